@@ -36,6 +36,9 @@
 #include "bacdcode.h"
 #include "bacdef.h"
 #include "abort.h"
+#if APDU_STATISTICS
+#include "apdu.h"
+#endif
 
 /** @file abort.c  Abort Encoding/Decoding */
 /* Helper function to avoid needing additional entries in service data structures
@@ -91,6 +94,10 @@ int abort_encode_apdu(
         apdu[1] = invoke_id;
         apdu[2] = abort_reason;
         apdu_len = 3;
+#if APDU_STATISTICS
+        if (server)
+            apdu_statistics_abort();
+#endif
     }
 
     return apdu_len;
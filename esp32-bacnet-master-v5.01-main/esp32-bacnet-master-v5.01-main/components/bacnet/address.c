@@ -42,6 +42,7 @@
 #include "bacdef.h"
 #include "bacdcode.h"
 #include "readrange.h"
+#include "baclock.h"
 
 /* we are likely compiling the demo command line tools if print enabled */
 #if !defined(BACNET_ADDRESS_CACHE_FILE)
@@ -58,6 +59,8 @@
 
 static uint32_t Top_Protected_Entry;
 static uint32_t Own_Device_ID = 0xFFFFFFFF;
+/* the client task binds to devices while the server task learns them */
+static BACLOCK Address_Lock = BACLOCK_INITIALIZER;
 
 static struct Address_Cache_Entry {
     uint8_t Flags;
@@ -67,6 +70,10 @@ static struct Address_Cache_Entry {
     uint32_t TimeToLive;
 } Address_Cache[MAX_ADDRESS_CACHE];
 
+/* largest encoding of one Device_Address_Binding element: the device
+   identifier, network number and MAC address */
+#define ADDRESS_LIST_ELEMENT_MAX (5 + 3 + 2 + MAX_MAC_LEN)
+
 /* State flags for cache entries */
 
 #define BAC_ADDR_IN_USE    1    /* Address cache entry in use */
@@ -85,12 +92,16 @@ static struct Address_Cache_Entry {
 
 void address_protected_entry_index_set(uint32_t top_protected_entry_index)
 {
+    baclock_take(&Address_Lock);
     Top_Protected_Entry = top_protected_entry_index;
+    baclock_give(&Address_Lock);
 }
 
 void address_own_device_id_set(uint32_t own_id)
 {
+    baclock_take(&Address_Lock);
     Own_Device_ID = own_id;
+    baclock_give(&Address_Lock);
 }
 
 bool address_match(
@@ -135,6 +146,7 @@ void address_remove_device(
     struct Address_Cache_Entry *pMatch;
     uint32_t index = 0;
 
+    baclock_take(&Address_Lock);
     pMatch = Address_Cache;
     while (pMatch <= &Address_Cache[MAX_ADDRESS_CACHE - 1]) {
         if (((pMatch->Flags & BAC_ADDR_IN_USE) != 0) &&
@@ -148,6 +160,7 @@ void address_remove_device(
         pMatch++;
         index++;
     }
+    baclock_give(&Address_Lock);
 
     return;
 }
@@ -295,6 +308,7 @@ void address_init(
 {
     struct Address_Cache_Entry *pMatch;
 
+    baclock_take(&Address_Lock);
    Top_Protected_Entry = 0;
 
     pMatch = Address_Cache;
@@ -305,6 +319,8 @@ void address_init(
 #ifdef BACNET_ADDRESS_CACHE_FILE
     address_file_init(Address_Cache_Filename);
 #endif
+    baclock_give(&Address_Lock);
+
     return;
 }
 
@@ -320,6 +336,7 @@ void address_init_partial(void)
 {
     struct Address_Cache_Entry *pMatch;
 
+    baclock_take(&Address_Lock);
     pMatch = Address_Cache;
     while (pMatch <= &Address_Cache[MAX_ADDRESS_CACHE - 1]) {
         if ((pMatch->Flags & BAC_ADDR_IN_USE) != 0) {   /* It's in use so let's check further */
@@ -337,6 +354,7 @@ void address_init_partial(void)
  #ifdef BACNET_ADDRESS_CACHE_FILE
     address_file_init(Address_Cache_Filename);
 #endif
+    baclock_give(&Address_Lock);
 
     return;
 }
@@ -356,6 +374,7 @@ void address_set_device_TTL(
 {
     struct Address_Cache_Entry *pMatch;
 
+    baclock_take(&Address_Lock);
     pMatch = Address_Cache;
     while (pMatch <= &Address_Cache[MAX_ADDRESS_CACHE - 1]) {
         if (((pMatch->Flags & BAC_ADDR_IN_USE) != 0) &&
@@ -375,6 +394,7 @@ void address_set_device_TTL(
         }
         pMatch++;
     }
+    baclock_give(&Address_Lock);
 }
 
 
@@ -386,6 +406,7 @@ bool address_get_by_device(
     struct Address_Cache_Entry *pMatch;
     bool found = false; /* return value */
 
+    baclock_take(&Address_Lock);
     pMatch = Address_Cache;
     while (pMatch <= &Address_Cache[MAX_ADDRESS_CACHE - 1]) {
         if (((pMatch->Flags & BAC_ADDR_IN_USE) != 0) &&
@@ -399,6 +420,7 @@ bool address_get_by_device(
         }
         pMatch++;
     }
+    baclock_give(&Address_Lock);
 
     return found;
 }
@@ -412,6 +434,7 @@ bool address_get_device_id(
     struct Address_Cache_Entry *pMatch;
     bool found = false; /* return value */
 
+    baclock_take(&Address_Lock);
     pMatch = Address_Cache;
     while (pMatch <= &Address_Cache[MAX_ADDRESS_CACHE - 1]) {
         if ((pMatch->Flags & (BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ)) == BAC_ADDR_IN_USE) {       /* If bound */
@@ -425,6 +448,7 @@ bool address_get_device_id(
         }
         pMatch++;
     }
+    baclock_give(&Address_Lock);
 
     return found;
 }
@@ -437,7 +461,9 @@ void address_add(
     bool found = false; /* return value */
     struct Address_Cache_Entry *pMatch;
 
+    baclock_take(&Address_Lock);
     if (Own_Device_ID == device_id) {
+        baclock_give(&Address_Lock);
         return;
     }
 
@@ -501,12 +527,13 @@ void address_add(
             pMatch->TimeToLive = BAC_ADDR_SHORT_TIME;   /* Opportunistic entry so leave on short fuse */
         }
     }
+    baclock_give(&Address_Lock);
+
     return;
 }
 
-/* returns true if device is already bound */
-/* also returns the address and max apdu if already bound */
-bool address_device_bind_request(
+/* address_device_bind_request() with Address_Lock held */
+static bool address_device_bind_request_locked(
     uint32_t device_id,
     uint32_t * device_ttl,
     unsigned *max_apdu,
@@ -567,6 +594,23 @@ bool address_device_bind_request(
     return (false);
 }
 
+/* returns true if device is already bound */
+/* also returns the address and max apdu if already bound */
+bool address_device_bind_request(
+    uint32_t device_id,
+    uint32_t * device_ttl,
+    unsigned *max_apdu,
+    BACNET_ADDRESS * src)
+{
+    bool status;
+
+    baclock_take(&Address_Lock);
+    status = address_device_bind_request_locked(device_id, device_ttl, max_apdu, src);
+    baclock_give(&Address_Lock);
+
+    return status;
+}
+
 /* returns true if device is already bound */
 /* also returns the address and max apdu if already bound */
 bool address_bind_request(
@@ -584,6 +628,7 @@ void address_add_binding(
 {
     struct Address_Cache_Entry *pMatch;
 
+    baclock_take(&Address_Lock);
     /* existing device or bind request - update address */
     pMatch = Address_Cache;
     while (pMatch <= &Address_Cache[MAX_ADDRESS_CACHE - 1]) {
@@ -602,6 +647,8 @@ void address_add_binding(
         }
         pMatch++;
     }
+    baclock_give(&Address_Lock);
+
     return;
 }
 
@@ -615,6 +662,7 @@ bool address_device_get_by_index(
     struct Address_Cache_Entry *pMatch;
     bool found = false; /* return value */
 
+    baclock_take(&Address_Lock);
     if (index < MAX_ADDRESS_CACHE) {
         pMatch = &Address_Cache[index];
         if ((pMatch->Flags & (BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ)) ==
@@ -634,6 +682,7 @@ bool address_device_get_by_index(
             found = true;
         }
     }
+    baclock_give(&Address_Lock);
 
     return found;
 }
@@ -653,6 +702,7 @@ unsigned address_count(
     struct Address_Cache_Entry *pMatch;
     unsigned count = 0; /* return value */
 
+    baclock_take(&Address_Lock);
     pMatch = Address_Cache;
     while (pMatch <= &Address_Cache[MAX_ADDRESS_CACHE - 1]) {
         /* Only count bound entries */
@@ -662,13 +712,15 @@ unsigned address_count(
 
         pMatch++;
     }
+    baclock_give(&Address_Lock);
 
     return count;
 }
 
 /****************************************************************************
  * Build a list of the current bindings for the device address binding      *
- * property.                                                                *
+ * property, in at most apdu_len octets.  Returns BACNET_STATUS_ABORT if    *
+ * the bindings do not fit.                                                 *
  ****************************************************************************/
 
 int address_list_encode(
@@ -679,15 +731,16 @@ int address_list_encode(
     struct Address_Cache_Entry *pMatch;
     BACNET_OCTET_STRING MAC_Address;
 
-    /* FIXME: I really shouild check the length remaining here but it is
-       fairly pointless until we have the true length remaining in
-       the packet to work with as at the moment it is just MAX_APDU */
-    apdu_len = apdu_len;
+    baclock_take(&Address_Lock);
     /* look for matching address */
     pMatch = Address_Cache;
     while (pMatch <= &Address_Cache[MAX_ADDRESS_CACHE - 1]) {
         if ((pMatch->Flags & (BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ)) ==
             BAC_ADDR_IN_USE) {
+            if ((iLen + ADDRESS_LIST_ELEMENT_MAX) > (int) apdu_len) {
+                iLen = BACNET_STATUS_ABORT;
+                break;
+            }
             iLen +=
                 encode_application_object_id(&apdu[iLen], OBJECT_DEVICE,
                 pMatch->device_id);
@@ -710,6 +763,7 @@ int address_list_encode(
         }
         pMatch++;
     }
+    baclock_give(&Address_Lock);
 
     return (iLen);
 }
@@ -724,8 +778,8 @@ int address_list_encode(
  * extract entries by doing a linear scan starting from the first entry in  *
  * the cache and picking them off one by one.                               *
  *                                                                          *
- * We do assume the list cannot change whilst we are accessing it so would  *
- * not be multithread safe if there are other tasks that change the cache.  *
+ * The list must not change whilst we are accessing it, so the whole scan   *
+ * is made with Address_Lock held against the other tasks.                  *
  *                                                                          *
  * We take the simple approach here to filling the buffer by taking a max   *
  * size for a single entry and then stopping if there is less than that     *
@@ -739,7 +793,8 @@ int address_list_encode(
 
 #define ACACHE_MAX_ENC 17       /* Maximum size of encoded cache entry, see above */
 
-int rr_address_list_encode(
+/* rr_address_list_encode() with Address_Lock held */
+static int rr_address_list_encode_locked(
     uint8_t * apdu,
     BACNET_READ_RANGE_DATA * pRequest)
 {
@@ -760,7 +815,8 @@ int rr_address_list_encode(
     bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_LAST_ITEM, false);
     bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_MORE_ITEMS, false);
     /* See how much space we have */
-    uiRemaining = (uint32_t) (MAX_APDU - pRequest->Overhead);
+    uiRemaining =
+        (uint32_t) (pRequest->application_data_len - pRequest->Overhead);
 
     pRequest->ItemCount = 0;    /* Start out with nothing */
     uiTotal = address_count();  /* What do we have to work with here ? */
@@ -883,6 +939,19 @@ int rr_address_list_encode(
     return (iLen);
 }
 
+int rr_address_list_encode(
+    uint8_t * apdu,
+    BACNET_READ_RANGE_DATA * pRequest)
+{
+    int status;
+
+    baclock_take(&Address_Lock);
+    status = rr_address_list_encode_locked(apdu, pRequest);
+    baclock_give(&Address_Lock);
+
+    return status;
+}
+
 /****************************************************************************
  * Scan the cache and eliminate any expired entries. Should be called       *
  * periodically to ensure the cache is managed correctly. If this function  *
@@ -895,6 +964,7 @@ void address_cache_timer(
 {       /* Approximate number of seconds since last call to this function */
     struct Address_Cache_Entry *pMatch;
 
+    baclock_take(&Address_Lock);
     pMatch = Address_Cache;
     while (pMatch <= &Address_Cache[MAX_ADDRESS_CACHE - 1]) {
         if (((pMatch->Flags & (BAC_ADDR_IN_USE | BAC_ADDR_RESERVED)) != 0)
@@ -907,6 +977,7 @@ void address_cache_timer(
 
         pMatch++;
     }
+    baclock_give(&Address_Lock);
 }
 
 
@@ -1064,6 +1135,69 @@ void testAddress(
     }
 }
 
+#include <pthread.h>
+
+#define TEST_THREADS 4
+#define TEST_LOOPS 100000
+
+static void *address_test_thread(
+    void *arg)
+{
+    unsigned index = (unsigned) (uintptr_t) arg;
+    unsigned errors = 0;
+    unsigned i;
+    BACNET_ADDRESS src;
+    BACNET_ADDRESS test_address;
+    unsigned test_max_apdu = 0;
+    uint32_t device_id = 1000 + index;
+
+    set_address(index + 1, &src);
+    for (i = 0; i < TEST_LOOPS; i++) {
+        address_add(device_id, 480, &src);
+        /* the entry may have been taken over by another thread,
+           but never half of it */
+        if (address_get_by_device(device_id, &test_max_apdu, &test_address)) {
+            if (!bacnet_address_same(&test_address, &src) ||
+                (test_max_apdu != 480)) {
+                errors++;
+            }
+        }
+        if (address_count() > MAX_ADDRESS_CACHE) {
+            errors++;
+        }
+        if ((i % 16) == 0) {
+            address_remove_device(device_id);
+        }
+    }
+
+    return (void *) (uintptr_t) errors;
+}
+
+void testAddressThreads(
+    Test * pTest)
+{
+    pthread_t thread[TEST_THREADS];
+    void *errors;
+    BACNET_ADDRESS test_address;
+    unsigned test_max_apdu = 0;
+    uintptr_t i;
+
+    address_init();
+    for (i = 0; i < TEST_THREADS; i++) {
+        ct_test(pTest, pthread_create(&thread[i], NULL, address_test_thread,
+                (void *) i) == 0);
+    }
+    for (i = 0; i < TEST_THREADS; i++) {
+        pthread_join(thread[i], &errors);
+        ct_test(pTest, errors == NULL);
+    }
+    for (i = 0; i < TEST_THREADS; i++) {
+        address_remove_device(1000 + i);
+        ct_test(pTest, !address_get_by_device(1000 + i, &test_max_apdu,
+                &test_address));
+    }
+}
+
 #ifdef TEST_ADDRESS
 int main(
     void)
@@ -1077,6 +1211,8 @@ int main(
     assert(rc);
     rc = ct_addTestFunction(pTest, testAddressFile);
     assert(rc);
+    rc = ct_addTestFunction(pTest, testAddressThreads);
+    assert(rc);
 
 
     ct_setStream(pTest, stdout);
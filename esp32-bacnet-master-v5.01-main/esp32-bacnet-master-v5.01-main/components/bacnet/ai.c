@@ -29,6 +29,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "bacdef.h"
 #include "bacdcode.h"
@@ -39,153 +41,211 @@
 #include "handlers.h"
 #include "timestamp.h"
 #include "ai.h"
+#include "objinst.h"
 
 
+/* the most Analog Input objects that can be created */
 #ifndef MAX_ANALOG_INPUTS
-#define MAX_ANALOG_INPUTS 4
+#define MAX_ANALOG_INPUTS 1024
+#endif
+/* the Analog Input objects created by Analog_Input_Init(), 0..n-1 */
+#ifndef ANALOG_INPUT_INIT_COUNT
+#define ANALOG_INPUT_INIT_COUNT 4
 #endif
+/* encoding of one Event_Time_Stamps element, a tagged date and time */
+#define AI_TIME_STAMP_ELEMENT_MAX 12
+
+static OBJINST_TABLE AI_Instances;
+/* the properties used on every COV check, one array each */
+static float *AI_Present_Value;
+static float *AI_Prior_Value;
+static float *AI_COV_Increment;
+static bool *AI_Out_Of_Service;
+static bool *AI_Changed;
+/* everything else */
+static ANALOG_INPUT_DESCR *AI_Descr;
+
+static bool Analog_Input_Resize(
+    unsigned size)
+{
+    void *data;
 
+    data = objinst_realloc(AI_Present_Value, size * sizeof(float));
+    if (!data) {
+        return false;
+    }
+    AI_Present_Value = data;
+    data = objinst_realloc(AI_Prior_Value, size * sizeof(float));
+    if (!data) {
+        return false;
+    }
+    AI_Prior_Value = data;
+    data = objinst_realloc(AI_COV_Increment, size * sizeof(float));
+    if (!data) {
+        return false;
+    }
+    AI_COV_Increment = data;
+    data = objinst_realloc(AI_Out_Of_Service, size * sizeof(bool));
+    if (!data) {
+        return false;
+    }
+    AI_Out_Of_Service = data;
+    data = objinst_realloc(AI_Changed, size * sizeof(bool));
+    if (!data) {
+        return false;
+    }
+    AI_Changed = data;
+    data = objinst_realloc(AI_Descr, size * sizeof(ANALOG_INPUT_DESCR));
+    if (!data) {
+        return false;
+    }
+    AI_Descr = data;
 
-ANALOG_INPUT_DESCR AI_Descr[MAX_ANALOG_INPUTS];
+    return true;
+}
 
-/* These three arrays are used by the ReadPropertyMultiple handler */
-static const int Properties_Required[] = {
-    PROP_OBJECT_IDENTIFIER,
-    PROP_OBJECT_NAME,
-    PROP_OBJECT_TYPE,
-    PROP_PRESENT_VALUE,
-    PROP_STATUS_FLAGS,
-    PROP_EVENT_STATE,
-    PROP_OUT_OF_SERVICE,
-    PROP_UNITS,
-    -1
-};
+static void Analog_Input_Move(
+    unsigned to,
+    unsigned from)
+{
+    AI_Present_Value[to] = AI_Present_Value[from];
+    AI_Prior_Value[to] = AI_Prior_Value[from];
+    AI_COV_Increment[to] = AI_COV_Increment[from];
+    AI_Out_Of_Service[to] = AI_Out_Of_Service[from];
+    AI_Changed[to] = AI_Changed[from];
+    AI_Descr[to] = AI_Descr[from];
+}
 
-static const int Properties_Optional[] = {
-    PROP_DESCRIPTION,
-    PROP_RELIABILITY,
-    PROP_COV_INCREMENT,
+/**
+ * Creates an Analog Input object with default property values.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was created or exists already
+ */
+bool Analog_Input_Create(
+    uint32_t object_instance)
+{
+    unsigned i;
 #if defined(INTRINSIC_REPORTING)
-    PROP_TIME_DELAY,
-    PROP_NOTIFICATION_CLASS,
-    PROP_HIGH_LIMIT,
-    PROP_LOW_LIMIT,
-    PROP_DEADBAND,
-    PROP_LIMIT_ENABLE,
-    PROP_EVENT_ENABLE,
-    PROP_ACKED_TRANSITIONS,
-    PROP_NOTIFY_TYPE,
-    PROP_EVENT_TIME_STAMPS,
+    unsigned j;
 #endif
-    -1
-};
 
-static const int Properties_Proprietary[] = {
-    9997,
-    9998,
-    9999,
-    -1
-};
+    if (Analog_Input_Valid_Instance(object_instance)) {
+        return true;
+    }
+    i = objinst_add(&AI_Instances, object_instance);
+    if (i >= objinst_count(&AI_Instances)) {
+        return false;
+    }
+    AI_Present_Value[i] = 0.0f;
+    AI_Prior_Value[i] = 0.0f;
+    AI_COV_Increment[i] = 1.0f;
+    AI_Out_Of_Service[i] = false;
+    AI_Changed[i] = false;
+    memset(&AI_Descr[i], 0x00, sizeof(ANALOG_INPUT_DESCR));
+    AI_Descr[i].Units = UNITS_PERCENT;
+    AI_Descr[i].Reliability = RELIABILITY_NO_FAULT_DETECTED;
+#if defined(INTRINSIC_REPORTING)
+    AI_Descr[i].Event_State = EVENT_STATE_NORMAL;
+    /* notification class not connected */
+    AI_Descr[i].Notification_Class = BACNET_MAX_INSTANCE;
+    /* initialize Event time stamps using wildcards
+       and set Acked_transitions */
+    for (j = 0; j < MAX_BACNET_EVENT_TRANSITION; j++) {
+        datetime_wildcard_set(&AI_Descr[i].Event_Time_Stamps[j]);
+        AI_Descr[i].Acked_Transitions[j].bIsAcked = true;
+    }
+#endif
+    Device_Inc_Database_Revision();
 
-void Analog_Input_Property_Lists(
-    const int **pRequired,
-    const int **pOptional,
-    const int **pProprietary)
+    return true;
+}
+
+/**
+ * Deletes an Analog Input object.  The last object takes its index.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was deleted
+ */
+bool Analog_Input_Delete(
+    uint32_t object_instance)
 {
-    if (pRequired)
-        *pRequired = Properties_Required;
-    if (pOptional)
-        *pOptional = Properties_Optional;
-    if (pProprietary)
-        *pProprietary = Properties_Proprietary;
+    if (!objinst_remove(&AI_Instances, object_instance)) {
+        return false;
+    }
+    Device_Inc_Database_Revision();
 
-    return;
+    return true;
 }
 
+/**
+ * Deletes all the Analog Input objects and frees their memory.
+ */
+void Analog_Input_Cleanup(
+    void)
+{
+    objinst_cleanup(&AI_Instances);
+    free(AI_Present_Value);
+    free(AI_Prior_Value);
+    free(AI_COV_Increment);
+    free(AI_Out_Of_Service);
+    free(AI_Changed);
+    free(AI_Descr);
+    AI_Present_Value = NULL;
+    AI_Prior_Value = NULL;
+    AI_COV_Increment = NULL;
+    AI_Out_Of_Service = NULL;
+    AI_Changed = NULL;
+    AI_Descr = NULL;
+}
 
 void Analog_Input_Init(
     void)
 {
-    unsigned i;
-#if defined(INTRINSIC_REPORTING)
-    unsigned j;
-#endif
+    uint32_t instance;
 
-    for (i = 0; i < MAX_ANALOG_INPUTS; i++) {
-        AI_Descr[i].Present_Value = 0.0f;
-        AI_Descr[i].Out_Of_Service = false;
-        AI_Descr[i].Units = UNITS_PERCENT;
-        AI_Descr[i].Reliability = RELIABILITY_NO_FAULT_DETECTED;
-        AI_Descr[i].Prior_Value = 0.0f;
-        AI_Descr[i].COV_Increment = 1.0f;
-        AI_Descr[i].Changed = false;
+    objinst_init(&AI_Instances, MAX_ANALOG_INPUTS, Analog_Input_Resize,
+        Analog_Input_Move);
+    for (instance = 0; instance < ANALOG_INPUT_INIT_COUNT; instance++) {
+        Analog_Input_Create(instance);
+    }
 #if defined(INTRINSIC_REPORTING)
-        AI_Descr[i].Event_State = EVENT_STATE_NORMAL;
-        /* notification class not connected */
-        AI_Descr[i].Notification_Class = BACNET_MAX_INSTANCE;
-        /* initialize Event time stamps using wildcards
-           and set Acked_transitions */
-        for (j = 0; j < MAX_BACNET_EVENT_TRANSITION; j++) {
-            datetime_wildcard_set(&AI_Descr[i].Event_Time_Stamps[j]);
-            AI_Descr[i].Acked_Transitions[j].bIsAcked = true;
-        }
-
-        /* Set handler for GetEventInformation function */
-        handler_get_event_information_set(OBJECT_ANALOG_INPUT,
-            Analog_Input_Event_Information);
-        /* Set handler for AcknowledgeAlarm function */
-        handler_alarm_ack_set(OBJECT_ANALOG_INPUT, Analog_Input_Alarm_Ack);
-        /* Set handler for GetAlarmSummary Service */
-        handler_get_alarm_summary_set(OBJECT_ANALOG_INPUT,
-            Analog_Input_Alarm_Summary);
+    /* Set handler for GetEventInformation function */
+    handler_get_event_information_set(OBJECT_ANALOG_INPUT,
+        Analog_Input_Event_Information);
+    /* Set handler for AcknowledgeAlarm function */
+    handler_alarm_ack_set(OBJECT_ANALOG_INPUT, Analog_Input_Alarm_Ack);
+    /* Set handler for GetAlarmSummary Service */
+    handler_get_alarm_summary_set(OBJECT_ANALOG_INPUT,
+        Analog_Input_Alarm_Summary);
 #endif
-    }
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need validate that the */
-/* given instance exists */
 bool Analog_Input_Valid_Instance(
     uint32_t object_instance)
 {
-    unsigned int index;
-
-    index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS)
-        return true;
-
-    return false;
+    return objinst_valid_instance(&AI_Instances, object_instance);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then count how many you have */
 unsigned Analog_Input_Count(
     void)
 {
-    return 1;
+    return objinst_count(&AI_Instances);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the instance */
-/* that correlates to the correct index */
 uint32_t Analog_Input_Index_To_Instance(
     unsigned index)
 {
-    return index;
+    return objinst_index_to_instance(&AI_Instances, index);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the index */
-/* that correlates to the correct instance number */
+/* returns an index not less than the count if there is no such object */
 unsigned Analog_Input_Instance_To_Index(
     uint32_t object_instance)
 {
-    unsigned index = MAX_ANALOG_INPUTS;
-
-    if (object_instance < MAX_ANALOG_INPUTS)
-        index = object_instance;
-
-    return index;
+    return objinst_instance_to_index(&AI_Instances, object_instance);
 }
 
 float Analog_Input_Present_Value(
@@ -195,8 +255,8 @@ float Analog_Input_Present_Value(
     unsigned int index;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        value = AI_Descr[index].Present_Value;
+    if (index < objinst_count(&AI_Instances)) {
+        value = AI_Present_Value[index];
     }
 
     return value;
@@ -209,17 +269,19 @@ static void Analog_Input_COV_Detect(unsigned int index,
     float cov_increment = 0.0;
     float cov_delta = 0.0;
 
-    if (index < MAX_ANALOG_INPUTS) {
-        prior_value = AI_Descr[index].Prior_Value;
-        cov_increment = AI_Descr[index].COV_Increment;
+    if (index < objinst_count(&AI_Instances)) {
+        prior_value = AI_Prior_Value[index];
+        cov_increment = AI_COV_Increment[index];
         if (prior_value > value) {
             cov_delta = prior_value - value;
         } else {
             cov_delta = value - prior_value;
         }
         if (cov_delta >= cov_increment) {
-            AI_Descr[index].Changed = true;
-            AI_Descr[index].Prior_Value = value;
+            AI_Changed[index] = true;
+            AI_Prior_Value[index] = value;
+            handler_cov_object_changed(OBJECT_ANALOG_INPUT,
+                Analog_Input_Index_To_Instance(index));
         }
     }
 }
@@ -231,9 +293,9 @@ void Analog_Input_Present_Value_Set(
     unsigned int index = 0;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
+    if (index < objinst_count(&AI_Instances)) {
         Analog_Input_COV_Detect(index, value);
-        AI_Descr[index].Present_Value = value;
+        AI_Present_Value[index] = value;
     }
 }
 
@@ -241,13 +303,14 @@ bool Analog_Input_Object_Name(
     uint32_t object_instance,
     BACNET_CHARACTER_STRING * object_name)
 {
-    static char text_string[32] = "";   /* okay for single thread */
+    char text_string[32] = "";
     unsigned int index;
     bool status = false;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        sprintf(text_string, "ANALOG INPUT %lu", (unsigned long) index);
+    if (index < objinst_count(&AI_Instances)) {
+        sprintf(text_string, "ANALOG INPUT %lu",
+            (unsigned long) object_instance);
         status = characterstring_init_ansi(object_name, text_string);
     }
 
@@ -261,8 +324,8 @@ bool Analog_Input_Change_Of_Value(
     bool changed = false;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        changed = AI_Descr[index].Changed;
+    if (index < objinst_count(&AI_Instances)) {
+        changed = AI_Changed[index];
     }
 
     return changed;
@@ -274,8 +337,8 @@ void Analog_Input_Change_Of_Value_Clear(
     unsigned index = 0;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        AI_Descr[index].Changed = false;
+    if (index < objinst_count(&AI_Instances)) {
+        AI_Changed[index] = false;
     }
 }
 
@@ -339,8 +402,8 @@ float Analog_Input_COV_Increment(
     float value = 0;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        value = AI_Descr[index].COV_Increment;
+    if (index < objinst_count(&AI_Instances)) {
+        value = AI_COV_Increment[index];
     }
 
     return value;
@@ -353,9 +416,9 @@ void Analog_Input_COV_Increment_Set(
     unsigned index = 0;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        AI_Descr[index].COV_Increment = value;
-        Analog_Input_COV_Detect(index, AI_Descr[index].Present_Value);
+    if (index < objinst_count(&AI_Instances)) {
+        AI_COV_Increment[index] = value;
+        Analog_Input_COV_Detect(index, AI_Present_Value[index]);
     }
 }
 
@@ -366,8 +429,8 @@ bool Analog_Input_Out_Of_Service(
     bool value = false;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        value = AI_Descr[index].Out_Of_Service;
+    if (index < objinst_count(&AI_Instances)) {
+        value = AI_Out_Of_Service[index];
     }
 
     return value;
@@ -380,267 +443,395 @@ void Analog_Input_Out_Of_Service_Set(
     unsigned index = 0;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        if (AI_Descr[index].Out_Of_Service != value) {
-            AI_Descr[index].Changed = true;
+    if (index < objinst_count(&AI_Instances)) {
+        if (AI_Out_Of_Service[index] != value) {
+            AI_Changed[index] = true;
+            handler_cov_object_changed(OBJECT_ANALOG_INPUT, object_instance);
         }
-        AI_Descr[index].Out_Of_Service = value;
+        AI_Out_Of_Service[index] = value;
     }
 }
 
-/* return apdu length, or BACNET_STATUS_ERROR on error */
-/* assumption - object has already exists */
-int Analog_Input_Read_Property(
-    BACNET_READ_PROPERTY_DATA * rpdata)
+static int Analog_Input_Read_Object_Identifier(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
 {
-    int apdu_len = 0;   /* return value */
-    BACNET_BIT_STRING bit_string;
-    BACNET_CHARACTER_STRING char_string;
-    ANALOG_INPUT_DESCR *CurrentAI;
-    unsigned object_index = 0;
-#if defined(INTRINSIC_REPORTING)
-    unsigned i = 0;
-    int len = 0;
-#endif
-    uint8_t *apdu = NULL;
+    return encode_application_object_id(&rpdata->application_data[0],
+        OBJECT_ANALOG_INPUT, rpdata->object_instance);
+}
 
-    if ((rpdata == NULL) || (rpdata->application_data == NULL) ||
-        (rpdata->application_data_len == 0)) {
-        return 0;
-    }
+static int Analog_Input_Read_Object_Name(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_CHARACTER_STRING char_string;
 
-    object_index = Analog_Input_Instance_To_Index(rpdata->object_instance);
-    if (object_index < MAX_ANALOG_INPUTS)
-        CurrentAI = &AI_Descr[object_index];
-    else
-        return BACNET_STATUS_ERROR;
+    Analog_Input_Object_Name(rpdata->object_instance, &char_string);
 
-    apdu = rpdata->application_data;
-    switch ((int) rpdata->object_property) {
-        case PROP_OBJECT_IDENTIFIER:
-            apdu_len =
-                encode_application_object_id(&apdu[0], OBJECT_ANALOG_INPUT,
-                rpdata->object_instance);
-            break;
+    return encode_application_character_string(&rpdata->application_data[0],
+        &char_string);
+}
 
-        case PROP_OBJECT_NAME:
-        case PROP_DESCRIPTION:
-            Analog_Input_Object_Name(rpdata->object_instance, &char_string);
-            apdu_len =
-                encode_application_character_string(&apdu[0], &char_string);
-            break;
+static int Analog_Input_Read_Object_Type(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        OBJECT_ANALOG_INPUT);
+}
 
-        case PROP_OBJECT_TYPE:
-            apdu_len =
-                encode_application_enumerated(&apdu[0], OBJECT_ANALOG_INPUT);
-            break;
+static int Analog_Input_Read_Present_Value(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0],
+        AI_Present_Value[object_index]);
+}
 
-        case PROP_PRESENT_VALUE:
-            apdu_len =
-                encode_application_real(&apdu[0],
-                Analog_Input_Present_Value(rpdata->object_instance));
-            break;
+static int Analog_Input_Read_Status_Flags(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string;
 
-        case PROP_STATUS_FLAGS:
-            bitstring_init(&bit_string);
+    bitstring_init(&bit_string);
 #if defined(INTRINSIC_REPORTING)
-            bitstring_set_bit(&bit_string, STATUS_FLAG_IN_ALARM,
-                CurrentAI->Event_State ? true : false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_IN_ALARM,
+        AI_Descr[object_index].Event_State ? true : false);
 #else
-            bitstring_set_bit(&bit_string, STATUS_FLAG_IN_ALARM, false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_IN_ALARM, false);
 #endif
-            bitstring_set_bit(&bit_string, STATUS_FLAG_FAULT, false);
-            bitstring_set_bit(&bit_string, STATUS_FLAG_OVERRIDDEN, false);
-            bitstring_set_bit(&bit_string, STATUS_FLAG_OUT_OF_SERVICE,
-                CurrentAI->Out_Of_Service);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_FAULT, false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_OVERRIDDEN, false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_OUT_OF_SERVICE,
+        AI_Out_Of_Service[object_index]);
 
-            apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
-            break;
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
 
-        case PROP_EVENT_STATE:
+static int Analog_Input_Read_Event_State(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
 #if defined(INTRINSIC_REPORTING)
-            apdu_len =
-                encode_application_enumerated(&apdu[0],
-                CurrentAI->Event_State);
+    return encode_application_enumerated(&rpdata->application_data[0],
+        AI_Descr[object_index].Event_State);
 #else
-            apdu_len =
-                encode_application_enumerated(&apdu[0], EVENT_STATE_NORMAL);
+    return encode_application_enumerated(&rpdata->application_data[0],
+        EVENT_STATE_NORMAL);
 #endif
-            break;
+}
 
-        case PROP_RELIABILITY:
-            apdu_len =
-                encode_application_enumerated(&apdu[0],
-                CurrentAI->Reliability);
-            break;
+static int Analog_Input_Read_Reliability(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        AI_Descr[object_index].Reliability);
+}
 
-        case PROP_OUT_OF_SERVICE:
-            apdu_len =
-                encode_application_boolean(&apdu[0],
-                CurrentAI->Out_Of_Service);
-            break;
+static int Analog_Input_Read_Out_Of_Service(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_boolean(&rpdata->application_data[0],
+        AI_Out_Of_Service[object_index]);
+}
 
-        case PROP_UNITS:
-            apdu_len =
-                encode_application_enumerated(&apdu[0], CurrentAI->Units);
-            break;
+static int Analog_Input_Read_Units(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        AI_Descr[object_index].Units);
+}
 
-        case PROP_COV_INCREMENT:
-            apdu_len = encode_application_real(&apdu[0],
-                CurrentAI->COV_Increment);
-            break;
+static int Analog_Input_Read_COV_Increment(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0],
+        AI_COV_Increment[object_index]);
+}
 
 #if defined(INTRINSIC_REPORTING)
-        case PROP_TIME_DELAY:
-            apdu_len =
-                encode_application_unsigned(&apdu[0], CurrentAI->Time_Delay);
-            break;
+static int Analog_Input_Read_Time_Delay(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        AI_Descr[object_index].Time_Delay);
+}
 
-        case PROP_NOTIFICATION_CLASS:
-            apdu_len =
-                encode_application_unsigned(&apdu[0],
-                CurrentAI->Notification_Class);
-            break;
+static int Analog_Input_Read_Notification_Class(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        AI_Descr[object_index].Notification_Class);
+}
 
-        case PROP_HIGH_LIMIT:
-            apdu_len =
-                encode_application_real(&apdu[0], CurrentAI->High_Limit);
-            break;
+static int Analog_Input_Read_High_Limit(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0],
+        AI_Descr[object_index].High_Limit);
+}
 
-        case PROP_LOW_LIMIT:
-            apdu_len = encode_application_real(&apdu[0], CurrentAI->Low_Limit);
-            break;
+static int Analog_Input_Read_Low_Limit(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0],
+        AI_Descr[object_index].Low_Limit);
+}
 
-        case PROP_DEADBAND:
-            apdu_len = encode_application_real(&apdu[0], CurrentAI->Deadband);
-            break;
+static int Analog_Input_Read_Deadband(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0],
+        AI_Descr[object_index].Deadband);
+}
 
-        case PROP_LIMIT_ENABLE:
-            bitstring_init(&bit_string);
-            bitstring_set_bit(&bit_string, 0,
-                (CurrentAI->
-                    Limit_Enable & EVENT_LOW_LIMIT_ENABLE) ? true : false);
-            bitstring_set_bit(&bit_string, 1,
-                (CurrentAI->
-                    Limit_Enable & EVENT_HIGH_LIMIT_ENABLE) ? true : false);
-
-            apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
-            break;
+static int Analog_Input_Read_Limit_Enable(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string;
 
-        case PROP_EVENT_ENABLE:
-            bitstring_init(&bit_string);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_OFFNORMAL,
-                (CurrentAI->
-                    Event_Enable & EVENT_ENABLE_TO_OFFNORMAL) ? true : false);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_FAULT,
-                (CurrentAI->
-                    Event_Enable & EVENT_ENABLE_TO_FAULT) ? true : false);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_NORMAL,
-                (CurrentAI->
-                    Event_Enable & EVENT_ENABLE_TO_NORMAL) ? true : false);
-
-            apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
-            break;
+    bitstring_init(&bit_string);
+    bitstring_set_bit(&bit_string, 0,
+        (AI_Descr[object_index].Limit_Enable & EVENT_LOW_LIMIT_ENABLE) ? true : false);
+    bitstring_set_bit(&bit_string, 1,
+        (AI_Descr[object_index].Limit_Enable & EVENT_HIGH_LIMIT_ENABLE) ? true : false);
 
-        case PROP_ACKED_TRANSITIONS:
-            bitstring_init(&bit_string);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_OFFNORMAL,
-                CurrentAI->Acked_Transitions[TRANSITION_TO_OFFNORMAL].
-                bIsAcked);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_FAULT,
-                CurrentAI->Acked_Transitions[TRANSITION_TO_FAULT].bIsAcked);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_NORMAL,
-                CurrentAI->Acked_Transitions[TRANSITION_TO_NORMAL].bIsAcked);
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
 
-            apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
-            break;
+static int Analog_Input_Read_Event_Enable(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string;
 
-        case PROP_NOTIFY_TYPE:
-            apdu_len =
-                encode_application_enumerated(&apdu[0],
-                CurrentAI->Notify_Type ? NOTIFY_EVENT : NOTIFY_ALARM);
-            break;
+    bitstring_init(&bit_string);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_OFFNORMAL,
+        (AI_Descr[object_index].Event_Enable & EVENT_ENABLE_TO_OFFNORMAL) ? true : false);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_FAULT,
+        (AI_Descr[object_index].Event_Enable & EVENT_ENABLE_TO_FAULT) ? true : false);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_NORMAL,
+        (AI_Descr[object_index].Event_Enable & EVENT_ENABLE_TO_NORMAL) ? true : false);
 
-        case PROP_EVENT_TIME_STAMPS:
-            /* Array element zero is the number of elements in the array */
-            if (rpdata->array_index == 0)
-                apdu_len =
-                    encode_application_unsigned(&apdu[0],
-                    MAX_BACNET_EVENT_TRANSITION);
-            /* if no index was specified, then try to encode the entire list */
-            /* into one packet. */
-            else if (rpdata->array_index == BACNET_ARRAY_ALL) {
-                for (i = 0; i < MAX_BACNET_EVENT_TRANSITION; i++) {;
-                    len =
-                        encode_opening_tag(&apdu[apdu_len],
-                        TIME_STAMP_DATETIME);
-                    len +=
-                        encode_application_date(&apdu[apdu_len + len],
-                        &CurrentAI->Event_Time_Stamps[i].date);
-                    len +=
-                        encode_application_time(&apdu[apdu_len + len],
-                        &CurrentAI->Event_Time_Stamps[i].time);
-                    len +=
-                        encode_closing_tag(&apdu[apdu_len + len],
-                        TIME_STAMP_DATETIME);
-
-                    /* add it if we have room */
-                    if ((apdu_len + len) < MAX_APDU)
-                        apdu_len += len;
-                    else {
-                        rpdata->error_code =
-                            ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
-                        apdu_len = BACNET_STATUS_ABORT;
-                        break;
-                    }
-                }
-            } else if (rpdata->array_index <= MAX_BACNET_EVENT_TRANSITION) {
-                apdu_len =
-                    encode_opening_tag(&apdu[apdu_len], TIME_STAMP_DATETIME);
-                apdu_len +=
-                    encode_application_date(&apdu[apdu_len],
-                    &CurrentAI->Event_Time_Stamps[rpdata->array_index].date);
-                apdu_len +=
-                    encode_application_time(&apdu[apdu_len],
-                    &CurrentAI->Event_Time_Stamps[rpdata->array_index].time);
-                apdu_len +=
-                    encode_closing_tag(&apdu[apdu_len], TIME_STAMP_DATETIME);
-            } else {
-                rpdata->error_class = ERROR_CLASS_PROPERTY;
-                rpdata->error_code = ERROR_CODE_INVALID_ARRAY_INDEX;
-                apdu_len = BACNET_STATUS_ERROR;
-            }
-            break;
-#endif
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
 
-        case 9997:
-            /* test case for real encoding-decoding real value correctly */
-            apdu_len = encode_application_real(&apdu[0], 90.510F);
-            break;
-        case 9998:
-            /* test case for unsigned encoding-decoding unsigned value correctly */
-            apdu_len = encode_application_unsigned(&apdu[0], 90);
-            break;
-        case 9999:
-            /* test case for signed encoding-decoding negative value correctly */
-            apdu_len = encode_application_signed(&apdu[0], -200);
-            break;
-        default:
-            rpdata->error_class = ERROR_CLASS_PROPERTY;
-            rpdata->error_code = ERROR_CODE_UNKNOWN_PROPERTY;
-            apdu_len = BACNET_STATUS_ERROR;
-            break;
-    }
-    /*  only array properties can have array options */
-    if ((apdu_len >= 0) && (rpdata->object_property != PROP_EVENT_TIME_STAMPS)
-        && (rpdata->array_index != BACNET_ARRAY_ALL)) {
+static int Analog_Input_Read_Acked_Transitions(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string;
+
+    bitstring_init(&bit_string);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_OFFNORMAL,
+        AI_Descr[object_index].Acked_Transitions[TRANSITION_TO_OFFNORMAL].bIsAcked);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_FAULT,
+        AI_Descr[object_index].Acked_Transitions[TRANSITION_TO_FAULT].bIsAcked);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_NORMAL,
+        AI_Descr[object_index].Acked_Transitions[TRANSITION_TO_NORMAL].bIsAcked);
+
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
+
+static int Analog_Input_Read_Notify_Type(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        AI_Descr[object_index].Notify_Type ? NOTIFY_EVENT : NOTIFY_ALARM);
+}
+
+static int Analog_Input_Read_Event_Time_Stamps(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    int apdu_len = 0;   /* return value */
+    int len = 0;
+    unsigned i = 0;
+    uint8_t *apdu = rpdata->application_data;
+    ANALOG_INPUT_DESCR *CurrentObject = &AI_Descr[object_index];
+
+    /* Array element zero is the number of elements in the array */
+    if (rpdata->array_index == 0)
+        apdu_len =
+            encode_application_unsigned(&apdu[0],
+            MAX_BACNET_EVENT_TRANSITION);
+    /* if no index was specified, then try to encode the entire list */
+    /* into one packet. */
+    else if (rpdata->array_index == BACNET_ARRAY_ALL) {
+        for (i = 0; i < MAX_BACNET_EVENT_TRANSITION; i++) {
+            /* add it if we have room */
+            if ((apdu_len + AI_TIME_STAMP_ELEMENT_MAX) > rpdata->application_data_len) {
+                rpdata->error_code =
+                    ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
+                apdu_len = BACNET_STATUS_ABORT;
+                break;
+            }
+            len = encode_opening_tag(&apdu[apdu_len], TIME_STAMP_DATETIME);
+            len +=
+                encode_application_date(&apdu[apdu_len + len],
+                &CurrentObject->Event_Time_Stamps[i].date);
+            len +=
+                encode_application_time(&apdu[apdu_len + len],
+                &CurrentObject->Event_Time_Stamps[i].time);
+            len +=
+                encode_closing_tag(&apdu[apdu_len + len],
+                TIME_STAMP_DATETIME);
+            apdu_len += len;
+        }
+    } else if (rpdata->array_index <= MAX_BACNET_EVENT_TRANSITION) {
+        /* array elements are numbered from one */
+        i = rpdata->array_index - 1;
+        apdu_len = encode_opening_tag(&apdu[apdu_len], TIME_STAMP_DATETIME);
+        apdu_len +=
+            encode_application_date(&apdu[apdu_len],
+            &CurrentObject->Event_Time_Stamps[i].date);
+        apdu_len +=
+            encode_application_time(&apdu[apdu_len],
+            &CurrentObject->Event_Time_Stamps[i].time);
+        apdu_len += encode_closing_tag(&apdu[apdu_len], TIME_STAMP_DATETIME);
+    } else {
         rpdata->error_class = ERROR_CLASS_PROPERTY;
-        rpdata->error_code = ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY;
+        rpdata->error_code = ERROR_CODE_INVALID_ARRAY_INDEX;
         apdu_len = BACNET_STATUS_ERROR;
     }
 
     return apdu_len;
 }
+#endif
+
+/* test case for real encoding-decoding real value correctly */
+static int Analog_Input_Read_Test_Real(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0], 90.510F);
+}
+
+/* test case for unsigned encoding-decoding unsigned value correctly */
+static int Analog_Input_Read_Test_Unsigned(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0], 90);
+}
+
+/* test case for signed encoding-decoding negative value correctly */
+static int Analog_Input_Read_Test_Signed(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_signed(&rpdata->application_data[0], -200);
+}
+
+/* The Analog Input properties, as ReadPropertyMultiple lists them */
+static const struct property_descr_t Analog_Input_Property_Descr[] = {
+    {PROP_OBJECT_IDENTIFIER, PROPERTY_REQUIRED,
+        Analog_Input_Read_Object_Identifier},
+    {PROP_OBJECT_NAME, PROPERTY_REQUIRED, Analog_Input_Read_Object_Name},
+    {PROP_OBJECT_TYPE, PROPERTY_REQUIRED, Analog_Input_Read_Object_Type},
+    {PROP_PRESENT_VALUE, PROPERTY_REQUIRED, Analog_Input_Read_Present_Value},
+    {PROP_STATUS_FLAGS, PROPERTY_REQUIRED, Analog_Input_Read_Status_Flags},
+    {PROP_EVENT_STATE, PROPERTY_REQUIRED, Analog_Input_Read_Event_State},
+    {PROP_OUT_OF_SERVICE, PROPERTY_REQUIRED, Analog_Input_Read_Out_Of_Service},
+    {PROP_UNITS, PROPERTY_REQUIRED, Analog_Input_Read_Units},
+    {PROP_DESCRIPTION, PROPERTY_OPTIONAL, Analog_Input_Read_Object_Name},
+    {PROP_RELIABILITY, PROPERTY_OPTIONAL, Analog_Input_Read_Reliability},
+    {PROP_COV_INCREMENT, PROPERTY_OPTIONAL, Analog_Input_Read_COV_Increment},
+#if defined(INTRINSIC_REPORTING)
+    {PROP_TIME_DELAY, PROPERTY_OPTIONAL, Analog_Input_Read_Time_Delay},
+    {PROP_NOTIFICATION_CLASS, PROPERTY_OPTIONAL,
+        Analog_Input_Read_Notification_Class},
+    {PROP_HIGH_LIMIT, PROPERTY_OPTIONAL, Analog_Input_Read_High_Limit},
+    {PROP_LOW_LIMIT, PROPERTY_OPTIONAL, Analog_Input_Read_Low_Limit},
+    {PROP_DEADBAND, PROPERTY_OPTIONAL, Analog_Input_Read_Deadband},
+    {PROP_LIMIT_ENABLE, PROPERTY_OPTIONAL, Analog_Input_Read_Limit_Enable},
+    {PROP_EVENT_ENABLE, PROPERTY_OPTIONAL, Analog_Input_Read_Event_Enable},
+    {PROP_ACKED_TRANSITIONS, PROPERTY_OPTIONAL,
+        Analog_Input_Read_Acked_Transitions},
+    {PROP_NOTIFY_TYPE, PROPERTY_OPTIONAL, Analog_Input_Read_Notify_Type},
+    {PROP_EVENT_TIME_STAMPS, PROPERTY_OPTIONAL | PROPERTY_ARRAY,
+        Analog_Input_Read_Event_Time_Stamps},
+#endif
+    {(BACNET_PROPERTY_ID) 9997, PROPERTY_PROPRIETARY,
+        Analog_Input_Read_Test_Real},
+    {(BACNET_PROPERTY_ID) 9998, PROPERTY_PROPRIETARY,
+        Analog_Input_Read_Test_Unsigned},
+    {(BACNET_PROPERTY_ID) 9999, PROPERTY_PROPRIETARY,
+        Analog_Input_Read_Test_Signed},
+};
+
+static const struct property_table_t Analog_Input_Properties =
+    PROPERTY_TABLE(Analog_Input_Property_Descr);
+
+/* These three arrays are used by the ReadPropertyMultiple handler,
+   and are filled from the property table on first use */
+#define AI_PROPERTY_COUNT \
+    (sizeof(Analog_Input_Property_Descr) / sizeof(Analog_Input_Property_Descr[0]))
+static int Analog_Input_Properties_Required[AI_PROPERTY_COUNT + 1];
+static int Analog_Input_Properties_Optional[AI_PROPERTY_COUNT + 1];
+static int Analog_Input_Properties_Proprietary[AI_PROPERTY_COUNT + 1];
+static bool Analog_Input_Properties_Valid;
+
+void Analog_Input_Property_Lists(
+    const int **pRequired,
+    const int **pOptional,
+    const int **pProprietary)
+{
+    if (!Analog_Input_Properties_Valid) {
+        property_table_lists(&Analog_Input_Properties,
+            Analog_Input_Properties_Required, Analog_Input_Properties_Optional,
+            Analog_Input_Properties_Proprietary);
+        Analog_Input_Properties_Valid = true;
+    }
+    if (pRequired)
+        *pRequired = Analog_Input_Properties_Required;
+    if (pOptional)
+        *pOptional = Analog_Input_Properties_Optional;
+    if (pProprietary)
+        *pProprietary = Analog_Input_Properties_Proprietary;
+
+    return;
+}
+
+const struct property_table_t *Analog_Input_Property_Table(
+    void)
+{
+    return &Analog_Input_Properties;
+}
+
+/* return apdu len, or BACNET_STATUS_ERROR on error */
+int Analog_Input_Read_Property(
+    BACNET_READ_PROPERTY_DATA * rpdata)
+{
+    unsigned object_index = 0;
+
+    if ((rpdata == NULL) || (rpdata->application_data == NULL) ||
+        (rpdata->application_data_len == 0)) {
+        return 0;
+    }
+
+    object_index = Analog_Input_Instance_To_Index(rpdata->object_instance);
+    if (object_index >= objinst_count(&AI_Instances))
+        return BACNET_STATUS_ERROR;
+
+    return property_table_read(&Analog_Input_Properties, rpdata, object_index);
+}
 
 /* returns true if successful */
 bool Analog_Input_Write_Property(
@@ -671,7 +862,7 @@ bool Analog_Input_Write_Property(
         return false;
     }
     object_index = Analog_Input_Instance_To_Index(wp_data->object_instance);
-    if (object_index < MAX_ANALOG_INPUTS) {
+    if (object_index < objinst_count(&AI_Instances)) {
         CurrentAI = &AI_Descr[object_index];
     } else {
         return false;
@@ -684,7 +875,7 @@ bool Analog_Input_Write_Property(
                 &wp_data->error_class, &wp_data->error_code);
 
             if (status) {
-                if (CurrentAI->Out_Of_Service == true) {
+                if (AI_Out_Of_Service[object_index] == true) {
                     Analog_Input_Present_Value_Set(wp_data->object_instance,
                         value.type.Real);
                 } else {
@@ -881,7 +1072,7 @@ void Analog_Input_Intrinsic_Reporting(
 
 
     object_index = Analog_Input_Instance_To_Index(object_instance);
-    if (object_index < MAX_ANALOG_INPUTS)
+    if (object_index < objinst_count(&AI_Instances))
         CurrentAI = &AI_Descr[object_index];
     else
         return;
@@ -1118,7 +1309,7 @@ void Analog_Input_Intrinsic_Reporting(
                 statusFlags, STATUS_FLAG_OVERRIDDEN, false);
             bitstring_set_bit(&event_data.notificationParams.outOfRange.
                 statusFlags, STATUS_FLAG_OUT_OF_SERVICE,
-                CurrentAI->Out_Of_Service);
+                AI_Out_Of_Service[object_index]);
             /* Deadband used for limit checking. */
             event_data.notificationParams.outOfRange.deadband =
                 CurrentAI->Deadband;
@@ -1174,7 +1365,7 @@ int Analog_Input_Event_Information(
 
 
     /* check index */
-    if (index < MAX_ANALOG_INPUTS) {
+    if (index < objinst_count(&AI_Instances)) {
         /* Event_State not equal to NORMAL */
         IsActiveEvent = (AI_Descr[index].Event_State != EVENT_STATE_NORMAL);
 
@@ -1250,7 +1441,7 @@ int Analog_Input_Alarm_Ack(
         Analog_Input_Instance_To_Index(alarmack_data->eventObjectIdentifier.
         instance);
 
-    if (object_index < MAX_ANALOG_INPUTS)
+    if (object_index < objinst_count(&AI_Instances))
         CurrentAI = &AI_Descr[object_index];
     else {
         *error_code = ERROR_CODE_UNKNOWN_OBJECT;
@@ -1344,7 +1535,7 @@ int Analog_Input_Alarm_Summary(
 {
 
     /* check index */
-    if (index < MAX_ANALOG_INPUTS) {
+    if (index < objinst_count(&AI_Instances)) {
         /* Event_State is not equal to NORMAL  and
            Notify_Type property value is ALARM */
         if ((AI_Descr[index].Event_State != EVENT_STATE_NORMAL) &&
@@ -1431,6 +1622,17 @@ void testAnalogInput(
     len = decode_object_id(&apdu[len], &decoded_type, &decoded_instance);
     ct_test(pTest, decoded_type == rpdata.object_type);
     ct_test(pTest, decoded_instance == rpdata.object_instance);
+    /* objects come and go; the others keep their values */
+    ct_test(pTest, Analog_Input_Count() == ANALOG_INPUT_INIT_COUNT);
+    ct_test(pTest, Analog_Input_Create(1000));
+    ct_test(pTest, Analog_Input_Count() == (ANALOG_INPUT_INIT_COUNT + 1));
+    Analog_Input_Present_Value_Set(1000, 42.0f);
+    ct_test(pTest, Analog_Input_Delete(0));
+    ct_test(pTest, !Analog_Input_Valid_Instance(0));
+    ct_test(pTest, Analog_Input_Present_Value(1000) == 42.0f);
+    ct_test(pTest, Analog_Input_Index_To_Instance(0) == 1000);
+    Analog_Input_Cleanup();
+    ct_test(pTest, Analog_Input_Count() == 0);
 
     return;
 }
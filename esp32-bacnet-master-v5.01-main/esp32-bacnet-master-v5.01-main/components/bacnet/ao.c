@@ -28,6 +28,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "bacdef.h"
 #include "bacdcode.h"
 #include "bacenum.h"
@@ -35,10 +37,17 @@
 #include "config.h"     /* the custom stuff */
 #include "wp.h"
 #include "ao.h"
+#include "device.h"
 #include "handlers.h"
+#include "objinst.h"
 
+/* the most Analog Output objects that can be created */
 #ifndef MAX_ANALOG_OUTPUTS
-#define MAX_ANALOG_OUTPUTS 4
+#define MAX_ANALOG_OUTPUTS 1024
+#endif
+/* the Analog Output objects created by Analog_Output_Init(), 0..n-1 */
+#ifndef ANALOG_OUTPUT_INIT_COUNT
+#define ANALOG_OUTPUT_INIT_COUNT 4
 #endif
 
 /* we choose to have a NULL level in our system represented by */
@@ -48,13 +57,16 @@
 /* When all the priorities are level null, the present value returns */
 /* the Relinquish Default value */
 #define AO_RELINQUISH_DEFAULT 0
+/* largest encoding of one Priority_Array element, a REAL */
+#define AO_PRIORITY_ELEMENT_MAX 5
+static OBJINST_TABLE AO_Instances;
 /* Here is our Priority Array.  They are supposed to be Real, but */
 /* we don't have that kind of memory, so we will use a single byte */
 /* and load a Real for returning the value when asked. */
-static uint8_t Analog_Output_Level[MAX_ANALOG_OUTPUTS][BACNET_MAX_PRIORITY];
+static uint8_t(*Analog_Output_Level)[BACNET_MAX_PRIORITY];
 /* Writable out-of-service allows others to play with our Present Value */
 /* without changing the physical output */
-static bool Out_Of_Service[MAX_ANALOG_OUTPUTS];
+static bool *Out_Of_Service;
 
 /* we need to have our arrays initialized before answering any calls */
 static bool Analog_Output_Initialized = false;
@@ -97,66 +109,136 @@ void Analog_Output_Property_Lists(
     return;
 }
 
-void Analog_Output_Init(
-    void)
+static bool Analog_Output_Resize(
+    unsigned size)
 {
-    unsigned i, j;
+    void *data;
 
-    if (!Analog_Output_Initialized) {
-        Analog_Output_Initialized = true;
-
-        /* initialize all the analog output priority arrays to NULL */
-        for (i = 0; i < MAX_ANALOG_OUTPUTS; i++) {
-            for (j = 0; j < BACNET_MAX_PRIORITY; j++) {
-                Analog_Output_Level[i][j] = AO_LEVEL_NULL;
-            }
-        }
+    data =
+        objinst_realloc(Analog_Output_Level,
+        size * sizeof(Analog_Output_Level[0]));
+    if (!data) {
+        return false;
+    }
+    Analog_Output_Level = data;
+    data = objinst_realloc(Out_Of_Service, size * sizeof(bool));
+    if (!data) {
+        return false;
     }
+    Out_Of_Service = data;
 
-    return;
+    return true;
+}
+
+static void Analog_Output_Move(
+    unsigned to,
+    unsigned from)
+{
+    memcpy(Analog_Output_Level[to], Analog_Output_Level[from],
+        sizeof(Analog_Output_Level[0]));
+    Out_Of_Service[to] = Out_Of_Service[from];
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need validate that the */
-/* given instance exists */
 bool Analog_Output_Valid_Instance(
     uint32_t object_instance)
 {
-    if (object_instance < MAX_ANALOG_OUTPUTS)
-        return true;
-
-    return false;
+    return objinst_valid_instance(&AO_Instances, object_instance);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then count how many you have */
 unsigned Analog_Output_Count(
     void)
 {
-    return MAX_ANALOG_OUTPUTS;
+    return objinst_count(&AO_Instances);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the instance */
-/* that correlates to the correct index */
 uint32_t Analog_Output_Index_To_Instance(
     unsigned index)
 {
-    return index;
+    return objinst_index_to_instance(&AO_Instances, index);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the index */
-/* that correlates to the correct instance number */
+/* returns an index not less than the count if there is no such object */
 unsigned Analog_Output_Instance_To_Index(
     uint32_t object_instance)
 {
-    unsigned index = MAX_ANALOG_OUTPUTS;
+    return objinst_instance_to_index(&AO_Instances, object_instance);
+}
+
+/**
+ * Creates an Analog Output object with its priority array all NULL.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was created or exists already
+ */
+bool Analog_Output_Create(
+    uint32_t object_instance)
+{
+    unsigned i, j;
 
-    if (object_instance < MAX_ANALOG_OUTPUTS)
-        index = object_instance;
+    if (Analog_Output_Valid_Instance(object_instance)) {
+        return true;
+    }
+    i = objinst_add(&AO_Instances, object_instance);
+    if (i >= objinst_count(&AO_Instances)) {
+        return false;
+    }
+    for (j = 0; j < BACNET_MAX_PRIORITY; j++) {
+        Analog_Output_Level[i][j] = AO_LEVEL_NULL;
+    }
+    Out_Of_Service[i] = false;
+    Device_Inc_Database_Revision();
 
-    return index;
+    return true;
+}
+
+/**
+ * Deletes an Analog Output object.  The last object takes its index.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was deleted
+ */
+bool Analog_Output_Delete(
+    uint32_t object_instance)
+{
+    if (!objinst_remove(&AO_Instances, object_instance)) {
+        return false;
+    }
+    Device_Inc_Database_Revision();
+
+    return true;
+}
+
+/**
+ * Deletes all the Analog Output objects and frees their memory.
+ */
+void Analog_Output_Cleanup(
+    void)
+{
+    objinst_cleanup(&AO_Instances);
+    free(Analog_Output_Level);
+    free(Out_Of_Service);
+    Analog_Output_Level = NULL;
+    Out_Of_Service = NULL;
+}
+
+void Analog_Output_Init(
+    void)
+{
+    uint32_t instance;
+
+    if (!Analog_Output_Initialized) {
+        Analog_Output_Initialized = true;
+
+        objinst_init(&AO_Instances, MAX_ANALOG_OUTPUTS, Analog_Output_Resize,
+            Analog_Output_Move);
+        for (instance = 0; instance < ANALOG_OUTPUT_INIT_COUNT; instance++) {
+            Analog_Output_Create(instance);
+        }
+    }
+
+    return;
 }
 
 float Analog_Output_Present_Value(
@@ -167,7 +249,7 @@ float Analog_Output_Present_Value(
     unsigned i = 0;
 
     index = Analog_Output_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < objinst_count(&AO_Instances)) {
         for (i = 0; i < BACNET_MAX_PRIORITY; i++) {
             if (Analog_Output_Level[index][i] != AO_LEVEL_NULL) {
                 value = Analog_Output_Level[index][i];
@@ -187,7 +269,7 @@ unsigned Analog_Output_Present_Value_Priority(
     unsigned priority = 0;      /* return value */
 
     index = Analog_Output_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < objinst_count(&AO_Instances)) {
         for (i = 0; i < BACNET_MAX_PRIORITY; i++) {
             if (Analog_Output_Level[index][i] != AO_LEVEL_NULL) {
                 priority = i + 1;
@@ -208,7 +290,7 @@ bool Analog_Output_Present_Value_Set(
     bool status = false;
 
     index = Analog_Output_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < objinst_count(&AO_Instances)) {
         if (priority && (priority <= BACNET_MAX_PRIORITY) &&
             (priority != 6 /* reserved */ ) &&
             (value >= 0.0) && (value <= 100.0)) {
@@ -234,7 +316,7 @@ bool Analog_Output_Present_Value_Relinquish(
     bool status = false;
 
     index = Analog_Output_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < objinst_count(&AO_Instances)) {
         if (priority && (priority <= BACNET_MAX_PRIORITY) &&
             (priority != 6 /* reserved */ )) {
             Analog_Output_Level[index][priority - 1] = AO_LEVEL_NULL;
@@ -256,10 +338,10 @@ bool Analog_Output_Object_Name(
     uint32_t object_instance,
     BACNET_CHARACTER_STRING * object_name)
 {
-    static char text_string[32] = "";   /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
-    if (object_instance < MAX_ANALOG_OUTPUTS) {
+    if (Analog_Output_Valid_Instance(object_instance)) {
         sprintf(text_string, "ANALOG OUTPUT %lu",
             (unsigned long) object_instance);
         status = characterstring_init_ansi(object_name, text_string);
@@ -275,7 +357,7 @@ bool Analog_Output_Out_Of_Service(
     bool oos_flag = false;
 
     index = Analog_Output_Instance_To_Index(instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < objinst_count(&AO_Instances)) {
         oos_flag = Out_Of_Service[index];
     }
 
@@ -289,7 +371,7 @@ void Analog_Output_Out_Of_Service_Set(
     unsigned index = 0;
 
     index = Analog_Output_Instance_To_Index(instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < objinst_count(&AO_Instances)) {
         Out_Of_Service[index] = oos_flag;
     }
 }
@@ -364,7 +446,14 @@ int Analog_Output_Read_Property(
                 object_index =
                     Analog_Output_Instance_To_Index(rpdata->object_instance);
                 for (i = 0; i < BACNET_MAX_PRIORITY; i++) {
-                    /* FIXME: check if we have room before adding it to APDU */
+                    /* check if we have room before adding it to APDU */
+                    if ((apdu_len + AO_PRIORITY_ELEMENT_MAX) >
+                        rpdata->application_data_len) {
+                        rpdata->error_code =
+                            ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
+                        apdu_len = BACNET_STATUS_ABORT;
+                        break;
+                    }
                     if (Analog_Output_Level[object_index][i] == AO_LEVEL_NULL)
                         len = encode_application_null(&apdu[apdu_len]);
                     else {
@@ -373,15 +462,7 @@ int Analog_Output_Read_Property(
                             encode_application_real(&apdu[apdu_len],
                             real_value);
                     }
-                    /* add it if we have room */
-                    if ((apdu_len + len) < MAX_APDU)
-                        apdu_len += len;
-                    else {
-                        rpdata->error_code =
-                            ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
-                        apdu_len = BACNET_STATUS_ABORT;
-                        break;
-                    }
+                    apdu_len += len;
                 }
             } else {
                 object_index =
@@ -42,6 +42,14 @@
 #include "tsm.h"
 #include "dcc.h"
 #include "iam.h"
+#if APDU_STATISTICS
+#include <string.h>
+#if defined(ESP_PLATFORM)
+#include "esp_timer.h"
+#else
+#include <sys/time.h>
+#endif
+#endif
 
 /** @file apdu.c  Handles APDU services */
 
@@ -56,6 +64,10 @@ extern int Routed_Device_Service_Approval(
 static uint16_t Timeout_Milliseconds = 3000;
 /* Number of APDU Retries */
 static uint8_t Number_Of_Retries = 3;
+#if BACNET_SEGMENTATION_ENABLED
+/* APDU Segment Timeout in Milliseconds */
+static uint16_t Segment_Timeout_Milliseconds = 2000;
+#endif
 
 /* a simple table for crossing the services supported */
 static BACNET_SERVICES_SUPPORTED
@@ -313,6 +325,13 @@ void apdu_set_abort_handler(
     Abort_Function = pFunction;
 }
 
+/* the Abort handler set, so that a new one can pass on what is not its */
+abort_function apdu_get_abort_handler(
+    void)
+{
+    return Abort_Function;
+}
+
 static reject_function Reject_Function;
 
 void apdu_set_reject_handler(
@@ -321,6 +340,13 @@ void apdu_set_reject_handler(
     Reject_Function = pFunction;
 }
 
+/* the Reject handler set, so that a new one can pass on what is not its */
+reject_function apdu_get_reject_handler(
+    void)
+{
+    return Reject_Function;
+}
+
 uint16_t apdu_decode_confirmed_service_request(
     uint8_t * apdu,     /* APDU data */
     uint16_t apdu_len,
@@ -374,6 +400,20 @@ void apdu_retries_set(
     Number_Of_Retries = value;
 }
 
+#if BACNET_SEGMENTATION_ENABLED
+uint16_t apdu_segment_timeout(
+    void)
+{
+    return Segment_Timeout_Milliseconds;
+}
+
+void apdu_segment_timeout_set(
+    uint16_t milliseconds)
+{
+    Segment_Timeout_Milliseconds = milliseconds;
+}
+#endif
+
 
 /* When network communications are completely disabled,
    only DeviceCommunicationControl and ReinitializeDevice APDUs
@@ -430,6 +470,237 @@ static bool apdu_unconfirmed_dcc_disabled(
     return status;
 }
 
+#if APDU_STATISTICS
+/* counters of each service; the extra last entry of each kind
+   counts the service choices beyond the ones we know */
+static BACNET_APDU_SERVICE_STATISTICS
+    Confirmed_Statistics[MAX_BACNET_CONFIRMED_SERVICE + 1];
+static BACNET_APDU_SERVICE_STATISTICS
+    Unconfirmed_Statistics[MAX_BACNET_UNCONFIRMED_SERVICE + 1];
+/* the service being dispatched - the rejects and aborts that its
+   handler sends are counted to it.  Those sent outside of a dispatch,
+   by the TSM for instance, count to the unknown confirmed service. */
+static BACNET_APDU_SERVICE_STATISTICS *Statistics_Current;
+
+static BACNET_APDU_SERVICE_STATISTICS *apdu_statistics_entry(
+    bool confirmed,
+    uint8_t service_choice)
+{
+    if (confirmed) {
+        if (service_choice > MAX_BACNET_CONFIRMED_SERVICE)
+            service_choice = MAX_BACNET_CONFIRMED_SERVICE;
+        return &Confirmed_Statistics[service_choice];
+    }
+    if (service_choice > MAX_BACNET_UNCONFIRMED_SERVICE)
+        service_choice = MAX_BACNET_UNCONFIRMED_SERVICE;
+    return &Unconfirmed_Statistics[service_choice];
+}
+
+/* free running microsecond time, for timing the handlers */
+static uint64_t apdu_statistics_time(
+    void)
+{
+#if defined(ESP_PLATFORM)
+    return (uint64_t) esp_timer_get_time();
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((uint64_t) tv.tv_sec * 1000000) + (uint64_t) tv.tv_usec;
+#endif
+}
+
+/* counts a request that is about to be given to its handler,
+   and returns the time it starts */
+static uint64_t apdu_statistics_request(
+    bool confirmed,
+    uint8_t service_choice)
+{
+    Statistics_Current = apdu_statistics_entry(confirmed, service_choice);
+    Statistics_Current->requests++;
+
+    return apdu_statistics_time();
+}
+
+/* adds the time the handler took to the histogram */
+static void apdu_statistics_done(
+    uint64_t start)
+{
+    BACNET_APDU_SERVICE_STATISTICS *stats = Statistics_Current;
+    uint32_t elapsed = 0;
+    uint32_t limit = 64;
+    unsigned bucket = 0;
+
+    elapsed = (uint32_t) (apdu_statistics_time() - start);
+    while ((bucket < (APDU_STATISTICS_BUCKETS - 1)) && (elapsed >= limit)) {
+        bucket++;
+        limit <<= 2;
+    }
+    stats->time_histogram[bucket]++;
+    stats->time_total += elapsed;
+    if (elapsed > stats->time_max)
+        stats->time_max = elapsed;
+    Statistics_Current = NULL;
+}
+
+static void apdu_statistics_dcc_drop(
+    bool confirmed,
+    uint8_t service_choice)
+{
+    apdu_statistics_entry(confirmed, service_choice)->dcc_drops++;
+}
+
+/** Counts a Reject sent in reply to the service being dispatched.
+ *  Called by reject_encode_apdu().
+ */
+void apdu_statistics_reject(
+    void)
+{
+    if (Statistics_Current)
+        Statistics_Current->rejects++;
+    else
+        Confirmed_Statistics[MAX_BACNET_CONFIRMED_SERVICE].rejects++;
+}
+
+/** Counts an Abort sent in reply to the service being dispatched.
+ *  Called by abort_encode_apdu().
+ */
+void apdu_statistics_abort(
+    void)
+{
+    if (Statistics_Current)
+        Statistics_Current->aborts++;
+    else
+        Confirmed_Statistics[MAX_BACNET_CONFIRMED_SERVICE].aborts++;
+}
+
+/** Gets the counters of one service.
+ *
+ * @param confirmed [in] true for a confirmed service, false for unconfirmed
+ * @param service_choice [in] the SERVICE_CONFIRMED_ or SERVICE_UNCONFIRMED_
+ *        value, or APDU_STATISTICS_OTHER for the unknown services
+ * @return the counters of the service
+ */
+const BACNET_APDU_SERVICE_STATISTICS *apdu_statistics(
+    bool confirmed,
+    uint8_t service_choice)
+{
+    return apdu_statistics_entry(confirmed, service_choice);
+}
+
+/** Clears the counters of all the services. */
+void apdu_statistics_reset(
+    void)
+{
+    memset(Confirmed_Statistics, 0, sizeof(Confirmed_Statistics));
+    memset(Unconfirmed_Statistics, 0, sizeof(Unconfirmed_Statistics));
+}
+
+static bool apdu_statistics_used(
+    const BACNET_APDU_SERVICE_STATISTICS * stats)
+{
+    return (stats->requests || stats->dcc_drops || stats->rejects ||
+        stats->aborts);
+}
+
+/* finds the index'th service (1..N) that has been counted */
+static BACNET_APDU_SERVICE_STATISTICS *apdu_statistics_find(
+    unsigned index,
+    bool * confirmed,
+    uint8_t * service_choice)
+{
+    unsigned count = 0;
+    unsigned i = 0;
+
+    for (i = 0; i <= MAX_BACNET_CONFIRMED_SERVICE; i++) {
+        if (apdu_statistics_used(&Confirmed_Statistics[i]) &&
+            (++count == index)) {
+            *confirmed = true;
+            *service_choice = (i == MAX_BACNET_CONFIRMED_SERVICE) ?
+                APDU_STATISTICS_OTHER : (uint8_t) i;
+            return &Confirmed_Statistics[i];
+        }
+    }
+    for (i = 0; i <= MAX_BACNET_UNCONFIRMED_SERVICE; i++) {
+        if (apdu_statistics_used(&Unconfirmed_Statistics[i]) &&
+            (++count == index)) {
+            *confirmed = false;
+            *service_choice = (i == MAX_BACNET_UNCONFIRMED_SERVICE) ?
+                APDU_STATISTICS_OTHER : (uint8_t) i;
+            return &Unconfirmed_Statistics[i];
+        }
+    }
+
+    return NULL;
+}
+
+/** Counts the services that have been seen since the last reset.
+ *
+ * @return the number of elements of the statistics property
+ */
+unsigned apdu_statistics_count(
+    void)
+{
+    unsigned count = 0;
+    unsigned i = 0;
+
+    for (i = 0; i <= MAX_BACNET_CONFIRMED_SERVICE; i++) {
+        if (apdu_statistics_used(&Confirmed_Statistics[i]))
+            count++;
+    }
+    for (i = 0; i <= MAX_BACNET_UNCONFIRMED_SERVICE; i++) {
+        if (apdu_statistics_used(&Unconfirmed_Statistics[i]))
+            count++;
+    }
+
+    return count;
+}
+
+/** Encodes the counters of one of the services that have been seen,
+ *  as application tagged unsigned values, in this order:
+ *  PDU type (0=confirmed, 1=unconfirmed), service choice, requests,
+ *  DCC drops, rejects, aborts, longest handler time in microseconds,
+ *  total handler time in milliseconds and the APDU_STATISTICS_BUCKETS
+ *  counts of the handler time histogram.
+ *
+ * @param apdu [out] buffer for the values, at least
+ *        APDU_STATISTICS_ELEMENT_MAX bytes
+ * @param index [in] 1..apdu_statistics_count()
+ * @return the number of bytes encoded, or 0 if there is no such service
+ */
+int apdu_statistics_encode(
+    uint8_t * apdu,
+    unsigned index)
+{
+    BACNET_APDU_SERVICE_STATISTICS *stats = NULL;
+    bool confirmed = false;
+    uint8_t service_choice = 0;
+    int len = 0;
+    unsigned i = 0;
+
+    stats = apdu_statistics_find(index, &confirmed, &service_choice);
+    if (!stats)
+        return 0;
+    len += encode_application_unsigned(&apdu[len], confirmed ? 0 : 1);
+    len += encode_application_unsigned(&apdu[len], service_choice);
+    len += encode_application_unsigned(&apdu[len], stats->requests);
+    len += encode_application_unsigned(&apdu[len], stats->dcc_drops);
+    len += encode_application_unsigned(&apdu[len], stats->rejects);
+    len += encode_application_unsigned(&apdu[len], stats->aborts);
+    len += encode_application_unsigned(&apdu[len], stats->time_max);
+    len +=
+        encode_application_unsigned(&apdu[len],
+        (uint32_t) (stats->time_total / 1000));
+    for (i = 0; i < APDU_STATISTICS_BUCKETS; i++) {
+        len +=
+            encode_application_unsigned(&apdu[len],
+            stats->time_histogram[i]);
+    }
+
+    return len;
+}
+#endif
+
 /** Process the APDU header and invoke the appropriate service handler
  * to manage the received request.
  * Almost all requests and ACKs invoke this function.
@@ -457,6 +728,12 @@ void apdu_handler(
     uint32_t error_class = 0;
     uint8_t reason = 0;
     bool server = false;
+#if BACNET_SEGMENTATION_ENABLED
+    uint32_t segmented_len = 0;
+#endif
+#if APDU_STATISTICS
+    uint64_t start_time = 0;
+#endif
 
     if (apdu) {
         /* PDU Type */
@@ -469,8 +746,29 @@ void apdu_handler(
                     /* When network communications are completely disabled,
                        only DeviceCommunicationControl and ReinitializeDevice APDUs
                        shall be processed and no messages shall be initiated. */
+#if APDU_STATISTICS
+                    apdu_statistics_dcc_drop(true, service_choice);
+#endif
                     break;
                 }
+#if BACNET_SEGMENTATION_ENABLED
+                if (service_data.segmented_message) {
+                    /* collect the segments - the handler only
+                       gets to see the whole request */
+                    if (!tsm_segmented_request_received(src, &service_data,
+                            service_choice, service_request,
+                            service_request_len, &service_request,
+                            &segmented_len)) {
+                        break;
+                    }
+                    service_request_len = (uint16_t) segmented_len;
+                    service_data.segmented_message = false;
+                    service_data.more_follows = false;
+                }
+#endif
+#if APDU_STATISTICS
+                start_time = apdu_statistics_request(true, service_choice);
+#endif
                 if ((service_choice < MAX_BACNET_CONFIRMED_SERVICE) &&
                     (Confirmed_Function[service_choice]))
                     Confirmed_Function[service_choice] (service_request,
@@ -478,6 +776,12 @@ void apdu_handler(
                 else if (Unrecognized_Service_Handler)
                     Unrecognized_Service_Handler(service_request,
                         service_request_len, src, &service_data);
+#if APDU_STATISTICS
+                apdu_statistics_done(start_time);
+#endif
+#if BACNET_SEGMENTATION_ENABLED
+                tsm_segmented_request_done(src, service_data.invoke_id);
+#endif
                 break;
             case PDU_TYPE_UNCONFIRMED_SERVICE_REQUEST:
                 service_choice = apdu[1];
@@ -489,13 +793,22 @@ void apdu_handler(
                        shall be processed and no messages shall be initiated.
                        If communications have been initiation disabled, then
                        WhoIs may be processed. */
+#if APDU_STATISTICS
+                    apdu_statistics_dcc_drop(false, service_choice);
+#endif
                     break;
                 }
+#if APDU_STATISTICS
+                start_time = apdu_statistics_request(false, service_choice);
+#endif
                 if (service_choice < MAX_BACNET_UNCONFIRMED_SERVICE) {
                     if (Unconfirmed_Function[service_choice])
                         Unconfirmed_Function[service_choice] (service_request,
                             service_request_len, src);
                 }
+#if APDU_STATISTICS
+                apdu_statistics_done(start_time);
+#endif
                 break;
             case PDU_TYPE_SIMPLE_ACK:
                 invoke_id = apdu[1];
@@ -546,6 +859,19 @@ void apdu_handler(
                 service_choice = apdu[len++];
                 service_request = &apdu[len];
                 service_request_len = apdu_len - (uint16_t) len;
+#if BACNET_SEGMENTATION_ENABLED
+                if (service_ack_data.segmented_message) {
+                    if (!tsm_segmented_complexack_received(src,
+                            &service_ack_data, service_choice,
+                            service_request, service_request_len,
+                            &service_request, &segmented_len)) {
+                        break;
+                    }
+                    service_request_len = (uint16_t) segmented_len;
+                    service_ack_data.segmented_message = false;
+                    service_ack_data.more_follows = false;
+                }
+#endif
                 switch (service_choice) {
                     case SERVICE_CONFIRMED_GET_ALARM_SUMMARY:
                     case SERVICE_CONFIRMED_GET_ENROLLMENT_SUMMARY:
@@ -577,9 +903,14 @@ void apdu_handler(
                 }
                 break;
             case PDU_TYPE_SEGMENT_ACK:
-                /* FIXME: what about a denial of service attack here?
-                   we could check src to see if that matched the tsm */
-                tsm_free_invoke_id(invoke_id);
+#if BACNET_SEGMENTATION_ENABLED
+                /* we only send segmented ComplexACKs, so only
+                   a client should be acknowledging segments */
+                if ((apdu_len >= 4) && !(apdu[0] & BAC_BIT(0))) {
+                    tsm_segmentack_received(src, apdu[1], apdu[2], apdu[3],
+                        (apdu[0] & BAC_BIT(1)) != 0);
+                }
+#endif
                 break;
             case PDU_TYPE_ERROR:
                 invoke_id = apdu[1];
@@ -633,6 +964,13 @@ void apdu_handler(
                 reason = apdu[2];
                 if (Abort_Function)
                     Abort_Function(src, invoke_id, reason, server);
+#if BACNET_SEGMENTATION_ENABLED
+                if (!server) {
+                    /* a client gave up on one of our transactions */
+                    tsm_abort_received(src, invoke_id);
+                    break;
+                }
+#endif
                 tsm_free_invoke_id(invoke_id);
                 break;
             default:
@@ -29,6 +29,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "bacdef.h"
@@ -40,139 +41,234 @@
 #include "device.h"
 #include "handlers.h"
 #include "av.h"
+#include "objinst.h"
 
 
+/* the most Analog Value objects that can be created */
 #ifndef MAX_ANALOG_VALUES
-#define MAX_ANALOG_VALUES 4
+#define MAX_ANALOG_VALUES 1024
 #endif
+/* the Analog Value objects created by Analog_Value_Init(), 0..n-1 */
+#ifndef ANALOG_VALUE_INIT_COUNT
+#define ANALOG_VALUE_INIT_COUNT 4
+#endif
+/* encoding of one Event_Time_Stamps element, a tagged date and time */
+#define AV_TIME_STAMP_ELEMENT_MAX 12
+
+static OBJINST_TABLE AV_Instances;
+/* the properties used on every COV check, one array each */
+static float *AV_Present_Value;
+static float *AV_Prior_Value;
+static float *AV_COV_Increment;
+static bool *AV_Out_Of_Service;
+static bool *AV_Changed;
+/* everything else */
+static ANALOG_VALUE_DESCR *AV_Descr;
+
+static bool Analog_Value_Resize(
+    unsigned size)
+{
+    void *data;
 
-ANALOG_VALUE_DESCR AV_Descr[MAX_ANALOG_VALUES];
-
-/* These three arrays are used by the ReadPropertyMultiple handler */
-static const int Analog_Value_Properties_Required[] = {
-    PROP_OBJECT_IDENTIFIER,
-    PROP_OBJECT_NAME,
-    PROP_OBJECT_TYPE,
-    PROP_PRESENT_VALUE,
-    PROP_STATUS_FLAGS,
-    PROP_EVENT_STATE,
-    PROP_OUT_OF_SERVICE,
-    PROP_UNITS,
-    -1
-};
+    data = objinst_realloc(AV_Present_Value, size * sizeof(float));
+    if (!data) {
+        return false;
+    }
+    AV_Present_Value = data;
+    data = objinst_realloc(AV_Prior_Value, size * sizeof(float));
+    if (!data) {
+        return false;
+    }
+    AV_Prior_Value = data;
+    data = objinst_realloc(AV_COV_Increment, size * sizeof(float));
+    if (!data) {
+        return false;
+    }
+    AV_COV_Increment = data;
+    data = objinst_realloc(AV_Out_Of_Service, size * sizeof(bool));
+    if (!data) {
+        return false;
+    }
+    AV_Out_Of_Service = data;
+    data = objinst_realloc(AV_Changed, size * sizeof(bool));
+    if (!data) {
+        return false;
+    }
+    AV_Changed = data;
+    data = objinst_realloc(AV_Descr, size * sizeof(ANALOG_VALUE_DESCR));
+    if (!data) {
+        return false;
+    }
+    AV_Descr = data;
+
+    return true;
+}
+
+static void Analog_Value_Move(
+    unsigned to,
+    unsigned from)
+{
+    AV_Present_Value[to] = AV_Present_Value[from];
+    AV_Prior_Value[to] = AV_Prior_Value[from];
+    AV_COV_Increment[to] = AV_COV_Increment[from];
+    AV_Out_Of_Service[to] = AV_Out_Of_Service[from];
+    AV_Changed[to] = AV_Changed[from];
+    AV_Descr[to] = AV_Descr[from];
+}
+
+/**
+ * Creates an Analog Value object with default property values.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was created or exists already
+ */
+bool Analog_Value_Create(
+    uint32_t object_instance)
+{
+    unsigned i;
+#if defined(INTRINSIC_REPORTING)
+    unsigned j;
+#endif
 
-static const int Analog_Value_Properties_Optional[] = {
-    PROP_DESCRIPTION,
+    if (Analog_Value_Valid_Instance(object_instance)) {
+        return true;
+    }
+    i = objinst_add(&AV_Instances, object_instance);
+    if (i >= objinst_count(&AV_Instances)) {
+        return false;
+    }
+    AV_Present_Value[i] = 0.0f;
+    AV_Prior_Value[i] = 0.0f;
+    AV_COV_Increment[i] = 1.0f;
+    AV_Out_Of_Service[i] = false;
+    AV_Changed[i] = false;
+    memset(&AV_Descr[i], 0x00, sizeof(ANALOG_VALUE_DESCR));
+    AV_Descr[i].Units = UNITS_NO_UNITS;
 #if defined(INTRINSIC_REPORTING)
-    PROP_TIME_DELAY,
-    PROP_NOTIFICATION_CLASS,
-    PROP_HIGH_LIMIT,
-    PROP_LOW_LIMIT,
-    PROP_DEADBAND,
-    PROP_LIMIT_ENABLE,
-    PROP_EVENT_ENABLE,
-    PROP_ACKED_TRANSITIONS,
-    PROP_NOTIFY_TYPE,
-    PROP_EVENT_TIME_STAMPS,
+    AV_Descr[i].Event_State = EVENT_STATE_NORMAL;
+    /* notification class not connected */
+    AV_Descr[i].Notification_Class = BACNET_MAX_INSTANCE;
+    /* initialize Event time stamps using wildcards
+       and set Acked_transitions */
+    for (j = 0; j < MAX_BACNET_EVENT_TRANSITION; j++) {
+        datetime_wildcard_set(&AV_Descr[i].Event_Time_Stamps[j]);
+        AV_Descr[i].Acked_Transitions[j].bIsAcked = true;
+    }
 #endif
-    -1
-};
+    Device_Inc_Database_Revision();
 
-static const int Analog_Value_Properties_Proprietary[] = {
-    -1
-};
+    return true;
+}
 
-void Analog_Value_Property_Lists(
-    const int **pRequired,
-    const int **pOptional,
-    const int **pProprietary)
+/**
+ * Deletes an Analog Value object.  The last object takes its index.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was deleted
+ */
+bool Analog_Value_Delete(
+    uint32_t object_instance)
 {
-    if (pRequired)
-        *pRequired = Analog_Value_Properties_Required;
-    if (pOptional)
-        *pOptional = Analog_Value_Properties_Optional;
-    if (pProprietary)
-        *pProprietary = Analog_Value_Properties_Proprietary;
+    if (!objinst_remove(&AV_Instances, object_instance)) {
+        return false;
+    }
+    Device_Inc_Database_Revision();
 
-    return;
+    return true;
+}
+
+/**
+ * Deletes all the Analog Value objects and frees their memory.
+ */
+void Analog_Value_Cleanup(
+    void)
+{
+    objinst_cleanup(&AV_Instances);
+    free(AV_Present_Value);
+    free(AV_Prior_Value);
+    free(AV_COV_Increment);
+    free(AV_Out_Of_Service);
+    free(AV_Changed);
+    free(AV_Descr);
+    AV_Present_Value = NULL;
+    AV_Prior_Value = NULL;
+    AV_COV_Increment = NULL;
+    AV_Out_Of_Service = NULL;
+    AV_Changed = NULL;
+    AV_Descr = NULL;
 }
 
 void Analog_Value_Init(
     void)
 {
-	unsigned i;
-#if defined(INTRINSIC_REPORTING)
-	unsigned j;
-#endif
+    uint32_t instance;
 
-    for (i = 0; i < MAX_ANALOG_VALUES; i++) {
-        memset(&AV_Descr[i], 0x00, sizeof(ANALOG_VALUE_DESCR));
-        AV_Descr[i].Present_Value = 0.0;
-        AV_Descr[i].Units = UNITS_NO_UNITS;
+    objinst_init(&AV_Instances, MAX_ANALOG_VALUES, Analog_Value_Resize,
+        Analog_Value_Move);
+    for (instance = 0; instance < ANALOG_VALUE_INIT_COUNT; instance++) {
+        Analog_Value_Create(instance);
+    }
 #if defined(INTRINSIC_REPORTING)
-        AV_Descr[i].Event_State = EVENT_STATE_NORMAL;
-        /* notification class not connected */
-        AV_Descr[i].Notification_Class = BACNET_MAX_INSTANCE;
-        /* initialize Event time stamps using wildcards
-           and set Acked_transitions */
-        for (j = 0; j < MAX_BACNET_EVENT_TRANSITION; j++) {
-            datetime_wildcard_set(&AV_Descr[i].Event_Time_Stamps[j]);
-            AV_Descr[i].Acked_Transitions[j].bIsAcked = true;
-        }
-
-        /* Set handler for GetEventInformation function */
-        handler_get_event_information_set(OBJECT_ANALOG_VALUE,
-            Analog_Value_Event_Information);
-        /* Set handler for AcknowledgeAlarm function */
-        handler_alarm_ack_set(OBJECT_ANALOG_VALUE, Analog_Value_Alarm_Ack);
-        /* Set handler for GetAlarmSummary Service */
-        handler_get_alarm_summary_set(OBJECT_ANALOG_VALUE,
-            Analog_Value_Alarm_Summary);
+    /* Set handler for GetEventInformation function */
+    handler_get_event_information_set(OBJECT_ANALOG_VALUE,
+        Analog_Value_Event_Information);
+    /* Set handler for AcknowledgeAlarm function */
+    handler_alarm_ack_set(OBJECT_ANALOG_VALUE, Analog_Value_Alarm_Ack);
+    /* Set handler for GetAlarmSummary Service */
+    handler_get_alarm_summary_set(OBJECT_ANALOG_VALUE,
+        Analog_Value_Alarm_Summary);
 #endif
-    }
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need validate that the */
-/* given instance exists */
 bool Analog_Value_Valid_Instance(
     uint32_t object_instance)
 {
-    if (object_instance < MAX_ANALOG_VALUES)
-        return true;
-
-    return false;
+    return objinst_valid_instance(&AV_Instances, object_instance);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then count how many you have */
 unsigned Analog_Value_Count(
     void)
 {
-    return 1;
+    return objinst_count(&AV_Instances);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the instance */
-/* that correlates to the correct index */
 uint32_t Analog_Value_Index_To_Instance(
     unsigned index)
 {
-    return index;
+    return objinst_index_to_instance(&AV_Instances, index);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the index */
-/* that correlates to the correct instance number */
+/* returns an index not less than the count if there is no such object */
 unsigned Analog_Value_Instance_To_Index(
     uint32_t object_instance)
 {
-    unsigned index = MAX_ANALOG_VALUES;
-
-    if (object_instance < MAX_ANALOG_VALUES)
-        index = object_instance;
+    return objinst_instance_to_index(&AV_Instances, object_instance);
+}
 
-    return index;
+static void Analog_Value_COV_Detect(unsigned int index,
+    float value)
+{
+    float prior_value = 0.0;
+    float cov_increment = 0.0;
+    float cov_delta = 0.0;
+
+    if (index < objinst_count(&AV_Instances)) {
+        prior_value = AV_Prior_Value[index];
+        cov_increment = AV_COV_Increment[index];
+        if (prior_value > value) {
+            cov_delta = prior_value - value;
+        } else {
+            cov_delta = value - prior_value;
+        }
+        if (cov_delta >= cov_increment) {
+            AV_Changed[index] = true;
+            AV_Prior_Value[index] = value;
+            handler_cov_object_changed(OBJECT_ANALOG_VALUE,
+                Analog_Value_Index_To_Instance(index));
+        }
+    }
 }
 
 /**
@@ -194,8 +290,9 @@ bool Analog_Value_Present_Value_Set(
     bool status = false;
 
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
-        AV_Descr[index].Present_Value = value;
+    if (index < objinst_count(&AV_Instances)) {
+        Analog_Value_COV_Detect(index, value);
+        AV_Present_Value[index] = value;
         status = true;
     }
     return status;
@@ -208,22 +305,160 @@ float Analog_Value_Present_Value(
     unsigned index = 0;
 
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
-        value = AV_Descr[index].Present_Value;
+    if (index < objinst_count(&AV_Instances)) {
+        value = AV_Present_Value[index];
+    }
+
+    return value;
+}
+
+bool Analog_Value_Out_Of_Service(
+    uint32_t object_instance)
+{
+    unsigned index = 0;
+    bool value = false;
+
+    index = Analog_Value_Instance_To_Index(object_instance);
+    if (index < objinst_count(&AV_Instances)) {
+        value = AV_Out_Of_Service[index];
     }
 
     return value;
 }
 
+void Analog_Value_Out_Of_Service_Set(
+    uint32_t object_instance,
+    bool value)
+{
+    unsigned index = 0;
+
+    index = Analog_Value_Instance_To_Index(object_instance);
+    if (index < objinst_count(&AV_Instances)) {
+        if (AV_Out_Of_Service[index] != value) {
+            AV_Changed[index] = true;
+            handler_cov_object_changed(OBJECT_ANALOG_VALUE, object_instance);
+        }
+        AV_Out_Of_Service[index] = value;
+    }
+}
+
+bool Analog_Value_Change_Of_Value(
+    uint32_t object_instance)
+{
+    unsigned index = 0;
+    bool changed = false;
+
+    index = Analog_Value_Instance_To_Index(object_instance);
+    if (index < objinst_count(&AV_Instances)) {
+        changed = AV_Changed[index];
+    }
+
+    return changed;
+}
+
+void Analog_Value_Change_Of_Value_Clear(
+    uint32_t object_instance)
+{
+    unsigned index = 0;
+
+    index = Analog_Value_Instance_To_Index(object_instance);
+    if (index < objinst_count(&AV_Instances)) {
+        AV_Changed[index] = false;
+    }
+}
+
+/**
+ * Encode the Value List for Present-Value and Status-Flags
+ *
+ * @param object_instance - object-instance number of the object
+ * @param  value_list - #BACNET_PROPERTY_VALUE with at least 2 entries
+ *
+ * @return true if values were encoded
+*/
+bool Analog_Value_Encode_Value_List(
+    uint32_t object_instance,
+    BACNET_PROPERTY_VALUE * value_list)
+{
+    bool status = false;
+    bool in_alarm = false;
+    unsigned index = 0;
+
+    index = Analog_Value_Instance_To_Index(object_instance);
+    if (index >= objinst_count(&AV_Instances)) {
+        return false;
+    }
+#if defined(INTRINSIC_REPORTING)
+    in_alarm = AV_Descr[index].Event_State ? true : false;
+#endif
+    if (value_list) {
+        value_list->propertyIdentifier = PROP_PRESENT_VALUE;
+        value_list->propertyArrayIndex = BACNET_ARRAY_ALL;
+        value_list->value.context_specific = false;
+        value_list->value.tag = BACNET_APPLICATION_TAG_REAL;
+        value_list->value.type.Real = AV_Present_Value[index];
+        value_list->value.next = NULL;
+        value_list->priority = BACNET_NO_PRIORITY;
+        value_list = value_list->next;
+    }
+    if (value_list) {
+        value_list->propertyIdentifier = PROP_STATUS_FLAGS;
+        value_list->propertyArrayIndex = BACNET_ARRAY_ALL;
+        value_list->value.context_specific = false;
+        value_list->value.tag = BACNET_APPLICATION_TAG_BIT_STRING;
+        bitstring_init(&value_list->value.type.Bit_String);
+        bitstring_set_bit(&value_list->value.type.Bit_String,
+            STATUS_FLAG_IN_ALARM, in_alarm);
+        bitstring_set_bit(&value_list->value.type.Bit_String,
+            STATUS_FLAG_FAULT, false);
+        bitstring_set_bit(&value_list->value.type.Bit_String,
+            STATUS_FLAG_OVERRIDDEN, false);
+        bitstring_set_bit(&value_list->value.type.Bit_String,
+            STATUS_FLAG_OUT_OF_SERVICE, AV_Out_Of_Service[index]);
+        value_list->value.next = NULL;
+        value_list->priority = BACNET_NO_PRIORITY;
+        value_list->next = NULL;
+        status = true;
+    }
+
+    return status;
+}
+
+float Analog_Value_COV_Increment(
+    uint32_t object_instance)
+{
+    unsigned index = 0;
+    float value = 0;
+
+    index = Analog_Value_Instance_To_Index(object_instance);
+    if (index < objinst_count(&AV_Instances)) {
+        value = AV_COV_Increment[index];
+    }
+
+    return value;
+}
+
+void Analog_Value_COV_Increment_Set(
+    uint32_t object_instance,
+    float value)
+{
+    unsigned index = 0;
+
+    index = Analog_Value_Instance_To_Index(object_instance);
+    if (index < objinst_count(&AV_Instances)) {
+        AV_COV_Increment[index] = value;
+        Analog_Value_COV_Detect(index, AV_Present_Value[index]);
+    }
+}
+
 /* note: the object name must be unique within this device */
 bool Analog_Value_Object_Name(
     uint32_t object_instance,
     BACNET_CHARACTER_STRING * object_name)
 {
-    static char text_string[32] = "";   /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
-    if (object_instance < MAX_ANALOG_VALUES) {
+    if (Analog_Value_Valid_Instance(object_instance)) {
         sprintf(text_string, "ANALOG VALUE %lu",
             (unsigned long) object_instance);
         status = characterstring_init_ansi(object_name, text_string);
@@ -232,237 +467,347 @@ bool Analog_Value_Object_Name(
     return status;
 }
 
-/* return apdu len, or BACNET_STATUS_ERROR on error */
-int Analog_Value_Read_Property(
-    BACNET_READ_PROPERTY_DATA * rpdata)
+static int Analog_Value_Read_Object_Identifier(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
 {
-    int apdu_len = 0;   /* return value */
-    BACNET_BIT_STRING bit_string;
-    BACNET_CHARACTER_STRING char_string;
-    float real_value = (float) 1.414;
-    unsigned object_index = 0;
-    bool state = false;
-    uint8_t *apdu = NULL;
-    ANALOG_VALUE_DESCR *CurrentAV;
-#if defined(INTRINSIC_REPORTING)
-    int len = 0;
-    unsigned i = 0;
-#endif
+    return encode_application_object_id(&rpdata->application_data[0],
+        OBJECT_ANALOG_VALUE, rpdata->object_instance);
+}
 
-    if ((rpdata == NULL) || (rpdata->application_data == NULL) ||
-        (rpdata->application_data_len == 0)) {
-        return 0;
-    }
+static int Analog_Value_Read_Object_Name(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_CHARACTER_STRING char_string;
 
-    apdu = rpdata->application_data;
+    Analog_Value_Object_Name(rpdata->object_instance, &char_string);
 
-    object_index = Analog_Value_Instance_To_Index(rpdata->object_instance);
-    if (object_index < MAX_ANALOG_VALUES)
-        CurrentAV = &AV_Descr[object_index];
-    else
-        return BACNET_STATUS_ERROR;
-
-    switch (rpdata->object_property) {
-        case PROP_OBJECT_IDENTIFIER:
-            apdu_len =
-                encode_application_object_id(&apdu[0], OBJECT_ANALOG_VALUE,
-                rpdata->object_instance);
-            break;
+    return encode_application_character_string(&rpdata->application_data[0],
+        &char_string);
+}
 
-        case PROP_OBJECT_NAME:
-        case PROP_DESCRIPTION:
-            Analog_Value_Object_Name(rpdata->object_instance, &char_string);
-            apdu_len =
-                encode_application_character_string(&apdu[0], &char_string);
-            break;
+static int Analog_Value_Read_Object_Type(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        OBJECT_ANALOG_VALUE);
+}
 
-        case PROP_OBJECT_TYPE:
-            apdu_len =
-                encode_application_enumerated(&apdu[0], OBJECT_ANALOG_VALUE);
-            break;
+static int Analog_Value_Read_Present_Value(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0],
+        AV_Present_Value[object_index]);
+}
 
-        case PROP_PRESENT_VALUE:
-            real_value = Analog_Value_Present_Value(rpdata->object_instance);
-            apdu_len = encode_application_real(&apdu[0], real_value);
-            break;
+static int Analog_Value_Read_Status_Flags(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string;
 
-        case PROP_STATUS_FLAGS:
-            bitstring_init(&bit_string);
+    bitstring_init(&bit_string);
 #if defined(INTRINSIC_REPORTING)
-            bitstring_set_bit(&bit_string, STATUS_FLAG_IN_ALARM,
-                CurrentAV->Event_State ? true : false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_IN_ALARM,
+        AV_Descr[object_index].Event_State ? true : false);
 #else
-            bitstring_set_bit(&bit_string, STATUS_FLAG_IN_ALARM, false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_IN_ALARM, false);
 #endif
-            bitstring_set_bit(&bit_string, STATUS_FLAG_FAULT, false);
-            bitstring_set_bit(&bit_string, STATUS_FLAG_OVERRIDDEN, false);
-            bitstring_set_bit(&bit_string, STATUS_FLAG_OUT_OF_SERVICE,
-                CurrentAV->Out_Of_Service);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_FAULT, false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_OVERRIDDEN, false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_OUT_OF_SERVICE,
+        AV_Out_Of_Service[object_index]);
 
-            apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
-            break;
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
 
-        case PROP_EVENT_STATE:
+static int Analog_Value_Read_Event_State(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
 #if defined(INTRINSIC_REPORTING)
-            apdu_len =
-                encode_application_enumerated(&apdu[0],
-                CurrentAV->Event_State);
+    return encode_application_enumerated(&rpdata->application_data[0],
+        AV_Descr[object_index].Event_State);
 #else
-            apdu_len =
-                encode_application_enumerated(&apdu[0], EVENT_STATE_NORMAL);
+    return encode_application_enumerated(&rpdata->application_data[0],
+        EVENT_STATE_NORMAL);
 #endif
-            break;
+}
 
-        case PROP_OUT_OF_SERVICE:
-            state = CurrentAV->Out_Of_Service;
-            apdu_len = encode_application_boolean(&apdu[0], state);
-            break;
+static int Analog_Value_Read_Out_Of_Service(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_boolean(&rpdata->application_data[0],
+        AV_Out_Of_Service[object_index]);
+}
 
-        case PROP_UNITS:
-            apdu_len =
-                encode_application_enumerated(&apdu[0], CurrentAV->Units);
-            break;
+static int Analog_Value_Read_Units(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        AV_Descr[object_index].Units);
+}
+
+static int Analog_Value_Read_COV_Increment(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0],
+        AV_COV_Increment[object_index]);
+}
 
 #if defined(INTRINSIC_REPORTING)
-        case PROP_TIME_DELAY:
-            apdu_len =
-                encode_application_unsigned(&apdu[0], CurrentAV->Time_Delay);
-            break;
+static int Analog_Value_Read_Time_Delay(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        AV_Descr[object_index].Time_Delay);
+}
 
-        case PROP_NOTIFICATION_CLASS:
-            apdu_len =
-                encode_application_unsigned(&apdu[0],
-                CurrentAV->Notification_Class);
-            break;
+static int Analog_Value_Read_Notification_Class(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        AV_Descr[object_index].Notification_Class);
+}
 
-        case PROP_HIGH_LIMIT:
-            apdu_len =
-                encode_application_real(&apdu[0], CurrentAV->High_Limit);
-            break;
+static int Analog_Value_Read_High_Limit(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0],
+        AV_Descr[object_index].High_Limit);
+}
 
-        case PROP_LOW_LIMIT:
-            apdu_len = encode_application_real(&apdu[0], CurrentAV->Low_Limit);
-            break;
+static int Analog_Value_Read_Low_Limit(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0],
+        AV_Descr[object_index].Low_Limit);
+}
 
-        case PROP_DEADBAND:
-            apdu_len = encode_application_real(&apdu[0], CurrentAV->Deadband);
-            break;
+static int Analog_Value_Read_Deadband(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_real(&rpdata->application_data[0],
+        AV_Descr[object_index].Deadband);
+}
 
-        case PROP_LIMIT_ENABLE:
-            bitstring_init(&bit_string);
-            bitstring_set_bit(&bit_string, 0,
-                (CurrentAV->
-                    Limit_Enable & EVENT_LOW_LIMIT_ENABLE) ? true : false);
-            bitstring_set_bit(&bit_string, 1,
-                (CurrentAV->
-                    Limit_Enable & EVENT_HIGH_LIMIT_ENABLE) ? true : false);
-
-            apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
-            break;
+static int Analog_Value_Read_Limit_Enable(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string;
 
-        case PROP_EVENT_ENABLE:
-            bitstring_init(&bit_string);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_OFFNORMAL,
-                (CurrentAV->
-                    Event_Enable & EVENT_ENABLE_TO_OFFNORMAL) ? true : false);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_FAULT,
-                (CurrentAV->
-                    Event_Enable & EVENT_ENABLE_TO_FAULT) ? true : false);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_NORMAL,
-                (CurrentAV->
-                    Event_Enable & EVENT_ENABLE_TO_NORMAL) ? true : false);
-
-            apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
-            break;
+    bitstring_init(&bit_string);
+    bitstring_set_bit(&bit_string, 0,
+        (AV_Descr[object_index].Limit_Enable & EVENT_LOW_LIMIT_ENABLE) ? true : false);
+    bitstring_set_bit(&bit_string, 1,
+        (AV_Descr[object_index].Limit_Enable & EVENT_HIGH_LIMIT_ENABLE) ? true : false);
 
-        case PROP_ACKED_TRANSITIONS:
-            bitstring_init(&bit_string);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_OFFNORMAL,
-                CurrentAV->Acked_Transitions[TRANSITION_TO_OFFNORMAL].
-                bIsAcked);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_FAULT,
-                CurrentAV->Acked_Transitions[TRANSITION_TO_FAULT].bIsAcked);
-            bitstring_set_bit(&bit_string, TRANSITION_TO_NORMAL,
-                CurrentAV->Acked_Transitions[TRANSITION_TO_NORMAL].bIsAcked);
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
 
-            apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
-            break;
+static int Analog_Value_Read_Event_Enable(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string;
 
-        case PROP_NOTIFY_TYPE:
-            apdu_len =
-                encode_application_enumerated(&apdu[0],
-                CurrentAV->Notify_Type ? NOTIFY_EVENT : NOTIFY_ALARM);
-            break;
+    bitstring_init(&bit_string);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_OFFNORMAL,
+        (AV_Descr[object_index].Event_Enable & EVENT_ENABLE_TO_OFFNORMAL) ? true : false);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_FAULT,
+        (AV_Descr[object_index].Event_Enable & EVENT_ENABLE_TO_FAULT) ? true : false);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_NORMAL,
+        (AV_Descr[object_index].Event_Enable & EVENT_ENABLE_TO_NORMAL) ? true : false);
 
-        case PROP_EVENT_TIME_STAMPS:
-            /* Array element zero is the number of elements in the array */
-            if (rpdata->array_index == 0)
-                apdu_len =
-                    encode_application_unsigned(&apdu[0],
-                    MAX_BACNET_EVENT_TRANSITION);
-            /* if no index was specified, then try to encode the entire list */
-            /* into one packet. */
-            else if (rpdata->array_index == BACNET_ARRAY_ALL) {
-                for (i = 0; i < MAX_BACNET_EVENT_TRANSITION; i++) {;
-                    len =
-                        encode_opening_tag(&apdu[apdu_len],
-                        TIME_STAMP_DATETIME);
-                    len +=
-                        encode_application_date(&apdu[apdu_len + len],
-                        &CurrentAV->Event_Time_Stamps[i].date);
-                    len +=
-                        encode_application_time(&apdu[apdu_len + len],
-                        &CurrentAV->Event_Time_Stamps[i].time);
-                    len +=
-                        encode_closing_tag(&apdu[apdu_len + len],
-                        TIME_STAMP_DATETIME);
-
-                    /* add it if we have room */
-                    if ((apdu_len + len) < MAX_APDU)
-                        apdu_len += len;
-                    else {
-                        rpdata->error_code =
-                            ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
-                        apdu_len = BACNET_STATUS_ABORT;
-                        break;
-                    }
-                }
-            } else if (rpdata->array_index <= MAX_BACNET_EVENT_TRANSITION) {
-                apdu_len =
-                    encode_opening_tag(&apdu[apdu_len], TIME_STAMP_DATETIME);
-                apdu_len +=
-                    encode_application_date(&apdu[apdu_len],
-                    &CurrentAV->Event_Time_Stamps[rpdata->array_index].date);
-                apdu_len +=
-                    encode_application_time(&apdu[apdu_len],
-                    &CurrentAV->Event_Time_Stamps[rpdata->array_index].time);
-                apdu_len +=
-                    encode_closing_tag(&apdu[apdu_len], TIME_STAMP_DATETIME);
-            } else {
-                rpdata->error_class = ERROR_CLASS_PROPERTY;
-                rpdata->error_code = ERROR_CODE_INVALID_ARRAY_INDEX;
-                apdu_len = BACNET_STATUS_ERROR;
-            }
-            break;
-#endif
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
 
-        default:
-            rpdata->error_class = ERROR_CLASS_PROPERTY;
-            rpdata->error_code = ERROR_CODE_UNKNOWN_PROPERTY;
-            apdu_len = BACNET_STATUS_ERROR;
-            break;
-    }
-    /*  only array properties can have array options */
-    if ((apdu_len >= 0) && (rpdata->object_property != PROP_PRIORITY_ARRAY) &&
-        (rpdata->object_property != PROP_EVENT_TIME_STAMPS) &&
-        (rpdata->array_index != BACNET_ARRAY_ALL)) {
+static int Analog_Value_Read_Acked_Transitions(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string;
+
+    bitstring_init(&bit_string);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_OFFNORMAL,
+        AV_Descr[object_index].Acked_Transitions[TRANSITION_TO_OFFNORMAL].bIsAcked);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_FAULT,
+        AV_Descr[object_index].Acked_Transitions[TRANSITION_TO_FAULT].bIsAcked);
+    bitstring_set_bit(&bit_string, TRANSITION_TO_NORMAL,
+        AV_Descr[object_index].Acked_Transitions[TRANSITION_TO_NORMAL].bIsAcked);
+
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
+
+static int Analog_Value_Read_Notify_Type(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        AV_Descr[object_index].Notify_Type ? NOTIFY_EVENT : NOTIFY_ALARM);
+}
+
+static int Analog_Value_Read_Event_Time_Stamps(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    int apdu_len = 0;   /* return value */
+    int len = 0;
+    unsigned i = 0;
+    uint8_t *apdu = rpdata->application_data;
+    ANALOG_VALUE_DESCR *CurrentObject = &AV_Descr[object_index];
+
+    /* Array element zero is the number of elements in the array */
+    if (rpdata->array_index == 0)
+        apdu_len =
+            encode_application_unsigned(&apdu[0],
+            MAX_BACNET_EVENT_TRANSITION);
+    /* if no index was specified, then try to encode the entire list */
+    /* into one packet. */
+    else if (rpdata->array_index == BACNET_ARRAY_ALL) {
+        for (i = 0; i < MAX_BACNET_EVENT_TRANSITION; i++) {
+            /* add it if we have room */
+            if ((apdu_len + AV_TIME_STAMP_ELEMENT_MAX) > rpdata->application_data_len) {
+                rpdata->error_code =
+                    ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
+                apdu_len = BACNET_STATUS_ABORT;
+                break;
+            }
+            len = encode_opening_tag(&apdu[apdu_len], TIME_STAMP_DATETIME);
+            len +=
+                encode_application_date(&apdu[apdu_len + len],
+                &CurrentObject->Event_Time_Stamps[i].date);
+            len +=
+                encode_application_time(&apdu[apdu_len + len],
+                &CurrentObject->Event_Time_Stamps[i].time);
+            len +=
+                encode_closing_tag(&apdu[apdu_len + len],
+                TIME_STAMP_DATETIME);
+            apdu_len += len;
+        }
+    } else if (rpdata->array_index <= MAX_BACNET_EVENT_TRANSITION) {
+        /* array elements are numbered from one */
+        i = rpdata->array_index - 1;
+        apdu_len = encode_opening_tag(&apdu[apdu_len], TIME_STAMP_DATETIME);
+        apdu_len +=
+            encode_application_date(&apdu[apdu_len],
+            &CurrentObject->Event_Time_Stamps[i].date);
+        apdu_len +=
+            encode_application_time(&apdu[apdu_len],
+            &CurrentObject->Event_Time_Stamps[i].time);
+        apdu_len += encode_closing_tag(&apdu[apdu_len], TIME_STAMP_DATETIME);
+    } else {
         rpdata->error_class = ERROR_CLASS_PROPERTY;
-        rpdata->error_code = ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY;
+        rpdata->error_code = ERROR_CODE_INVALID_ARRAY_INDEX;
         apdu_len = BACNET_STATUS_ERROR;
     }
 
     return apdu_len;
 }
+#endif
+
+/* The Analog Value properties, as ReadPropertyMultiple lists them */
+static const struct property_descr_t Analog_Value_Property_Descr[] = {
+    {PROP_OBJECT_IDENTIFIER, PROPERTY_REQUIRED,
+        Analog_Value_Read_Object_Identifier},
+    {PROP_OBJECT_NAME, PROPERTY_REQUIRED, Analog_Value_Read_Object_Name},
+    {PROP_OBJECT_TYPE, PROPERTY_REQUIRED, Analog_Value_Read_Object_Type},
+    {PROP_PRESENT_VALUE, PROPERTY_REQUIRED, Analog_Value_Read_Present_Value},
+    {PROP_STATUS_FLAGS, PROPERTY_REQUIRED, Analog_Value_Read_Status_Flags},
+    {PROP_EVENT_STATE, PROPERTY_REQUIRED, Analog_Value_Read_Event_State},
+    {PROP_OUT_OF_SERVICE, PROPERTY_REQUIRED, Analog_Value_Read_Out_Of_Service},
+    {PROP_UNITS, PROPERTY_REQUIRED, Analog_Value_Read_Units},
+    {PROP_DESCRIPTION, PROPERTY_OPTIONAL, Analog_Value_Read_Object_Name},
+    {PROP_COV_INCREMENT, PROPERTY_OPTIONAL, Analog_Value_Read_COV_Increment},
+#if defined(INTRINSIC_REPORTING)
+    {PROP_TIME_DELAY, PROPERTY_OPTIONAL, Analog_Value_Read_Time_Delay},
+    {PROP_NOTIFICATION_CLASS, PROPERTY_OPTIONAL,
+        Analog_Value_Read_Notification_Class},
+    {PROP_HIGH_LIMIT, PROPERTY_OPTIONAL, Analog_Value_Read_High_Limit},
+    {PROP_LOW_LIMIT, PROPERTY_OPTIONAL, Analog_Value_Read_Low_Limit},
+    {PROP_DEADBAND, PROPERTY_OPTIONAL, Analog_Value_Read_Deadband},
+    {PROP_LIMIT_ENABLE, PROPERTY_OPTIONAL, Analog_Value_Read_Limit_Enable},
+    {PROP_EVENT_ENABLE, PROPERTY_OPTIONAL, Analog_Value_Read_Event_Enable},
+    {PROP_ACKED_TRANSITIONS, PROPERTY_OPTIONAL,
+        Analog_Value_Read_Acked_Transitions},
+    {PROP_NOTIFY_TYPE, PROPERTY_OPTIONAL, Analog_Value_Read_Notify_Type},
+    {PROP_EVENT_TIME_STAMPS, PROPERTY_OPTIONAL | PROPERTY_ARRAY,
+        Analog_Value_Read_Event_Time_Stamps},
+#endif
+};
+
+static const struct property_table_t Analog_Value_Properties =
+    PROPERTY_TABLE(Analog_Value_Property_Descr);
+
+/* These three arrays are used by the ReadPropertyMultiple handler,
+   and are filled from the property table on first use */
+#define AV_PROPERTY_COUNT \
+    (sizeof(Analog_Value_Property_Descr) / sizeof(Analog_Value_Property_Descr[0]))
+static int Analog_Value_Properties_Required[AV_PROPERTY_COUNT + 1];
+static int Analog_Value_Properties_Optional[AV_PROPERTY_COUNT + 1];
+static int Analog_Value_Properties_Proprietary[AV_PROPERTY_COUNT + 1];
+static bool Analog_Value_Properties_Valid;
+
+void Analog_Value_Property_Lists(
+    const int **pRequired,
+    const int **pOptional,
+    const int **pProprietary)
+{
+    if (!Analog_Value_Properties_Valid) {
+        property_table_lists(&Analog_Value_Properties,
+            Analog_Value_Properties_Required, Analog_Value_Properties_Optional,
+            Analog_Value_Properties_Proprietary);
+        Analog_Value_Properties_Valid = true;
+    }
+    if (pRequired)
+        *pRequired = Analog_Value_Properties_Required;
+    if (pOptional)
+        *pOptional = Analog_Value_Properties_Optional;
+    if (pProprietary)
+        *pProprietary = Analog_Value_Properties_Proprietary;
+
+    return;
+}
+
+const struct property_table_t *Analog_Value_Property_Table(
+    void)
+{
+    return &Analog_Value_Properties;
+}
+
+/* return apdu len, or BACNET_STATUS_ERROR on error */
+int Analog_Value_Read_Property(
+    BACNET_READ_PROPERTY_DATA * rpdata)
+{
+    unsigned object_index = 0;
+
+    if ((rpdata == NULL) || (rpdata->application_data == NULL) ||
+        (rpdata->application_data_len == 0)) {
+        return 0;
+    }
+
+    object_index = Analog_Value_Instance_To_Index(rpdata->object_instance);
+    if (object_index >= objinst_count(&AV_Instances))
+        return BACNET_STATUS_ERROR;
+
+    return property_table_read(&Analog_Value_Properties, rpdata, object_index);
+}
 
 /* returns true if successful */
 bool Analog_Value_Write_Property(
@@ -494,7 +839,7 @@ bool Analog_Value_Write_Property(
         return false;
     }
     object_index = Analog_Value_Instance_To_Index(wp_data->object_instance);
-    if (object_index < MAX_ANALOG_VALUES)
+    if (object_index < objinst_count(&AV_Instances))
         CurrentAV = &AV_Descr[object_index];
     else
         return false;
@@ -530,7 +875,8 @@ bool Analog_Value_Write_Property(
                 WPValidateArgType(&value, BACNET_APPLICATION_TAG_BOOLEAN,
                 &wp_data->error_class, &wp_data->error_code);
             if (status) {
-                CurrentAV->Out_Of_Service = value.type.Boolean;
+                Analog_Value_Out_Of_Service_Set(wp_data->object_instance,
+                    value.type.Boolean);
             }
             break;
 
@@ -543,6 +889,23 @@ bool Analog_Value_Write_Property(
             }
             break;
 
+        case PROP_COV_INCREMENT:
+            status =
+                WPValidateArgType(&value, BACNET_APPLICATION_TAG_REAL,
+                &wp_data->error_class, &wp_data->error_code);
+            if (status) {
+                if (value.type.Real >= 0.0) {
+                    Analog_Value_COV_Increment_Set(
+                        wp_data->object_instance,
+                        value.type.Real);
+                } else {
+                    status = false;
+                    wp_data->error_class = ERROR_CLASS_PROPERTY;
+                    wp_data->error_code = ERROR_CODE_VALUE_OUT_OF_RANGE;
+                }
+            }
+            break;
+
 #if defined(INTRINSIC_REPORTING)
         case PROP_TIME_DELAY:
             status =
@@ -690,7 +1053,7 @@ void Analog_Value_Intrinsic_Reporting(
 
 
     object_index = Analog_Value_Instance_To_Index(object_instance);
-    if (object_index < MAX_ANALOG_VALUES)
+    if (object_index < objinst_count(&AV_Instances))
         CurrentAV = &AV_Descr[object_index];
     else
         return;
@@ -813,6 +1176,9 @@ void Analog_Value_Intrinsic_Reporting(
         ToState = CurrentAV->Event_State;
 
         if (FromState != ToState) {
+            /* IN_ALARM of the Status_Flags follows the Event_State */
+            AV_Changed[object_index] = true;
+            handler_cov_object_changed(OBJECT_ANALOG_VALUE, object_instance);
             /* Event_State has changed.
                Need to fill only the basic parameters of this type of event.
                Other parameters will be filled in common function. */
@@ -927,7 +1293,7 @@ void Analog_Value_Intrinsic_Reporting(
                 statusFlags, STATUS_FLAG_OVERRIDDEN, false);
             bitstring_set_bit(&event_data.notificationParams.outOfRange.
                 statusFlags, STATUS_FLAG_OUT_OF_SERVICE,
-                CurrentAV->Out_Of_Service);
+                AV_Out_Of_Service[object_index]);
             /* Deadband used for limit checking. */
             event_data.notificationParams.outOfRange.deadband =
                 CurrentAV->Deadband;
@@ -983,7 +1349,7 @@ int Analog_Value_Event_Information(
 
 
     /* check index */
-    if (index < MAX_ANALOG_VALUES) {
+    if (index < objinst_count(&AV_Instances)) {
         /* Event_State not equal to NORMAL */
         IsActiveEvent = (AV_Descr[index].Event_State != EVENT_STATE_NORMAL);
 
@@ -1058,7 +1424,7 @@ int Analog_Value_Alarm_Ack(
         Analog_Value_Instance_To_Index(alarmack_data->eventObjectIdentifier.
         instance);
 
-    if (object_index < MAX_ANALOG_VALUES)
+    if (object_index < objinst_count(&AV_Instances))
         CurrentAV = &AV_Descr[object_index];
     else {
         *error_code = ERROR_CODE_UNKNOWN_OBJECT;
@@ -1155,7 +1521,7 @@ int Analog_Value_Alarm_Summary(
 {
 
     /* check index */
-    if (index < MAX_ANALOG_VALUES) {
+    if (index < objinst_count(&AV_Instances)) {
         /* Event_State is not equal to NORMAL  and
            Notify_Type property value is ALARM */
         if ((AV_Descr[index].Event_State != EVENT_STATE_NORMAL) &&
@@ -1234,6 +1600,24 @@ void testAnalog_Value(
     len = decode_object_id(&apdu[len], &decoded_type, &decoded_instance);
     ct_test(pTest, decoded_type == rpdata.object_type);
     ct_test(pTest, decoded_instance == rpdata.object_instance);
+    /* objects come and go; the others keep their values */
+    ct_test(pTest, Analog_Value_Count() == ANALOG_VALUE_INIT_COUNT);
+    ct_test(pTest, !Analog_Value_Valid_Instance(1000));
+    ct_test(pTest, Analog_Value_Create(1000));
+    ct_test(pTest, Analog_Value_Create(1000));
+    ct_test(pTest, Analog_Value_Count() == (ANALOG_VALUE_INIT_COUNT + 1));
+    Analog_Value_Present_Value_Set(1000, 42.0f, BACNET_MAX_PRIORITY);
+    Analog_Value_Present_Value_Set(0, 7.0f, BACNET_MAX_PRIORITY);
+    ct_test(pTest, Analog_Value_Delete(0));
+    ct_test(pTest, !Analog_Value_Delete(0));
+    ct_test(pTest, !Analog_Value_Valid_Instance(0));
+    ct_test(pTest, Analog_Value_Count() == ANALOG_VALUE_INIT_COUNT);
+    ct_test(pTest, Analog_Value_Present_Value(1000) == 42.0f);
+    ct_test(pTest, Analog_Value_Index_To_Instance(0) == 1000);
+    rpdata.object_instance = 0;
+    ct_test(pTest, Analog_Value_Read_Property(&rpdata) < 0);
+    Analog_Value_Cleanup();
+    ct_test(pTest, Analog_Value_Count() == 0);
 
     return;
 }
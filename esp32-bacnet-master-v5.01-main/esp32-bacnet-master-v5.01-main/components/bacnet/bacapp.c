@@ -169,6 +169,183 @@ int bacapp_encode_application_data(
     return apdu_len;
 }
 
+/* The length/value/type of the tag of a value and the octets after the
+   tag, as the encoders above and below would encode them.
+   Returns false for the types that cannot be sized this way. */
+static bool bacapp_value_len(
+    BACNET_APPLICATION_DATA_VALUE * value,
+    bool context_specific,
+    uint32_t * len_value_type,
+    uint32_t * content_len)
+{
+    uint32_t len = 0;
+    bool status = true;
+
+    switch (value->tag) {
+#if defined (BACAPP_NULL)
+        case BACNET_APPLICATION_TAG_NULL:
+            break;
+#endif
+#if defined (BACAPP_BOOLEAN)
+        case BACNET_APPLICATION_TAG_BOOLEAN:
+            if (context_specific) {
+                /* the value follows the tag */
+                *len_value_type = 1;
+                *content_len = 1;
+                return true;
+            }
+            /* the value is the tag */
+            *len_value_type = value->type.Boolean ? 1 : 0;
+            *content_len = 0;
+            return true;
+#endif
+#if defined (BACAPP_UNSIGNED)
+        case BACNET_APPLICATION_TAG_UNSIGNED_INT:
+            len = (uint32_t) encode_bacnet_unsigned_len(value->type.
+                Unsigned_Int);
+            break;
+#endif
+#if defined (BACAPP_SIGNED)
+        case BACNET_APPLICATION_TAG_SIGNED_INT:
+            len = (uint32_t) encode_bacnet_signed_len(value->type.Signed_Int);
+            break;
+#endif
+#if defined (BACAPP_REAL)
+        case BACNET_APPLICATION_TAG_REAL:
+            len = 4;
+            break;
+#endif
+#if defined (BACAPP_DOUBLE)
+        case BACNET_APPLICATION_TAG_DOUBLE:
+            len = 8;
+            break;
+#endif
+#if defined (BACAPP_OCTET_STRING)
+        case BACNET_APPLICATION_TAG_OCTET_STRING:
+            len = (uint32_t) octetstring_length(&value->type.Octet_String);
+            break;
+#endif
+#if defined (BACAPP_CHARACTER_STRING)
+        case BACNET_APPLICATION_TAG_CHARACTER_STRING:
+            /* and the character set */
+            len = (uint32_t) characterstring_length(&value->type.
+                Character_String) + 1;
+            break;
+#endif
+#if defined (BACAPP_BIT_STRING)
+        case BACNET_APPLICATION_TAG_BIT_STRING:
+            /* and the unused bits */
+            len = (uint32_t) bitstring_bytes_used(&value->type.Bit_String) + 1;
+            break;
+#endif
+#if defined (BACAPP_ENUMERATED)
+        case BACNET_APPLICATION_TAG_ENUMERATED:
+            len = (uint32_t) encode_bacnet_unsigned_len(value->type.
+                Enumerated);
+            break;
+#endif
+#if defined (BACAPP_DATE)
+        case BACNET_APPLICATION_TAG_DATE:
+            len = 4;
+            break;
+#endif
+#if defined (BACAPP_TIME)
+        case BACNET_APPLICATION_TAG_TIME:
+            len = 4;
+            break;
+#endif
+#if defined (BACAPP_OBJECT_ID)
+        case BACNET_APPLICATION_TAG_OBJECT_ID:
+            len = 4;
+            break;
+#endif
+        default:
+            status = false;
+            break;
+    }
+    *len_value_type = len;
+    *content_len = len;
+
+    return status;
+}
+
+/* the encoders of the strings give up on a value that fills the APDU */
+static int bacapp_value_len_limit(
+    BACNET_APPLICATION_DATA_VALUE * value,
+    int len)
+{
+    switch (value->tag) {
+        case BACNET_APPLICATION_TAG_OCTET_STRING:
+        case BACNET_APPLICATION_TAG_CHARACTER_STRING:
+            if (len >= MAX_APDU) {
+                len = 0;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return len;
+}
+
+#if defined (BACAPP_DEVICE_OBJECT_PROP_REF)
+static int bacapp_device_obj_property_ref_len(
+    BACNET_DEVICE_OBJECT_PROPERTY_REFERENCE * value)
+{
+    int len = 0;
+    int value_len = 0;
+
+    /* object-identifier       [0] BACnetObjectIdentifier */
+    len += encode_tag_len(0, 4) + 4;
+    /* property-identifier     [1] BACnetPropertyIdentifier */
+    value_len = encode_bacnet_unsigned_len(value->propertyIdentifier);
+    len += encode_tag_len(1, (uint32_t) value_len) + value_len;
+    /* property-array-index    [2] Unsigned OPTIONAL */
+    if (value->arrayIndex != BACNET_ARRAY_ALL) {
+        value_len = encode_bacnet_unsigned_len(value->arrayIndex);
+        len += encode_tag_len(2, (uint32_t) value_len) + value_len;
+    }
+    /* device-identifier       [3] BACnetObjectIdentifier OPTIONAL */
+    if (value->deviceIndentifier.type == OBJECT_DEVICE) {
+        len += encode_tag_len(3, 4) + 4;
+    }
+
+    return len;
+}
+#endif
+
+/** Sizes a value without encoding it.
+ *
+ * @param value - the value to be encoded
+ *
+ * @return the number of apdu bytes that bacapp_encode_application_data()
+ * would encode, or 0 for the types that it cannot encode or size
+ */
+int bacapp_encode_application_data_len(
+    BACNET_APPLICATION_DATA_VALUE * value)
+{
+    uint32_t len_value_type = 0;
+    uint32_t content_len = 0;
+    int len = 0;
+
+    if (value) {
+#if defined (BACAPP_DEVICE_OBJECT_PROP_REF)
+        if (value->tag ==
+            BACNET_APPLICATION_TAG_DEVICE_OBJECT_PROPERTY_REFERENCE) {
+            return bacapp_device_obj_property_ref_len(&value->type.
+                Device_Object_Property_Reference);
+        }
+#endif
+        if (bacapp_value_len(value, false, &len_value_type, &content_len)) {
+            len = encode_tag_len(value->tag, len_value_type) +
+                (int) content_len;
+            len = bacapp_value_len_limit(value, len);
+        }
+    }
+
+    return len;
+}
+
 /* decode the data and store it into value.
    Return the number of octets consumed. */
 int bacapp_decode_data(
@@ -830,6 +1007,120 @@ int bacapp_encode_data(
 
     return apdu_len;
 }
+/** Sizes a context tagged value without encoding it.
+ *
+ * @param context_tag_number - the context tag of the value
+ * @param value - the value to be encoded
+ *
+ * @return the number of apdu bytes that bacapp_encode_context_data_value()
+ * would encode, or 0 for the types that it cannot encode or size
+ */
+int bacapp_encode_context_data_value_len(
+    uint8_t context_tag_number,
+    BACNET_APPLICATION_DATA_VALUE * value)
+{
+    uint32_t len_value_type = 0;
+    uint32_t content_len = 0;
+    int len = 0;
+
+    if (value && bacapp_value_len(value, true, &len_value_type,
+            &content_len)) {
+        len = encode_tag_len(context_tag_number, len_value_type) +
+            (int) content_len;
+        len = bacapp_value_len_limit(value, len);
+    }
+
+    return len;
+}
+
+/* returns the number of apdu bytes that bacapp_encode_data() would encode */
+int bacapp_encode_data_len(
+    BACNET_APPLICATION_DATA_VALUE * value)
+{
+    int len = 0;
+
+    if (value) {
+        if (value->context_specific) {
+            len =
+                bacapp_encode_context_data_value_len(value->context_tag,
+                value);
+        } else {
+            len = bacapp_encode_application_data_len(value);
+        }
+    }
+
+    return len;
+}
+
+/**
+ * Starts encoding values into a buffer.
+ *
+ * @param cursor - the cursor
+ * @param apdu - the buffer
+ * @param size - octets in the buffer
+ */
+void bacapp_cursor_init(
+    BACAPP_CURSOR * cursor,
+    uint8_t * apdu,
+    unsigned size)
+{
+    cursor->apdu = apdu;
+    cursor->size = size;
+    cursor->len = 0;
+}
+
+/**
+ * Takes the next len octets of the buffer, to be encoded by the caller.
+ *
+ * @param cursor - the cursor
+ * @param len - octets to take
+ *
+ * @return where they start, or NULL if the buffer does not have them
+ */
+uint8_t *bacapp_cursor_reserve(
+    BACAPP_CURSOR * cursor,
+    unsigned len)
+{
+    uint8_t *apdu = NULL;
+
+    if (len <= (cursor->size - cursor->len)) {
+        apdu = &cursor->apdu[cursor->len];
+        cursor->len += len;
+    }
+
+    return apdu;
+}
+
+/**
+ * Encodes a value, application or context tagged as bacapp_encode_data()
+ * does, into the exact room it takes.
+ *
+ * @param cursor - the cursor
+ * @param value - the value to be encoded
+ *
+ * @return the number of apdu bytes encoded, or 0 if the value
+ * does not fit or cannot be encoded; nothing is encoded then
+ */
+int bacapp_cursor_encode_data(
+    BACAPP_CURSOR * cursor,
+    BACNET_APPLICATION_DATA_VALUE * value)
+{
+    uint8_t *apdu = NULL;
+    int len = 0;
+
+    len = bacapp_encode_data_len(value);
+    if (len > 0) {
+        apdu = bacapp_cursor_reserve(cursor, (unsigned) len);
+        if (apdu) {
+            bacapp_encode_data(apdu, value);
+        } else {
+            len = 0;
+        }
+    }
+
+    return len;
+}
+
 
 
 bool bacapp_copy(
@@ -2175,6 +2466,152 @@ void testBACnetApplicationData(
 }
 
 
+/* the size query against what the encoders encode, for each type */
+static void testBACnetApplicationDataEncodeLenValue(
+    Test * pTest,
+    BACNET_APPLICATION_DATA_VALUE * value)
+{
+    static const uint8_t context_tags[] = { 0, 3, 14, 15, 200 };
+    uint8_t apdu[MAX_APDU + 16];
+    unsigned i;
+    int len;
+
+    len = bacapp_encode_application_data(&apdu[0], value);
+    ct_test(pTest, bacapp_encode_application_data_len(value) == len);
+    for (i = 0; i < sizeof(context_tags); i++) {
+        len =
+            bacapp_encode_context_data_value(&apdu[0], context_tags[i],
+            value);
+        ct_test(pTest,
+            bacapp_encode_context_data_value_len(context_tags[i],
+                value) == len);
+    }
+}
+
+void testBACnetApplicationDataEncodeLen(
+    Test * pTest)
+{
+    static const uint32_t unsigned_values[] = {
+        0, 4, 5, 0xFF, 0x100, 0xFFFF, 0x10000, 0xFFFFFF, 0x1000000,
+        0xFFFFFFFF
+    };
+    static const int32_t signed_values[] = {
+        0, -1, 127, 128, -128, -129, 32767, 32768, -32768, -32769,
+        8388607, 8388608, -8388607, -8388608, 2147483647
+    };
+    static const unsigned string_lengths[] = {
+        0, 3, 4, 252, 253, MAX_APDU - 8, MAX_APDU - 1
+    };
+    BACNET_APPLICATION_DATA_VALUE value;
+    BACAPP_CURSOR cursor;
+    uint8_t apdu[12];
+    char text[MAX_APDU];
+    unsigned i, bit;
+    int len;
+
+    memset(&value, 0, sizeof(value));
+    value.tag = BACNET_APPLICATION_TAG_NULL;
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    value.tag = BACNET_APPLICATION_TAG_BOOLEAN;
+    value.type.Boolean = false;
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    value.type.Boolean = true;
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    for (i = 0; i < sizeof(unsigned_values) / sizeof(unsigned_values[0]);
+        i++) {
+        value.tag = BACNET_APPLICATION_TAG_UNSIGNED_INT;
+        value.type.Unsigned_Int = unsigned_values[i];
+        testBACnetApplicationDataEncodeLenValue(pTest, &value);
+        value.tag = BACNET_APPLICATION_TAG_ENUMERATED;
+        value.type.Enumerated = unsigned_values[i];
+        testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    }
+    for (i = 0; i < sizeof(signed_values) / sizeof(signed_values[0]); i++) {
+        value.tag = BACNET_APPLICATION_TAG_SIGNED_INT;
+        value.type.Signed_Int = signed_values[i];
+        testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    }
+    value.tag = BACNET_APPLICATION_TAG_REAL;
+    value.type.Real = 3.14159f;
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    value.tag = BACNET_APPLICATION_TAG_DOUBLE;
+    value.type.Double = 3.14159;
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    memset(text, 'x', sizeof(text));
+    for (i = 0; i < sizeof(string_lengths) / sizeof(string_lengths[0]); i++) {
+        value.tag = BACNET_APPLICATION_TAG_CHARACTER_STRING;
+        characterstring_init(&value.type.Character_String,
+            CHARACTER_ANSI_X34, text, string_lengths[i]);
+        testBACnetApplicationDataEncodeLenValue(pTest, &value);
+        value.tag = BACNET_APPLICATION_TAG_OCTET_STRING;
+        octetstring_init(&value.type.Octet_String, (uint8_t *) text,
+            string_lengths[i]);
+        testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    }
+    value.tag = BACNET_APPLICATION_TAG_BIT_STRING;
+    bitstring_init(&value.type.Bit_String);
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    for (bit = 0; bit < 24; bit += 5) {
+        bitstring_set_bit(&value.type.Bit_String, (uint8_t) bit, true);
+        testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    }
+    value.tag = BACNET_APPLICATION_TAG_DATE;
+    datetime_set_date(&value.type.Date, 2026, 10, 19);
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    value.tag = BACNET_APPLICATION_TAG_TIME;
+    datetime_set_time(&value.type.Time, 12, 30, 15, 0);
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    value.tag = BACNET_APPLICATION_TAG_OBJECT_ID;
+    value.type.Object_Id.type = OBJECT_ANALOG_INPUT;
+    value.type.Object_Id.instance = 4194302;
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+#if defined (BACAPP_DEVICE_OBJECT_PROP_REF)
+    value.tag = BACNET_APPLICATION_TAG_DEVICE_OBJECT_PROPERTY_REFERENCE;
+    value.type.Device_Object_Property_Reference.objectIdentifier.type =
+        OBJECT_ANALOG_INPUT;
+    value.type.Device_Object_Property_Reference.objectIdentifier.instance =
+        1;
+    value.type.Device_Object_Property_Reference.propertyIdentifier =
+        PROP_PRESENT_VALUE;
+    value.type.Device_Object_Property_Reference.arrayIndex = BACNET_ARRAY_ALL;
+    value.type.Device_Object_Property_Reference.deviceIndentifier.type =
+        OBJECT_ANALOG_INPUT;
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+    value.type.Device_Object_Property_Reference.propertyIdentifier = 512;
+    value.type.Device_Object_Property_Reference.arrayIndex = 300;
+    value.type.Device_Object_Property_Reference.deviceIndentifier.type =
+        OBJECT_DEVICE;
+    value.type.Device_Object_Property_Reference.deviceIndentifier.instance =
+        123;
+    testBACnetApplicationDataEncodeLenValue(pTest, &value);
+#endif
+
+    /* values go in while they fit, and nothing of one that does not */
+    bacapp_cursor_init(&cursor, &apdu[0], sizeof(apdu));
+    value.context_specific = false;
+    value.tag = BACNET_APPLICATION_TAG_REAL;
+    value.type.Real = 1.0f;
+    len = bacapp_cursor_encode_data(&cursor, &value);
+    ct_test(pTest, len == 5);
+    ct_test(pTest, cursor.len == 5);
+    value.tag = BACNET_APPLICATION_TAG_DOUBLE;
+    value.type.Double = 1.0;
+    len = bacapp_cursor_encode_data(&cursor, &value);
+    ct_test(pTest, len == 0);
+    ct_test(pTest, cursor.len == 5);
+    value.context_specific = true;
+    value.context_tag = 2;
+    value.tag = BACNET_APPLICATION_TAG_UNSIGNED_INT;
+    value.type.Unsigned_Int = 0x12345;
+    len = bacapp_cursor_encode_data(&cursor, &value);
+    ct_test(pTest, len == 4);
+    ct_test(pTest, cursor.len == 9);
+    ct_test(pTest, apdu[5] == 0x2B);
+    ct_test(pTest, bacapp_cursor_reserve(&cursor, 3) == &apdu[9]);
+    ct_test(pTest, bacapp_cursor_reserve(&cursor, 1) == NULL);
+    ct_test(pTest, cursor.len == sizeof(apdu));
+}
+
 #ifdef TEST_BACNET_APPLICATION_DATA
 int main(
     void)
@@ -2190,6 +2627,8 @@ int main(
     assert(rc);
     rc = ct_addTestFunction(pTest, testBACnetApplicationData_Safe);
     assert(rc);
+    rc = ct_addTestFunction(pTest, testBACnetApplicationDataEncodeLen);
+    assert(rc);
 
     ct_setStream(pTest, stdout);
     ct_run(pTest);
@@ -253,6 +253,30 @@ int encode_tag(
     return len;
 }
 
+/* returns the number of apdu bytes that encode_tag() would encode,
+   without encoding them */
+int encode_tag_len(
+    uint8_t tag_number,
+    uint32_t len_value_type)
+{
+    int len = 1;        /* return value */
+
+    if (tag_number > 14) {
+        len++;
+    }
+    if (len_value_type > 4) {
+        if (len_value_type <= 253) {
+            len += 1;
+        } else if (len_value_type <= 65535) {
+            len += 3;
+        } else {
+            len += 5;
+        }
+    }
+
+    return len;
+}
+
 /* from clause 20.2.1.3.2 Constructed Data */
 /* returns the number of apdu bytes consumed */
 int encode_opening_tag(
@@ -301,7 +325,74 @@ int encode_closing_tag(
     return len;
 }
 
+/* What the initial octet of a tag says about the octets after it, so
+   that a tag is decoded with one table lookup instead of a test of
+   each class in turn: the tag number is in the next octet, the length
+   or value follows the tag number, or else the value itself (0..4 for
+   the small values, 0 for opening and closing tags). */
+#define TAG_INFO_VALUE      0x07
+#define TAG_INFO_EXT_NUMBER 0x08
+#define TAG_INFO_EXT_VALUE  0x10
+
+#define TAG_INFO(x) \
+    (((((x) & 0xF0) == 0xF0) ? TAG_INFO_EXT_NUMBER : 0) | \
+    ((((x) & 0x07) == 5) ? TAG_INFO_EXT_VALUE : \
+    (((x) & 0x07) > 5) ? 0 : ((x) & 0x07)))
+#define TAG_INFO_4(x) \
+    TAG_INFO(x), TAG_INFO((x) + 1), TAG_INFO((x) + 2), TAG_INFO((x) + 3)
+#define TAG_INFO_16(x) \
+    TAG_INFO_4(x), TAG_INFO_4((x) + 4), TAG_INFO_4((x) + 8), \
+    TAG_INFO_4((x) + 12)
+#define TAG_INFO_64(x) \
+    TAG_INFO_16(x), TAG_INFO_16((x) + 16), TAG_INFO_16((x) + 32), \
+    TAG_INFO_16((x) + 48)
+
+static const uint8_t Tag_Info[256] = {
+    TAG_INFO_64(0x00), TAG_INFO_64(0x40), TAG_INFO_64(0x80), TAG_INFO_64(0xC0)
+};
+
+/* Big-endian loads from any address.  The memcpy is a single load
+   where the target allows unaligned access, and the same byte loads
+   the shifts would take where it does not.  The byte order is the
+   compiler's: BIG_ENDIAN may come from the C library as well. */
+static inline uint16_t load_unsigned16(
+    const uint8_t * apdu)
+{
+    uint16_t value;
+
+    memcpy(&value, apdu, sizeof(value));
+#if (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return value;
+#else
+    return __builtin_bswap16(value);
+#endif
+}
+
+static inline uint32_t load_unsigned32(
+    const uint8_t * apdu)
+{
+    uint32_t value;
 
+    memcpy(&value, apdu, sizeof(value));
+#if (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return value;
+#else
+    return __builtin_bswap32(value);
+#endif
+}
+
+static inline uint64_t load_unsigned64(
+    const uint8_t * apdu)
+{
+    uint64_t value;
+
+    memcpy(&value, apdu, sizeof(value));
+#if (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return value;
+#else
+    return __builtin_bswap64(value);
+#endif
+}
 
 int decode_tag_number(
     uint8_t * apdu,
@@ -335,12 +426,14 @@ int decode_tag_number_safe(
 
     /* decode the tag number first */
     if (apdu_len_remaining >= 1) {
-        if (IS_EXTENDED_TAG_NUMBER(apdu[0]) && apdu_len_remaining >= 2) {
-            /* extended tag */
-            if (tag_number) {
-                *tag_number = apdu[1];
+        if (IS_EXTENDED_TAG_NUMBER(apdu[0])) {
+            /* extended tag, unless the packet ends before its number */
+            if (apdu_len_remaining >= 2) {
+                if (tag_number) {
+                    *tag_number = apdu[1];
+                }
+                len = 2;
             }
-            len = 2;
         } else {
             if (tag_number) {
                 *tag_number = (uint8_t) (apdu[0] >> 4);
@@ -372,100 +465,116 @@ int decode_tag_number_and_value(
     uint8_t * tag_number,
     uint32_t * value)
 {
-    int len = 1;
-    uint16_t value16;
+    uint8_t info = Tag_Info[apdu[0]];
     uint32_t value32;
+    int len = 1;
 
-    len = decode_tag_number(&apdu[0], tag_number);
-    if (IS_EXTENDED_VALUE(apdu[0])) {
-        /* tagged as uint32_t */
-        if (apdu[len] == 255) {
-            len++;
-            len += decode_unsigned32(&apdu[len], &value32);
-            if (value) {
-                *value = value32;
-            }
-        }
-        /* tagged as uint16_t */
-        else if (apdu[len] == 254) {
-            len++;
-            len += decode_unsigned16(&apdu[len], &value16);
-            if (value) {
-                *value = value16;
-            }
+    if (info & TAG_INFO_EXT_NUMBER) {
+        /* extended tag */
+        if (tag_number) {
+            *tag_number = apdu[1];
         }
-        /* no tag - must be uint8_t */
-        else {
-            if (value) {
-                *value = apdu[len];
-            }
-            len++;
+        len++;
+    } else if (tag_number) {
+        *tag_number = (uint8_t) (apdu[0] >> 4);
+    }
+    if (info & TAG_INFO_EXT_VALUE) {
+        value32 = apdu[len];
+        len++;
+        if (value32 == 255) {
+            /* tagged as uint32_t */
+            value32 = load_unsigned32(&apdu[len]);
+            len += 4;
+        } else if (value32 == 254) {
+            /* tagged as uint16_t */
+            value32 = load_unsigned16(&apdu[len]);
+            len += 2;
         }
-    } else if (IS_OPENING_TAG(apdu[0]) && value) {
-        *value = 0;
-    } else if (IS_CLOSING_TAG(apdu[0]) && value) {
-        /* closing tag */
-        *value = 0;
-    } else if (value) {
-        /* small value */
-        *value = apdu[0] & 0x07;
+    } else {
+        /* small value, or zero for an opening or closing tag */
+        value32 = info & TAG_INFO_VALUE;
+    }
+    if (value) {
+        *value = value32;
     }
 
     return len;
 }
 
-/* Same as function above, but will safely fail if packet has been truncated */
+/* Same as function above, but will safely fail if packet has been truncated.
+   With room for the longest tag, the tag is taken from one load of eight
+   octets; nearer the end of the packet its length is checked first. */
 int decode_tag_number_and_value_safe(
     uint8_t * apdu,
     uint32_t apdu_len_remaining,
     uint8_t * tag_number,
     uint32_t * value)
 {
-    int len = 0;
-
-    len = decode_tag_number_safe(&apdu[0], apdu_len_remaining, tag_number);
+    uint64_t octets;
+    uint8_t info;
+    uint32_t value32;
+    int len = 1;
 
-    if (len > 0) {
-        apdu_len_remaining -= len;
-        if (IS_EXTENDED_VALUE(apdu[0])) {
-            /* tagged as uint32_t */
-            if (apdu[len] == 255 && apdu_len_remaining >= 5) {
-                uint32_t value32;
-                len++;
-                len += decode_unsigned32(&apdu[len], &value32);
-                if (value) {
-                    *value = value32;
-                }
-            }
-            /* tagged as uint16_t */
-            else if (apdu[len] == 254 && apdu_len_remaining >= 3) {
-                uint16_t value16;
-                len++;
-                len += decode_unsigned16(&apdu[len], &value16);
-                if (value) {
-                    *value = value16;
-                }
+    if (apdu_len_remaining < 8) {
+        if (apdu_len_remaining < 1) {
+            return 0;
+        }
+        info = Tag_Info[apdu[0]];
+        if (info & TAG_INFO_EXT_NUMBER) {
+            len++;
+        }
+        if (info & TAG_INFO_EXT_VALUE) {
+            if (apdu_len_remaining < (uint32_t) len + 1) {
+                return 0;
             }
-            /* no tag - must be uint8_t */
-            else if (apdu[len] < 254 && apdu_len_remaining >= 1) {
-                if (value) {
-                    *value = apdu[len];
-                }
-                len++;
+            if (apdu[len] == 255) {
+                len += 5;
+            } else if (apdu[len] == 254) {
+                len += 3;
             } else {
-                /* packet is truncated */
-                len = 0;
+                len += 1;
             }
-        } else if (IS_OPENING_TAG(apdu[0]) && value) {
-            *value = 0;
-        } else if (IS_CLOSING_TAG(apdu[0]) && value) {
-            /* closing tag */
-            *value = 0;
-        } else if (value) {
-            /* small value */
-            *value = apdu[0] & 0x07;
         }
+        if (apdu_len_remaining < (uint32_t) len) {
+            /* packet is truncated */
+            return 0;
+        }
+
+        return decode_tag_number_and_value(apdu, tag_number, value);
     }
+    /* the initial octet is the most significant */
+    octets = load_unsigned64(apdu);
+    info = Tag_Info[(uint8_t) (octets >> 56)];
+    if (info & TAG_INFO_EXT_NUMBER) {
+        /* extended tag */
+        if (tag_number) {
+            *tag_number = (uint8_t) (octets >> 48);
+        }
+        octets <<= 8;
+        len++;
+    } else if (tag_number) {
+        *tag_number = (uint8_t) (octets >> 60);
+    }
+    if (info & TAG_INFO_EXT_VALUE) {
+        value32 = (uint8_t) (octets >> 48);
+        len++;
+        if (value32 == 255) {
+            /* tagged as uint32_t */
+            value32 = (uint32_t) (octets >> 16);
+            len += 4;
+        } else if (value32 == 254) {
+            /* tagged as uint16_t */
+            value32 = (uint16_t) (octets >> 32);
+            len += 2;
+        }
+    } else {
+        /* small value, or zero for an opening or closing tag */
+        value32 = info & TAG_INFO_VALUE;
+    }
+    if (value) {
+        *value = value32;
+    }
+
     return len;
 }
 
@@ -1121,22 +1230,19 @@ int decode_unsigned(
     uint32_t len_value,
     uint32_t * value)
 {
-    uint16_t unsigned16_value = 0;
-
     if (value) {
         switch (len_value) {
             case 1:
                 *value = apdu[0];
                 break;
             case 2:
-                decode_unsigned16(&apdu[0], &unsigned16_value);
-                *value = unsigned16_value;
+                *value = load_unsigned16(&apdu[0]);
                 break;
             case 3:
-                decode_unsigned24(&apdu[0], value);
+                *value = ((uint32_t) load_unsigned16(&apdu[0]) << 8) | apdu[2];
                 break;
             case 4:
-                decode_unsigned32(&apdu[0], value);
+                *value = load_unsigned32(&apdu[0]);
                 break;
             default:
                 *value = 0;
@@ -1189,6 +1295,22 @@ int encode_bacnet_unsigned(
     return len;
 }
 
+/* returns the number of apdu bytes that encode_bacnet_unsigned()
+   would encode */
+int encode_bacnet_unsigned_len(
+    uint32_t value)
+{
+    if (value < 0x100) {
+        return 1;
+    } else if (value < 0x10000) {
+        return 2;
+    } else if (value < 0x1000000) {
+        return 3;
+    }
+
+    return 4;
+}
+
 /* from clause 20.2.4 Encoding of an Unsigned Integer Value */
 /* and 20.2.1 General Rules for Encoding BACnet Tags */
 /* returns the number of apdu bytes consumed */
@@ -1241,15 +1363,7 @@ int decode_enumerated(
     uint32_t len_value,
     uint32_t * value)
 {
-    uint32_t unsigned_value = 0;
-    int len;
-
-    len = decode_unsigned(apdu, len_value, &unsigned_value);
-    if (value) {
-        *value = unsigned_value;
-    }
-
-    return len;
+    return decode_unsigned(apdu, len_value, value);
 }
 
 int decode_context_enumerated(
@@ -1335,23 +1449,17 @@ int decode_signed(
     uint32_t len_value,
     int32_t * value)
 {
+    uint32_t unsigned_value = 0;
+    unsigned shift;
+
     if (value) {
-        switch (len_value) {
-            case 1:
-                decode_signed8(&apdu[0], value);
-                break;
-            case 2:
-                decode_signed16(&apdu[0], value);
-                break;
-            case 3:
-                decode_signed24(&apdu[0], value);
-                break;
-            case 4:
-                decode_signed32(&apdu[0], value);
-                break;
-            default:
-                *value = 0;
-                break;
+        if ((len_value >= 1) && (len_value <= 4)) {
+            /* the octets as unsigned, then the top one's sign extended */
+            decode_unsigned(apdu, len_value, &unsigned_value);
+            shift = 32 - (8 * len_value);
+            *value = (int32_t) (unsigned_value << shift) >> shift;
+        } else {
+            *value = 0;
         }
     }
 
@@ -1403,6 +1511,22 @@ int encode_bacnet_signed(
     return len;
 }
 
+/* returns the number of apdu bytes that encode_bacnet_signed()
+   would encode */
+int encode_bacnet_signed_len(
+    int32_t value)
+{
+    if ((value >= -128) && (value < 128)) {
+        return 1;
+    } else if ((value >= -32768) && (value < 32768)) {
+        return 2;
+    } else if ((value > -8388608) && (value < 8388608)) {
+        return 3;
+    }
+
+    return 4;
+}
+
 /* from clause 20.2.5 Encoding of a Signed Integer Value */
 /* and 20.2.1 General Rules for Encoding BACnet Tags */
 /* returns the number of apdu bytes consumed */
@@ -1779,6 +1903,7 @@ int encode_simple_ack(
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include "ctest.h"
 
 static int get_apdu_len(
@@ -1892,7 +2017,7 @@ static void testBACDCodeTags(
             test_len = get_apdu_len(IS_EXTENDED_TAG_NUMBER(apdu[0]), value);
             ct_test(pTest, len == test_len);
             /* stop at the the last value */
-            if (value & BIT31) {
+            if (value & 0x80000000UL) {
                 break;
             }
         }
@@ -1905,6 +2030,285 @@ static void testBACDCodeTags(
     return;
 }
 
+/* the byte-by-byte decoders the table-driven ones replaced,
+   kept to check the new ones against and to time them */
+static int decode_tag_number_and_value_safe_reference(
+    uint8_t * apdu,
+    uint32_t apdu_len_remaining,
+    uint8_t * tag_number,
+    uint32_t * value)
+{
+    int len = 0;
+
+    if (apdu_len_remaining >= 1) {
+        if (IS_EXTENDED_TAG_NUMBER(apdu[0]) && apdu_len_remaining >= 2) {
+            if (tag_number) {
+                *tag_number = apdu[1];
+            }
+            len = 2;
+        } else {
+            if (tag_number) {
+                *tag_number = (uint8_t) (apdu[0] >> 4);
+            }
+            len = 1;
+        }
+    }
+    if (len > 0) {
+        apdu_len_remaining -= len;
+        if (IS_EXTENDED_VALUE(apdu[0])) {
+            if (apdu[len] == 255 && apdu_len_remaining >= 5) {
+                uint32_t value32;
+                len++;
+                len += decode_unsigned32(&apdu[len], &value32);
+                if (value) {
+                    *value = value32;
+                }
+            } else if (apdu[len] == 254 && apdu_len_remaining >= 3) {
+                uint16_t value16;
+                len++;
+                len += decode_unsigned16(&apdu[len], &value16);
+                if (value) {
+                    *value = value16;
+                }
+            } else if (apdu[len] < 254 && apdu_len_remaining >= 1) {
+                if (value) {
+                    *value = apdu[len];
+                }
+                len++;
+            } else {
+                len = 0;
+            }
+        } else if (IS_OPENING_TAG(apdu[0]) && value) {
+            *value = 0;
+        } else if (IS_CLOSING_TAG(apdu[0]) && value) {
+            *value = 0;
+        } else if (value) {
+            *value = apdu[0] & 0x07;
+        }
+    }
+    return len;
+}
+
+static int decode_unsigned_reference(
+    uint8_t * apdu,
+    uint32_t len_value,
+    uint32_t * value)
+{
+    uint16_t unsigned16_value = 0;
+
+    switch (len_value) {
+        case 1:
+            *value = apdu[0];
+            break;
+        case 2:
+            decode_unsigned16(&apdu[0], &unsigned16_value);
+            *value = unsigned16_value;
+            break;
+        case 3:
+            decode_unsigned24(&apdu[0], value);
+            break;
+        case 4:
+            decode_unsigned32(&apdu[0], value);
+            break;
+        default:
+            *value = 0;
+            break;
+    }
+
+    return (int) len_value;
+}
+
+static void testBACDCodeTagsSafe(
+    Test * pTest)
+{
+    static const uint8_t markers[] = { 0, 4, 5, 200, 253, 254, 255 };
+    uint8_t apdu[16] = { 0 };
+    uint8_t tag_number = 0, test_tag_number = 0;
+    uint32_t value = 0, test_value = 0;
+    uint32_t remaining = 0;
+    unsigned octet = 0, i = 0, j = 0;
+    int len = 0, test_len = 0;
+
+    for (octet = 0; octet <= 0xFF; octet++) {
+        for (i = 0; i < sizeof(markers); i++) {
+            apdu[0] = (uint8_t) octet;
+            apdu[1] = markers[i];
+            apdu[2] = markers[i];
+            for (j = 3; j < sizeof(apdu); j++) {
+                apdu[j] = (uint8_t) (0x11 * j);
+            }
+            test_len =
+                decode_tag_number_and_value_safe_reference(&apdu[0],
+                sizeof(apdu), &test_tag_number, &test_value);
+            len =
+                decode_tag_number_and_value(&apdu[0], &tag_number, &value);
+            ct_test(pTest, len == test_len);
+            ct_test(pTest, tag_number == test_tag_number);
+            ct_test(pTest, value == test_value);
+            for (remaining = 0; remaining <= sizeof(apdu); remaining++) {
+                test_len =
+                    decode_tag_number_and_value_safe_reference(&apdu[0],
+                    remaining, &test_tag_number, &test_value);
+                len =
+                    decode_tag_number_and_value_safe(&apdu[0], remaining,
+                    &tag_number, &value);
+                if ((remaining == 1) && IS_EXTENDED_TAG_NUMBER(apdu[0])) {
+                    /* the old decoder took the tag number octet to be
+                       there; the packet ends before it */
+                    ct_test(pTest, len == 0);
+                    continue;
+                }
+                ct_test(pTest, len == test_len);
+                ct_test(pTest, (uint32_t) len <= remaining);
+                if (len > 0) {
+                    ct_test(pTest, tag_number == test_tag_number);
+                    ct_test(pTest, value == test_value);
+                }
+            }
+        }
+    }
+}
+
+/* An RPM-ACK for the Present_Value, Status_Flags, Object_Name and
+   Units of an Analog Input and four properties of an Analog Value,
+   as a workstation polls them */
+static uint8_t RPM_Ack_Traffic[] = {
+    0x30, 0x01, 0x0E,
+    0x0C, 0x00, 0x00, 0x00, 0x01,
+    0x1E,
+    0x29, 0x55, 0x4E, 0x44, 0x41, 0xB4, 0xCC, 0xCD, 0x4F,
+    0x29, 0x6F, 0x4E, 0x82, 0x04, 0x00, 0x4F,
+    0x29, 0x4D, 0x4E, 0x75, 0x0A, 0x00,
+    'Z', 'o', 'n', 'e', ' ', 'T', 'e', 'm', 'p', 0x4F,
+    0x29, 0x75, 0x4E, 0x91, 0x3E, 0x4F,
+    0x1F,
+    0x0C, 0x00, 0x80, 0x00, 0x64,
+    0x1E,
+    0x29, 0x55, 0x4E, 0x44, 0x41, 0xA0, 0x00, 0x00, 0x4F,
+    0x29, 0x51, 0x4E, 0x10, 0x4F,
+    0x29, 0x4B, 0x4E, 0xC4, 0x00, 0x80, 0x00, 0x64, 0x4F,
+    0x2A, 0x01, 0x2C, 0x4E, 0x22, 0x0E, 0x10, 0x4F,
+    0x1F
+};
+
+/* An unconfirmed COV notification of the Present_Value and
+   Status_Flags of an Analog Input */
+static uint8_t COV_Traffic[] = {
+    0x10, 0x02,
+    0x09, 0x12,
+    0x1C, 0x02, 0x00, 0x00, 0x05,
+    0x2C, 0x00, 0x00, 0x00, 0x01,
+    0x3A, 0x0E, 0x10,
+    0x4E,
+    0x09, 0x55, 0x2E, 0x44, 0x41, 0xB4, 0xCC, 0xCD, 0x2F,
+    0x09, 0x6F, 0x2E, 0x82, 0x04, 0x00, 0x2F,
+    0x4F
+};
+
+/* decodes every tag of the service data the way the handlers do,
+   and sums what it finds so that the decoders can be compared;
+   returns zero if the tags do not add up to the length */
+static uint32_t walk_traffic(
+    uint8_t * apdu,
+    uint32_t apdu_len,
+    bool reference)
+{
+    int (*decode_tag) (uint8_t *, uint32_t, uint8_t *, uint32_t *);
+    int (*decode_value) (uint8_t *, uint32_t, uint32_t *);
+    uint8_t tag_number = 0;
+    uint32_t len_value = 0, value = 0;
+    uint32_t sum = 1;
+    uint32_t offset = 0;
+    int len = 0;
+
+    /* called through pointers so that neither is inlined */
+    if (reference) {
+        decode_tag = decode_tag_number_and_value_safe_reference;
+        decode_value = decode_unsigned_reference;
+    } else {
+        decode_tag = decode_tag_number_and_value_safe;
+        decode_value = decode_unsigned;
+    }
+    while (offset < apdu_len) {
+        len =
+            decode_tag(&apdu[offset], apdu_len - offset, &tag_number,
+            &len_value);
+        if (len <= 0) {
+            return 0;
+        }
+        sum += tag_number + len_value;
+        if (IS_OPENING_TAG(apdu[offset]) || IS_CLOSING_TAG(apdu[offset])) {
+            offset += len;
+            continue;
+        }
+        if (!IS_CONTEXT_SPECIFIC(apdu[offset]) &&
+            (tag_number == BACNET_APPLICATION_TAG_BOOLEAN)) {
+            offset += len;
+            continue;
+        }
+        offset += len;
+        if (len_value > (apdu_len - offset)) {
+            return 0;
+        }
+        if (len_value <= 4) {
+            decode_value(&apdu[offset], len_value, &value);
+            sum += value;
+        }
+        offset += len_value;
+    }
+
+    return sum;
+}
+
+static void testBACDCodeTraffic(
+    Test * pTest)
+{
+    uint32_t sum = 0, test_sum = 0;
+    clock_t start, reference_ticks, ticks;
+    unsigned i = 0;
+    const unsigned loops = 200000;
+
+    sum = walk_traffic(&RPM_Ack_Traffic[3], sizeof(RPM_Ack_Traffic) - 3,
+        false);
+    test_sum = walk_traffic(&RPM_Ack_Traffic[3],
+        sizeof(RPM_Ack_Traffic) - 3, true);
+    ct_test(pTest, sum != 0);
+    ct_test(pTest, sum == test_sum);
+    sum = walk_traffic(&COV_Traffic[2], sizeof(COV_Traffic) - 2, false);
+    test_sum = walk_traffic(&COV_Traffic[2], sizeof(COV_Traffic) - 2, true);
+    ct_test(pTest, sum != 0);
+    ct_test(pTest, sum == test_sum);
+    /* a truncated packet fails instead of being read past its end */
+    sum = walk_traffic(&COV_Traffic[2], sizeof(COV_Traffic) - 6, false);
+    ct_test(pTest, sum == 0);
+
+    /* time the two decoders over the same traffic; on the host the
+       table decoder is about a third faster at -Os, the size build
+       of the target, and no faster than the byte decoder at -O2 */
+    test_sum = 0;
+    start = clock();
+    for (i = 0; i < loops; i++) {
+        test_sum += walk_traffic(&RPM_Ack_Traffic[3],
+            sizeof(RPM_Ack_Traffic) - 3, true);
+        test_sum += walk_traffic(&COV_Traffic[2], sizeof(COV_Traffic) - 2,
+            true);
+    }
+    reference_ticks = clock() - start;
+    sum = 0;
+    start = clock();
+    for (i = 0; i < loops; i++) {
+        sum += walk_traffic(&RPM_Ack_Traffic[3],
+            sizeof(RPM_Ack_Traffic) - 3, false);
+        sum += walk_traffic(&COV_Traffic[2], sizeof(COV_Traffic) - 2, false);
+    }
+    ticks = clock() - start;
+    ct_test(pTest, sum == test_sum);
+    printf("RPM-ACK and COV traffic, %u times: byte decoder %lu ms, "
+        "table decoder %lu ms\n", loops,
+        (unsigned long) (reference_ticks * 1000 / CLOCKS_PER_SEC),
+        (unsigned long) (ticks * 1000 / CLOCKS_PER_SEC));
+}
+
 static void testBACDCodeEnumerated(
     Test * pTest)
 {
@@ -3016,6 +3420,10 @@ void test_BACDCode(
     /* add individual tests */
     rc = ct_addTestFunction(pTest, testBACDCodeTags);
     assert(rc);
+    rc = ct_addTestFunction(pTest, testBACDCodeTagsSafe);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testBACDCodeTraffic);
+    assert(rc);
     rc = ct_addTestFunction(pTest, testBACDCodeReal);
     assert(rc);
     rc = ct_addTestFunction(pTest, testBACDCodeUnsigned);
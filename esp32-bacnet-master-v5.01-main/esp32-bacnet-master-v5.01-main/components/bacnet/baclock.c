@@ -0,0 +1,160 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "baclock.h"
+
+/** @file baclock.c  Recursive locks of the modules shared by the tasks */
+
+/**
+ * Takes the lock, waiting for as long as another task holds it.
+ * A task that holds it already takes it again, and must give it
+ * as many times as it took it.
+ *
+ * @param lock - the lock
+ */
+void baclock_take(
+    BACLOCK * lock)
+{
+#if defined(TEST)
+    pthread_t self = pthread_self();
+
+    /* only this thread ever makes the owner itself */
+    if (lock->depth && pthread_equal(lock->owner, self)) {
+        lock->depth++;
+        return;
+    }
+    (void) pthread_mutex_lock(&lock->mutex);
+    lock->owner = self;
+    lock->depth = 1;
+#else
+    if (!lock->mutex) {
+        taskENTER_CRITICAL(&lock->spinlock);
+        if (!lock->mutex) {
+            lock->mutex = xSemaphoreCreateRecursiveMutexStatic(&lock->buffer);
+        }
+        taskEXIT_CRITICAL(&lock->spinlock);
+    }
+    (void) xSemaphoreTakeRecursive(lock->mutex, portMAX_DELAY);
+#endif
+}
+
+/**
+ * Gives back the lock taken by baclock_take().
+ *
+ * @param lock - the lock
+ */
+void baclock_give(
+    BACLOCK * lock)
+{
+#if defined(TEST)
+    if (--lock->depth == 0) {
+        (void) pthread_mutex_unlock(&lock->mutex);
+    }
+#else
+    (void) xSemaphoreGiveRecursive(lock->mutex);
+#endif
+}
+
+/**
+ * @return the handle of the calling task, to tell the tasks apart
+ */
+void *baclock_task(
+    void)
+{
+#if defined(TEST)
+    return (void *) (uintptr_t) pthread_self();
+#else
+    return xTaskGetCurrentTaskHandle();
+#endif
+}
+
+#ifdef TEST
+#include <assert.h>
+#include "ctest.h"
+
+#define TEST_THREADS 4
+#define TEST_LOOPS 100000
+
+static BACLOCK Test_Lock = BACLOCK_INITIALIZER;
+static volatile uint32_t Test_Counter;
+
+static void *test_thread(
+    void *arg)
+{
+    unsigned i;
+
+    (void) arg;
+    for (i = 0; i < TEST_LOOPS; i++) {
+        baclock_take(&Test_Lock);
+        baclock_take(&Test_Lock);
+        Test_Counter = Test_Counter + 1;
+        baclock_give(&Test_Lock);
+        Test_Counter = Test_Counter + 1;
+        baclock_give(&Test_Lock);
+    }
+
+    return NULL;
+}
+
+void testBACLock(
+    Test * pTest)
+{
+    pthread_t thread[TEST_THREADS];
+    unsigned i;
+
+    for (i = 0; i < TEST_THREADS; i++) {
+        ct_test(pTest, pthread_create(&thread[i], NULL, test_thread,
+                NULL) == 0);
+    }
+    for (i = 0; i < TEST_THREADS; i++) {
+        (void) pthread_join(thread[i], NULL);
+    }
+    ct_test(pTest, Test_Counter == (2UL * TEST_THREADS * TEST_LOOPS));
+    ct_test(pTest, Test_Lock.depth == 0);
+    ct_test(pTest, baclock_task() == baclock_task());
+}
+
+#ifdef TEST_BACLOCK
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("BACnet Lock", NULL);
+    /* individual tests */
+    rc = ct_addTestFunction(pTest, testBACLock);
+    assert(rc);
+
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_BACLOCK */
+#endif /* TEST */
@@ -28,6 +28,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "bacdef.h"
 #include "bacdcode.h"
 #include "bacenum.h"
@@ -37,20 +38,28 @@
 #include "cov.h"
 #include "config.h"     /* the custom stuff */
 #include "bi.h"
+#include "device.h"
 #include "handlers.h"
+#include "objinst.h"
 
+/* the most Binary Input objects that can be created */
 #ifndef MAX_BINARY_INPUTS
-#define MAX_BINARY_INPUTS 5
+#define MAX_BINARY_INPUTS 1024
+#endif
+/* the Binary Input objects created by Binary_Input_Init(), 0..n-1 */
+#ifndef BINARY_INPUT_INIT_COUNT
+#define BINARY_INPUT_INIT_COUNT 5
 #endif
 
+static OBJINST_TABLE BI_Instances;
 /* stores the current value */
-static BACNET_BINARY_PV Present_Value[MAX_BINARY_INPUTS];
+static BACNET_BINARY_PV *Present_Value;
 /* out of service decouples physical input from Present_Value */
-static bool Out_Of_Service[MAX_BINARY_INPUTS];
+static bool *Out_Of_Service;
 /* Change of Value flag */
-static bool Change_Of_Value[MAX_BINARY_INPUTS];
+static bool *Change_Of_Value;
 /* Polarity of Input */
-static BACNET_POLARITY Polarity[MAX_BINARY_INPUTS];
+static BACNET_POLARITY *Polarity;
 
 /* These three arrays are used by the ReadPropertyMultiple handler */
 static const int Binary_Input_Properties_Required[] = {
@@ -92,67 +101,150 @@ void Binary_Input_Property_Lists(
     return;
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need validate that the */
-/* given instance exists */
-bool Binary_Input_Valid_Instance(
-    uint32_t object_instance)
+static bool Binary_Input_Resize(
+    unsigned size)
 {
-    if (object_instance < MAX_BINARY_INPUTS) {
-        return true;
+    void *data;
+
+    data = objinst_realloc(Present_Value, size * sizeof(BACNET_BINARY_PV));
+    if (!data) {
+        return false;
+    }
+    Present_Value = data;
+    data = objinst_realloc(Out_Of_Service, size * sizeof(bool));
+    if (!data) {
+        return false;
     }
+    Out_Of_Service = data;
+    data = objinst_realloc(Change_Of_Value, size * sizeof(bool));
+    if (!data) {
+        return false;
+    }
+    Change_Of_Value = data;
+    data = objinst_realloc(Polarity, size * sizeof(BACNET_POLARITY));
+    if (!data) {
+        return false;
+    }
+    Polarity = data;
 
-    return false;
+    return true;
+}
+
+static void Binary_Input_Move(
+    unsigned to,
+    unsigned from)
+{
+    Present_Value[to] = Present_Value[from];
+    Out_Of_Service[to] = Out_Of_Service[from];
+    Change_Of_Value[to] = Change_Of_Value[from];
+    Polarity[to] = Polarity[from];
+}
+
+bool Binary_Input_Valid_Instance(
+    uint32_t object_instance)
+{
+    return objinst_valid_instance(&BI_Instances, object_instance);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then count how many you have */
 unsigned Binary_Input_Count(
     void)
 {
-    return 1;
+    return objinst_count(&BI_Instances);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the instance */
-/* that correlates to the correct index */
 uint32_t Binary_Input_Index_To_Instance(
     unsigned index)
 {
-    return index;
+    return objinst_index_to_instance(&BI_Instances, index);
+}
+
+/**
+ * Creates a Binary Input object with default property values.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was created or exists already
+ */
+bool Binary_Input_Create(
+    uint32_t object_instance)
+{
+    unsigned i;
+
+    if (Binary_Input_Valid_Instance(object_instance)) {
+        return true;
+    }
+    i = objinst_add(&BI_Instances, object_instance);
+    if (i >= objinst_count(&BI_Instances)) {
+        return false;
+    }
+    Present_Value[i] = BINARY_INACTIVE;
+    Out_Of_Service[i] = false;
+    Change_Of_Value[i] = false;
+    Polarity[i] = POLARITY_NORMAL;
+    Device_Inc_Database_Revision();
+
+    return true;
+}
+
+/**
+ * Deletes a Binary Input object.  The last object takes its index.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was deleted
+ */
+bool Binary_Input_Delete(
+    uint32_t object_instance)
+{
+    if (!objinst_remove(&BI_Instances, object_instance)) {
+        return false;
+    }
+    Device_Inc_Database_Revision();
+
+    return true;
+}
+
+/**
+ * Deletes all the Binary Input objects and frees their memory.
+ */
+void Binary_Input_Cleanup(
+    void)
+{
+    objinst_cleanup(&BI_Instances);
+    free(Present_Value);
+    free(Out_Of_Service);
+    free(Change_Of_Value);
+    free(Polarity);
+    Present_Value = NULL;
+    Out_Of_Service = NULL;
+    Change_Of_Value = NULL;
+    Polarity = NULL;
 }
 
 void Binary_Input_Init(
     void)
 {
     static bool initialized = false;
-    unsigned i;
+    uint32_t instance;
 
     if (!initialized) {
         initialized = true;
 
-        /* initialize all the values */
-        for (i = 0; i < MAX_BINARY_INPUTS; i++) {
-            Present_Value[i] = BINARY_INACTIVE;
+        objinst_init(&BI_Instances, MAX_BINARY_INPUTS, Binary_Input_Resize,
+            Binary_Input_Move);
+        for (instance = 0; instance < BINARY_INPUT_INIT_COUNT; instance++) {
+            Binary_Input_Create(instance);
         }
     }
 
     return;
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the index */
-/* that correlates to the correct instance number */
+/* returns an index not less than the count if there is no such object */
 unsigned Binary_Input_Instance_To_Index(
     uint32_t object_instance)
 {
-    unsigned index = MAX_BINARY_INPUTS;
-
-    if (object_instance < MAX_BINARY_INPUTS) {
-        index = object_instance;
-    }
-
-    return index;
+    return objinst_instance_to_index(&BI_Instances, object_instance);
 }
 
 BACNET_BINARY_PV Binary_Input_Present_Value(
@@ -162,7 +254,7 @@ BACNET_BINARY_PV Binary_Input_Present_Value(
     unsigned index = 0;
 
     index = Binary_Input_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_INPUTS) {
+    if (index < objinst_count(&BI_Instances)) {
         value = Present_Value[index];
         if (Polarity[index] != POLARITY_NORMAL) {
             if (value == BINARY_INACTIVE) {
@@ -183,7 +275,7 @@ bool Binary_Input_Out_Of_Service(
     unsigned index = 0;
 
     index = Binary_Input_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_INPUTS) {
+    if (index < objinst_count(&BI_Instances)) {
         value = Out_Of_Service[index];
     }
 
@@ -197,7 +289,7 @@ bool Binary_Input_Change_Of_Value(
     unsigned index;
 
     index = Binary_Input_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_INPUTS) {
+    if (index < objinst_count(&BI_Instances)) {
         status = Change_Of_Value[index];
     }
 
@@ -210,7 +302,7 @@ void Binary_Input_Change_Of_Value_Clear(
     unsigned index;
 
     index = Binary_Input_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_INPUTS) {
+    if (index < objinst_count(&BI_Instances)) {
         Change_Of_Value[index] = false;
     }
 
@@ -278,7 +370,7 @@ bool Binary_Input_Present_Value_Set(
     bool status = false;
 
     index = Binary_Input_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_INPUTS) {
+    if (index < objinst_count(&BI_Instances)) {
         if (Polarity[index] != POLARITY_NORMAL) {
             if (value == BINARY_INACTIVE) {
                 value = BINARY_ACTIVE;
@@ -288,6 +380,7 @@ bool Binary_Input_Present_Value_Set(
         }
         if (Present_Value[index] != value) {
             Change_Of_Value[index] = true;
+            handler_cov_object_changed(OBJECT_BINARY_INPUT, object_instance);
         }
         Present_Value[index] = value;
         status = true;
@@ -303,9 +396,10 @@ void Binary_Input_Out_Of_Service_Set(
     unsigned index = 0;
 
     index = Binary_Input_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_INPUTS) {
+    if (index < objinst_count(&BI_Instances)) {
         if (Out_Of_Service[index] != value) {
             Change_Of_Value[index] = true;
+            handler_cov_object_changed(OBJECT_BINARY_INPUT, object_instance);
         }
         Out_Of_Service[index] = value;
     }
@@ -317,12 +411,12 @@ bool Binary_Input_Object_Name(
     uint32_t object_instance,
     BACNET_CHARACTER_STRING * object_name)
 {
-    static char text_string[32] = "";   /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
     unsigned index = 0;
 
     index = Binary_Input_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_INPUTS) {
+    if (index < objinst_count(&BI_Instances)) {
         sprintf(text_string, "BINARY INPUT %lu",
             (unsigned long) object_instance);
         status = characterstring_init_ansi(object_name, text_string);
@@ -338,7 +432,7 @@ BACNET_POLARITY Binary_Input_Polarity(
     unsigned index = 0;
 
     index = Binary_Input_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_INPUTS) {
+    if (index < objinst_count(&BI_Instances)) {
         polarity = Polarity[index];
     }
 
@@ -353,7 +447,7 @@ bool Binary_Input_Polarity_Set(
     unsigned index = 0;
 
     index = Binary_Input_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_INPUTS) {
+    if (index < objinst_count(&BI_Instances)) {
         Polarity[index] = polarity;
     }
 
@@ -0,0 +1,373 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "config.h"
+#include "bacdcode.h"
+#include "bip6.h"
+#include "bvlc6.h"
+#include "vmac.h"
+#include "device.h"
+#include "net.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_event.h"
+
+/** @file bip6.c  BACnet/IPv6 datalink on the lwIP sockets of the ESP32 */
+
+#define TAG "BIP6"
+
+static int BIP6_Socket = -1;
+/* this node: the global address if there is one, else the link-local
+   one, and the UDP port */
+static BACNET_IP6_ADDRESS BIP6_Addr;
+/* the BACnet/IPv6 multicast group, and the same UDP port */
+static BACNET_IP6_ADDRESS BIP6_Broadcast_Addr;
+static esp_netif_t *BIP6_Netif;
+
+/* link-local addresses need the interface they are on */
+static bool bip6_link_local(
+    BACNET_IP6_ADDRESS * addr)
+{
+    return (((addr->address[0] == 0xFE) &&
+            ((addr->address[1] & 0xC0) == 0x80)) ||
+        ((addr->address[0] == 0xFF) && ((addr->address[1] & 0x0F) <= 2)));
+}
+
+static void bip6_sockaddr(
+    struct sockaddr_in6 *sin6,
+    BACNET_IP6_ADDRESS * addr)
+{
+    memset(sin6, 0, sizeof(struct sockaddr_in6));
+    sin6->sin6_family = AF_INET6;
+    sin6->sin6_port = htons(addr->port);
+    memcpy(&sin6->sin6_addr, addr->address, IP6_ADDRESS_MAX);
+    if (BIP6_Netif && bip6_link_local(addr)) {
+        sin6->sin6_scope_id = esp_netif_get_netif_impl_index(BIP6_Netif);
+    }
+}
+
+static void bip6_ip6_addr_set(
+    esp_ip6_addr_t * ip6)
+{
+    memcpy(BIP6_Addr.address, ip6->addr, IP6_ADDRESS_MAX);
+}
+
+static void got_ip6_event_handler(
+    void *arg,
+    esp_event_base_t event_base,
+    int32_t event_id,
+    void *event_data)
+{
+    ip_event_got_ip6_t *event = (ip_event_got_ip6_t *) event_data;
+    esp_ip6_addr_t ip6 = { 0 };
+
+    (void) arg;
+    (void) event_base;
+    if ((event_id != IP_EVENT_GOT_IP6) || (event->esp_netif != BIP6_Netif)) {
+        return;
+    }
+    /* a global address, once there is one, is kept over a link-local */
+    if (esp_netif_get_ip6_global(BIP6_Netif, &ip6) != ESP_OK) {
+        ip6 = event->ip6_info.ip;
+    }
+    bip6_ip6_addr_set(&ip6);
+    ESP_LOGI(TAG, "IPv6 Address: " IPV6STR, IPV62STR(ip6));
+}
+
+/**
+ * Sets the interface, and this node's address from it
+ *
+ * @param ifname - the esp_netif key; NULL for the WiFi station
+ */
+void bip6_set_interface(
+    char *ifname)
+{
+    esp_ip6_addr_t ip6 = { 0 };
+
+    BIP6_Netif =
+        esp_netif_get_handle_from_ifkey(ifname ? ifname : "WIFI_STA_DEF");
+    if (!BIP6_Netif) {
+        return;
+    }
+    if ((esp_netif_get_ip6_global(BIP6_Netif, &ip6) == ESP_OK) ||
+        (esp_netif_get_ip6_linklocal(BIP6_Netif, &ip6) == ESP_OK)) {
+        bip6_ip6_addr_set(&ip6);
+        ESP_LOGI(TAG, "IPv6 Address: " IPV6STR, IPV62STR(ip6));
+    }
+    ESP_LOGI(TAG, "UDP Port: 0x%04X [%hu]", BIP6_Addr.port, BIP6_Addr.port);
+}
+
+bool bip6_set_addr(
+    BACNET_IP6_ADDRESS * addr)
+{
+    return bvlc6_address_copy(&BIP6_Addr, addr);
+}
+
+bool bip6_get_addr(
+    BACNET_IP6_ADDRESS * addr)
+{
+    return bvlc6_address_copy(addr, &BIP6_Addr);
+}
+
+/**
+ * Sets the UDP port, of this node and of the multicast group
+ *
+ * @param port - the port, in host byte order
+ */
+void bip6_set_port(
+    uint16_t port)
+{
+    BIP6_Addr.port = port;
+    BIP6_Broadcast_Addr.port = port;
+}
+
+uint16_t bip6_get_port(
+    void)
+{
+    return BIP6_Addr.port;
+}
+
+bool bip6_set_broadcast_addr(
+    BACNET_IP6_ADDRESS * addr)
+{
+    uint16_t port = BIP6_Broadcast_Addr.port;
+    bool status = bvlc6_address_copy(&BIP6_Broadcast_Addr, addr);
+
+    /* the port is the one of this node */
+    BIP6_Broadcast_Addr.port = port;
+
+    return status;
+}
+
+bool bip6_get_broadcast_addr(
+    BACNET_IP6_ADDRESS * addr)
+{
+    return bvlc6_address_copy(addr, &BIP6_Broadcast_Addr);
+}
+
+bool bip6_address_match_self(
+    BACNET_IP6_ADDRESS * addr)
+{
+    return !bvlc6_address_different(addr, &BIP6_Addr);
+}
+
+/**
+ * Sends a BVLL message to a B/IPv6 address
+ *
+ * @param addr - the address and port
+ * @param mtu - the message
+ * @param mtu_len - its length
+ *
+ * @return number of bytes sent, or negative on failure
+ */
+int bip6_send_mpdu(
+    BACNET_IP6_ADDRESS * addr,
+    uint8_t * mtu,
+    uint16_t mtu_len)
+{
+    struct sockaddr_in6 bip6_dest;
+
+    if (BIP6_Socket < 0) {
+        return BIP6_Socket;
+    }
+    bip6_sockaddr(&bip6_dest, addr);
+
+    return sendto(BIP6_Socket, (char *) mtu, mtu_len, 0,
+        (struct sockaddr *) &bip6_dest, sizeof(bip6_dest));
+}
+
+/**
+ * The send() function for BACnet/IPv6 (Annex U)
+ *
+ * @param dest - destination address; its MAC is the VMAC of the node
+ * @param npdu_data - the NPDU header information (not used)
+ * @param pdu - the NPDU to send
+ * @param pdu_len - its length
+ *
+ * @return number of bytes sent, or negative on failure
+ */
+int bip6_send_pdu(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    return bvlc6_send_pdu(dest, npdu_data, pdu, pdu_len);
+}
+
+/**
+ * The receive() function for BACnet/IPv6: receives one message,
+ * handles its BVLL, and leaves its NPDU at the start of pdu[]
+ *
+ * @param src - the VMAC of the sender of the NPDU
+ * @param pdu - the buffer, which gets the whole message first
+ * @param max_pdu - its size
+ * @param timeout - milliseconds to wait for a message
+ *
+ * @return the number of octets in the NPDU, or zero if there is none
+ */
+uint16_t bip6_receive(
+    BACNET_ADDRESS * src,
+    uint8_t * pdu,
+    uint16_t max_pdu,
+    unsigned timeout)
+{
+    BACNET_IP6_ADDRESS addr = { { 0 }, 0 };
+    struct sockaddr_in6 sin6 = { 0 };
+    socklen_t sin6_len = sizeof(sin6);
+    struct timeval select_timeout;
+    fd_set read_fds;
+    int received_bytes = 0;
+    uint16_t npdu_len = 0;
+    int offset = 0;
+
+    if (BIP6_Socket < 0) {
+        return 0;
+    }
+    select_timeout.tv_sec = timeout / 1000;
+    select_timeout.tv_usec = 1000 * (timeout % 1000);
+    FD_ZERO(&read_fds);
+    FD_SET(BIP6_Socket, &read_fds);
+    if (select(BIP6_Socket + 1, &read_fds, NULL, NULL, &select_timeout) <= 0) {
+        return 0;
+    }
+    received_bytes = recvfrom(BIP6_Socket, (char *) &pdu[0], max_pdu, 0,
+        (struct sockaddr *) &sin6, &sin6_len);
+    if (received_bytes <= 0) {
+        return 0;
+    }
+    memcpy(addr.address, &sin6.sin6_addr, IP6_ADDRESS_MAX);
+    addr.port = ntohs(sin6.sin6_port);
+    /* our own multicasts come back */
+    if (bip6_address_match_self(&addr)) {
+        return 0;
+    }
+    offset = bvlc6_handler(&addr, src, pdu, (uint16_t) received_bytes);
+    if (offset > 0) {
+        (void) decode_unsigned16(&pdu[2], &npdu_len);
+        npdu_len -= (uint16_t) offset;
+        memmove(&pdu[0], &pdu[offset], npdu_len);
+    }
+
+    return npdu_len;
+}
+
+/**
+ * The VMAC of this node is its device instance
+ */
+void bip6_get_my_address(
+    BACNET_ADDRESS * my_address)
+{
+    bvlc6_vmac_address_set(my_address, Device_Object_Instance_Number());
+}
+
+void bip6_get_broadcast_address(
+    BACNET_ADDRESS * dest)
+{
+    if (dest) {
+        memset(dest, 0, sizeof(BACNET_ADDRESS));
+        dest->net = BACNET_BROADCAST_NETWORK;
+    }
+}
+
+/** Initialize the BACnet/IPv6 services at the given interface.
+ * @ingroup DLBIP6
+ * -# Gets the IPv6 address of the interface
+ * -# Opens a UDP socket, bound to the BACnet/IPv6 port
+ * -# Joins the BACnet/IPv6 multicast group, for broadcasts
+ *
+ * @param ifname [in] The esp_netif key of the interface to use.
+ *        If NULL, the WiFi station is used.
+ * @return True if the socket is open for BACnet/IPv6
+ */
+bool bip6_init(
+    char *ifname)
+{
+    struct sockaddr_in6 sin6 = { 0 };
+    struct ipv6_mreq join = { 0 };
+    int sockopt = 1;
+
+    if (BIP6_Addr.port == 0) {
+        bip6_set_port(0xBAC0);
+    }
+    if (BIP6_Broadcast_Addr.address[0] != 0xFF) {
+        bvlc6_address_set(&BIP6_Broadcast_Addr, BIP6_MULTICAST_SCOPE, 0,
+            0, 0, 0, 0, 0, BIP6_MULTICAST_GROUP_ID);
+    }
+    bvlc6_init();
+    bip6_set_interface(ifname);
+    BIP6_Socket = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    if (BIP6_Socket < 0) {
+        return false;
+    }
+    if (setsockopt(BIP6_Socket, SOL_SOCKET, SO_REUSEADDR, &sockopt,
+            sizeof(sockopt)) < 0) {
+        ESP_LOGE(TAG, "SO_REUSEADDR failed");
+        bip6_cleanup();
+        return false;
+    }
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_port = htons(BIP6_Addr.port);
+    sin6.sin6_addr = in6addr_any;
+    if (bind(BIP6_Socket, (const struct sockaddr *) &sin6,
+            sizeof(sin6)) < 0) {
+        ESP_LOGE(TAG, "bind failed");
+        bip6_cleanup();
+        return false;
+    }
+    memcpy(&join.ipv6mr_multiaddr, BIP6_Broadcast_Addr.address,
+        IP6_ADDRESS_MAX);
+    if (BIP6_Netif) {
+        join.ipv6mr_interface = esp_netif_get_netif_impl_index(BIP6_Netif);
+    }
+    if (setsockopt(BIP6_Socket, IPPROTO_IPV6, IPV6_JOIN_GROUP, &join,
+            sizeof(join)) < 0) {
+        ESP_LOGE(TAG, "IPV6_JOIN_GROUP failed");
+        bip6_cleanup();
+        return false;
+    }
+    /* follow the address when SLAAC or DHCPv6 hands out a new one */
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_GOT_IP6,
+            &got_ip6_event_handler, NULL));
+
+    return true;
+}
+
+/** Cleanup and close out the BACnet/IPv6 services by closing the socket.
+ * @ingroup DLBIP6
+ */
+void bip6_cleanup(
+    void)
+{
+    if (BIP6_Socket >= 0) {
+        close(BIP6_Socket);
+    }
+    BIP6_Socket = -1;
+    (void) esp_event_handler_unregister(IP_EVENT, IP_EVENT_GOT_IP6,
+        &got_ip6_event_handler);
+    VMAC_Cleanup();
+}
@@ -28,6 +28,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "bacdef.h"
 #include "bacdcode.h"
 #include "bacenum.h"
@@ -36,21 +38,30 @@
 #include "rp.h"
 #include "wp.h"
 #include "bo.h"
+#include "device.h"
 #include "handlers.h"
+#include "objinst.h"
 
+/* the most Binary Output objects that can be created */
 #ifndef MAX_BINARY_OUTPUTS
-#define MAX_BINARY_OUTPUTS 4
+#define MAX_BINARY_OUTPUTS 1024
+#endif
+/* the Binary Output objects created by Binary_Output_Init(), 0..n-1 */
+#ifndef BINARY_OUTPUT_INIT_COUNT
+#define BINARY_OUTPUT_INIT_COUNT 4
 #endif
 
 /* When all the priorities are level null, the present value returns */
 /* the Relinquish Default value */
 #define RELINQUISH_DEFAULT BINARY_INACTIVE
+/* largest encoding of one Priority_Array element, an ENUMERATED */
+#define BO_PRIORITY_ELEMENT_MAX 2
+static OBJINST_TABLE BO_Instances;
 /* Here is our Priority Array.*/
-static BACNET_BINARY_PV
-    Binary_Output_Level[MAX_BINARY_OUTPUTS][BACNET_MAX_PRIORITY];
+static BACNET_BINARY_PV(*Binary_Output_Level)[BACNET_MAX_PRIORITY];
 /* Writable out-of-service allows others to play with our Present Value */
 /* without changing the physical output */
-static bool Out_Of_Service[MAX_BINARY_OUTPUTS];
+static bool *Out_Of_Service;
 
 /* These three arrays are used by the ReadPropertyMultiple handler */
 static const int Binary_Output_Properties_Required[] = {
@@ -93,67 +104,137 @@ void Binary_Output_Property_Lists(
     return;
 }
 
-void Binary_Output_Init(
-    void)
+static bool Binary_Output_Resize(
+    unsigned size)
 {
-    unsigned i, j;
-    static bool initialized = false;
-
-    if (!initialized) {
-        initialized = true;
+    void *data;
 
-        /* initialize all the analog output priority arrays to NULL */
-        for (i = 0; i < MAX_BINARY_OUTPUTS; i++) {
-            for (j = 0; j < BACNET_MAX_PRIORITY; j++) {
-                Binary_Output_Level[i][j] = BINARY_NULL;
-            }
-        }
+    data =
+        objinst_realloc(Binary_Output_Level,
+        size * sizeof(Binary_Output_Level[0]));
+    if (!data) {
+        return false;
+    }
+    Binary_Output_Level = data;
+    data = objinst_realloc(Out_Of_Service, size * sizeof(bool));
+    if (!data) {
+        return false;
     }
+    Out_Of_Service = data;
 
-    return;
+    return true;
+}
+
+static void Binary_Output_Move(
+    unsigned to,
+    unsigned from)
+{
+    memcpy(Binary_Output_Level[to], Binary_Output_Level[from],
+        sizeof(Binary_Output_Level[0]));
+    Out_Of_Service[to] = Out_Of_Service[from];
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need validate that the */
-/* given instance exists */
 bool Binary_Output_Valid_Instance(
     uint32_t object_instance)
 {
-    if (object_instance < MAX_BINARY_OUTPUTS)
-        return true;
-
-    return false;
+    return objinst_valid_instance(&BO_Instances, object_instance);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then count how many you have */
 unsigned Binary_Output_Count(
     void)
 {
-    return MAX_BINARY_OUTPUTS;
+    return objinst_count(&BO_Instances);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the instance */
-/* that correlates to the correct index */
 uint32_t Binary_Output_Index_To_Instance(
     unsigned index)
 {
-    return index;
+    return objinst_index_to_instance(&BO_Instances, index);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the index */
-/* that correlates to the correct instance number */
+/* returns an index not less than the count if there is no such object */
 unsigned Binary_Output_Instance_To_Index(
     uint32_t object_instance)
 {
-    unsigned index = MAX_BINARY_OUTPUTS;
+    return objinst_instance_to_index(&BO_Instances, object_instance);
+}
 
-    if (object_instance < MAX_BINARY_OUTPUTS)
-        index = object_instance;
+/**
+ * Creates a Binary Output object with its priority array all NULL.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was created or exists already
+ */
+bool Binary_Output_Create(
+    uint32_t object_instance)
+{
+    unsigned i, j;
 
-    return index;
+    if (Binary_Output_Valid_Instance(object_instance)) {
+        return true;
+    }
+    i = objinst_add(&BO_Instances, object_instance);
+    if (i >= objinst_count(&BO_Instances)) {
+        return false;
+    }
+    for (j = 0; j < BACNET_MAX_PRIORITY; j++) {
+        Binary_Output_Level[i][j] = BINARY_NULL;
+    }
+    Out_Of_Service[i] = false;
+    Device_Inc_Database_Revision();
+
+    return true;
+}
+
+/**
+ * Deletes a Binary Output object.  The last object takes its index.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was deleted
+ */
+bool Binary_Output_Delete(
+    uint32_t object_instance)
+{
+    if (!objinst_remove(&BO_Instances, object_instance)) {
+        return false;
+    }
+    Device_Inc_Database_Revision();
+
+    return true;
+}
+
+/**
+ * Deletes all the Binary Output objects and frees their memory.
+ */
+void Binary_Output_Cleanup(
+    void)
+{
+    objinst_cleanup(&BO_Instances);
+    free(Binary_Output_Level);
+    free(Out_Of_Service);
+    Binary_Output_Level = NULL;
+    Out_Of_Service = NULL;
+}
+
+void Binary_Output_Init(
+    void)
+{
+    static bool initialized = false;
+    uint32_t instance;
+
+    if (!initialized) {
+        initialized = true;
+
+        objinst_init(&BO_Instances, MAX_BINARY_OUTPUTS, Binary_Output_Resize,
+            Binary_Output_Move);
+        for (instance = 0; instance < BINARY_OUTPUT_INIT_COUNT; instance++) {
+            Binary_Output_Create(instance);
+        }
+    }
+
+    return;
 }
 
 BACNET_BINARY_PV Binary_Output_Present_Value(
@@ -164,7 +245,7 @@ BACNET_BINARY_PV Binary_Output_Present_Value(
     unsigned i = 0;
 
     index = Binary_Output_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_OUTPUTS) {
+    if (index < objinst_count(&BO_Instances)) {
         for (i = 0; i < BACNET_MAX_PRIORITY; i++) {
             if (Binary_Output_Level[index][i] != BINARY_NULL) {
                 value = Binary_Output_Level[index][i];
@@ -183,7 +264,7 @@ bool Binary_Output_Out_Of_Service(
     unsigned index = 0;
 
     index = Binary_Output_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_OUTPUTS) {
+    if (index < objinst_count(&BO_Instances)) {
         value = Out_Of_Service[index];
     }
 
@@ -195,10 +276,10 @@ bool Binary_Output_Object_Name(
     uint32_t object_instance,
     BACNET_CHARACTER_STRING * object_name)
 {
-    static char text_string[32] = "";   /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
-    if (object_instance < MAX_BINARY_OUTPUTS) {
+    if (Binary_Output_Valid_Instance(object_instance)) {
         sprintf(text_string, "BINARY OUTPUT %lu",
             (unsigned long) object_instance);
         status = characterstring_init_ansi(object_name, text_string);
@@ -284,7 +365,14 @@ int Binary_Output_Read_Property(
                 object_index =
                     Binary_Output_Instance_To_Index(rpdata->object_instance);
                 for (i = 0; i < BACNET_MAX_PRIORITY; i++) {
-                    /* FIXME: check if we have room before adding it to APDU */
+                    /* check if we have room before adding it to APDU */
+                    if ((apdu_len + BO_PRIORITY_ELEMENT_MAX) >
+                        rpdata->application_data_len) {
+                        rpdata->error_code =
+                            ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
+                        apdu_len = BACNET_STATUS_ABORT;
+                        break;
+                    }
                     if (Binary_Output_Level[object_index][i] == BINARY_NULL)
                         len = encode_application_null(&apdu[apdu_len]);
                     else {
@@ -293,15 +381,7 @@ int Binary_Output_Read_Property(
                             encode_application_enumerated(&apdu[apdu_len],
                             present_value);
                     }
-                    /* add it if we have room */
-                    if ((apdu_len + len) < MAX_APDU)
-                        apdu_len += len;
-                    else {
-                        rpdata->error_code =
-                            ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
-                        apdu_len = BACNET_STATUS_ABORT;
-                        break;
-                    }
+                    apdu_len += len;
                 }
             } else {
                 object_index =
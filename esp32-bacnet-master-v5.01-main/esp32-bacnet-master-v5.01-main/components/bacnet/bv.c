@@ -28,6 +28,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "bacdef.h"
 #include "bacdcode.h"
 #include "bacenum.h"
@@ -36,21 +38,30 @@
 #include "wp.h"
 #include "rp.h"
 #include "bv.h"
+#include "device.h"
 #include "handlers.h"
+#include "objinst.h"
 
+/* the most Binary Value objects that can be created */
 #ifndef MAX_BINARY_VALUES
-#define MAX_BINARY_VALUES 10
+#define MAX_BINARY_VALUES 1024
+#endif
+/* the Binary Value objects created by Binary_Value_Init(), 0..n-1 */
+#ifndef BINARY_VALUE_INIT_COUNT
+#define BINARY_VALUE_INIT_COUNT 10
 #endif
 
 /* When all the priorities are level null, the present value returns */
 /* the Relinquish Default value */
 #define RELINQUISH_DEFAULT BINARY_INACTIVE
+/* largest encoding of one Priority_Array element, an ENUMERATED */
+#define BV_PRIORITY_ELEMENT_MAX 2
+static OBJINST_TABLE BV_Instances;
 /* Here is our Priority Array.*/
-static BACNET_BINARY_PV
-    Binary_Value_Level[MAX_BINARY_VALUES][BACNET_MAX_PRIORITY];
+static BACNET_BINARY_PV(*Binary_Value_Level)[BACNET_MAX_PRIORITY];
 /* Writable out-of-service allows others to play with our Present Value */
 /* without changing the physical output */
-static bool Out_Of_Service[MAX_BINARY_VALUES];
+static bool *Out_Of_Service;
 
 /* These three arrays are used by the ReadPropertyMultiple handler */
 static const int Binary_Value_Properties_Required[] = {
@@ -90,67 +101,137 @@ void Binary_Value_Property_Lists(
     return;
 }
 
-void Binary_Value_Init(
-    void)
+static bool Binary_Value_Resize(
+    unsigned size)
 {
-    unsigned i, j;
-    static bool initialized = false;
-
-    if (!initialized) {
-        initialized = true;
+    void *data;
 
-        /* initialize all the analog output priority arrays to NULL */
-        for (i = 0; i < MAX_BINARY_VALUES; i++) {
-            for (j = 0; j < BACNET_MAX_PRIORITY; j++) {
-                Binary_Value_Level[i][j] = BINARY_NULL;
-            }
-        }
+    data =
+        objinst_realloc(Binary_Value_Level,
+        size * sizeof(Binary_Value_Level[0]));
+    if (!data) {
+        return false;
+    }
+    Binary_Value_Level = data;
+    data = objinst_realloc(Out_Of_Service, size * sizeof(bool));
+    if (!data) {
+        return false;
     }
+    Out_Of_Service = data;
 
-    return;
+    return true;
+}
+
+static void Binary_Value_Move(
+    unsigned to,
+    unsigned from)
+{
+    memcpy(Binary_Value_Level[to], Binary_Value_Level[from],
+        sizeof(Binary_Value_Level[0]));
+    Out_Of_Service[to] = Out_Of_Service[from];
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need validate that the */
-/* given instance exists */
 bool Binary_Value_Valid_Instance(
     uint32_t object_instance)
 {
-    if (object_instance < MAX_BINARY_VALUES)
-        return true;
-
-    return false;
+    return objinst_valid_instance(&BV_Instances, object_instance);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then count how many you have */
 unsigned Binary_Value_Count(
     void)
 {
-    return 1;
+    return objinst_count(&BV_Instances);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the instance */
-/* that correlates to the correct index */
 uint32_t Binary_Value_Index_To_Instance(
     unsigned index)
 {
-    return index;
+    return objinst_index_to_instance(&BV_Instances, index);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the index */
-/* that correlates to the correct instance number */
+/* returns an index not less than the count if there is no such object */
 unsigned Binary_Value_Instance_To_Index(
     uint32_t object_instance)
 {
-    unsigned index = MAX_BINARY_VALUES;
+    return objinst_instance_to_index(&BV_Instances, object_instance);
+}
 
-    if (object_instance < MAX_BINARY_VALUES)
-        index = object_instance;
+/**
+ * Creates a Binary Value object with its priority array all NULL.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was created or exists already
+ */
+bool Binary_Value_Create(
+    uint32_t object_instance)
+{
+    unsigned i, j;
 
-    return index;
+    if (Binary_Value_Valid_Instance(object_instance)) {
+        return true;
+    }
+    i = objinst_add(&BV_Instances, object_instance);
+    if (i >= objinst_count(&BV_Instances)) {
+        return false;
+    }
+    for (j = 0; j < BACNET_MAX_PRIORITY; j++) {
+        Binary_Value_Level[i][j] = BINARY_NULL;
+    }
+    Out_Of_Service[i] = false;
+    Device_Inc_Database_Revision();
+
+    return true;
+}
+
+/**
+ * Deletes a Binary Value object.  The last object takes its index.
+ *
+ * @param  object_instance - object-instance number of the object
+ *
+ * @return true if the object was deleted
+ */
+bool Binary_Value_Delete(
+    uint32_t object_instance)
+{
+    if (!objinst_remove(&BV_Instances, object_instance)) {
+        return false;
+    }
+    Device_Inc_Database_Revision();
+
+    return true;
+}
+
+/**
+ * Deletes all the Binary Value objects and frees their memory.
+ */
+void Binary_Value_Cleanup(
+    void)
+{
+    objinst_cleanup(&BV_Instances);
+    free(Binary_Value_Level);
+    free(Out_Of_Service);
+    Binary_Value_Level = NULL;
+    Out_Of_Service = NULL;
+}
+
+void Binary_Value_Init(
+    void)
+{
+    static bool initialized = false;
+    uint32_t instance;
+
+    if (!initialized) {
+        initialized = true;
+
+        objinst_init(&BV_Instances, MAX_BINARY_VALUES, Binary_Value_Resize,
+            Binary_Value_Move);
+        for (instance = 0; instance < BINARY_VALUE_INIT_COUNT; instance++) {
+            Binary_Value_Create(instance);
+        }
+    }
+
+    return;
 }
 
 BACNET_BINARY_PV Binary_Value_Present_Value(
@@ -161,7 +242,7 @@ BACNET_BINARY_PV Binary_Value_Present_Value(
     unsigned i = 0;
 
     index = Binary_Value_Instance_To_Index(object_instance);
-    if (index < MAX_BINARY_VALUES) {
+    if (index < objinst_count(&BV_Instances)) {
         for (i = 0; i < BACNET_MAX_PRIORITY; i++) {
             if (Binary_Value_Level[index][i] != BINARY_NULL) {
                 value = Binary_Value_Level[index][i];
@@ -178,10 +259,10 @@ bool Binary_Value_Object_Name(
     uint32_t object_instance,
     BACNET_CHARACTER_STRING * object_name)
 {
-    static char text_string[32] = "";   /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
-    if (object_instance < MAX_BINARY_VALUES) {
+    if (Binary_Value_Valid_Instance(object_instance)) {
         sprintf(text_string, "BINARY VALUE %lu",
             (unsigned long) object_instance);
         status = characterstring_init_ansi(object_name, text_string);
@@ -197,7 +278,7 @@ bool Binary_Value_Out_Of_Service(
     bool oos_flag = false;
 
     index = Binary_Value_Instance_To_Index(instance);
-    if (index < MAX_BINARY_VALUES) {
+    if (index < objinst_count(&BV_Instances)) {
         oos_flag = Out_Of_Service[index];
     }
 
@@ -211,7 +292,7 @@ void Binary_Value_Out_Of_Service_Set(
     unsigned index = 0;
 
     index = Binary_Value_Instance_To_Index(instance);
-    if (index < MAX_BINARY_VALUES) {
+    if (index < objinst_count(&BV_Instances)) {
         Out_Of_Service[index] = oos_flag;
     }
 }
@@ -288,7 +369,14 @@ int Binary_Value_Read_Property(
                 object_index =
                     Binary_Value_Instance_To_Index(rpdata->object_instance);
                 for (i = 0; i < BACNET_MAX_PRIORITY; i++) {
-                    /* FIXME: check if we have room before adding it to APDU */
+                    /* check if we have room before adding it to APDU */
+                    if ((apdu_len + BV_PRIORITY_ELEMENT_MAX) >
+                        rpdata->application_data_len) {
+                        rpdata->error_code =
+                            ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
+                        apdu_len = BACNET_STATUS_ABORT;
+                        break;
+                    }
                     if (Binary_Value_Level[object_index][i] == BINARY_NULL)
                         len = encode_application_null(&apdu[apdu_len]);
                     else {
@@ -297,15 +385,7 @@ int Binary_Value_Read_Property(
                             encode_application_enumerated(&apdu[apdu_len],
                             present_value);
                     }
-                    /* add it if we have room */
-                    if ((apdu_len + len) < MAX_APDU)
-                        apdu_len += len;
-                    else {
-                        rpdata->error_code =
-                            ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
-                        apdu_len = BACNET_STATUS_ABORT;
-                        break;
-                    }
+                    apdu_len += len;
                 }
             } else {
                 object_index =
@@ -39,6 +39,7 @@
 #include "bacdcode.h"
 #include "bacint.h"
 #include "bvlc.h"
+#include "baclock.h"
 #ifndef DEBUG_ENABLED
 #define DEBUG_ENABLED 0
 #endif
@@ -60,6 +61,10 @@ static struct in_addr BVLC_Global_Address;
 /** Flag to indicate if NAT handling is enabled/disabled */
 static bool BVLC_NAT_Handling = false;
 
+/* the BDT and FDT: the task receiving on the port changes them, as
+   does the one that runs the maintenance timer */
+static BACLOCK BVLC_Lock = BACLOCK_INITIALIZER;
+
 /** result from a client request */
 BACNET_BVLC_RESULT BVLC_Result_Code = BVLC_RESULT_SUCCESSFUL_COMPLETION;
 
@@ -96,8 +101,13 @@ typedef struct {
     uint16_t dest_port;
     /* seconds for valid entry lifetime */
     uint16_t time_to_live;
-    /* our counter */
-    time_t seconds_remaining;   /* includes 30 second grace period */
+    /* FDT clock reading when the entry is purged;
+       includes 30 second grace period */
+    uint32_t expire_time;
+    /* links, as entry number + 1 so that 0 ends a chain */
+    uint16_t hash_next; /* IP:port hash chain, or free list */
+    uint16_t wheel_next;        /* timing wheel slot */
+    uint16_t wheel_prev;
 } FD_TABLE_ENTRY;
 
 #ifndef MAX_FD_ENTRIES
@@ -105,6 +115,165 @@ typedef struct {
 #endif
 static FD_TABLE_ENTRY FD_Table[MAX_FD_ENTRIES];
 
+/* The FDT is indexed two ways, so that a registration, a delete or an
+   expiry never scans the table: a hash of the B/IP address finds an
+   entry, and a timing wheel of one second slots holds each entry in the
+   slot of the second it expires, modulo the wheel size.  Each second
+   only one slot is visited. */
+#ifndef FD_HASH_SIZE
+#define FD_HASH_SIZE 128        /* power of two */
+#endif
+#ifndef FD_WHEEL_SIZE
+#define FD_WHEEL_SIZE 64        /* power of two */
+#endif
+#if (MAX_FD_ENTRIES >= 0xFFFF)
+#error "MAX_FD_ENTRIES too large for the FDT index"
+#endif
+static uint16_t FD_Hash[FD_HASH_SIZE];
+static uint16_t FD_Wheel[FD_WHEEL_SIZE];
+/* entries below this have been used; those not valid are on the free list */
+static uint16_t FD_Table_Used;
+static uint16_t FD_Free_List;
+/* seconds counted by bvlc_maintenance_timer() */
+static uint32_t FD_Clock;
+
+/* The BDT and FDT compiled down to the B/IP addresses that a broadcast
+   is forwarded to, with our own address already left out.  The lists are
+   rebuilt on the next broadcast after either table, the NAT setting or
+   our own address changes, so forwarding is a plain walk of the list. */
+typedef struct {
+    struct in_addr address;     /* in network format */
+    uint16_t port;      /* in network format */
+} BVLC_FORWARD_ENTRY;
+
+/* directed broadcast or unicast address of each peer BBMD */
+static BVLC_FORWARD_ENTRY BDT_Forward_List[MAX_BBMD_ENTRIES];
+static unsigned BDT_Forward_Count;
+/* peer BBMDs with an all ones mask: they unicast their broadcasts to us */
+static BVLC_FORWARD_ENTRY BDT_Unicast_Peer_List[MAX_BBMD_ENTRIES];
+static unsigned BDT_Unicast_Peer_Count;
+static bool BDT_Forward_List_Valid;
+/* registered foreign devices */
+static BVLC_FORWARD_ENTRY FDT_Forward_List[MAX_FD_ENTRIES];
+static unsigned FDT_Forward_Count;
+static bool FDT_Forward_List_Valid;
+/* our own address when the lists were built */
+static uint32_t Forward_List_Addr;
+static uint16_t Forward_List_Port;
+
+/* a Forwarded-NPDU, encoded once for every destination */
+static uint8_t Forward_MTU[BIP_MPDU_MAX];
+
+
+static unsigned bvlc_fdt_hash(
+    uint32_t address,
+    uint16_t port)
+{
+    uint32_t key = address ^ ((uint32_t) port << 16) ^ port;
+
+    key ^= key >> 16;
+    key *= 0x45D9F3BUL;
+    key ^= key >> 16;
+
+    return key & (FD_HASH_SIZE - 1);
+}
+
+/** Finds a Foreign Device in the FDT
+ *
+ * @param address - B/IP address in network order
+ * @param port - UDP port in network order
+ *
+ * @return the FDT entry, or NULL if the device is not registered
+ */
+static FD_TABLE_ENTRY *bvlc_fdt_find(
+    uint32_t address,
+    uint16_t port)
+{
+    uint16_t link = FD_Hash[bvlc_fdt_hash(address, port)];
+    FD_TABLE_ENTRY *entry = NULL;
+
+    while (link) {
+        entry = &FD_Table[link - 1];
+        if ((entry->dest_address.s_addr == address) &&
+            (entry->dest_port == port)) {
+            return entry;
+        }
+        link = entry->hash_next;
+    }
+
+    return NULL;
+}
+
+/* files an entry in the wheel slot of its expiry second */
+static void bvlc_fdt_wheel_insert(
+    FD_TABLE_ENTRY * entry)
+{
+    uint16_t link = (uint16_t) (entry - &FD_Table[0]) + 1;
+    uint16_t *slot = &FD_Wheel[entry->expire_time & (FD_WHEEL_SIZE - 1)];
+
+    entry->wheel_prev = 0;
+    entry->wheel_next = *slot;
+    if (*slot) {
+        FD_Table[*slot - 1].wheel_prev = link;
+    }
+    *slot = link;
+}
+
+static void bvlc_fdt_wheel_remove(
+    FD_TABLE_ENTRY * entry)
+{
+    if (entry->wheel_prev) {
+        FD_Table[entry->wheel_prev - 1].wheel_next = entry->wheel_next;
+    } else {
+        FD_Wheel[entry->expire_time & (FD_WHEEL_SIZE - 1)] =
+            entry->wheel_next;
+    }
+    if (entry->wheel_next) {
+        FD_Table[entry->wheel_next - 1].wheel_prev = entry->wheel_prev;
+    }
+    entry->wheel_next = 0;
+    entry->wheel_prev = 0;
+}
+
+/* takes an entry out of both indexes and returns it to the free list */
+static void bvlc_fdt_remove(
+    FD_TABLE_ENTRY * entry)
+{
+    uint16_t link = (uint16_t) (entry - &FD_Table[0]) + 1;
+    uint16_t *chain =
+        &FD_Hash[bvlc_fdt_hash(entry->dest_address.s_addr, entry->dest_port)];
+
+    while (*chain) {
+        if (*chain == link) {
+            *chain = entry->hash_next;
+            break;
+        }
+        chain = &FD_Table[*chain - 1].hash_next;
+    }
+    bvlc_fdt_wheel_remove(entry);
+    entry->valid = false;
+    entry->hash_next = FD_Free_List;
+    FD_Free_List = link;
+    FDT_Forward_List_Valid = false;
+}
+
+/** Seconds left before a Foreign Device is purged
+ *
+ * @param entry - FDT entry
+ *
+ * @return seconds remaining, including the grace period
+ */
+static uint16_t bvlc_fdt_seconds_remaining(
+    FD_TABLE_ENTRY * entry)
+{
+    uint32_t seconds = entry->expire_time - FD_Clock;
+
+    if (seconds > 0xFFFF) {
+        seconds = 0xFFFF;
+    }
+
+    return (uint16_t) seconds;
+}
 
 /** A timer function that is called about once a second.
  *
@@ -113,22 +282,30 @@ static FD_TABLE_ENTRY FD_Table[MAX_FD_ENTRIES];
 void bvlc_maintenance_timer(
     time_t seconds)
 {
-    unsigned i = 0;
+    uint32_t steps = 0;
+    uint16_t link = 0;
+    FD_TABLE_ENTRY *entry = NULL;
 
-    for (i = 0; i < MAX_FD_ENTRIES; i++) {
-        if (FD_Table[i].valid) {
-            if (FD_Table[i].seconds_remaining) {
-                if (FD_Table[i].seconds_remaining < seconds) {
-                    FD_Table[i].seconds_remaining = 0;
-                } else {
-                    FD_Table[i].seconds_remaining -= seconds;
-                }
-                if (FD_Table[i].seconds_remaining == 0) {
-                    FD_Table[i].valid = false;
-                }
+    if (seconds <= 0) {
+        return;
+    }
+    baclock_take(&BVLC_Lock);
+    /* after a whole turn of the wheel, every slot is due */
+    steps = (seconds < FD_WHEEL_SIZE) ? (uint32_t) seconds : FD_WHEEL_SIZE;
+    FD_Clock += (uint32_t) seconds;
+    while (steps) {
+        steps--;
+        link = FD_Wheel[(FD_Clock - steps) & (FD_WHEEL_SIZE - 1)];
+        while (link) {
+            entry = &FD_Table[link - 1];
+            link = entry->wheel_next;
+            /* entries a turn or more ahead stay in the slot */
+            if ((int32_t) (entry->expire_time - FD_Clock) <= 0) {
+                bvlc_fdt_remove(entry);
             }
         }
     }
+    baclock_give(&BVLC_Lock);
 }
 
 /** Copy the source internet address to the BACnet address
@@ -329,7 +506,7 @@ int bvlc_bbmd_read_bdt(
     uint32_t bbmd_address,
     uint16_t bbmd_port)
 {
-    uint8_t mtu[MAX_MPDU] = { 0 };
+    uint8_t mtu[BIP_MPDU_MAX] = { 0 };
     uint16_t mtu_len = 0;
     int rv = 0;
     struct sockaddr_in bbmd = { 0 };
@@ -528,14 +705,14 @@ static int bvlc_encode_read_fdt_ack(
     unsigned i;
     uint16_t seconds_remaining = 0;
 
-    for (i = 0; i < MAX_FD_ENTRIES; i++) {
+    for (i = 0; i < FD_Table_Used; i++) {
         if (FD_Table[i].valid) {
             count++;
         }
     }
     len = bvlc_encode_read_fdt_ack_init(&pdu[0], count);
     pdu_len += len;
-    for (i = 0; i < MAX_FD_ENTRIES; i++) {
+    for (i = 0; i < FD_Table_Used; i++) {
         if (FD_Table[i].valid) {
             /* too much to send */
             if ((pdu_len + 10) > max_pdu) {
@@ -548,7 +725,7 @@ static int bvlc_encode_read_fdt_ack(
             pdu_len += len;
             len = encode_unsigned16(&pdu[pdu_len], FD_Table[i].time_to_live);
             pdu_len += len;
-            seconds_remaining = (uint16_t) FD_Table[i].seconds_remaining;
+            seconds_remaining = bvlc_fdt_seconds_remaining(&FD_Table[i]);
             len = encode_unsigned16(&pdu[pdu_len], seconds_remaining);
             pdu_len += len;
         }
@@ -698,6 +875,7 @@ static bool bvlc_create_bdt(
             BBMD_Table[i].broadcast_mask.s_addr = 0;
         }
     }
+    BDT_Forward_List_Valid = false;
     /* did they all fit? */
     if (npdu_length < 10) {
         status = true;
@@ -717,41 +895,41 @@ static bool bvlc_register_foreign_device(
     struct sockaddr_in *sin,
     uint16_t time_to_live)
 {
-    unsigned i = 0;
-    bool status = false;
+    FD_TABLE_ENTRY *entry = NULL;
+    uint16_t link = 0;
+    unsigned hash = 0;
 
     /* am I here already?  If so, update my time to live... */
-    for (i = 0; i < MAX_FD_ENTRIES; i++) {
-        if (FD_Table[i].valid) {
-            if ((FD_Table[i].dest_address.s_addr == sin->sin_addr.s_addr) &&
-                (FD_Table[i].dest_port == sin->sin_port)) {
-                status = true;
-                FD_Table[i].time_to_live = time_to_live;
-                /*  Upon receipt of a BVLL Register-Foreign-Device message,
-                   a BBMD shall start a timer with a value equal to the
-                   Time-to-Live parameter supplied plus a fixed grace
-                   period of 30 seconds. */
-                FD_Table[i].seconds_remaining = time_to_live + 30;
-                break;
-            }
-        }
-    }
-    if (!status) {
-        for (i = 0; i < MAX_FD_ENTRIES; i++) {
-            if (!FD_Table[i].valid) {
-                FD_Table[i].dest_address.s_addr = sin->sin_addr.s_addr;
-                FD_Table[i].dest_port = sin->sin_port;
-                FD_Table[i].time_to_live = time_to_live;
-                FD_Table[i].seconds_remaining = time_to_live + 30;
-                FD_Table[i].valid = true;
-                status = true;
-                break;
-            }
+    entry = bvlc_fdt_find(sin->sin_addr.s_addr, sin->sin_port);
+    if (entry) {
+        bvlc_fdt_wheel_remove(entry);
+    } else {
+        if (FD_Free_List) {
+            link = FD_Free_List;
+            FD_Free_List = FD_Table[link - 1].hash_next;
+        } else if (FD_Table_Used < MAX_FD_ENTRIES) {
+            link = ++FD_Table_Used;
+        } else {
+            return false;
         }
+        entry = &FD_Table[link - 1];
+        entry->dest_address.s_addr = sin->sin_addr.s_addr;
+        entry->dest_port = sin->sin_port;
+        hash = bvlc_fdt_hash(sin->sin_addr.s_addr, sin->sin_port);
+        entry->hash_next = FD_Hash[hash];
+        FD_Hash[hash] = link;
+        entry->valid = true;
+        FDT_Forward_List_Valid = false;
     }
+    entry->time_to_live = time_to_live;
+    /*  Upon receipt of a BVLL Register-Foreign-Device message,
+       a BBMD shall start a timer with a value equal to the
+       Time-to-Live parameter supplied plus a fixed grace
+       period of 30 seconds. */
+    entry->expire_time = FD_Clock + time_to_live + 30;
+    bvlc_fdt_wheel_insert(entry);
 
-
-    return status;
+    return true;
 }
 
 /** Delete a Foreign Device from the Foreign Device Table
@@ -764,22 +942,16 @@ static bool bvlc_delete_foreign_device(
     uint8_t * pdu)
 {
     struct sockaddr_in sin = { 0 };     /* the ip address */
-    bool status = false;        /* return value */
-    unsigned i = 0;
+    FD_TABLE_ENTRY *entry = NULL;
 
     bvlc_decode_bip_address(pdu, &sin.sin_addr, &sin.sin_port);
-    for (i = 0; i < MAX_FD_ENTRIES; i++) {
-        if (FD_Table[i].valid) {
-            if ((FD_Table[i].dest_address.s_addr == sin.sin_addr.s_addr) &&
-                (FD_Table[i].dest_port == sin.sin_port)) {
-                FD_Table[i].valid = false;
-                FD_Table[i].seconds_remaining = 0;
-                status = true;
-                break;
-            }
-        }
+    entry = bvlc_fdt_find(sin.sin_addr.s_addr, sin.sin_port);
+    if (entry) {
+        bvlc_fdt_remove(entry);
+        return true;
     }
-    return status;
+
+    return false;
 }
 #endif
 
@@ -817,25 +989,119 @@ int bvlc_send_mpdu(
 }
 
 #if defined(BBMD_ENABLED) && BBMD_ENABLED
-/** Sends all Broadcast Devices a Forwarded NPDU
+/** Checks a forwarding destination against our own addresses
+ *
+ * @param address - destination address in network order
+ * @param port - destination port in network order
+ *
+ * @return true if a message sent there would come back to us
+ */
+static bool bvlc_forward_to_self(
+    uint32_t address,
+    uint16_t port)
+{
+    if (port != bip_get_port()) {
+        return false;
+    }
+    if ((address == bip_get_addr()) || (address == bip_get_broadcast_addr())) {
+        return true;
+    }
+    /* NAT router port forwards BACnet packets from global IP to us.
+     * Packets sent to that global IP by us would end up back, creating
+     * a loop.
+     */
+    if (BVLC_NAT_Handling && (address == BVLC_Global_Address.s_addr)) {
+        return true;
+    }
+
+    return false;
+}
+
+/** Rebuilds the BDT and FDT forwarding lists if they are out of date */
+static void bvlc_forward_lists_update(
+    void)
+{
+    unsigned i = 0;
+    uint32_t address = 0;
+
+    if ((Forward_List_Addr != bip_get_addr()) ||
+        (Forward_List_Port != bip_get_port())) {
+        Forward_List_Addr = bip_get_addr();
+        Forward_List_Port = bip_get_port();
+        BDT_Forward_List_Valid = false;
+        FDT_Forward_List_Valid = false;
+    }
+    if (!BDT_Forward_List_Valid) {
+        BDT_Forward_Count = 0;
+        BDT_Unicast_Peer_Count = 0;
+        for (i = 0; i < MAX_BBMD_ENTRIES; i++) {
+            if (!BBMD_Table[i].valid) {
+                continue;
+            }
+            /* Skip ourself */
+            if ((BBMD_Table[i].dest_address.s_addr == bip_get_addr()) &&
+                (BBMD_Table[i].dest_port == bip_get_port())) {
+                continue;
+            }
+            if (BBMD_Table[i].broadcast_mask.s_addr == 0xFFFFFFFFL) {
+                BDT_Unicast_Peer_List[BDT_Unicast_Peer_Count].address =
+                    BBMD_Table[i].dest_address;
+                BDT_Unicast_Peer_List[BDT_Unicast_Peer_Count].port =
+                    BBMD_Table[i].dest_port;
+                BDT_Unicast_Peer_Count++;
+            }
+            /* The B/IP address to which the Forwarded-NPDU message is
+               sent is formed by inverting the broadcast distribution
+               mask in the BDT entry and logically ORing it with the
+               BBMD address of the same entry. */
+            address =
+                ((~BBMD_Table[i].broadcast_mask.
+                    s_addr) | BBMD_Table[i].dest_address.s_addr);
+            if (bvlc_forward_to_self(address, BBMD_Table[i].dest_port)) {
+                continue;
+            }
+            BDT_Forward_List[BDT_Forward_Count].address.s_addr = address;
+            BDT_Forward_List[BDT_Forward_Count].port =
+                BBMD_Table[i].dest_port;
+            BDT_Forward_Count++;
+        }
+        BDT_Forward_List_Valid = true;
+    }
+    if (!FDT_Forward_List_Valid) {
+        FDT_Forward_Count = 0;
+        for (i = 0; i < FD_Table_Used; i++) {
+            if (!FD_Table[i].valid) {
+                continue;
+            }
+            if (bvlc_forward_to_self(FD_Table[i].dest_address.s_addr,
+                    FD_Table[i].dest_port)) {
+                continue;
+            }
+            FDT_Forward_List[FDT_Forward_Count].address =
+                FD_Table[i].dest_address;
+            FDT_Forward_List[FDT_Forward_Count].port = FD_Table[i].dest_port;
+            FDT_Forward_Count++;
+        }
+        FDT_Forward_List_Valid = true;
+    }
+}
+
+/** Encodes the Forwarded-NPDU that goes to the BDT and FDT
  *
  * @param sin - source address in network order
  * @param npdu - the NPDU
- * @param max_npdu - amount of space available in the NPDU
  * @param npdu_length - length of the NPDU
  * @param original - was the message an original (not forwarded)
+ *
+ * @return number of bytes encoded in Forward_MTU, or 0 if too big
  */
-static void bvlc_bdt_forward_npdu(
+static uint16_t bvlc_encode_forward_mtu(
     struct sockaddr_in *sin,
     uint8_t * npdu,
-    uint16_t max_npdu,
     uint16_t npdu_length,
     bool original)
 {
-    uint8_t mtu[MAX_MPDU] = { 0 };
-    uint16_t mtu_len = 0;
-    unsigned i = 0;     /* loop counter */
-    struct sockaddr_in bip_dest = { 0 };
+    struct sockaddr_in nat_addr;
 
     /* If we are forwarding an original broadcast message and the NAT
      * handling is enabled, change the source address to NAT routers
@@ -845,152 +1111,93 @@ static void bvlc_bdt_forward_npdu(
      * If we are forwarding a message from peer BBMD or foreign device
      * or the NAT handling is disabled, leave the source address as is.
      */
-    if(BVLC_NAT_Handling && original) {
-        struct sockaddr_in nat_addr = *sin;
+    if (BVLC_NAT_Handling && original) {
+        nat_addr = *sin;
         nat_addr.sin_addr = BVLC_Global_Address;
-        mtu_len = (uint16_t) bvlc_encode_forwarded_npdu(&mtu[0],
-                             &nat_addr, npdu, max_npdu, npdu_length);
-    }
-    else {
-        mtu_len = (uint16_t) bvlc_encode_forwarded_npdu(&mtu[0],
-                             sin, npdu, max_npdu, npdu_length);
+        sin = &nat_addr;
     }
 
-    /* loop through the BDT and send one to each entry, except us */
-    for (i = 0; i < MAX_BBMD_ENTRIES; i++) {
-        if (BBMD_Table[i].valid) {
-            /* The B/IP address to which the Forwarded-NPDU message is
-               sent is formed by inverting the broadcast distribution
-               mask in the BDT entry and logically ORing it with the
-               BBMD address of the same entry. */
-            bip_dest.sin_addr.s_addr =
-                ((~BBMD_Table[i].broadcast_mask.
-                    s_addr) | BBMD_Table[i].dest_address.s_addr);
-            bip_dest.sin_port = BBMD_Table[i].dest_port;
-            /* don't send to my broadcast address and same port */
-            if ((bip_dest.sin_addr.s_addr == bip_get_broadcast_addr())
-                && (bip_dest.sin_port == bip_get_port())) {
-                continue;
-            }
-            /* don't send to my ip address and same port */
-            if ((bip_dest.sin_addr.s_addr == bip_get_addr()) &&
-                (bip_dest.sin_port == bip_get_port())) {
-                continue;
-            }
-            /* NAT router port forwards BACnet packets from global IP to us.
-             * Packets sent to that global IP by us would end up back, creating
-             * a loop.
-             */
-            if (BVLC_NAT_Handling &&
-                (bip_dest.sin_addr.s_addr == BVLC_Global_Address.s_addr) &&
-                (bip_dest.sin_port == bip_get_port())) {
-                continue;
-            }
-            bvlc_send_mpdu(&bip_dest, mtu, mtu_len);
-            debug_printf("BVLC: BDT Sent Forwarded-NPDU to %s:%04X\n",
-                inet_ntoa(bip_dest.sin_addr), ntohs(bip_dest.sin_port));
+    return (uint16_t) bvlc_encode_forwarded_npdu(&Forward_MTU[0], sin, npdu,
+        sizeof(Forward_MTU) - (4 + 6), npdu_length);
+}
+
+/** Sends a BVLL message to each destination in a forwarding list
+ *
+ * @param list - the destinations
+ * @param count - number of destinations in the list
+ * @param skip - a destination to leave out, or NULL
+ * @param mtu - the encoded BVLL message
+ * @param mtu_len - length of the message
+ */
+static void bvlc_send_forward_list(
+    BVLC_FORWARD_ENTRY * list,
+    unsigned count,
+    struct sockaddr_in *skip,
+    uint8_t * mtu,
+    uint16_t mtu_len)
+{
+    struct sockaddr_in bip_dest = { 0 };
+    unsigned i = 0;     /* loop counter */
+
+    for (i = 0; i < count; i++) {
+        if (skip && (list[i].address.s_addr == skip->sin_addr.s_addr) &&
+            (list[i].port == skip->sin_port)) {
+            continue;
         }
+        bip_dest.sin_addr = list[i].address;
+        bip_dest.sin_port = list[i].port;
+        bvlc_send_mpdu(&bip_dest, mtu, mtu_len);
+        debug_printf("BVLC: Sent Forwarded-NPDU to %s:%04X\n",
+            inet_ntoa(bip_dest.sin_addr), ntohs(bip_dest.sin_port));
     }
+}
 
-    return;
+/** Sends all Broadcast Devices a Forwarded NPDU, except us
+ *
+ * @param mtu - the encoded Forwarded-NPDU
+ * @param mtu_len - length of the Forwarded-NPDU
+ */
+static void bvlc_bdt_forward_npdu(
+    uint8_t * mtu,
+    uint16_t mtu_len)
+{
+    bvlc_forward_lists_update();
+    bvlc_send_forward_list(&BDT_Forward_List[0], BDT_Forward_Count, NULL,
+        mtu, mtu_len);
 }
 
 /** Send a BVLL Forwarded-NPDU message on its local IP subnet using
  * the local B/IP broadcast address as the destination address.
  *
- * @param sin - source address in network order
- * @param npdu - the NPDU
- * @param max_npdu - amount of space available in the NPDU
- * @param npdu_length - reported length of the NPDU
+ * @param mtu - the encoded Forwarded-NPDU
+ * @param mtu_len - length of the Forwarded-NPDU
  */
 static void bvlc_forward_npdu(
-    struct sockaddr_in *sin,
-    uint8_t * npdu,
-    uint16_t max_npdu,
-    uint16_t npdu_length)
+    uint8_t * mtu,
+    uint16_t mtu_len)
 {
-    uint8_t mtu[MAX_MPDU] = { 0 };
-    uint16_t mtu_len = 0;
     struct sockaddr_in bip_dest = { 0 };
 
-    mtu_len =
-        (uint16_t) bvlc_encode_forwarded_npdu(&mtu[0], sin, npdu,
-        max_npdu, npdu_length);
     bip_dest.sin_addr.s_addr = bip_get_broadcast_addr();
     bip_dest.sin_port = bip_get_port();
     bvlc_send_mpdu(&bip_dest, mtu, mtu_len);
     debug_printf("BVLC: Sent Forwarded-NPDU as local broadcast.\n");
 }
 
-/** Sends all Foreign Devices a Forwarded NPDU
+/** Sends all Foreign Devices a Forwarded NPDU, except the originator
  *
  * @param sin - source address in network order
- * @param npdu - returns the NPDU
- * @param max_npdu - amount of space available in the NPDU
- * @param npdu_length - reported length of the NPDU
- * @param original - was the message an original (not forwarded)
+ * @param mtu - the encoded Forwarded-NPDU
+ * @param mtu_len - length of the Forwarded-NPDU
  */
 static void bvlc_fdt_forward_npdu(
     struct sockaddr_in *sin,
-    uint8_t * npdu,
-    uint16_t max_npdu,
-    uint16_t npdu_length,
-    bool original)
+    uint8_t * mtu,
+    uint16_t mtu_len)
 {
-    uint8_t mtu[MAX_MPDU] = { 0 };
-    uint16_t mtu_len = 0;
-    unsigned i = 0;     /* loop counter */
-    struct sockaddr_in bip_dest = { 0 };
-
-    /* If we are forwarding an original broadcast message and the NAT
-     * handling is enabled, change the source address to NAT routers
-     * global IP address so the recipient can reply (local IP address
-     * is not accesible from internet side.
-     *
-     * If we are forwarding a message from peer BBMD or foreign device
-     * or the NAT handling is disabled, leave the source address as is.
-     */
-    if(BVLC_NAT_Handling && original) {
-        struct sockaddr_in nat_addr = *sin;
-        nat_addr.sin_addr = BVLC_Global_Address;
-        mtu_len = (uint16_t)bvlc_encode_forwarded_npdu(&mtu[0],
-                             &nat_addr, npdu, max_npdu, npdu_length);
-    } else {
-        mtu_len = (uint16_t)bvlc_encode_forwarded_npdu(&mtu[0],
-                             sin, npdu, max_npdu, npdu_length);
-    }
-
-    /* loop through the FDT and send one to each entry */
-    for (i = 0; i < MAX_FD_ENTRIES; i++) {
-        if (FD_Table[i].valid && FD_Table[i].seconds_remaining) {
-            bip_dest.sin_addr.s_addr = FD_Table[i].dest_address.s_addr;
-            bip_dest.sin_port = FD_Table[i].dest_port;
-            /* don't send to my ip address and same port */
-            if ((bip_dest.sin_addr.s_addr == bip_get_addr()) &&
-                (bip_dest.sin_port == bip_get_port())) {
-                continue;
-            }
-            /* don't send to src ip address and same port */
-            if ((bip_dest.sin_addr.s_addr == sin->sin_addr.s_addr) &&
-                (bip_dest.sin_port == sin->sin_port)) {
-                continue;
-            }
-            /* NAT router port forwards BACnet packets from global IP to us.
-             * Packets sent to that global IP by us would end up back, creating
-             * a loop.
-             */
-            if (BVLC_NAT_Handling &&
-                (bip_dest.sin_addr.s_addr == BVLC_Global_Address.s_addr) &&
-                (bip_dest.sin_port == bip_get_port())) {
-                continue;
-            }
-            bvlc_send_mpdu(&bip_dest, mtu, mtu_len);
-            debug_printf("BVLC: FDT Sent Forwarded-NPDU to %s:%04X\n",
-                inet_ntoa(bip_dest.sin_addr), ntohs(bip_dest.sin_port));
-        }
-    }
-
-    return;
+    bvlc_forward_lists_update();
+    bvlc_send_forward_list(&FDT_Forward_List[0], FDT_Forward_Count, sin,
+        mtu, mtu_len);
 }
 #endif
 
@@ -1006,7 +1213,7 @@ static int bvlc_send_result(
     struct sockaddr_in *dest,   /* the destination address */
     BACNET_BVLC_RESULT result_code)
 {
-    uint8_t mtu[MAX_MPDU] = { 0 };
+    uint8_t mtu[BIP_MPDU_MAX] = { 0 };
     uint16_t mtu_len = 0;
 
     mtu_len = (uint16_t) bvlc_encode_bvlc_result(&mtu[0], result_code);
@@ -1027,7 +1234,7 @@ static int bvlc_send_result(
 static int bvlc_send_bdt(
     struct sockaddr_in *dest)
 {
-    uint8_t mtu[MAX_MPDU] = { 0 };
+    uint8_t mtu[BIP_MPDU_MAX] = { 0 };
     uint16_t mtu_len = 0;
 
     mtu_len = (uint16_t) bvlc_encode_read_bdt_ack(&mtu[0], sizeof(mtu));
@@ -1047,7 +1254,7 @@ static int bvlc_send_bdt(
 static int bvlc_send_fdt(
     struct sockaddr_in *dest)
 {
-    uint8_t mtu[MAX_MPDU] = { 0 };
+    uint8_t mtu[BIP_MPDU_MAX] = { 0 };
     uint16_t mtu_len = 0;
 
     mtu_len = (uint16_t) bvlc_encode_read_fdt_ack(&mtu[0], sizeof(mtu));
@@ -1067,31 +1274,17 @@ static int bvlc_send_fdt(
 static bool bvlc_bdt_member_mask_is_unicast(
     struct sockaddr_in *sin)
 {
-    bool unicast = false;
     unsigned i = 0;     /* loop counter */
 
-    for (i = 0; i < MAX_BBMD_ENTRIES; i++) {
-        if (BBMD_Table[i].valid) {
-
-            /* Skip ourself*/
-            if ((BBMD_Table[i].dest_address.s_addr == bip_get_addr()) &&
-                (BBMD_Table[i].dest_port == bip_get_port())) {
-                continue;
-            }
-
-            /* find the source address in the table */
-            if ((BBMD_Table[i].dest_address.s_addr == sin->sin_addr.s_addr) &&
-                (BBMD_Table[i].dest_port == sin->sin_port)) {
-                /* unicast mask? */
-                if (BBMD_Table[i].broadcast_mask.s_addr == 0xFFFFFFFFL) {
-                    unicast = true;
-                    break;
-                }
-            }
+    bvlc_forward_lists_update();
+    for (i = 0; i < BDT_Unicast_Peer_Count; i++) {
+        if ((BDT_Unicast_Peer_List[i].address.s_addr == sin->sin_addr.s_addr)
+            && (BDT_Unicast_Peer_List[i].port == sin->sin_port)) {
+            return true;
         }
     }
 
-    return unicast;
+    return false;
 }
 
 /** Receive a packet from the BACnet/IP socket (Annex J)
@@ -1122,6 +1315,7 @@ uint16_t bvlc_receive(
     uint16_t i = 0;
     bool status = false;
     uint16_t time_to_live = 0;
+    uint16_t mtu_len = 0;
 
     /* Make sure the socket is open */
     if (bip_socket() < 0) {
@@ -1159,12 +1353,18 @@ uint16_t bvlc_receive(
         return 0;
     }
     /* the signature of a BACnet/IP packet */
-    if (npdu[0] != BVLL_TYPE_BACNET_IP) {
+    if ((received_bytes < 4) || (npdu[0] != BVLL_TYPE_BACNET_IP)) {
         return 0;
     }
-    BVLC_Function_Code = npdu[1];
     /* decode the length of the PDU - length is inclusive of BVLC */
     (void) decode_unsigned16(&npdu[2], &npdu_len);
+    if ((npdu_len < 4) || (npdu_len > received_bytes)) {
+        /* a length that claims more than was received would have
+           the packet read, and forwarded, from past its end */
+        return 0;
+    }
+    baclock_take(&BVLC_Lock);
+    BVLC_Function_Code = npdu[1];
     /* subtract off the BVLC header */
     npdu_len -= 4;
     switch (BVLC_Function_Code) {
@@ -1244,6 +1444,11 @@ uint16_t bvlc_receive(
                BACnet devices may omit the broadcast using the B/IP
                broadcast address. The method by which a BBMD determines whether
                or not other BACnet devices are present is a local matter. */
+            if (npdu_len < 6) {
+                /* too short for the original address */
+                npdu_len = 0;
+                break;
+            }
             /* decode the 4 byte original address and 2 byte port */
             bvlc_decode_bip_address(&npdu[4], &original_sin.sin_addr,
                 &original_sin.sin_port);
@@ -1261,8 +1466,8 @@ uint16_t bvlc_receive(
             /* use the original addr from the BVLC for src */
             dest.sin_addr.s_addr = original_sin.sin_addr.s_addr;
             dest.sin_port = original_sin.sin_port;
-            bvlc_fdt_forward_npdu(&dest, &npdu[4 + 6], max_npdu-(4 + 6),
-                npdu_len, false);
+            /* the message is already a Forwarded-NPDU: pass it on as is */
+            bvlc_fdt_forward_npdu(&dest, &npdu[0], npdu_len + 4 + 6);
             debug_printf("BVLC: Received Forwarded-NPDU from %s:%04X.\n",
                 inet_ntoa(dest.sin_addr), ntohs(dest.sin_port));
             bvlc_internet_to_bacnet_address(src, &dest);
@@ -1356,9 +1561,15 @@ uint16_t bvlc_receive(
                it shall return a BVLC-Result message to the foreign device
                with a result code of X'0060' indicating that the forwarding
                attempt was unsuccessful */
-            bvlc_forward_npdu(&sin, &npdu[4], max_npdu-4, npdu_len);
-            bvlc_bdt_forward_npdu(&sin, &npdu[4], max_npdu-4, npdu_len, false);
-            bvlc_fdt_forward_npdu(&sin, &npdu[4], max_npdu-4, npdu_len, false);
+            mtu_len = bvlc_encode_forward_mtu(&sin, &npdu[4], npdu_len, false);
+            if (mtu_len) {
+                bvlc_forward_npdu(&Forward_MTU[0], mtu_len);
+                bvlc_bdt_forward_npdu(&Forward_MTU[0], mtu_len);
+                bvlc_fdt_forward_npdu(&sin, &Forward_MTU[0], mtu_len);
+            } else {
+                bvlc_send_result(&sin,
+                    BVLC_RESULT_DISTRIBUTE_BROADCAST_TO_NETWORK_NAK);
+            }
             /* not an NPDU */
             npdu_len = 0;
             break;
@@ -1410,8 +1621,12 @@ uint16_t bvlc_receive(
                     npdu[i] = npdu[4 + i];
                 }
                 /* if BDT or FDT entries exist, Forward the NPDU */
-                bvlc_bdt_forward_npdu(&sin, &npdu[0], max_npdu, npdu_len, true);
-                bvlc_fdt_forward_npdu(&sin, &npdu[0], max_npdu, npdu_len, true);
+                mtu_len =
+                    bvlc_encode_forward_mtu(&sin, &npdu[0], npdu_len, true);
+                if (mtu_len) {
+                    bvlc_bdt_forward_npdu(&Forward_MTU[0], mtu_len);
+                    bvlc_fdt_forward_npdu(&sin, &Forward_MTU[0], mtu_len);
+                }
             } else {
                 /* ignore packets that are too large */
                 npdu_len = 0;
@@ -1420,6 +1635,7 @@ uint16_t bvlc_receive(
         default:
             break;
     }
+    baclock_give(&BVLC_Lock);
 
     return npdu_len;
 }
@@ -1440,7 +1656,7 @@ int bvlc_send_pdu(
     unsigned pdu_len)
 {
     struct sockaddr_in bvlc_dest = { 0 };
-    uint8_t mtu[MAX_MPDU] = { 0 };
+    uint8_t mtu[BIP_MPDU_MAX] = { 0 };
     uint16_t mtu_len = 0;
     /* addr and port in network format */
     struct in_addr address;
@@ -1544,7 +1760,7 @@ int bvlc_register_with_bbmd(
     uint16_t bbmd_port,
     uint16_t time_to_live_seconds)
 {
-    uint8_t mtu[MAX_MPDU] = { 0 };
+    uint8_t mtu[BIP_MPDU_MAX] = { 0 };
     uint16_t mtu_len = 0;
     int retval = 0;
 
@@ -1689,19 +1905,20 @@ void bvlc_clear_bdt_local(
     void)
 {
     int i = 0;
+
+    baclock_take(&BVLC_Lock);
     for (i = 0; i < MAX_BBMD_ENTRIES; ++i) {
         BBMD_Table[i].valid = false;
         BBMD_Table[i].dest_address.s_addr = 0;
         BBMD_Table[i].dest_port = 0;
         BBMD_Table[i].broadcast_mask.s_addr = 0;
     }
+    BDT_Forward_List_Valid = false;
+    baclock_give(&BVLC_Lock);
 }
 
-/** Add new entry to broadcast distribution table.
- *
- * @return True if the new entry was added successfully.
- */
-bool bvlc_add_bdt_entry_local(
+/* bvlc_add_bdt_entry_local() with BVLC_Lock held */
+static bool bvlc_add_bdt_entry_local_locked(
     BBMD_TABLE_ENTRY* entry)
 {
     bool found = false;
@@ -1731,10 +1948,27 @@ bool bvlc_add_bdt_entry_local(
     /* Copy new entry to the empty slot */
     BBMD_Table[i] = *entry;
     BBMD_Table[i].valid = true;
+    BDT_Forward_List_Valid = false;
 
     return true;
 }
 
+/** Add new entry to broadcast distribution table.
+ *
+ * @return True if the new entry was added successfully.
+ */
+bool bvlc_add_bdt_entry_local(
+    BBMD_TABLE_ENTRY* entry)
+{
+    bool status;
+
+    baclock_take(&BVLC_Lock);
+    status = bvlc_add_bdt_entry_local_locked(entry);
+    baclock_give(&BVLC_Lock);
+
+    return status;
+}
+
 /** Enable NAT handling and set the global IP address
  * @param [in] - Global IP address visible to peer BBMDs and foreign devices
  */
@@ -1742,6 +1976,8 @@ void bvlc_set_global_address_for_nat(const struct in_addr* addr)
 {
     BVLC_Global_Address = *addr;
     BVLC_NAT_Handling = true;
+    BDT_Forward_List_Valid = false;
+    FDT_Forward_List_Valid = false;
 }
 
 /** Disable NAT handling.
@@ -1750,6 +1986,8 @@ void bvlc_disable_nat(void)
 {
     BVLC_NAT_Handling = false;
     BVLC_Global_Address.s_addr = 0;
+    BDT_Forward_List_Valid = false;
+    FDT_Forward_List_Valid = false;
 }
 
 
@@ -1809,6 +2047,145 @@ void testInternetAddress(
     ct_test(pTest, sin.sin_addr.s_addr == test_sin.sin_addr.s_addr);
 }
 
+void testForeignDeviceTable(
+    Test * pTest)
+{
+    struct sockaddr_in sin = { 0 };
+    uint8_t pdu[6] = { 0 };
+    FD_TABLE_ENTRY *entry = NULL;
+    unsigned i = 0;
+
+    sin.sin_port = htons(0xBAC0);
+    for (i = 0; i < MAX_FD_ENTRIES; i++) {
+        sin.sin_addr.s_addr = htonl(0xC0A80000UL + i);
+        ct_test(pTest, bvlc_register_foreign_device(&sin, 60 + i));
+    }
+    /* full */
+    sin.sin_addr.s_addr = htonl(0x0A000001UL);
+    ct_test(pTest, !bvlc_register_foreign_device(&sin, 60));
+    /* re-registration restarts the timer */
+    sin.sin_addr.s_addr = htonl(0xC0A80000UL);
+    bvlc_maintenance_timer(50);
+    ct_test(pTest, bvlc_register_foreign_device(&sin, 600));
+    entry = bvlc_fdt_find(sin.sin_addr.s_addr, sin.sin_port);
+    ct_test(pTest, entry != NULL);
+    ct_test(pTest, entry->time_to_live == 600);
+    ct_test(pTest, bvlc_fdt_seconds_remaining(entry) == 630);
+    /* the grace period has run out for the second entry only */
+    bvlc_maintenance_timer(41);
+    sin.sin_addr.s_addr = htonl(0xC0A80001UL);
+    ct_test(pTest, bvlc_fdt_find(sin.sin_addr.s_addr, sin.sin_port) == NULL);
+    sin.sin_addr.s_addr = htonl(0xC0A80002UL);
+    ct_test(pTest, bvlc_fdt_find(sin.sin_addr.s_addr, sin.sin_port) != NULL);
+    /* delete */
+    bvlc_encode_bip_address(&pdu[0], &sin.sin_addr, sin.sin_port);
+    ct_test(pTest, bvlc_delete_foreign_device(&pdu[0]));
+    ct_test(pTest, !bvlc_delete_foreign_device(&pdu[0]));
+    /* a long gap expires everything that is due */
+    bvlc_maintenance_timer(1000);
+    for (i = 0; i < MAX_FD_ENTRIES; i++) {
+        ct_test(pTest, !FD_Table[i].valid);
+    }
+    /* the freed entries are used again */
+    for (i = 0; i < MAX_FD_ENTRIES; i++) {
+        sin.sin_addr.s_addr = htonl(0xC0A90000UL + i);
+        ct_test(pTest, bvlc_register_foreign_device(&sin, 10));
+    }
+    ct_test(pTest, FD_Table_Used == MAX_FD_ENTRIES);
+}
+
+/* a socket of its own on the loopback interface */
+static int test_socket(
+    struct sockaddr_in *sin)
+{
+    socklen_t sin_len = sizeof(*sin);
+    int sock_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    memset(sin, 0, sizeof(*sin));
+    sin->sin_family = AF_INET;
+    sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sin->sin_port = 0;
+    if ((sock_fd < 0) ||
+        (bind(sock_fd, (struct sockaddr *) sin, sizeof(*sin)) < 0) ||
+        (getsockname(sock_fd, (struct sockaddr *) sin, &sin_len) < 0)) {
+        return -1;
+    }
+
+    return sock_fd;
+}
+
+/* returns the length of the packet the socket received, or 0 if none
+   arrived in time */
+static int test_socket_receive(
+    int sock_fd,
+    unsigned timeout)
+{
+    uint8_t mtu[BIP_MPDU_MAX];
+    struct timeval select_timeout;
+    fd_set read_fds;
+
+    select_timeout.tv_sec = 0;
+    select_timeout.tv_usec = 1000 * timeout;
+    FD_ZERO(&read_fds);
+    FD_SET(sock_fd, &read_fds);
+    if (select(sock_fd + 1, &read_fds, NULL, NULL, &select_timeout) <= 0) {
+        return 0;
+    }
+
+    return (int) recv(sock_fd, (char *) &mtu[0], sizeof(mtu), 0);
+}
+
+/* a Forwarded-NPDU is passed on to the foreign devices only as far
+   as it was received, whatever its length field says */
+void testForwardedNPDU(
+    Test * pTest)
+{
+    struct sockaddr_in bbmd_sin, fd_sin, peer_sin;
+    int bbmd_fd, fd_fd, peer_fd;
+    BACNET_ADDRESS src;
+    uint8_t npdu[BIP_MPDU_MAX] = { 0 };
+    uint8_t mtu[] = {
+        BVLL_TYPE_BACNET_IP, BVLC_FORWARDED_NPDU, 0x00, 0x0E,
+        0x0A, 0x00, 0x00, 0x09, 0xBA, 0xC0,
+        0x01, 0x00, 0x10, 0x08
+    };
+
+    bbmd_fd = test_socket(&bbmd_sin);
+    fd_fd = test_socket(&fd_sin);
+    peer_fd = test_socket(&peer_sin);
+    ct_test(pTest, (bbmd_fd >= 0) && (fd_fd >= 0) && (peer_fd >= 0));
+    bip_set_socket(bbmd_fd);
+    bip_set_addr(bbmd_sin.sin_addr.s_addr);
+    bip_set_port(bbmd_sin.sin_port);
+    /* one foreign device, and no other */
+    bvlc_maintenance_timer(1000);
+    ct_test(pTest, bvlc_register_foreign_device(&fd_sin, 60));
+    /* as it should be */
+    ct_test(pTest, sendto(peer_fd, (char *) mtu, sizeof(mtu), 0,
+            (struct sockaddr *) &bbmd_sin, sizeof(bbmd_sin)) == sizeof(mtu));
+    ct_test(pTest, bvlc_receive(&src, &npdu[0], sizeof(npdu), 1000) == 4);
+    ct_test(pTest, npdu[0] == 0x01);
+    ct_test(pTest, test_socket_receive(fd_fd, 1000) == sizeof(mtu));
+    /* a length longer than the packet */
+    mtu[2] = 0x05;
+    mtu[3] = 0x78;
+    ct_test(pTest, sendto(peer_fd, (char *) mtu, sizeof(mtu), 0,
+            (struct sockaddr *) &bbmd_sin, sizeof(bbmd_sin)) == sizeof(mtu));
+    ct_test(pTest, bvlc_receive(&src, &npdu[0], sizeof(npdu), 1000) == 0);
+    ct_test(pTest, test_socket_receive(fd_fd, 200) == 0);
+    /* a length shorter than the original address */
+    mtu[2] = 0x00;
+    mtu[3] = 0x08;
+    ct_test(pTest, sendto(peer_fd, (char *) mtu, 8, 0,
+            (struct sockaddr *) &bbmd_sin, sizeof(bbmd_sin)) == 8);
+    ct_test(pTest, bvlc_receive(&src, &npdu[0], sizeof(npdu), 1000) == 0);
+    ct_test(pTest, test_socket_receive(fd_fd, 200) == 0);
+    bip_set_socket(-1);
+    close(peer_fd);
+    close(fd_fd);
+    close(bbmd_fd);
+}
+
 #ifdef TEST_BVLC
 int main(
     void)
@@ -1822,6 +2199,10 @@ int main(
     assert(rc);
     rc = ct_addTestFunction(pTest, testInternetAddress);
     assert(rc);
+    rc = ct_addTestFunction(pTest, testForeignDeviceTable);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testForwardedNPDU);
+    assert(rc);
     /* configure output */
     ct_setStream(pTest, stdout);
     ct_run(pTest);
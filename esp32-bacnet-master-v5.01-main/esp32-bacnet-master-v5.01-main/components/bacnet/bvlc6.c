@@ -0,0 +1,1567 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "bacdcode.h"
+#include "bacint.h"
+#include "bvlc6.h"
+#include "bip6.h"
+#include "vmac.h"
+#include "baclock.h"
+
+/** @file bvlc6.c  BACnet Virtual Link Layer for BACnet/IPv6 (Annex U) */
+
+/* the octets of a message before its NPDU, by function */
+#define BVLC6_HEADER_LEN 4
+#define BVLC6_VMAC_LEN 3
+#define BVLC6_RESULT_LEN (BVLC6_HEADER_LEN + 3 + 2)
+#define BVLC6_ORIGINAL_UNICAST_LEN (BVLC6_HEADER_LEN + 3 + 3)
+#define BVLC6_ORIGINAL_BROADCAST_LEN (BVLC6_HEADER_LEN + 3)
+#define BVLC6_ADDRESS_RESOLUTION_LEN (BVLC6_HEADER_LEN + 3 + 3)
+#define BVLC6_FORWARDED_ADDRESS_RESOLUTION_LEN \
+    (BVLC6_HEADER_LEN + 3 + 3 + BIP6_ADDRESS_MAX)
+#define BVLC6_VIRTUAL_ADDRESS_RESOLUTION_LEN (BVLC6_HEADER_LEN + 3)
+#define BVLC6_FORWARDED_NPDU_LEN (BVLC6_HEADER_LEN + 3 + BIP6_ADDRESS_MAX)
+#define BVLC6_REGISTER_FOREIGN_DEVICE_LEN (BVLC6_HEADER_LEN + 3 + 2)
+#define BVLC6_DELETE_FOREIGN_DEVICE_LEN \
+    (BVLC6_HEADER_LEN + 3 + BIP6_ADDRESS_MAX)
+#define BVLC6_DISTRIBUTE_BROADCAST_LEN (BVLC6_HEADER_LEN + 3)
+
+/* the function code of the last message received */
+static uint8_t BVLC6_Function_Code = BVLC6_RESULT;
+/* the result code of the last BVLC-Result received */
+static uint16_t BVLC6_Result_Code = BVLC6_RESULT_SUCCESSFUL_COMPLETION;
+/* the BBMD this node is registered with as a foreign device */
+static BACNET_IP6_ADDRESS Remote_BBMD;
+static uint16_t Remote_BBMD_TTL_Seconds;
+static uint16_t Remote_BBMD_Timer_Seconds;
+/* the VMAC table: learned by the task receiving, read by those sending */
+static BACLOCK VMAC_Lock = BACLOCK_INITIALIZER;
+
+/**
+ * Encodes a B/IPv6 address: the IPv6 address, then the UDP port
+ *
+ * @param pdu - buffer to encode into
+ * @param pdu_size - room in the buffer
+ * @param ip6_address - the address
+ *
+ * @return number of bytes encoded, or 0 if there was no room
+ */
+int bvlc6_encode_address(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    BACNET_IP6_ADDRESS * ip6_address)
+{
+    if (!pdu || !ip6_address || (pdu_size < BIP6_ADDRESS_MAX)) {
+        return 0;
+    }
+    memcpy(pdu, ip6_address->address, IP6_ADDRESS_MAX);
+    (void) encode_unsigned16(&pdu[IP6_ADDRESS_MAX], ip6_address->port);
+
+    return BIP6_ADDRESS_MAX;
+}
+
+/**
+ * Decodes a B/IPv6 address
+ *
+ * @param pdu - buffer to decode
+ * @param pdu_len - length of the buffer
+ * @param ip6_address - the address decoded
+ *
+ * @return number of bytes decoded, or 0 if it was too short
+ */
+int bvlc6_decode_address(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    BACNET_IP6_ADDRESS * ip6_address)
+{
+    if (!pdu || (pdu_len < BIP6_ADDRESS_MAX)) {
+        return 0;
+    }
+    if (ip6_address) {
+        memcpy(ip6_address->address, pdu, IP6_ADDRESS_MAX);
+        (void) decode_unsigned16(&pdu[IP6_ADDRESS_MAX], &ip6_address->port);
+    }
+
+    return BIP6_ADDRESS_MAX;
+}
+
+/**
+ * Copies a B/IPv6 address
+ *
+ * @param dst - the copy
+ * @param src - the address
+ *
+ * @return true if copied
+ */
+bool bvlc6_address_copy(
+    BACNET_IP6_ADDRESS * dst,
+    BACNET_IP6_ADDRESS * src)
+{
+    if (!dst || !src) {
+        return false;
+    }
+    memcpy(dst->address, src->address, IP6_ADDRESS_MAX);
+    dst->port = src->port;
+
+    return true;
+}
+
+/**
+ * Compares two B/IPv6 addresses
+ *
+ * @param dst - one address
+ * @param src - the other address
+ *
+ * @return true if they differ in address or port
+ */
+bool bvlc6_address_different(
+    BACNET_IP6_ADDRESS * dst,
+    BACNET_IP6_ADDRESS * src)
+{
+    if (!dst || !src) {
+        return true;
+    }
+
+    return ((dst->port != src->port) ||
+        (memcmp(dst->address, src->address, IP6_ADDRESS_MAX) != 0));
+}
+
+/**
+ * Sets the IPv6 address from its eight 16-bit groups, as written
+ * in hex, most significant first; the port is left as it is.
+ *
+ * @param addr - the address
+ * @param addr0 - the first group, eg 0xFF05 for a site-local multicast
+ * @param addr7 - the last group
+ *
+ * @return true if set
+ */
+bool bvlc6_address_set(
+    BACNET_IP6_ADDRESS * addr,
+    uint16_t addr0,
+    uint16_t addr1,
+    uint16_t addr2,
+    uint16_t addr3,
+    uint16_t addr4,
+    uint16_t addr5,
+    uint16_t addr6,
+    uint16_t addr7)
+{
+    if (!addr) {
+        return false;
+    }
+    (void) encode_unsigned16(&addr->address[0], addr0);
+    (void) encode_unsigned16(&addr->address[2], addr1);
+    (void) encode_unsigned16(&addr->address[4], addr2);
+    (void) encode_unsigned16(&addr->address[6], addr3);
+    (void) encode_unsigned16(&addr->address[8], addr4);
+    (void) encode_unsigned16(&addr->address[10], addr5);
+    (void) encode_unsigned16(&addr->address[12], addr6);
+    (void) encode_unsigned16(&addr->address[14], addr7);
+
+    return true;
+}
+
+/**
+ * Gets the eight 16-bit groups of the IPv6 address
+ *
+ * @param addr - the address
+ * @param addr0 - the first group
+ * @param addr7 - the last group
+ *
+ * @return true if the address was given
+ */
+bool bvlc6_address_get(
+    BACNET_IP6_ADDRESS * addr,
+    uint16_t * addr0,
+    uint16_t * addr1,
+    uint16_t * addr2,
+    uint16_t * addr3,
+    uint16_t * addr4,
+    uint16_t * addr5,
+    uint16_t * addr6,
+    uint16_t * addr7)
+{
+    if (!addr) {
+        return false;
+    }
+    (void) decode_unsigned16(&addr->address[0], addr0);
+    (void) decode_unsigned16(&addr->address[2], addr1);
+    (void) decode_unsigned16(&addr->address[4], addr2);
+    (void) decode_unsigned16(&addr->address[6], addr3);
+    (void) decode_unsigned16(&addr->address[8], addr4);
+    (void) decode_unsigned16(&addr->address[10], addr5);
+    (void) decode_unsigned16(&addr->address[12], addr6);
+    (void) decode_unsigned16(&addr->address[14], addr7);
+
+    return true;
+}
+
+/**
+ * Sets a BACnet address to the VMAC of a device: its device instance,
+ * in three octets
+ *
+ * @param addr - the BACnet address
+ * @param device_id - the device instance
+ *
+ * @return true if set
+ */
+bool bvlc6_vmac_address_set(
+    BACNET_ADDRESS * addr,
+    uint32_t device_id)
+{
+    if (!addr) {
+        return false;
+    }
+    memset(addr, 0, sizeof(BACNET_ADDRESS));
+    addr->mac_len = BVLC6_VMAC_LEN;
+    (void) encode_unsigned24(addr->mac, device_id);
+
+    return true;
+}
+
+/**
+ * Gets the device instance of the VMAC of a BACnet address
+ *
+ * @param addr - the BACnet address
+ * @param device_id - the device instance
+ *
+ * @return true if the address is a VMAC
+ */
+bool bvlc6_vmac_address_get(
+    BACNET_ADDRESS * addr,
+    uint32_t * device_id)
+{
+    if (!addr || (addr->mac_len != BVLC6_VMAC_LEN)) {
+        return false;
+    }
+    if (device_id) {
+        (void) decode_unsigned24(addr->mac, device_id);
+    }
+
+    return true;
+}
+
+/**
+ * Encodes the BVLL header
+ *
+ * @param pdu - buffer to encode into
+ * @param pdu_size - room in the buffer
+ * @param message_type - the BVLC function
+ * @param length - the length of the whole message
+ *
+ * @return number of bytes encoded, or 0 if there was no room
+ */
+int bvlc6_encode_header(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint8_t message_type,
+    uint16_t length)
+{
+    if (!pdu || (pdu_size < BVLC6_HEADER_LEN)) {
+        return 0;
+    }
+    pdu[0] = BVLL_TYPE_BACNET_IP6;
+    pdu[1] = message_type;
+    (void) encode_unsigned16(&pdu[2], length);
+
+    return BVLC6_HEADER_LEN;
+}
+
+/**
+ * Decodes the BVLL header
+ *
+ * @param pdu - buffer to decode
+ * @param pdu_len - length of the buffer
+ * @param message_type - the BVLC function
+ * @param length - the length of the whole message
+ *
+ * @return number of bytes decoded, or 0 if it is not a B/IPv6 message
+ */
+int bvlc6_decode_header(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint8_t * message_type,
+    uint16_t * length)
+{
+    if (!pdu || (pdu_len < BVLC6_HEADER_LEN) ||
+        (pdu[0] != BVLL_TYPE_BACNET_IP6)) {
+        return 0;
+    }
+    if (message_type) {
+        *message_type = pdu[1];
+    }
+    if (length) {
+        (void) decode_unsigned16(&pdu[2], length);
+    }
+
+    return BVLC6_HEADER_LEN;
+}
+
+/* the decoders below take the message after its BVLL header */
+
+/* encodes the header, and the VMAC of the sender after it */
+static int bvlc6_encode_vmac_header(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint8_t message_type,
+    uint16_t length,
+    uint32_t vmac)
+{
+    if (!pdu || (pdu_size < length)) {
+        return 0;
+    }
+    (void) bvlc6_encode_header(pdu, pdu_size, message_type, length);
+    (void) encode_unsigned24(&pdu[BVLC6_HEADER_LEN], vmac);
+
+    return BVLC6_HEADER_LEN + BVLC6_VMAC_LEN;
+}
+
+/* copies out the NPDU after the fields of a message */
+static int bvlc6_decode_npdu(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint16_t offset,
+    uint8_t * npdu,
+    uint16_t npdu_size,
+    uint16_t * npdu_len)
+{
+    uint16_t len = pdu_len - offset;
+
+    if (npdu) {
+        if (len > npdu_size) {
+            return 0;
+        }
+        memcpy(npdu, &pdu[offset], len);
+    }
+    if (npdu_len) {
+        *npdu_len = len;
+    }
+
+    return pdu_len;
+}
+
+int bvlc6_encode_result(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac,
+    uint16_t result_code)
+{
+    int len = bvlc6_encode_vmac_header(pdu, pdu_size, BVLC6_RESULT,
+        BVLC6_RESULT_LEN, vmac);
+
+    if (len) {
+        len += encode_unsigned16(&pdu[len], result_code);
+    }
+
+    return len;
+}
+
+int bvlc6_decode_result(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac,
+    uint16_t * result_code)
+{
+    if (!pdu || (pdu_len < (BVLC6_RESULT_LEN - BVLC6_HEADER_LEN))) {
+        return 0;
+    }
+    if (vmac) {
+        (void) decode_unsigned24(&pdu[0], vmac);
+    }
+    if (result_code) {
+        (void) decode_unsigned16(&pdu[3], result_code);
+    }
+
+    return BVLC6_RESULT_LEN - BVLC6_HEADER_LEN;
+}
+
+int bvlc6_encode_original_unicast(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac_src,
+    uint32_t vmac_dst,
+    uint8_t * npdu,
+    uint16_t npdu_len)
+{
+    uint16_t length = BVLC6_ORIGINAL_UNICAST_LEN + npdu_len;
+    int len = 0;
+
+    if (length < npdu_len) {
+        return 0;
+    }
+    len = bvlc6_encode_vmac_header(pdu, pdu_size,
+        BVLC6_ORIGINAL_UNICAST_NPDU, length, vmac_src);
+    if (len) {
+        len += encode_unsigned24(&pdu[len], vmac_dst);
+        memcpy(&pdu[len], npdu, npdu_len);
+        len += npdu_len;
+    }
+
+    return len;
+}
+
+int bvlc6_decode_original_unicast(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac_src,
+    uint32_t * vmac_dst,
+    uint8_t * npdu,
+    uint16_t npdu_size,
+    uint16_t * npdu_len)
+{
+    const uint16_t offset = BVLC6_ORIGINAL_UNICAST_LEN - BVLC6_HEADER_LEN;
+
+    if (!pdu || (pdu_len < offset)) {
+        return 0;
+    }
+    if (vmac_src) {
+        (void) decode_unsigned24(&pdu[0], vmac_src);
+    }
+    if (vmac_dst) {
+        (void) decode_unsigned24(&pdu[3], vmac_dst);
+    }
+
+    return bvlc6_decode_npdu(pdu, pdu_len, offset, npdu, npdu_size,
+        npdu_len);
+}
+
+int bvlc6_encode_original_broadcast(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac,
+    uint8_t * npdu,
+    uint16_t npdu_len)
+{
+    uint16_t length = BVLC6_ORIGINAL_BROADCAST_LEN + npdu_len;
+    int len = 0;
+
+    if (length < npdu_len) {
+        return 0;
+    }
+    len = bvlc6_encode_vmac_header(pdu, pdu_size,
+        BVLC6_ORIGINAL_BROADCAST_NPDU, length, vmac);
+    if (len) {
+        memcpy(&pdu[len], npdu, npdu_len);
+        len += npdu_len;
+    }
+
+    return len;
+}
+
+int bvlc6_decode_original_broadcast(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac,
+    uint8_t * npdu,
+    uint16_t npdu_size,
+    uint16_t * npdu_len)
+{
+    const uint16_t offset = BVLC6_ORIGINAL_BROADCAST_LEN - BVLC6_HEADER_LEN;
+
+    if (!pdu || (pdu_len < offset)) {
+        return 0;
+    }
+    if (vmac) {
+        (void) decode_unsigned24(&pdu[0], vmac);
+    }
+
+    return bvlc6_decode_npdu(pdu, pdu_len, offset, npdu, npdu_size,
+        npdu_len);
+}
+
+/* the messages of a source VMAC and a target or destination VMAC */
+static int bvlc6_encode_vmac_pair(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint8_t message_type,
+    uint32_t vmac_src,
+    uint32_t vmac_dst)
+{
+    int len = bvlc6_encode_vmac_header(pdu, pdu_size, message_type,
+        BVLC6_ADDRESS_RESOLUTION_LEN, vmac_src);
+
+    if (len) {
+        len += encode_unsigned24(&pdu[len], vmac_dst);
+    }
+
+    return len;
+}
+
+static int bvlc6_decode_vmac_pair(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac_src,
+    uint32_t * vmac_dst)
+{
+    if (!pdu || (pdu_len < (2 * BVLC6_VMAC_LEN))) {
+        return 0;
+    }
+    if (vmac_src) {
+        (void) decode_unsigned24(&pdu[0], vmac_src);
+    }
+    if (vmac_dst) {
+        (void) decode_unsigned24(&pdu[3], vmac_dst);
+    }
+
+    return 2 * BVLC6_VMAC_LEN;
+}
+
+int bvlc6_encode_address_resolution(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac_src,
+    uint32_t vmac_target)
+{
+    return bvlc6_encode_vmac_pair(pdu, pdu_size, BVLC6_ADDRESS_RESOLUTION,
+        vmac_src, vmac_target);
+}
+
+int bvlc6_decode_address_resolution(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac_src,
+    uint32_t * vmac_target)
+{
+    return bvlc6_decode_vmac_pair(pdu, pdu_len, vmac_src, vmac_target);
+}
+
+int bvlc6_encode_forwarded_address_resolution(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac_src,
+    uint32_t vmac_target,
+    BACNET_IP6_ADDRESS * bip6_address)
+{
+    int len = bvlc6_encode_vmac_header(pdu, pdu_size,
+        BVLC6_FORWARDED_ADDRESS_RESOLUTION,
+        BVLC6_FORWARDED_ADDRESS_RESOLUTION_LEN, vmac_src);
+
+    if (len) {
+        len += encode_unsigned24(&pdu[len], vmac_target);
+        len += bvlc6_encode_address(&pdu[len], BIP6_ADDRESS_MAX,
+            bip6_address);
+    }
+
+    return len;
+}
+
+int bvlc6_decode_forwarded_address_resolution(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac_src,
+    uint32_t * vmac_target,
+    BACNET_IP6_ADDRESS * bip6_address)
+{
+    int len = 0;
+
+    if (!pdu || (pdu_len < (BVLC6_FORWARDED_ADDRESS_RESOLUTION_LEN -
+                BVLC6_HEADER_LEN))) {
+        return 0;
+    }
+    len = bvlc6_decode_vmac_pair(pdu, pdu_len, vmac_src, vmac_target);
+    len += bvlc6_decode_address(&pdu[len], pdu_len - len, bip6_address);
+
+    return len;
+}
+
+int bvlc6_encode_address_resolution_ack(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac_src,
+    uint32_t vmac_dst)
+{
+    return bvlc6_encode_vmac_pair(pdu, pdu_size,
+        BVLC6_ADDRESS_RESOLUTION_ACK, vmac_src, vmac_dst);
+}
+
+int bvlc6_decode_address_resolution_ack(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac_src,
+    uint32_t * vmac_dst)
+{
+    return bvlc6_decode_vmac_pair(pdu, pdu_len, vmac_src, vmac_dst);
+}
+
+int bvlc6_encode_virtual_address_resolution(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac_src)
+{
+    return bvlc6_encode_vmac_header(pdu, pdu_size,
+        BVLC6_VIRTUAL_ADDRESS_RESOLUTION,
+        BVLC6_VIRTUAL_ADDRESS_RESOLUTION_LEN, vmac_src);
+}
+
+int bvlc6_decode_virtual_address_resolution(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac_src)
+{
+    if (!pdu || (pdu_len < BVLC6_VMAC_LEN)) {
+        return 0;
+    }
+    if (vmac_src) {
+        (void) decode_unsigned24(&pdu[0], vmac_src);
+    }
+
+    return BVLC6_VMAC_LEN;
+}
+
+int bvlc6_encode_virtual_address_resolution_ack(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac_src,
+    uint32_t vmac_dst)
+{
+    return bvlc6_encode_vmac_pair(pdu, pdu_size,
+        BVLC6_VIRTUAL_ADDRESS_RESOLUTION_ACK, vmac_src, vmac_dst);
+}
+
+int bvlc6_decode_virtual_address_resolution_ack(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac_src,
+    uint32_t * vmac_dst)
+{
+    return bvlc6_decode_vmac_pair(pdu, pdu_len, vmac_src, vmac_dst);
+}
+
+int bvlc6_encode_forwarded_npdu(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac_src,
+    BACNET_IP6_ADDRESS * address,
+    uint8_t * npdu,
+    uint16_t npdu_len)
+{
+    uint16_t length = BVLC6_FORWARDED_NPDU_LEN + npdu_len;
+    int len = 0;
+
+    if (length < npdu_len) {
+        return 0;
+    }
+    len = bvlc6_encode_vmac_header(pdu, pdu_size, BVLC6_FORWARDED_NPDU,
+        length, vmac_src);
+    if (len) {
+        len += bvlc6_encode_address(&pdu[len], BIP6_ADDRESS_MAX, address);
+        memcpy(&pdu[len], npdu, npdu_len);
+        len += npdu_len;
+    }
+
+    return len;
+}
+
+int bvlc6_decode_forwarded_npdu(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac_src,
+    BACNET_IP6_ADDRESS * address,
+    uint8_t * npdu,
+    uint16_t npdu_size,
+    uint16_t * npdu_len)
+{
+    const uint16_t offset = BVLC6_FORWARDED_NPDU_LEN - BVLC6_HEADER_LEN;
+
+    if (!pdu || (pdu_len < offset)) {
+        return 0;
+    }
+    if (vmac_src) {
+        (void) decode_unsigned24(&pdu[0], vmac_src);
+    }
+    (void) bvlc6_decode_address(&pdu[BVLC6_VMAC_LEN], BIP6_ADDRESS_MAX,
+        address);
+
+    return bvlc6_decode_npdu(pdu, pdu_len, offset, npdu, npdu_size,
+        npdu_len);
+}
+
+int bvlc6_encode_register_foreign_device(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac_src,
+    uint16_t ttl_seconds)
+{
+    int len = bvlc6_encode_vmac_header(pdu, pdu_size,
+        BVLC6_REGISTER_FOREIGN_DEVICE, BVLC6_REGISTER_FOREIGN_DEVICE_LEN,
+        vmac_src);
+
+    if (len) {
+        len += encode_unsigned16(&pdu[len], ttl_seconds);
+    }
+
+    return len;
+}
+
+int bvlc6_decode_register_foreign_device(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac_src,
+    uint16_t * ttl_seconds)
+{
+    if (!pdu || (pdu_len < (BVLC6_REGISTER_FOREIGN_DEVICE_LEN -
+                BVLC6_HEADER_LEN))) {
+        return 0;
+    }
+    if (vmac_src) {
+        (void) decode_unsigned24(&pdu[0], vmac_src);
+    }
+    if (ttl_seconds) {
+        (void) decode_unsigned16(&pdu[3], ttl_seconds);
+    }
+
+    return BVLC6_REGISTER_FOREIGN_DEVICE_LEN - BVLC6_HEADER_LEN;
+}
+
+int bvlc6_encode_delete_foreign_device(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac_src,
+    BACNET_IP6_FOREIGN_DEVICE_TABLE_ENTRY * fdt_entry)
+{
+    int len = 0;
+
+    if (!fdt_entry) {
+        return 0;
+    }
+    len = bvlc6_encode_vmac_header(pdu, pdu_size,
+        BVLC6_DELETE_FOREIGN_DEVICE, BVLC6_DELETE_FOREIGN_DEVICE_LEN,
+        vmac_src);
+    if (len) {
+        len += bvlc6_encode_address(&pdu[len], BIP6_ADDRESS_MAX,
+            &fdt_entry->bip6_address);
+    }
+
+    return len;
+}
+
+int bvlc6_decode_delete_foreign_device(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac_src,
+    BACNET_IP6_FOREIGN_DEVICE_TABLE_ENTRY * fdt_entry)
+{
+    if (!pdu || (pdu_len < (BVLC6_DELETE_FOREIGN_DEVICE_LEN -
+                BVLC6_HEADER_LEN))) {
+        return 0;
+    }
+    if (vmac_src) {
+        (void) decode_unsigned24(&pdu[0], vmac_src);
+    }
+    if (fdt_entry) {
+        (void) bvlc6_decode_address(&pdu[BVLC6_VMAC_LEN], BIP6_ADDRESS_MAX,
+            &fdt_entry->bip6_address);
+    }
+
+    return BVLC6_DELETE_FOREIGN_DEVICE_LEN - BVLC6_HEADER_LEN;
+}
+
+int bvlc6_encode_secure_bvll(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint8_t * sbuf,
+    uint16_t sbuf_len)
+{
+    uint16_t length = BVLC6_HEADER_LEN + sbuf_len;
+
+    if (!pdu || !sbuf || (length < sbuf_len) || (pdu_size < length)) {
+        return 0;
+    }
+    (void) bvlc6_encode_header(pdu, pdu_size, BVLC6_SECURE_BVLL, length);
+    memcpy(&pdu[BVLC6_HEADER_LEN], sbuf, sbuf_len);
+
+    return length;
+}
+
+int bvlc6_decode_secure_bvll(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint8_t * sbuf,
+    uint16_t sbuf_size,
+    uint16_t * sbuf_len)
+{
+    if (!pdu) {
+        return 0;
+    }
+
+    return bvlc6_decode_npdu(pdu, pdu_len, 0, sbuf, sbuf_size, sbuf_len);
+}
+
+int bvlc6_encode_distribute_broadcast_to_network(
+    uint8_t * pdu,
+    uint16_t pdu_size,
+    uint32_t vmac,
+    uint8_t * npdu,
+    uint16_t npdu_len)
+{
+    uint16_t length = BVLC6_DISTRIBUTE_BROADCAST_LEN + npdu_len;
+    int len = 0;
+
+    if (length < npdu_len) {
+        return 0;
+    }
+    len = bvlc6_encode_vmac_header(pdu, pdu_size,
+        BVLC6_DISTRIBUTE_BROADCAST_TO_NETWORK, length, vmac);
+    if (len) {
+        memcpy(&pdu[len], npdu, npdu_len);
+        len += npdu_len;
+    }
+
+    return len;
+}
+
+int bvlc6_decode_distribute_broadcast_to_network(
+    uint8_t * pdu,
+    uint16_t pdu_len,
+    uint32_t * vmac,
+    uint8_t * npdu,
+    uint16_t npdu_size,
+    uint16_t * npdu_len)
+{
+    return bvlc6_decode_original_broadcast(pdu, pdu_len, vmac, npdu,
+        npdu_size, npdu_len);
+}
+
+/* the VMAC of this node */
+static uint32_t bvlc6_my_vmac(
+    void)
+{
+    BACNET_ADDRESS my_address = { 0 };
+    uint32_t device_id = 0;
+
+    bip6_get_my_address(&my_address);
+    (void) bvlc6_vmac_address_get(&my_address, &device_id);
+
+    return device_id;
+}
+
+/* remembers where a node is; nothing is learned about this node */
+static void bvlc6_vmac_learn(
+    uint32_t vmac,
+    BACNET_IP6_ADDRESS * addr)
+{
+    struct vmac_data data = { { 0 }, 0 };
+
+    if (vmac == bvlc6_my_vmac()) {
+        return;
+    }
+    data.mac_len = (uint8_t) bvlc6_encode_address(data.mac,
+        sizeof(data.mac), addr);
+    baclock_take(&VMAC_Lock);
+    (void) VMAC_Add(vmac, &data);
+    baclock_give(&VMAC_Lock);
+}
+
+/* the address of a node, if it is known */
+static bool bvlc6_vmac_address(
+    uint32_t vmac,
+    BACNET_IP6_ADDRESS * addr)
+{
+    struct vmac_data *data = NULL;
+    bool status = false;
+
+    baclock_take(&VMAC_Lock);
+    data = VMAC_Find_By_Key(vmac);
+    if (data) {
+        status = (bvlc6_decode_address(data->mac, data->mac_len, addr) > 0);
+    }
+    baclock_give(&VMAC_Lock);
+
+    return status;
+}
+
+static bool bvlc6_registered(
+    void)
+{
+    return (Remote_BBMD_TTL_Seconds != 0);
+}
+
+/**
+ * Sends an NPDU: unicast to the B/IPv6 address of the VMAC of the
+ * destination, else multicast to the BACnet/IPv6 group, or through the
+ * BBMD if this node is registered with one as a foreign device.
+ *
+ * @param dest - the destination; its MAC is a VMAC
+ * @param npdu_data - the NPDU header information (not used)
+ * @param pdu - the NPDU
+ * @param pdu_len - its length
+ *
+ * @return number of bytes sent, or -1 if it could not be sent.  An NPDU
+ *  to a node whose address is not known is dropped, and the address is
+ *  asked for, so that the retry of the application finds it.
+ */
+int bvlc6_send_pdu(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    BACNET_IP6_ADDRESS addr = { { 0 }, 0 };
+    uint8_t mtu[BIP6_MPDU_MAX] = { 0 };
+    uint32_t vmac_src = bvlc6_my_vmac();
+    uint32_t vmac_dst = 0;
+    int mtu_len = 0;
+
+    (void) npdu_data;
+    if (!dest || (pdu_len > MAX_PDU)) {
+        return -1;
+    }
+    if (bvlc6_vmac_address_get(dest, &vmac_dst) &&
+        (dest->net != BACNET_BROADCAST_NETWORK)) {
+        if (bvlc6_vmac_address(vmac_dst, &addr)) {
+            mtu_len = bvlc6_encode_original_unicast(mtu, sizeof(mtu),
+                vmac_src, vmac_dst, pdu, (uint16_t) pdu_len);
+        } else {
+            mtu_len = bvlc6_encode_address_resolution(mtu, sizeof(mtu),
+                vmac_src, vmac_dst);
+            if (bvlc6_registered()) {
+                bvlc6_address_copy(&addr, &Remote_BBMD);
+            } else {
+                bip6_get_broadcast_addr(&addr);
+            }
+            (void) bip6_send_mpdu(&addr, mtu, (uint16_t) mtu_len);
+            return -1;
+        }
+    } else if ((dest->mac_len == 0) ||
+        (dest->net == BACNET_BROADCAST_NETWORK)) {
+        if (bvlc6_registered()) {
+            bvlc6_address_copy(&addr, &Remote_BBMD);
+            mtu_len = bvlc6_encode_distribute_broadcast_to_network(mtu,
+                sizeof(mtu), vmac_src, pdu, (uint16_t) pdu_len);
+        } else {
+            bip6_get_broadcast_addr(&addr);
+            mtu_len = bvlc6_encode_original_broadcast(mtu, sizeof(mtu),
+                vmac_src, pdu, (uint16_t) pdu_len);
+        }
+    } else {
+        /* not a VMAC */
+        return -1;
+    }
+    if (mtu_len <= 0) {
+        return -1;
+    }
+
+    return bip6_send_mpdu(&addr, mtu, (uint16_t) mtu_len);
+}
+
+/* sends a message to one node */
+static void bvlc6_send_reply(
+    BACNET_IP6_ADDRESS * addr,
+    uint8_t * mtu,
+    int mtu_len)
+{
+    if (mtu_len > 0) {
+        (void) bip6_send_mpdu(addr, mtu, (uint16_t) mtu_len);
+    }
+}
+
+/**
+ * Handles a B/IPv6 message received by this node, which is not a BBMD.
+ * The VMAC and address of its sender are learned; an address
+ * resolution for this node is answered; the functions of a BBMD are
+ * refused with a BVLC-Result NAK.
+ *
+ * @param addr - the B/IPv6 address the message came from
+ * @param src - the VMAC of the sender of its NPDU
+ * @param npdu - the whole message
+ * @param npdu_len - its length
+ *
+ * @return the offset of the NPDU in the message, or 0 if the message
+ *  carried none for this node
+ */
+int bvlc6_handler(
+    BACNET_IP6_ADDRESS * addr,
+    BACNET_ADDRESS * src,
+    uint8_t * npdu,
+    uint16_t npdu_len)
+{
+    BACNET_IP6_ADDRESS original = { { 0 }, 0 };
+    uint8_t mtu[BVLC6_FORWARDED_ADDRESS_RESOLUTION_LEN] = { 0 };
+    uint8_t message_type = 0;
+    uint16_t length = 0;
+    uint16_t result_code = 0;
+    uint32_t vmac_me = bvlc6_my_vmac();
+    uint32_t vmac_src = 0;
+    uint32_t vmac_dst = 0;
+    uint8_t *pdu = NULL;
+    uint16_t pdu_len = 0;
+    int offset = 0;
+
+    if (!bvlc6_decode_header(npdu, npdu_len, &message_type, &length) ||
+        (length < BVLC6_HEADER_LEN) || (length > npdu_len)) {
+        return 0;
+    }
+    BVLC6_Function_Code = message_type;
+    pdu = &npdu[BVLC6_HEADER_LEN];
+    pdu_len = length - BVLC6_HEADER_LEN;
+    switch (message_type) {
+        case BVLC6_RESULT:
+            if (bvlc6_decode_result(pdu, pdu_len, &vmac_src, &result_code)) {
+                BVLC6_Result_Code = result_code;
+            }
+            break;
+        case BVLC6_ORIGINAL_UNICAST_NPDU:
+            if (bvlc6_decode_original_unicast(pdu, pdu_len, &vmac_src,
+                    &vmac_dst, NULL, 0, NULL) && (vmac_dst == vmac_me) &&
+                (vmac_src != vmac_me)) {
+                bvlc6_vmac_learn(vmac_src, addr);
+                bvlc6_vmac_address_set(src, vmac_src);
+                offset = BVLC6_ORIGINAL_UNICAST_LEN;
+            }
+            break;
+        case BVLC6_ORIGINAL_BROADCAST_NPDU:
+            if (bvlc6_decode_original_broadcast(pdu, pdu_len, &vmac_src,
+                    NULL, 0, NULL) && (vmac_src != vmac_me)) {
+                bvlc6_vmac_learn(vmac_src, addr);
+                bvlc6_vmac_address_set(src, vmac_src);
+                offset = BVLC6_ORIGINAL_BROADCAST_LEN;
+            }
+            break;
+        case BVLC6_FORWARDED_NPDU:
+            if (bvlc6_decode_forwarded_npdu(pdu, pdu_len, &vmac_src,
+                    &original, NULL, 0, NULL) && (vmac_src != vmac_me)) {
+                bvlc6_vmac_learn(vmac_src, &original);
+                bvlc6_vmac_address_set(src, vmac_src);
+                offset = BVLC6_FORWARDED_NPDU_LEN;
+            }
+            break;
+        case BVLC6_ADDRESS_RESOLUTION:
+            if (bvlc6_decode_address_resolution(pdu, pdu_len, &vmac_src,
+                    &vmac_dst) && (vmac_dst == vmac_me)) {
+                bvlc6_vmac_learn(vmac_src, addr);
+                bvlc6_send_reply(addr, mtu,
+                    bvlc6_encode_address_resolution_ack(mtu, sizeof(mtu),
+                        vmac_me, vmac_src));
+            }
+            break;
+        case BVLC6_FORWARDED_ADDRESS_RESOLUTION:
+            if (bvlc6_decode_forwarded_address_resolution(pdu, pdu_len,
+                    &vmac_src, &vmac_dst, &original) &&
+                (vmac_dst == vmac_me)) {
+                bvlc6_vmac_learn(vmac_src, &original);
+                bvlc6_send_reply(&original, mtu,
+                    bvlc6_encode_address_resolution_ack(mtu, sizeof(mtu),
+                        vmac_me, vmac_src));
+            }
+            break;
+        case BVLC6_ADDRESS_RESOLUTION_ACK:
+        case BVLC6_VIRTUAL_ADDRESS_RESOLUTION_ACK:
+            if (bvlc6_decode_vmac_pair(pdu, pdu_len, &vmac_src, &vmac_dst) &&
+                (vmac_dst == vmac_me)) {
+                bvlc6_vmac_learn(vmac_src, addr);
+            }
+            break;
+        case BVLC6_VIRTUAL_ADDRESS_RESOLUTION:
+            if (bvlc6_decode_virtual_address_resolution(pdu, pdu_len,
+                    &vmac_src)) {
+                bvlc6_vmac_learn(vmac_src, addr);
+                bvlc6_send_reply(addr, mtu,
+                    bvlc6_encode_virtual_address_resolution_ack(mtu,
+                        sizeof(mtu), vmac_me, vmac_src));
+            }
+            break;
+        case BVLC6_REGISTER_FOREIGN_DEVICE:
+            bvlc6_send_reply(addr, mtu, bvlc6_encode_result(mtu, sizeof(mtu),
+                    vmac_me, BVLC6_RESULT_REGISTER_FOREIGN_DEVICE_NAK));
+            break;
+        case BVLC6_DELETE_FOREIGN_DEVICE:
+            bvlc6_send_reply(addr, mtu, bvlc6_encode_result(mtu, sizeof(mtu),
+                    vmac_me, BVLC6_RESULT_DELETE_FOREIGN_DEVICE_NAK));
+            break;
+        case BVLC6_DISTRIBUTE_BROADCAST_TO_NETWORK:
+            bvlc6_send_reply(addr, mtu, bvlc6_encode_result(mtu, sizeof(mtu),
+                    vmac_me, BVLC6_RESULT_DISTRIBUTE_BROADCAST_TO_NETWORK_NAK));
+            break;
+        default:
+            break;
+    }
+
+    return offset;
+}
+
+/**
+ * Registers this node as a foreign device with a BBMD; it then sends
+ * its broadcasts through the BBMD, and registers again before the
+ * registration runs out.
+ *
+ * @param bbmd_addr - the address of the BBMD
+ * @param vmac_src - the VMAC of this node
+ * @param time_to_live_seconds - how long the registration lasts
+ *
+ * @return number of bytes sent, or negative on failure
+ */
+int bvlc6_register_with_bbmd(
+    BACNET_IP6_ADDRESS * bbmd_addr,
+    uint32_t vmac_src,
+    uint16_t time_to_live_seconds)
+{
+    uint8_t mtu[BVLC6_REGISTER_FOREIGN_DEVICE_LEN] = { 0 };
+    int mtu_len = 0;
+
+    if (!bbmd_addr) {
+        return -1;
+    }
+    bvlc6_address_copy(&Remote_BBMD, bbmd_addr);
+    Remote_BBMD_TTL_Seconds = time_to_live_seconds;
+    Remote_BBMD_Timer_Seconds = time_to_live_seconds;
+    mtu_len = bvlc6_encode_register_foreign_device(mtu, sizeof(mtu),
+        vmac_src, time_to_live_seconds);
+
+    return bip6_send_mpdu(bbmd_addr, mtu, (uint16_t) mtu_len);
+}
+
+/**
+ * Renews the foreign device registration, if there is one
+ *
+ * @param seconds - seconds since it was last called
+ */
+void bvlc6_maintenance_timer(
+    time_t seconds)
+{
+    if (!bvlc6_registered()) {
+        return;
+    }
+    if (Remote_BBMD_Timer_Seconds > seconds) {
+        Remote_BBMD_Timer_Seconds -= (uint16_t) seconds;
+    } else {
+        (void) bvlc6_register_with_bbmd(&Remote_BBMD, bvlc6_my_vmac(),
+            Remote_BBMD_TTL_Seconds);
+    }
+}
+
+/**
+ * Returns the result code of the last BVLC-Result received
+ */
+uint16_t bvlc6_get_last_result(
+    void)
+{
+    return BVLC6_Result_Code;
+}
+
+/**
+ * Returns the function code of the last message received
+ */
+uint8_t bvlc6_get_function_code(
+    void)
+{
+    return BVLC6_Function_Code;
+}
+
+/**
+ * Forgets the VMAC of the other nodes and any foreign device
+ * registration
+ */
+void bvlc6_init(
+    void)
+{
+    baclock_take(&VMAC_Lock);
+    VMAC_Init();
+    baclock_give(&VMAC_Lock);
+    memset(&Remote_BBMD, 0, sizeof(Remote_BBMD));
+    Remote_BBMD_TTL_Seconds = 0;
+    Remote_BBMD_Timer_Seconds = 0;
+    BVLC6_Function_Code = BVLC6_RESULT;
+    BVLC6_Result_Code = BVLC6_RESULT_SUCCESSFUL_COMPLETION;
+}
+
+#ifdef TEST
+#include <assert.h>
+#include "ctest.h"
+
+/* the datalink under the BVLL: what was sent, and to where */
+static uint32_t Test_VMAC = 0x123456;
+static BACNET_IP6_ADDRESS Test_Sent_Addr;
+static uint8_t Test_Sent[BIP6_MPDU_MAX];
+static uint16_t Test_Sent_Len;
+static unsigned Test_Sent_Count;
+
+void bip6_get_my_address(
+    BACNET_ADDRESS * my_address)
+{
+    bvlc6_vmac_address_set(my_address, Test_VMAC);
+}
+
+bool bip6_get_broadcast_addr(
+    BACNET_IP6_ADDRESS * addr)
+{
+    bvlc6_address_set(addr, BIP6_MULTICAST_SITE_LOCAL, 0, 0, 0, 0, 0, 0,
+        BIP6_MULTICAST_GROUP_ID);
+    addr->port = 0xBAC0;
+
+    return true;
+}
+
+int bip6_send_mpdu(
+    BACNET_IP6_ADDRESS * addr,
+    uint8_t * mtu,
+    uint16_t mtu_len)
+{
+    bvlc6_address_copy(&Test_Sent_Addr, addr);
+    memcpy(Test_Sent, mtu, mtu_len);
+    Test_Sent_Len = mtu_len;
+    Test_Sent_Count++;
+
+    return mtu_len;
+}
+
+static void test_BVLC6_Address(
+    Test * pTest)
+{
+    BACNET_IP6_ADDRESS addr = { { 0 }, 0 }, test_addr = { { 0 }, 0 };
+    BACNET_ADDRESS vmac = { 0 };
+    uint8_t pdu[BIP6_ADDRESS_MAX] = { 0 };
+    uint16_t group[8] = { 0 };
+    uint32_t device_id = 0;
+
+    ct_test(pTest, bvlc6_address_set(&addr, 0xFE80, 0, 0, 0, 0x0211,
+            0x22FF, 0xFE33, 0x4455));
+    addr.port = 0xBAC0;
+    ct_test(pTest, addr.address[0] == 0xFE);
+    ct_test(pTest, addr.address[1] == 0x80);
+    ct_test(pTest, addr.address[15] == 0x55);
+    ct_test(pTest, bvlc6_address_get(&addr, &group[0], &group[1],
+            &group[2], &group[3], &group[4], &group[5], &group[6],
+            &group[7]));
+    ct_test(pTest, group[0] == 0xFE80);
+    ct_test(pTest, group[4] == 0x0211);
+    ct_test(pTest, group[7] == 0x4455);
+    ct_test(pTest, bvlc6_encode_address(pdu, sizeof(pdu),
+            &addr) == BIP6_ADDRESS_MAX);
+    ct_test(pTest, pdu[16] == 0xBA);
+    ct_test(pTest, pdu[17] == 0xC0);
+    ct_test(pTest, bvlc6_encode_address(pdu, sizeof(pdu) - 1, &addr) == 0);
+    ct_test(pTest, bvlc6_decode_address(pdu, sizeof(pdu),
+            &test_addr) == BIP6_ADDRESS_MAX);
+    ct_test(pTest, !bvlc6_address_different(&addr, &test_addr));
+    test_addr.port++;
+    ct_test(pTest, bvlc6_address_different(&addr, &test_addr));
+    ct_test(pTest, bvlc6_address_copy(&test_addr, &addr));
+    ct_test(pTest, !bvlc6_address_different(&addr, &test_addr));
+
+    ct_test(pTest, bvlc6_vmac_address_set(&vmac, 4194303));
+    ct_test(pTest, vmac.mac_len == 3);
+    ct_test(pTest, vmac.net == 0);
+    ct_test(pTest, bvlc6_vmac_address_get(&vmac, &device_id));
+    ct_test(pTest, device_id == 4194303);
+    vmac.mac_len = 6;
+    ct_test(pTest, !bvlc6_vmac_address_get(&vmac, &device_id));
+}
+
+static void test_BVLC6_Codec(
+    Test * pTest)
+{
+    BACNET_IP6_ADDRESS addr = { { 0 }, 0 }, test_addr = { { 0 }, 0 };
+    BACNET_IP6_FOREIGN_DEVICE_TABLE_ENTRY fdt = { 0 }, test_fdt = { 0 };
+    uint8_t pdu[64] = { 0 };
+    uint8_t npdu[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    uint8_t test_npdu[8] = { 0 };
+    uint8_t message_type = 0;
+    uint16_t length = 0;
+    uint16_t test_len = 0;
+    uint16_t value = 0;
+    uint32_t vmac_src = 0, vmac_dst = 0;
+    int len = 0;
+
+    bvlc6_address_set(&addr, 0x2001, 0x0DB8, 0, 0, 0, 0, 0, 1);
+    addr.port = 47809;
+
+    len = bvlc6_encode_result(pdu, sizeof(pdu), 0x010203,
+        BVLC6_RESULT_ADDRESS_RESOLUTION_NAK);
+    ct_test(pTest, len == 9);
+    ct_test(pTest, bvlc6_decode_header(pdu, len, &message_type,
+            &length) == 4);
+    ct_test(pTest, message_type == BVLC6_RESULT);
+    ct_test(pTest, length == len);
+    ct_test(pTest, bvlc6_decode_result(&pdu[4], len - 4, &vmac_src,
+            &value) == 5);
+    ct_test(pTest, vmac_src == 0x010203);
+    ct_test(pTest, value == BVLC6_RESULT_ADDRESS_RESOLUTION_NAK);
+    ct_test(pTest, bvlc6_decode_result(&pdu[4], 4, &vmac_src, &value) == 0);
+
+    len = bvlc6_encode_original_unicast(pdu, sizeof(pdu), 1, 2, npdu,
+        sizeof(npdu));
+    ct_test(pTest, len == (10 + sizeof(npdu)));
+    ct_test(pTest, bvlc6_decode_header(pdu, len, &message_type, &length));
+    ct_test(pTest, message_type == BVLC6_ORIGINAL_UNICAST_NPDU);
+    ct_test(pTest, length == len);
+    ct_test(pTest, bvlc6_decode_original_unicast(&pdu[4], len - 4,
+            &vmac_src, &vmac_dst, test_npdu, sizeof(test_npdu),
+            &test_len) == (len - 4));
+    ct_test(pTest, (vmac_src == 1) && (vmac_dst == 2));
+    ct_test(pTest, test_len == sizeof(npdu));
+    ct_test(pTest, memcmp(npdu, test_npdu, sizeof(npdu)) == 0);
+    ct_test(pTest, bvlc6_decode_original_unicast(&pdu[4], len - 4,
+            &vmac_src, &vmac_dst, test_npdu, 4, &test_len) == 0);
+    ct_test(pTest, bvlc6_encode_original_unicast(pdu, 12, 1, 2, npdu,
+            sizeof(npdu)) == 0);
+
+    len = bvlc6_encode_original_broadcast(pdu, sizeof(pdu), 3, npdu,
+        sizeof(npdu));
+    ct_test(pTest, len == (7 + sizeof(npdu)));
+    ct_test(pTest, pdu[1] == BVLC6_ORIGINAL_BROADCAST_NPDU);
+    ct_test(pTest, bvlc6_decode_original_broadcast(&pdu[4], len - 4,
+            &vmac_src, test_npdu, sizeof(test_npdu), &test_len));
+    ct_test(pTest, vmac_src == 3);
+    ct_test(pTest, test_len == sizeof(npdu));
+
+    len = bvlc6_encode_address_resolution(pdu, sizeof(pdu), 4, 5);
+    ct_test(pTest, len == 10);
+    ct_test(pTest, pdu[1] == BVLC6_ADDRESS_RESOLUTION);
+    ct_test(pTest, bvlc6_decode_address_resolution(&pdu[4], len - 4,
+            &vmac_src, &vmac_dst) == 6);
+    ct_test(pTest, (vmac_src == 4) && (vmac_dst == 5));
+
+    len = bvlc6_encode_forwarded_address_resolution(pdu, sizeof(pdu), 6,
+        7, &addr);
+    ct_test(pTest, len == 28);
+    ct_test(pTest, pdu[1] == BVLC6_FORWARDED_ADDRESS_RESOLUTION);
+    ct_test(pTest, bvlc6_decode_forwarded_address_resolution(&pdu[4],
+            len - 4, &vmac_src, &vmac_dst, &test_addr) == 24);
+    ct_test(pTest, (vmac_src == 6) && (vmac_dst == 7));
+    ct_test(pTest, !bvlc6_address_different(&addr, &test_addr));
+
+    len = bvlc6_encode_address_resolution_ack(pdu, sizeof(pdu), 8, 9);
+    ct_test(pTest, (len == 10) && (pdu[1] == BVLC6_ADDRESS_RESOLUTION_ACK));
+    ct_test(pTest, bvlc6_decode_address_resolution_ack(&pdu[4], len - 4,
+            &vmac_src, &vmac_dst) == 6);
+    ct_test(pTest, (vmac_src == 8) && (vmac_dst == 9));
+
+    len = bvlc6_encode_virtual_address_resolution(pdu, sizeof(pdu), 10);
+    ct_test(pTest, (len == 7) &&
+        (pdu[1] == BVLC6_VIRTUAL_ADDRESS_RESOLUTION));
+    ct_test(pTest, bvlc6_decode_virtual_address_resolution(&pdu[4],
+            len - 4, &vmac_src) == 3);
+    ct_test(pTest, vmac_src == 10);
+
+    len = bvlc6_encode_virtual_address_resolution_ack(pdu, sizeof(pdu),
+        11, 12);
+    ct_test(pTest, (len == 10) &&
+        (pdu[1] == BVLC6_VIRTUAL_ADDRESS_RESOLUTION_ACK));
+    ct_test(pTest, bvlc6_decode_virtual_address_resolution_ack(&pdu[4],
+            len - 4, &vmac_src, &vmac_dst) == 6);
+    ct_test(pTest, (vmac_src == 11) && (vmac_dst == 12));
+
+    len = bvlc6_encode_forwarded_npdu(pdu, sizeof(pdu), 13, &addr, npdu,
+        sizeof(npdu));
+    ct_test(pTest, len == (25 + sizeof(npdu)));
+    ct_test(pTest, pdu[1] == BVLC6_FORWARDED_NPDU);
+    ct_test(pTest, bvlc6_decode_forwarded_npdu(&pdu[4], len - 4,
+            &vmac_src, &test_addr, test_npdu, sizeof(test_npdu),
+            &test_len));
+    ct_test(pTest, vmac_src == 13);
+    ct_test(pTest, !bvlc6_address_different(&addr, &test_addr));
+    ct_test(pTest, memcmp(npdu, test_npdu, sizeof(npdu)) == 0);
+
+    len = bvlc6_encode_register_foreign_device(pdu, sizeof(pdu), 14, 600);
+    ct_test(pTest, (len == 9) && (pdu[1] == BVLC6_REGISTER_FOREIGN_DEVICE));
+    ct_test(pTest, bvlc6_decode_register_foreign_device(&pdu[4], len - 4,
+            &vmac_src, &value) == 5);
+    ct_test(pTest, (vmac_src == 14) && (value == 600));
+
+    bvlc6_address_copy(&fdt.bip6_address, &addr);
+    len = bvlc6_encode_delete_foreign_device(pdu, sizeof(pdu), 15, &fdt);
+    ct_test(pTest, (len == 25) && (pdu[1] == BVLC6_DELETE_FOREIGN_DEVICE));
+    ct_test(pTest, bvlc6_decode_delete_foreign_device(&pdu[4], len - 4,
+            &vmac_src, &test_fdt) == 21);
+    ct_test(pTest, vmac_src == 15);
+    ct_test(pTest, !bvlc6_address_different(&fdt.bip6_address,
+            &test_fdt.bip6_address));
+
+    len = bvlc6_encode_secure_bvll(pdu, sizeof(pdu), npdu, sizeof(npdu));
+    ct_test(pTest, (len == 12) && (pdu[1] == BVLC6_SECURE_BVLL));
+    ct_test(pTest, bvlc6_decode_secure_bvll(&pdu[4], len - 4, test_npdu,
+            sizeof(test_npdu), &test_len));
+    ct_test(pTest, test_len == sizeof(npdu));
+
+    len = bvlc6_encode_distribute_broadcast_to_network(pdu, sizeof(pdu),
+        16, npdu, sizeof(npdu));
+    ct_test(pTest, (len == (7 + sizeof(npdu))) &&
+        (pdu[1] == BVLC6_DISTRIBUTE_BROADCAST_TO_NETWORK));
+    ct_test(pTest, bvlc6_decode_distribute_broadcast_to_network(&pdu[4],
+            len - 4, &vmac_src, test_npdu, sizeof(test_npdu), &test_len));
+    ct_test(pTest, vmac_src == 16);
+
+    pdu[0] = BVLL_TYPE_BACNET_IP6 + 1;
+    ct_test(pTest, bvlc6_decode_header(pdu, len, &message_type,
+            &length) == 0);
+}
+
+static void test_BVLC6_Handler(
+    Test * pTest)
+{
+    BACNET_IP6_ADDRESS peer = { { 0 }, 0 }, other = { { 0 }, 0 };
+    BACNET_IP6_ADDRESS test_addr = { { 0 }, 0 };
+    BACNET_ADDRESS src = { 0 }, dest = { 0 };
+    uint8_t pdu[64] = { 0 };
+    uint8_t npdu[4] = { 0x01, 0x00, 0x10, 0x08 };
+    uint32_t vmac_src = 0, vmac_dst = 0;
+    uint8_t message_type = 0;
+    uint16_t value = 0;
+    int len = 0;
+
+    bvlc6_init();
+    bvlc6_address_set(&peer, 0xFE80, 0, 0, 0, 0, 0, 0, 0x0022);
+    peer.port = 0xBAC0;
+    bvlc6_address_set(&other, 0xFE80, 0, 0, 0, 0, 0, 0, 0x0033);
+    other.port = 0xBAC0;
+
+    /* a Who-Is from device 1234: its address is learned */
+    len = bvlc6_encode_original_broadcast(pdu, sizeof(pdu), 1234, npdu,
+        sizeof(npdu));
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len) == 7);
+    ct_test(pTest, src.mac_len == 3);
+    ct_test(pTest, bvlc6_vmac_address_get(&src, &vmac_src));
+    ct_test(pTest, vmac_src == 1234);
+    ct_test(pTest, VMAC_Count() == 1);
+    /* so a reply goes straight to it */
+    Test_Sent_Count = 0;
+    ct_test(pTest, bvlc6_send_pdu(&src, NULL, npdu, sizeof(npdu)) == 14);
+    ct_test(pTest, Test_Sent_Count == 1);
+    ct_test(pTest, !bvlc6_address_different(&Test_Sent_Addr, &peer));
+    ct_test(pTest, Test_Sent[1] == BVLC6_ORIGINAL_UNICAST_NPDU);
+    ct_test(pTest, bvlc6_decode_original_unicast(&Test_Sent[4], 10,
+            &vmac_src, &vmac_dst, NULL, 0, NULL));
+    ct_test(pTest, (vmac_src == Test_VMAC) && (vmac_dst == 1234));
+    /* a broadcast goes to the BACnet/IPv6 multicast group */
+    memset(&dest, 0, sizeof(dest));
+    dest.net = BACNET_BROADCAST_NETWORK;
+    ct_test(pTest, bvlc6_send_pdu(&dest, NULL, npdu, sizeof(npdu)) == 11);
+    ct_test(pTest, Test_Sent[1] == BVLC6_ORIGINAL_BROADCAST_NPDU);
+    bip6_get_broadcast_addr(&test_addr);
+    ct_test(pTest, !bvlc6_address_different(&Test_Sent_Addr, &test_addr));
+    /* a node not known is asked for, and the NPDU dropped */
+    bvlc6_vmac_address_set(&dest, 5678);
+    ct_test(pTest, bvlc6_send_pdu(&dest, NULL, npdu, sizeof(npdu)) < 0);
+    ct_test(pTest, Test_Sent[1] == BVLC6_ADDRESS_RESOLUTION);
+    ct_test(pTest, bvlc6_decode_address_resolution(&Test_Sent[4], 6,
+            &vmac_src, &vmac_dst));
+    ct_test(pTest, vmac_dst == 5678);
+    /* and it answers */
+    len = bvlc6_encode_address_resolution_ack(pdu, sizeof(pdu), 5678,
+        Test_VMAC);
+    ct_test(pTest, bvlc6_handler(&other, &src, pdu, len) == 0);
+    ct_test(pTest, bvlc6_send_pdu(&dest, NULL, npdu, sizeof(npdu)) == 14);
+    ct_test(pTest, !bvlc6_address_different(&Test_Sent_Addr, &other));
+
+    /* unicast to this node is for the application; to another is not */
+    len = bvlc6_encode_original_unicast(pdu, sizeof(pdu), 1234, Test_VMAC,
+        npdu, sizeof(npdu));
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len) == 10);
+    len = bvlc6_encode_original_unicast(pdu, sizeof(pdu), 1234, 99, npdu,
+        sizeof(npdu));
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len) == 0);
+    /* a forwarded NPDU comes from the address inside it */
+    len = bvlc6_encode_forwarded_npdu(pdu, sizeof(pdu), 777, &other, npdu,
+        sizeof(npdu));
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len) == 25);
+    ct_test(pTest, bvlc6_vmac_address(777, &test_addr));
+    ct_test(pTest, !bvlc6_address_different(&test_addr, &other));
+    /* a truncated message is dropped */
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len - 1) == 0);
+
+    /* this node is asked for, directly and through a BBMD */
+    Test_Sent_Count = 0;
+    len = bvlc6_encode_address_resolution(pdu, sizeof(pdu), 4321,
+        Test_VMAC);
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len) == 0);
+    ct_test(pTest, Test_Sent_Count == 1);
+    ct_test(pTest, Test_Sent[1] == BVLC6_ADDRESS_RESOLUTION_ACK);
+    len = bvlc6_encode_address_resolution(pdu, sizeof(pdu), 4321, 99);
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len) == 0);
+    ct_test(pTest, Test_Sent_Count == 1);
+    len = bvlc6_encode_forwarded_address_resolution(pdu, sizeof(pdu),
+        4322, Test_VMAC, &other);
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len) == 0);
+    ct_test(pTest, Test_Sent_Count == 2);
+    ct_test(pTest, !bvlc6_address_different(&Test_Sent_Addr, &other));
+    len = bvlc6_encode_virtual_address_resolution(pdu, sizeof(pdu), 4323);
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len) == 0);
+    ct_test(pTest, Test_Sent[1] == BVLC6_VIRTUAL_ADDRESS_RESOLUTION_ACK);
+    /* it is not a BBMD */
+    len = bvlc6_encode_register_foreign_device(pdu, sizeof(pdu), 4324, 60);
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len) == 0);
+    ct_test(pTest, bvlc6_decode_header(Test_Sent, Test_Sent_Len,
+            &message_type, NULL));
+    ct_test(pTest, message_type == BVLC6_RESULT);
+    ct_test(pTest, bvlc6_decode_result(&Test_Sent[4], Test_Sent_Len - 4,
+            &vmac_src, &value));
+    ct_test(pTest, vmac_src == Test_VMAC);
+    ct_test(pTest, value == BVLC6_RESULT_REGISTER_FOREIGN_DEVICE_NAK);
+    len = bvlc6_encode_result(pdu, sizeof(pdu), 4324,
+        BVLC6_RESULT_REGISTER_FOREIGN_DEVICE_NAK);
+    ct_test(pTest, bvlc6_handler(&peer, &src, pdu, len) == 0);
+    ct_test(pTest, bvlc6_get_function_code() == BVLC6_RESULT);
+    ct_test(pTest, bvlc6_get_last_result() ==
+        BVLC6_RESULT_REGISTER_FOREIGN_DEVICE_NAK);
+
+    /* as a foreign device, broadcasts go through the BBMD */
+    ct_test(pTest, bvlc6_register_with_bbmd(&other, Test_VMAC, 60) == 9);
+    memset(&dest, 0, sizeof(dest));
+    ct_test(pTest, bvlc6_send_pdu(&dest, NULL, npdu, sizeof(npdu)) > 0);
+    ct_test(pTest, Test_Sent[1] == BVLC6_DISTRIBUTE_BROADCAST_TO_NETWORK);
+    ct_test(pTest, !bvlc6_address_different(&Test_Sent_Addr, &other));
+    Test_Sent_Count = 0;
+    bvlc6_maintenance_timer(59);
+    ct_test(pTest, Test_Sent_Count == 0);
+    bvlc6_maintenance_timer(1);
+    ct_test(pTest, Test_Sent_Count == 1);
+    ct_test(pTest, Test_Sent[1] == BVLC6_REGISTER_FOREIGN_DEVICE);
+    bvlc6_init();
+    ct_test(pTest, VMAC_Count() == 0);
+}
+
+void test_BVLC6(
+    Test * pTest)
+{
+    bool rc;
+
+    rc = ct_addTestFunction(pTest, test_BVLC6_Address);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, test_BVLC6_Codec);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, test_BVLC6_Handler);
+    assert(rc);
+}
+
+#ifdef TEST_BVLC6
+int main(
+    void)
+{
+    Test *pTest;
+
+    pTest = ct_create("BACnet Virtual Link Control IP/v6", NULL);
+    test_BVLC6(pTest);
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_BVLC6 */
+#endif /* TEST */
@@ -32,6 +32,7 @@
  -------------------------------------------
 ####COPYRIGHTEND####*/
 #include <stdint.h>
+#include <string.h>
 #include "bacenum.h"
 #include "bacdcode.h"
 #include "bacdef.h"
@@ -46,14 +47,13 @@ COV Subscribe Property
 COV Notification
 Unconfirmed COV Notification
 */
-static int notify_encode_apdu(
+/* encodes the notification up to its listOfValues */
+static int notify_encode_header(
     uint8_t * apdu,
     BACNET_COV_DATA * data)
 {
     int len = 0;        /* length of each encoding */
     int apdu_len = 0;   /* total length of the apdu, return value */
-    BACNET_PROPERTY_VALUE *value = NULL;        /* value in list */
-	BACNET_APPLICATION_DATA_VALUE *app_data = NULL;
 
     if (apdu) {
         /* tag 0 - subscriberProcessIdentifier */
@@ -75,6 +75,30 @@ static int notify_encode_apdu(
         /* tag 3 - timeRemaining */
         len = encode_context_unsigned(&apdu[apdu_len], 3, data->timeRemaining);
         apdu_len += len;
+    }
+
+    return apdu_len;
+}
+
+/** Encode the listOfValues of a COV notification.
+ * The result is the same for every subscriber of an object, so it can be
+ * encoded once and passed to ucov_notify_encode_apdu_values() or
+ * ccov_notify_encode_apdu_values() for each subscriber.
+ *
+ * @param apdu [out] buffer for the encoded list
+ * @param value_list [in] the first value, linked to the others
+ * @return number of bytes encoded
+ */
+int cov_notify_encode_value_list(
+    uint8_t * apdu,
+    BACNET_PROPERTY_VALUE * value_list)
+{
+    int len = 0;        /* length of each encoding */
+    int apdu_len = 0;   /* total length of the apdu, return value */
+    BACNET_PROPERTY_VALUE *value = NULL;        /* value in list */
+	BACNET_APPLICATION_DATA_VALUE *app_data = NULL;
+
+    if (apdu) {
         /* tag 4 - listOfValues */
         len = encode_opening_tag(&apdu[apdu_len], 4);
         apdu_len += len;
@@ -82,7 +106,7 @@ static int notify_encode_apdu(
         /* FIXME: for small implementations, we might try a partial
            approach like the rpm.c where the values are encoded with
            a separate function */
-        value = data->listOfValues;
+        value = value_list;
         while (value != NULL) {
             /* tag 0 - propertyIdentifier */
             len =
@@ -129,6 +153,69 @@ static int notify_encode_apdu(
     return apdu_len;
 }
 
+/** Size the listOfValues of a COV notification without encoding it.
+ *
+ * @param value_list [in] the first value, linked to the others
+ * @return the number of bytes cov_notify_encode_value_list() would encode,
+ *  or 0 if a value cannot be encoded
+ */
+int cov_notify_value_list_len(
+    BACNET_PROPERTY_VALUE * value_list)
+{
+    int len = 0;        /* length of each encoding */
+    int apdu_len = 0;   /* total length of the apdu, return value */
+    BACNET_PROPERTY_VALUE *value = NULL;        /* value in list */
+    BACNET_APPLICATION_DATA_VALUE *app_data = NULL;
+
+    /* tag 4 - listOfValues, opening and closing */
+    apdu_len = 2;
+    for (value = value_list; value != NULL; value = value->next) {
+        /* tag 0 - propertyIdentifier */
+        len = encode_bacnet_unsigned_len(value->propertyIdentifier);
+        apdu_len += encode_tag_len(0, (uint32_t) len) + len;
+        /* tag 1 - propertyArrayIndex OPTIONAL */
+        if (value->propertyArrayIndex != BACNET_ARRAY_ALL) {
+            len = encode_bacnet_unsigned_len(value->propertyArrayIndex);
+            apdu_len += encode_tag_len(1, (uint32_t) len) + len;
+        }
+        /* tag 2 - value, opening and closing */
+        apdu_len += 2;
+        for (app_data = &value->value; app_data != NULL;
+            app_data = app_data->next) {
+            len = bacapp_encode_application_data_len(app_data);
+            if (len <= 0) {
+                return 0;
+            }
+            apdu_len += len;
+        }
+        /* tag 3 - priority OPTIONAL */
+        if (value->priority != BACNET_NO_PRIORITY) {
+            len = encode_bacnet_unsigned_len(value->priority);
+            apdu_len += encode_tag_len(3, (uint32_t) len) + len;
+        }
+    }
+
+    return apdu_len;
+}
+
+static int notify_encode_apdu(
+    uint8_t * apdu,
+    BACNET_COV_DATA * data)
+{
+    int len = 0;        /* length of each encoding */
+    int apdu_len = 0;   /* total length of the apdu, return value */
+
+    if (apdu) {
+        len = notify_encode_header(&apdu[0], data);
+        apdu_len += len;
+        len = cov_notify_encode_value_list(&apdu[apdu_len],
+            data->listOfValues);
+        apdu_len += len;
+    }
+
+    return apdu_len;
+}
+
 int ccov_notify_encode_apdu(
     uint8_t * apdu,
     uint8_t invoke_id,
@@ -168,6 +255,70 @@ int ucov_notify_encode_apdu(
     return apdu_len;
 }
 
+/** Encode a confirmed COV notification around a listOfValues that was
+ * already encoded by cov_notify_encode_value_list().
+ * The data->listOfValues is not used.
+ *
+ * @param apdu [out] buffer for the APDU
+ * @param invoke_id [in] invoke ID of the request
+ * @param data [in] subscriber, device, object and time remaining
+ * @param values [in] the encoded listOfValues
+ * @param values_len [in] number of bytes in values
+ * @return number of bytes encoded
+ */
+int ccov_notify_encode_apdu_values(
+    uint8_t * apdu,
+    uint8_t invoke_id,
+    BACNET_COV_DATA * data,
+    uint8_t * values,
+    int values_len)
+{
+    int apdu_len = 0;   /* total length of the apdu, return value */
+
+    if (apdu && data && values) {
+        apdu[0] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST;
+        apdu[1] = encode_max_segs_max_apdu(0, MAX_APDU);
+        apdu[2] = invoke_id;
+        apdu[3] = SERVICE_CONFIRMED_COV_NOTIFICATION;
+        apdu_len = 4;
+        apdu_len += notify_encode_header(&apdu[apdu_len], data);
+        memcpy(&apdu[apdu_len], values, values_len);
+        apdu_len += values_len;
+    }
+
+    return apdu_len;
+}
+
+/** Encode an unconfirmed COV notification around a listOfValues that was
+ * already encoded by cov_notify_encode_value_list().
+ * The data->listOfValues is not used.
+ *
+ * @param apdu [out] buffer for the APDU
+ * @param data [in] subscriber, device, object and time remaining
+ * @param values [in] the encoded listOfValues
+ * @param values_len [in] number of bytes in values
+ * @return number of bytes encoded
+ */
+int ucov_notify_encode_apdu_values(
+    uint8_t * apdu,
+    BACNET_COV_DATA * data,
+    uint8_t * values,
+    int values_len)
+{
+    int apdu_len = 0;   /* total length of the apdu, return value */
+
+    if (apdu && data && values) {
+        apdu[0] = PDU_TYPE_UNCONFIRMED_SERVICE_REQUEST;
+        apdu[1] = SERVICE_UNCONFIRMED_COV_NOTIFICATION; /* service choice */
+        apdu_len = 2;
+        apdu_len += notify_encode_header(&apdu[apdu_len], data);
+        memcpy(&apdu[apdu_len], values, values_len);
+        apdu_len += values_len;
+    }
+
+    return apdu_len;
+}
+
 /* decode the service request only */
 /* COV and Unconfirmed COV are the same */
 int cov_notify_decode_service_request(
@@ -887,6 +1038,37 @@ void testCCOVNotifyData(
     testCOVNotifyData(pTest, data, &test_data);
 }
 
+/* the pre-encoded value list gives the same notification */
+void testCOVNotifyValues(
+    Test * pTest,
+    uint8_t invoke_id,
+    BACNET_COV_DATA * data)
+{
+    uint8_t apdu[480] = { 0 };
+    uint8_t test_apdu[480] = { 0 };
+    uint8_t values[128] = { 0 };
+    int values_len = 0;
+    int len = 0;
+    int test_len = 0;
+
+    values_len = cov_notify_encode_value_list(&values[0], data->listOfValues);
+    ct_test(pTest, values_len > 0);
+    ct_test(pTest,
+        cov_notify_value_list_len(data->listOfValues) == values_len);
+    len = ucov_notify_encode_apdu(&apdu[0], data);
+    test_len =
+        ucov_notify_encode_apdu_values(&test_apdu[0], data, &values[0],
+        values_len);
+    ct_test(pTest, len == test_len);
+    ct_test(pTest, memcmp(apdu, test_apdu, len) == 0);
+    len = ccov_notify_encode_apdu(&apdu[0], invoke_id, data);
+    test_len =
+        ccov_notify_encode_apdu_values(&test_apdu[0], invoke_id, data,
+        &values[0], values_len);
+    ct_test(pTest, len == test_len);
+    ct_test(pTest, memcmp(apdu, test_apdu, len) == 0);
+}
+
 void testCOVNotify(
     Test * pTest)
 {
@@ -916,6 +1098,7 @@ void testCOVNotify(
 
     testUCOVNotifyData(pTest, &data);
     testCCOVNotifyData(pTest, invoke_id, &data);
+    testCOVNotifyValues(pTest, invoke_id, &data);
 }
 
 void testCOVSubscribeData(
@@ -0,0 +1,144 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdint.h>
+#include "crc.h"
+
+/** @file crc.c  CRCs of the MS/TP frame header and data (Annex G) */
+
+/**
+ * Accumulates the CRC8 of an MS/TP frame header (Annex G.1).
+ *
+ * @param dataValue - one octet of the header
+ * @param crcValue - the CRC so far, 0xFF before the first octet
+ *
+ * @return the CRC including dataValue
+ */
+uint8_t CRC_Calc_Header(
+    uint8_t dataValue,
+    uint8_t crcValue)
+{
+    uint16_t crc;
+
+    crc = crcValue ^ dataValue; /* XOR C7..C0 with D7..D0 */
+    /* Exclusive OR the terms in the table (top down) */
+    crc =
+        crc ^ (crc << 1) ^ (crc << 2) ^ (crc << 3) ^ (crc << 4) ^ (crc << 5)
+        ^ (crc << 6) ^ (crc << 7);
+
+    /* Combine bits shifted out left hand end */
+    return (uint8_t) ((crc & 0xfe) ^ ((crc >> 8) & 1));
+}
+
+/**
+ * Accumulates the CRC16 of the data of an MS/TP frame (Annex G.2).
+ *
+ * @param dataValue - one octet of the data
+ * @param crcValue - the CRC so far, 0xFFFF before the first octet
+ *
+ * @return the CRC including dataValue
+ */
+uint16_t CRC_Calc_Data(
+    uint8_t dataValue,
+    uint16_t crcValue)
+{
+    uint16_t crcLow;
+
+    crcLow = (crcValue & 0xff) ^ dataValue;     /* XOR C7..C0 with D7..D0 */
+
+    /* Exclusive OR the terms in the table (top down) */
+    return (uint16_t) ((crcValue >> 8) ^ (crcLow << 8) ^ (crcLow << 3)
+        ^ (crcLow << 12) ^ (crcLow >> 4)
+        ^ (crcLow & 0x0f) ^ ((crcLow & 0x0f) << 7));
+}
+
+#ifdef TEST
+#include <assert.h>
+#include <string.h>
+
+#include "ctest.h"
+
+/* the header of a Token frame from 0x05 to 0x10, from Annex G.1 */
+void testCRC8(
+    Test * pTest)
+{
+    uint8_t crc = 0xff;
+
+    crc = CRC_Calc_Header(0x00, crc);
+    ct_test(pTest, crc == 0x55);
+    crc = CRC_Calc_Header(0x10, crc);
+    ct_test(pTest, crc == 0xC2);
+    crc = CRC_Calc_Header(0x05, crc);
+    ct_test(pTest, crc == 0xBC);
+    crc = CRC_Calc_Header(0x00, crc);
+    ct_test(pTest, crc == 0x95);
+    crc = CRC_Calc_Header(0x00, crc);
+    ct_test(pTest, crc == 0x73);
+    /* send the ones complement, which gives the check value */
+    ct_test(pTest, (uint8_t) ~crc == 0x8C);
+    crc = CRC_Calc_Header((uint8_t) ~crc, crc);
+    ct_test(pTest, crc == 0x55);
+}
+
+/* the data octets 0x01, 0x22, 0x30 from Annex G.2 */
+void testCRC16(
+    Test * pTest)
+{
+    uint16_t crc = 0xffff;
+
+    crc = CRC_Calc_Data(0x01, crc);
+    ct_test(pTest, crc == 0x1E0E);
+    crc = CRC_Calc_Data(0x22, crc);
+    ct_test(pTest, crc == 0xEB70);
+    crc = CRC_Calc_Data(0x30, crc);
+    ct_test(pTest, crc == 0x42EF);
+    /* the ones complement goes out least significant octet first */
+    crc = (uint16_t) ~crc;
+    ct_test(pTest, crc == 0xBD10);
+    crc = CRC_Calc_Data(0x10, 0x42EF);
+    crc = CRC_Calc_Data(0xBD, crc);
+    ct_test(pTest, crc == 0xF0B8);
+}
+
+#ifdef TEST_CRC
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("crc", NULL);
+    rc = ct_addTestFunction(pTest, testCRC8);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testCRC16);
+    assert(rc);
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_CRC */
+#endif /* TEST */
@@ -28,8 +28,10 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>     /* for memmove */
-//#include <time.h>       /* for timezone, localtime */
+#include <time.h>       /* for timezone, localtime */
+#include <sys/time.h>   /* for gettimeofday */
 #include "bacdef.h"
 #include "bacdcode.h"
 #include "bacenum.h"
@@ -54,6 +56,7 @@
 #include "bi.h"
 #include "bo.h"
 #include "bv.h"
+#include "trendlog.h"
 
 #if defined(__BORLANDC__) || defined(_WIN32)
 /* Not included in time.h as specified by The Open Group */
@@ -89,7 +92,8 @@ static object_functions_t My_Object_Table[] = {
             NULL /* Value_Lists */ ,
             NULL /* COV */ ,
             NULL /* COV Clear */ ,
-        NULL /* Intrinsic Reporting */ },
+            NULL /* Intrinsic Reporting */ ,
+        Device_Property_Table},
     {OBJECT_ANALOG_INPUT,
             Analog_Input_Init,
             Analog_Input_Count,
@@ -101,10 +105,11 @@ static object_functions_t My_Object_Table[] = {
             Analog_Input_Property_Lists,
             NULL /* ReadRangeInfo */ ,
             NULL /* Iterator */ ,
-            NULL /* Value_Lists */ ,
-            NULL /* COV */ ,
-            NULL /* COV Clear */ ,
-        Analog_Input_Intrinsic_Reporting},
+            Analog_Input_Encode_Value_List,
+            Analog_Input_Change_Of_Value,
+            Analog_Input_Change_Of_Value_Clear,
+            Analog_Input_Intrinsic_Reporting,
+        Analog_Input_Property_Table},
     {OBJECT_ANALOG_OUTPUT,
             Analog_Output_Init,
             Analog_Output_Count,
@@ -119,7 +124,8 @@ static object_functions_t My_Object_Table[] = {
             NULL /* Value_Lists */ ,
             NULL /* COV */ ,
             NULL /* COV Clear */ ,
-        NULL /* Intrinsic Reporting */ },
+            NULL /* Intrinsic Reporting */ ,
+        NULL /* Property_Table */ },
     {OBJECT_ANALOG_VALUE,
             Analog_Value_Init,
             Analog_Value_Count,
@@ -131,10 +137,11 @@ static object_functions_t My_Object_Table[] = {
             Analog_Value_Property_Lists,
             NULL /* ReadRangeInfo */ ,
             NULL /* Iterator */ ,
-            NULL /* Value_Lists */ ,
-            NULL /* COV */ ,
-            NULL /* COV Clear */ ,
-        Analog_Value_Intrinsic_Reporting},
+            Analog_Value_Encode_Value_List,
+            Analog_Value_Change_Of_Value,
+            Analog_Value_Change_Of_Value_Clear,
+            Analog_Value_Intrinsic_Reporting,
+        Analog_Value_Property_Table},
     {OBJECT_BINARY_INPUT,
             Binary_Input_Init,
             Binary_Input_Count,
@@ -149,7 +156,8 @@ static object_functions_t My_Object_Table[] = {
             Binary_Input_Encode_Value_List,
             Binary_Input_Change_Of_Value,
             Binary_Input_Change_Of_Value_Clear,
-        NULL /* Intrinsic Reporting */ },
+            NULL /* Intrinsic Reporting */ ,
+        NULL /* Property_Table */ },
     {OBJECT_BINARY_OUTPUT,
             Binary_Output_Init,
             Binary_Output_Count,
@@ -164,7 +172,8 @@ static object_functions_t My_Object_Table[] = {
             NULL /* Value_Lists */ ,
             NULL /* COV */ ,
             NULL /* COV Clear */ ,
-        NULL /* Intrinsic Reporting */ },
+            NULL /* Intrinsic Reporting */ ,
+        NULL /* Property_Table */ },
     {OBJECT_BINARY_VALUE,
             Binary_Value_Init,
             Binary_Value_Count,
@@ -179,7 +188,24 @@ static object_functions_t My_Object_Table[] = {
             NULL /* Value_Lists */ ,
             NULL /* COV */ ,
             NULL /* COV Clear */ ,
-        NULL /* Intrinsic Reporting */ },
+            NULL /* Intrinsic Reporting */ ,
+        NULL /* Property_Table */ },
+    {OBJECT_TRENDLOG,
+            Trend_Log_Init,
+            Trend_Log_Count,
+            Trend_Log_Index_To_Instance,
+            Trend_Log_Valid_Instance,
+            Trend_Log_Object_Name,
+            Trend_Log_Read_Property,
+            Trend_Log_Write_Property,
+            Trend_Log_Property_Lists,
+            Trend_Log_RR_Info,
+            NULL /* Iterator */ ,
+            NULL /* Value_Lists */ ,
+            NULL /* COV */ ,
+            NULL /* COV Clear */ ,
+            NULL /* Intrinsic Reporting */ ,
+        Trend_Log_Property_Table},
 #if 0
     {OBJECT_CHARACTERSTRING_VALUE,
             CharacterString_Value_Init,
@@ -195,7 +221,8 @@ static object_functions_t My_Object_Table[] = {
             NULL /* Value_Lists */ ,
             NULL /* COV */ ,
             NULL /* COV Clear */ ,
-        NULL /* Intrinsic Reporting */ },
+            NULL /* Intrinsic Reporting */ ,
+        NULL /* Property_Table */ },
 #endif
 #if defined(INTRINSIC_REPORTING)
     {OBJECT_NOTIFICATION_CLASS,
@@ -212,7 +239,8 @@ static object_functions_t My_Object_Table[] = {
             NULL /* Value_Lists */ ,
             NULL /* COV */ ,
             NULL /* COV Clear */ ,
-        NULL /* Intrinsic Reporting */ },
+            NULL /* Intrinsic Reporting */ ,
+        NULL /* Property_Table */ },
 #endif
 
     {MAX_BACNET_OBJECT_TYPE,
@@ -229,7 +257,8 @@ static object_functions_t My_Object_Table[] = {
             NULL /* Value_Lists */ ,
             NULL /* COV */ ,
             NULL /* COV Clear */ ,
-        NULL /* Intrinsic Reporting */ }
+            NULL /* Intrinsic Reporting */ ,
+        NULL /* Property_Table */ }
 };
 
 /** Glue function to let the Device object, when called by a handler,
@@ -322,6 +351,25 @@ void Device_Objects_Property_List(
     return;
 }
 
+/** For a given object type, returns its property descriptor table.
+ * @ingroup ObjHelpers
+ * @param object_type [in] The desired BACNET_OBJECT_TYPE
+ * @return The table, or NULL if the object type works from its
+ *         property lists only.
+ */
+const struct property_table_t *Device_Objects_Property_Table(
+    BACNET_OBJECT_TYPE object_type)
+{
+    struct object_functions *pObject = NULL;
+
+    pObject = Device_Objects_Find_Functions(object_type);
+    if ((pObject != NULL) && (pObject->Object_Property_Table != NULL)) {
+        return pObject->Object_Property_Table();
+    }
+
+    return NULL;
+}
+
 /** Commands a Device re-initialization, to a given state.
  * The request's password must match for the operation to succeed.
  * This implementation provides a framework, but doesn't
@@ -373,65 +421,6 @@ bool Device_Reinitialize(
     return status;
 }
 
-/* These three arrays are used by the ReadPropertyMultiple handler */
-static const int Device_Properties_Required[] = {
-    PROP_OBJECT_IDENTIFIER,
-    PROP_OBJECT_NAME,
-    PROP_OBJECT_TYPE,
-    PROP_SYSTEM_STATUS,
-    PROP_VENDOR_NAME,
-    PROP_VENDOR_IDENTIFIER,
-    PROP_MODEL_NAME,
-    PROP_FIRMWARE_REVISION,
-    PROP_APPLICATION_SOFTWARE_VERSION,
-    PROP_PROTOCOL_VERSION,
-    PROP_PROTOCOL_REVISION,
-    PROP_PROTOCOL_SERVICES_SUPPORTED,
-    PROP_PROTOCOL_OBJECT_TYPES_SUPPORTED,
-    PROP_OBJECT_LIST,
-    PROP_MAX_APDU_LENGTH_ACCEPTED,
-    PROP_SEGMENTATION_SUPPORTED,
-    PROP_APDU_TIMEOUT,
-    PROP_NUMBER_OF_APDU_RETRIES,
-    PROP_DEVICE_ADDRESS_BINDING,
-    PROP_DATABASE_REVISION,
-    -1
-};
-
-static const int Device_Properties_Optional[] = {
-#if defined(BACDL_MSTP)
-    PROP_MAX_MASTER,
-    PROP_MAX_INFO_FRAMES,
-#endif
-    PROP_DESCRIPTION,
-    PROP_LOCAL_TIME,
-    PROP_UTC_OFFSET,
-    PROP_LOCAL_DATE,
-    PROP_DAYLIGHT_SAVINGS_STATUS,
-    PROP_LOCATION,
-    PROP_ACTIVE_COV_SUBSCRIPTIONS,
-    -1
-};
-
-static const int Device_Properties_Proprietary[] = {
-    -1
-};
-
-void Device_Property_Lists(
-    const int **pRequired,
-    const int **pOptional,
-    const int **pProprietary)
-{
-    if (pRequired)
-        *pRequired = Device_Properties_Required;
-    if (pOptional)
-        *pOptional = Device_Properties_Optional;
-    if (pProprietary)
-        *pProprietary = Device_Properties_Proprietary;
-
-    return;
-}
-
 /* note: you really only need to define variables for
    properties that are writable or that may change.
    The properties that are constant can be hard coded
@@ -469,6 +458,27 @@ static bool Daylight_Savings_Status = false;    /* rely on OS */
 /* Max_Info_Frames - rely on MS/TP subsystem, if there is one */
 /* Device_Address_Binding - required, but relies on binding cache */
 static uint32_t Database_Revision = 0;
+/* pre-encoded values of the static properties, see Device_Properties */
+#ifndef DEVICE_PROPERTY_CACHE_SIZE
+#define DEVICE_PROPERTY_CACHE_SIZE 320
+#endif
+static struct property_cache_t Device_Property_Cache;
+/* Object_List index: the object identifiers of the Object_Table,
+   flattened, and rebuilt when the Database_Revision changes */
+static BACNET_OBJECT_ID *Object_List_Index;
+static unsigned Object_List_Index_Size;
+static unsigned Object_List_Index_Count;
+static uint32_t Object_List_Index_Revision;
+static bool Object_List_Index_Valid;
+/* Object_Name index: for each Object_List entry, the hash of its name
+   and the next entry in the same bucket, as index + 1, 0 ends */
+static uint32_t *Object_Name_Hash;
+static unsigned *Object_Name_Next;
+static unsigned *Object_Name_Buckets;
+static unsigned Object_Name_Buckets_Size;
+static void Device_Object_Name_Index_Update(
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance);
 /* Configuration_Files */
 /* Last_Restore_Time */
 /* Backup_Failure_Timeout */
@@ -549,10 +559,19 @@ bool Device_Set_Object_Name(
 {
     bool status = false;        /*return value */
 
+    bool index_current = false;
+
     if (!characterstring_same(&My_Object_Name, object_name)) {
+        index_current = Object_List_Index_Valid &&
+            (Object_List_Index_Revision == Database_Revision);
         /* Make the change and update the database revision */
         status = characterstring_copy(&My_Object_Name, object_name);
         Device_Inc_Database_Revision();
+        if (index_current) {
+            /* only the name changed: move it in the Object_Name index */
+            Device_Object_Name_Index_Update(OBJECT_DEVICE,
+                Object_Instance_Number);
+        }
     }
 
     return status;
@@ -666,6 +685,7 @@ bool Device_Set_Model_Name(
     if (length < sizeof(Model_Name)) {
         memmove(Model_Name, name, length);
         Model_Name[length] = 0;
+        Device_Property_Cache_Invalidate();
         status = true;
     }
 
@@ -693,6 +713,7 @@ bool Device_Set_Application_Software_Version(
     if (length < sizeof(Application_Software_Version)) {
         memmove(Application_Software_Version, name, length);
         Application_Software_Version[length] = 0;
+        Device_Property_Cache_Invalidate();
         status = true;
     }
 
@@ -714,6 +735,7 @@ bool Device_Set_Description(
     if (length < sizeof(Description)) {
         memmove(Description, name, length);
         Description[length] = 0;
+        Device_Property_Cache_Invalidate();
         status = true;
     }
 
@@ -735,6 +757,7 @@ bool Device_Set_Location(
     if (length < sizeof(Location)) {
         memmove(Location, name, length);
         Location[length] = 0;
+        Device_Property_Cache_Invalidate();
         status = true;
     }
 
@@ -756,7 +779,11 @@ uint8_t Device_Protocol_Revision(
 BACNET_SEGMENTATION Device_Segmentation_Supported(
     void)
 {
+#if BACNET_SEGMENTATION_ENABLED
+    return SEGMENTATION_BOTH;
+#else
     return SEGMENTATION_NONE;
+#endif
 }
 
 uint32_t Device_Database_Revision(
@@ -769,6 +796,8 @@ void Device_Set_Database_Revision(
     uint32_t revision)
 {
     Database_Revision = revision;
+    Object_List_Index_Valid = false;
+    Device_Property_Cache_Invalidate();
 }
 
 /*
@@ -780,6 +809,8 @@ void Device_Inc_Database_Revision(
     void)
 {
     Database_Revision++;
+    Object_List_Index_Valid = false;
+    Device_Property_Cache_Invalidate();
 }
 
 /** Get the total count of objects supported by this Device Object.
@@ -805,17 +836,10 @@ unsigned Device_Object_List_Count(
     return count;
 }
 
-/** Lookup the Object at the given array index in the Device's Object List.
- * Even though we don't keep a single linear array of objects in the Device,
- * this method acts as though we do and works through a virtual, concatenated
- * array of all of our object type arrays.
- *
- * @param array_index [in] The desired array index (1 to N)
- * @param object_type [out] The object's type, if found.
- * @param instance [out] The object's instance number, if found.
- * @return True if found, else false.
- */
-bool Device_Object_List_Identifier(
+/* Finds the Object at the given array index by working through a virtual,
+   concatenated array of all of our object type arrays. Used when the
+   Object_List index could not be built. */
+static bool Device_Object_List_Walk(
     uint32_t array_index,
     int *object_type,
     uint32_t * instance)
@@ -866,9 +890,231 @@ bool Device_Object_List_Identifier(
     return status;
 }
 
+/* hashes the characters and encoding that characterstring_same() compares */
+static uint32_t Device_Object_Name_Hash(
+    BACNET_CHARACTER_STRING * object_name)
+{
+    uint32_t hash = 2166136261UL;
+    size_t i = 0;
+
+    hash = (hash ^ object_name->encoding) * 16777619UL;
+    for (i = 0; i < object_name->length; i++) {
+        hash = (hash ^ (uint8_t) object_name->value[i]) * 16777619UL;
+    }
+
+    return hash;
+}
+
+/* adds an Object_List entry to the bucket of its name hash */
+static void Device_Object_Name_Link(
+    unsigned index)
+{
+    unsigned bucket = Object_Name_Hash[index] & (Object_Name_Buckets_Size - 1);
+
+    Object_Name_Next[index] = Object_Name_Buckets[bucket];
+    Object_Name_Buckets[bucket] = index + 1;
+}
+
+static void Device_Object_Name_Unlink(
+    unsigned index)
+{
+    unsigned *link = NULL;
+
+    link =
+        &Object_Name_Buckets[Object_Name_Hash[index] &
+        (Object_Name_Buckets_Size - 1)];
+    while (*link) {
+        if (*link == (index + 1)) {
+            *link = Object_Name_Next[index];
+            break;
+        }
+        link = &Object_Name_Next[*link - 1];
+    }
+    Object_Name_Next[index] = 0;
+}
+
+/* Builds the Object_List index from the Object_Table.
+   @return true if the index is usable */
+static bool Device_Object_List_Index_Build(
+    void)
+{
+    unsigned count = 0;
+    unsigned object_count = 0;
+    unsigned i = 0;
+    unsigned object_index = 0;
+    unsigned buckets_size = 0;
+    BACNET_OBJECT_ID *object_list = NULL;
+    uint32_t *name_hash = NULL;
+    unsigned *name_next = NULL;
+    unsigned *buckets = NULL;
+    BACNET_CHARACTER_STRING object_name;
+    struct object_functions *pObject = NULL;
+
+    count = Device_Object_List_Count();
+    Object_List_Index_Valid = false;
+    if (count > Object_List_Index_Size) {
+        object_list =
+            realloc(Object_List_Index, count * sizeof(BACNET_OBJECT_ID));
+        if (!object_list) {
+            return false;
+        }
+        Object_List_Index = object_list;
+        name_hash = realloc(Object_Name_Hash, count * sizeof(uint32_t));
+        if (!name_hash) {
+            return false;
+        }
+        Object_Name_Hash = name_hash;
+        name_next = realloc(Object_Name_Next, count * sizeof(unsigned));
+        if (!name_next) {
+            return false;
+        }
+        Object_Name_Next = name_next;
+        Object_List_Index_Size = count;
+    }
+    if ((count > Object_Name_Buckets_Size) || !Object_Name_Buckets) {
+        /* about one name per bucket, a power of two */
+        buckets_size = 16;
+        while (buckets_size < count) {
+            buckets_size <<= 1;
+        }
+        buckets = realloc(Object_Name_Buckets, buckets_size * sizeof(unsigned));
+        if (!buckets) {
+            return false;
+        }
+        Object_Name_Buckets = buckets;
+        Object_Name_Buckets_Size = buckets_size;
+    }
+    for (i = 0; i < Object_Name_Buckets_Size; i++) {
+        Object_Name_Buckets[i] = 0;
+    }
+    count = 0;
+    pObject = Object_Table;
+    while (pObject->Object_Type < MAX_BACNET_OBJECT_TYPE) {
+        if (pObject->Object_Count && pObject->Object_Index_To_Instance) {
+            object_count = pObject->Object_Count();
+            if (pObject->Object_Iterator) {
+                object_index = pObject->Object_Iterator(~(unsigned) 0);
+            }
+            for (i = 0; (i < object_count) &&
+                (count < Object_List_Index_Size); i++) {
+                if (pObject->Object_Iterator) {
+                    if (i > 0) {
+                        object_index = pObject->Object_Iterator(object_index);
+                    }
+                } else {
+                    object_index = i;
+                }
+                Object_List_Index[count].type = pObject->Object_Type;
+                Object_List_Index[count].instance =
+                    pObject->Object_Index_To_Instance(object_index);
+                Object_Name_Hash[count] = 0;
+                Object_Name_Next[count] = 0;
+                if (pObject->Object_Name &&
+                    pObject->Object_Name(Object_List_Index[count].instance,
+                        &object_name)) {
+                    Object_Name_Hash[count] =
+                        Device_Object_Name_Hash(&object_name);
+                    Device_Object_Name_Link(count);
+                }
+                count++;
+            }
+        }
+        pObject++;
+    }
+    Object_List_Index_Count = count;
+    Object_List_Index_Revision = Database_Revision;
+    Object_List_Index_Valid = true;
+
+    return true;
+}
+
+/* @return the Object_List index, rebuilt if the database has changed,
+   or NULL if it could not be built */
+static BACNET_OBJECT_ID *Device_Object_List_Index(
+    void)
+{
+    if (!Object_List_Index_Valid ||
+        (Object_List_Index_Revision != Database_Revision)) {
+        if (!Device_Object_List_Index_Build()) {
+            return NULL;
+        }
+    }
+
+    return Object_List_Index;
+}
+
+/** Lookup the Object at the given array index in the Device's Object List.
+ * The Object_List is kept as a flat index of the object identifiers of
+ * all of our object type arrays, which is rebuilt when the
+ * Database_Revision changes, so each lookup takes the same time.
+ * @note Objects that are created or deleted must increment the
+ *       Database_Revision, see Device_Inc_Database_Revision().
+ *
+ * @param array_index [in] The desired array index (1 to N)
+ * @param object_type [out] The object's type, if found.
+ * @param instance [out] The object's instance number, if found.
+ * @return True if found, else false.
+ */
+bool Device_Object_List_Identifier(
+    uint32_t array_index,
+    int *object_type,
+    uint32_t * instance)
+{
+    BACNET_OBJECT_ID *object_list = NULL;
+
+    /* array index zero is length - so invalid */
+    if (array_index == 0) {
+        return false;
+    }
+    object_list = Device_Object_List_Index();
+    if (!object_list) {
+        return Device_Object_List_Walk(array_index, object_type, instance);
+    }
+    if (array_index > Object_List_Index_Count) {
+        return false;
+    }
+    *object_type = object_list[array_index - 1].type;
+    *instance = object_list[array_index - 1].instance;
+
+    return true;
+}
+
+/* Moves an object in the Object_Name index after its name was written.
+   The index must have been current before the database revision that
+   the write caused, and stays current. */
+static void Device_Object_Name_Index_Update(
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance)
+{
+    unsigned i = 0;
+    BACNET_CHARACTER_STRING object_name;
+    struct object_functions *pObject = NULL;
+
+    pObject = Device_Objects_Find_Functions(object_type);
+    if ((pObject == NULL) || (pObject->Object_Name == NULL)) {
+        return;
+    }
+    for (i = 0; i < Object_List_Index_Count; i++) {
+        if ((Object_List_Index[i].type == object_type) &&
+            (Object_List_Index[i].instance == object_instance)) {
+            Device_Object_Name_Unlink(i);
+            if (pObject->Object_Name(object_instance, &object_name)) {
+                Object_Name_Hash[i] = Device_Object_Name_Hash(&object_name);
+                Device_Object_Name_Link(i);
+            }
+            Object_List_Index_Revision = Database_Revision;
+            Object_List_Index_Valid = true;
+            break;
+        }
+    }
+}
+
 /** Determine if we have an object with the given object_name.
  * If the object_type and object_instance pointers are not null,
  * and the lookup succeeds, they will be given the resulting values.
+ * The names are looked up in the Object_Name index, which is kept with
+ * the Object_List index, so only the objects whose name hash matches
+ * have their name read and compared.
  * @param object_name [in] The desired Object Name to look for.
  * @param object_type [out] The BACNET_OBJECT_TYPE of the matching Object.
  * @param object_instance [out] The object instance number of the matching Object.
@@ -886,7 +1132,37 @@ bool Device_Valid_Object_Name(
     bool check_id = false;
     BACNET_CHARACTER_STRING object_name2;
     struct object_functions *pObject = NULL;
+    uint32_t hash = 0;
+    unsigned link = 0;
+
+    if (Device_Object_List_Index()) {
+        hash = Device_Object_Name_Hash(object_name1);
+        link = Object_Name_Buckets[hash & (Object_Name_Buckets_Size - 1)];
+        while (link) {
+            i = link - 1;
+            link = Object_Name_Next[i];
+            if (Object_Name_Hash[i] != hash) {
+                continue;
+            }
+            type = Object_List_Index[i].type;
+            instance = Object_List_Index[i].instance;
+            pObject = Device_Objects_Find_Functions(type);
+            if ((pObject != NULL) && (pObject->Object_Name != NULL) &&
+                (pObject->Object_Name(instance, &object_name2) &&
+                    characterstring_same(object_name1, &object_name2))) {
+                found = true;
+                if (object_type) {
+                    *object_type = type;
+                }
+                if (object_instance) {
+                    *object_instance = instance;
+                }
+                break;
+            }
+        }
 
+        return found;
+    }
     max_objects = Device_Object_List_Count();
     for (i = 1; i <= max_objects; i++) {
         check_id = Device_Object_List_Identifier(i, &type, &instance);
@@ -1029,239 +1305,567 @@ bool Device_Daylight_Savings_Status(void)
     return Daylight_Savings_Status;
 }
 
-/* return the length of the apdu encoded or BACNET_STATUS_ERROR for error or
+/* The Device property encoders, one per property.  Each returns the
+   length of the apdu encoded or BACNET_STATUS_ERROR for error or
    BACNET_STATUS_ABORT for abort message */
-int Device_Read_Property_Local(
-    BACNET_READ_PROPERTY_DATA * rpdata)
+static int Device_Read_Object_Identifier(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_object_id(&rpdata->application_data[0],
+        OBJECT_DEVICE, Object_Instance_Number);
+}
+
+static int Device_Read_Object_Name(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_character_string(&rpdata->application_data[0],
+        &My_Object_Name);
+}
+
+static int Device_Read_Object_Type(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        OBJECT_DEVICE);
+}
+
+static int Device_Read_Ansi_String(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    const char *value)
 {
-    int apdu_len = 0;   /* return value */
-    int len = 0;        /* apdu len intermediate value */
-    BACNET_BIT_STRING bit_string = { 0 };
     BACNET_CHARACTER_STRING char_string = { 0 };
+
+    characterstring_init_ansi(&char_string, value);
+
+    return encode_application_character_string(&rpdata->application_data[0],
+        &char_string);
+}
+
+static int Device_Read_Description(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return Device_Read_Ansi_String(rpdata, Description);
+}
+
+static int Device_Read_System_Status(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        System_Status);
+}
+
+static int Device_Read_Vendor_Name(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return Device_Read_Ansi_String(rpdata, Vendor_Name);
+}
+
+static int Device_Read_Vendor_Identifier(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        Vendor_Identifier);
+}
+
+static int Device_Read_Model_Name(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return Device_Read_Ansi_String(rpdata, Model_Name);
+}
+
+static int Device_Read_Firmware_Revision(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return Device_Read_Ansi_String(rpdata, BACnet_Version);
+}
+
+static int Device_Read_Application_Software_Version(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return Device_Read_Ansi_String(rpdata, Application_Software_Version);
+}
+
+static int Device_Read_Location(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return Device_Read_Ansi_String(rpdata, Location);
+}
+
+static int Device_Read_Local_Time(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    Update_Current_Time();
+
+    return encode_application_time(&rpdata->application_data[0],
+        &Local_Time);
+}
+
+static int Device_Read_UTC_Offset(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    Update_Current_Time();
+
+    return encode_application_signed(&rpdata->application_data[0],
+        UTC_Offset);
+}
+
+static int Device_Read_Local_Date(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    Update_Current_Time();
+
+    return encode_application_date(&rpdata->application_data[0],
+        &Local_Date);
+}
+
+static int Device_Read_Daylight_Savings_Status(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    Update_Current_Time();
+
+    return encode_application_boolean(&rpdata->application_data[0],
+        Daylight_Savings_Status);
+}
+
+static int Device_Read_Protocol_Version(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        Device_Protocol_Version());
+}
+
+static int Device_Read_Protocol_Revision(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        Device_Protocol_Revision());
+}
+
+static int Device_Read_Protocol_Services_Supported(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string = { 0 };
     uint32_t i = 0;
-    int object_type = 0;
-    uint32_t instance = 0;
-    uint32_t count = 0;
-    uint8_t *apdu = NULL;
+
+    /* Note: list of services that are executed, not initiated. */
+    bitstring_init(&bit_string);
+    for (i = 0; i < MAX_BACNET_SERVICES_SUPPORTED; i++) {
+        /* automatic lookup based on handlers set */
+        bitstring_set_bit(&bit_string, (uint8_t) i,
+            apdu_service_supported((BACNET_SERVICES_SUPPORTED) i));
+    }
+
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
+
+static int Device_Read_Protocol_Object_Types_Supported(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string = { 0 };
     struct object_functions *pObject = NULL;
-    bool found = false;
+    uint32_t i = 0;
 
-    if ((rpdata == NULL) || (rpdata->application_data == NULL) ||
-        (rpdata->application_data_len == 0)) {
-        return 0;
+    /* Note: this is the list of objects that can be in this device,
+       not a list of objects that this device can access */
+    bitstring_init(&bit_string);
+    for (i = 0; i < MAX_ASHRAE_OBJECT_TYPE; i++) {
+        /* initialize all the object types to not-supported */
+        bitstring_set_bit(&bit_string, (uint8_t) i, false);
+    }
+    /* set the object types with objects to supported */
+    pObject = Object_Table;
+    while (pObject->Object_Type < MAX_BACNET_OBJECT_TYPE) {
+        if ((pObject->Object_Count) && (pObject->Object_Count() > 0)) {
+            bitstring_set_bit(&bit_string, pObject->Object_Type, true);
+        }
+        pObject++;
     }
-    apdu = rpdata->application_data;
-    switch (rpdata->object_property) {
-        case PROP_OBJECT_IDENTIFIER:
-            apdu_len =
-                encode_application_object_id(&apdu[0], OBJECT_DEVICE,
-                Object_Instance_Number);
-            break;
-        case PROP_OBJECT_NAME:
-            apdu_len =
-                encode_application_character_string(&apdu[0], &My_Object_Name);
-            break;
-        case PROP_OBJECT_TYPE:
-            apdu_len = encode_application_enumerated(&apdu[0], OBJECT_DEVICE);
-            break;
-        case PROP_DESCRIPTION:
-            characterstring_init_ansi(&char_string, Description);
-            apdu_len =
-                encode_application_character_string(&apdu[0], &char_string);
-            break;
-        case PROP_SYSTEM_STATUS:
-            apdu_len = encode_application_enumerated(&apdu[0], System_Status);
-            break;
-        case PROP_VENDOR_NAME:
-            characterstring_init_ansi(&char_string, Vendor_Name);
-            apdu_len =
-                encode_application_character_string(&apdu[0], &char_string);
-            break;
-        case PROP_VENDOR_IDENTIFIER:
-            apdu_len =
-                encode_application_unsigned(&apdu[0], Vendor_Identifier);
-            break;
-        case PROP_MODEL_NAME:
-            characterstring_init_ansi(&char_string, Model_Name);
-            apdu_len =
-                encode_application_character_string(&apdu[0], &char_string);
-            break;
-        case PROP_FIRMWARE_REVISION:
-            characterstring_init_ansi(&char_string, BACnet_Version);
-            apdu_len =
-                encode_application_character_string(&apdu[0], &char_string);
-            break;
-        case PROP_APPLICATION_SOFTWARE_VERSION:
-            characterstring_init_ansi(&char_string,
-                Application_Software_Version);
-            apdu_len =
-                encode_application_character_string(&apdu[0], &char_string);
-            break;
-        case PROP_LOCATION:
-            characterstring_init_ansi(&char_string, Location);
-            apdu_len =
-                encode_application_character_string(&apdu[0], &char_string);
-            break;
-        case PROP_LOCAL_TIME:
-            Update_Current_Time();
-            apdu_len = encode_application_time(&apdu[0], &Local_Time);
-            break;
-        case PROP_UTC_OFFSET:
-            Update_Current_Time();
-            apdu_len = encode_application_signed(&apdu[0], UTC_Offset);
-            break;
-        case PROP_LOCAL_DATE:
-            Update_Current_Time();
-            apdu_len = encode_application_date(&apdu[0], &Local_Date);
-            break;
-        case PROP_DAYLIGHT_SAVINGS_STATUS:
-            Update_Current_Time();
-            apdu_len =
-                encode_application_boolean(&apdu[0], Daylight_Savings_Status);
-            break;
-        case PROP_PROTOCOL_VERSION:
-            apdu_len =
-                encode_application_unsigned(&apdu[0],
-                Device_Protocol_Version());
-            break;
-        case PROP_PROTOCOL_REVISION:
-            apdu_len =
-                encode_application_unsigned(&apdu[0],
-                Device_Protocol_Revision());
-            break;
-        case PROP_PROTOCOL_SERVICES_SUPPORTED:
-            /* Note: list of services that are executed, not initiated. */
-            bitstring_init(&bit_string);
-            for (i = 0; i < MAX_BACNET_SERVICES_SUPPORTED; i++) {
-                /* automatic lookup based on handlers set */
-                bitstring_set_bit(&bit_string, (uint8_t) i,
-                    apdu_service_supported((BACNET_SERVICES_SUPPORTED) i));
-            }
-            apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
-            break;
-        case PROP_PROTOCOL_OBJECT_TYPES_SUPPORTED:
-            /* Note: this is the list of objects that can be in this device,
-               not a list of objects that this device can access */
-            bitstring_init(&bit_string);
-            for (i = 0; i < MAX_ASHRAE_OBJECT_TYPE; i++) {
-                /* initialize all the object types to not-supported */
-                bitstring_set_bit(&bit_string, (uint8_t) i, false);
-            }
-            /* set the object types with objects to supported */
 
-            pObject = Object_Table;
-            while (pObject->Object_Type < MAX_BACNET_OBJECT_TYPE) {
-                if ((pObject->Object_Count) && (pObject->Object_Count() > 0)) {
-                    bitstring_set_bit(&bit_string, pObject->Object_Type, true);
-                }
-                pObject++;
-            }
-            apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
-            break;
-        case PROP_OBJECT_LIST:
-            count = Device_Object_List_Count();
-            /* Array element zero is the number of objects in the list */
-            if (rpdata->array_index == 0)
-                apdu_len = encode_application_unsigned(&apdu[0], count);
-            /* if no index was specified, then try to encode the entire list */
-            /* into one packet.  Note that more than likely you will have */
-            /* to return an error if the number of encoded objects exceeds */
-            /* your maximum APDU size. */
-            else if (rpdata->array_index == BACNET_ARRAY_ALL) {
-                for (i = 1; i <= count; i++) {
-                    found =
-                        Device_Object_List_Identifier(i, &object_type,
-                        &instance);
-                    if (found) {
-                        len =
-                            encode_application_object_id(&apdu[apdu_len],
-                            object_type, instance);
-                        apdu_len += len;
-                        /* assume next one is the same size as this one */
-                        /* can we all fit into the APDU? Don't check for last entry */
-                        if ((i != count) && (apdu_len + len) >= MAX_APDU) {
-                            /* Abort response */
-                            rpdata->error_code =
-                                ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
-                            apdu_len = BACNET_STATUS_ABORT;
-                            break;
-                        }
-                    } else {
-                        /* error: internal error? */
-                        rpdata->error_class = ERROR_CLASS_SERVICES;
-                        rpdata->error_code = ERROR_CODE_OTHER;
-                        apdu_len = BACNET_STATUS_ERROR;
-                        break;
-                    }
-                }
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
+
+static int Device_Read_Object_List(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    int apdu_len = 0;   /* return value */
+    int len = 0;        /* apdu len intermediate value */
+    uint32_t i = 0;
+    int object_type = 0;
+    uint32_t instance = 0;
+    uint32_t count = 0;
+    uint8_t *apdu = NULL;
+    BACNET_OBJECT_ID *object_list = NULL;
+    bool found = false;
+
+    apdu = rpdata->application_data;
+    object_list = Device_Object_List_Index();
+    if (object_list) {
+        count = Object_List_Index_Count;
+    } else {
+        count = Device_Object_List_Count();
+    }
+    /* Array element zero is the number of objects in the list */
+    if (rpdata->array_index == 0)
+        apdu_len = encode_application_unsigned(&apdu[0], count);
+    /* if no index was specified, then try to encode the entire list */
+    /* into one packet.  Note that more than likely you will have */
+    /* to return an error if the number of encoded objects exceeds */
+    /* your maximum APDU size. */
+    else if (rpdata->array_index == BACNET_ARRAY_ALL) {
+        for (i = 1; i <= count; i++) {
+            if (object_list) {
+                object_type = object_list[i - 1].type;
+                instance = object_list[i - 1].instance;
+                found = true;
             } else {
                 found =
-                    Device_Object_List_Identifier(rpdata->array_index,
-                    &object_type, &instance);
-                if (found) {
-                    apdu_len =
-                        encode_application_object_id(&apdu[0], object_type,
-                        instance);
-                } else {
-                    rpdata->error_class = ERROR_CLASS_PROPERTY;
-                    rpdata->error_code = ERROR_CODE_INVALID_ARRAY_INDEX;
-                    apdu_len = BACNET_STATUS_ERROR;
+                    Device_Object_List_Identifier(i, &object_type, &instance);
+            }
+            if (found) {
+                len =
+                    encode_application_object_id(&apdu[apdu_len],
+                    object_type, instance);
+                apdu_len += len;
+                /* assume next one is the same size as this one */
+                /* can we all fit into the APDU? Don't check for last entry */
+                if ((i != count) &&
+                    (apdu_len + len) >= rpdata->application_data_len) {
+                    /* Abort response */
+                    rpdata->error_code =
+                        ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
+                    apdu_len = BACNET_STATUS_ABORT;
+                    break;
                 }
+            } else {
+                /* error: internal error? */
+                rpdata->error_class = ERROR_CLASS_SERVICES;
+                rpdata->error_code = ERROR_CODE_OTHER;
+                apdu_len = BACNET_STATUS_ERROR;
+                break;
             }
-            break;
-        case PROP_MAX_APDU_LENGTH_ACCEPTED:
-            apdu_len = encode_application_unsigned(&apdu[0], MAX_APDU);
-            break;
-        case PROP_SEGMENTATION_SUPPORTED:
-            apdu_len =
-                encode_application_enumerated(&apdu[0],
-                Device_Segmentation_Supported());
-            break;
-        case PROP_APDU_TIMEOUT:
-            apdu_len = encode_application_unsigned(&apdu[0], apdu_timeout());
-            break;
-        case PROP_NUMBER_OF_APDU_RETRIES:
-            apdu_len = encode_application_unsigned(&apdu[0], apdu_retries());
-            break;
-        case PROP_DEVICE_ADDRESS_BINDING:
-            /* FIXME: the real max apdu remaining should be passed into function */
-            apdu_len = address_list_encode(&apdu[0], MAX_APDU);
-            break;
-        case PROP_DATABASE_REVISION:
-            apdu_len =
-                encode_application_unsigned(&apdu[0], Database_Revision);
-            break;
-#if defined(BACDL_MSTP)
-        case PROP_MAX_INFO_FRAMES:
-            apdu_len =
-                encode_application_unsigned(&apdu[0],
-                dlmstp_max_info_frames());
-            break;
-        case PROP_MAX_MASTER:
+        }
+    } else {
+        found =
+            Device_Object_List_Identifier(rpdata->array_index, &object_type,
+            &instance);
+        if (found) {
             apdu_len =
-                encode_application_unsigned(&apdu[0], dlmstp_max_master());
-            break;
-#endif
-        case PROP_ACTIVE_COV_SUBSCRIPTIONS:
-            /* FIXME: the real max apdu should be passed into function */
-            apdu_len = handler_cov_encode_subscriptions(&apdu[0], MAX_APDU);
-            break;
-        default:
+                encode_application_object_id(&apdu[0], object_type, instance);
+        } else {
             rpdata->error_class = ERROR_CLASS_PROPERTY;
-            rpdata->error_code = ERROR_CODE_UNKNOWN_PROPERTY;
+            rpdata->error_code = ERROR_CODE_INVALID_ARRAY_INDEX;
             apdu_len = BACNET_STATUS_ERROR;
-            break;
+        }
+    }
+
+    return apdu_len;
+}
+
+static int Device_Read_Max_APDU_Length_Accepted(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        MAX_APDU);
+}
+
+static int Device_Read_Segmentation_Supported(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        Device_Segmentation_Supported());
+}
+
+static int Device_Read_APDU_Timeout(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        apdu_timeout());
+}
+
+static int Device_Read_Number_Of_APDU_Retries(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        apdu_retries());
+}
+
+#if BACNET_SEGMENTATION_ENABLED
+static int Device_Read_Max_Segments_Accepted(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        MAX_SEGMENTS_ACCEPTED);
+}
+
+static int Device_Read_APDU_Segment_Timeout(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        apdu_segment_timeout());
+}
+#endif
+
+static int Device_Read_Device_Address_Binding(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    int apdu_len = 0;
+
+    apdu_len =
+        address_list_encode(&rpdata->application_data[0],
+        rpdata->application_data_len);
+    if (apdu_len == BACNET_STATUS_ABORT) {
+        rpdata->error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
+    }
+
+    return apdu_len;
+}
+
+static int Device_Read_Database_Revision(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        Database_Revision);
+}
+
+#if defined(BACDL_MSTP)
+static int Device_Read_Max_Info_Frames(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        dlmstp_max_info_frames());
+}
+
+static int Device_Read_Max_Master(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        dlmstp_max_master());
+}
+#endif
+
+static int Device_Read_Active_COV_Subscriptions(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    int apdu_len = 0;
+
+    apdu_len =
+        handler_cov_encode_subscriptions(&rpdata->application_data[0],
+        (int) rpdata->application_data_len);
+    if (apdu_len == BACNET_STATUS_ABORT) {
+        rpdata->error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
     }
-    /*  only array properties can have array options */
-    if ((apdu_len >= 0) && (rpdata->object_property != PROP_OBJECT_LIST) &&
-        (rpdata->array_index != BACNET_ARRAY_ALL)) {
+
+    return apdu_len;
+}
+
+#if APDU_STATISTICS
+/* the per-service counters of apdu_handler(), one array element per
+   service that has been seen - see apdu_statistics_encode() */
+static int Device_Read_APDU_Statistics(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    int apdu_len = 0;   /* return value */
+    int len = 0;        /* apdu len intermediate value */
+    unsigned count = 0;
+    unsigned i = 0;
+    uint8_t *apdu = NULL;
+
+    apdu = rpdata->application_data;
+    count = apdu_statistics_count();
+    if (rpdata->array_index == 0) {
+        apdu_len = encode_application_unsigned(&apdu[0], count);
+    } else if (rpdata->array_index == BACNET_ARRAY_ALL) {
+        for (i = 1; i <= count; i++) {
+            if ((apdu_len + APDU_STATISTICS_ELEMENT_MAX) >
+                rpdata->application_data_len) {
+                rpdata->error_code =
+                    ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
+                apdu_len = BACNET_STATUS_ABORT;
+                break;
+            }
+            len = apdu_statistics_encode(&apdu[apdu_len], i);
+            apdu_len += len;
+        }
+    } else if (rpdata->array_index <= count) {
+        apdu_len = apdu_statistics_encode(&apdu[0], rpdata->array_index);
+    } else {
         rpdata->error_class = ERROR_CLASS_PROPERTY;
-        rpdata->error_code = ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY;
+        rpdata->error_code = ERROR_CODE_INVALID_ARRAY_INDEX;
         apdu_len = BACNET_STATUS_ERROR;
     }
 
     return apdu_len;
 }
+#endif
+
+/* The Device properties, as ReadPropertyMultiple lists them */
+static const struct property_descr_t Device_Property_Descr[] = {
+    {PROP_OBJECT_IDENTIFIER, PROPERTY_REQUIRED,
+        Device_Read_Object_Identifier},
+    {PROP_OBJECT_NAME, PROPERTY_REQUIRED | PROPERTY_CACHED,
+        Device_Read_Object_Name},
+    {PROP_OBJECT_TYPE, PROPERTY_REQUIRED, Device_Read_Object_Type},
+    {PROP_SYSTEM_STATUS, PROPERTY_REQUIRED, Device_Read_System_Status},
+    {PROP_VENDOR_NAME, PROPERTY_REQUIRED | PROPERTY_CACHED,
+        Device_Read_Vendor_Name},
+    {PROP_VENDOR_IDENTIFIER, PROPERTY_REQUIRED,
+        Device_Read_Vendor_Identifier},
+    {PROP_MODEL_NAME, PROPERTY_REQUIRED | PROPERTY_CACHED,
+        Device_Read_Model_Name},
+    {PROP_FIRMWARE_REVISION, PROPERTY_REQUIRED | PROPERTY_CACHED,
+        Device_Read_Firmware_Revision},
+    {PROP_APPLICATION_SOFTWARE_VERSION, PROPERTY_REQUIRED | PROPERTY_CACHED,
+        Device_Read_Application_Software_Version},
+    {PROP_PROTOCOL_VERSION, PROPERTY_REQUIRED, Device_Read_Protocol_Version},
+    {PROP_PROTOCOL_REVISION, PROPERTY_REQUIRED,
+        Device_Read_Protocol_Revision},
+    {PROP_PROTOCOL_SERVICES_SUPPORTED, PROPERTY_REQUIRED | PROPERTY_CACHED,
+        Device_Read_Protocol_Services_Supported},
+    {PROP_PROTOCOL_OBJECT_TYPES_SUPPORTED, PROPERTY_REQUIRED | PROPERTY_CACHED,
+        Device_Read_Protocol_Object_Types_Supported},
+    {PROP_OBJECT_LIST, PROPERTY_REQUIRED | PROPERTY_ARRAY,
+        Device_Read_Object_List},
+    {PROP_MAX_APDU_LENGTH_ACCEPTED, PROPERTY_REQUIRED,
+        Device_Read_Max_APDU_Length_Accepted},
+    {PROP_SEGMENTATION_SUPPORTED, PROPERTY_REQUIRED,
+        Device_Read_Segmentation_Supported},
+    {PROP_APDU_TIMEOUT, PROPERTY_REQUIRED, Device_Read_APDU_Timeout},
+    {PROP_NUMBER_OF_APDU_RETRIES, PROPERTY_REQUIRED,
+        Device_Read_Number_Of_APDU_Retries},
+    {PROP_DEVICE_ADDRESS_BINDING, PROPERTY_REQUIRED,
+        Device_Read_Device_Address_Binding},
+    {PROP_DATABASE_REVISION, PROPERTY_REQUIRED,
+        Device_Read_Database_Revision},
+#if defined(BACDL_MSTP)
+    {PROP_MAX_MASTER, PROPERTY_OPTIONAL, Device_Read_Max_Master},
+    {PROP_MAX_INFO_FRAMES, PROPERTY_OPTIONAL, Device_Read_Max_Info_Frames},
+#endif
+    {PROP_DESCRIPTION, PROPERTY_OPTIONAL | PROPERTY_CACHED,
+        Device_Read_Description},
+    {PROP_LOCAL_TIME, PROPERTY_OPTIONAL, Device_Read_Local_Time},
+    {PROP_UTC_OFFSET, PROPERTY_OPTIONAL, Device_Read_UTC_Offset},
+    {PROP_LOCAL_DATE, PROPERTY_OPTIONAL, Device_Read_Local_Date},
+    {PROP_DAYLIGHT_SAVINGS_STATUS, PROPERTY_OPTIONAL,
+        Device_Read_Daylight_Savings_Status},
+    {PROP_LOCATION, PROPERTY_OPTIONAL | PROPERTY_CACHED,
+        Device_Read_Location},
+    {PROP_ACTIVE_COV_SUBSCRIPTIONS, PROPERTY_OPTIONAL,
+        Device_Read_Active_COV_Subscriptions},
+#if BACNET_SEGMENTATION_ENABLED
+    {PROP_MAX_SEGMENTS_ACCEPTED, PROPERTY_OPTIONAL,
+        Device_Read_Max_Segments_Accepted},
+    {PROP_APDU_SEGMENT_TIMEOUT, PROPERTY_OPTIONAL,
+        Device_Read_APDU_Segment_Timeout},
+#endif
+#if APDU_STATISTICS
+    {(BACNET_PROPERTY_ID) APDU_STATISTICS_PROPERTY,
+        PROPERTY_PROPRIETARY | PROPERTY_ARRAY, Device_Read_APDU_Statistics},
+#endif
+};
+
+static const struct property_table_t Device_Properties =
+    PROPERTY_TABLE_CACHED(Device_Property_Descr, &Device_Property_Cache);
+
+/* These three arrays are used by the ReadPropertyMultiple handler,
+   and are filled from the property table on first use */
+#define DEVICE_PROPERTY_COUNT \
+    (sizeof(Device_Property_Descr) / sizeof(Device_Property_Descr[0]))
+static int Device_Properties_Required[DEVICE_PROPERTY_COUNT + 1];
+static int Device_Properties_Optional[DEVICE_PROPERTY_COUNT + 1];
+static int Device_Properties_Proprietary[DEVICE_PROPERTY_COUNT + 1];
+static bool Device_Properties_Valid;
+/* the pre-encoded PROPERTY_CACHED values */
+static uint8_t Device_Property_Cache_Data[DEVICE_PROPERTY_CACHE_SIZE];
+static struct property_cache_slot_t
+    Device_Property_Cache_Slot[DEVICE_PROPERTY_COUNT];
+static struct property_cache_t Device_Property_Cache = {
+    Device_Property_Cache_Data, sizeof(Device_Property_Cache_Data), 0,
+    Device_Property_Cache_Slot
+};
+
+void Device_Property_Lists(
+    const int **pRequired,
+    const int **pOptional,
+    const int **pProprietary)
+{
+    if (!Device_Properties_Valid) {
+        property_table_lists(&Device_Properties, Device_Properties_Required,
+            Device_Properties_Optional, Device_Properties_Proprietary);
+        Device_Properties_Valid = true;
+    }
+    if (pRequired)
+        *pRequired = Device_Properties_Required;
+    if (pOptional)
+        *pOptional = Device_Properties_Optional;
+    if (pProprietary)
+        *pProprietary = Device_Properties_Proprietary;
+
+    return;
+}
+
+const struct property_table_t *Device_Property_Table(
+    void)
+{
+    return &Device_Properties;
+}
+
+/** Drops the pre-encoded values of the static Device properties.
+ * It is called when the database revision changes or a property is
+ * written or set; call it also after changing the service handlers.
+ * @ingroup ObjIntf
+ */
+void Device_Property_Cache_Invalidate(
+    void)
+{
+    property_cache_invalidate(&Device_Properties);
+}
+
+/* return the length of the apdu encoded or BACNET_STATUS_ERROR for error or
+   BACNET_STATUS_ABORT for abort message */
+int Device_Read_Property_Local(
+    BACNET_READ_PROPERTY_DATA * rpdata)
+{
+    if ((rpdata == NULL) || (rpdata->application_data == NULL) ||
+        (rpdata->application_data_len == 0)) {
+        return 0;
+    }
+
+    return property_table_read(&Device_Properties, rpdata, 0);
+}
 
 /** Looks up the requested Object and Property, and encodes its Value in an APDU.
  * @ingroup ObjIntf
@@ -1357,6 +1961,26 @@ bool Device_Write_Property_Local(
                 apdu_timeout_set((uint16_t) value.type.Unsigned_Int);
             }
             break;
+#if BACNET_SEGMENTATION_ENABLED
+        case PROP_APDU_SEGMENT_TIMEOUT:
+            status =
+                WPValidateArgType(&value, BACNET_APPLICATION_TAG_UNSIGNED_INT,
+                &wp_data->error_class, &wp_data->error_code);
+            if (status) {
+                /* the segment timer is kept in 16 bits, and a zero
+                   timeout would fail every segmented transfer */
+                if ((value.type.Unsigned_Int > 0) &&
+                    (value.type.Unsigned_Int <= UINT16_MAX)) {
+                    apdu_segment_timeout_set((uint16_t) value.type.
+                        Unsigned_Int);
+                } else {
+                    status = false;
+                    wp_data->error_class = ERROR_CLASS_PROPERTY;
+                    wp_data->error_code = ERROR_CODE_VALUE_OUT_OF_RANGE;
+                }
+            }
+            break;
+#endif
         case PROP_VENDOR_IDENTIFIER:
             status =
                 WPValidateArgType(&value, BACNET_APPLICATION_TAG_UNSIGNED_INT,
@@ -1490,6 +2114,9 @@ bool Device_Write_Property_Local(
         case PROP_OBJECT_LIST:
         case PROP_MAX_APDU_LENGTH_ACCEPTED:
         case PROP_SEGMENTATION_SUPPORTED:
+#if BACNET_SEGMENTATION_ENABLED
+        case PROP_MAX_SEGMENTS_ACCEPTED:
+#endif
         case PROP_DEVICE_ADDRESS_BINDING:
         case PROP_DATABASE_REVISION:
         case PROP_ACTIVE_COV_SUBSCRIPTIONS:
@@ -1702,6 +2329,8 @@ void Device_Init(
         }
         pObject++;
     }
+    Object_List_Index_Valid = false;
+    Device_Property_Cache_Invalidate();
 }
 
 bool DeviceGetRRInfo(
@@ -1792,10 +2421,11 @@ bool WPValidateArgType(
     BACNET_ERROR_CLASS * pErrorClass,
     BACNET_ERROR_CODE * pErrorCode)
 {
-    pValue = pValue;
-    ucExpectedTag = ucExpectedTag;
-    pErrorClass = pErrorClass;
-    pErrorCode = pErrorCode;
+    if (pValue->tag == ucExpectedTag) {
+        return true;
+    }
+    *pErrorClass = ERROR_CLASS_PROPERTY;
+    *pErrorCode = ERROR_CODE_INVALID_DATA_TYPE;
 
     return false;
 }
@@ -1859,6 +2489,220 @@ void testDevice(
     return;
 }
 
+/* the Object_List index matches the walk through the object tables */
+void testDeviceObjectList(
+    Test * pTest)
+{
+    unsigned count = 0;
+    unsigned i = 0;
+    int object_type = 0;
+    uint32_t instance = 0;
+    int test_object_type = 0;
+    uint32_t test_instance = 0;
+    bool status = false;
+
+    Device_Init(NULL);
+    count = Device_Object_List_Count();
+    ct_test(pTest, count > 0);
+    for (i = 1; i <= count; i++) {
+        status = Device_Object_List_Identifier(i, &object_type, &instance);
+        ct_test(pTest, status == true);
+        status =
+            Device_Object_List_Walk(i, &test_object_type, &test_instance);
+        ct_test(pTest, status == true);
+        ct_test(pTest, object_type == test_object_type);
+        ct_test(pTest, instance == test_instance);
+    }
+    status = Device_Object_List_Identifier(0, &object_type, &instance);
+    ct_test(pTest, status == false);
+    status =
+        Device_Object_List_Identifier(count + 1, &object_type, &instance);
+    ct_test(pTest, status == false);
+    /* a new revision rebuilds the index */
+    Device_Inc_Database_Revision();
+    status = Device_Object_List_Identifier(count, &object_type, &instance);
+    ct_test(pTest, status == true);
+    ct_test(pTest, Object_List_Index_Revision == Database_Revision);
+}
+
+/* each object is found by its name through the Object_Name index */
+void testDeviceObjectName(
+    Test * pTest)
+{
+    unsigned count = 0;
+    unsigned i = 0;
+    int object_type = 0;
+    uint32_t instance = 0;
+    int test_object_type = 0;
+    uint32_t test_instance = 0;
+    bool status = false;
+    BACNET_CHARACTER_STRING object_name;
+    BACNET_CHARACTER_STRING old_name;
+
+    Device_Init(NULL);
+    count = Device_Object_List_Count();
+    for (i = 1; i <= count; i++) {
+        Device_Object_List_Identifier(i, &object_type, &instance);
+        status =
+            Device_Object_Name_Copy((BACNET_OBJECT_TYPE) object_type,
+            instance, &object_name);
+        ct_test(pTest, status == true);
+        status =
+            Device_Valid_Object_Name(&object_name, &test_object_type,
+            &test_instance);
+        ct_test(pTest, status == true);
+        ct_test(pTest, object_type == test_object_type);
+        ct_test(pTest, instance == test_instance);
+    }
+    characterstring_init_ansi(&object_name, "no such object");
+    status = Device_Valid_Object_Name(&object_name, NULL, NULL);
+    ct_test(pTest, status == false);
+    /* a name write keeps the index current */
+    Device_Object_Name(Device_Object_Instance_Number(), &old_name);
+    characterstring_init_ansi(&object_name, "Renamed Device");
+    Device_Set_Object_Name(&object_name);
+    ct_test(pTest, Object_List_Index_Valid == true);
+    ct_test(pTest, Object_List_Index_Revision == Database_Revision);
+    status =
+        Device_Valid_Object_Name(&object_name, &test_object_type,
+        &test_instance);
+    ct_test(pTest, status == true);
+    ct_test(pTest, test_object_type == OBJECT_DEVICE);
+    ct_test(pTest, test_instance == Device_Object_Instance_Number());
+    status = Device_Valid_Object_Name(&old_name, NULL, NULL);
+    ct_test(pTest, status == false);
+}
+
+/* every listed property reads through the property table */
+void testDevicePropertyTable(
+    Test * pTest)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    BACNET_READ_PROPERTY_DATA rpdata;
+    const int *pRequired = NULL;
+    const int *pOptional = NULL;
+    const int *pProprietary = NULL;
+    const struct property_table_t *table = NULL;
+    unsigned count = 0;
+    int len = 0;
+
+    Device_Init(NULL);
+    table = Device_Objects_Property_Table(OBJECT_DEVICE);
+    ct_test(pTest, table == Device_Property_Table());
+    Device_Property_Lists(&pRequired, &pOptional, &pProprietary);
+    count =
+        property_list_count(pRequired) + property_list_count(pOptional) +
+        property_list_count(pProprietary);
+    ct_test(pTest, count == table->count);
+    ct_test(pTest, pRequired[0] == PROP_OBJECT_IDENTIFIER);
+    rpdata.application_data = &apdu[0];
+    rpdata.application_data_len = sizeof(apdu);
+    rpdata.object_type = OBJECT_DEVICE;
+    rpdata.object_instance = Device_Object_Instance_Number();
+    rpdata.array_index = BACNET_ARRAY_ALL;
+    while (*pRequired != -1) {
+        rpdata.object_property = (BACNET_PROPERTY_ID) * pRequired++;
+        len = Device_Read_Property(&rpdata);
+        ct_test(pTest, len >= 0);
+    }
+    /* only arrays take an array index */
+    rpdata.object_property = PROP_OBJECT_LIST;
+    rpdata.array_index = 0;
+    len = Device_Read_Property(&rpdata);
+    ct_test(pTest, len > 0);
+    rpdata.object_property = PROP_OBJECT_NAME;
+    len = Device_Read_Property(&rpdata);
+    ct_test(pTest, len == BACNET_STATUS_ERROR);
+    ct_test(pTest, rpdata.error_code == ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY);
+    rpdata.object_property = PROP_PRESENT_VALUE;
+    rpdata.array_index = BACNET_ARRAY_ALL;
+    len = Device_Read_Property(&rpdata);
+    ct_test(pTest, len == BACNET_STATUS_ERROR);
+    ct_test(pTest, rpdata.error_code == ERROR_CODE_UNKNOWN_PROPERTY);
+}
+
+/* static values come from the cache until they change */
+void testDevicePropertyCache(
+    Test * pTest)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    uint8_t test_apdu[MAX_APDU] = { 0 };
+    BACNET_READ_PROPERTY_DATA rpdata;
+    BACNET_CHARACTER_STRING char_string;
+    const char *name = "Cached";
+    uint8_t tag_number = 0;
+    uint32_t len_value = 0;
+    int len = 0;
+    int test_len = 0;
+
+    Device_Init(NULL);
+    ct_test(pTest, Device_Property_Cache.used == 0);
+    rpdata.object_type = OBJECT_DEVICE;
+    rpdata.object_instance = Device_Object_Instance_Number();
+    rpdata.object_property = PROP_MODEL_NAME;
+    rpdata.array_index = BACNET_ARRAY_ALL;
+    rpdata.application_data = &apdu[0];
+    rpdata.application_data_len = sizeof(apdu);
+    len = Device_Read_Property(&rpdata);
+    ct_test(pTest, len > 0);
+    ct_test(pTest, Device_Property_Cache.used == (unsigned) len);
+    rpdata.application_data = &test_apdu[0];
+    test_len = Device_Read_Property(&rpdata);
+    ct_test(pTest, test_len == len);
+    ct_test(pTest, memcmp(&apdu[0], &test_apdu[0], len) == 0);
+    ct_test(pTest, Device_Property_Cache.used == (unsigned) len);
+    /* a new value is encoded on the next read */
+    Device_Set_Model_Name(name, strlen(name));
+    ct_test(pTest, Device_Property_Cache.used == 0);
+    test_len = Device_Read_Property(&rpdata);
+    ct_test(pTest, test_len > 0);
+    len =
+        decode_tag_number_and_value(&test_apdu[0], &tag_number, &len_value);
+    ct_test(pTest, tag_number == BACNET_APPLICATION_TAG_CHARACTER_STRING);
+    len += decode_character_string(&test_apdu[len], len_value, &char_string);
+    ct_test(pTest, len > 0);
+    ct_test(pTest, strcmp(characterstring_value(&char_string), name) == 0);
+    /* values that change are not cached */
+    rpdata.object_property = PROP_DATABASE_REVISION;
+    len = Device_Read_Property(&rpdata);
+    ct_test(pTest, len > 0);
+    ct_test(pTest, Device_Property_Cache.used == (unsigned) test_len);
+    Device_Inc_Database_Revision();
+    ct_test(pTest, Device_Property_Cache.used == 0);
+}
+
+#if BACNET_SEGMENTATION_ENABLED
+/* the APDU Segment Timeout takes only what the segment timer holds */
+void testDeviceSegmentTimeout(
+    Test * pTest)
+{
+    BACNET_WRITE_PROPERTY_DATA wp_data;
+    bool status = false;
+
+    Device_Init(NULL);
+    memset(&wp_data, 0, sizeof(wp_data));
+    wp_data.object_type = OBJECT_DEVICE;
+    wp_data.object_instance = Device_Object_Instance_Number();
+    wp_data.object_property = PROP_APDU_SEGMENT_TIMEOUT;
+    wp_data.array_index = BACNET_ARRAY_ALL;
+    wp_data.application_data_len =
+        encode_application_unsigned(&wp_data.application_data[0], 5000);
+    status = Device_Write_Property_Local(&wp_data);
+    ct_test(pTest, status == true);
+    wp_data.application_data_len =
+        encode_application_unsigned(&wp_data.application_data[0], 0);
+    status = Device_Write_Property_Local(&wp_data);
+    ct_test(pTest, status == false);
+    ct_test(pTest, wp_data.error_class == ERROR_CLASS_PROPERTY);
+    ct_test(pTest, wp_data.error_code == ERROR_CODE_VALUE_OUT_OF_RANGE);
+    wp_data.application_data_len =
+        encode_application_unsigned(&wp_data.application_data[0], 65536UL);
+    status = Device_Write_Property_Local(&wp_data);
+    ct_test(pTest, status == false);
+    ct_test(pTest, wp_data.error_code == ERROR_CODE_VALUE_OUT_OF_RANGE);
+}
+#endif
+
 #ifdef TEST_DEVICE
 int main(
     void)
@@ -1870,6 +2714,18 @@ int main(
     /* individual tests */
     rc = ct_addTestFunction(pTest, testDevice);
     assert(rc);
+    rc = ct_addTestFunction(pTest, testDeviceObjectList);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testDeviceObjectName);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testDevicePropertyTable);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testDevicePropertyCache);
+    assert(rc);
+#if BACNET_SEGMENTATION_ENABLED
+    rc = ct_addTestFunction(pTest, testDeviceSegmentTimeout);
+    assert(rc);
+#endif
 
     ct_setStream(pTest, stdout);
     ct_run(pTest);
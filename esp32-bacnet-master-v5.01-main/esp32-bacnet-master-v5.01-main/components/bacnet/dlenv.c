@@ -231,6 +231,9 @@ void dlenv_maintenance_timer(
  *   - BACNET_MAX_MASTER
  *   - BACNET_MSTP_BAUD
  *   - BACNET_MSTP_MAC
+ * - BACDL_ROUTER: (BACnet/IP to MS/TP router)
+ *   - those of both BACDL_BIP and BACDL_MSTP, and of BACDL_BIP6 with
+ *     a BACnet/IPv6 port
  * - BACDL_BIP6: (BACnet/IPv6)
  *   - BACNET_BIP6_PORT - UDP/IP port number (0..65534) used for BACnet/IPv6
  *     communications.  Default is 47808 (0xBAC0).
@@ -259,7 +262,7 @@ void dlenv_init(
         bip6_set_broadcast_addr(&addr);
     } else {
         bvlc6_address_set(&addr,
-                BIP6_MULTICAST_SITE_LOCAL, 0, 0, 0, 0, 0, 0,
+                BIP6_MULTICAST_SCOPE, 0, 0, 0, 0, 0, 0,
                 BIP6_MULTICAST_GROUP_ID);
         bip6_set_broadcast_addr(&addr);
     }
@@ -287,30 +290,24 @@ void dlenv_init(
         if (ntohs(bip_get_port()) < 1024)
             bip_set_port(htons(0xBAC0));
     }
-#elif defined(BACDL_MSTP)
+#endif
+#if defined(BACDL_MSTP) || defined(BACDL_ROUTER)
+    /* without these, the settings from the configuration are kept */
     pEnv = getenv("BACNET_MAX_INFO_FRAMES");
     if (pEnv) {
         dlmstp_set_max_info_frames(strtol(pEnv, NULL, 0));
-    } else {
-        dlmstp_set_max_info_frames(1);
     }
     pEnv = getenv("BACNET_MAX_MASTER");
     if (pEnv) {
         dlmstp_set_max_master(strtol(pEnv, NULL, 0));
-    } else {
-        dlmstp_set_max_master(127);
     }
     pEnv = getenv("BACNET_MSTP_BAUD");
     if (pEnv) {
         dlmstp_set_baud_rate(strtol(pEnv, NULL, 0));
-    } else {
-        dlmstp_set_baud_rate(38400);
     }
     pEnv = getenv("BACNET_MSTP_MAC");
     if (pEnv) {
         dlmstp_set_mac_address(strtol(pEnv, NULL, 0));
-    } else {
-        dlmstp_set_mac_address(127);
     }
 #endif
     pEnv = getenv("BACNET_APDU_TIMEOUT");
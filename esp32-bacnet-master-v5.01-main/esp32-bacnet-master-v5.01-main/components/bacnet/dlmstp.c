@@ -0,0 +1,532 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "bacdef.h"
+#include "bacaddr.h"
+#include "bacenum.h"
+#include "bits.h"
+#include "npdu.h"
+#include "config.h"
+#include "mstpdef.h"
+#include "mstp.h"
+#include "dlmstp.h"
+#include "rs485.h"
+
+/** @file dlmstp.c  BACnet MS/TP datalink for the ESP32 */
+
+/* the state machines must see every millisecond of silence on time */
+#ifndef MSTP_TASK_PRIORITY
+#define MSTP_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#endif
+#ifndef MSTP_TASK_STACK
+#define MSTP_TASK_STACK 3072
+#endif
+
+/* orders the copy of a packet before its ready flag */
+#define DLMSTP_BARRIER() __sync_synchronize()
+
+/* the settings of the configuration until dlenv_init() or
+   the Device object changes them */
+static volatile struct mstp_port_struct_t MSTP_Port = {
+    .This_Station = MSTP_MAC_ADDRESS,
+    .Nmax_info_frames = MSTP_MAX_INFO_FRAMES,
+    .Nmax_master = MSTP_MAX_MASTER
+};
+static uint8_t Input_Buffer[DLMSTP_MPDU_MAX];
+static uint8_t Output_Buffer[DLMSTP_MPDU_MAX];
+/* the PDUs waiting for the token, oldest first */
+static DLMSTP_PACKET PDU_Queue[MSTP_PDU_PACKET_COUNT];
+static unsigned PDU_Head;
+static unsigned PDU_Count;
+/* serializes the tasks that send with the MS/TP task */
+static SemaphoreHandle_t PDU_Mutex;
+/* the last PDU received, held until dlmstp_receive() takes it */
+static DLMSTP_PACKET Receive_Packet;
+static SemaphoreHandle_t Receive_Ready;
+static TaskHandle_t MSTP_Task;
+
+/**
+ * Tells whether a reply answers a Data Expecting Reply frame: the same
+ * invoke ID and service, the same version and priority, and if the
+ * request was routed, the same network and address.
+ *
+ * @param request_pdu - the NPDU of the request
+ * @param request_pdu_len - number of octets in the request
+ * @param src_address - MS/TP source of the request
+ * @param reply_pdu - the NPDU of the reply
+ * @param reply_pdu_len - number of octets in the reply
+ * @param dest_address - MS/TP destination of the reply
+ *
+ * @return true if the reply is for the request
+ */
+static bool dlmstp_compare_data_expecting_reply(
+    uint8_t * request_pdu,
+    uint16_t request_pdu_len,
+    uint8_t src_address,
+    uint8_t * reply_pdu,
+    uint16_t reply_pdu_len,
+    uint8_t dest_address)
+{
+    BACNET_ADDRESS request_src = { 0 }, request_dest = { 0 };
+    BACNET_ADDRESS reply_src = { 0 }, reply_dest = { 0 };
+    BACNET_NPDU_DATA request_npdu = { 0 }, reply_npdu = { 0 };
+    uint8_t request_invoke_id = 0, request_service = 0;
+    uint8_t reply_invoke_id = 0, reply_service = 0;
+    bool reply_has_service = true;
+    int offset = 0;
+
+    if (src_address != dest_address) {
+        return false;
+    }
+    offset =
+        npdu_decode(request_pdu, &request_dest, &request_src, &request_npdu);
+    if ((offset <= 0) || request_npdu.network_layer_message ||
+        (request_pdu_len < (offset + 4))) {
+        return false;
+    }
+    if ((request_pdu[offset] & 0xF0) != PDU_TYPE_CONFIRMED_SERVICE_REQUEST) {
+        return false;
+    }
+    request_invoke_id = request_pdu[offset + 2];
+    if (request_pdu[offset] & BAC_BIT3) {
+        /* segmented: sequence number and window come first */
+        if (request_pdu_len < (offset + 6)) {
+            return false;
+        }
+        request_service = request_pdu[offset + 5];
+    } else {
+        request_service = request_pdu[offset + 3];
+    }
+
+    offset = npdu_decode(reply_pdu, &reply_dest, &reply_src, &reply_npdu);
+    if ((offset <= 0) || reply_npdu.network_layer_message ||
+        (reply_pdu_len < (offset + 2))) {
+        return false;
+    }
+    reply_invoke_id = reply_pdu[offset + 1];
+    switch (reply_pdu[offset] & 0xF0) {
+        case PDU_TYPE_SIMPLE_ACK:
+        case PDU_TYPE_ERROR:
+            if (reply_pdu_len < (offset + 3)) {
+                return false;
+            }
+            reply_service = reply_pdu[offset + 2];
+            break;
+        case PDU_TYPE_COMPLEX_ACK:
+            if (reply_pdu[offset] & BAC_BIT3) {
+                if (reply_pdu_len < (offset + 5)) {
+                    return false;
+                }
+                reply_service = reply_pdu[offset + 4];
+            } else {
+                if (reply_pdu_len < (offset + 3)) {
+                    return false;
+                }
+                reply_service = reply_pdu[offset + 2];
+            }
+            break;
+        case PDU_TYPE_SEGMENT_ACK:
+        case PDU_TYPE_REJECT:
+        case PDU_TYPE_ABORT:
+            reply_has_service = false;
+            break;
+        default:
+            return false;
+    }
+    if (request_invoke_id != reply_invoke_id) {
+        return false;
+    }
+    if (reply_has_service && (request_service != reply_service)) {
+        return false;
+    }
+    if ((request_npdu.protocol_version != reply_npdu.protocol_version) ||
+        (request_npdu.priority != reply_npdu.priority)) {
+        return false;
+    }
+    if (request_src.net != reply_dest.net) {
+        return false;
+    }
+    if (request_src.net && ((request_src.len != reply_dest.len) ||
+            (memcmp(request_src.adr, reply_dest.adr, request_src.len) != 0))) {
+        return false;
+    }
+
+    return true;
+}
+
+/* called by the MS/TP state machine when a data frame for us
+   or for everyone has arrived */
+uint16_t MSTP_Put_Receive(
+    volatile struct mstp_port_struct_t *mstp_port)
+{
+    uint16_t pdu_len = 0;
+
+    if (Receive_Packet.ready) {
+        /* the last one has not been taken: drop this one */
+        return 0;
+    }
+    pdu_len = mstp_port->DataLength;
+    if (pdu_len > sizeof(Receive_Packet.pdu)) {
+        return 0;
+    }
+    MSTP_Fill_BACnet_Address(&Receive_Packet.address,
+        mstp_port->SourceAddress);
+    Receive_Packet.frame_type = mstp_port->FrameType;
+    Receive_Packet.pdu_len = pdu_len;
+    memcpy(Receive_Packet.pdu, (uint8_t *) & mstp_port->InputBuffer[0],
+        pdu_len);
+    DLMSTP_BARRIER();
+    Receive_Packet.ready = true;
+    (void) xSemaphoreGive(Receive_Ready);
+
+    return pdu_len;
+}
+
+static uint16_t dlmstp_frame_from_packet(
+    volatile struct mstp_port_struct_t *mstp_port,
+    DLMSTP_PACKET * pkt)
+{
+    uint8_t destination = MSTP_BROADCAST_ADDRESS;
+
+    if (pkt->address.mac_len == 1) {
+        destination = pkt->address.mac[0];
+    }
+
+    return MSTP_Create_Frame((uint8_t *) & mstp_port->OutputBuffer[0],
+        mstp_port->OutputBufferSize, pkt->frame_type, destination,
+        mstp_port->This_Station, pkt->pdu, pkt->pdu_len);
+}
+
+/* called by the MS/TP state machine when it holds the token */
+uint16_t MSTP_Get_Send(
+    volatile struct mstp_port_struct_t * mstp_port,
+    unsigned timeout)
+{
+    uint16_t len = 0;
+
+    (void) timeout;
+    if (xSemaphoreTake(PDU_Mutex, portMAX_DELAY) == pdTRUE) {
+        if (PDU_Count) {
+            len = dlmstp_frame_from_packet(mstp_port, &PDU_Queue[PDU_Head]);
+            PDU_Head = (PDU_Head + 1) % MSTP_PDU_PACKET_COUNT;
+            PDU_Count--;
+        }
+        (void) xSemaphoreGive(PDU_Mutex);
+    }
+
+    return len;
+}
+
+/* called by the MS/TP state machine while it answers a Data Expecting
+   Reply frame: the reply has to be the next PDU to go, else the request
+   is answered with Reply Postponed */
+uint16_t MSTP_Get_Reply(
+    volatile struct mstp_port_struct_t * mstp_port,
+    unsigned timeout)
+{
+    DLMSTP_PACKET *pkt = NULL;
+    uint8_t destination = 0;
+    uint16_t len = 0;
+
+    (void) timeout;
+    if (xSemaphoreTake(PDU_Mutex, portMAX_DELAY) == pdTRUE) {
+        if (PDU_Count) {
+            pkt = &PDU_Queue[PDU_Head];
+            destination = MSTP_BROADCAST_ADDRESS;
+            if (pkt->address.mac_len == 1) {
+                destination = pkt->address.mac[0];
+            }
+            if (dlmstp_compare_data_expecting_reply((uint8_t *) &
+                    mstp_port->InputBuffer[0], mstp_port->DataLength,
+                    mstp_port->SourceAddress, pkt->pdu, pkt->pdu_len,
+                    destination)) {
+                len = dlmstp_frame_from_packet(mstp_port, pkt);
+                PDU_Head = (PDU_Head + 1) % MSTP_PDU_PACKET_COUNT;
+                PDU_Count--;
+            }
+        }
+        (void) xSemaphoreGive(PDU_Mutex);
+    }
+
+    return len;
+}
+
+void MSTP_Send_Frame(
+    volatile struct mstp_port_struct_t *mstp_port,
+    uint8_t * buffer,
+    uint16_t nbytes)
+{
+    RS485_Send_Frame(mstp_port, buffer, nbytes);
+}
+
+/* runs the receive and node state machines on each octet received,
+   and at least once a millisecond for the timeouts */
+static void dlmstp_task(
+    void *pvParameters)
+{
+    volatile struct mstp_port_struct_t *port = &MSTP_Port;
+
+    (void) pvParameters;
+    for (;;) {
+        RS485_Wait_Event();
+        do {
+            while (RS485_Data_Pending() && !port->ReceivedValidFrame &&
+                !port->ReceivedInvalidFrame) {
+                RS485_Check_UART_Data(port);
+                MSTP_Receive_Frame_FSM(port);
+            }
+            MSTP_Receive_Frame_FSM(port);
+            if (port->This_Station > DEFAULT_MAX_MASTER) {
+                MSTP_Slave_Node_FSM(port);
+            } else if ((port->receive_state == MSTP_RECEIVE_STATE_IDLE) ||
+                port->ReceivedValidFrame || port->ReceivedInvalidFrame) {
+                while (MSTP_Master_Node_FSM(port)) {
+                    /* run again at once */
+                }
+            }
+        } while (RS485_Data_Pending() && !port->ReceivedValidFrame &&
+            !port->ReceivedInvalidFrame);
+    }
+}
+
+/* returns number of bytes queued on success, negative on failure */
+int dlmstp_send_pdu(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    DLMSTP_PACKET *pkt = NULL;
+    int bytes_sent = -1;
+
+    if (!PDU_Mutex || (pdu_len > MAX_PDU)) {
+        return -1;
+    }
+    if (xSemaphoreTake(PDU_Mutex, portMAX_DELAY) == pdTRUE) {
+        if (PDU_Count < MSTP_PDU_PACKET_COUNT) {
+            pkt =
+                &PDU_Queue[(PDU_Head + PDU_Count) % MSTP_PDU_PACKET_COUNT];
+            if (npdu_data->data_expecting_reply) {
+                pkt->frame_type = FRAME_TYPE_BACNET_DATA_EXPECTING_REPLY;
+            } else {
+                pkt->frame_type = FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY;
+            }
+            memcpy(pkt->pdu, pdu, pdu_len);
+            pkt->pdu_len = (uint16_t) pdu_len;
+            bacnet_address_copy(&pkt->address, dest);
+            PDU_Count++;
+            bytes_sent = (int) pdu_len;
+        }
+        (void) xSemaphoreGive(PDU_Mutex);
+    }
+
+    return bytes_sent;
+}
+
+/* returns the number of octets in the PDU, or zero on failure */
+uint16_t dlmstp_receive(
+    BACNET_ADDRESS * src,
+    uint8_t * pdu,
+    uint16_t max_pdu,
+    unsigned timeout)
+{
+    uint16_t pdu_len = 0;
+
+    if (!Receive_Ready) {
+        return 0;
+    }
+    if (!Receive_Packet.ready) {
+        (void) xSemaphoreTake(Receive_Ready, pdMS_TO_TICKS(timeout));
+    }
+    if (Receive_Packet.ready) {
+        DLMSTP_BARRIER();
+        if (Receive_Packet.pdu_len <= max_pdu) {
+            bacnet_address_copy(src, &Receive_Packet.address);
+            memcpy(pdu, Receive_Packet.pdu, Receive_Packet.pdu_len);
+            pdu_len = Receive_Packet.pdu_len;
+        }
+        DLMSTP_BARRIER();
+        Receive_Packet.ready = false;
+    }
+
+    return pdu_len;
+}
+
+void dlmstp_set_max_info_frames(
+    uint8_t max_info_frames)
+{
+    if (max_info_frames >= 1) {
+        MSTP_Port.Nmax_info_frames = max_info_frames;
+    }
+}
+
+uint8_t dlmstp_max_info_frames(
+    void)
+{
+    return MSTP_Port.Nmax_info_frames;
+}
+
+void dlmstp_set_max_master(
+    uint8_t max_master)
+{
+    if (max_master <= DEFAULT_MAX_MASTER) {
+        if (MSTP_Port.This_Station <= max_master) {
+            MSTP_Port.Nmax_master = max_master;
+        }
+    }
+}
+
+uint8_t dlmstp_max_master(
+    void)
+{
+    return MSTP_Port.Nmax_master;
+}
+
+void dlmstp_set_mac_address(
+    uint8_t mac_address)
+{
+    /* 255 is the broadcast address */
+    if (mac_address < MSTP_BROADCAST_ADDRESS) {
+        MSTP_Port.This_Station = mac_address;
+        if ((mac_address <= DEFAULT_MAX_MASTER) &&
+            (mac_address > MSTP_Port.Nmax_master)) {
+            MSTP_Port.Nmax_master = mac_address;
+        }
+    }
+}
+
+uint8_t dlmstp_mac_address(
+    void)
+{
+    return MSTP_Port.This_Station;
+}
+
+void dlmstp_set_baud_rate(
+    uint32_t baud)
+{
+    (void) RS485_Set_Baud_Rate(baud);
+}
+
+uint32_t dlmstp_baud_rate(
+    void)
+{
+    return RS485_Get_Baud_Rate();
+}
+
+void dlmstp_fill_bacnet_address(
+    BACNET_ADDRESS * src,
+    uint8_t mstp_address)
+{
+    MSTP_Fill_BACnet_Address(src, mstp_address);
+}
+
+void dlmstp_get_my_address(
+    BACNET_ADDRESS * my_address)
+{
+    MSTP_Fill_BACnet_Address(my_address, MSTP_Port.This_Station);
+}
+
+void dlmstp_get_broadcast_address(
+    BACNET_ADDRESS * dest)
+{
+    MSTP_Fill_BACnet_Address(dest, MSTP_BROADCAST_ADDRESS);
+}
+
+bool dlmstp_sole_master(
+    void)
+{
+    return MSTP_Port.SoleMaster;
+}
+
+bool dlmstp_send_pdu_queue_empty(
+    void)
+{
+    return (PDU_Count == 0);
+}
+
+bool dlmstp_send_pdu_queue_full(
+    void)
+{
+    return (PDU_Count >= MSTP_PDU_PACKET_COUNT);
+}
+
+void dlmstp_reset(
+    void)
+{
+    MSTP_Init(&MSTP_Port);
+}
+
+/**
+ * Starts the MS/TP datalink: the UART and its timer, and the task that
+ * runs the state machines.  The settings made before, by dlenv_init()
+ * for example, are kept.
+ *
+ * @param ifname - unused: the UART is the one set in the configuration
+ *
+ * @return true if the datalink is running
+ */
+bool dlmstp_init(
+    char *ifname)
+{
+    (void) ifname;
+    if (MSTP_Task) {
+        return true;
+    }
+    PDU_Mutex = xSemaphoreCreateMutex();
+    Receive_Ready = xSemaphoreCreateBinary();
+    if (!PDU_Mutex || !Receive_Ready) {
+        return false;
+    }
+    MSTP_Port.InputBuffer = Input_Buffer;
+    MSTP_Port.InputBufferSize = sizeof(Input_Buffer);
+    MSTP_Port.OutputBuffer = Output_Buffer;
+    MSTP_Port.OutputBufferSize = sizeof(Output_Buffer);
+    MSTP_Port.SilenceTimer = RS485_Silence_Milliseconds;
+    MSTP_Port.SilenceTimerReset = RS485_Silence_Reset;
+    RS485_Initialize();
+    MSTP_Init(&MSTP_Port);
+    if (xTaskCreate(dlmstp_task, "bacnet_mstp", MSTP_TASK_STACK, NULL,
+            MSTP_TASK_PRIORITY, &MSTP_Task) != pdPASS) {
+        RS485_Cleanup();
+        return false;
+    }
+
+    return true;
+}
+
+void dlmstp_cleanup(
+    void)
+{
+    if (MSTP_Task) {
+        vTaskDelete(MSTP_Task);
+        MSTP_Task = NULL;
+    }
+    RS485_Cleanup();
+}
@@ -0,0 +1,547 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include "config.h"
+#include "bacdef.h"
+#include "bacaddr.h"
+#include "npdu.h"
+#include "datalink.h"
+#include "dlqueue.h"
+#include "baclock.h"
+
+/** @file dlqueue.c  Priority transmit queue in front of the datalink */
+
+#if DATALINK_TX_QUEUE_SIZE && defined(datalink_transmit_pdu)
+
+#if (DATALINK_TX_QUEUE_SIZE > 255)
+#error "DATALINK_TX_QUEUE_SIZE must fit in a uint8_t"
+#endif
+
+/* the queues, in the order they are served */
+enum {
+    DLQUEUE_LIFE_SAFETY,
+    DLQUEUE_CRITICAL_EQUIPMENT,
+    DLQUEUE_URGENT,
+    DLQUEUE_NORMAL,
+    /* normal priority broadcasts, served only while they have credit */
+    DLQUEUE_BROADCAST,
+    DLQUEUE_MAX
+};
+
+/* broadcast credit is counted in thousandths of a broadcast,
+   so that the timer can add it a millisecond at a time */
+#define DLQUEUE_BROADCAST_COST 1000UL
+#define DLQUEUE_BROADCAST_CREDIT_MAX \
+    (DLQUEUE_BROADCAST_COST * DATALINK_TX_BROADCAST_BURST)
+
+typedef struct dlqueue_entry {
+    BACNET_ADDRESS dest;
+    BACNET_NPDU_DATA npdu_data;
+    uint16_t pdu_len;
+    uint8_t pdu[MAX_PDU];
+} DLQUEUE_ENTRY;
+
+/* FIFO of entry numbers */
+typedef struct dlqueue_fifo {
+    uint8_t head;
+    uint8_t count;
+    uint8_t entry[DATALINK_TX_QUEUE_SIZE];
+} DLQUEUE_FIFO;
+
+static DLQUEUE_ENTRY Queue_Entry[DATALINK_TX_QUEUE_SIZE];
+static DLQUEUE_FIFO Queue_Fifo[DLQUEUE_MAX];
+/* stack of unused entry numbers */
+static uint8_t Free_Entry[DATALINK_TX_QUEUE_SIZE];
+static uint8_t Free_Count;
+static uint32_t Broadcast_Credit;
+static bool Queue_Initialized;
+/* a task is handing the queue to the datalink */
+static bool Queue_Draining;
+/* every task that sends goes through the queue; it is never held
+   while the datalink sends */
+static BACLOCK Queue_Lock = BACLOCK_INITIALIZER;
+
+/** Empties the queue and refills the broadcast credit. */
+void dlqueue_init(
+    void)
+{
+    unsigned i = 0;
+
+    baclock_take(&Queue_Lock);
+    for (i = 0; i < DLQUEUE_MAX; i++) {
+        Queue_Fifo[i].head = 0;
+        Queue_Fifo[i].count = 0;
+    }
+    for (i = 0; i < DATALINK_TX_QUEUE_SIZE; i++) {
+        Free_Entry[i] = (uint8_t) i;
+    }
+    Free_Count = DATALINK_TX_QUEUE_SIZE;
+    Broadcast_Credit = DLQUEUE_BROADCAST_CREDIT_MAX;
+    Queue_Draining = false;
+    Queue_Initialized = true;
+    baclock_give(&Queue_Lock);
+}
+
+static void dlqueue_fifo_put(
+    DLQUEUE_FIFO * fifo,
+    uint8_t entry)
+{
+    unsigned tail = (fifo->head + fifo->count) % DATALINK_TX_QUEUE_SIZE;
+
+    fifo->entry[tail] = entry;
+    fifo->count++;
+}
+
+static uint8_t dlqueue_fifo_get(
+    DLQUEUE_FIFO * fifo)
+{
+    uint8_t entry = fifo->entry[fifo->head];
+
+    fifo->head = (uint8_t) ((fifo->head + 1) % DATALINK_TX_QUEUE_SIZE);
+    fifo->count--;
+
+    return entry;
+}
+
+/* global, local and remote broadcasts */
+static bool dlqueue_broadcast(
+    BACNET_ADDRESS * dest)
+{
+    return ((dest->net == BACNET_BROADCAST_NETWORK) || (dest->mac_len == 0)
+        || (dest->net && (dest->len == 0)));
+}
+
+static unsigned dlqueue_select(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data)
+{
+    switch (npdu_data->priority) {
+        case MESSAGE_PRIORITY_LIFE_SAFETY:
+            return DLQUEUE_LIFE_SAFETY;
+        case MESSAGE_PRIORITY_CRITICAL_EQUIPMENT:
+            return DLQUEUE_CRITICAL_EQUIPMENT;
+        case MESSAGE_PRIORITY_URGENT:
+            return DLQUEUE_URGENT;
+        default:
+            break;
+    }
+
+    return dlqueue_broadcast(dest) ? DLQUEUE_BROADCAST : DLQUEUE_NORMAL;
+}
+
+/* Takes the highest priority PDU that may go now off the queue, with
+   Queue_Lock held.  Its entry stays in use until dlqueue_transmit().
+   Returns the entry, or DATALINK_TX_QUEUE_SIZE if nothing may go. */
+static unsigned dlqueue_next_locked(
+    void)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < DLQUEUE_MAX; i++) {
+        if (Queue_Fifo[i].count == 0) {
+            continue;
+        }
+        if (i == DLQUEUE_BROADCAST) {
+            if (Broadcast_Credit < DLQUEUE_BROADCAST_COST) {
+                continue;
+            }
+            Broadcast_Credit -= DLQUEUE_BROADCAST_COST;
+        }
+        return dlqueue_fifo_get(&Queue_Fifo[i]);
+    }
+
+    return DATALINK_TX_QUEUE_SIZE;
+}
+
+/* Hands an entry taken off the queue to the datalink, with Queue_Lock
+   given, then frees it. */
+static void dlqueue_transmit(
+    unsigned entry)
+{
+    DLQUEUE_ENTRY *pEntry = &Queue_Entry[entry];
+    int bytes_sent = 0;
+
+    bytes_sent =
+        datalink_transmit_pdu(&pEntry->dest, &pEntry->npdu_data,
+        &pEntry->pdu[0], pEntry->pdu_len);
+#if PRINT_ENABLED
+    if (bytes_sent <= 0) {
+        fprintf(stderr, "DLQueue: failed to send a queued PDU!\n");
+    }
+#else
+    (void) bytes_sent;
+#endif
+    baclock_take(&Queue_Lock);
+    Free_Entry[Free_Count++] = (uint8_t) entry;
+    baclock_give(&Queue_Lock);
+}
+
+/* Sends everything that may go now, highest priority first, unless
+   another task is at it already - that one sends what is queued
+   meanwhile too. */
+static void dlqueue_drain(
+    void)
+{
+    unsigned entry = 0;
+
+    baclock_take(&Queue_Lock);
+    if (!Queue_Initialized || Queue_Draining) {
+        baclock_give(&Queue_Lock);
+        return;
+    }
+    Queue_Draining = true;
+    for (;;) {
+        entry = dlqueue_next_locked();
+        if (entry == DATALINK_TX_QUEUE_SIZE) {
+            break;
+        }
+        baclock_give(&Queue_Lock);
+        dlqueue_transmit(entry);
+        baclock_take(&Queue_Lock);
+    }
+    Queue_Draining = false;
+    baclock_give(&Queue_Lock);
+}
+
+/** Queues a PDU for the datalink by its network priority, then sends
+ * what may go now, unless another task is already sending - that task
+ * sends this PDU in its turn.
+ * Takes the place of datalink_send_pdu() for the handlers; the PDU is
+ * copied, so the caller may reuse its buffer straight away.
+ * If the queue is full, the most urgent queued PDU is sent to make room,
+ * or, when only metered broadcasts are waiting, the oldest one is dropped.
+ * If every entry is still being sent, the PDU is sent straight away.
+ *
+ * @param dest [in] destination address
+ * @param npdu_data [in] NPDU control information, including the priority
+ * @param pdu [in] the encoded NPDU and APDU
+ * @param pdu_len [in] number of bytes in the pdu
+ * @return pdu_len if the PDU was queued, or -1 if it is too big
+ */
+int dlqueue_send_pdu(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    DLQUEUE_ENTRY *pEntry = NULL;
+    unsigned entry = 0;
+
+    if (!dest || !npdu_data || !pdu || (pdu_len > MAX_PDU)) {
+        return -1;
+    }
+    baclock_take(&Queue_Lock);
+    if (!Queue_Initialized) {
+        dlqueue_init();
+    }
+    if (Free_Count == 0) {
+        entry = dlqueue_next_locked();
+        if (entry != DATALINK_TX_QUEUE_SIZE) {
+            baclock_give(&Queue_Lock);
+            dlqueue_transmit(entry);
+            baclock_take(&Queue_Lock);
+        } else if (Queue_Fifo[DLQUEUE_BROADCAST].count) {
+            entry = dlqueue_fifo_get(&Queue_Fifo[DLQUEUE_BROADCAST]);
+            Free_Entry[Free_Count++] = (uint8_t) entry;
+#if PRINT_ENABLED
+            fprintf(stderr, "DLQueue: dropped a broadcast!\n");
+#endif
+        }
+    }
+    if (Free_Count == 0) {
+        baclock_give(&Queue_Lock);
+        return datalink_transmit_pdu(dest, npdu_data, pdu, pdu_len);
+    }
+    entry = Free_Entry[--Free_Count];
+    pEntry = &Queue_Entry[entry];
+    bacnet_address_copy(&pEntry->dest, dest);
+    pEntry->npdu_data = *npdu_data;
+    memcpy(&pEntry->pdu[0], pdu, pdu_len);
+    pEntry->pdu_len = (uint16_t) pdu_len;
+    dlqueue_fifo_put(&Queue_Fifo[dlqueue_select(dest, npdu_data)],
+        (uint8_t) entry);
+    baclock_give(&Queue_Lock);
+    dlqueue_drain();
+
+    return (int) pdu_len;
+}
+
+/** Sends the metered broadcasts that have earned their credit.
+ * Call after dlqueue_timer_milliseconds().
+ */
+void dlqueue_task(
+    void)
+{
+    dlqueue_drain();
+}
+
+/** Refills the broadcast credit.
+ * @param milliseconds [in] time since the last call
+ */
+void dlqueue_timer_milliseconds(
+    uint16_t milliseconds)
+{
+    uint32_t credit = (uint32_t) milliseconds * DATALINK_TX_BROADCAST_RATE;
+
+    baclock_take(&Queue_Lock);
+    if (!Queue_Initialized) {
+        dlqueue_init();
+    }
+    if (credit > (DLQUEUE_BROADCAST_CREDIT_MAX - Broadcast_Credit)) {
+        Broadcast_Credit = DLQUEUE_BROADCAST_CREDIT_MAX;
+    } else {
+        Broadcast_Credit += credit;
+    }
+    baclock_give(&Queue_Lock);
+}
+
+/** @return the number of PDUs waiting to be sent */
+unsigned dlqueue_count(
+    void)
+{
+    unsigned count = 0;
+
+    baclock_take(&Queue_Lock);
+    count = DATALINK_TX_QUEUE_SIZE - Free_Count;
+    baclock_give(&Queue_Lock);
+
+    return count;
+}
+
+#ifdef TEST
+#include <assert.h>
+#include <pthread.h>
+#include "ctest.h"
+
+static uint8_t Sent_Tag[DATALINK_TX_QUEUE_SIZE * 2];
+static unsigned Sent_Count;
+/* PDUs sent by each tag, for the threaded test */
+static unsigned Sent_By_Tag[256];
+/* PDUs given to the datalink with Queue_Lock held */
+static unsigned Sent_Locked;
+
+/* the datalink: records the first octet of each PDU it is given */
+int datalink_transmit_pdu(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    (void) dest;
+    (void) npdu_data;
+    if (Queue_Lock.depth && pthread_equal(Queue_Lock.owner, pthread_self())) {
+        Sent_Locked++;
+    }
+    if (Sent_Count < sizeof(Sent_Tag)) {
+        Sent_Tag[Sent_Count++] = pdu[0];
+    }
+    Sent_By_Tag[pdu[0]]++;
+
+    return (int) pdu_len;
+}
+
+static void testQueue(
+    Test * pTest,
+    uint8_t tag,
+    bool broadcast,
+    BACNET_MESSAGE_PRIORITY priority)
+{
+    BACNET_ADDRESS dest = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t pdu[4] = { 0 };
+
+    if (!broadcast) {
+        dest.mac_len = 1;
+        dest.mac[0] = tag;
+    }
+    npdu_encode_npdu_data(&npdu_data, false, priority);
+    pdu[0] = tag;
+    ct_test(pTest, dlqueue_send_pdu(&dest, &npdu_data, pdu,
+            sizeof(pdu)) == sizeof(pdu));
+}
+
+void testDLQueue(
+    Test * pTest)
+{
+    unsigned i = 0;
+
+    /* the task that queues a PDU sends it */
+    dlqueue_init();
+    Sent_Count = 0;
+    Sent_Locked = 0;
+    testQueue(pTest, 2, false, MESSAGE_PRIORITY_NORMAL);
+    ct_test(pTest, Sent_Count == 1);
+    ct_test(pTest, dlqueue_count() == 0);
+
+    /* while another task sends, a burst of I-Am, a bulk reply, then
+       an alarm queue up behind it */
+    dlqueue_init();
+    Sent_Count = 0;
+    Queue_Draining = true;
+    for (i = 0; i < DATALINK_TX_BROADCAST_BURST + 2; i++) {
+        testQueue(pTest, 10 + i, true, MESSAGE_PRIORITY_NORMAL);
+    }
+    testQueue(pTest, 2, false, MESSAGE_PRIORITY_NORMAL);
+    testQueue(pTest, 1, true, MESSAGE_PRIORITY_LIFE_SAFETY);
+    ct_test(pTest, Sent_Count == 0);
+    ct_test(pTest, dlqueue_count() == DATALINK_TX_BROADCAST_BURST + 4);
+    Queue_Draining = false;
+    dlqueue_task();
+    ct_test(pTest, Sent_Count == DATALINK_TX_BROADCAST_BURST + 2);
+    ct_test(pTest, Sent_Tag[0] == 1);
+    ct_test(pTest, Sent_Tag[1] == 2);
+    for (i = 0; i < DATALINK_TX_BROADCAST_BURST; i++) {
+        ct_test(pTest, Sent_Tag[2 + i] == 10 + i);
+    }
+    /* the rest of the broadcasts wait for credit */
+    ct_test(pTest, dlqueue_count() == 2);
+    dlqueue_task();
+    ct_test(pTest, dlqueue_count() == 2);
+    dlqueue_timer_milliseconds(1000 / DATALINK_TX_BROADCAST_RATE);
+    dlqueue_task();
+    ct_test(pTest, dlqueue_count() == 1);
+    dlqueue_timer_milliseconds(60000);
+    dlqueue_task();
+    ct_test(pTest, dlqueue_count() == 0);
+    ct_test(pTest, Sent_Tag[Sent_Count - 1] ==
+        10 + DATALINK_TX_BROADCAST_BURST + 1);
+
+    /* a full queue makes room by sending, or by dropping a broadcast */
+    dlqueue_init();
+    Broadcast_Credit = 0;
+    Sent_Count = 0;
+    Queue_Draining = true;
+    for (i = 0; i < DATALINK_TX_QUEUE_SIZE; i++) {
+        testQueue(pTest, 10 + i, true, MESSAGE_PRIORITY_NORMAL);
+    }
+    testQueue(pTest, 2, false, MESSAGE_PRIORITY_NORMAL);
+    ct_test(pTest, Sent_Count == 0);
+    ct_test(pTest, dlqueue_count() == DATALINK_TX_QUEUE_SIZE);
+    testQueue(pTest, 3, false, MESSAGE_PRIORITY_URGENT);
+    ct_test(pTest, Sent_Count == 1);
+    ct_test(pTest, Sent_Tag[0] == 2);
+    Queue_Draining = false;
+    dlqueue_task();
+    ct_test(pTest, Sent_Count == 2);
+    ct_test(pTest, Sent_Tag[1] == 3);
+    /* the broadcasts wait for credit */
+    ct_test(pTest, dlqueue_count() == DATALINK_TX_QUEUE_SIZE - 1);
+    ct_test(pTest, Sent_Locked == 0);
+}
+
+#define TEST_THREADS 4
+#define TEST_LOOPS 100000
+
+static volatile bool Test_Senders_Done;
+
+static void *dlqueue_test_sender(
+    void *arg)
+{
+    BACNET_ADDRESS dest = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t pdu[4] = { 0 };
+    unsigned i;
+
+    pdu[0] = (uint8_t) (uintptr_t) arg;
+    dest.mac_len = 1;
+    dest.mac[0] = pdu[0];
+    npdu_encode_npdu_data(&npdu_data, false, MESSAGE_PRIORITY_NORMAL);
+    for (i = 0; i < TEST_LOOPS; i++) {
+        dlqueue_send_pdu(&dest, &npdu_data, pdu, sizeof(pdu));
+    }
+
+    return NULL;
+}
+
+static void *dlqueue_test_drainer(
+    void *arg)
+{
+    (void) arg;
+    while (!Test_Senders_Done) {
+        dlqueue_task();
+    }
+    dlqueue_task();
+
+    return NULL;
+}
+
+/* unicasts are never dropped, so each one must be sent exactly once */
+void testDLQueueThreads(
+    Test * pTest)
+{
+    pthread_t sender[TEST_THREADS];
+    pthread_t drainer;
+    uintptr_t i;
+
+    dlqueue_init();
+    memset(Sent_By_Tag, 0, sizeof(Sent_By_Tag));
+    Sent_Locked = 0;
+    Test_Senders_Done = false;
+    ct_test(pTest, pthread_create(&drainer, NULL, dlqueue_test_drainer,
+            NULL) == 0);
+    for (i = 0; i < TEST_THREADS; i++) {
+        ct_test(pTest, pthread_create(&sender[i], NULL, dlqueue_test_sender,
+                (void *) (i + 1)) == 0);
+    }
+    for (i = 0; i < TEST_THREADS; i++) {
+        pthread_join(sender[i], NULL);
+    }
+    Test_Senders_Done = true;
+    pthread_join(drainer, NULL);
+    ct_test(pTest, dlqueue_count() == 0);
+    for (i = 0; i < TEST_THREADS; i++) {
+        ct_test(pTest, Sent_By_Tag[i + 1] == TEST_LOOPS);
+    }
+    ct_test(pTest, Sent_Locked == 0);
+}
+
+#ifdef TEST_DLQUEUE
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("BACnet Datalink Queue", NULL);
+    /* individual tests */
+    rc = ct_addTestFunction(pTest, testDLQueue);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testDLQueueThreads);
+    assert(rc);
+
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_DLQUEUE */
+#endif /* TEST */
+#endif /* DATALINK_TX_QUEUE_SIZE */
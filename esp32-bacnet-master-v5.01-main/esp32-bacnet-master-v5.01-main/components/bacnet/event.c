@@ -91,6 +91,26 @@ int cevent_notify_encode_apdu(
     return apdu_len;
 }
 
+/** Maps the Priority of an event notification onto the network priority
+ * carried in the NPDU, so that alarms are not queued behind routine traffic.
+ *
+ * @param priority [in] event notification priority, 0 (highest) to 255
+ * @return the BACnet network priority for the notification
+ */
+BACNET_MESSAGE_PRIORITY event_notify_network_priority(
+    uint8_t priority)
+{
+    if (priority < 64) {
+        return MESSAGE_PRIORITY_LIFE_SAFETY;
+    } else if (priority < 128) {
+        return MESSAGE_PRIORITY_CRITICAL_EQUIPMENT;
+    } else if (priority < 192) {
+        return MESSAGE_PRIORITY_URGENT;
+    }
+
+    return MESSAGE_PRIORITY_NORMAL;
+}
+
 int event_notify_encode_service_request(
     uint8_t * apdu,
     BACNET_EVENT_NOTIFICATION_DATA * data)
@@ -0,0 +1,355 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "fifo.h"
+
+/** @file fifo.c  Byte FIFO shared by one writer and one reader
+ *
+ * The head only moves on FIFO_Put() and FIFO_Add(), and the tail only on
+ * FIFO_Get(), FIFO_Pull() and FIFO_Flush(), so one writer - such as a
+ * UART interrupt - and one reader can use the FIFO at the same time
+ * without a lock.  Both indexes run freely and wrap with the power of
+ * two buffer_len, so that head - tail is always the count.
+ */
+
+/* the data must be seen before the index that hands it over */
+#define FIFO_BARRIER() __sync_synchronize()
+
+/**
+ * Returns the number of bytes in the FIFO.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ *
+ * @return number of bytes in the FIFO
+ */
+unsigned FIFO_Count(
+    FIFO_BUFFER const *b)
+{
+    unsigned head, tail;        /* used to avoid volatile decision */
+
+    if (b) {
+        head = b->head;
+        tail = b->tail;
+        return head - tail;
+    }
+
+    return 0;
+}
+
+/**
+ * Tells whether the FIFO is full.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ *
+ * @return true if the FIFO is full, or b is NULL
+ */
+bool FIFO_Full(
+    FIFO_BUFFER const *b)
+{
+    return (b ? (FIFO_Count(b) == b->buffer_len) : true);
+}
+
+/**
+ * Tells whether there is room in the FIFO for a number of bytes.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ * @param count - number of bytes to be added
+ *
+ * @return true if all of them fit
+ */
+bool FIFO_Available(
+    FIFO_BUFFER const *b,
+    unsigned count)
+{
+    return (b ? (count <= (b->buffer_len - FIFO_Count(b))) : false);
+}
+
+/**
+ * Tells whether the FIFO is empty.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ *
+ * @return true if the FIFO is empty, or b is NULL
+ */
+bool FIFO_Empty(
+    FIFO_BUFFER const *b)
+{
+    return (b ? (FIFO_Count(b) == 0) : true);
+}
+
+/**
+ * Looks at the oldest byte without removing it.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ *
+ * @return the oldest byte, or 0 if the FIFO is empty
+ */
+uint8_t FIFO_Peek(
+    FIFO_BUFFER const *b)
+{
+    if (!FIFO_Empty(b)) {
+        FIFO_BARRIER();
+        return b->buffer[b->tail & (b->buffer_len - 1)];
+    }
+
+    return 0;
+}
+
+/**
+ * Removes the oldest byte.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ *
+ * @return the oldest byte, or 0 if the FIFO is empty
+ */
+uint8_t FIFO_Get(
+    FIFO_BUFFER * b)
+{
+    uint8_t data_byte = 0;
+
+    if (!FIFO_Empty(b)) {
+        FIFO_BARRIER();
+        data_byte = b->buffer[b->tail & (b->buffer_len - 1)];
+        FIFO_BARRIER();
+        b->tail++;
+    }
+
+    return data_byte;
+}
+
+/**
+ * Removes up to length of the oldest bytes.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ * @param data_bytes - where the bytes are copied, or NULL to drop them
+ * @param length - the most bytes to remove
+ *
+ * @return the number of bytes removed
+ */
+unsigned FIFO_Pull(
+    FIFO_BUFFER * b,
+    uint8_t * data_bytes,
+    unsigned length)
+{
+    unsigned count;
+    unsigned i;
+    unsigned tail;
+
+    count = FIFO_Count(b);
+    if (count > length) {
+        count = length;
+    }
+    if (count) {
+        FIFO_BARRIER();
+        tail = b->tail;
+        if (data_bytes) {
+            for (i = 0; i < count; i++) {
+                data_bytes[i] = b->buffer[(tail + i) & (b->buffer_len - 1)];
+            }
+        }
+        FIFO_BARRIER();
+        b->tail = tail + count;
+    }
+
+    return count;
+}
+
+/**
+ * Adds a byte.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ * @param data_byte - the byte to add
+ *
+ * @return true if there was room for it
+ */
+bool FIFO_Put(
+    FIFO_BUFFER * b,
+    uint8_t data_byte)
+{
+    if (b && !FIFO_Full(b)) {
+        b->buffer[b->head & (b->buffer_len - 1)] = data_byte;
+        FIFO_BARRIER();
+        b->head++;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Adds a number of bytes, all of them or none.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ * @param data_bytes - the bytes to add
+ * @param count - the number of bytes
+ *
+ * @return true if there was room for all of them
+ */
+bool FIFO_Add(
+    FIFO_BUFFER * b,
+    uint8_t * data_bytes,
+    unsigned count)
+{
+    unsigned head;
+    unsigned i;
+
+    if (b && data_bytes && FIFO_Available(b, count)) {
+        head = b->head;
+        for (i = 0; i < count; i++) {
+            b->buffer[(head + i) & (b->buffer_len - 1)] = data_bytes[i];
+        }
+        FIFO_BARRIER();
+        b->head = head + count;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Removes all the bytes.  Only the reader may do this.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ */
+void FIFO_Flush(
+    FIFO_BUFFER * b)
+{
+    if (b) {
+        b->tail = b->head;
+    }
+}
+
+/**
+ * Sets up a FIFO over a block of memory.
+ *
+ * @param b - pointer to FIFO_BUFFER structure
+ * @param buffer - the block of memory
+ * @param buffer_len - its size, which must be a power of two
+ */
+void FIFO_Init(
+    FIFO_BUFFER * b,
+    volatile uint8_t * buffer,
+    unsigned buffer_len)
+{
+    if (b) {
+        b->head = 0;
+        b->tail = 0;
+        b->buffer = buffer;
+        b->buffer_len = buffer_len;
+    }
+}
+
+#ifdef TEST
+#include <assert.h>
+#include <string.h>
+
+#include "ctest.h"
+
+/* fill, drain and wrap the FIFO */
+void testFIFOBuffer(
+    Test * pTest)
+{
+    FIFO_BUFFER test_buffer;
+    volatile uint8_t data_store[64];
+    uint8_t add_data[40] = { "RoseSteveLouPatRachelJessicaDaniAmyHerb" };
+    uint8_t test_add_data[40] = { 0 };
+    uint8_t test_data = 0;
+    unsigned index = 0;
+    unsigned count = 0;
+    unsigned pass = 0;
+    bool status = 0;
+
+    FIFO_Init(&test_buffer, data_store, sizeof(data_store));
+    ct_test(pTest, FIFO_Empty(&test_buffer));
+    ct_test(pTest, FIFO_Count(&test_buffer) == 0);
+
+    /* wrap around the end of the buffer a few times */
+    for (pass = 0; pass < 3; pass++) {
+        for (index = 0; index < sizeof(data_store); index++) {
+            ct_test(pTest, !FIFO_Full(&test_buffer));
+            status = FIFO_Put(&test_buffer, (uint8_t) (index + pass));
+            ct_test(pTest, status == true);
+            ct_test(pTest, !FIFO_Empty(&test_buffer));
+        }
+        ct_test(pTest, FIFO_Full(&test_buffer));
+        ct_test(pTest, FIFO_Count(&test_buffer) == sizeof(data_store));
+        status = FIFO_Put(&test_buffer, 42);
+        ct_test(pTest, status == false);
+        for (index = 0; index < sizeof(data_store); index++) {
+            test_data = FIFO_Peek(&test_buffer);
+            ct_test(pTest, test_data == (uint8_t) (index + pass));
+            test_data = FIFO_Get(&test_buffer);
+            ct_test(pTest, test_data == (uint8_t) (index + pass));
+        }
+        ct_test(pTest, FIFO_Empty(&test_buffer));
+        ct_test(pTest, FIFO_Get(&test_buffer) == 0);
+        /* leave the indexes off the start of the buffer */
+        status = FIFO_Put(&test_buffer, 42);
+        test_data = FIFO_Get(&test_buffer);
+        ct_test(pTest, test_data == 42);
+    }
+
+    /* many bytes at a time, across the end of the buffer */
+    for (pass = 0; pass < 4; pass++) {
+        ct_test(pTest, FIFO_Available(&test_buffer, sizeof(add_data)));
+        status = FIFO_Add(&test_buffer, add_data, sizeof(add_data));
+        ct_test(pTest, status == true);
+        ct_test(pTest, !FIFO_Available(&test_buffer, sizeof(add_data)));
+        status = FIFO_Add(&test_buffer, add_data, sizeof(add_data));
+        ct_test(pTest, status == false);
+        count = FIFO_Pull(&test_buffer, test_add_data, sizeof(test_add_data));
+        ct_test(pTest, count == sizeof(add_data));
+        ct_test(pTest, memcmp(add_data, test_add_data, count) == 0);
+    }
+    ct_test(pTest, FIFO_Empty(&test_buffer));
+
+    status = FIFO_Add(&test_buffer, add_data, sizeof(add_data));
+    count = FIFO_Pull(&test_buffer, NULL, 10);
+    ct_test(pTest, count == 10);
+    ct_test(pTest, FIFO_Count(&test_buffer) == (sizeof(add_data) - 10));
+    FIFO_Flush(&test_buffer);
+    ct_test(pTest, FIFO_Empty(&test_buffer));
+}
+
+#ifdef TEST_FIFO_BUFFER
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("FIFO Buffer", NULL);
+    rc = ct_addTestFunction(pTest, testFIFOBuffer);
+    assert(rc);
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_FIFO_BUFFER */
+#endif /* TEST */
@@ -25,6 +25,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include "config.h"
@@ -40,17 +41,26 @@
 #include "cov.h"
 #include "tsm.h"
 #include "dcc.h"
+#include "baclock.h"
 #if PRINT_ENABLED
 #include "bactext.h"
 #endif
 /* demo objects */
 #include "device.h"
 #include "handlers.h"
+#if defined(ESP_PLATFORM)
+#include "esp_heap_caps.h"
+#endif
 
 /** @file h_cov.c  Handles Change of Value (COV) services. */
 
 typedef struct BACnet_COV_Address{
     bool valid:1;
+    /* number of subscriptions sent to this address */
+    uint16_t refcount;
+    /* next address in the same hash bucket, or the next free address,
+       as index + 1, 0 ends */
+    uint16_t hash_next;
     BACNET_ADDRESS dest;
 } BACNET_COV_ADDRESS;
 
@@ -60,40 +70,127 @@ typedef struct BACnet_COV_Subscription_Flags {
     bool valid:1;
     bool issueConfirmedNotifications:1; /* optional */
     bool send_requested:1;
+    bool pending:1;     /* on the COV_Pending list */
 } BACNET_COV_SUBSCRIPTION_FLAGS;
 
 typedef struct BACnet_COV_Subscription {
     BACNET_COV_SUBSCRIPTION_FLAGS flag;
-    uint8_t dest_index;
     uint8_t invokeID;   /* for confirmed COV */
+    uint16_t dest_index;
+    /* next subscription to the same object, as index + 1, 0 ends */
+    uint16_t object_next;
+    /* next subscription in the same subscriber key bucket,
+       or the next free subscription, as index + 1, 0 ends */
+    uint16_t key_next;
     uint32_t subscriberProcessIdentifier;
     uint32_t lifetime;  /* optional */
     BACNET_OBJECT_ID monitoredObjectIdentifier;
 } BACNET_COV_SUBSCRIPTION;
 
+/* The subscription and address tables start empty and grow in steps,
+   up to these limits, from PSRAM when the target has it.
+   Entries are linked by index + 1 in 16 bits, so the limits
+   must stay below 65535. */
 #ifndef MAX_COV_SUBCRIPTIONS
-#define MAX_COV_SUBCRIPTIONS 128
+#define MAX_COV_SUBCRIPTIONS 1024
+#endif
+#ifndef COV_SUBSCRIPTIONS_GROW
+#define COV_SUBSCRIPTIONS_GROW 32
 #endif
-static BACNET_COV_SUBSCRIPTION COV_Subscriptions[MAX_COV_SUBCRIPTIONS];
 #ifndef MAX_COV_ADDRESSES
-#define MAX_COV_ADDRESSES 16
+#define MAX_COV_ADDRESSES 256
+#endif
+#ifndef COV_ADDRESSES_GROW
+#define COV_ADDRESSES_GROW 8
+#endif
+static BACNET_COV_SUBSCRIPTION *COV_Subscriptions;
+static unsigned COV_Subscriptions_Size;
+static uint16_t COV_Subscriptions_Free;
+static BACNET_COV_ADDRESS *COV_Addresses;
+static unsigned COV_Addresses_Size;
+static uint16_t COV_Addresses_Free;
+
+/* Subscriber index: a subscription is found from its subscriber
+   address, process identifier and monitored object. */
+#ifndef COV_KEY_HASH_SIZE
+#define COV_KEY_HASH_SIZE 128   /* power of two */
+#endif
+static uint16_t COV_Key_Hash[COV_KEY_HASH_SIZE];
+#ifndef COV_ADDRESS_HASH_SIZE
+#define COV_ADDRESS_HASH_SIZE 32        /* power of two */
+#endif
+static uint16_t COV_Address_Hash[COV_ADDRESS_HASH_SIZE];
+
+/* Monitored object index: the subscriptions to an object are chained
+   from the hash bucket of its object identifier. */
+#ifndef COV_OBJECT_HASH_SIZE
+#define COV_OBJECT_HASH_SIZE 64 /* power of two */
+#endif
+static uint16_t COV_Object_Hash[COV_OBJECT_HASH_SIZE];
+
+/* largest encoding of one Active_COV_Subscriptions element by
+   cov_encode_subscription() */
+#define COV_SUBSCRIPTION_ELEMENT_MAX (32 + MAX_MAC_LEN)
+
+/* Objects that changed since the last task, pushed by the objects
+   through handler_cov_object_changed(). */
+#ifndef MAX_COV_CHANGES
+#define MAX_COV_CHANGES 16
 #endif
-static BACNET_COV_ADDRESS COV_Addresses[MAX_COV_ADDRESSES];
+static BACNET_OBJECT_ID COV_Changes[MAX_COV_CHANGES];
+static unsigned COV_Changes_Count;
+/* set when a change did not fit: check every subscribed object once */
+static bool COV_Changes_Overflow;
+
+/* Subscriptions with a notification to send or a confirmation to wait
+   for; each subscription is on the list at most once, so the list is
+   sized like COV_Subscriptions. */
+static uint16_t *COV_Pending;
+static unsigned COV_Pending_Head;
+static unsigned COV_Pending_Count;
+
+/* listOfValues of the last object notified, encoded once per task pass
+   and shared by all of its subscribers; the buffer is sized from
+   cov_notify_value_list_len() and only grows */
+static BACNET_OBJECT_ID COV_Values_Object;
+static bool COV_Values_Valid;
+static int COV_Values_Len;
+static uint8_t *COV_Values_Apdu;
+static unsigned COV_Values_Size;
+
+/* the objects report their changes from whichever task writes them,
+   while the server task subscribes, expires and notifies */
+static BACLOCK COV_Lock = BACLOCK_INITIALIZER;
+
+/* resizes a table, from PSRAM when there is some */
+static void *cov_realloc(
+    void *ptr,
+    size_t size)
+{
+#if defined(ESP_PLATFORM)
+    void *new_ptr =
+        heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+    if (new_ptr) {
+        return new_ptr;
+    }
+#endif
+    return realloc(ptr, size);
+}
 
 /**
 * Gets the address from the list of COV addresses
 *
 * @param  index - offset into COV address list where address is stored
-* @param  dest - address to be filled when found
 *
-* @return true if valid address, false if not valid or not found
+* @return the address, or NULL if not valid or not found
 */
 static BACNET_ADDRESS *cov_address_get(
-    int index)
+    unsigned index)
 {
     BACNET_ADDRESS *cov_dest = NULL;
 
-    if (index < MAX_COV_ADDRESSES) {
+    if (index < COV_Addresses_Size) {
         if (COV_Addresses[index].valid) {
             cov_dest = &COV_Addresses[index].dest;
         }
@@ -102,74 +199,151 @@ static BACNET_ADDRESS *cov_address_get(
     return cov_dest;
 }
 
+/* hashes the parts of an address that bacnet_address_same() compares */
+static unsigned cov_address_hash(
+    BACNET_ADDRESS * dest)
+{
+    uint32_t key = 2166136261UL;
+    unsigned i = 0;
+    unsigned len = 0;
+
+    key = (key ^ (dest->net & 0xFF)) * 16777619UL;
+    key = (key ^ (dest->net >> 8)) * 16777619UL;
+    len = dest->len;
+    if (len > MAX_MAC_LEN) {
+        len = MAX_MAC_LEN;
+    }
+    for (i = 0; i < len; i++) {
+        key = (key ^ dest->adr[i]) * 16777619UL;
+    }
+    if (dest->net == 0) {
+        len = dest->mac_len;
+        if (len > MAX_MAC_LEN) {
+            len = MAX_MAC_LEN;
+        }
+        for (i = 0; i < len; i++) {
+            key = (key ^ dest->mac[i]) * 16777619UL;
+        }
+    }
+
+    return key & (COV_ADDRESS_HASH_SIZE - 1);
+}
+
+/**
+* Finds an address in the list of COV addresses
+*
+* @param  dest - address to look for
+*
+* @return index number 0..N, or -1 if not in the list
+*/
+static int cov_address_find(
+    BACNET_ADDRESS * dest)
+{
+    uint16_t link = 0;
+
+    link = COV_Address_Hash[cov_address_hash(dest)];
+    while (link) {
+        if (bacnet_address_same(dest, &COV_Addresses[link - 1].dest)) {
+            return link - 1;
+        }
+        link = COV_Addresses[link - 1].hash_next;
+    }
+
+    return -1;
+}
+
+/* adds room for more addresses to the list */
+static bool cov_addresses_grow(
+    void)
+{
+    BACNET_COV_ADDRESS *addresses = NULL;
+    unsigned size = 0;
+    unsigned i = 0;
+
+    if (COV_Addresses_Size >= MAX_COV_ADDRESSES) {
+        return false;
+    }
+    size = COV_Addresses_Size + COV_ADDRESSES_GROW;
+    if (size > MAX_COV_ADDRESSES) {
+        size = MAX_COV_ADDRESSES;
+    }
+    addresses = cov_realloc(COV_Addresses, size * sizeof(BACNET_COV_ADDRESS));
+    if (!addresses) {
+        return false;
+    }
+    COV_Addresses = addresses;
+    for (i = size; i > COV_Addresses_Size; i--) {
+        memset(&COV_Addresses[i - 1], 0, sizeof(BACNET_COV_ADDRESS));
+        COV_Addresses[i - 1].hash_next = COV_Addresses_Free;
+        COV_Addresses_Free = (uint16_t) i;
+    }
+    COV_Addresses_Size = size;
+
+    return true;
+}
+
 /**
- * Removes the address from the list of COV addresses, if it is not
- * used by other COV subscriptions
+ * Drops a reference to an address in the list of COV addresses,
+ * and removes the address when no subscription uses it anymore.
+ *
+ * @param  index - offset into COV address list where address is stored
  */
-static void cov_address_remove_unused(void)
+static void cov_address_release(
+    unsigned index)
 {
-    unsigned index = 0;
-    unsigned cov_index = 0;
-    bool found = false;
+    uint16_t *link = NULL;
 
-    for (cov_index = 0; cov_index < MAX_COV_ADDRESSES; cov_index++) {
-        if (COV_Addresses[cov_index].valid) {
-            found = false;
-            for (index = 0; index < MAX_COV_SUBCRIPTIONS; index++) {
-                if ((COV_Subscriptions[index].flag.valid) &&
-                    (COV_Subscriptions[index].dest_index == cov_index)) {
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                COV_Addresses[cov_index].valid = false;
+    if (!cov_address_get(index)) {
+        return;
+    }
+    if (COV_Addresses[index].refcount) {
+        COV_Addresses[index].refcount--;
+    }
+    if (COV_Addresses[index].refcount == 0) {
+        link = &COV_Address_Hash[cov_address_hash(&COV_Addresses[index].dest)];
+        while (*link) {
+            if (*link == (index + 1)) {
+                *link = COV_Addresses[index].hash_next;
+                break;
             }
+            link = &COV_Addresses[*link - 1].hash_next;
         }
+        COV_Addresses[index].valid = false;
+        COV_Addresses[index].hash_next = COV_Addresses_Free;
+        COV_Addresses_Free = (uint16_t) (index + 1);
     }
 }
 
 /**
-* Adds the address to the list of COV addresses
+* Adds a reference to the address in the list of COV addresses
 *
 * @param  dest - address to be added if there is room in the list
 *
 * @return index number 0..N, or -1 if unable to add
 */
 static int cov_address_add(
-    BACNET_ADDRESS *dest)
+    BACNET_ADDRESS * dest)
 {
     int index = -1;
-    unsigned i = 0;
-    bool found = false;
-    bool valid = false;
-    BACNET_ADDRESS *cov_dest = NULL;
+    unsigned hash = 0;
 
     if (dest) {
-        for (i = 0; i < MAX_COV_ADDRESSES; i++) {
-            valid = COV_Addresses[i].valid;
-            if (valid) {
-                cov_dest = &COV_Addresses[i].dest;
-                found = bacnet_address_same(dest, cov_dest);
-                if (found) {
-                    index = i;
-                    break;
-                }
-            }
-        }
-        if (!found) {
-            /* find a free place to add a new address */
-            for (i = 0; i < MAX_COV_ADDRESSES; i++) {
-                valid = COV_Addresses[i].valid;
-                if (!valid) {
-                    index = i;
-                    cov_dest = &COV_Addresses[i].dest;
-                    bacnet_address_copy(cov_dest, dest);
-                    COV_Addresses[i].valid = true;
-                    break;
-                }
+        index = cov_address_find(dest);
+        if (index < 0) {
+            if (!COV_Addresses_Free && !cov_addresses_grow()) {
+                return -1;
             }
+            /* take a free place to add a new address */
+            index = COV_Addresses_Free - 1;
+            COV_Addresses_Free = COV_Addresses[index].hash_next;
+            bacnet_address_copy(&COV_Addresses[index].dest, dest);
+            COV_Addresses[index].valid = true;
+            COV_Addresses[index].refcount = 0;
+            hash = cov_address_hash(dest);
+            COV_Addresses[index].hash_next = COV_Address_Hash[hash];
+            COV_Address_Hash[hash] = (uint16_t) (index + 1);
         }
+        COV_Addresses[index].refcount++;
     }
 
     return index;
@@ -212,10 +386,7 @@ static int cov_encode_subscription(
     BACNET_OCTET_STRING octet_string;
     BACNET_ADDRESS *dest = NULL;
 
-
-    /* FIXME: unused parameter */
-    max_apdu = max_apdu;
-    if (!cov_subscription) {
+    if (!cov_subscription || (max_apdu < COV_SUBSCRIPTION_ELEMENT_MAX)) {
         return 0;
     }
     dest = cov_address_get(cov_subscription->dest_index);
@@ -293,7 +464,6 @@ static int cov_encode_subscription(
  *  Invoked by a request to read the Device object's PROP_ACTIVE_COV_SUBSCRIPTIONS.
  *  Loops through the list of COV Subscriptions, and, for each valid one,
  *  adds its description to the APDU.
- *  @note This function needs some work to better handle buffer overruns.
  *  @param apdu [out] Buffer in which the APDU contents are built.
  *  @param max_apdu [in] Max length of the APDU buffer.
  *  @return How many bytes were encoded in the buffer, or -2 if the response
@@ -308,18 +478,21 @@ int handler_cov_encode_subscriptions(
     unsigned index = 0;
 
     if (apdu) {
-        for (index = 0; index < MAX_COV_SUBCRIPTIONS; index++) {
+        baclock_take(&COV_Lock);
+        for (index = 0; index < COV_Subscriptions_Size; index++) {
             if (COV_Subscriptions[index].flag.valid) {
+                /* check that it fits before encoding it */
+                if ((apdu_len + COV_SUBSCRIPTION_ELEMENT_MAX) > max_apdu) {
+                    apdu_len = -2;
+                    break;
+                }
                 len =
                     cov_encode_subscription(&apdu[apdu_len],
                     max_apdu - apdu_len, &COV_Subscriptions[index]);
                 apdu_len += len;
-                /* TODO: too late here to notice that we overran the buffer */
-                if (apdu_len > max_apdu) {
-                    return -2;
-                }
             }
         }
+        baclock_give(&COV_Lock);
     }
 
     return apdu_len;
@@ -327,27 +500,329 @@ int handler_cov_encode_subscriptions(
 
 /** Handler to initialize the COV list, clearing and disabling each entry.
  * @ingroup DSCOV
+ * The tables keep the memory they have grown to.
  */
 void handler_cov_init(
     void)
 {
     unsigned index = 0;
 
-    for (index = 0; index < MAX_COV_SUBCRIPTIONS; index++) {
-        COV_Subscriptions[index].flag.valid = false;
-        COV_Subscriptions[index].dest_index = -1;
-        COV_Subscriptions[index].subscriberProcessIdentifier = 0;
-        COV_Subscriptions[index].monitoredObjectIdentifier.type =
-            OBJECT_ANALOG_INPUT;
-        COV_Subscriptions[index].monitoredObjectIdentifier.instance = 0;
-        COV_Subscriptions[index].flag.issueConfirmedNotifications = false;
+    baclock_take(&COV_Lock);
+    COV_Subscriptions_Free = 0;
+    for (index = COV_Subscriptions_Size; index > 0; index--) {
+        memset(&COV_Subscriptions[index - 1], 0,
+            sizeof(BACNET_COV_SUBSCRIPTION));
+        COV_Subscriptions[index - 1].key_next = COV_Subscriptions_Free;
+        COV_Subscriptions_Free = (uint16_t) index;
+    }
+    COV_Addresses_Free = 0;
+    for (index = COV_Addresses_Size; index > 0; index--) {
+        memset(&COV_Addresses[index - 1], 0, sizeof(BACNET_COV_ADDRESS));
+        COV_Addresses[index - 1].hash_next = COV_Addresses_Free;
+        COV_Addresses_Free = (uint16_t) index;
+    }
+    for (index = 0; index < COV_OBJECT_HASH_SIZE; index++) {
+        COV_Object_Hash[index] = 0;
+    }
+    for (index = 0; index < COV_KEY_HASH_SIZE; index++) {
+        COV_Key_Hash[index] = 0;
+    }
+    for (index = 0; index < COV_ADDRESS_HASH_SIZE; index++) {
+        COV_Address_Hash[index] = 0;
+    }
+    COV_Changes_Count = 0;
+    COV_Changes_Overflow = false;
+    COV_Pending_Head = 0;
+    COV_Pending_Count = 0;
+    baclock_give(&COV_Lock);
+}
+
+/* adds room for more subscriptions, and for them on the pending list */
+static bool cov_subscriptions_grow(
+    void)
+{
+    BACNET_COV_SUBSCRIPTION *subscriptions = NULL;
+    uint16_t *pending = NULL;
+    unsigned size = 0;
+    unsigned i = 0;
+
+    if (COV_Subscriptions_Size >= MAX_COV_SUBCRIPTIONS) {
+        return false;
+    }
+    size = COV_Subscriptions_Size + COV_SUBSCRIPTIONS_GROW;
+    if (size > MAX_COV_SUBCRIPTIONS) {
+        size = MAX_COV_SUBCRIPTIONS;
+    }
+    pending = cov_realloc(NULL, size * sizeof(uint16_t));
+    if (!pending) {
+        return false;
+    }
+    subscriptions =
+        cov_realloc(COV_Subscriptions, size * sizeof(BACNET_COV_SUBSCRIPTION));
+    if (!subscriptions) {
+        free(pending);
+        return false;
+    }
+    COV_Subscriptions = subscriptions;
+    /* the pending list starts over at the front of its new array */
+    for (i = 0; i < COV_Pending_Count; i++) {
+        pending[i] =
+            COV_Pending[(COV_Pending_Head + i) % COV_Subscriptions_Size];
+    }
+    free(COV_Pending);
+    COV_Pending = pending;
+    COV_Pending_Head = 0;
+    for (i = size; i > COV_Subscriptions_Size; i--) {
+        memset(&COV_Subscriptions[i - 1], 0, sizeof(BACNET_COV_SUBSCRIPTION));
+        COV_Subscriptions[i - 1].key_next = COV_Subscriptions_Free;
+        COV_Subscriptions_Free = (uint16_t) i;
+    }
+    COV_Subscriptions_Size = size;
+
+    return true;
+}
+
+static unsigned cov_key_hash(
+    unsigned dest_index,
+    uint32_t process_id,
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance)
+{
+    uint32_t key = ((uint32_t) object_type << 22) ^ object_instance;
+
+    key ^= (process_id * 0x9E3779B1UL) ^ (dest_index << 11);
+    key ^= key >> 16;
+    key *= 0x45D9F3BUL;
+    key ^= key >> 16;
+
+    return key & (COV_KEY_HASH_SIZE - 1);
+}
+
+static unsigned cov_subscription_key_hash(
+    unsigned index)
+{
+    return cov_key_hash(COV_Subscriptions[index].dest_index,
+        COV_Subscriptions[index].subscriberProcessIdentifier,
+        (BACNET_OBJECT_TYPE)
+        COV_Subscriptions[index].monitoredObjectIdentifier.type,
+        COV_Subscriptions[index].monitoredObjectIdentifier.instance);
+}
+
+/**
+ * Finds the subscription of a subscriber to an object
+ *
+ * @param  dest_index - index of the subscriber address
+ * @param  process_id - subscriber process identifier
+ * @param  object_id - monitored object
+ *
+ * @return index number 0..N, or -1 if there is no such subscription
+ */
+static int cov_subscription_find(
+    unsigned dest_index,
+    uint32_t process_id,
+    BACNET_OBJECT_ID * object_id)
+{
+    uint16_t link = 0;
+    BACNET_COV_SUBSCRIPTION *cov_subscription = NULL;
+
+    link =
+        COV_Key_Hash[cov_key_hash(dest_index, process_id,
+            (BACNET_OBJECT_TYPE) object_id->type, object_id->instance)];
+    while (link) {
+        cov_subscription = &COV_Subscriptions[link - 1];
+        if ((cov_subscription->dest_index == dest_index) &&
+            (cov_subscription->subscriberProcessIdentifier == process_id) &&
+            (cov_subscription->monitoredObjectIdentifier.type ==
+                object_id->type) &&
+            (cov_subscription->monitoredObjectIdentifier.instance ==
+                object_id->instance)) {
+            return link - 1;
+        }
+        link = cov_subscription->key_next;
+    }
+
+    return -1;
+}
+
+static unsigned cov_object_hash(
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance)
+{
+    uint32_t key = ((uint32_t) object_type << 22) ^ object_instance;
+
+    key ^= key >> 16;
+    key *= 0x45D9F3BUL;
+    key ^= key >> 16;
+
+    return key & (COV_OBJECT_HASH_SIZE - 1);
+}
+
+/* adds a subscription to the chain of its monitored object,
+   and to the chain of its subscriber key */
+static void cov_object_link(
+    unsigned index)
+{
+    unsigned hash =
+        cov_object_hash((BACNET_OBJECT_TYPE)
+        COV_Subscriptions[index].monitoredObjectIdentifier.type,
+        COV_Subscriptions[index].monitoredObjectIdentifier.instance);
+
+    COV_Subscriptions[index].object_next = COV_Object_Hash[hash];
+    COV_Object_Hash[hash] = (uint16_t) (index + 1);
+    hash = cov_subscription_key_hash(index);
+    COV_Subscriptions[index].key_next = COV_Key_Hash[hash];
+    COV_Key_Hash[hash] = (uint16_t) (index + 1);
+}
+
+static void cov_object_unlink(
+    unsigned index)
+{
+    uint16_t *link =
+        &COV_Object_Hash[cov_object_hash((BACNET_OBJECT_TYPE)
+            COV_Subscriptions[index].monitoredObjectIdentifier.type,
+            COV_Subscriptions[index].monitoredObjectIdentifier.instance)];
+
+    while (*link) {
+        if (*link == (index + 1)) {
+            *link = COV_Subscriptions[index].object_next;
+            break;
+        }
+        link = &COV_Subscriptions[*link - 1].object_next;
+    }
+    COV_Subscriptions[index].object_next = 0;
+    link = &COV_Key_Hash[cov_subscription_key_hash(index)];
+    while (*link) {
+        if (*link == (index + 1)) {
+            *link = COV_Subscriptions[index].key_next;
+            break;
+        }
+        link = &COV_Subscriptions[*link - 1].key_next;
+    }
+    COV_Subscriptions[index].key_next = 0;
+}
+
+/* puts a subscription on the list of work for handler_cov_task() */
+static void cov_pending_add(
+    unsigned index)
+{
+    if (!COV_Subscriptions[index].flag.pending) {
+        COV_Subscriptions[index].flag.pending = true;
+        COV_Pending[(COV_Pending_Head +
+                COV_Pending_Count) % COV_Subscriptions_Size] = (uint16_t) index;
+        COV_Pending_Count++;
+    }
+}
+
+/* asks for a notification to the subscription */
+static void cov_send_requested(
+    unsigned index)
+{
+    COV_Subscriptions[index].flag.send_requested = true;
+    cov_pending_add(index);
+}
+
+/* cancels or expires a subscription; it drops off the pending list later */
+static void cov_subscription_free(
+    unsigned index)
+{
+    cov_object_unlink(index);
+    COV_Subscriptions[index].flag.valid = false;
+    COV_Subscriptions[index].flag.send_requested = false;
+    cov_address_release(COV_Subscriptions[index].dest_index);
+    if (COV_Subscriptions[index].invokeID) {
+        tsm_free_invoke_id(COV_Subscriptions[index].invokeID);
         COV_Subscriptions[index].invokeID = 0;
-        COV_Subscriptions[index].lifetime = 0;
-        COV_Subscriptions[index].flag.send_requested = false;
     }
-    for (index = 0; index < MAX_COV_ADDRESSES; index++) {
-        COV_Addresses[index].valid = false;
+    COV_Subscriptions[index].key_next = COV_Subscriptions_Free;
+    COV_Subscriptions_Free = (uint16_t) (index + 1);
+}
+
+/** Tells the COV handler that an object has changed its Present_Value or
+ * Status_Flags by at least its COV increment.
+ * @ingroup DSCOV
+ * Objects that support COV call this from the code that sets their
+ * Change_Of_Value flag, so that the COV handler only looks at objects that
+ * changed instead of polling every subscription.
+ *
+ * @param object_type [in] type of the object that changed
+ * @param object_instance [in] instance of the object that changed
+ */
+void handler_cov_object_changed(
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance)
+{
+    unsigned i = 0;
+
+    baclock_take(&COV_Lock);
+    for (i = 0; i < COV_Changes_Count; i++) {
+        if ((COV_Changes[i].type == object_type) &&
+            (COV_Changes[i].instance == object_instance)) {
+            break;
+        }
+    }
+    if (i == COV_Changes_Count) {
+        if (COV_Changes_Count < MAX_COV_CHANGES) {
+            COV_Changes[COV_Changes_Count].type = object_type;
+            COV_Changes[COV_Changes_Count].instance = object_instance;
+            COV_Changes_Count++;
+        } else {
+            COV_Changes_Overflow = true;
+        }
     }
+    baclock_give(&COV_Lock);
+}
+
+/* requests a notification to each subscriber of a changed object */
+static void cov_object_changes_mark(
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance)
+{
+    uint16_t link = 0;
+    unsigned index = 0;
+
+    if (!Device_COV(object_type, object_instance)) {
+        return;
+    }
+    link = COV_Object_Hash[cov_object_hash(object_type, object_instance)];
+    while (link) {
+        index = link - 1;
+        link = COV_Subscriptions[index].object_next;
+        if ((COV_Subscriptions[index].monitoredObjectIdentifier.type ==
+                object_type) &&
+            (COV_Subscriptions[index].monitoredObjectIdentifier.instance ==
+                object_instance)) {
+#if PRINT_ENABLED
+            fprintf(stderr, "COVtask: Marking...\n");
+#endif
+            cov_send_requested(index);
+        }
+    }
+    Device_COV_Clear(object_type, object_instance);
+}
+
+/* turns the changed objects into requested notifications */
+static void cov_object_changes_process(
+    void)
+{
+    unsigned i = 0;
+
+    if (COV_Changes_Overflow) {
+        COV_Changes_Overflow = false;
+        COV_Changes_Count = 0;
+        for (i = 0; i < COV_Subscriptions_Size; i++) {
+            if (COV_Subscriptions[i].flag.valid) {
+                cov_object_changes_mark((BACNET_OBJECT_TYPE)
+                    COV_Subscriptions[i].monitoredObjectIdentifier.type,
+                    COV_Subscriptions[i].monitoredObjectIdentifier.instance);
+            }
+        }
+        return;
+    }
+    for (i = 0; i < COV_Changes_Count; i++) {
+        cov_object_changes_mark((BACNET_OBJECT_TYPE) COV_Changes[i].type,
+            COV_Changes[i].instance);
+    }
+    COV_Changes_Count = 0;
 }
 
 static bool cov_list_subscribe(
@@ -356,95 +831,129 @@ static bool cov_list_subscribe(
     BACNET_ERROR_CLASS * error_class,
     BACNET_ERROR_CODE * error_code)
 {
-    bool existing_entry = false;
-    int index;
-    int first_invalid_index = -1;
+    int index = -1;
+    int dest_index = -1;
     bool found = true;
-    bool address_match = false;
-    BACNET_ADDRESS *dest = NULL;
 
     /* unable to subscribe - resources? */
     /* unable to cancel subscription - other? */
 
     /* existing? - match Object ID and Process ID and address */
-    for (index = 0; index < MAX_COV_SUBCRIPTIONS; index++) {
-        if (COV_Subscriptions[index].flag.valid) {
-            dest = cov_address_get(COV_Subscriptions[index].dest_index);
-            if (dest) {
-                address_match = bacnet_address_same(src, dest);
-            } else {
-                /* skip address matching - we don't have an address */
-                address_match = true;
-            }
-            if ((COV_Subscriptions[index].monitoredObjectIdentifier.type ==
-                    cov_data->monitoredObjectIdentifier.type) &&
-                (COV_Subscriptions[index].monitoredObjectIdentifier.instance ==
-                    cov_data->monitoredObjectIdentifier.instance) &&
-                (COV_Subscriptions[index].subscriberProcessIdentifier ==
-                    cov_data->subscriberProcessIdentifier) && address_match) {
-                existing_entry = true;
-                if (cov_data->cancellationRequest) {
-                    COV_Subscriptions[index].flag.valid = false;
-                    COV_Subscriptions[index].dest_index = -1;
-                    cov_address_remove_unused();
-                } else {
-                    COV_Subscriptions[index].dest_index = cov_address_add(src);
-                    COV_Subscriptions[index].flag.issueConfirmedNotifications =
-                        cov_data->issueConfirmedNotifications;
-                    COV_Subscriptions[index].lifetime = cov_data->lifetime;
-                    COV_Subscriptions[index].flag.send_requested = true;
-                }
-                if (COV_Subscriptions[index].invokeID) {
-                    tsm_free_invoke_id(COV_Subscriptions[index].invokeID);
-                    COV_Subscriptions[index].invokeID = 0;
-                }
-                break;
-            }
+    dest_index = cov_address_find(src);
+    if (dest_index >= 0) {
+        index =
+            cov_subscription_find(dest_index,
+            cov_data->subscriberProcessIdentifier,
+            &cov_data->monitoredObjectIdentifier);
+    }
+    if (index >= 0) {
+        if (cov_data->cancellationRequest) {
+            cov_subscription_free(index);
         } else {
-            if (first_invalid_index < 0) {
-                first_invalid_index = index;
+            COV_Subscriptions[index].flag.issueConfirmedNotifications =
+                cov_data->issueConfirmedNotifications;
+            COV_Subscriptions[index].lifetime = cov_data->lifetime;
+            if (COV_Subscriptions[index].invokeID) {
+                tsm_free_invoke_id(COV_Subscriptions[index].invokeID);
+                COV_Subscriptions[index].invokeID = 0;
             }
+            cov_send_requested(index);
         }
-    }
-    if (!existing_entry && (first_invalid_index >= 0) &&
-        (!cov_data->cancellationRequest)) {
-        index = first_invalid_index;
-        found = true;
-        COV_Subscriptions[index].flag.valid = true;
-        COV_Subscriptions[index].dest_index = cov_address_add(src);
-        COV_Subscriptions[index].monitoredObjectIdentifier.type =
-            cov_data->monitoredObjectIdentifier.type;
-        COV_Subscriptions[index].monitoredObjectIdentifier.instance =
-            cov_data->monitoredObjectIdentifier.instance;
-        COV_Subscriptions[index].subscriberProcessIdentifier =
-            cov_data->subscriberProcessIdentifier;
-        COV_Subscriptions[index].flag.issueConfirmedNotifications =
-            cov_data->issueConfirmedNotifications;
-        COV_Subscriptions[index].invokeID = 0;
-        COV_Subscriptions[index].lifetime = cov_data->lifetime;
-        COV_Subscriptions[index].flag.send_requested = true;
-    } else if (!existing_entry) {
-        if (first_invalid_index < 0) {
+    } else if (!cov_data->cancellationRequest) {
+        /* the subscriber may have other subscriptions, so dest_index
+           may be valid while there is no room for this one */
+        if (!COV_Subscriptions_Free && !cov_subscriptions_grow()) {
+            dest_index = -1;
+        } else {
+            dest_index = cov_address_add(src);
+        }
+        if (dest_index < 0) {
             /* Out of resources */
             *error_class = ERROR_CLASS_RESOURCES;
             *error_code = ERROR_CODE_NO_SPACE_TO_ADD_LIST_ELEMENT;
             found = false;
         } else {
-            /* cancellationRequest - valid object not subscribed */
-            /* From BACnet Standard 135-2010-13.14.2
-               ...Cancellations that are issued for which no matching COV
-               context can be found shall succeed as if a context had
-               existed, returning 'Result(+)'. */
-            found = true;
+            index = COV_Subscriptions_Free - 1;
+            COV_Subscriptions_Free = COV_Subscriptions[index].key_next;
+            COV_Subscriptions[index].flag.valid = true;
+            COV_Subscriptions[index].flag.send_requested = false;
+            COV_Subscriptions[index].dest_index = (uint16_t) dest_index;
+            COV_Subscriptions[index].monitoredObjectIdentifier.type =
+                cov_data->monitoredObjectIdentifier.type;
+            COV_Subscriptions[index].monitoredObjectIdentifier.instance =
+                cov_data->monitoredObjectIdentifier.instance;
+            COV_Subscriptions[index].subscriberProcessIdentifier =
+                cov_data->subscriberProcessIdentifier;
+            COV_Subscriptions[index].flag.issueConfirmedNotifications =
+                cov_data->issueConfirmedNotifications;
+            COV_Subscriptions[index].invokeID = 0;
+            COV_Subscriptions[index].lifetime = cov_data->lifetime;
+            cov_object_link(index);
+            cov_send_requested(index);
         }
+    } else {
+        /* cancellationRequest - valid object not subscribed */
+        /* From BACnet Standard 135-2010-13.14.2
+           ...Cancellations that are issued for which no matching COV
+           context can be found shall succeed as if a context had
+           existed, returning 'Result(+)'. */
+        found = true;
     }
 
     return found;
 }
 
+/* encodes the listOfValues of an object, unless already done this pass */
+static bool cov_values_encode(
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance)
+{
+    BACNET_PROPERTY_VALUE value_list[2];
+    uint8_t *values = NULL;
+    int len = 0;
+
+    if (COV_Values_Valid && (COV_Values_Object.type == object_type) &&
+        (COV_Values_Object.instance == object_instance)) {
+        return true;
+    }
+    COV_Values_Valid = false;
+    /* configure the linked list for the two properties */
+    value_list[0].next = &value_list[1];
+    value_list[1].next = NULL;
+    if (Device_Encode_Value_List(object_type, object_instance,
+            &value_list[0])) {
+        /* size the list first: it is encoded straight into the
+           shared buffer, and must leave room for the rest of the
+           notification */
+        len = cov_notify_value_list_len(&value_list[0]);
+        if ((len <= 0) || (len > MAX_APDU)) {
+            return false;
+        }
+        if ((unsigned) len > COV_Values_Size) {
+            values = cov_realloc(COV_Values_Apdu, (size_t) len);
+            if (!values) {
+                return false;
+            }
+            COV_Values_Apdu = values;
+            COV_Values_Size = (unsigned) len;
+        }
+        COV_Values_Len =
+            cov_notify_encode_value_list(&COV_Values_Apdu[0], &value_list[0]);
+        COV_Values_Object.type = object_type;
+        COV_Values_Object.instance = object_instance;
+        COV_Values_Valid = true;
+    }
+
+    return COV_Values_Valid;
+}
+
+/* sends the notification for one subscriber, only encoding its own
+   process identifier, time remaining, invoke ID and destination
+   around the shared listOfValues */
 static bool cov_send_request(
     BACNET_COV_SUBSCRIPTION * cov_subscription,
-    BACNET_PROPERTY_VALUE * value_list)
+    uint8_t * values,
+    int values_len)
 {
     int len = 0;
     int pdu_len = 0;
@@ -486,22 +995,22 @@ static bool cov_send_request(
     cov_data.monitoredObjectIdentifier.instance =
         cov_subscription->monitoredObjectIdentifier.instance;
     cov_data.timeRemaining = cov_subscription->lifetime;
-    cov_data.listOfValues = value_list;
+    cov_data.listOfValues = NULL;
     if (cov_subscription->flag.issueConfirmedNotifications) {
         npdu_data.data_expecting_reply = true;
         invoke_id = tsm_next_free_invokeID();
         if (invoke_id) {
             cov_subscription->invokeID = invoke_id;
             len =
-                ccov_notify_encode_apdu(&Handler_Transmit_Buffer[pdu_len],
-                invoke_id, &cov_data);
+                ccov_notify_encode_apdu_values(&Handler_Transmit_Buffer
+                [pdu_len], invoke_id, &cov_data, values, values_len);
         } else {
             goto COV_FAILED;
         }
     } else {
         len =
-            ucov_notify_encode_apdu(&Handler_Transmit_Buffer[pdu_len],
-            &cov_data);
+            ucov_notify_encode_apdu_values(&Handler_Transmit_Buffer[pdu_len],
+            &cov_data, values, values_len);
     }
     pdu_len += len;
     if (cov_subscription->flag.issueConfirmedNotifications) {
@@ -529,7 +1038,7 @@ static void cov_lifetime_expiration_handler(
     uint32_t elapsed_seconds,
     uint32_t lifetime_seconds)
 {
-    if (index < MAX_COV_SUBCRIPTIONS) {
+    if (index < COV_Subscriptions_Size) {
         /* handle lifetime expiration */
         if (lifetime_seconds >= elapsed_seconds) {
             COV_Subscriptions[index].lifetime -= elapsed_seconds;
@@ -553,37 +1062,14 @@ static void cov_lifetime_expiration_handler(
                 COV_Subscriptions[index].lifetime);
             fprintf(stderr, "\n");
 #endif
-            COV_Subscriptions[index].flag.valid = false;
-            COV_Subscriptions[index].dest_index = -1;
-            cov_address_remove_unused();
-            if (COV_Subscriptions[index].flag.issueConfirmedNotifications) {
-                if (COV_Subscriptions[index].invokeID) {
-                    tsm_free_invoke_id(COV_Subscriptions[index].invokeID);
-                    COV_Subscriptions[index].invokeID = 0;
-                }
-            }
+            cov_subscription_free(index);
         }
     }
 }
 
-/** Handler to check the list of subscribed objects for any that have changed
- *  and so need to have notifications sent.
+/** Handler to expire COV subscriptions whose lifetime has run out.
  * @ingroup DSCOV
  * This handler will be invoked by the main program every second or so.
- * This example only handles Binary Inputs, but can be easily extended to
- * support other types.
- * For each subscribed object,
- *  - See if the subscription has timed out
- *    - Remove it if it has timed out.
- *  - See if the subscribed object instance has changed
- *    (eg, check with Binary_Input_Change_Of_Value() )
- *  - If changed,
- *    - Clear the COV (eg, Binary_Input_Change_Of_Value_Clear() )
- *    - Send the notice with cov_send_request()
- *      - Will be confirmed or unconfirmed, as per the subscription.
- *
- * @note worst case tasking: MS/TP with the ability to send only
- *        one notification per task cycle.
  *
  * @param elapsed_seconds [in] How many seconds have elapsed since last called.
  */
@@ -594,8 +1080,9 @@ void handler_cov_timer_seconds(
     uint32_t lifetime_seconds = 0;
 
     if (elapsed_seconds) {
+        baclock_take(&COV_Lock);
         /* handle the subscription timeouts */
-        for (index = 0; index < MAX_COV_SUBCRIPTIONS; index++) {
+        for (index = 0; index < COV_Subscriptions_Size; index++) {
             if (COV_Subscriptions[index].flag.valid) {
                 lifetime_seconds = COV_Subscriptions[index].lifetime;
                 if (lifetime_seconds) {
@@ -605,145 +1092,110 @@ void handler_cov_timer_seconds(
                 }
             }
         }
+        baclock_give(&COV_Lock);
     }
 }
 
-bool handler_cov_fsm(
-    void)
+/* confirmed notification house keeping, then send if requested
+   @return true if the subscription still has work pending */
+static bool cov_pending_service(
+    unsigned index)
 {
-    static int index = 0;
     BACNET_OBJECT_TYPE object_type = MAX_BACNET_OBJECT_TYPE;
     uint32_t object_instance = 0;
     bool status = false;
     bool send = false;
-    BACNET_PROPERTY_VALUE value_list[2];
-    /* states for transmitting */
-    static enum {
-        COV_STATE_IDLE = 0,
-        COV_STATE_MARK,
-        COV_STATE_CLEAR,
-        COV_STATE_FREE,
-        COV_STATE_SEND
-    } cov_task_state = COV_STATE_IDLE;
-
-    switch (cov_task_state) {
-        case COV_STATE_IDLE:
-            index = 0;
-            cov_task_state = COV_STATE_MARK;
-            break;
-        case COV_STATE_MARK:
-            /* mark any subscriptions where the value has changed */
-            if (COV_Subscriptions[index].flag.valid) {
-                object_type = (BACNET_OBJECT_TYPE)
-                    COV_Subscriptions[index].monitoredObjectIdentifier.type;
-                object_instance =
-                    COV_Subscriptions[index].
-                    monitoredObjectIdentifier.instance;
-                status = Device_COV(object_type, object_instance);
-                if (status) {
-                    COV_Subscriptions[index].flag.send_requested = true;
-#if PRINT_ENABLED
-                    fprintf(stderr, "COVtask: Marking...\n");
-#endif
-                }
-            }
-            index++;
-            if (index >= MAX_COV_SUBCRIPTIONS) {
-                index = 0;
-                cov_task_state = COV_STATE_CLEAR;
-            }
-            break;
-        case COV_STATE_CLEAR:
-            /* clear the COV flag after checking all subscriptions */
-            if ((COV_Subscriptions[index].flag.valid) &&
-                (COV_Subscriptions[index].flag.send_requested)) {
-                object_type = (BACNET_OBJECT_TYPE)
-                    COV_Subscriptions[index].monitoredObjectIdentifier.type;
-                object_instance =
-                    COV_Subscriptions[index].
-                    monitoredObjectIdentifier.instance;
-                Device_COV_Clear(object_type, object_instance);
-            }
-            index++;
-            if (index >= MAX_COV_SUBCRIPTIONS) {
-                index = 0;
-                cov_task_state = COV_STATE_FREE;
-            }
-            break;
-        case COV_STATE_FREE:
-            /* confirmed notification house keeping */
-            if ((COV_Subscriptions[index].flag.valid) &&
-                (COV_Subscriptions[index].flag.issueConfirmedNotifications) &&
-                (COV_Subscriptions[index].invokeID)) {
-                if (tsm_invoke_id_free(COV_Subscriptions[index].invokeID)) {
-                    COV_Subscriptions[index].invokeID = 0;
-                } else
-                    if (tsm_invoke_id_failed(COV_Subscriptions
-                        [index].invokeID)) {
-                    tsm_free_invoke_id(COV_Subscriptions[index].invokeID);
-                    COV_Subscriptions[index].invokeID = 0;
-                }
+
+    if (!COV_Subscriptions[index].flag.valid) {
+        return false;
+    }
+    if ((COV_Subscriptions[index].flag.issueConfirmedNotifications) &&
+        (COV_Subscriptions[index].invokeID)) {
+        if (tsm_invoke_id_free(COV_Subscriptions[index].invokeID)) {
+            COV_Subscriptions[index].invokeID = 0;
+        } else if (tsm_invoke_id_failed(COV_Subscriptions[index].invokeID)) {
+            tsm_free_invoke_id(COV_Subscriptions[index].invokeID);
+            COV_Subscriptions[index].invokeID = 0;
+        }
+    }
+    if (COV_Subscriptions[index].flag.send_requested) {
+        send = true;
+        if (COV_Subscriptions[index].flag.issueConfirmedNotifications) {
+            if (COV_Subscriptions[index].invokeID != 0) {
+                /* already sending */
+                send = false;
             }
-            index++;
-            if (index >= MAX_COV_SUBCRIPTIONS) {
-                index = 0;
-                cov_task_state = COV_STATE_SEND;
+            if (!tsm_transaction_available()) {
+                /* no transactions available - can't send now */
+                send = false;
             }
-            break;
-        case COV_STATE_SEND:
-            /* send any COVs that are requested */
-            if ((COV_Subscriptions[index].flag.valid) &&
-                (COV_Subscriptions[index].flag.send_requested)) {
-                send = true;
-                if (COV_Subscriptions[index].flag.issueConfirmedNotifications) {
-                    if (COV_Subscriptions[index].invokeID != 0) {
-                        /* already sending */
-                        send = false;
-                    }
-                    if (!tsm_transaction_available()) {
-                        /* no transactions available - can't send now */
-                        send = false;
-                    }
-                }
-                if (send) {
-                    object_type = (BACNET_OBJECT_TYPE)
-                        COV_Subscriptions[index].
-                        monitoredObjectIdentifier.type;
-                    object_instance =
-                        COV_Subscriptions[index].
-                        monitoredObjectIdentifier.instance;
+        }
+        if (send) {
+            object_type = (BACNET_OBJECT_TYPE)
+                COV_Subscriptions[index].monitoredObjectIdentifier.type;
+            object_instance =
+                COV_Subscriptions[index].monitoredObjectIdentifier.instance;
 #if PRINT_ENABLED
-                    fprintf(stderr, "COVtask: Sending...\n");
+            fprintf(stderr, "COVtask: Sending...\n");
 #endif
-                    /* configure the linked list for the two properties */
-                    value_list[0].next = &value_list[1];
-                    value_list[1].next = NULL;
-                    status =
-                        Device_Encode_Value_List(object_type,
-                        object_instance, &value_list[0]);
-                    if (status) {
-                        status =
-                            cov_send_request(&COV_Subscriptions[index],
-                            &value_list[0]);
-                    }
-                    if (status) {
-                        COV_Subscriptions[index].flag.send_requested = false;
-                    }
-                }
+            status = cov_values_encode(object_type, object_instance);
+            if (status) {
+                status =
+                    cov_send_request(&COV_Subscriptions[index],
+                    &COV_Values_Apdu[0], COV_Values_Len);
             }
-            index++;
-            if (index >= MAX_COV_SUBCRIPTIONS) {
-                index = 0;
-                cov_task_state = COV_STATE_IDLE;
+            if (status) {
+                COV_Subscriptions[index].flag.send_requested = false;
             }
-            break;
-        default:
-            index = 0;
-            cov_task_state = COV_STATE_IDLE;
-            break;
+        }
+    }
+
+    return (COV_Subscriptions[index].flag.send_requested ||
+        COV_Subscriptions[index].invokeID);
+}
+
+/** Handler to send the COV notifications for objects that have changed.
+ * @ingroup DSCOV
+ * This handler will be invoked by the main program after each received
+ * message and every second or so.
+ *  - The objects reported by handler_cov_object_changed() since the last
+ *    call mark their subscribers through the monitored object index,
+ *    and their COV flag is cleared (eg, Binary_Input_Change_Of_Value_Clear())
+ *  - Each subscription on the pending list then has its confirmed
+ *    notification checked, and its notice sent with cov_send_request(),
+ *    confirmed or unconfirmed as per the subscription.  The subscribers
+ *    of an object are marked together, so its listOfValues is encoded
+ *    once and copied into each of their notifications.
+ * The work done depends on the number of changes, not the number of
+ * subscriptions.
+ *
+ * @return true, since each call completes a whole cycle
+ */
+bool handler_cov_fsm(
+    void)
+{
+    unsigned count = 0;
+    unsigned index = 0;
+
+    baclock_take(&COV_Lock);
+    cov_object_changes_process();
+    /* values may have changed since the last pass */
+    COV_Values_Valid = false;
+    /* each pending subscription is looked at once per call */
+    count = COV_Pending_Count;
+    while (count) {
+        count--;
+        index = COV_Pending[COV_Pending_Head];
+        COV_Pending_Head = (COV_Pending_Head + 1) % COV_Subscriptions_Size;
+        COV_Pending_Count--;
+        COV_Subscriptions[index].flag.pending = false;
+        if (cov_pending_service(index)) {
+            cov_pending_add(index);
+        }
     }
+    baclock_give(&COV_Lock);
 
-    return (cov_task_state == COV_STATE_IDLE);
+    return true;
 }
 
 void handler_cov_task(
@@ -847,9 +1299,11 @@ void handler_cov_subscribe(
     }
     cov_data.error_class = ERROR_CLASS_OBJECT;
     cov_data.error_code = ERROR_CODE_UNKNOWN_OBJECT;
+    baclock_take(&COV_Lock);
     success =
         cov_subscribe(src, &cov_data, &cov_data.error_class,
         &cov_data.error_code);
+    baclock_give(&COV_Lock);
     if (success) {
         apdu_len =
             encode_simple_ack(&Handler_Transmit_Buffer[npdu_len],
@@ -905,3 +1359,312 @@ void handler_cov_subscribe(
 
     return;
 }
+
+#ifdef TEST
+#include <assert.h>
+#include <pthread.h>
+#include "ctest.h"
+
+/* the notifications the datalink was asked to send */
+static unsigned Test_Notifications;
+/* the error of the last subscription that failed */
+static BACNET_ERROR_CLASS Test_Error_Class;
+static BACNET_ERROR_CODE Test_Error_Code;
+
+int datalink_send_pdu(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    (void) dest;
+    (void) npdu_data;
+    (void) pdu;
+    Test_Notifications++;
+
+    return (int) pdu_len;
+}
+
+void datalink_get_my_address(
+    BACNET_ADDRESS * my_address)
+{
+    memset(my_address, 0, sizeof(BACNET_ADDRESS));
+}
+
+bool Device_Valid_Object_Id(
+    int object_type,
+    uint32_t object_instance)
+{
+    (void) object_instance;
+    return (object_type == OBJECT_ANALOG_INPUT);
+}
+
+bool Device_Value_List_Supported(
+    BACNET_OBJECT_TYPE object_type)
+{
+    return (object_type == OBJECT_ANALOG_INPUT);
+}
+
+bool Device_COV(
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance)
+{
+    (void) object_type;
+    (void) object_instance;
+    return true;
+}
+
+void Device_COV_Clear(
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance)
+{
+    (void) object_type;
+    (void) object_instance;
+}
+
+bool Device_Encode_Value_List(
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance,
+    BACNET_PROPERTY_VALUE * value_list)
+{
+    (void) object_type;
+    value_list->propertyIdentifier = PROP_PRESENT_VALUE;
+    value_list->propertyArrayIndex = BACNET_ARRAY_ALL;
+    value_list->value.context_specific = false;
+    value_list->value.tag = BACNET_APPLICATION_TAG_REAL;
+    value_list->value.type.Real = (float) object_instance;
+    value_list->value.next = NULL;
+    value_list->priority = BACNET_NO_PRIORITY;
+    value_list = value_list->next;
+    value_list->propertyIdentifier = PROP_STATUS_FLAGS;
+    value_list->propertyArrayIndex = BACNET_ARRAY_ALL;
+    value_list->value.context_specific = false;
+    value_list->value.tag = BACNET_APPLICATION_TAG_BIT_STRING;
+    bitstring_init(&value_list->value.type.Bit_String);
+    bitstring_set_bits_used(&value_list->value.type.Bit_String, 1, 4);
+    value_list->value.next = NULL;
+    value_list->priority = BACNET_NO_PRIORITY;
+
+    return true;
+}
+
+uint32_t Device_Object_Instance_Number(
+    void)
+{
+    return 1234;
+}
+
+static void test_address(
+    BACNET_ADDRESS * src,
+    uint8_t mac)
+{
+    memset(src, 0, sizeof(BACNET_ADDRESS));
+    src->mac_len = 1;
+    src->mac[0] = mac;
+}
+
+static bool test_subscribe(
+    BACNET_ADDRESS * src,
+    uint32_t process_id,
+    uint32_t object_instance,
+    bool cancel,
+    uint32_t lifetime)
+{
+    BACNET_SUBSCRIBE_COV_DATA cov_data;
+    bool status = false;
+
+    memset(&cov_data, 0, sizeof(cov_data));
+    cov_data.subscriberProcessIdentifier = process_id;
+    cov_data.monitoredObjectIdentifier.type = OBJECT_ANALOG_INPUT;
+    cov_data.monitoredObjectIdentifier.instance = object_instance;
+    cov_data.cancellationRequest = cancel;
+    cov_data.lifetime = lifetime;
+    cov_data.error_class = ERROR_CLASS_OBJECT;
+    cov_data.error_code = ERROR_CODE_UNKNOWN_OBJECT;
+    /* as handler_cov_subscribe() does */
+    baclock_take(&COV_Lock);
+    status =
+        cov_subscribe(src, &cov_data, &cov_data.error_class,
+        &cov_data.error_code);
+    baclock_give(&COV_Lock);
+    if (status) {
+        return true;
+    }
+    Test_Error_Class = cov_data.error_class;
+    Test_Error_Code = cov_data.error_code;
+
+    return false;
+}
+
+static unsigned test_subscriptions(
+    void)
+{
+    unsigned count = 0;
+    unsigned index = 0;
+
+    for (index = 0; index < COV_Subscriptions_Size; index++) {
+        if (COV_Subscriptions[index].flag.valid) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void testCOVSubscriptions(
+    Test * pTest)
+{
+    BACNET_ADDRESS src[2];
+    uint8_t apdu[MAX_APDU];
+    unsigned i = 0;
+
+    handler_cov_init();
+    test_address(&src[0], 1);
+    test_address(&src[1], 2);
+    ct_test(pTest, test_subscribe(&src[0], 1, 1, false, 0));
+    ct_test(pTest, test_subscribe(&src[1], 1, 1, false, 0));
+    ct_test(pTest, test_subscribe(&src[0], 2, 1, false, 0));
+    ct_test(pTest, test_subscriptions() == 3);
+    /* a subscription again is the same subscription */
+    ct_test(pTest, test_subscribe(&src[0], 1, 1, false, 0));
+    ct_test(pTest, test_subscriptions() == 3);
+    /* the two subscribers share their addresses */
+    ct_test(pTest, COV_Addresses[cov_address_find(&src[0])].refcount == 2);
+    ct_test(pTest, COV_Addresses[cov_address_find(&src[1])].refcount == 1);
+    ct_test(pTest, handler_cov_encode_subscriptions(&apdu[0],
+            sizeof(apdu)) > 0);
+    ct_test(pTest, handler_cov_encode_subscriptions(&apdu[0],
+            COV_SUBSCRIPTION_ELEMENT_MAX) == -2);
+    /* one notification to each subscriber of the object changed,
+       and only to those, once all the pending ones are sent */
+    handler_cov_fsm();
+    Test_Notifications = 0;
+    ct_test(pTest, test_subscribe(&src[1], 1, 2, false, 0));
+    handler_cov_fsm();
+    ct_test(pTest, Test_Notifications == 1);
+    Test_Notifications = 0;
+    handler_cov_object_changed(OBJECT_ANALOG_INPUT, 1);
+    handler_cov_fsm();
+    ct_test(pTest, Test_Notifications == 3);
+    Test_Notifications = 0;
+    handler_cov_fsm();
+    ct_test(pTest, Test_Notifications == 0);
+    /* cancelled, and cancelled again as if it still existed */
+    ct_test(pTest, test_subscribe(&src[1], 1, 2, true, 0));
+    ct_test(pTest, test_subscribe(&src[1], 1, 2, true, 0));
+    ct_test(pTest, test_subscriptions() == 3);
+    ct_test(pTest, test_subscribe(&src[1], 1, 1, true, 0));
+    ct_test(pTest, cov_address_find(&src[1]) < 0);
+    ct_test(pTest, test_subscriptions() == 2);
+    /* expires when its lifetime runs out */
+    ct_test(pTest, test_subscribe(&src[1], 3, 1, false, 10));
+    handler_cov_timer_seconds(9);
+    ct_test(pTest, test_subscriptions() == 3);
+    handler_cov_timer_seconds(1);
+    ct_test(pTest, test_subscriptions() == 2);
+    ct_test(pTest, cov_address_find(&src[1]) < 0);
+
+    /* fill the table from a subscriber that has subscriptions already */
+    for (i = 2; test_subscriptions() < MAX_COV_SUBCRIPTIONS; i++) {
+        if (!test_subscribe(&src[0], i + 1, 1, false, 0)) {
+            break;
+        }
+    }
+    ct_test(pTest, test_subscriptions() == MAX_COV_SUBCRIPTIONS);
+    ct_test(pTest, COV_Subscriptions_Free == 0);
+    Test_Error_Class = ERROR_CLASS_OBJECT;
+    Test_Error_Code = ERROR_CODE_UNKNOWN_OBJECT;
+    ct_test(pTest, !test_subscribe(&src[0], 1, 2, false, 0));
+    ct_test(pTest, Test_Error_Class == ERROR_CLASS_RESOURCES);
+    ct_test(pTest, Test_Error_Code == ERROR_CODE_NO_SPACE_TO_ADD_LIST_ELEMENT);
+    ct_test(pTest, !test_subscribe(&src[1], 1, 2, false, 0));
+    ct_test(pTest, Test_Error_Code == ERROR_CODE_NO_SPACE_TO_ADD_LIST_ELEMENT);
+    ct_test(pTest, test_subscriptions() == MAX_COV_SUBCRIPTIONS);
+    ct_test(pTest, cov_address_find(&src[1]) < 0);
+    ct_test(pTest, COV_Addresses[cov_address_find(&src[0])].refcount ==
+        MAX_COV_SUBCRIPTIONS);
+    /* a place freed is taken again */
+    ct_test(pTest, test_subscribe(&src[0], 1, 1, true, 0));
+    ct_test(pTest, test_subscribe(&src[1], 1, 2, false, 0));
+    ct_test(pTest, test_subscriptions() == MAX_COV_SUBCRIPTIONS);
+    handler_cov_init();
+    ct_test(pTest, test_subscriptions() == 0);
+    ct_test(pTest, cov_address_find(&src[0]) < 0);
+}
+
+#define TEST_CHANGES 10000
+static volatile bool Test_Changes_Done;
+
+/* an object task reporting its changes */
+static void *test_changes_thread(
+    void *arg)
+{
+    unsigned i = 0;
+
+    (void) arg;
+    for (i = 0; i < TEST_CHANGES; i++) {
+        handler_cov_object_changed(OBJECT_ANALOG_INPUT,
+            (uint32_t) (i % (MAX_COV_CHANGES * 2)));
+    }
+    Test_Changes_Done = true;
+
+    return NULL;
+}
+
+/* the objects report changes while the server task subscribes,
+   expires and notifies */
+void testCOVThreads(
+    Test * pTest)
+{
+    BACNET_ADDRESS src;
+    pthread_t changes;
+    unsigned i = 0;
+
+    handler_cov_init();
+    test_address(&src, 1);
+    Test_Changes_Done = false;
+    ct_test(pTest, pthread_create(&changes, NULL, test_changes_thread,
+            NULL) == 0);
+    for (i = 0; !Test_Changes_Done; i++) {
+        test_subscribe(&src, i % 64, i % (MAX_COV_CHANGES * 2),
+            (i % 3) == 0, 5);
+        handler_cov_timer_seconds(1);
+        handler_cov_fsm();
+    }
+    ct_test(pTest, pthread_join(changes, NULL) == 0);
+    /* the subscriptions left are intact */
+    handler_cov_init();
+    ct_test(pTest, test_subscribe(&src, 1, 1, false, 0));
+    ct_test(pTest, test_subscribe(&src, 2, 1, false, 0));
+    handler_cov_fsm();
+    Test_Notifications = 0;
+    handler_cov_object_changed(OBJECT_ANALOG_INPUT, 1);
+    handler_cov_fsm();
+    ct_test(pTest, Test_Notifications == 2);
+    handler_cov_init();
+    ct_test(pTest, test_subscriptions() == 0);
+}
+
+#ifdef TEST_COV_HANDLER
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("BACnet COV Subscriptions", NULL);
+    /* individual tests */
+    rc = ct_addTestFunction(pTest, testCOVSubscriptions);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testCOVThreads);
+    assert(rc);
+
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_COV_HANDLER */
+#endif /* TEST */
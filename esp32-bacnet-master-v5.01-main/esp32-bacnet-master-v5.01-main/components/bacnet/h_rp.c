@@ -38,6 +38,7 @@
 #include "abort.h"
 #include "reject.h"
 #include "rp.h"
+#include "tsm.h"
 /* device object has custom handler for all objects */
 #include "device.h"
 #include "handlers.h"
@@ -51,9 +52,9 @@
  * by a call to apdu_set_confirmed_handler().
  * This handler builds a response packet, which is
  * - an Abort if
- *   - the message is segmented
+ *   - the message is segmented (unless segmentation is enabled)
  *   - if decoding fails
- *   - if the response would be too large
+ *   - if the response would be too large for the client
  * - the result from Device_Read_Property(), if it succeeds
  * - an Error if Device_Read_Property() fails
  *   or there isn't enough room in the APDU to fit the data.
@@ -79,6 +80,8 @@ void handler_read_property(
     bool error = true;  /* assume that there is an error */
     int bytes_sent = 0;
     BACNET_ADDRESS my_address;
+    uint8_t *apdu = NULL;
+    uint32_t apdu_size = 0;
 
     /* configure default error code as an abort since it is common */
     rpdata.error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
@@ -88,6 +91,21 @@ void handler_read_property(
     npdu_len =
         npdu_encode_pdu(&Handler_Transmit_Buffer[0], src, &my_address,
         &npdu_data);
+    /* the ACK is encoded here */
+    apdu = &Handler_Transmit_Buffer[npdu_len];
+    apdu_size = sizeof(Handler_Transmit_Buffer) - npdu_len;
+#if BACNET_SEGMENTATION_ENABLED
+    if (service_data->segmented_response_accepted) {
+        /* room for a response that the TSM will segment */
+        uint32_t segment_size = 0;
+        uint8_t *segment_buffer = tsm_segment_buffer_alloc(&segment_size);
+
+        if (segment_buffer) {
+            apdu = segment_buffer;
+            apdu_size = segment_size;
+        }
+    }
+#else
     if (service_data->segmented_message) {
         /* we don't support segmentation - send an abort */
         len = BACNET_STATUS_ABORT;
@@ -96,6 +114,7 @@ void handler_read_property(
 #endif
         goto RP_FAILURE;
     }
+#endif
     len = rp_decode_service_request(service_request, service_len, &rpdata);
 #if PRINT_ENABLED
     if (len <= 0) {
@@ -116,20 +135,21 @@ void handler_read_property(
         rpdata.object_instance = Device_Object_Instance_Number();
     }
 
-    apdu_len =
-        rp_ack_encode_apdu_init(&Handler_Transmit_Buffer[npdu_len],
-        service_data->invoke_id, &rpdata);
-    /* configure our storage */
-    rpdata.application_data = &Handler_Transmit_Buffer[npdu_len + apdu_len];
-    rpdata.application_data_len =
-        sizeof(Handler_Transmit_Buffer) - (npdu_len + apdu_len);
+    apdu_len = rp_ack_encode_apdu_init(apdu, service_data->invoke_id, &rpdata);
+    /* configure our storage - leave room for the closing tag */
+    rpdata.application_data = &apdu[apdu_len];
+    rpdata.application_data_len = (int) apdu_size - (apdu_len + 1);
     len = Device_Read_Property(&rpdata);
     if (len >= 0) {
         apdu_len += len;
-        len =
-            rp_ack_encode_apdu_object_property_end(&Handler_Transmit_Buffer
-            [npdu_len + apdu_len]);
+        len = rp_ack_encode_apdu_object_property_end(&apdu[apdu_len]);
         apdu_len += len;
+#if BACNET_SEGMENTATION_ENABLED
+        /* the TSM segments the ACK or aborts if the client can't take it */
+        tsm_set_complexack_transaction(src, &npdu_data, service_data, apdu,
+            (uint32_t) apdu_len);
+        return;
+#else
         if (apdu_len > service_data->max_resp) {
             /* too big for the sender - send an abort
              * Setting of error code needed here as read property processing may
@@ -145,6 +165,7 @@ void handler_read_property(
 #endif
             error = false;
         }
+#endif
     } else {
 #if PRINT_ENABLED
         fprintf(stderr, "RP: Device_Read_Property: ");
@@ -161,6 +182,9 @@ void handler_read_property(
     }
 
   RP_FAILURE:
+#if BACNET_SEGMENTATION_ENABLED
+    tsm_segment_buffer_free(apdu);
+#endif
     if (error) {
         if (len == BACNET_STATUS_ABORT) {
             apdu_len =
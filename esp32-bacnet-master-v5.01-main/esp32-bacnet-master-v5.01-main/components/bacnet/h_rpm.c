@@ -31,7 +31,6 @@
 #include <errno.h>
 #include "config.h"
 #include "txbuf.h"
-#include "memcopy.h"
 #include "bacdef.h"
 #include "bacdcode.h"
 #include "apdu.h"
@@ -40,14 +39,14 @@
 #include "reject.h"
 #include "bacerror.h"
 #include "rpm.h"
+#include "proplist.h"
+#include "tsm.h"
 #include "handlers.h"
 /* device object has custom handler for all objects */
 #include "device.h"
 
 /** @file h_rpm.c  Handles Read Property Multiple requests. */
 
-static uint8_t Temp_Buf[MAX_APDU] = { 0 };
-
 static BACNET_PROPERTY_ID RPM_Object_Property(
     struct special_property_list_t *pPropertyList,
     BACNET_PROPERTY_ID special_property,
@@ -101,68 +100,85 @@ static unsigned RPM_Object_Property_Count(
     return count;
 }
 
-/** Encode the RPM property returning the length of the encoding,
-   or 0 if there is no room to fit the encoding.  */
+/* Values are read straight into the reply, and the readers are given the
+   room that is really left there.  Lists are checked against that room
+   element by element, but a single value - at most a character string of
+   MAX_DEV_DESC_LEN - is encoded without looking at it.  So with less room
+   than that left, the value is read into a scratch copy, like the small
+   parts of the ACK are, and kept only if it fits. */
+#define RPM_VALUE_PART_MAX (MAX_DEV_DESC_LEN + 8)
+
+/** Encode the RPM property at the cursor returning the length of the
+   encoding, or BACNET_STATUS_ABORT if there is no room to fit it.  */
 static int RPM_Encode_Property(
-    uint8_t * apdu,
-    uint16_t offset,
-    uint16_t max_apdu,
+    RPM_ACK_CURSOR * cursor,
     BACNET_RPM_DATA * rpmdata)
 {
     int len = 0;
-    size_t copy_len = 0;
-    int apdu_len = 0;
+    unsigned mark = 0;
+    unsigned value_mark = 0;
+    unsigned max_len = 0;
+    unsigned value_len = 0;
+    bool in_place = false;
+    uint8_t scratch[RPM_VALUE_PART_MAX];
     BACNET_READ_PROPERTY_DATA rpdata;
 
-    len =
-        rpm_ack_encode_apdu_object_property(&Temp_Buf[0],
-        rpmdata->object_property, rpmdata->array_index);
-    copy_len = memcopy(&apdu[0], &Temp_Buf[0], offset, len, max_apdu);
-    if (copy_len == 0) {
+    mark = rpm_ack_cursor_mark(cursor);
+    if (!rpm_ack_cursor_object_property(cursor, rpmdata->object_property,
+            rpmdata->array_index)) {
         rpmdata->error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
         return BACNET_STATUS_ABORT;
     }
-    apdu_len += len;
-    len = 0;
+    value_mark = rpm_ack_cursor_mark(cursor);
     rpdata.error_class = ERROR_CLASS_OBJECT;
     rpdata.error_code = ERROR_CODE_UNKNOWN_OBJECT;
     rpdata.object_type = rpmdata->object_type;
     rpdata.object_instance = rpmdata->object_instance;
     rpdata.object_property = rpmdata->object_property;
     rpdata.array_index = rpmdata->array_index;
-    rpdata.application_data = &Temp_Buf[0];
-    rpdata.application_data_len = sizeof(Temp_Buf);
+    value_len =
+        property_table_value_len(Device_Objects_Property_Table
+        (rpmdata->object_type), rpmdata->object_property,
+        rpmdata->array_index);
+    if ((rpm_ack_cursor_room(cursor) >= RPM_VALUE_PART_MAX) ||
+        ((value_len > 0) && (rpm_ack_cursor_room(cursor) >= (value_len + 2)))) {
+        rpdata.application_data = rpm_ack_cursor_value_begin(cursor, &max_len);
+        rpdata.application_data_len = max_len;
+        in_place = true;
+    } else {
+        rpdata.application_data = &scratch[0];
+        rpdata.application_data_len = sizeof(scratch);
+    }
     len = Device_Read_Property(&rpdata);
     if (len < 0) {
         if ((len == BACNET_STATUS_ABORT) || (len == BACNET_STATUS_REJECT)) {
+            rpm_ack_cursor_rollback(cursor, mark);
             rpmdata->error_code = rpdata.error_code;
             /* pass along aborts and rejects for now */
             return len; /* Ie, Abort */
         }
         /* error was returned - encode that for the response */
-        len =
-            rpm_ack_encode_apdu_object_property_error(&Temp_Buf[0],
-            rpdata.error_class, rpdata.error_code);
-        copy_len =
-            memcopy(&apdu[0], &Temp_Buf[0], offset + apdu_len, len, max_apdu);
-
-        if (copy_len == 0) {
+        rpm_ack_cursor_rollback(cursor, value_mark);
+        if (!rpm_ack_cursor_object_property_error(cursor, rpdata.error_class,
+                rpdata.error_code)) {
+            rpm_ack_cursor_rollback(cursor, mark);
             rpmdata->error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
             return BACNET_STATUS_ABORT;
         }
-    } else if ((offset + apdu_len + 1 + len + 1) < max_apdu) {
-        /* enough room to fit the property value and tags */
-        len =
-            rpm_ack_encode_apdu_object_property_value(&apdu[offset + apdu_len],
-            &Temp_Buf[0], len);
-    } else {
+    } else if (in_place) {
+        if (!rpm_ack_cursor_value_end(cursor, (unsigned) len)) {
+            rpm_ack_cursor_rollback(cursor, mark);
+            rpmdata->error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
+            return BACNET_STATUS_ABORT;
+        }
+    } else if (!rpm_ack_cursor_value(cursor, &scratch[0], (unsigned) len)) {
         /* not enough room - abort! */
+        rpm_ack_cursor_rollback(cursor, mark);
         rpmdata->error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
         return BACNET_STATUS_ABORT;
     }
-    apdu_len += len;
 
-    return apdu_len;
+    return (int) (rpm_ack_cursor_mark(cursor) - mark);
 }
 
 /** Handler for a ReadPropertyMultiple Service request.
@@ -171,9 +187,9 @@ static int RPM_Encode_Property(
  * by a call to apdu_set_confirmed_handler().
  * This handler builds a response packet, which is
  * - an Abort if
- *   - the message is segmented
+ *   - the message is segmented (unless segmentation is enabled)
  *   - if decoding fails
- *   - if the response would be too large
+ *   - if the response would be too large for the client
  * - the result from each included read request, if it succeeds
  * - an Error if processing fails for all, or individual errors if only some fail,
  *   or there isn't enough room in the APDU to fit the data.
@@ -191,7 +207,6 @@ void handler_read_property_multiple(
     BACNET_CONFIRMED_SERVICE_DATA * service_data)
 {
     int len = 0;
-    uint16_t copy_len = 0;
     uint16_t decode_len = 0;
     int pdu_len = 0;
     BACNET_NPDU_DATA npdu_data;
@@ -201,6 +216,9 @@ void handler_read_property_multiple(
     int apdu_len = 0;
     int npdu_len = 0;
     int error = 0;
+    uint8_t *apdu = NULL;
+    uint16_t apdu_size = MAX_APDU;
+    RPM_ACK_CURSOR cursor;
 
     /* jps_debug - see if we are utilizing all the buffer */
     /* memset(&Handler_Transmit_Buffer[0], 0xff, sizeof(Handler_Transmit_Buffer)); */
@@ -210,6 +228,20 @@ void handler_read_property_multiple(
     npdu_len =
         npdu_encode_pdu(&Handler_Transmit_Buffer[0], src, &my_address,
         &npdu_data);
+    /* the ACK is encoded here */
+    apdu = &Handler_Transmit_Buffer[npdu_len];
+#if BACNET_SEGMENTATION_ENABLED
+    if (service_data->segmented_response_accepted) {
+        /* room for a response that the TSM will segment */
+        uint32_t segment_size = 0;
+        uint8_t *segment_buffer = tsm_segment_buffer_alloc(&segment_size);
+
+        if (segment_buffer) {
+            apdu = segment_buffer;
+            apdu_size = (uint16_t) segment_size;
+        }
+    }
+#else
     if (service_data->segmented_message) {
         rpmdata.error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
         error = BACNET_STATUS_ABORT;
@@ -218,11 +250,11 @@ void handler_read_property_multiple(
 #endif
         goto RPM_FAILURE;
     }
+#endif
     /* decode apdu request & encode apdu reply
        encode complex ack, invoke id, service choice */
-    apdu_len =
-        rpm_ack_encode_apdu_init(&Handler_Transmit_Buffer[npdu_len],
-        service_data->invoke_id);
+    apdu_len = rpm_ack_encode_apdu_init(apdu, service_data->invoke_id);
+    rpm_ack_cursor_init(&cursor, apdu, apdu_size, apdu_len);
     for (;;) {
         /* Start by looking for an object ID */
         len =
@@ -247,11 +279,7 @@ void handler_read_property_multiple(
         }
 
         /* Stick this object id into the reply - if it will fit */
-        len = rpm_ack_encode_apdu_object_begin(&Temp_Buf[0], &rpmdata);
-        copy_len =
-            memcopy(&Handler_Transmit_Buffer[npdu_len], &Temp_Buf[0], apdu_len,
-            len, MAX_APDU);
-        if (copy_len == 0) {
+        if (!rpm_ack_cursor_object_begin(&cursor, &rpmdata)) {
 #if PRINT_ENABLED
             fprintf(stderr, "RPM: Response too big!\r\n");
 #endif
@@ -259,8 +287,6 @@ void handler_read_property_multiple(
             error = BACNET_STATUS_ABORT;
             goto RPM_FAILURE;
         }
-
-        apdu_len += copy_len;
         /* do each property of this object of the RPM request */
         for (;;) {
             /* Fetch a property */
@@ -284,17 +310,15 @@ void handler_read_property_multiple(
                 unsigned property_count = 0;
                 unsigned index = 0;
                 BACNET_PROPERTY_ID special_object_property;
+                const struct property_table_t *property_table;
 
+                property_table =
+                    Device_Objects_Property_Table(rpmdata.object_type);
                 if (rpmdata.array_index != BACNET_ARRAY_ALL) {
                     /*  No array index options for this special property.
                        Encode error for this object property response */
-                    len =
-                        rpm_ack_encode_apdu_object_property(&Temp_Buf[0],
-                        rpmdata.object_property, rpmdata.array_index);
-                    copy_len =
-                        memcopy(&Handler_Transmit_Buffer[npdu_len],
-                        &Temp_Buf[0], apdu_len, len, MAX_APDU);
-                    if (copy_len == 0) {
+                    if (!rpm_ack_cursor_object_property(&cursor,
+                            rpmdata.object_property, rpmdata.array_index)) {
 #if PRINT_ENABLED
                         fprintf(stderr,
                             "RPM: Too full to encode property!\r\n");
@@ -304,15 +328,9 @@ void handler_read_property_multiple(
                         error = BACNET_STATUS_ABORT;
                         goto RPM_FAILURE;
                     }
-                    apdu_len += len;
-                    len =
-                        rpm_ack_encode_apdu_object_property_error(&Temp_Buf[0],
-                        ERROR_CLASS_PROPERTY,
-                        ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY);
-                    copy_len =
-                        memcopy(&Handler_Transmit_Buffer[npdu_len],
-                        &Temp_Buf[0], apdu_len, len, MAX_APDU);
-                    if (copy_len == 0) {
+                    if (!rpm_ack_cursor_object_property_error(&cursor,
+                            ERROR_CLASS_PROPERTY,
+                            ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY)) {
 #if PRINT_ENABLED
                         fprintf(stderr, "RPM: Too full to encode error!\r\n");
 #endif
@@ -321,7 +339,25 @@ void handler_read_property_multiple(
                         error = BACNET_STATUS_ABORT;
                         goto RPM_FAILURE;
                     }
-                    apdu_len += len;
+                } else if (property_table) {
+                    /* walk the property table of the object type */
+                    special_object_property = rpmdata.object_property;
+                    for (index = 0; index < property_table->count; index++) {
+                        if (!property_table_special(&property_table->
+                                descr[index], special_object_property)) {
+                            continue;
+                        }
+                        rpmdata.object_property =
+                            property_table->descr[index].property;
+                        len = RPM_Encode_Property(&cursor, &rpmdata);
+                        if (len < 0) {
+#if PRINT_ENABLED
+                            fprintf(stderr, "RPM: Too full for property!\r\n");
+#endif
+                            error = len;
+                            goto RPM_FAILURE;
+                        }
+                    }
                 } else {
                     special_object_property = rpmdata.object_property;
                     Device_Objects_Property_List(rpmdata.object_type,
@@ -341,13 +377,8 @@ void handler_read_property_multiple(
                             rpmdata.object_property =
                                 RPM_Object_Property(&property_list,
                                 special_object_property, index);
-                            len =
-                                RPM_Encode_Property(&Handler_Transmit_Buffer
-                                [npdu_len], (uint16_t) apdu_len, MAX_APDU,
-                                &rpmdata);
-                            if (len > 0) {
-                                apdu_len += len;
-                            } else {
+                            len = RPM_Encode_Property(&cursor, &rpmdata);
+                            if (len < 0) {
 #if PRINT_ENABLED
                                 fprintf(stderr,
                                     "RPM: Too full for property!\r\n");
@@ -360,12 +391,8 @@ void handler_read_property_multiple(
                 }
             } else {
                 /* handle an individual property */
-                len =
-                    RPM_Encode_Property(&Handler_Transmit_Buffer[npdu_len],
-                    (uint16_t) apdu_len, MAX_APDU, &rpmdata);
-                if (len > 0) {
-                    apdu_len += len;
-                } else {
+                len = RPM_Encode_Property(&cursor, &rpmdata);
+                if (len < 0) {
 #if PRINT_ENABLED
                     fprintf(stderr,
                         "RPM: Too full for individual property!\r\n");
@@ -377,11 +404,7 @@ void handler_read_property_multiple(
             if (decode_is_closing_tag_number(&service_request[decode_len], 1)) {
                 /* Reached end of property list so cap the result list */
                 decode_len++;
-                len = rpm_ack_encode_apdu_object_end(&Temp_Buf[0]);
-                copy_len =
-                    memcopy(&Handler_Transmit_Buffer[npdu_len], &Temp_Buf[0],
-                    apdu_len, len, MAX_APDU);
-                if (copy_len == 0) {
+                if (!rpm_ack_cursor_object_end(&cursor)) {
 #if PRINT_ENABLED
                     fprintf(stderr, "RPM: Too full to encode object end!\r\n");
 #endif
@@ -389,8 +412,6 @@ void handler_read_property_multiple(
                         ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
                     error = BACNET_STATUS_ABORT;
                     goto RPM_FAILURE;
-                } else {
-                    apdu_len += copy_len;
                 }
                 break;  /* finished with this property list */
             }
@@ -400,7 +421,14 @@ void handler_read_property_multiple(
             break;
         }
     }
+    apdu_len = (int) cursor.len;
 
+#if BACNET_SEGMENTATION_ENABLED
+    /* the TSM segments the ACK or aborts if the client can't take it */
+    tsm_set_complexack_transaction(src, &npdu_data, service_data, apdu,
+        (uint32_t) apdu_len);
+    return;
+#else
     if (apdu_len > service_data->max_resp) {
         /* too big for the sender - send an abort */
         rpmdata.error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
@@ -410,8 +438,12 @@ void handler_read_property_multiple(
 #endif
         goto RPM_FAILURE;
     }
+#endif
 
   RPM_FAILURE:
+#if BACNET_SEGMENTATION_ENABLED
+    tsm_segment_buffer_free(apdu);
+#endif
     if (error) {
         if (error == BACNET_STATUS_ABORT) {
             apdu_len =
@@ -36,12 +36,14 @@
 #include "npdu.h"
 #include "abort.h"
 #include "readrange.h"
+#include "tsm.h"
 #include "device.h"
 #include "handlers.h"
 
 /** @file h_rr.c  Handles Read Range requests. */
 
-static uint8_t Temp_Buf[MAX_APDU] = { 0 };
+/* room for the ReadRange-ACK header in front of the items */
+#define RR_ACK_HEADER_MAX 32
 
 /* Encodes the property APDU and returns the length,
    or sets the error, and returns -1 */
@@ -100,6 +102,8 @@ void handler_read_range(
     bool error = false;
     int bytes_sent = 0;
     BACNET_ADDRESS my_address;
+    uint8_t *payload = NULL;
+    uint8_t *apdu = &Handler_Transmit_Buffer[0];
 
     data.error_class = ERROR_CLASS_OBJECT;
     data.error_code = ERROR_CODE_UNKNOWN_OBJECT;
@@ -109,6 +113,8 @@ void handler_read_range(
     pdu_len =
         npdu_encode_pdu(&Handler_Transmit_Buffer[0], src, &my_address,
         &npdu_data);
+    apdu = &Handler_Transmit_Buffer[pdu_len];
+#if !BACNET_SEGMENTATION_ENABLED
     if (service_data->segmented_message) {
         /* we don't support segmentation - send an abort */
         len =
@@ -120,6 +126,7 @@ void handler_read_range(
 #endif
         goto RR_ABORT;
     }
+#endif
     memset(&data, 0, sizeof(data));     /* start with blank canvas */
     len = rr_decode_service_request(service_request, service_len, &data);
 #if PRINT_ENABLED
@@ -137,22 +144,53 @@ void handler_read_range(
         goto RR_ABORT;
     }
 
+    /* encode the items where the ACK wants them, so that
+       rr_ack_encode_apdu() only has to slide them forward */
+    payload = &apdu[RR_ACK_HEADER_MAX];
+    /* room for the whole ACK - the handler subtracts the Overhead,
+       which is RR_OVERHEAD or more - as long as the items still
+       fit in the transmit buffer behind the NPDU */
+    data.application_data_len = MAX_APDU;
+    if ((pdu_len + RR_ACK_HEADER_MAX + MAX_APDU - RR_OVERHEAD) > MAX_PDU) {
+        data.application_data_len =
+            MAX_PDU - pdu_len - RR_ACK_HEADER_MAX + RR_OVERHEAD;
+    }
+#if BACNET_SEGMENTATION_ENABLED
+    if (service_data->segmented_response_accepted) {
+        uint32_t segment_size = 0;
+        uint8_t *segment_buffer = tsm_segment_buffer_alloc(&segment_size);
+
+        if (segment_buffer) {
+            apdu = segment_buffer;
+            payload = &segment_buffer[RR_ACK_HEADER_MAX];
+            data.application_data_len =
+                (int) (segment_size - RR_ACK_HEADER_MAX);
+        }
+    }
+#endif
     /* assume that there is an error */
     error = true;
-    len = Encode_RR_payload(&Temp_Buf[0], &data);
+    len = Encode_RR_payload(payload, &data);
     if (len >= 0) {
         /* encode the APDU portion of the packet */
-        data.application_data = &Temp_Buf[0];
+        data.application_data = payload;
         data.application_data_len = len;
-        /* FIXME: probably need a length limitation sent with encode */
-        len =
-            rr_ack_encode_apdu(&Handler_Transmit_Buffer[pdu_len],
-            service_data->invoke_id, &data);
+        len = rr_ack_encode_apdu(apdu, service_data->invoke_id, &data);
+#if BACNET_SEGMENTATION_ENABLED
+        /* the TSM segments the ACK or aborts if the client can't take it */
+        tsm_set_complexack_transaction(src, &npdu_data, service_data, apdu,
+            (uint32_t) len);
+        return;
+#else
 #if PRINT_ENABLED
         fprintf(stderr, "RR: Sending Ack!\n");
 #endif
         error = false;
+#endif
     }
+#if BACNET_SEGMENTATION_ENABLED
+    tsm_segment_buffer_free(apdu);
+#endif
     if (error) {
         if (len == -2) {
             /* BACnet APDU too small to fit data, so proper response is Abort */
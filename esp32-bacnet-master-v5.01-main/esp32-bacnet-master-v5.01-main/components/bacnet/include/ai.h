@@ -31,6 +31,7 @@
 #include "bacdef.h"
 #include "rp.h"
 #include "wp.h"
+#include "proplist.h"
 #if defined(INTRINSIC_REPORTING)
 #include "nc.h"
 #include "getevent.h"
@@ -44,13 +45,8 @@ extern "C" {
 
     typedef struct analog_input_descr {
         unsigned Event_State:3;
-        float Present_Value;
         BACNET_RELIABILITY Reliability;
-        bool Out_Of_Service;
         uint8_t Units;
-        float Prior_Value;
-        float COV_Increment;
-        bool Changed;
 #if defined(INTRINSIC_REPORTING)
         uint32_t Time_Delay;
         uint32_t Notification_Class;
@@ -73,6 +69,8 @@ extern "C" {
         const int **pRequired,
         const int **pOptional,
         const int **pProprietary);
+    const struct property_table_t *Analog_Input_Property_Table(
+        void);
 
     bool Analog_Input_Valid_Instance(
         uint32_t object_instance);
@@ -48,6 +48,27 @@ typedef struct _confirmed_service_ack_data {
     uint8_t proposed_window_number;
 } BACNET_CONFIRMED_SERVICE_ACK_DATA;
 
+#if APDU_STATISTICS
+/* handler execution time buckets: below 64us, then each bucket
+   four times wider than the one before, the last has the rest */
+#define APDU_STATISTICS_BUCKETS 8
+/* service choice used for the counters of unknown services */
+#define APDU_STATISTICS_OTHER 255
+/* largest encoding of one service's counters */
+#define APDU_STATISTICS_ELEMENT_MAX ((8 + APDU_STATISTICS_BUCKETS) * 5)
+
+typedef struct _apdu_service_statistics {
+    uint32_t requests;
+    uint32_t dcc_drops;
+    uint32_t rejects;
+    uint32_t aborts;
+    /* handler execution time in microseconds */
+    uint32_t time_max;
+    uint64_t time_total;
+    uint32_t time_histogram[APDU_STATISTICS_BUCKETS];
+} BACNET_APDU_SERVICE_STATISTICS;
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -163,9 +184,13 @@ extern "C" {
 
     void apdu_set_abort_handler(
         abort_function pFunction);
+    abort_function apdu_get_abort_handler(
+        void);
 
     void apdu_set_reject_handler(
         reject_function pFunction);
+    reject_function apdu_get_reject_handler(
+        void);
 
     uint16_t apdu_decode_confirmed_service_request(
         uint8_t * apdu, /* APDU data */
@@ -183,12 +208,35 @@ extern "C" {
         void);
     void apdu_retries_set(
         uint8_t value);
+#if BACNET_SEGMENTATION_ENABLED
+    uint16_t apdu_segment_timeout(
+        void);
+    void apdu_segment_timeout_set(
+        uint16_t value);
+#endif
 
     void apdu_handler(
         BACNET_ADDRESS * src,   /* source address */
         uint8_t * apdu, /* APDU data */
         uint16_t pdu_len);      /* for confirmed messages */
 
+#if APDU_STATISTICS
+    const BACNET_APDU_SERVICE_STATISTICS *apdu_statistics(
+        bool confirmed,
+        uint8_t service_choice);
+    void apdu_statistics_reset(
+        void);
+    void apdu_statistics_reject(
+        void);
+    void apdu_statistics_abort(
+        void);
+    unsigned apdu_statistics_count(
+        void);
+    int apdu_statistics_encode(
+        uint8_t * apdu,
+        unsigned index);
+#endif
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
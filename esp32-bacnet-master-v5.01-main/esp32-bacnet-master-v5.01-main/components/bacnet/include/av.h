@@ -32,6 +32,7 @@
 #include "bacerror.h"
 #include "wp.h"
 #include "rp.h"
+#include "proplist.h"
 #if defined(INTRINSIC_REPORTING)
 #include "nc.h"
 #include "alarm_ack.h"
@@ -45,9 +46,7 @@ extern "C" {
 
     typedef struct analog_value_descr {
         unsigned Event_State:3;
-        bool Out_Of_Service;
         uint16_t Units;
-        float Present_Value;
 #if defined(INTRINSIC_REPORTING)
         uint32_t Time_Delay;
         uint32_t Notification_Class;
@@ -71,6 +70,8 @@ extern "C" {
         const int **pRequired,
         const int **pOptional,
         const int **pProprietary);
+    const struct property_table_t *Analog_Value_Property_Table(
+        void);
     bool Analog_Value_Valid_Instance(
         uint32_t object_instance);
     unsigned Analog_Value_Count(
@@ -130,6 +130,14 @@ typedef struct BACnet_Object_Property_Value {
     BACNET_APPLICATION_DATA_VALUE *value;
 } BACNET_OBJECT_PROPERTY_VALUE;
 
+/* A bounded buffer that values are encoded into one after the other,
+   each into the exact room that the size query gives for it. */
+typedef struct bacapp_cursor {
+    uint8_t *apdu;
+    unsigned size;      /* octets in the apdu buffer */
+    unsigned len;       /* octets encoded so far */
+} BACAPP_CURSOR;
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -172,6 +180,26 @@ extern "C" {
         uint8_t context_tag_number,
         BACNET_APPLICATION_DATA_VALUE * value);
 
+    /* the octets the encoders above would encode, without encoding them */
+    int bacapp_encode_data_len(
+        BACNET_APPLICATION_DATA_VALUE * value);
+    int bacapp_encode_application_data_len(
+        BACNET_APPLICATION_DATA_VALUE * value);
+    int bacapp_encode_context_data_value_len(
+        uint8_t context_tag_number,
+        BACNET_APPLICATION_DATA_VALUE * value);
+
+    void bacapp_cursor_init(
+        BACAPP_CURSOR * cursor,
+        uint8_t * apdu,
+        unsigned size);
+    uint8_t *bacapp_cursor_reserve(
+        BACAPP_CURSOR * cursor,
+        unsigned len);
+    int bacapp_cursor_encode_data(
+        BACAPP_CURSOR * cursor,
+        BACNET_APPLICATION_DATA_VALUE * value);
+
     BACNET_APPLICATION_TAG bacapp_context_tag_type(
         BACNET_PROPERTY_ID property,
         uint8_t tag_number);
@@ -239,6 +267,8 @@ extern "C" {
         Test * pTest);
     void testBACnetApplicationData(
         Test * pTest);
+    void testBACnetApplicationDataEncodeLen(
+        Test * pTest);
 #endif
 
 #ifdef __cplusplus
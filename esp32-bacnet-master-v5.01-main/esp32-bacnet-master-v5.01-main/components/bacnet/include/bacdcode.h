@@ -45,6 +45,9 @@ extern "C" {
         uint8_t tag_number,
         bool context_specific,
         uint32_t len_value_type);
+    int encode_tag_len(
+        uint8_t tag_number,
+        uint32_t len_value_type);
 
 /* from clause 20.2.1.3.2 Constructed Data */
 /* returns the number of apdu bytes consumed */
@@ -256,6 +259,8 @@ extern "C" {
     int encode_bacnet_unsigned(
         uint8_t * apdu,
         uint32_t value);
+    int encode_bacnet_unsigned_len(
+        uint32_t value);
     int encode_context_unsigned(
         uint8_t * apdu,
         uint8_t tag_number,
@@ -278,6 +283,8 @@ extern "C" {
     int encode_bacnet_signed(
         uint8_t * apdu,
         int32_t value);
+    int encode_bacnet_signed_len(
+        int32_t value);
     int encode_application_signed(
         uint8_t * apdu,
         int32_t value);
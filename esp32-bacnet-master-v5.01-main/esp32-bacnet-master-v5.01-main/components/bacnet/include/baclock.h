@@ -0,0 +1,97 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#ifndef BACLOCK_H
+#define BACLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#if defined(TEST)
+#include <pthread.h>
+#else
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#endif
+
+/** A recursive lock that needs no init call, so that a module can
+ *  declare it static and have it taken first by any task. */
+typedef struct baclock {
+#if defined(TEST)
+    pthread_mutex_t mutex;
+    pthread_t owner;
+    unsigned depth;
+#else
+    /* guards the creation of the mutex on its first take */
+    portMUX_TYPE spinlock;
+    SemaphoreHandle_t mutex;
+    StaticSemaphore_t buffer;
+#endif
+} BACLOCK;
+
+#if defined(TEST)
+#define BACLOCK_INITIALIZER { .mutex = PTHREAD_MUTEX_INITIALIZER }
+#else
+#define BACLOCK_INITIALIZER { .spinlock = portMUX_INITIALIZER_UNLOCKED }
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    void baclock_take(
+        BACLOCK * lock);
+    void baclock_give(
+        BACLOCK * lock);
+    void *baclock_task(
+        void);
+
+#ifdef TEST
+#include "ctest.h"
+    void testBACLock(
+        Test * pTest);
+#endif
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup BACLock Stack Locks
+ * The server task, the client task and the tasks that receive on the
+ * ports all call into the stack, so each module whose state they share
+ * keeps it behind a BACLOCK of its own: the COV subscriptions, the TSM,
+ * the address cache, the transmit queue, the router, and the BBMD and
+ * VMAC tables of BACnet/IP and BACnet/IPv6.  A lock is held only while
+ * the state is touched, never while a datalink is waited on.  Locks are
+ * taken in that order and never the other way round: the COV handler
+ * starts confirmed notifications in the TSM, and the TSM may send
+ * through the transmit queue and the router while it holds its lock,
+ * but no module calls back into the COV handler, the TSM or the address
+ * cache with a lock held.
+ * The handlers encode into Handler_Transmit_Buffer, which is a buffer
+ * of the calling task's own.  The objects belong to the server task,
+ * which is the only one that reads or writes their properties.
+ * The host build uses pthreads, so that the tests can hammer a module
+ * from several threads at once.
+ */
+#endif
@@ -32,8 +32,14 @@
 #include "net.h"
 
 /* specific defines for BACnet/IP over Ethernet */
-#define MAX_HEADER (1 + 1 + 2)
-#define MAX_MPDU (MAX_HEADER+MAX_PDU)
+#define BIP_HEADER_MAX (1 + 1 + 2)
+#define BIP_MPDU_MAX (BIP_HEADER_MAX+MAX_PDU)
+/* for legacy demo applications; a router includes the datalink
+   with the largest header first */
+#if !defined(MAX_HEADER)
+#define MAX_HEADER BIP_HEADER_MAX
+#define MAX_MPDU BIP_MPDU_MAX
+#endif
 
 #define BVLL_TYPE_BACNET_IP (0x81)
 
@@ -20,11 +20,16 @@
 #include "npdu.h"
 #include "bvlc6.h"
 
-/* specific defines for BACnet/IP over Ethernet */
-#define BIP6_HEADER_MAX (1 + 1 + 2)
+/* specific defines for BACnet/IPv6: the longest BVLL header in front
+   of an NPDU is that of a Forwarded-NPDU, with a VMAC and a B/IPv6
+   address after its type, function and length */
+#define BIP6_HEADER_MAX (1 + 1 + 2 + 3 + BIP6_ADDRESS_MAX)
 #define BIP6_MPDU_MAX (BIP6_HEADER_MAX+MAX_PDU)
 /* for legacy demo applications */
+#if !defined(MAX_HEADER)
+#define MAX_HEADER BIP6_HEADER_MAX
 #define MAX_MPDU BIP6_MPDU_MAX
+#endif
 
 #ifdef __cplusplus
 extern "C" {
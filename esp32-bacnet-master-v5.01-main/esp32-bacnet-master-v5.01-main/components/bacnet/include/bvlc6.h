@@ -376,6 +376,11 @@ extern "C" {
         uint16_t * npdu_len);
 
     /* user application function prototypes */
+    int bvlc6_send_pdu(
+        BACNET_ADDRESS * dest,
+        BACNET_NPDU_DATA * npdu_data,
+        uint8_t * pdu,
+        unsigned pdu_len);
     void bvlc6_maintenance_timer(time_t seconds);
     int bvlc6_handler(
         BACNET_IP6_ADDRESS *addr,
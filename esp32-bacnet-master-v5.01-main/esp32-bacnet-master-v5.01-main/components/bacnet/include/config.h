@@ -52,6 +52,60 @@
 #if !defined(BBMD6_ENABLED)
 #define BBMD6_ENABLED 0
 #endif
+/* broadcasts go to FF0X::BAC0 of this scope; FF05 is site-local */
+#if !defined(BIP6_MULTICAST_SCOPE)
+#define BIP6_MULTICAST_SCOPE 0xFF05
+#endif
+#endif
+
+/* optional configuration for the MS/TP datalink layer: an RS-485
+   transceiver on one of the ESP32 UARTs, with its driver enable on the
+   RTS pin.  These are normally set from the BACnet menu of menuconfig. */
+#if defined(BACDL_MSTP) || defined(BACDL_ROUTER)
+#if !defined(MSTP_UART_NUM)
+#define MSTP_UART_NUM 1
+#endif
+#if !defined(MSTP_TX_GPIO)
+#define MSTP_TX_GPIO 17
+#endif
+#if !defined(MSTP_RX_GPIO)
+#define MSTP_RX_GPIO 16
+#endif
+#if !defined(MSTP_DE_GPIO)
+#define MSTP_DE_GPIO 4
+#endif
+#if !defined(MSTP_BAUD_RATE)
+#define MSTP_BAUD_RATE 38400
+#endif
+/* 0..127 for a master node, 128..254 for a slave */
+#if !defined(MSTP_MAC_ADDRESS)
+#define MSTP_MAC_ADDRESS 127
+#endif
+#if !defined(MSTP_MAX_MASTER)
+#define MSTP_MAX_MASTER 127
+#endif
+#if !defined(MSTP_MAX_INFO_FRAMES)
+#define MSTP_MAX_INFO_FRAMES 1
+#endif
+/* PDUs waiting for the token to be sent; a power of two */
+#if !defined(MSTP_PDU_PACKET_COUNT)
+#define MSTP_PDU_PACKET_COUNT 4
+#endif
+#endif
+
+/* optional configuration for the router between the BACnet/IP port,
+   where the device itself is, the MS/TP port and, with BACDL_BIP6,
+   the BACnet/IPv6 port */
+#if defined(BACDL_ROUTER)
+#if !defined(ROUTER_BIP_NET)
+#define ROUTER_BIP_NET 1
+#endif
+#if !defined(ROUTER_MSTP_NET)
+#define ROUTER_MSTP_NET 2
+#endif
+#if !defined(ROUTER_BIP6_NET)
+#define ROUTER_BIP6_NET 3
+#endif
 #endif
 
 /* Enable the Gateway (Routing) functionality here, if desired. */
@@ -87,7 +141,10 @@
 #if !defined(MAX_APDU)
     /* #define MAX_APDU 50 */
     /* #define MAX_APDU 1476 */
-#if defined(BACDL_BIP)
+#if defined(BACDL_ROUTER)
+/* the device answers on both networks */
+#define MAX_APDU 480
+#elif defined(BACDL_BIP)
 #define MAX_APDU 1476
 /* #define MAX_APDU 128 enable this IP for testing
    readrange so you get the More Follows flag set */
@@ -108,6 +165,91 @@
 #if !defined(MAX_TSM_TRANSACTIONS)
 #define MAX_TSM_TRANSACTIONS 5
 #endif
+
+/* Segmented requests and responses (clause 5.2 and 5.4).
+   Set to 0 to abort any message that would need segmentation.
+   Segmentation is carried by the TSM, so it needs MAX_TSM_TRANSACTIONS. */
+#if !defined(BACNET_SEGMENTATION_ENABLED)
+#if MAX_TSM_TRANSACTIONS
+#define BACNET_SEGMENTATION_ENABLED 1
+#else
+#define BACNET_SEGMENTATION_ENABLED 0
+#endif
+#endif
+#if BACNET_SEGMENTATION_ENABLED
+/* number of segments we accept in one message: 2,4,8,16,32 or 64,
+   so long as MAX_SEGMENTED_APDU stays within the 16-bit service request
+   length of 65535 - at most 32 with a MAX_APDU of 1476, and 64 only
+   with a MAX_APDU of 1023 or less */
+#if !defined(MAX_SEGMENTS_ACCEPTED)
+#define MAX_SEGMENTS_ACCEPTED 8
+#endif
+/* largest window we propose or accept, 1..127 */
+#if !defined(MAX_SEGMENT_WINDOW_SIZE)
+#define MAX_SEGMENT_WINDOW_SIZE 4
+#endif
+/* number of pooled buffers used for reassembly and segmented replies */
+#if !defined(MAX_SEGMENT_BUFFERS)
+#define MAX_SEGMENT_BUFFERS 2
+#endif
+/* number of segmented transactions we serve for other clients at once */
+#if !defined(MAX_TSM_PEER_TRANSACTIONS)
+#define MAX_TSM_PEER_TRANSACTIONS 2
+#endif
+/* size of one pooled buffer - a whole segmented APDU */
+#define MAX_SEGMENTED_APDU (MAX_APDU * MAX_SEGMENTS_ACCEPTED)
+#endif
+
+/* Transmit queue between the application and the datalink.
+   Outgoing PDUs are queued by network priority and sent by the task
+   that queues them, or by the one already sending, so that life-safety
+   and urgent messages go out ahead of bulk replies.  Broadcasts held
+   back for credit go from dlqueue_task().
+   Set to 0 to send straight to the datalink. */
+#if !defined(DATALINK_TX_QUEUE_SIZE)
+#define DATALINK_TX_QUEUE_SIZE 8
+#endif
+#if DATALINK_TX_QUEUE_SIZE
+/* normal priority broadcasts (I-Am, Who-Is...) allowed per second */
+#if !defined(DATALINK_TX_BROADCAST_RATE)
+#define DATALINK_TX_BROADCAST_RATE 4
+#endif
+/* number of broadcasts that may go out back to back after a quiet time */
+#if !defined(DATALINK_TX_BROADCAST_BURST)
+#define DATALINK_TX_BROADCAST_BURST 4
+#endif
+#endif
+
+/* Per-service counters kept by apdu_handler(): requests, DCC drops,
+   rejects, aborts and a histogram of the handler execution time.
+   They are read from the proprietary Device property
+   APDU_STATISTICS_PROPERTY.  Set to 1 to enable; when 0 nothing is
+   counted and no code is added to the dispatch path. */
+#if !defined(APDU_STATISTICS)
+#define APDU_STATISTICS 0
+#endif
+#if APDU_STATISTICS
+/* proprietary Device property holding the counters */
+#if !defined(APDU_STATISTICS_PROPERTY)
+#define APDU_STATISTICS_PROPERTY 512
+#endif
+#endif
+
+/* Trend Log records are also written, compressed, to page files on a
+   mounted SPIFFS partition, so that a log holds far more records than
+   its RAM ring and keeps them across a restart.  Set to 1 to enable,
+   as the BACNET_TREND_LOG_ARCHIVE Kconfig option does; the partition
+   table must then have a spiffs partition, which the application
+   mounts at TL_ARCHIVE_PATH before Device_Init(). */
+#if !defined(TREND_LOG_ARCHIVE)
+#define TREND_LOG_ARCHIVE 0
+#endif
+#if TREND_LOG_ARCHIVE
+#if !defined(TL_ARCHIVE_PATH)
+#define TL_ARCHIVE_PATH "/spiffs"
+#endif
+#endif
+
 /* The address cache is used for binding to BACnet devices */
 /* The number of entries corresponds to the number of */
 /* devices that might respond to an I-Am on the network. */
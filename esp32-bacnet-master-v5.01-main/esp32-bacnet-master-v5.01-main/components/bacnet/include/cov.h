@@ -74,6 +74,23 @@ extern "C" {
         uint8_t invoke_id,
         BACNET_COV_DATA * data);
 
+    int cov_notify_encode_value_list(
+        uint8_t * apdu,
+        BACNET_PROPERTY_VALUE * value_list);
+    int cov_notify_value_list_len(
+        BACNET_PROPERTY_VALUE * value_list);
+    int ucov_notify_encode_apdu_values(
+        uint8_t * apdu,
+        BACNET_COV_DATA * data,
+        uint8_t * values,
+        int values_len);
+    int ccov_notify_encode_apdu_values(
+        uint8_t * apdu,
+        uint8_t invoke_id,
+        BACNET_COV_DATA * data,
+        uint8_t * values,
+        int values_len);
+
     int ccov_notify_decode_apdu(
         uint8_t * apdu,
         unsigned apdu_len,
@@ -38,6 +38,14 @@ extern "C" {
         uint8_t dataValue,
         uint16_t crcValue);
 
+#ifdef TEST
+#include "ctest.h"
+    void testCRC8(
+        Test * pTest);
+    void testCRC16(
+        Test * pTest);
+#endif
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
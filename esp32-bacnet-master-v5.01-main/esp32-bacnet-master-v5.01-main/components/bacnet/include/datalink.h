@@ -27,11 +27,30 @@
 #include "config.h"
 #include "bacdef.h"
 
-#if defined(BACDL_ETHERNET)
+#if defined(BACDL_ROUTER)
+/* the datalink with the largest header first, since it sizes MAX_MPDU:
+   BACnet/IPv6, then MS/TP */
+#if defined(BACDL_BIP6)
+#include "bip6.h"
+#include "bvlc6.h"
+#endif
+#include "dlmstp.h"
+#include "bip.h"
+#include "bvlc.h"
+#include "router.h"
+
+#define datalink_init router_init
+#define datalink_transmit_pdu router_send_pdu
+#define datalink_receive router_receive
+#define datalink_cleanup router_cleanup
+#define datalink_get_broadcast_address router_get_broadcast_address
+#define datalink_get_my_address router_get_my_address
+
+#elif defined(BACDL_ETHERNET)
 #include "ethernet.h"
 
 #define datalink_init ethernet_init
-#define datalink_send_pdu ethernet_send_pdu
+#define datalink_transmit_pdu ethernet_send_pdu
 #define datalink_receive ethernet_receive
 #define datalink_cleanup ethernet_cleanup
 #define datalink_get_broadcast_address ethernet_get_broadcast_address
@@ -41,7 +60,7 @@
 #include "arcnet.h"
 
 #define datalink_init arcnet_init
-#define datalink_send_pdu arcnet_send_pdu
+#define datalink_transmit_pdu arcnet_send_pdu
 #define datalink_receive arcnet_receive
 #define datalink_cleanup arcnet_cleanup
 #define datalink_get_broadcast_address arcnet_get_broadcast_address
@@ -51,7 +70,7 @@
 #include "dlmstp.h"
 
 #define datalink_init dlmstp_init
-#define datalink_send_pdu dlmstp_send_pdu
+#define datalink_transmit_pdu dlmstp_send_pdu
 #define datalink_receive dlmstp_receive
 #define datalink_cleanup dlmstp_cleanup
 #define datalink_get_broadcast_address dlmstp_get_broadcast_address
@@ -63,10 +82,10 @@
 
 #define datalink_init bip_init
 #if defined(BBMD_ENABLED) && BBMD_ENABLED
-#define datalink_send_pdu bvlc_send_pdu
+#define datalink_transmit_pdu bvlc_send_pdu
 #define datalink_receive bvlc_receive
 #else
-#define datalink_send_pdu bip_send_pdu
+#define datalink_transmit_pdu bip_send_pdu
 #define datalink_receive bip_receive
 #endif
 #define datalink_cleanup bip_cleanup
@@ -83,7 +102,7 @@ extern void routed_get_my_address(
 #include "bip6.h"
 #include "bvlc6.h"
 #define datalink_init bip6_init
-#define datalink_send_pdu bip6_send_pdu
+#define datalink_transmit_pdu bip6_send_pdu
 #define datalink_receive bip6_receive
 #define datalink_cleanup bip6_cleanup
 #define datalink_get_broadcast_address bip6_get_broadcast_address
@@ -125,6 +144,19 @@ extern "C" {
 }
 #endif /* __cplusplus */
 #endif
+
+/* A single datalink hands its PDUs to datalink_transmit_pdu().  With the
+   transmit queue enabled, datalink_send_pdu() queues them by priority
+   and the sending task passes them on, unless another one is sending;
+   otherwise they go straight out. */
+#if defined(datalink_transmit_pdu)
+#if DATALINK_TX_QUEUE_SIZE
+#include "dlqueue.h"
+#define datalink_send_pdu dlqueue_send_pdu
+#else
+#define datalink_send_pdu datalink_transmit_pdu
+#endif
+#endif
 /** @defgroup DataLink The BACnet Network (DataLink) Layer
  * <b>6 THE NETWORK LAYER </b><br>
  * The purpose of the BACnet network layer is to provide the means by which
@@ -142,6 +174,8 @@ extern "C" {
  * - BACDL_ARCNET   -- for Clause 8 ARCNET LAN
  * - BACDL_MSTP     -- for Clause 9 MASTER-SLAVE/TOKEN PASSING (MS/TP) LAN
  * - BACDL_BIP      -- for ANNEX J - BACnet/IP
+ * - BACDL_BIP6     -- for ANNEX U - BACnet/IPv6
+ * - BACDL_ROUTER   -- BACnet/IP and MS/TP, with a router between them
  * - BACDL_ALL      -- Unspecified for the build, so the transport can be
  *                     chosen at runtime from among these choices.
  * - Clause 10 POINT-TO-POINT (PTP) and Clause 11 EIA/CEA-709.1 ("LonTalk") LAN
@@ -138,6 +138,15 @@ typedef void (
     *object_intrinsic_reporting_function) (
     uint32_t object_instance);
 
+/** Property descriptor table of an object type.
+ * @ingroup ObjHelpers
+ * @return The table that ReadPropertyMultiple walks for the special
+ *         properties ALL, REQUIRED and OPTIONAL.
+ */
+typedef const struct property_table_t *(
+    *object_property_table_function) (
+    void);
+
 
 /** Defines the group of object helper functions for any supported Object.
  * @ingroup ObjHelpers
@@ -164,6 +173,7 @@ typedef struct object_functions {
     object_cov_function Object_COV;
     object_cov_clear_function Object_COV_Clear;
     object_intrinsic_reporting_function Object_Intrinsic_Reporting;
+    object_property_table_function Object_Property_Table;
 } object_functions_t;
 
 /* String Lengths - excluding any nul terminator */
@@ -248,9 +258,15 @@ extern "C" {
         const int **pRequired,
         const int **pOptional,
         const int **pProprietary);
+    const struct property_table_t *Device_Property_Table(
+        void);
+    void Device_Property_Cache_Invalidate(
+        void);
     void Device_Objects_Property_List(
         BACNET_OBJECT_TYPE object_type,
         struct special_property_list_t *pPropertyList);
+    const struct property_table_t *Device_Objects_Property_Table(
+        BACNET_OBJECT_TYPE object_type);
     /* functions to support COV */
     bool Device_Encode_Value_List(
         BACNET_OBJECT_TYPE object_type,
@@ -32,15 +32,20 @@
 
 /* defines specific to MS/TP */
 /* preamble+type+dest+src+len+crc8+crc16 */
-#define MAX_HEADER (2+1+1+1+2+1+2)
-#define MAX_MPDU (MAX_HEADER+MAX_PDU)
+#define DLMSTP_HEADER_MAX (2+1+1+1+2+1+2)
+#define DLMSTP_MPDU_MAX (DLMSTP_HEADER_MAX+MAX_PDU)
+/* for legacy demo applications */
+#if !defined(MAX_HEADER)
+#define MAX_HEADER DLMSTP_HEADER_MAX
+#define MAX_MPDU DLMSTP_MPDU_MAX
+#endif
 
 typedef struct dlmstp_packet {
     bool ready; /* true if ready to be sent or received */
     BACNET_ADDRESS address;     /* source address */
     uint8_t frame_type; /* type of message */
     uint16_t pdu_len;   /* packet length */
-    uint8_t pdu[MAX_MPDU];      /* packet */
+    uint8_t pdu[DLMSTP_MPDU_MAX];        /* packet */
 } DLMSTP_PACKET;
 
 #ifdef __cplusplus
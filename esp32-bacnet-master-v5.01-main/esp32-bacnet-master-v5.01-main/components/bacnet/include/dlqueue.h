@@ -0,0 +1,73 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#ifndef DLQUEUE_H
+#define DLQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "bacdef.h"
+#include "npdu.h"
+
+/** @file dlqueue.h  Priority transmit queue in front of the datalink */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    void dlqueue_init(
+        void);
+
+    int dlqueue_send_pdu(
+        BACNET_ADDRESS * dest,
+        BACNET_NPDU_DATA * npdu_data,
+        uint8_t * pdu,
+        unsigned pdu_len);
+
+    void dlqueue_task(
+        void);
+
+    void dlqueue_timer_milliseconds(
+        uint16_t milliseconds);
+
+    unsigned dlqueue_count(
+        void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup DLQueue Datalink Transmit Queue
+ * @ingroup DataLink
+ * Outgoing PDUs are held in one FIFO per BACnet network priority
+ * (clause 6.2.2) and handed to the datalink highest priority first, so a
+ * life-safety event notification is never stuck behind a long ReadRange
+ * reply.  Normal priority broadcasts are metered by a token bucket and
+ * only take their turn while credit is available, which keeps a burst of
+ * I-Am or Who-Is traffic from starving unicast replies.
+ * The task that queues a PDU sends it, and whatever else may go, unless
+ * another task is already sending; then that one sends it in its turn.
+ * The queue is never locked while the datalink sends.
+ */
+#endif
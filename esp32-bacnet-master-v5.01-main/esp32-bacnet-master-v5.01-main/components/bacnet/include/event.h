@@ -184,6 +184,14 @@ extern "C" {
         unsigned apdu_len,
         BACNET_EVENT_NOTIFICATION_DATA * data);
 
+/***************************************************
+**
+** Network priority for an event notification priority
+**
+****************************************************/
+    BACNET_MESSAGE_PRIORITY event_notify_network_priority(
+        uint8_t priority);
+
 /***************************************************
 **
 ** Sends an Unconfirmed Event Notifcation to a dest
@@ -235,6 +235,9 @@ extern "C" {
         BACNET_CONFIRMED_SERVICE_DATA * service_data);
     bool handler_cov_fsm(
         void);
+    void handler_cov_object_changed(
+        BACNET_OBJECT_TYPE object_type,
+        uint32_t object_instance);
     void handler_cov_task(
         void);
     void handler_cov_timer_seconds(
@@ -244,6 +247,13 @@ extern "C" {
     int handler_cov_encode_subscriptions(
         uint8_t * apdu,
         int max_apdu);
+#ifdef TEST
+#include "ctest.h"
+    void testCOVSubscriptions(
+        Test * pTest);
+    void testCOVThreads(
+        Test * pTest);
+#endif
 
     void handler_ucov_notification(
         uint8_t * service_request,
@@ -37,7 +37,8 @@ struct Keylist_Node {
 };
 
 typedef struct Keylist {
-    struct Keylist_Node **array;        /* array of nodes */
+    KEY *keys;  /* sorted keys, apart so that a search reads only them */
+    void **data;        /* the data of the key at the same index */
     int count;  /* number of nodes in this list - more effecient than loop */
     int size;   /* number of available nodes on this list - can grow or shrink */
 } KEYLIST_TYPE;
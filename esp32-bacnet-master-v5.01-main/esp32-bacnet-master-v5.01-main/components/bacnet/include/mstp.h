@@ -225,6 +225,17 @@ extern "C" {
     uint16_t MSTP_Get_Reply(
         volatile struct mstp_port_struct_t *mstp_port,
         unsigned timeout);      /* milliseconds to wait for a packet */
+    /* for the MS/TP state machine to put a frame on the wire */
+    void MSTP_Send_Frame(
+        volatile struct mstp_port_struct_t *mstp_port,
+        uint8_t * buffer,       /* frame to send (up to 501 bytes of data) */
+        uint16_t nbytes);       /* number of bytes of data */
+
+#ifdef TEST
+#include "ctest.h"
+    void testMSTP(
+        Test * pTest);
+#endif
 
 #ifdef __cplusplus
 }
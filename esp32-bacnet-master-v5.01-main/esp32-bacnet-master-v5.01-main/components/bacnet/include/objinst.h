@@ -0,0 +1,124 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#ifndef OBJINST_H
+#define OBJINST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @file objinst.h  Object instance table shared by the object types */
+
+/* called to grow the per-object arrays of an object type to hold
+   size objects; returns false if the memory is not available */
+typedef bool(
+    *objinst_resize_function) (
+    unsigned size);
+
+/* called to move the object at index from into index to,
+   when an object is deleted and the last object fills its place */
+typedef void (
+    *objinst_move_function) (
+    unsigned to,
+    unsigned from);
+
+typedef struct objinst_table {
+    /* object instance number of each index */
+    uint32_t *Instance;
+    /* next index + 1 in the same hash bucket, 0 ends the chain */
+    uint16_t *Next;
+    /* first index + 1 in each hash bucket, 0 if the bucket is empty */
+    uint16_t *Bucket;
+    /* number of objects in the table */
+    unsigned Count;
+    /* number of objects the arrays can hold */
+    unsigned Size;
+    /* most objects the table is allowed to hold */
+    unsigned Max;
+    objinst_resize_function Resize;
+    objinst_move_function Move;
+} OBJINST_TABLE;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    void objinst_init(
+        OBJINST_TABLE * table,
+        unsigned max,
+        objinst_resize_function resize,
+        objinst_move_function move);
+
+    void objinst_cleanup(
+        OBJINST_TABLE * table);
+
+    unsigned objinst_count(
+        OBJINST_TABLE * table);
+
+    uint32_t objinst_index_to_instance(
+        OBJINST_TABLE * table,
+        unsigned index);
+
+    unsigned objinst_instance_to_index(
+        OBJINST_TABLE * table,
+        uint32_t object_instance);
+
+    bool objinst_valid_instance(
+        OBJINST_TABLE * table,
+        uint32_t object_instance);
+
+    unsigned objinst_add(
+        OBJINST_TABLE * table,
+        uint32_t object_instance);
+
+    bool objinst_remove(
+        OBJINST_TABLE * table,
+        uint32_t object_instance);
+
+    void *objinst_realloc(
+        void *ptr,
+        size_t size);
+
+#ifdef TEST
+#include "ctest.h"
+    void testObjectInstanceTable(
+        Test * pTest);
+#endif
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup ObjInst Object Instance Table
+ * @ingroup ObjFrmwk
+ * The object types keep their objects in arrays that grow as objects are
+ * created, one array per property that is read or written often, so a
+ * walk over the Present_Value of every object touches only that array.
+ * The instance table maps between the index into those arrays and the
+ * object instance number, through a hash so that an instance lookup does
+ * not have to search the table.  Deleting an object moves the last object
+ * into its place, which keeps the arrays packed and the index range
+ * 0..count-1, as the Device object expects.
+ */
+#endif
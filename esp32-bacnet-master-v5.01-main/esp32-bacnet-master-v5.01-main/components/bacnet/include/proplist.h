@@ -43,6 +43,59 @@ struct special_property_list_t {
     struct property_list_t Proprietary;
 };
 
+/* property descriptor flags */
+#define PROPERTY_REQUIRED 0x01
+#define PROPERTY_OPTIONAL 0x02
+#define PROPERTY_PROPRIETARY 0x04
+/* the property is an array and accepts an array index */
+#define PROPERTY_ARRAY 0x08
+/* the value is static or rarely changes, and is kept pre-encoded
+   in the property cache of the table */
+#define PROPERTY_CACHED 0x10
+
+/* encodes the property in rpdata for the object at object_index,
+   returning the APDU length, or BACNET_STATUS_ERROR or
+   BACNET_STATUS_ABORT with the error set in rpdata */
+typedef int (
+    *property_read_function) (
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index);
+
+struct property_descr_t {
+    BACNET_PROPERTY_ID property;
+    uint8_t flags;
+    property_read_function read;
+};
+
+/* where the encoded value of one table entry is kept, len 0 if not */
+struct property_cache_slot_t {
+    uint16_t offset;
+    uint16_t len;
+};
+
+/* pre-encoded values of the PROPERTY_CACHED entries of a table, back to
+   back in data.  A cache holds the values of one object, so it is for
+   the tables of single instance object types such as the Device. */
+struct property_cache_t {
+    uint8_t *data;
+    unsigned size;
+    unsigned used;
+    struct property_cache_slot_t *slot; /* one per table entry */
+};
+
+/* the properties of an object type, in the order that ReadPropertyMultiple
+   returns them: the required ones first, then optional, then proprietary */
+struct property_table_t {
+    const struct property_descr_t *descr;
+    unsigned count;
+    struct property_cache_t *cache;     /* or NULL */
+};
+
+#define PROPERTY_TABLE(descr) \
+    { (descr), sizeof(descr) / sizeof((descr)[0]), NULL }
+#define PROPERTY_TABLE_CACHED(descr, cache) \
+    { (descr), sizeof(descr) / sizeof((descr)[0]), (cache) }
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -69,6 +122,28 @@ extern "C" {
         const int *pListOptional,
         const int *pListProprietary);
 
+    const struct property_descr_t *property_table_find(
+        const struct property_table_t *table,
+        BACNET_PROPERTY_ID property);
+    int property_table_read(
+        const struct property_table_t *table,
+        BACNET_READ_PROPERTY_DATA * rpdata,
+        unsigned object_index);
+    unsigned property_table_value_len(
+        const struct property_table_t *table,
+        BACNET_PROPERTY_ID property,
+        uint32_t array_index);
+    bool property_table_special(
+        const struct property_descr_t *descr,
+        BACNET_PROPERTY_ID special_property);
+    void property_cache_invalidate(
+        const struct property_table_t *table);
+    void property_table_lists(
+        const struct property_table_t *table,
+        int *pRequired,
+        int *pOptional,
+        int *pProprietary);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
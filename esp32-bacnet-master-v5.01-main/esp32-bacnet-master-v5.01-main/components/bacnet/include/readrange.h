@@ -38,7 +38,8 @@ extern "C" {
         BACNET_PROPERTY_ID object_property;
         uint32_t array_index;
         uint8_t *application_data;
-        int application_data_len;
+        int application_data_len;       /**< On entry to the handler, room
+                                           for the whole ACK. */
         BACNET_BIT_STRING ResultFlags;  /**<  FIRST_ITEM, LAST_ITEM, MORE_ITEMS. */
         int RequestType;/**< Index, sequence or time based request. */
         int Overhead;    /**< How much space the baggage takes in the response. */
@@ -101,7 +102,8 @@ extern "C" {
 
 /** Define pointer to function type for handling ReadRange request.
    This function will take the following parameters:
-  - 1. A pointer to a buffer of at least MAX_APDU bytes to build the response in.
+  - 1. A pointer to a buffer to build the response in; the items must fit in
+      application_data_len less the Overhead.
   - 2. A pointer to a BACNET_READ_RANGE_DATA structure with all the request
       information in it. The function is responsible for applying the request
       to the property in question and returning the response. */
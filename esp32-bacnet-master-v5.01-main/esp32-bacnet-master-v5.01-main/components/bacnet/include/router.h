@@ -0,0 +1,177 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+#include "bacdef.h"
+#include "npdu.h"
+
+/* ports of the router; the device itself is on the first */
+#ifndef ROUTER_PORTS_MAX
+#if defined(BACDL_ROUTER) && defined(BACDL_BIP6)
+#define ROUTER_PORTS_MAX 3
+#else
+#define ROUTER_PORTS_MAX 2
+#endif
+#endif
+/* networks reached through other routers */
+#ifndef ROUTER_TABLE_SIZE
+#define ROUTER_TABLE_SIZE 16
+#endif
+/* packets waiting to go out of each port */
+#ifndef ROUTER_QUEUE_SIZE
+#define ROUTER_QUEUE_SIZE 4
+#endif
+/* milliseconds each port is waited on for a packet */
+#ifndef ROUTER_POLL_MS
+#define ROUTER_POLL_MS 5
+#endif
+/* each port receives in a task of its own; without them,
+   router_receive() waits on the ports in turn */
+#ifndef ROUTER_RX_TASKS
+#if defined(BACDL_ROUTER)
+#define ROUTER_RX_TASKS 1
+#else
+#define ROUTER_RX_TASKS 0
+#endif
+#endif
+/* packets each port may have received before the router takes them */
+#ifndef ROUTER_RX_QUEUE_SIZE
+#define ROUTER_RX_QUEUE_SIZE 2
+#endif
+
+/* a forwarded NPCI may lose DNET but gain SNET, SLEN and SADR, so the
+   packets keep room for those in front of the NPDU received */
+#define ROUTER_HEADROOM (2 + 1 + MAX_MAC_LEN)
+
+/** One port of the router: a datalink and its network number. */
+typedef struct router_link {
+    uint16_t net;
+    int (
+        *send_pdu) (
+        BACNET_ADDRESS * dest,
+        BACNET_NPDU_DATA * npdu_data,
+        uint8_t * pdu,
+        unsigned pdu_len);
+    uint16_t(
+        *receive) (
+        BACNET_ADDRESS * src,
+        uint8_t * pdu,
+        uint16_t max_pdu,
+        unsigned timeout);
+    void (
+        *get_broadcast_address) (
+        BACNET_ADDRESS * dest);
+    void (
+        *get_my_address) (
+        BACNET_ADDRESS * my_address);
+    /* true while the datalink takes no more; NULL if it never refuses */
+    bool(
+        *send_busy) (
+        void);
+} ROUTER_LINK;
+
+/** A network reached through another router. */
+typedef struct router_route {
+    /* 0 if the entry is unused */
+    uint16_t dnet;
+    uint8_t port;
+    /* the router said Router-Busy-To-Network */
+    bool busy;
+    /* the MAC of the router on that port */
+    BACNET_ADDRESS next_hop;
+} ROUTER_ROUTE;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    bool router_init(
+        char *ifname);
+    void router_cleanup(
+        void);
+
+    void router_ports_init(
+        void);
+    int router_port_add(
+        ROUTER_LINK * link);
+    void router_announce(
+        void);
+
+    int router_send_pdu(
+        BACNET_ADDRESS * dest,
+        BACNET_NPDU_DATA * npdu_data,
+        uint8_t * pdu,
+        unsigned pdu_len);
+    uint16_t router_receive(
+        BACNET_ADDRESS * src,
+        uint8_t * pdu,
+        uint16_t max_pdu,
+        unsigned timeout);
+
+    void router_get_broadcast_address(
+        BACNET_ADDRESS * dest);
+    void router_get_my_address(
+        BACNET_ADDRESS * my_address);
+
+    ROUTER_ROUTE *router_route_find(
+        uint16_t dnet);
+    unsigned router_queue_count(
+        unsigned port);
+
+#ifdef TEST
+#include "ctest.h"
+    void testRouter(
+        Test * pTest);
+#endif
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup Router BACnet Router
+ * @ingroup DataLink
+ * Routes NPDUs between the ports of the device (clause 6.5): the
+ * BACnet/IP network, where the device itself is, the MS/TP network
+ * on the RS-485 port and, with BACDL_BIP6, a BACnet/IPv6 network.
+ * The router answers Who-Is-Router-To-Network,
+ * learns the networks behind other routers from I-Am-Router-To-Network
+ * and from the SNET of what it receives, and rejects what it cannot
+ * route.  A forwarded NPDU is received with room in front of it, so that
+ * its DNET/DADR and SNET/SADR are rewritten where it lies: only the
+ * header moves, never the APDU.  It then waits in the queue of the port
+ * it leaves by, so that a slow MS/TP network only ever holds up its own
+ * traffic.  Each port receives in a task of its own, which may have
+ * ROUTER_RX_QUEUE_SIZE packets waiting in the one queue the router takes
+ * them from, so that a port that floods or blocks never holds up what
+ * the others receive.  The router runs in the task that calls
+ * router_receive(), which hands the device the NPDUs that are for it;
+ * other tasks may send through it at the same time, as the ports,
+ * queues and routes are only touched with a lock held, and never
+ * while waiting on a port.
+ */
+#endif
@@ -44,6 +44,14 @@ typedef struct BACnet_RPM_Data {
     BACNET_ERROR_CODE error_code;
 } BACNET_RPM_DATA;
 
+/*
+ * Bounded cursor for encoding an RPM ACK in place, straight into the
+ * reply buffer.  A mark taken before a part is encoded lets the part
+ * be rolled back when it is replaced by an error or does not fit.
+ * It is a BACAPP_CURSOR, so values are also encoded with bacapp_cursor_*.
+ */
+typedef BACAPP_CURSOR RPM_ACK_CURSOR;
+
 struct BACnet_Read_Access_Data;
 typedef struct BACnet_Read_Access_Data {
     BACNET_OBJECT_TYPE object_type;
@@ -152,6 +160,43 @@ extern "C" {
     int rpm_ack_encode_apdu_object_end(
         uint8_t * apdu);
 
+/* RPM Ack encoded in place - each returns false if the part does not fit */
+    void rpm_ack_cursor_init(
+        RPM_ACK_CURSOR * cursor,
+        uint8_t * apdu,
+        unsigned size,
+        unsigned len);
+    unsigned rpm_ack_cursor_mark(
+        RPM_ACK_CURSOR * cursor);
+    void rpm_ack_cursor_rollback(
+        RPM_ACK_CURSOR * cursor,
+        unsigned mark);
+    unsigned rpm_ack_cursor_room(
+        RPM_ACK_CURSOR * cursor);
+    bool rpm_ack_cursor_object_begin(
+        RPM_ACK_CURSOR * cursor,
+        BACNET_RPM_DATA * rpmdata);
+    bool rpm_ack_cursor_object_property(
+        RPM_ACK_CURSOR * cursor,
+        BACNET_PROPERTY_ID object_property,
+        uint32_t array_index);
+    uint8_t *rpm_ack_cursor_value_begin(
+        RPM_ACK_CURSOR * cursor,
+        unsigned *max_len);
+    bool rpm_ack_cursor_value_end(
+        RPM_ACK_CURSOR * cursor,
+        unsigned value_len);
+    bool rpm_ack_cursor_value(
+        RPM_ACK_CURSOR * cursor,
+        uint8_t * application_data,
+        unsigned application_data_len);
+    bool rpm_ack_cursor_object_property_error(
+        RPM_ACK_CURSOR * cursor,
+        BACNET_ERROR_CLASS error_class,
+        BACNET_ERROR_CODE error_code);
+    bool rpm_ack_cursor_object_end(
+        RPM_ACK_CURSOR * cursor);
+
     int rpm_ack_decode_object_id(
         uint8_t * apdu,
         unsigned apdu_len,
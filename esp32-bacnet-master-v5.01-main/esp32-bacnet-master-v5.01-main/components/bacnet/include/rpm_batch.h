@@ -0,0 +1,128 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#ifndef RPM_BATCH_H
+#define RPM_BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bacdef.h"
+#include "bacenum.h"
+#include "apdu.h"
+#include "rp.h"
+
+/* number of reads that can be queued or waiting for an ACK */
+#ifndef MAX_RPM_BATCH_READS
+#define MAX_RPM_BATCH_READS 32
+#endif
+
+/** Called once for every queued read.
+ * On success rp_data->application_data holds the encoded value;
+ * on failure it is NULL and rp_data->error_class and error_code
+ * tell why - ERROR_CLASS_COMMUNICATION when the request itself failed.
+ *
+ * @param device_id [in] the device that was read
+ * @param rp_data [in] the object, property and result
+ * @param context [in] the pointer given to rpm_batch_read()
+ */
+typedef void (
+    *rpm_batch_callback_function) (
+    uint32_t device_id,
+    BACNET_READ_PROPERTY_DATA * rp_data,
+    void *context);
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    void rpm_batch_init(
+        void);
+
+    bool rpm_batch_read(
+        uint32_t device_id,
+        BACNET_OBJECT_TYPE object_type,
+        uint32_t object_instance,
+        BACNET_PROPERTY_ID object_property,
+        uint32_t array_index,
+        rpm_batch_callback_function callback,
+        void *context);
+
+    unsigned rpm_batch_send(
+        void);
+
+    void rpm_batch_task(
+        void);
+
+    unsigned rpm_batch_pending_count(
+        void);
+
+    void rpm_batch_ack_handler(
+        uint8_t * service_request,
+        uint16_t service_len,
+        BACNET_ADDRESS * src,
+        BACNET_CONFIRMED_SERVICE_ACK_DATA * service_data);
+
+    void rpm_batch_error_handler(
+        BACNET_ADDRESS * src,
+        uint8_t invoke_id,
+        BACNET_ERROR_CLASS error_class,
+        BACNET_ERROR_CODE error_code);
+
+    void rpm_batch_reject_handler(
+        BACNET_ADDRESS * src,
+        uint8_t invoke_id,
+        uint8_t reject_reason);
+
+    void rpm_batch_abort_handler(
+        BACNET_ADDRESS * src,
+        uint8_t invoke_id,
+        uint8_t abort_reason,
+        bool server);
+
+#ifdef TEST
+#include "ctest.h"
+    void testRPMBatch(
+        Test * pTest);
+    void testRPMBatchSplit(
+        Test * pTest);
+    void testRPMBatchErrors(
+        Test * pTest);
+#endif
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup DSRPMB Data Sharing - Batched ReadPropertyMultiple client
+ * @ingroup DataShare
+ * Reads queued with rpm_batch_read() are grouped by device and by object,
+ * and rpm_batch_send() packs them into as few ReadPropertyMultiple
+ * requests as fit in each device's max APDU, going by what each property
+ * is expected to cost in the ACK.  The ACKs are taken apart again and
+ * every read gets its own callback; an Error, Reject, Abort or timeout
+ * fails the reads of its request, except an Abort saying the ACK did not
+ * fit, which sends each of them again on its own.  The reads, the ACKs
+ * and rpm_batch_task() all belong to the server task, which runs the
+ * TSM timer.
+ */
+#endif
@@ -0,0 +1,74 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#ifndef RS485_H
+#define RS485_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mstp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    void RS485_Initialize(
+        void);
+    void RS485_Cleanup(
+        void);
+
+    bool RS485_Set_Baud_Rate(
+        uint32_t baud);
+    uint32_t RS485_Get_Baud_Rate(
+        void);
+
+    void RS485_Send_Frame(
+        volatile struct mstp_port_struct_t *mstp_port,
+        uint8_t * buffer,
+        uint16_t nbytes);
+    void RS485_Check_UART_Data(
+        volatile struct mstp_port_struct_t *mstp_port);
+    bool RS485_Data_Pending(
+        void);
+    void RS485_Wait_Event(
+        void);
+
+    uint32_t RS485_Silence_Milliseconds(
+        void *pArg);
+    void RS485_Silence_Reset(
+        void *pArg);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup RS485 RS-485 Port
+ * @ingroup DLMSTP
+ * The EIA-485 line of the MS/TP datalink, on one of the ESP32 UARTs in
+ * its RS-485 half duplex mode, which drives the transceiver enable from
+ * RTS.  An interrupt moves the received octets into a FIFO and stamps
+ * the time of the last one, from which the silence timer is read; a
+ * general purpose timer ticks every millisecond, so that the MS/TP task
+ * sees Tslot, Tusage_timeout and the other timeouts on time.
+ */
+#endif
@@ -0,0 +1,148 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#ifndef TLARCHIVE_H
+#define TLARCHIVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+#include "trendlog.h"
+
+/* bytes in a page, the unit written to flash */
+#ifndef TL_ARCHIVE_PAGE_SIZE
+#define TL_ARCHIVE_PAGE_SIZE 1024
+#endif
+/* pages in the file of each log; the oldest is overwritten */
+#ifndef TL_ARCHIVE_PAGES
+#define TL_ARCHIVE_PAGES 128
+#endif
+/* sealed pages waiting for the archive task */
+#ifndef TL_ARCHIVE_QUEUE
+#define TL_ARCHIVE_QUEUE 4
+#endif
+
+/* magic, count, length, checksum, page number, first sequence,
+   and the first record in full */
+#define TL_PAGE_HEADER 28
+/* the most records a page can hold: each takes two bytes or more */
+#define TL_PAGE_RECORDS_MAX (((TL_ARCHIVE_PAGE_SIZE - TL_PAGE_HEADER) / 2) + 1)
+
+/* what the archive knows about a page without reading it */
+typedef struct tl_page_index {
+    uint32_t Page_Number;
+    uint32_t First_Sequence;
+    uint32_t First_Time;
+    uint16_t Count;
+    bool Valid;
+    /* the queue job that writes it; until that is done
+       the page is read from the queue instead of the flash */
+    uint32_t Job;
+} TL_PAGE_INDEX;
+
+typedef struct tl_archive {
+    char Filename[32];
+    /* by page number modulo TL_ARCHIVE_PAGES */
+    TL_PAGE_INDEX *Index;
+    /* the page being filled, which gets the next page number */
+    uint8_t *Open;
+    uint32_t Next_Page;
+    uint16_t Open_Length;
+    uint16_t Open_Count;
+    TL_RECORD Open_Last;
+    uint32_t Newest_Sequence;
+    /* the file is to be erased before the next page is written */
+    bool Erase_Pending;
+    /* pages lost because the queue was full */
+    uint32_t Overruns;
+} TL_ARCHIVE;
+
+/* reads the records of an archive one after the other */
+typedef struct tl_cursor {
+    TL_ARCHIVE *Archive;
+    const uint8_t *Page;
+    uint32_t Page_Number;
+    uint16_t Offset;
+    /* records of the page after the current one */
+    uint16_t Remaining;
+    uint32_t Sequence;
+    TL_RECORD Record;
+} TL_CURSOR;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    TL_ARCHIVE *tl_archive_open(
+        unsigned log_index);
+    void tl_archive_append(
+        TL_ARCHIVE * archive,
+        uint32_t sequence,
+        TL_RECORD * record);
+    void tl_archive_flush(
+        TL_ARCHIVE * archive);
+    void tl_archive_purge(
+        TL_ARCHIVE * archive);
+    bool tl_archive_full(
+        TL_ARCHIVE * archive);
+
+    uint32_t tl_archive_oldest(
+        TL_ARCHIVE * archive);
+    uint32_t tl_archive_newest(
+        TL_ARCHIVE * archive);
+    uint32_t tl_archive_find_time(
+        TL_ARCHIVE * archive,
+        uint32_t seconds);
+    bool tl_archive_seek(
+        TL_ARCHIVE * archive,
+        TL_CURSOR * cursor,
+        uint32_t sequence);
+    bool tl_archive_next(
+        TL_CURSOR * cursor);
+
+    bool tl_archive_maintenance(
+        void);
+
+#ifdef TEST
+#include "ctest.h"
+    void testTLArchive(
+        Test * pTest);
+#endif
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup TLArchive Trend Log Archive
+ * @ingroup TrendLog
+ * Every record a Trend Log takes is also packed into a page: the first
+ * record in full, each one after it as the zigzag varint deltas of its
+ * time and datum from the one before, so that a one-minute sample of a
+ * slowly moving value takes two to four bytes.  A full page is sealed
+ * and queued; tl_archive_maintenance(), run by a task of its own,
+ * writes it into the next slot of the log's page file, overwriting the
+ * oldest page, and erases the file when the log is purged.  The server
+ * task thus never waits on the flash, except to read the pages that a
+ * ReadRange asks for, which it decodes one record at a time.
+ */
+#endif
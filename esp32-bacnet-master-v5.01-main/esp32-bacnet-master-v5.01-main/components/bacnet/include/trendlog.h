@@ -0,0 +1,170 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#ifndef TRENDLOG_H
+#define TRENDLOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bacdef.h"
+#include "bacerror.h"
+#include "datetime.h"
+#include "bacdevobjpropref.h"
+#include "readrange.h"
+#include "wp.h"
+#include "rp.h"
+#include "proplist.h"
+
+#ifndef MAX_TREND_LOGS
+#define MAX_TREND_LOGS 4
+#endif
+
+/* the kinds of log datum a record holds */
+#define TL_TYPE_STATUS   0
+#define TL_TYPE_BOOL     1
+#define TL_TYPE_REAL     2
+#define TL_TYPE_ENUM     3
+#define TL_TYPE_UNSIGN   4
+#define TL_TYPE_SIGN     5
+#define TL_TYPE_NULL     7
+#define TL_TYPE_ERROR    8
+
+/* TL_RECORD Status: the Status_Flags of the logged object in
+   the low four bits, and whether they were read at all */
+#define TL_STATUS_FLAGS_MASK  0x0F
+#define TL_STATUS_FLAGS_VALID 0x80
+
+/* record times count the seconds from the start of this year */
+#define TL_EPOCH_YEAR 2000
+
+/* largest and smallest encoding of one BACnetLogRecord */
+#define TL_MAX_ENC 40
+#define TL_MIN_ENC 15
+
+/** One entry of the log buffer - 12 bytes, so that a day of
+ *  one-minute samples takes 17 KB of the ring. */
+typedef struct tl_record {
+    /* seconds since TL_EPOCH_YEAR began, local time */
+    uint32_t Time;
+    union {
+        float Real;
+        bool Boolean;
+        uint32_t Enumerated;
+        uint32_t Unsigned;
+        int32_t Signed;
+        /* log-status bits, or error class << 16 | error code */
+        uint32_t Bits;
+    } Datum;
+    uint8_t Type;
+    uint8_t Status;
+} TL_RECORD;
+
+typedef struct trend_log_descr {
+    bool Enable;
+    bool Stop_When_Full;
+    /* seconds between samples */
+    uint32_t Log_Interval;
+    /* seconds until the next sample */
+    uint32_t Remaining;
+    BACNET_DEVICE_OBJECT_PROPERTY_REFERENCE Source;
+    /* the ring: Buffer_Size records, of which Record_Count are used,
+       the oldest at Record_Start */
+    TL_RECORD *Buffer;
+    uint32_t Buffer_Size;
+    uint32_t Record_Count;
+    uint32_t Record_Start;
+    /* sequence number of the newest record, 0 before the first */
+    uint32_t Total_Record_Count;
+    /* the older records, on flash; NULL without TREND_LOG_ARCHIVE */
+    struct tl_archive *Archive;
+} TREND_LOG_DESCR;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    void Trend_Log_Property_Lists(
+        const int **pRequired,
+        const int **pOptional,
+        const int **pProprietary);
+    const struct property_table_t *Trend_Log_Property_Table(
+        void);
+    bool Trend_Log_Valid_Instance(
+        uint32_t object_instance);
+    unsigned Trend_Log_Count(
+        void);
+    uint32_t Trend_Log_Index_To_Instance(
+        unsigned index);
+    unsigned Trend_Log_Instance_To_Index(
+        uint32_t instance);
+    bool Trend_Log_Object_Name(
+        uint32_t object_instance,
+        BACNET_CHARACTER_STRING * object_name);
+
+    int Trend_Log_Read_Property(
+        BACNET_READ_PROPERTY_DATA * rpdata);
+    bool Trend_Log_Write_Property(
+        BACNET_WRITE_PROPERTY_DATA * wp_data);
+
+    bool Trend_Log_Source_Set(
+        uint32_t object_instance,
+        BACNET_OBJECT_TYPE object_type,
+        uint32_t source_instance,
+        BACNET_PROPERTY_ID object_property,
+        uint32_t log_interval);
+    bool Trend_Log_Enable_Set(
+        uint32_t object_instance,
+        bool enable);
+
+    void Trend_Log_Timer(
+        uint16_t seconds);
+
+    bool Trend_Log_RR_Info(
+        BACNET_READ_RANGE_DATA * pRequest,      /* Info on the request */
+        RR_PROP_INFO * pInfo);  /* Where to write the response to */
+    int rr_trend_log_encode(
+        uint8_t * apdu,
+        BACNET_READ_RANGE_DATA * pRequest);
+
+    void Trend_Log_Init(
+        void);
+
+#ifdef TEST
+#include "ctest.h"
+    void testTrendLog(
+        Test * pTest);
+#endif
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup TrendLog Trend Log Object
+ * @ingroup Trend
+ * The Trend Log object samples one property of a local object every
+ * Log_Interval and keeps the samples in a ring of Buffer_Size records,
+ * in PSRAM where the target has it.  The ring is read with ReadRange:
+ * by position and by sequence number in constant time, and by time
+ * with a binary search, since the records are kept in time order.
+ */
+#endif
@@ -29,6 +29,7 @@
 #include <stddef.h>
 #include "bacdef.h"
 #include "npdu.h"
+#include "apdu.h"
 
 /* note: TSM functionality is optional - only needed if we are
    doing client requests */
@@ -40,30 +41,56 @@ typedef enum {
     TSM_STATE_AWAIT_CONFIRMATION,
     TSM_STATE_AWAIT_RESPONSE,
     TSM_STATE_SEGMENTED_REQUEST,
-    TSM_STATE_SEGMENTED_CONFIRMATION
+    TSM_STATE_SEGMENTED_CONFIRMATION,
+    TSM_STATE_SEGMENTED_RESPONSE
 } BACNET_TSM_STATE;
 
 /* 5.4.1 Variables And Parameters */
-/* The following variables are defined for each instance of  */
-/* Transaction State Machine: */
-typedef struct BACnet_TSM_Data {
-    /* used to count APDU retries */
-    uint8_t RetryCount;
+#if BACNET_SEGMENTATION_ENABLED
+/* The segmentation variables are shared by the requesting and the
+   responding state machines, so they are kept in their own structure. */
+typedef struct BACnet_TSM_Segment_Data {
     /* used to count segment retries */
-    /*uint8_t SegmentRetryCount;  */
+    uint8_t SegmentRetryCount;
     /* used to control APDU retries and the acceptance of server replies */
-    /*bool SentAllSegments;  */
+    bool SentAllSegments;
     /* stores the sequence number of the last segment received in order */
-    /*uint8_t LastSequenceNumber; */
+    uint8_t LastSequenceNumber;
     /* stores the sequence number of the first segment of */
     /* a sequence of segments that fill a window */
-    /*uint8_t InitialSequenceNumber; */
+    uint8_t InitialSequenceNumber;
     /* stores the current window size */
-    /*uint8_t ActualWindowSize; */
+    uint8_t ActualWindowSize;
     /* stores the window size proposed by the segment sender */
-    /*uint8_t ProposedWindowSize;  */
+    uint8_t ProposedWindowSize;
     /*  used to perform timeout on PDU segments */
-    /*uint8_t SegmentTimer; */
+    /* in milliseconds */
+    uint16_t SegmentTimer;
+    /* service choice carried by every segment */
+    uint8_t service_choice;
+    /* number of segments when transmitting */
+    uint8_t segment_count;
+    /* octets of service data carried in each segment when transmitting */
+    uint16_t segment_size;
+    /* pooled buffer holding the whole service data */
+    uint8_t *buffer;
+    /* octets of service data received, or to be sent */
+    uint32_t buffer_len;
+    /* the timer resends the window from this segment on,
+       once it has given up the TSM lock */
+    bool ResendWindow;
+    uint8_t ResendSequenceNumber;
+    /* the window was sent again for a negative SegmentACK,
+       and is not sent again for another until a new one */
+    bool WindowResent;
+} BACNET_TSM_SEGMENT_DATA;
+#endif
+
+/* The following variables are defined for each instance of  */
+/* Transaction State Machine: */
+typedef struct BACnet_TSM_Data {
+    /* used to count APDU retries */
+    uint8_t RetryCount;
     /* used to perform timeout on Confirmed Requests */
     /* in milliseconds */
     uint16_t RequestTimer;
@@ -78,8 +105,33 @@ typedef struct BACnet_TSM_Data {
     /* copy of the APDU, should we need to send it again */
     uint8_t apdu[MAX_PDU];
     unsigned apdu_len;
+    /* the timer sends it again once it has given up the TSM lock */
+    bool Retransmit;
+#if BACNET_SEGMENTATION_ENABLED
+    /* reassembly of a segmented ComplexACK */
+    BACNET_TSM_SEGMENT_DATA segment;
+#endif
 } BACNET_TSM_DATA;
 
+#if BACNET_SEGMENTATION_ENABLED
+/* 5.4.5 Responding BACnet-user: one of these is used for each
+   segmented request we are receiving or segmented response we are
+   sending.  It is keyed by the peer address and the peer invoke ID. */
+typedef struct BACnet_TSM_Peer_Data {
+    /* the peer invoke id - only valid when state is not IDLE */
+    uint8_t InvokeID;
+    /* state that the TSM is in */
+    BACNET_TSM_STATE state;
+    /* the address of the client */
+    BACNET_ADDRESS dest;
+    /* the network layer info for the reply */
+    BACNET_NPDU_DATA npdu_data;
+    /* the header of the original request */
+    BACNET_CONFIRMED_SERVICE_DATA service_data;
+    BACNET_TSM_SEGMENT_DATA segment;
+} BACNET_TSM_PEER_DATA;
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -118,6 +170,52 @@ extern "C" {
     bool tsm_invoke_id_failed(
         uint8_t invokeID);
 
+#if BACNET_SEGMENTATION_ENABLED
+/* pooled buffers of MAX_SEGMENTED_APDU octets */
+    uint8_t *tsm_segment_buffer_alloc(
+        uint32_t * buffer_size);
+    void tsm_segment_buffer_free(
+        uint8_t * buffer);
+/* send a ComplexACK, segmenting it if it doesn't fit the client */
+    int tsm_set_complexack_transaction(
+        BACNET_ADDRESS * dest,
+        BACNET_NPDU_DATA * npdu_data,
+        BACNET_CONFIRMED_SERVICE_DATA * service_data,
+        uint8_t * apdu,
+        uint32_t apdu_len);
+/* returns true when the last segment of a request has been received */
+    bool tsm_segmented_request_received(
+        BACNET_ADDRESS * src,
+        BACNET_CONFIRMED_SERVICE_DATA * service_data,
+        uint8_t service_choice,
+        uint8_t * service_request,
+        uint16_t service_request_len,
+        uint8_t ** request,
+        uint32_t * request_len);
+/* call when the handler of a reassembled request has returned */
+    void tsm_segmented_request_done(
+        BACNET_ADDRESS * src,
+        uint8_t invokeID);
+/* returns true when the last segment of a ComplexACK has been received */
+    bool tsm_segmented_complexack_received(
+        BACNET_ADDRESS * src,
+        BACNET_CONFIRMED_SERVICE_ACK_DATA * service_data,
+        uint8_t service_choice,
+        uint8_t * service_request,
+        uint16_t service_request_len,
+        uint8_t ** ack,
+        uint32_t * ack_len);
+    void tsm_segmentack_received(
+        BACNET_ADDRESS * src,
+        uint8_t invokeID,
+        uint8_t sequence_number,
+        uint8_t actual_window_size,
+        bool negative_ack);
+    void tsm_abort_received(
+        BACNET_ADDRESS * src,
+        uint8_t invokeID);
+#endif
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -30,6 +30,44 @@
 #include "config.h"
 #include "datalink.h"
 
-extern uint8_t Handler_Transmit_Buffer[MAX_PDU];
+/* one for each task that encodes into Handler_Transmit_Buffer: the
+   startup task, until it releases its buffer, the server task and the
+   client task */
+#ifndef TXBUF_POOL_SIZE
+#define TXBUF_POOL_SIZE 3
+#endif
+
+typedef uint8_t TXBUF[MAX_PDU];
+
+/* the transmit buffer of the calling task */
+#define Handler_Transmit_Buffer (*txbuf_get())
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    TXBUF *txbuf_get(
+        void);
+    void txbuf_release(
+        void);
+
+#ifdef TEST
+#include "ctest.h"
+    void testTxBuf(
+        Test * pTest);
+    void testTxBufEmpty(
+        Test * pTest);
+#endif
 
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup TxBuf Transmit Buffers
+ * @ingroup BACLock
+ * Each task that sends gets a transmit buffer of its own from a pool of
+ * TXBUF_POOL_SIZE the first time it uses Handler_Transmit_Buffer, and
+ * keeps it until it calls txbuf_release(), so that the server and the
+ * client task can encode at the same time.  A task that finds the pool
+ * empty logs it and aborts: a new task that sends needs a buffer more.
+ */
 #endif
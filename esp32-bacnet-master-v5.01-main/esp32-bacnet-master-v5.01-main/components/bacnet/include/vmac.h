@@ -11,6 +11,10 @@
 
 /* define the max MAC as big as IPv6 + port number */
 #define VMAC_MAC_MAX 18
+/* nodes whose address is known; a power of two */
+#ifndef VMAC_TABLE_SIZE
+#define VMAC_TABLE_SIZE 64
+#endif
 /**
 * VMAC data structure
 *
@@ -49,4 +53,10 @@ extern "C" {
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
+/** @defgroup VMAC Virtual MAC Addresses
+ * @ingroup DLBIP6
+ * The B/IPv6 address of each node is found by the device instance it
+ * uses as its VMAC, in an open-addressed hash table of VMAC_TABLE_SIZE
+ * slots, so that sending to a node does not search the table.
+ */
 #endif
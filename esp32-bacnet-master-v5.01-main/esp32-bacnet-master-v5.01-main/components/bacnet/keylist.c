@@ -39,8 +39,12 @@
 /* It stores a pointer to data, which you must */
 /* malloc and free on your own, or just use */
 /* static data */
+/* The keys are kept in an array of their own, so that */
+/* the binary search only touches the keys, and both */
+/* arrays double or halve in size as the list changes. */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "keylist.h"    /* check for valid prototypes */
 
@@ -52,17 +56,13 @@
 #define TRUE 1
 #endif
 
+/* minimum number of nodes to allocate memory for */
+#define KEYLIST_CHUNK 8
+
 /******************************************************************** */
 /* Generic node routines */
 /******************************************************************** */
 
-/* grab memory for a node */
-static struct Keylist_Node *NodeCreate(
-    void)
-{
-    return calloc(1, sizeof(struct Keylist_Node));
-}
-
 /* grab memory for a list */
 static struct Keylist *KeylistCreate(
     void)
@@ -77,36 +77,39 @@ static int CheckArraySize(
     OS_Keylist list)
 {
     int new_size = 0;   /* set it up so that no size change is the default */
-    const int chunk = 8;        /* minimum number of nodes to allocate memory for */
-    struct Keylist_Node **new_array;    /* new array of nodes, if needed */
-    int i;      /* counter */
+    KEY *new_keys;      /* new array of keys, if needed */
+    void **new_data;    /* new array of data, if needed */
+
     if (!list)
         return FALSE;
 
-    /* indicates the need for more memory allocation */
+    /* indicates the need for more memory allocation: doubling the
+       size keeps the cost of copying to a constant per addition */
     if (list->count == list->size)
-        new_size = list->size + chunk;
-
-    /* allow for shrinking memory */
-    else if ((list->size > chunk) && (list->count < (list->size - chunk)))
-        new_size = list->size - chunk;
-    if (new_size) {
-
-        /* Allocate more room for node pointer array */
-        new_array = calloc((size_t) new_size, sizeof(new_array));
-
-        /* See if we got the memory we wanted */
-        if (!new_array)
+        new_size = list->size ? (list->size * 2) : KEYLIST_CHUNK;
+
+    /* allow for shrinking memory, but not so soon that an addition
+       right after a deletion grows it again */
+    else if ((list->size > KEYLIST_CHUNK) && (list->count < (list->size / 4)))
+        new_size = list->size / 2;
+    if (new_size > list->size) {
+        new_keys = realloc(list->keys, (size_t) new_size * sizeof(KEY));
+        if (!new_keys)
             return FALSE;
-
-        /* copy the nodes from the old array to the new array */
-        if (list->array) {
-            for (i = 0; i < list->count; i++) {
-                new_array[i] = list->array[i];
-            }
-            free(list->array);
-        }
-        list->array = new_array;
+        list->keys = new_keys;
+        new_data = realloc(list->data, (size_t) new_size * sizeof(void *));
+        if (!new_data)
+            return FALSE;
+        list->data = new_data;
+        list->size = new_size;
+    } else if (new_size) {
+        /* an array that cannot shrink stays as big as it was */
+        new_keys = realloc(list->keys, (size_t) new_size * sizeof(KEY));
+        if (new_keys)
+            list->keys = new_keys;
+        new_data = realloc(list->data, (size_t) new_size * sizeof(void *));
+        if (new_data)
+            list->data = new_data;
         list->size = new_size;
     }
     return TRUE;
@@ -124,13 +127,12 @@ static int FindIndex(
     KEY key,
     int *pIndex)
 {
-    struct Keylist_Node *node;  /* holds the new node */
     int left = 0;       /* the left branch of tree, beginning of list */
     int right = 0;      /* the right branch on the tree, end of list */
     int index = 0;      /* our current search place in the array */
     KEY current_key = 0;        /* place holder for current node key */
     int status = FALSE; /* return value */
-    if (!list || !list->array || !list->count) {
+    if (!list || !list->keys || !list->count) {
         *pIndex = 0;
         return (FALSE);
     }
@@ -140,10 +142,7 @@ static int FindIndex(
 
         /* A binary search */
         index = (left + right) / 2;
-        node = list->array[index];
-        if (!node)
-            break;
-        current_key = node->key;
+        current_key = list->keys[index];
         if (key < current_key)
             right = index - 1;
 
@@ -178,14 +177,16 @@ int Keylist_Data_Add(
     KEY key,
     void *data)
 {
-    struct Keylist_Node *node;  /* holds the new node */
     int index = -1;     /* return value */
-    int i;      /* counts through the array */
 
     if (list && CheckArraySize(list)) {
         /* figure out where to put the new node */
         if (list->count) {
-            (void) FindIndex(list, key, &index);
+            /* keys that only ever go up are added at the end */
+            if (key > list->keys[list->count - 1])
+                index = list->count;
+            else
+                (void) FindIndex(list, key, &index);
             /* Add to the beginning of the list */
             if (index < 0)
                 index = 0;
@@ -195,23 +196,20 @@ int Keylist_Data_Add(
                 index = list->count;
 
             /* Move all the items up to make room for the new one */
-            for (i = list->count; i > index; i--) {
-                list->array[i] = list->array[i - 1];
-            }
+            memmove(&list->keys[index + 1], &list->keys[index],
+                (size_t) (list->count - index) * sizeof(KEY));
+            memmove(&list->data[index + 1], &list->data[index],
+                (size_t) (list->count - index) * sizeof(void *));
         }
 
         else {
             index = 0;
         }
 
-        /* create and add the node */
-        node = NodeCreate();
-        if (node) {
-            list->count++;
-            node->key = key;
-            node->data = data;
-            list->array[index] = node;
-        }
+        /* add the node */
+        list->count++;
+        list->keys[index] = key;
+        list->data[index] = data;
     }
     return index;
 }
@@ -222,36 +220,18 @@ void *Keylist_Data_Delete_By_Index(
     OS_Keylist list,
     int index)
 {
-    struct Keylist_Node *node;
     void *data = NULL;
 
-    if (list && list->array && list->count && (index >= 0) &&
+    if (list && list->keys && list->count && (index >= 0) &&
         (index < list->count)) {
-        node = list->array[index];
-        if (node)
-            data = node->data;
-
-        /* move the nodes to account for the deleted one */
-        if (list->count == 1) {
+        data = list->data[index];
 
-            /* There is no node shifting to do */
-        }
-        /* We are the last one */
-        else if (index == (list->count - 1)) {
-
-            /* There is no node shifting to do */
-        }
-        /* Move all the nodes down one */
-        else {
-            int i;      /* counter */
-            int count = list->count - 1;
-            for (i = index; i < count; i++) {
-                list->array[i] = list->array[i + 1];
-            }
-        }
+        /* Move all the nodes after it down one */
         list->count--;
-        if (node)
-            free(node);
+        memmove(&list->keys[index], &list->keys[index + 1],
+            (size_t) (list->count - index) * sizeof(KEY));
+        memmove(&list->data[index], &list->data[index + 1],
+            (size_t) (list->count - index) * sizeof(void *));
 
         /* potentially reduce the size of the array */
         (void) CheckArraySize(list);
@@ -297,15 +277,15 @@ void *Keylist_Data(
     OS_Keylist list,
     KEY key)
 {
-    struct Keylist_Node *node = NULL;
+    void *data = NULL;
     int index = 0;      /* used to look up the index of node */
 
-    if (list && list->array && list->count) {
+    if (list && list->keys && list->count) {
         if (FindIndex(list, key, &index))
-            node = list->array[index];
+            data = list->data[index];
     }
 
-    return node ? node->data : NULL;
+    return data;
 }
 
 /* returns the index from the node specified by key */
@@ -315,7 +295,7 @@ int Keylist_Index(
 {
     int index = -1;      /* used to look up the index of node */
 
-    if (list && list->array && list->count) {
+    if (list && list->keys && list->count) {
         if (!FindIndex(list, key, &index)) {
             index = -1;
         }
@@ -330,13 +310,13 @@ void *Keylist_Data_Index(
     OS_Keylist list,
     int index)
 {
-    struct Keylist_Node *node = NULL;
+    void *data = NULL;
 
-    if (list && list->array && list->count && (index >= 0) &&
+    if (list && list->data && list->count && (index >= 0) &&
         (index < list->count))
-        node = list->array[index];
+        data = list->data[index];
 
-    return node ? node->data : NULL;
+    return data;
 }
 
 /* return the key at the given index */
@@ -345,13 +325,10 @@ KEY Keylist_Key(
     int index)
 {
     KEY key = 0;        /* return value */
-    struct Keylist_Node *node;
 
-    if (list && list->array && list->count && (index >= 0) &&
+    if (list && list->keys && list->count && (index >= 0) &&
         (index < list->count)) {
-        node = list->array[index];
-        if (node)
-            key = node->key;
+        key = list->keys[index];
     }
 
     return key;
@@ -404,12 +381,10 @@ void Keylist_Delete(
     OS_Keylist list)
 {       /* list number to be deleted */
     if (list) {
-        /* clean out the list */
-        while (list->count) {
-            (void) Keylist_Data_Delete_By_Index(list, 0);
-        }
-        if (list->array)
-            free(list->array);
+        if (list->keys)
+            free(list->keys);
+        if (list->data)
+            free(list->data);
         free(list);
     }
 
@@ -698,6 +673,57 @@ static void testKeyListLarge(
     return;
 }
 
+/* test the order of keys added backwards, and the shrinking */
+static void testKeyListGrowth(
+    Test * pTest)
+{
+    int data1 = 42;
+    OS_Keylist list;
+    KEY key;
+    int index;
+    bool status = true;
+    const int num_keys = 1000;
+
+    list = Keylist_Create();
+    ct_test(pTest, list != NULL);
+    if (!list)
+        return;
+    for (key = num_keys; key > 0; key--) {
+        index = Keylist_Data_Add(list, key, &data1);
+        if (index != 0)
+            status = false;
+    }
+    ct_test(pTest, status);
+    ct_test(pTest, Keylist_Count(list) == num_keys);
+    ct_test(pTest, list->size < (num_keys * 2));
+    for (index = 0; index < num_keys; index++) {
+        if (Keylist_Key(list, index) != (KEY) (index + 1))
+            status = false;
+    }
+    ct_test(pTest, status);
+    /* every other key goes, the rest stay in order */
+    for (key = 2; key <= num_keys; key += 2) {
+        if (Keylist_Data_Delete(list, key) != &data1)
+            status = false;
+    }
+    ct_test(pTest, status);
+    ct_test(pTest, Keylist_Count(list) == (num_keys / 2));
+    for (index = 0; index < (num_keys / 2); index++) {
+        if (Keylist_Key(list, index) != (KEY) ((index * 2) + 1))
+            status = false;
+    }
+    ct_test(pTest, status);
+    ct_test(pTest, Keylist_Next_Empty_Key(list, 1) == 2);
+    while (Keylist_Count(list) > 3) {
+        (void) Keylist_Data_Pop(list);
+    }
+    ct_test(pTest, list->size < (num_keys / 4));
+    ct_test(pTest, Keylist_Key(list, 2) == 5);
+    Keylist_Delete(list);
+
+    return;
+}
+
 /* test access of a lot of entries */
 void testKeyList(
     Test * pTest)
@@ -715,6 +741,8 @@ void testKeyList(
     assert(rc);
     rc = ct_addTestFunction(pTest, testKeyListLarge);
     assert(rc);
+    rc = ct_addTestFunction(pTest, testKeyListGrowth);
+    assert(rc);
 }
 
 #ifdef TEST_KEYLIST
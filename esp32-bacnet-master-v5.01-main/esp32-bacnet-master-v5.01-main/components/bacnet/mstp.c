@@ -0,0 +1,1601 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "bacdef.h"
+#include "mstp.h"
+#include "crc.h"
+
+/** @file mstp.c  MS/TP Receive Frame, Master Node and Slave Node state
+ *  machines (Clause 9.5), apart from any port.  The port feeds octets
+ *  through DataRegister and DataAvailable, keeps the SilenceTimer, and
+ *  gives the state machines MSTP_Send_Frame(), MSTP_Put_Receive(),
+ *  MSTP_Get_Send() and MSTP_Get_Reply(). */
+
+/* The minimum number of DataAvailable or ReceiveError events that must be */
+/* seen by a receiving node in order to declare the line "active": 4. */
+#define Nmin_octets 4
+
+/* The minimum time without a DataAvailable or ReceiveError event within */
+/* a frame before a receiving node may discard the frame: 60 bit times. */
+/* Implementations may use larger values, not to exceed 100 milliseconds. */
+#ifndef Tframe_abort
+#define Tframe_abort 95
+#endif
+
+/* The maximum time a node may wait after reception of a frame that */
+/* expects a reply before sending the first octet of a reply or Reply */
+/* Postponed frame: 250 milliseconds. */
+#ifndef Treply_delay
+#define Treply_delay 250
+#endif
+
+/* The minimum time without a DataAvailable or ReceiveError event that a */
+/* node must wait for a station to begin replying to a confirmed request: */
+/* 255 milliseconds.  (Implementations may use larger values, up to 300.) */
+#ifndef Treply_timeout
+#define Treply_timeout 260
+#endif
+
+/* The minimum time without a DataAvailable or ReceiveError event that a */
+/* node must wait for a remote node to begin using a token or replying to */
+/* a Poll For Master frame: 20 milliseconds, and at most 100. */
+#ifndef Tusage_timeout
+#define Tusage_timeout 25
+#endif
+
+/* counts up to 255 and stays there */
+#define INCREMENT_AND_LIMIT_UINT8(x) {if ((x) < 0xFF) (x)++;}
+
+/** Builds an MS/TP frame: preamble, header, header CRC, and the data
+ *  with its CRC if there is any.
+ *
+ * @param buffer - where the frame is built
+ * @param buffer_len - size of buffer
+ * @param frame_type - FRAME_TYPE_TOKEN and so on
+ * @param destination - MAC address of the destination, or broadcast
+ * @param source - MAC address of this station
+ * @param data - data of the frame, or NULL
+ * @param data_len - number of octets of data (up to 501)
+ *
+ * @return length of the frame, or 0 if it did not fit in the buffer
+ */
+uint16_t MSTP_Create_Frame(
+    uint8_t * buffer,
+    uint16_t buffer_len,
+    uint8_t frame_type,
+    uint8_t destination,
+    uint8_t source,
+    uint8_t * data,
+    uint16_t data_len)
+{
+    uint8_t crc8 = 0xFF;        /* used to calculate the crc value */
+    uint16_t crc16 = 0xFFFF;    /* used to calculate the crc value */
+    uint16_t index = 0; /* used to load the data portion of the frame */
+
+    if (!data) {
+        data_len = 0;
+    }
+    /* not enough to do a header, or the data and its CRC */
+    if ((buffer_len < 8) ||
+        (data_len && ((uint32_t) data_len + 10 > buffer_len))) {
+        return 0;
+    }
+    buffer[0] = 0x55;
+    buffer[1] = 0xFF;
+    buffer[2] = frame_type;
+    crc8 = CRC_Calc_Header(buffer[2], crc8);
+    buffer[3] = destination;
+    crc8 = CRC_Calc_Header(buffer[3], crc8);
+    buffer[4] = source;
+    crc8 = CRC_Calc_Header(buffer[4], crc8);
+    buffer[5] = (uint8_t) (data_len >> 8);      /* MSB first */
+    crc8 = CRC_Calc_Header(buffer[5], crc8);
+    buffer[6] = (uint8_t) (data_len & 0xFF);
+    crc8 = CRC_Calc_Header(buffer[6], crc8);
+    buffer[7] = (uint8_t) ~crc8;
+    index = 8;
+    if (data_len) {
+        while (data_len) {
+            buffer[index] = *data;
+            crc16 = CRC_Calc_Data(buffer[index], crc16);
+            data++;
+            index++;
+            data_len--;
+        }
+        crc16 = (uint16_t) ~crc16;
+        /* the data CRC is sent least significant octet first */
+        buffer[index] = (uint8_t) (crc16 & 0xFF);
+        buffer[index + 1] = (uint8_t) (crc16 >> 8);
+        index += 2;
+    }
+
+    return index;
+}
+
+/** Builds a frame in the OutputBuffer of the port and sends it.
+ *
+ * @param mstp_port - port to send from
+ * @param frame_type - FRAME_TYPE_TOKEN and so on
+ * @param destination - MAC address of the destination, or broadcast
+ * @param source - MAC address of this station
+ * @param data - data of the frame, or NULL
+ * @param data_len - number of octets of data
+ */
+void MSTP_Create_And_Send_Frame(
+    volatile struct mstp_port_struct_t *mstp_port,
+    uint8_t frame_type,
+    uint8_t destination,
+    uint8_t source,
+    uint8_t * data,
+    uint16_t data_len)
+{
+    uint16_t len = 0;   /* number of bytes to send */
+
+    len =
+        MSTP_Create_Frame((uint8_t *) & mstp_port->OutputBuffer[0],
+        mstp_port->OutputBufferSize, frame_type, destination, source, data,
+        data_len);
+    if (len) {
+        MSTP_Send_Frame(mstp_port, (uint8_t *) & mstp_port->OutputBuffer[0],
+            len);
+    }
+}
+
+/** Fills a BACnet address from the MAC address of a station.
+ *
+ * @param src - the BACnet address to fill
+ * @param mstp_address - MAC address of the station
+ */
+void MSTP_Fill_BACnet_Address(
+    BACNET_ADDRESS * src,
+    uint8_t mstp_address)
+{
+    int i = 0;
+
+    if (mstp_address == MSTP_BROADCAST_ADDRESS) {
+        /* mac_len = 0 if broadcast address */
+        src->mac_len = 0;
+        src->mac[0] = 0;
+    } else {
+        src->mac_len = 1;
+        src->mac[0] = mstp_address;
+    }
+    /* local only, no routing */
+    src->net = 0;
+    /* no SLEN */
+    src->len = 0;
+    for (i = 0; i < MAX_MAC_LEN; i++) {
+        /* no SADR */
+        src->adr[i] = 0;
+    }
+}
+
+/* the receive state machine leaves a frame for the node state machine */
+static void mstp_receive_done(
+    volatile struct mstp_port_struct_t *mstp_port,
+    bool valid)
+{
+    if (!valid) {
+        mstp_port->ReceivedInvalidFrame = true;
+    } else if ((mstp_port->DestinationAddress == mstp_port->This_Station) ||
+        (mstp_port->DestinationAddress == MSTP_BROADCAST_ADDRESS)) {
+        mstp_port->ReceivedValidFrame = true;
+    } else {
+        mstp_port->ReceivedValidFrameNotForUs = true;
+    }
+    mstp_port->receive_state = MSTP_RECEIVE_STATE_IDLE;
+}
+
+/** The Receive Frame state machine: takes the octet in DataRegister
+ *  when DataAvailable is set, or the error when ReceiveError is set,
+ *  and watches the SilenceTimer for an abandoned frame.  A complete
+ *  frame sets ReceivedValidFrame, ReceivedValidFrameNotForUs or
+ *  ReceivedInvalidFrame, which the node state machine clears.
+ *
+ * @param mstp_port - the port
+ */
+void MSTP_Receive_Frame_FSM(
+    volatile struct mstp_port_struct_t *mstp_port)
+{
+    switch (mstp_port->receive_state) {
+        case MSTP_RECEIVE_STATE_IDLE:
+            /* In the IDLE state, the node waits for the beginning */
+            /* of a frame. */
+            if (mstp_port->ReceiveError) {
+                /* EatAnError */
+                mstp_port->ReceiveError = false;
+                mstp_port->SilenceTimerReset((void *) mstp_port);
+                INCREMENT_AND_LIMIT_UINT8(mstp_port->EventCount);
+            } else if (mstp_port->DataAvailable) {
+                if (mstp_port->DataRegister == 0x55) {
+                    /* Preamble1 */
+                    mstp_port->receive_state = MSTP_RECEIVE_STATE_PREAMBLE;
+                }
+                /* else EatAnOctet */
+                mstp_port->DataAvailable = false;
+                mstp_port->SilenceTimerReset((void *) mstp_port);
+                INCREMENT_AND_LIMIT_UINT8(mstp_port->EventCount);
+            }
+            break;
+        case MSTP_RECEIVE_STATE_PREAMBLE:
+            /* In the PREAMBLE state, the node waits for the */
+            /* second octet of the preamble. */
+            if (mstp_port->SilenceTimer((void *) mstp_port) > Tframe_abort) {
+                /* Timeout */
+                mstp_port->receive_state = MSTP_RECEIVE_STATE_IDLE;
+            } else if (mstp_port->ReceiveError) {
+                /* Error */
+                mstp_port->ReceiveError = false;
+                mstp_port->SilenceTimerReset((void *) mstp_port);
+                INCREMENT_AND_LIMIT_UINT8(mstp_port->EventCount);
+                mstp_port->receive_state = MSTP_RECEIVE_STATE_IDLE;
+            } else if (mstp_port->DataAvailable) {
+                if (mstp_port->DataRegister == 0xFF) {
+                    /* Preamble2 */
+                    mstp_port->Index = 0;
+                    mstp_port->HeaderCRC = 0xFF;
+                    mstp_port->receive_state = MSTP_RECEIVE_STATE_HEADER;
+                } else if (mstp_port->DataRegister != 0x55) {
+                    /* NotPreamble */
+                    mstp_port->receive_state = MSTP_RECEIVE_STATE_IDLE;
+                }
+                /* else RepeatedPreamble1 */
+                mstp_port->DataAvailable = false;
+                mstp_port->SilenceTimerReset((void *) mstp_port);
+                INCREMENT_AND_LIMIT_UINT8(mstp_port->EventCount);
+            }
+            break;
+        case MSTP_RECEIVE_STATE_HEADER:
+            /* In the HEADER state, the node waits for the fixed message */
+            /* header. */
+            if (mstp_port->SilenceTimer((void *) mstp_port) > Tframe_abort) {
+                /* Timeout */
+                mstp_receive_done(mstp_port, false);
+            } else if (mstp_port->ReceiveError) {
+                /* Error */
+                mstp_port->ReceiveError = false;
+                mstp_port->SilenceTimerReset((void *) mstp_port);
+                INCREMENT_AND_LIMIT_UINT8(mstp_port->EventCount);
+                mstp_receive_done(mstp_port, false);
+            } else if (mstp_port->DataAvailable) {
+                mstp_port->DataAvailable = false;
+                mstp_port->SilenceTimerReset((void *) mstp_port);
+                INCREMENT_AND_LIMIT_UINT8(mstp_port->EventCount);
+                mstp_port->HeaderCRC =
+                    CRC_Calc_Header(mstp_port->DataRegister,
+                    mstp_port->HeaderCRC);
+                switch (mstp_port->Index) {
+                    case 0:
+                        /* FrameType */
+                        mstp_port->FrameType = mstp_port->DataRegister;
+                        break;
+                    case 1:
+                        /* Destination */
+                        mstp_port->DestinationAddress =
+                            mstp_port->DataRegister;
+                        break;
+                    case 2:
+                        /* Source */
+                        mstp_port->SourceAddress = mstp_port->DataRegister;
+                        break;
+                    case 3:
+                        /* Length1 */
+                        mstp_port->DataLength =
+                            (uint16_t) (mstp_port->DataRegister << 8);
+                        break;
+                    case 4:
+                        /* Length2 */
+                        mstp_port->DataLength |= mstp_port->DataRegister;
+                        break;
+                    default:
+                        /* HeaderCRC */
+                        mstp_port->HeaderCRCActual = mstp_port->DataRegister;
+                        if (mstp_port->HeaderCRC != 0x55) {
+                            /* BadCRC */
+                            mstp_receive_done(mstp_port, false);
+                        } else if (mstp_port->DataLength == 0) {
+                            /* NoData */
+                            mstp_receive_done(mstp_port, true);
+                        } else {
+                            mstp_port->Index = 0;
+                            mstp_port->DataCRC = 0xFFFF;
+                            if (((mstp_port->DestinationAddress ==
+                                        mstp_port->This_Station) ||
+                                    (mstp_port->DestinationAddress ==
+                                        MSTP_BROADCAST_ADDRESS)) &&
+                                (mstp_port->DataLength <=
+                                    mstp_port->InputBufferSize)) {
+                                /* Data */
+                                mstp_port->receive_state =
+                                    MSTP_RECEIVE_STATE_DATA;
+                            } else {
+                                /* NotForUs, or FrameTooLong */
+                                mstp_port->receive_state =
+                                    MSTP_RECEIVE_STATE_SKIP_DATA;
+                            }
+                        }
+                        break;
+                }
+                if (mstp_port->receive_state == MSTP_RECEIVE_STATE_HEADER) {
+                    mstp_port->Index++;
+                }
+            }
+            break;
+        case MSTP_RECEIVE_STATE_DATA:
+        case MSTP_RECEIVE_STATE_SKIP_DATA:
+            /* In the DATA state, the node waits for the data portion of */
+            /* a frame, and in SKIP_DATA it counts the data of a frame */
+            /* that is not for it or too long for its buffer. */
+            if (mstp_port->SilenceTimer((void *) mstp_port) > Tframe_abort) {
+                /* Timeout */
+                mstp_receive_done(mstp_port, false);
+            } else if (mstp_port->ReceiveError) {
+                /* Error */
+                mstp_port->ReceiveError = false;
+                mstp_port->SilenceTimerReset((void *) mstp_port);
+                INCREMENT_AND_LIMIT_UINT8(mstp_port->EventCount);
+                mstp_receive_done(mstp_port, false);
+            } else if (mstp_port->DataAvailable) {
+                mstp_port->DataAvailable = false;
+                mstp_port->SilenceTimerReset((void *) mstp_port);
+                INCREMENT_AND_LIMIT_UINT8(mstp_port->EventCount);
+                mstp_port->DataCRC =
+                    CRC_Calc_Data(mstp_port->DataRegister,
+                    mstp_port->DataCRC);
+                if (mstp_port->Index < mstp_port->DataLength) {
+                    /* DataOctet */
+                    if (mstp_port->receive_state == MSTP_RECEIVE_STATE_DATA) {
+                        mstp_port->InputBuffer[mstp_port->Index] =
+                            mstp_port->DataRegister;
+                    }
+                    mstp_port->Index++;
+                } else if (mstp_port->Index == mstp_port->DataLength) {
+                    /* CRC1 */
+                    mstp_port->DataCRCActualLSB = mstp_port->DataRegister;
+                    mstp_port->Index++;
+                } else {
+                    /* CRC2 */
+                    mstp_port->DataCRCActualMSB = mstp_port->DataRegister;
+                    if (mstp_port->DataCRC != 0xF0B8) {
+                        /* BadCRC */
+                        mstp_receive_done(mstp_port, false);
+                    } else if (mstp_port->receive_state ==
+                        MSTP_RECEIVE_STATE_DATA) {
+                        /* GoodCRC */
+                        mstp_receive_done(mstp_port, true);
+                    } else {
+                        /* the frame was skipped: not for us, or too long */
+                        if (mstp_port->DestinationAddress ==
+                            mstp_port->This_Station) {
+                            mstp_port->ReceivedInvalidFrame = true;
+                        } else {
+                            mstp_port->ReceivedValidFrameNotForUs = true;
+                        }
+                        mstp_port->receive_state = MSTP_RECEIVE_STATE_IDLE;
+                    }
+                }
+            }
+            break;
+        default:
+            /* shouldn't get here - but if we do... */
+            mstp_port->receive_state = MSTP_RECEIVE_STATE_IDLE;
+            break;
+    }
+}
+
+/* hands the data of a received frame to the port, if it is BACnet data
+   for this station or a broadcast */
+static void mstp_receive_data(
+    volatile struct mstp_port_struct_t *mstp_port)
+{
+    if ((mstp_port->FrameType == FRAME_TYPE_BACNET_DATA_EXPECTING_REPLY) ||
+        (mstp_port->FrameType == FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY)) {
+        (void) MSTP_Put_Receive(mstp_port);
+    }
+}
+
+/** The Master Node state machine.  Runs after each frame received, and
+ *  whenever the Receive Frame state machine is idle so that the timers
+ *  are seen.
+ *
+ * @param mstp_port - the port
+ *
+ * @return true if it changed state and should be run again at once
+ */
+bool MSTP_Master_Node_FSM(
+    volatile struct mstp_port_struct_t * mstp_port)
+{
+    unsigned length = 0;
+    uint8_t frame_type = 0;
+    uint8_t destination = 0;
+    uint8_t next_poll_station = 0;
+    uint8_t next_this_station = 0;
+    uint8_t next_next_station = 0;
+    uint16_t my_timeout = 10, ns_timeout = 0;
+    /* transition immediately to the next state */
+    bool transition_now = false;
+
+    /* some calculations that several states need */
+    next_poll_station =
+        (mstp_port->Poll_Station + 1) % (mstp_port->Nmax_master + 1);
+    next_this_station =
+        (mstp_port->This_Station + 1) % (mstp_port->Nmax_master + 1);
+    next_next_station =
+        (mstp_port->Next_Station + 1) % (mstp_port->Nmax_master + 1);
+    switch (mstp_port->master_state) {
+        case MSTP_MASTER_STATE_INITIALIZE:
+            /* DoneInitializing */
+            /* indicate that the next station is unknown */
+            mstp_port->Next_Station = mstp_port->This_Station;
+            mstp_port->Poll_Station = mstp_port->This_Station;
+            /* cause a Poll For Master to be sent when this node first */
+            /* receives the token */
+            mstp_port->TokenCount = Npoll;
+            mstp_port->SoleMaster = false;
+            mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+            transition_now = true;
+            break;
+        case MSTP_MASTER_STATE_IDLE:
+            /* In the IDLE state, the node waits for a frame. */
+            if (mstp_port->ReceivedValidFrameNotForUs) {
+                /* the line is in use; the frame is of no other interest */
+                mstp_port->ReceivedValidFrameNotForUs = false;
+            }
+            if (mstp_port->ReceivedInvalidFrame) {
+                /* ReceivedInvalidFrame */
+                /* invalid frame was received */
+                mstp_port->ReceivedInvalidFrame = false;
+            } else if (mstp_port->ReceivedValidFrame) {
+                /* wait for the next frame - remain in IDLE, unless
+                   one of the transitions below applies */
+                switch (mstp_port->FrameType) {
+                    case FRAME_TYPE_TOKEN:
+                        /* ReceivedToken */
+                        if (mstp_port->DestinationAddress ==
+                            mstp_port->This_Station) {
+                            mstp_port->FrameCount = 0;
+                            mstp_port->SoleMaster = false;
+                            mstp_port->master_state =
+                                MSTP_MASTER_STATE_USE_TOKEN;
+                            transition_now = true;
+                        }
+                        break;
+                    case FRAME_TYPE_POLL_FOR_MASTER:
+                        /* ReceivedPFM */
+                        if (mstp_port->DestinationAddress ==
+                            mstp_port->This_Station) {
+                            MSTP_Create_And_Send_Frame(mstp_port,
+                                FRAME_TYPE_REPLY_TO_POLL_FOR_MASTER,
+                                mstp_port->SourceAddress,
+                                mstp_port->This_Station, NULL, 0);
+                        }
+                        break;
+                    case FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY:
+                        /* ReceivedDataNoReply */
+                        mstp_receive_data(mstp_port);
+                        break;
+                    case FRAME_TYPE_BACNET_DATA_EXPECTING_REPLY:
+                        mstp_receive_data(mstp_port);
+                        if (mstp_port->DestinationAddress ==
+                            mstp_port->This_Station) {
+                            /* ReceivedDataNeedingReply */
+                            /* keep the frame until it is answered, for its
+                               source address */
+                            mstp_port->master_state =
+                                MSTP_MASTER_STATE_ANSWER_DATA_REQUEST;
+                            transition_now = true;
+                        }
+                        /* else a broadcast: ReceivedDataNoReply */
+                        break;
+                    case FRAME_TYPE_TEST_REQUEST:
+                        if (mstp_port->DestinationAddress ==
+                            mstp_port->This_Station) {
+                            MSTP_Create_And_Send_Frame(mstp_port,
+                                FRAME_TYPE_TEST_RESPONSE,
+                                mstp_port->SourceAddress,
+                                mstp_port->This_Station,
+                                (uint8_t *) & mstp_port->InputBuffer[0],
+                                mstp_port->DataLength);
+                        }
+                        break;
+                    case FRAME_TYPE_TEST_RESPONSE:
+                    default:
+                        break;
+                }
+                if (mstp_port->master_state !=
+                    MSTP_MASTER_STATE_ANSWER_DATA_REQUEST) {
+                    mstp_port->ReceivedValidFrame = false;
+                }
+            } else if (mstp_port->SilenceTimer((void *) mstp_port) >=
+                Tno_token) {
+                /* LostToken */
+                /* assume that the token has been lost */
+                mstp_port->EventCount = 0;      /* Addendum 135-2004d-8 */
+                mstp_port->master_state = MSTP_MASTER_STATE_NO_TOKEN;
+                transition_now = true;
+            }
+            break;
+        case MSTP_MASTER_STATE_USE_TOKEN:
+            /* In the USE_TOKEN state, the node is allowed to send one or */
+            /* more data frames. These may be BACnet Data frames or */
+            /* proprietary frames. */
+            length = MSTP_Get_Send(mstp_port, 0);
+            if (length < 1) {
+                /* NothingToSend */
+                mstp_port->FrameCount = mstp_port->Nmax_info_frames;
+                mstp_port->master_state = MSTP_MASTER_STATE_DONE_WITH_TOKEN;
+                transition_now = true;
+            } else {
+                frame_type = mstp_port->OutputBuffer[2];
+                destination = mstp_port->OutputBuffer[3];
+                MSTP_Send_Frame(mstp_port,
+                    (uint8_t *) & mstp_port->OutputBuffer[0],
+                    (uint16_t) length);
+                mstp_port->FrameCount++;
+                switch (frame_type) {
+                    case FRAME_TYPE_BACNET_DATA_EXPECTING_REPLY:
+                        if (destination == MSTP_BROADCAST_ADDRESS) {
+                            /* SendNoWait */
+                            mstp_port->master_state =
+                                MSTP_MASTER_STATE_DONE_WITH_TOKEN;
+                            transition_now = true;
+                        } else {
+                            /* SendAndWait */
+                            mstp_port->master_state =
+                                MSTP_MASTER_STATE_WAIT_FOR_REPLY;
+                        }
+                        break;
+                    case FRAME_TYPE_TEST_REQUEST:
+                        /* SendAndWait */
+                        mstp_port->master_state =
+                            MSTP_MASTER_STATE_WAIT_FOR_REPLY;
+                        break;
+                    case FRAME_TYPE_TEST_RESPONSE:
+                    case FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY:
+                    default:
+                        /* SendNoWait */
+                        mstp_port->master_state =
+                            MSTP_MASTER_STATE_DONE_WITH_TOKEN;
+                        transition_now = true;
+                        break;
+                }
+            }
+            break;
+        case MSTP_MASTER_STATE_WAIT_FOR_REPLY:
+            /* In the WAIT_FOR_REPLY state, the node waits for */
+            /* a reply from another node. */
+            if (mstp_port->ReceivedInvalidFrame) {
+                /* InvalidFrame */
+                /* error in frame reception */
+                mstp_port->ReceivedInvalidFrame = false;
+                mstp_port->master_state = MSTP_MASTER_STATE_DONE_WITH_TOKEN;
+                transition_now = true;
+            } else if (mstp_port->ReceivedValidFrame) {
+                if (mstp_port->DestinationAddress == mstp_port->This_Station) {
+                    switch (mstp_port->FrameType) {
+                        case FRAME_TYPE_REPLY_POSTPONED:
+                            /* ReceivedPostpone */
+                            /* the reply will come with a later token */
+                        case FRAME_TYPE_TEST_RESPONSE:
+                            /* ReceivedReply */
+                            mstp_port->master_state =
+                                MSTP_MASTER_STATE_DONE_WITH_TOKEN;
+                            break;
+                        case FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY:
+                            /* ReceivedReply */
+                            mstp_receive_data(mstp_port);
+                            mstp_port->master_state =
+                                MSTP_MASTER_STATE_DONE_WITH_TOKEN;
+                            break;
+                        default:
+                            /* ReceivedUnexpectedFrame */
+                            /* an unexpected frame was received */
+                            /* This may indicate the presence of multiple */
+                            /* tokens. */
+                            mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+                            break;
+                    }
+                } else {
+                    /* ReceivedUnexpectedFrame */
+                    mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+                }
+                mstp_port->ReceivedValidFrame = false;
+                transition_now = true;
+            } else if (mstp_port->SilenceTimer((void *) mstp_port) >=
+                Treply_timeout) {
+                /* ReplyTimeout */
+                /* assume that the request has failed */
+                mstp_port->FrameCount = mstp_port->Nmax_info_frames;
+                mstp_port->master_state = MSTP_MASTER_STATE_DONE_WITH_TOKEN;
+                transition_now = true;
+            }
+            break;
+        case MSTP_MASTER_STATE_DONE_WITH_TOKEN:
+            /* The DONE_WITH_TOKEN state either sends another data frame, */
+            /* passes the token, or initiates a Poll For Master cycle. */
+            if (mstp_port->FrameCount < mstp_port->Nmax_info_frames) {
+                /* SendAnotherFrame */
+                mstp_port->master_state = MSTP_MASTER_STATE_USE_TOKEN;
+                transition_now = true;
+            } else if ((!mstp_port->SoleMaster) &&
+                (mstp_port->Next_Station == mstp_port->This_Station)) {
+                /* NextStationUnknown - added in Addendum 135-2008v-1 */
+                /* then the next station to which the token should be */
+                /* sent is unknown - so PollForMaster */
+                mstp_port->Poll_Station = next_this_station;
+                MSTP_Create_And_Send_Frame(mstp_port,
+                    FRAME_TYPE_POLL_FOR_MASTER, mstp_port->Poll_Station,
+                    mstp_port->This_Station, NULL, 0);
+                mstp_port->RetryCount = 0;
+                mstp_port->master_state = MSTP_MASTER_STATE_POLL_FOR_MASTER;
+            } else if (mstp_port->TokenCount < (Npoll - 1)) {
+                if ((mstp_port->SoleMaster) &&
+                    (mstp_port->Next_Station != next_this_station)) {
+                    /* SoleMaster */
+                    /* there are no other known master nodes to */
+                    /* which the token may be sent (true master-slave */
+                    /* operation). */
+                    mstp_port->FrameCount = 0;
+                    mstp_port->TokenCount++;
+                    mstp_port->master_state = MSTP_MASTER_STATE_USE_TOKEN;
+                    transition_now = true;
+                } else {
+                    /* SendToken */
+                    /* Npoll changed in Errata SSPC-135-2004 */
+                    /* The comparison of NS and TS+1 eliminates the Poll */
+                    /* For Master if there are no addresses between TS */
+                    /* and NS, since there is no address at which a new */
+                    /* master node may be found in that case. */
+                    mstp_port->TokenCount++;
+                    /* transmit a Token frame to NS */
+                    MSTP_Create_And_Send_Frame(mstp_port, FRAME_TYPE_TOKEN,
+                        mstp_port->Next_Station, mstp_port->This_Station,
+                        NULL, 0);
+                    mstp_port->RetryCount = 0;
+                    mstp_port->EventCount = 0;
+                    mstp_port->master_state = MSTP_MASTER_STATE_PASS_TOKEN;
+                }
+            } else if (next_poll_station == mstp_port->Next_Station) {
+                if (mstp_port->SoleMaster) {
+                    /* SoleMasterRestartMaintenancePFM */
+                    mstp_port->Poll_Station = next_next_station;
+                    MSTP_Create_And_Send_Frame(mstp_port,
+                        FRAME_TYPE_POLL_FOR_MASTER, mstp_port->Poll_Station,
+                        mstp_port->This_Station, NULL, 0);
+                    /* no known successor node */
+                    mstp_port->Next_Station = mstp_port->This_Station;
+                    mstp_port->RetryCount = 0;
+                    /* changed in Errata SSPC-135-2004 */
+                    mstp_port->TokenCount = 1;
+                    /* mstp_port->EventCount = 0; removed in Addendum 135-2004d-8 */
+                    /* find a new successor to TS */
+                    mstp_port->master_state =
+                        MSTP_MASTER_STATE_POLL_FOR_MASTER;
+                } else {
+                    /* ResetMaintenancePFM */
+                    mstp_port->Poll_Station = mstp_port->This_Station;
+                    /* transmit a Token frame to NS */
+                    MSTP_Create_And_Send_Frame(mstp_port, FRAME_TYPE_TOKEN,
+                        mstp_port->Next_Station, mstp_port->This_Station,
+                        NULL, 0);
+                    mstp_port->RetryCount = 0;
+                    /* changed in Errata SSPC-135-2004 */
+                    mstp_port->TokenCount = 1;
+                    mstp_port->EventCount = 0;
+                    mstp_port->master_state = MSTP_MASTER_STATE_PASS_TOKEN;
+                }
+            } else {
+                /* SendMaintenancePFM */
+                mstp_port->Poll_Station = next_poll_station;
+                MSTP_Create_And_Send_Frame(mstp_port,
+                    FRAME_TYPE_POLL_FOR_MASTER, mstp_port->Poll_Station,
+                    mstp_port->This_Station, NULL, 0);
+                mstp_port->RetryCount = 0;
+                mstp_port->master_state = MSTP_MASTER_STATE_POLL_FOR_MASTER;
+            }
+            break;
+        case MSTP_MASTER_STATE_PASS_TOKEN:
+            /* The PASS_TOKEN state listens for a successor to begin using */
+            /* the token that this node has just attempted to pass. */
+            if (mstp_port->SilenceTimer((void *) mstp_port) <= Tusage_timeout) {
+                if (mstp_port->EventCount > Nmin_octets) {
+                    /* SawTokenUser */
+                    /* Enter the IDLE state to process the frame. */
+                    mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+                    transition_now = true;
+                }
+            } else {
+                if (mstp_port->RetryCount < Nretry_token) {
+                    /* RetrySendToken */
+                    mstp_port->RetryCount++;
+                    /* Transmit a Token frame to NS */
+                    MSTP_Create_And_Send_Frame(mstp_port, FRAME_TYPE_TOKEN,
+                        mstp_port->Next_Station, mstp_port->This_Station,
+                        NULL, 0);
+                    mstp_port->EventCount = 0;
+                    /* re-enter the current state to listen for NS */
+                    /* to begin using the token. */
+                } else {
+                    /* FindNewSuccessor */
+                    /* Assume that NS has failed.  */
+                    mstp_port->Poll_Station = next_next_station;
+                    /* Transmit a Poll For Master frame to PS. */
+                    MSTP_Create_And_Send_Frame(mstp_port,
+                        FRAME_TYPE_POLL_FOR_MASTER, mstp_port->Poll_Station,
+                        mstp_port->This_Station, NULL, 0);
+                    /* no known successor node */
+                    mstp_port->Next_Station = mstp_port->This_Station;
+                    mstp_port->RetryCount = 0;
+                    mstp_port->TokenCount = 0;
+                    /* mstp_port->EventCount = 0; removed in Addendum 135-2004d-8 */
+                    /* find a new successor to TS */
+                    mstp_port->master_state =
+                        MSTP_MASTER_STATE_POLL_FOR_MASTER;
+                }
+            }
+            break;
+        case MSTP_MASTER_STATE_NO_TOKEN:
+            /* The NO_TOKEN state is entered if SilenceTimer exceeds */
+            /* Tno_token, indicating that there has been no network */
+            /* activity for that period of time. The timeout is continued */
+            /* to determine whether or not this node may create a token. */
+            my_timeout = Tno_token + (Tslot * mstp_port->This_Station);
+            if (mstp_port->SilenceTimer((void *) mstp_port) < my_timeout) {
+                if (mstp_port->EventCount > Nmin_octets) {
+                    /* SawFrame */
+                    /* Some other node exists at a lower address. */
+                    /* Enter the IDLE state to receive and process the */
+                    /* incoming frame. */
+                    mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+                    transition_now = true;
+                }
+            } else {
+                ns_timeout =
+                    Tno_token + (Tslot * (mstp_port->This_Station + 1));
+                if ((mstp_port->SilenceTimer((void *) mstp_port) <
+                        ns_timeout) ||
+                    (mstp_port->EventCount <= Nmin_octets)) {
+                    /* GenerateToken */
+                    /* Assume that this node is the lowest numerical */
+                    /* address on the network and is empowered to create */
+                    /* a token.  */
+                    mstp_port->Poll_Station = next_this_station;
+                    /* Transmit a Poll For Master frame to PS. */
+                    MSTP_Create_And_Send_Frame(mstp_port,
+                        FRAME_TYPE_POLL_FOR_MASTER, mstp_port->Poll_Station,
+                        mstp_port->This_Station, NULL, 0);
+                    /* indicate that the next station is unknown */
+                    mstp_port->Next_Station = mstp_port->This_Station;
+                    mstp_port->RetryCount = 0;
+                    mstp_port->TokenCount = 0;
+                    /* mstp_port->EventCount = 0; removed Addendum 135-2004d-8 */
+                    /* enter the POLL_FOR_MASTER state to find a new */
+                    /* successor to TS. */
+                    mstp_port->master_state =
+                        MSTP_MASTER_STATE_POLL_FOR_MASTER;
+                }
+            }
+            break;
+        case MSTP_MASTER_STATE_POLL_FOR_MASTER:
+            /* In the POLL_FOR_MASTER state, the node listens for a reply */
+            /* to a previously sent Poll For Master frame in order to find */
+            /* a successor node. */
+            if (mstp_port->ReceivedValidFrame) {
+                if ((mstp_port->DestinationAddress == mstp_port->This_Station)
+                    && (mstp_port->FrameType ==
+                        FRAME_TYPE_REPLY_TO_POLL_FOR_MASTER)) {
+                    /* ReceivedReplyToPFM */
+                    mstp_port->SoleMaster = false;
+                    mstp_port->Next_Station = mstp_port->SourceAddress;
+                    mstp_port->EventCount = 0;
+                    /* Transmit a Token frame to NS */
+                    MSTP_Create_And_Send_Frame(mstp_port, FRAME_TYPE_TOKEN,
+                        mstp_port->Next_Station, mstp_port->This_Station,
+                        NULL, 0);
+                    mstp_port->Poll_Station = mstp_port->This_Station;
+                    mstp_port->TokenCount = 0;
+                    mstp_port->RetryCount = 0;
+                    mstp_port->master_state = MSTP_MASTER_STATE_PASS_TOKEN;
+                } else {
+                    /* ReceivedUnexpectedFrame */
+                    /* An unexpected type of frame was received */
+                    /* while polling.  Enter the IDLE state to */
+                    /* process it. */
+                    mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+                    transition_now = true;
+                    /* leave ReceivedValidFrame for the IDLE state */
+                    break;
+                }
+                mstp_port->ReceivedValidFrame = false;
+            } else if ((mstp_port->SilenceTimer((void *) mstp_port) >
+                    Tusage_timeout) || mstp_port->ReceivedInvalidFrame) {
+                if (mstp_port->SoleMaster) {
+                    /* SoleMaster */
+                    /* There was no valid reply to the periodic poll */
+                    /* by the sole known master for other masters. */
+                    mstp_port->FrameCount = 0;
+                    /* mstp_port->TokenCount++; removed in 2004 */
+                    mstp_port->master_state = MSTP_MASTER_STATE_USE_TOKEN;
+                    transition_now = true;
+                } else if (mstp_port->Next_Station != mstp_port->This_Station) {
+                    /* DoneWithPFM */
+                    /* There was no valid reply to the maintenance */
+                    /* poll for a master at address PS. */
+                    mstp_port->EventCount = 0;
+                    /* transmit a Token frame to NS */
+                    MSTP_Create_And_Send_Frame(mstp_port, FRAME_TYPE_TOKEN,
+                        mstp_port->Next_Station, mstp_port->This_Station,
+                        NULL, 0);
+                    mstp_port->RetryCount = 0;
+                    mstp_port->master_state = MSTP_MASTER_STATE_PASS_TOKEN;
+                } else if (next_poll_station != mstp_port->This_Station) {
+                    /* SendNextPFM */
+                    mstp_port->Poll_Station = next_poll_station;
+                    /* Transmit a Poll For Master frame to PS. */
+                    MSTP_Create_And_Send_Frame(mstp_port,
+                        FRAME_TYPE_POLL_FOR_MASTER, mstp_port->Poll_Station,
+                        mstp_port->This_Station, NULL, 0);
+                    mstp_port->RetryCount = 0;
+                    /* Re-enter the current state. */
+                } else {
+                    /* DeclareSoleMaster */
+                    /* to indicate that this station is the only master */
+                    mstp_port->SoleMaster = true;
+                    mstp_port->FrameCount = 0;
+                    mstp_port->master_state = MSTP_MASTER_STATE_USE_TOKEN;
+                    transition_now = true;
+                }
+                mstp_port->ReceivedInvalidFrame = false;
+            }
+            break;
+        case MSTP_MASTER_STATE_ANSWER_DATA_REQUEST:
+            /* The ANSWER_DATA_REQUEST state is entered when a */
+            /* BACnet Data Expecting Reply, a Test_Request, or */
+            /* a proprietary frame that expects a reply is received. */
+            length = MSTP_Get_Reply(mstp_port, 0);
+            if (length > 0) {
+                /* Reply */
+                /* If a reply is available from the higher layers */
+                /* within Treply_delay after the reception of the */
+                /* final octet of the requesting frame */
+                /* (the mechanism used to determine this is a local */
+                /* matter), then call SendFrame to transmit the reply */
+                /* frame and enter the IDLE state to wait for the next */
+                /* frame. */
+                MSTP_Send_Frame(mstp_port,
+                    (uint8_t *) & mstp_port->OutputBuffer[0],
+                    (uint16_t) length);
+                mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+                /* clear our flag we were holding for comparison */
+                mstp_port->ReceivedValidFrame = false;
+            } else if (mstp_port->SilenceTimer((void *) mstp_port) >
+                Treply_delay) {
+                /* DeferredReply */
+                /* If no reply will be available from the higher */
+                /* layers within Treply_delay after the reception of the */
+                /* final octet of the requesting frame (the mechanism */
+                /* used to determine this is a local matter), */
+                /* then an immediate reply is not possible. */
+                /* Any reply shall wait until this node receives the */
+                /* token. Call SendFrame to transmit a Reply Postponed */
+                /* frame, and enter the IDLE state. */
+                MSTP_Create_And_Send_Frame(mstp_port,
+                    FRAME_TYPE_REPLY_POSTPONED, mstp_port->SourceAddress,
+                    mstp_port->This_Station, NULL, 0);
+                mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+                /* clear our flag we were holding for comparison */
+                mstp_port->ReceivedValidFrame = false;
+            }
+            break;
+        default:
+            mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+            break;
+    }
+
+    return transition_now;
+}
+
+/** The Slave Node state machine (Clause 9.6): a slave never holds the
+ *  token, and answers a request only while the requester waits.
+ *
+ * @param mstp_port - the port
+ */
+void MSTP_Slave_Node_FSM(
+    volatile struct mstp_port_struct_t *mstp_port)
+{
+    unsigned length = 0;
+
+    if (mstp_port->master_state == MSTP_MASTER_STATE_ANSWER_DATA_REQUEST) {
+        length = MSTP_Get_Reply(mstp_port, 0);
+        if (length > 0) {
+            /* Reply */
+            MSTP_Send_Frame(mstp_port,
+                (uint8_t *) & mstp_port->OutputBuffer[0],
+                (uint16_t) length);
+            mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+            mstp_port->ReceivedValidFrame = false;
+        } else if (mstp_port->SilenceTimer((void *) mstp_port) >
+            Treply_delay) {
+            /* a slave cannot postpone a reply: the request is dropped */
+            mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+            mstp_port->ReceivedValidFrame = false;
+        }
+        return;
+    }
+    mstp_port->master_state = MSTP_MASTER_STATE_IDLE;
+    mstp_port->ReceivedValidFrameNotForUs = false;
+    if (mstp_port->ReceivedInvalidFrame) {
+        /* ReceivedInvalidFrame */
+        mstp_port->ReceivedInvalidFrame = false;
+    } else if (mstp_port->ReceivedValidFrame) {
+        switch (mstp_port->FrameType) {
+            case FRAME_TYPE_BACNET_DATA_EXPECTING_REPLY:
+                mstp_receive_data(mstp_port);
+                if (mstp_port->DestinationAddress == mstp_port->This_Station) {
+                    /* ReceivedDataNeedingReply */
+                    mstp_port->master_state =
+                        MSTP_MASTER_STATE_ANSWER_DATA_REQUEST;
+                }
+                break;
+            case FRAME_TYPE_TEST_REQUEST:
+                if (mstp_port->DestinationAddress == mstp_port->This_Station) {
+                    MSTP_Create_And_Send_Frame(mstp_port,
+                        FRAME_TYPE_TEST_RESPONSE, mstp_port->SourceAddress,
+                        mstp_port->This_Station,
+                        (uint8_t *) & mstp_port->InputBuffer[0],
+                        mstp_port->DataLength);
+                }
+                break;
+            case FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY:
+                /* ReceivedDataNoReply */
+                mstp_receive_data(mstp_port);
+                break;
+            case FRAME_TYPE_TOKEN:
+            case FRAME_TYPE_POLL_FOR_MASTER:
+            case FRAME_TYPE_TEST_RESPONSE:
+            default:
+                /* not for a slave */
+                break;
+        }
+        if (mstp_port->master_state != MSTP_MASTER_STATE_ANSWER_DATA_REQUEST) {
+            mstp_port->ReceivedValidFrame = false;
+        }
+    }
+}
+
+/** Tells whether other stations were heard lately: a master uses this
+ *  to know a token is around.
+ *
+ * @param mstp_port - the port
+ *
+ * @return true if the line is active
+ */
+bool MSTP_Line_Active(
+    volatile struct mstp_port_struct_t *mstp_port)
+{
+    return (mstp_port->EventCount > Nmin_octets);
+}
+
+/** Puts the state machines of a port in their initial states.  The port
+ *  sets This_Station, Nmax_master, Nmax_info_frames, the buffers and the
+ *  timer functions before this.
+ *
+ * @param mstp_port - the port
+ */
+void MSTP_Init(
+    volatile struct mstp_port_struct_t *mstp_port)
+{
+    if (mstp_port) {
+        mstp_port->receive_state = MSTP_RECEIVE_STATE_IDLE;
+        mstp_port->master_state = MSTP_MASTER_STATE_INITIALIZE;
+        mstp_port->ReceiveError = false;
+        mstp_port->DataAvailable = false;
+        mstp_port->DataRegister = 0;
+        mstp_port->DataCRC = 0;
+        mstp_port->DataLength = 0;
+        mstp_port->DestinationAddress = 0;
+        mstp_port->EventCount = 0;
+        mstp_port->FrameType = FRAME_TYPE_TOKEN;
+        mstp_port->FrameCount = 0;
+        mstp_port->HeaderCRC = 0;
+        mstp_port->Index = 0;
+        mstp_port->Next_Station = mstp_port->This_Station;
+        mstp_port->Poll_Station = mstp_port->This_Station;
+        mstp_port->ReceivedInvalidFrame = false;
+        mstp_port->ReceivedValidFrame = false;
+        mstp_port->ReceivedValidFrameNotForUs = false;
+        mstp_port->RetryCount = 0;
+        mstp_port->SilenceTimerReset((void *) mstp_port);
+        mstp_port->SoleMaster = false;
+        mstp_port->SourceAddress = 0;
+        mstp_port->TokenCount = 0;
+    }
+}
+
+#ifdef TEST
+#include <assert.h>
+#include <string.h>
+
+#include "ctest.h"
+#include "fifo.h"
+#include "dlmstp.h"
+
+/* A loopback bus of master nodes: a frame sent by one node is copied
+   into the receive FIFO of every other node that is online, and time
+   moves in steps of one millisecond.  The port functions of each node
+   queue frames to send, echo a reply to a request when told to, and
+   count what they see. */
+#define SIM_NODES 4
+#define SIM_QUEUE 8
+#define SIM_DATA 16
+
+struct sim_frame {
+    uint8_t frame_type;
+    uint8_t destination;
+    uint8_t data[SIM_DATA];
+    uint16_t data_len;
+};
+
+struct sim_node {
+    volatile struct mstp_port_struct_t port;
+    bool online;
+    uint32_t silence_start;
+    FIFO_BUFFER rx;
+    volatile uint8_t rx_store[1024];
+    uint8_t input[DLMSTP_MPDU_MAX];
+    uint8_t output[DLMSTP_MPDU_MAX];
+    struct sim_frame queue[SIM_QUEUE];
+    unsigned queue_head;
+    unsigned queue_count;
+    /* answer a Data Expecting Reply with its own data */
+    bool auto_reply;
+    bool reply_pending;
+    /* what was received */
+    unsigned received;
+    uint8_t received_source;
+    uint8_t received_data[SIM_DATA * SIM_QUEUE];
+    uint16_t received_len;
+    /* what was sent */
+    unsigned tokens;
+    unsigned postponed;
+    unsigned hold_frames;
+    unsigned hold_frames_max;
+};
+
+static struct sim_node Sim_Node[SIM_NODES];
+static uint32_t Sim_Time;
+
+static struct sim_node *sim_node(
+    volatile struct mstp_port_struct_t *mstp_port)
+{
+    return (struct sim_node *) mstp_port->UserData;
+}
+
+static uint32_t sim_silence_timer(
+    void *pArg)
+{
+    struct sim_node *node =
+        sim_node((volatile struct mstp_port_struct_t *) pArg);
+
+    return Sim_Time - node->silence_start;
+}
+
+static void sim_silence_timer_reset(
+    void *pArg)
+{
+    struct sim_node *node =
+        sim_node((volatile struct mstp_port_struct_t *) pArg);
+
+    node->silence_start = Sim_Time;
+}
+
+void MSTP_Send_Frame(
+    volatile struct mstp_port_struct_t *mstp_port,
+    uint8_t * buffer,
+    uint16_t nbytes)
+{
+    struct sim_node *node = sim_node(mstp_port);
+    unsigned i;
+
+    switch (buffer[2]) {
+        case FRAME_TYPE_TOKEN:
+        case FRAME_TYPE_POLL_FOR_MASTER:
+            node->hold_frames = 0;
+            break;
+        case FRAME_TYPE_REPLY_POSTPONED:
+            node->postponed++;
+            break;
+        case FRAME_TYPE_BACNET_DATA_EXPECTING_REPLY:
+        case FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY:
+            node->hold_frames++;
+            if (node->hold_frames > node->hold_frames_max) {
+                node->hold_frames_max = node->hold_frames;
+            }
+            break;
+        default:
+            break;
+    }
+    for (i = 0; i < SIM_NODES; i++) {
+        if ((&Sim_Node[i] == node) || !Sim_Node[i].online) {
+            continue;
+        }
+        if ((buffer[2] == FRAME_TYPE_TOKEN) &&
+            (buffer[3] == Sim_Node[i].port.This_Station)) {
+            Sim_Node[i].tokens++;
+        }
+        (void) FIFO_Add(&Sim_Node[i].rx, buffer, nbytes);
+    }
+    mstp_port->SilenceTimerReset((void *) mstp_port);
+}
+
+uint16_t MSTP_Put_Receive(
+    volatile struct mstp_port_struct_t * mstp_port)
+{
+    struct sim_node *node = sim_node(mstp_port);
+    uint16_t len = mstp_port->DataLength;
+
+    if ((node->received_len + len) <= sizeof(node->received_data)) {
+        memcpy(&node->received_data[node->received_len],
+            (uint8_t *) & mstp_port->InputBuffer[0], len);
+        node->received_len += len;
+    }
+    node->received_source = mstp_port->SourceAddress;
+    node->received++;
+    if ((mstp_port->FrameType == FRAME_TYPE_BACNET_DATA_EXPECTING_REPLY) &&
+        (mstp_port->DestinationAddress == mstp_port->This_Station)) {
+        node->reply_pending = node->auto_reply;
+    }
+
+    return len;
+}
+
+uint16_t MSTP_Get_Send(
+    volatile struct mstp_port_struct_t * mstp_port,
+    unsigned timeout)
+{
+    struct sim_node *node = sim_node(mstp_port);
+    struct sim_frame *frame;
+    uint16_t len = 0;
+
+    (void) timeout;
+    if (node->queue_count) {
+        frame = &node->queue[node->queue_head];
+        len =
+            MSTP_Create_Frame((uint8_t *) & mstp_port->OutputBuffer[0],
+            mstp_port->OutputBufferSize, frame->frame_type,
+            frame->destination, mstp_port->This_Station, frame->data,
+            frame->data_len);
+        node->queue_head = (node->queue_head + 1) % SIM_QUEUE;
+        node->queue_count--;
+    }
+
+    return len;
+}
+
+uint16_t MSTP_Get_Reply(
+    volatile struct mstp_port_struct_t * mstp_port,
+    unsigned timeout)
+{
+    struct sim_node *node = sim_node(mstp_port);
+    uint16_t len = 0;
+
+    (void) timeout;
+    if (node->reply_pending) {
+        node->reply_pending = false;
+        len =
+            MSTP_Create_Frame((uint8_t *) & mstp_port->OutputBuffer[0],
+            mstp_port->OutputBufferSize,
+            FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY,
+            mstp_port->SourceAddress, mstp_port->This_Station,
+            (uint8_t *) & mstp_port->InputBuffer[0], mstp_port->DataLength);
+    }
+
+    return len;
+}
+
+static void sim_init(
+    const uint8_t * stations,
+    unsigned count,
+    uint8_t max_master)
+{
+    struct sim_node *node;
+    unsigned i;
+
+    memset(Sim_Node, 0, sizeof(Sim_Node));
+    Sim_Time = 0;
+    for (i = 0; i < count; i++) {
+        node = &Sim_Node[i];
+        node->online = true;
+        FIFO_Init(&node->rx, node->rx_store, sizeof(node->rx_store));
+        node->port.UserData = node;
+        node->port.InputBuffer = node->input;
+        node->port.InputBufferSize = sizeof(node->input);
+        node->port.OutputBuffer = node->output;
+        node->port.OutputBufferSize = sizeof(node->output);
+        node->port.SilenceTimer = sim_silence_timer;
+        node->port.SilenceTimerReset = sim_silence_timer_reset;
+        node->port.This_Station = stations[i];
+        node->port.Nmax_master = max_master;
+        node->port.Nmax_info_frames = 1;
+        MSTP_Init(&node->port);
+    }
+}
+
+/* what the port task does each time it runs */
+static void sim_node_task(
+    struct sim_node *node)
+{
+    volatile struct mstp_port_struct_t *port = &node->port;
+
+    do {
+        while (!FIFO_Empty(&node->rx) && !port->ReceivedValidFrame &&
+            !port->ReceivedInvalidFrame) {
+            port->DataRegister = FIFO_Get(&node->rx);
+            port->DataAvailable = true;
+            MSTP_Receive_Frame_FSM(port);
+        }
+        MSTP_Receive_Frame_FSM(port);
+        if (port->This_Station > DEFAULT_MAX_MASTER) {
+            MSTP_Slave_Node_FSM(port);
+        } else if ((port->receive_state == MSTP_RECEIVE_STATE_IDLE) ||
+            port->ReceivedValidFrame || port->ReceivedInvalidFrame) {
+            while (MSTP_Master_Node_FSM(port)) {
+                /* run again at once */
+            }
+        }
+    } while (!FIFO_Empty(&node->rx) && !port->ReceivedValidFrame &&
+        !port->ReceivedInvalidFrame);
+}
+
+static void sim_run(
+    uint32_t milliseconds)
+{
+    uint32_t end = Sim_Time + milliseconds;
+    unsigned i;
+
+    while (Sim_Time < end) {
+        Sim_Time++;
+        for (i = 0; i < SIM_NODES; i++) {
+            if (Sim_Node[i].online) {
+                sim_node_task(&Sim_Node[i]);
+            }
+        }
+    }
+}
+
+static void sim_queue(
+    struct sim_node *node,
+    uint8_t frame_type,
+    uint8_t destination,
+    uint8_t data)
+{
+    struct sim_frame *frame;
+
+    assert(node->queue_count < SIM_QUEUE);
+    frame =
+        &node->queue[(node->queue_head + node->queue_count) % SIM_QUEUE];
+    frame->frame_type = frame_type;
+    frame->destination = destination;
+    memset(frame->data, data, sizeof(frame->data));
+    frame->data_len = sizeof(frame->data);
+    node->queue_count++;
+}
+
+/* frames are built as in Annex G */
+static void testMSTPCreateFrame(
+    Test * pTest)
+{
+    uint8_t buffer[32] = { 0 };
+    uint8_t data[3] = { 0x01, 0x22, 0x30 };
+    uint8_t token[8] = { 0x55, 0xFF, 0x00, 0x10, 0x05, 0x00, 0x00, 0x8C };
+    uint16_t len = 0;
+
+    len =
+        MSTP_Create_Frame(buffer, sizeof(buffer), FRAME_TYPE_TOKEN, 0x10,
+        0x05, NULL, 0);
+    ct_test(pTest, len == 8);
+    ct_test(pTest, memcmp(buffer, token, sizeof(token)) == 0);
+    len =
+        MSTP_Create_Frame(buffer, sizeof(buffer),
+        FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY, 0x10, 0x05, data,
+        sizeof(data));
+    ct_test(pTest, len == 13);
+    ct_test(pTest, buffer[5] == 0);
+    ct_test(pTest, buffer[6] == 3);
+    ct_test(pTest, memcmp(&buffer[8], data, sizeof(data)) == 0);
+    ct_test(pTest, buffer[11] == 0x10);
+    ct_test(pTest, buffer[12] == 0xBD);
+    /* no room for the data CRC */
+    len =
+        MSTP_Create_Frame(buffer, 12,
+        FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY, 0x10, 0x05, data,
+        sizeof(data));
+    ct_test(pTest, len == 0);
+    len =
+        MSTP_Create_Frame(buffer, 7, FRAME_TYPE_TOKEN, 0x10, 0x05, NULL, 0);
+    ct_test(pTest, len == 0);
+}
+
+/* feeds the octets of a frame to the receive state machine */
+static void sim_receive(
+    volatile struct mstp_port_struct_t *port,
+    uint8_t * buffer,
+    uint16_t len)
+{
+    uint16_t i;
+
+    for (i = 0; i < len; i++) {
+        port->DataRegister = buffer[i];
+        port->DataAvailable = true;
+        MSTP_Receive_Frame_FSM(port);
+    }
+}
+
+static void testMSTPReceiveFrame(
+    Test * pTest)
+{
+    static const uint8_t stations[1] = { 5 };
+    volatile struct mstp_port_struct_t *port;
+    uint8_t buffer[64] = { 0 };
+    uint8_t data[20];
+    uint16_t len = 0;
+
+    sim_init(stations, 1, 127);
+    port = &Sim_Node[0].port;
+    memset(data, 0xA5, sizeof(data));
+    /* a token for us, with some line noise ahead of it */
+    buffer[0] = 0x00;
+    buffer[1] = 0x55;
+    len =
+        MSTP_Create_Frame(&buffer[2], sizeof(buffer) - 2, FRAME_TYPE_TOKEN, 5,
+        3, NULL, 0);
+    sim_receive(port, buffer, len + 2);
+    ct_test(pTest, port->ReceivedValidFrame);
+    ct_test(pTest, port->FrameType == FRAME_TYPE_TOKEN);
+    ct_test(pTest, port->SourceAddress == 3);
+    ct_test(pTest, port->receive_state == MSTP_RECEIVE_STATE_IDLE);
+    port->ReceivedValidFrame = false;
+    /* data for us */
+    len =
+        MSTP_Create_Frame(buffer, sizeof(buffer),
+        FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY, 5, 3, data,
+        sizeof(data));
+    sim_receive(port, buffer, len);
+    ct_test(pTest, port->ReceivedValidFrame);
+    ct_test(pTest, port->DataLength == sizeof(data));
+    ct_test(pTest, memcmp((uint8_t *) port->InputBuffer, data,
+            sizeof(data)) == 0);
+    port->ReceivedValidFrame = false;
+    /* data for another station is skipped */
+    len =
+        MSTP_Create_Frame(buffer, sizeof(buffer),
+        FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY, 6, 3, data,
+        sizeof(data));
+    port->InputBuffer[0] = 0;
+    sim_receive(port, buffer, len);
+    ct_test(pTest, !port->ReceivedValidFrame);
+    ct_test(pTest, port->ReceivedValidFrameNotForUs);
+    ct_test(pTest, port->InputBuffer[0] == 0);
+    port->ReceivedValidFrameNotForUs = false;
+    /* a bad data CRC */
+    len =
+        MSTP_Create_Frame(buffer, sizeof(buffer),
+        FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY, 5, 3, data,
+        sizeof(data));
+    buffer[len - 1] ^= 0x01;
+    sim_receive(port, buffer, len);
+    ct_test(pTest, !port->ReceivedValidFrame);
+    ct_test(pTest, port->ReceivedInvalidFrame);
+    port->ReceivedInvalidFrame = false;
+    /* a bad header CRC */
+    len =
+        MSTP_Create_Frame(buffer, sizeof(buffer), FRAME_TYPE_TOKEN, 5, 3,
+        NULL, 0);
+    buffer[7] ^= 0x01;
+    sim_receive(port, buffer, len);
+    ct_test(pTest, port->ReceivedInvalidFrame);
+    port->ReceivedInvalidFrame = false;
+    /* a frame that stops in the header is abandoned */
+    len =
+        MSTP_Create_Frame(buffer, sizeof(buffer), FRAME_TYPE_TOKEN, 5, 3,
+        NULL, 0);
+    sim_receive(port, buffer, 5);
+    ct_test(pTest, port->receive_state == MSTP_RECEIVE_STATE_HEADER);
+    Sim_Time += Tframe_abort + 1;
+    MSTP_Receive_Frame_FSM(port);
+    ct_test(pTest, port->ReceivedInvalidFrame);
+    ct_test(pTest, port->receive_state == MSTP_RECEIVE_STATE_IDLE);
+    port->ReceivedInvalidFrame = false;
+    /* a UART error in the data */
+    len =
+        MSTP_Create_Frame(buffer, sizeof(buffer),
+        FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY, 5, 3, data,
+        sizeof(data));
+    sim_receive(port, buffer, 12);
+    port->ReceiveError = true;
+    MSTP_Receive_Frame_FSM(port);
+    ct_test(pTest, port->ReceivedInvalidFrame);
+    ct_test(pTest, port->receive_state == MSTP_RECEIVE_STATE_IDLE);
+}
+
+/* the masters find each other and pass the token around */
+static void testMSTPTokenRing(
+    Test * pTest)
+{
+    static const uint8_t stations[3] = { 0, 3, 6 };
+    unsigned i;
+
+    sim_init(stations, 3, 7);
+    sim_run(5000);
+    ct_test(pTest, Sim_Node[0].port.Next_Station == 3);
+    ct_test(pTest, Sim_Node[1].port.Next_Station == 6);
+    ct_test(pTest, Sim_Node[2].port.Next_Station == 0);
+    for (i = 0; i < 3; i++) {
+        ct_test(pTest, !Sim_Node[i].port.SoleMaster);
+        ct_test(pTest, Sim_Node[i].tokens > 100);
+    }
+    /* a station leaves, and the ring closes behind it */
+    Sim_Node[1].online = false;
+    sim_run(2000);
+    ct_test(pTest, Sim_Node[0].port.Next_Station == 6);
+    ct_test(pTest, Sim_Node[2].port.Next_Station == 0);
+    /* and comes back, found by the maintenance Poll For Master */
+    MSTP_Init(&Sim_Node[1].port);
+    FIFO_Flush(&Sim_Node[1].rx);
+    Sim_Node[1].online = true;
+    sim_run(5000);
+    ct_test(pTest, Sim_Node[0].port.Next_Station == 3);
+    ct_test(pTest, Sim_Node[1].port.Next_Station == 6);
+    /* everyone gone: the token is lost, and the last one is alone */
+    Sim_Node[0].online = false;
+    Sim_Node[1].online = false;
+    sim_run(3000);
+    ct_test(pTest, Sim_Node[2].port.SoleMaster);
+}
+
+/* no more than Max_Info_Frames frames are sent with each token */
+static void testMSTPMaxInfoFrames(
+    Test * pTest)
+{
+    static const uint8_t stations[3] = { 0, 3, 6 };
+    unsigned i;
+
+    sim_init(stations, 3, 7);
+    sim_run(2000);
+    Sim_Node[1].port.Nmax_info_frames = 2;
+    for (i = 0; i < 5; i++) {
+        sim_queue(&Sim_Node[1], FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY,
+            6, (uint8_t) i);
+    }
+    sim_queue(&Sim_Node[0], FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY,
+        MSTP_BROADCAST_ADDRESS, 0x42);
+    sim_queue(&Sim_Node[0], FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY,
+        MSTP_BROADCAST_ADDRESS, 0x43);
+    sim_run(2000);
+    ct_test(pTest, Sim_Node[1].queue_count == 0);
+    ct_test(pTest, Sim_Node[1].hold_frames_max == 2);
+    ct_test(pTest, Sim_Node[0].hold_frames_max == 1);
+    /* in order, along with the broadcasts */
+    ct_test(pTest, Sim_Node[2].received == 7);
+    ct_test(pTest, Sim_Node[1].received == 2);
+    ct_test(pTest, Sim_Node[1].received_data[0] == 0x42);
+    ct_test(pTest, Sim_Node[1].received_data[SIM_DATA] == 0x43);
+    for (i = 0; i < 5; i++) {
+        ct_test(pTest, memchr(Sim_Node[2].received_data, (int) i,
+                sizeof(Sim_Node[2].received_data)) != NULL);
+    }
+}
+
+/* a request is answered while the token is held, or postponed */
+static void testMSTPDataExpectingReply(
+    Test * pTest)
+{
+    static const uint8_t stations[3] = { 0, 3, 6 };
+
+    sim_init(stations, 3, 7);
+    sim_run(2000);
+    Sim_Node[2].auto_reply = true;
+    sim_queue(&Sim_Node[0], FRAME_TYPE_BACNET_DATA_EXPECTING_REPLY, 6, 0x55);
+    sim_run(1000);
+    ct_test(pTest, Sim_Node[2].received == 1);
+    ct_test(pTest, Sim_Node[2].received_source == 0);
+    ct_test(pTest, Sim_Node[0].received == 1);
+    ct_test(pTest, Sim_Node[0].received_source == 6);
+    ct_test(pTest, Sim_Node[0].received_data[0] == 0x55);
+    ct_test(pTest, Sim_Node[2].postponed == 0);
+    /* no reply in time */
+    Sim_Node[1].auto_reply = false;
+    sim_queue(&Sim_Node[0], FRAME_TYPE_BACNET_DATA_EXPECTING_REPLY, 3, 0x66);
+    sim_run(1000);
+    ct_test(pTest, Sim_Node[1].received == 1);
+    ct_test(pTest, Sim_Node[1].postponed == 1);
+    ct_test(pTest, Sim_Node[0].received == 1);
+    /* the token still goes around */
+    ct_test(pTest, Sim_Node[0].port.Next_Station == 3);
+    ct_test(pTest, Sim_Node[1].port.Next_Station == 6);
+    ct_test(pTest, Sim_Node[2].port.Next_Station == 0);
+}
+
+/* a lone master declares itself sole master, and a slave answers it */
+static void testMSTPSoleMaster(
+    Test * pTest)
+{
+    static const uint8_t stations[2] = { 4, 200 };
+
+    sim_init(stations, 2, 7);
+    sim_run(2000);
+    ct_test(pTest, Sim_Node[0].port.SoleMaster);
+    ct_test(pTest, Sim_Node[0].port.Next_Station == 4);
+    Sim_Node[1].auto_reply = true;
+    sim_queue(&Sim_Node[0], FRAME_TYPE_BACNET_DATA_EXPECTING_REPLY, 200, 7);
+    sim_queue(&Sim_Node[0], FRAME_TYPE_BACNET_DATA_NOT_EXPECTING_REPLY, 200,
+        8);
+    sim_run(1000);
+    ct_test(pTest, Sim_Node[0].queue_count == 0);
+    ct_test(pTest, Sim_Node[1].received == 2);
+    ct_test(pTest, Sim_Node[0].received == 1);
+    ct_test(pTest, Sim_Node[0].received_source == 200);
+    ct_test(pTest, Sim_Node[0].received_data[0] == 7);
+    ct_test(pTest, Sim_Node[0].port.SoleMaster);
+}
+
+void testMSTP(
+    Test * pTest)
+{
+    bool rc;
+
+    rc = ct_addTestFunction(pTest, testMSTPCreateFrame);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testMSTPReceiveFrame);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testMSTPTokenRing);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testMSTPMaxInfoFrames);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testMSTPDataExpectingReply);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testMSTPSoleMaster);
+    assert(rc);
+}
+
+#ifdef TEST_MSTP
+int main(
+    void)
+{
+    Test *pTest;
+
+    pTest = ct_create("mstp", NULL);
+    testMSTP(pTest);
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_MSTP */
+#endif /* TEST */
@@ -45,6 +45,8 @@
 #ifndef MAX_NOTIFICATION_CLASSES
 #define MAX_NOTIFICATION_CLASSES 2
 #endif
+/* largest encoding of one Recipient_List element, a BACnetDestination */
+#define NC_RECIPIENT_ELEMENT_MAX (29 + MAX_MAC_LEN)
 
 
 #if defined(INTRINSIC_REPORTING)
@@ -154,7 +156,7 @@ bool Notification_Class_Object_Name(
     uint32_t object_instance,
     BACNET_CHARACTER_STRING * object_name)
 {
-    static char text_string[32] = "";   /* okay for single thread */
+    char text_string[32] = "";
     unsigned int index;
     bool status = false;
 
@@ -269,6 +271,14 @@ int Notification_Class_Read_Property(
                 RecipientEntry = &CurrentNotify->Recipient_List[idx];
                 if (RecipientEntry->Recipient.RecipientType !=
                     RECIPIENT_TYPE_NOTINITIALIZED) {
+                    /* check if we have room before adding it to APDU */
+                    if ((apdu_len + NC_RECIPIENT_ELEMENT_MAX) >
+                        (int) rpdata->application_data_len) {
+                        rpdata->error_code =
+                            ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
+                        apdu_len = BACNET_STATUS_ABORT;
+                        break;
+                    }
                     /* Valid Days - BACnetDaysOfWeek - [bitstring] monday-sunday */
                     u8Val = 0x01;
                     bitstring_init(&bit_string);
@@ -0,0 +1,422 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bacdef.h"
+#include "objinst.h"
+#if defined(ESP_PLATFORM)
+#include "esp_heap_caps.h"
+#endif
+
+/** @file objinst.c  Object instance table shared by the object types */
+
+/* the table arrays start with room for this many objects,
+   and double each time they are full */
+#ifndef OBJINST_SIZE_MIN
+#define OBJINST_SIZE_MIN 4
+#endif
+
+/* the links are stored as index + 1 in 16 bits */
+#define OBJINST_MAX 0xFFFFU
+
+/**
+ * Reallocates object memory, from the external PSRAM when the
+ * target has it, so that large numbers of objects stay out of
+ * the internal RAM.
+ *
+ * @param ptr - memory to resize, or NULL
+ * @param size - new size in bytes
+ *
+ * @return the memory, or NULL if it is not available
+ */
+void *objinst_realloc(
+    void *ptr,
+    size_t size)
+{
+#if defined(ESP_PLATFORM)
+    void *data;
+
+    data = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (data) {
+        return data;
+    }
+#endif
+    return realloc(ptr, size);
+}
+
+static void objinst_link(
+    OBJINST_TABLE * table,
+    unsigned index)
+{
+    unsigned bucket;
+
+    bucket = table->Instance[index] % table->Size;
+    table->Next[index] = table->Bucket[bucket];
+    table->Bucket[bucket] = index + 1;
+}
+
+static void objinst_unlink(
+    OBJINST_TABLE * table,
+    unsigned index)
+{
+    uint16_t *link;
+
+    link = &table->Bucket[table->Instance[index] % table->Size];
+    while (*link) {
+        if (*link == (index + 1)) {
+            *link = table->Next[index];
+            break;
+        }
+        link = &table->Next[*link - 1];
+    }
+}
+
+static void objinst_rehash(
+    OBJINST_TABLE * table)
+{
+    unsigned index;
+
+    memset(table->Bucket, 0, table->Size * sizeof(table->Bucket[0]));
+    for (index = 0; index < table->Count; index++) {
+        objinst_link(table, index);
+    }
+}
+
+static bool objinst_grow(
+    OBJINST_TABLE * table)
+{
+    unsigned size;
+    void *data;
+
+    if (table->Size >= table->Max) {
+        return false;
+    }
+    size = table->Size ? (table->Size * 2) : OBJINST_SIZE_MIN;
+    if (size > table->Max) {
+        size = table->Max;
+    }
+    /* the object arrays first, so that a failure leaves the table as is */
+    if (table->Resize && !table->Resize(size)) {
+        return false;
+    }
+    data = objinst_realloc(table->Instance, size * sizeof(uint32_t));
+    if (!data) {
+        return false;
+    }
+    table->Instance = data;
+    data = objinst_realloc(table->Next, size * sizeof(uint16_t));
+    if (!data) {
+        return false;
+    }
+    table->Next = data;
+    data = objinst_realloc(table->Bucket, size * sizeof(uint16_t));
+    if (!data) {
+        return false;
+    }
+    table->Bucket = data;
+    table->Size = size;
+    objinst_rehash(table);
+
+    return true;
+}
+
+/**
+ * Empties the table.  Memory from an earlier use is kept.
+ *
+ * @param table - the instance table of an object type
+ * @param max - most objects the table may hold
+ * @param resize - grows the object arrays, or NULL
+ * @param move - moves an object within the object arrays, or NULL
+ */
+void objinst_init(
+    OBJINST_TABLE * table,
+    unsigned max,
+    objinst_resize_function resize,
+    objinst_move_function move)
+{
+    if (max > OBJINST_MAX) {
+        max = OBJINST_MAX;
+    }
+    table->Max = max;
+    table->Resize = resize;
+    table->Move = move;
+    table->Count = 0;
+    if (table->Size) {
+        memset(table->Bucket, 0, table->Size * sizeof(table->Bucket[0]));
+    }
+}
+
+/**
+ * Empties the table and frees its memory.
+ * The object type frees its own arrays.
+ *
+ * @param table - the instance table of an object type
+ */
+void objinst_cleanup(
+    OBJINST_TABLE * table)
+{
+    free(table->Instance);
+    free(table->Next);
+    free(table->Bucket);
+    table->Instance = NULL;
+    table->Next = NULL;
+    table->Bucket = NULL;
+    table->Count = 0;
+    table->Size = 0;
+}
+
+unsigned objinst_count(
+    OBJINST_TABLE * table)
+{
+    return table->Count;
+}
+
+/**
+ * @param table - the instance table of an object type
+ * @param index - 0..count-1
+ *
+ * @return the object instance at the index, or
+ *  BACNET_MAX_INSTANCE if the index is out of range
+ */
+uint32_t objinst_index_to_instance(
+    OBJINST_TABLE * table,
+    unsigned index)
+{
+    if (index < table->Count) {
+        return table->Instance[index];
+    }
+
+    return BACNET_MAX_INSTANCE;
+}
+
+/**
+ * @param table - the instance table of an object type
+ * @param object_instance - object instance number
+ *
+ * @return the index of the object, or a value not less
+ *  than the count if there is no such object
+ */
+unsigned objinst_instance_to_index(
+    OBJINST_TABLE * table,
+    uint32_t object_instance)
+{
+    unsigned link;
+
+    if (table->Count) {
+        link = table->Bucket[object_instance % table->Size];
+        while (link) {
+            if (table->Instance[link - 1] == object_instance) {
+                return link - 1;
+            }
+            link = table->Next[link - 1];
+        }
+    }
+
+    return table->Max;
+}
+
+bool objinst_valid_instance(
+    OBJINST_TABLE * table,
+    uint32_t object_instance)
+{
+    return (objinst_instance_to_index(table, object_instance) < table->Count);
+}
+
+/**
+ * Adds an object to the table, growing the object arrays as needed.
+ * The caller sets up the object at the returned index.
+ *
+ * @param table - the instance table of an object type
+ * @param object_instance - object instance number, 0..BACNET_MAX_INSTANCE-1
+ *
+ * @return the index of the new object, or a value not less than
+ *  the count if the object exists already or there is no room
+ */
+unsigned objinst_add(
+    OBJINST_TABLE * table,
+    uint32_t object_instance)
+{
+    unsigned index;
+
+    if (object_instance >= BACNET_MAX_INSTANCE) {
+        return table->Max;
+    }
+    if (objinst_valid_instance(table, object_instance)) {
+        return table->Max;
+    }
+    if ((table->Count >= table->Size) && !objinst_grow(table)) {
+        return table->Max;
+    }
+    index = table->Count;
+    table->Instance[index] = object_instance;
+    objinst_link(table, index);
+    table->Count++;
+
+    return index;
+}
+
+/**
+ * Removes an object from the table.  The last object is moved
+ * into its place, so the index of that object changes.
+ *
+ * @param table - the instance table of an object type
+ * @param object_instance - object instance number
+ *
+ * @return true if the object was removed
+ */
+bool objinst_remove(
+    OBJINST_TABLE * table,
+    uint32_t object_instance)
+{
+    unsigned index;
+    unsigned last;
+
+    index = objinst_instance_to_index(table, object_instance);
+    if (index >= table->Count) {
+        return false;
+    }
+    objinst_unlink(table, index);
+    last = table->Count - 1;
+    if (index != last) {
+        objinst_unlink(table, last);
+        if (table->Move) {
+            table->Move(index, last);
+        }
+        table->Instance[index] = table->Instance[last];
+        objinst_link(table, index);
+    }
+    table->Count--;
+
+    return true;
+}
+
+#ifdef TEST
+#include <assert.h>
+#include "ctest.h"
+
+static unsigned Test_Size;
+static uint32_t *Test_Value;
+
+static bool testResize(
+    unsigned size)
+{
+    void *data;
+
+    data = objinst_realloc(Test_Value, size * sizeof(uint32_t));
+    if (!data) {
+        return false;
+    }
+    Test_Value = data;
+    Test_Size = size;
+
+    return true;
+}
+
+static void testMove(
+    unsigned to,
+    unsigned from)
+{
+    Test_Value[to] = Test_Value[from];
+}
+
+void testObjectInstanceTable(
+    Test * pTest)
+{
+    OBJINST_TABLE table = { 0 };
+    unsigned index;
+    uint32_t instance;
+
+    objinst_init(&table, 100, testResize, testMove);
+    ct_test(pTest, objinst_count(&table) == 0);
+    ct_test(pTest, !objinst_valid_instance(&table, 0));
+    /* sparse instances, added out of order */
+    for (instance = 0; instance < 100; instance++) {
+        index = objinst_add(&table, (instance * 37) % 100 + 1000);
+        ct_test(pTest, index == instance);
+        Test_Value[index] = (instance * 37) % 100 + 1000;
+    }
+    ct_test(pTest, objinst_count(&table) == 100);
+    ct_test(pTest, Test_Size == 100);
+    /* full, and duplicates are refused */
+    ct_test(pTest, objinst_add(&table, 5) >= objinst_count(&table));
+    ct_test(pTest, objinst_add(&table, 1000) >= objinst_count(&table));
+    for (instance = 1000; instance < 1100; instance++) {
+        index = objinst_instance_to_index(&table, instance);
+        ct_test(pTest, index < objinst_count(&table));
+        ct_test(pTest, objinst_index_to_instance(&table, index) == instance);
+    }
+    ct_test(pTest, !objinst_valid_instance(&table, 999));
+    ct_test(pTest, !objinst_valid_instance(&table, 1100));
+    /* remove every other one; the rest keep their data */
+    for (instance = 1000; instance < 1100; instance += 2) {
+        ct_test(pTest, objinst_remove(&table, instance));
+    }
+    ct_test(pTest, !objinst_remove(&table, 1000));
+    ct_test(pTest, objinst_count(&table) == 50);
+    for (instance = 1000; instance < 1100; instance++) {
+        index = objinst_instance_to_index(&table, instance);
+        if (instance & 1) {
+            ct_test(pTest, index < objinst_count(&table));
+            ct_test(pTest, Test_Value[index] == instance);
+        } else {
+            ct_test(pTest, index >= objinst_count(&table));
+        }
+    }
+    ct_test(pTest, objinst_index_to_instance(&table, 50) ==
+        BACNET_MAX_INSTANCE);
+    /* re-initialize keeps the memory */
+    objinst_init(&table, 100, testResize, testMove);
+    ct_test(pTest, objinst_count(&table) == 0);
+    ct_test(pTest, !objinst_valid_instance(&table, 1001));
+    ct_test(pTest, objinst_add(&table, 1001) == 0);
+    objinst_cleanup(&table);
+    free(Test_Value);
+    Test_Value = NULL;
+}
+
+#ifdef TEST_OBJINST
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("BACnet Object Instance Table", NULL);
+    /* individual tests */
+    rc = ct_addTestFunction(pTest, testObjectInstanceTable);
+    assert(rc);
+
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_OBJINST */
+#endif /* TEST */
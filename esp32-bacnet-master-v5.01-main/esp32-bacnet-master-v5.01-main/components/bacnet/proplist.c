@@ -32,6 +32,7 @@
  -------------------------------------------
 ####COPYRIGHTEND####*/
 #include <stdint.h>
+#include <string.h>
 #include "bacenum.h"
 #include "bacdef.h"
 #include "bacdcode.h"
@@ -44,6 +45,9 @@
 #define BACNET_PROPERTY_LISTS 0
 #endif
 
+/* largest encoding of one Property_List element, an ENUMERATED */
+#define PROPERTY_LIST_ELEMENT_MAX 5
+
 #if BACNET_PROPERTY_LISTS
 /** @file proplist.c  List of Required and Optional object properties */
 /* note: the PROP_PROPERTY_LIST is NOT included in these lists, on purpose */
@@ -1150,6 +1154,213 @@ unsigned property_list_count(
     return property_count;
 }
 
+/**
+ * Finds the descriptor of a property in an object property table.
+ *
+ * @param table - property table of an object type
+ * @param property - the property to find
+ *
+ * @return the descriptor, or NULL if the object type has no such property
+ */
+const struct property_descr_t *property_table_find(
+    const struct property_table_t *table,
+    BACNET_PROPERTY_ID property)
+{
+    const struct property_descr_t *descr;
+    unsigned i;
+
+    descr = table->descr;
+    for (i = 0; i < table->count; i++) {
+        if (descr[i].property == property) {
+            return &descr[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* copies a cached value, or encodes it and keeps it if there is room */
+static int property_cache_read(
+    const struct property_table_t *table,
+    const struct property_descr_t *descr,
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    struct property_cache_t *cache = table->cache;
+    struct property_cache_slot_t *slot = &cache->slot[descr - table->descr];
+    int len;
+
+    if ((slot->len > 0) && (slot->len <= rpdata->application_data_len)) {
+        memcpy(rpdata->application_data, &cache->data[slot->offset],
+            slot->len);
+        return slot->len;
+    }
+    len = descr->read(rpdata, object_index);
+    if ((len > 0) && (slot->len == 0) &&
+        ((unsigned) len <= (cache->size - cache->used))) {
+        memcpy(&cache->data[cache->used], rpdata->application_data,
+            (size_t) len);
+        slot->offset = (uint16_t) cache->used;
+        slot->len = (uint16_t) len;
+        cache->used += (unsigned) len;
+    }
+
+    return len;
+}
+
+/**
+ * ReadProperty through an object property table.  The descriptor of the
+ * property encodes the value; unknown properties, and an array index on
+ * a property that is not an array, are answered with an error.
+ *
+ * @param table - property table of an object type
+ * @param rpdata - ReadProperty data, including requested data and
+ * data for the reply, or error response.
+ * @param object_index - index of the object, passed to the descriptor
+ *
+ * @return number of APDU bytes in the response, or
+ * BACNET_STATUS_ERROR or BACNET_STATUS_ABORT on error.
+ */
+int property_table_read(
+    const struct property_table_t *table,
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    const struct property_descr_t *descr;
+
+    descr = property_table_find(table, rpdata->object_property);
+    if (!descr) {
+        rpdata->error_class = ERROR_CLASS_PROPERTY;
+        rpdata->error_code = ERROR_CODE_UNKNOWN_PROPERTY;
+        return BACNET_STATUS_ERROR;
+    }
+    /*  only array properties can have array options */
+    if (!(descr->flags & PROPERTY_ARRAY) &&
+        (rpdata->array_index != BACNET_ARRAY_ALL)) {
+        rpdata->error_class = ERROR_CLASS_PROPERTY;
+        rpdata->error_code = ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY;
+        return BACNET_STATUS_ERROR;
+    }
+    if ((descr->flags & PROPERTY_CACHED) && table->cache &&
+        (rpdata->array_index == BACNET_ARRAY_ALL)) {
+        return property_cache_read(table, descr, rpdata, object_index);
+    }
+
+    return descr->read(rpdata, object_index);
+}
+
+/**
+ * Tells the exact length of a property value without encoding it, which
+ * is only known for a value kept in the cache of its table.
+ *
+ * @param table - property table of an object type, or NULL
+ * @param property - the property to be read
+ * @param array_index - the array index to be read
+ *
+ * @return the length of the encoded value, or 0 if not known
+ */
+unsigned property_table_value_len(
+    const struct property_table_t *table,
+    BACNET_PROPERTY_ID property,
+    uint32_t array_index)
+{
+    const struct property_descr_t *descr;
+
+    if (!table || !table->cache || (array_index != BACNET_ARRAY_ALL)) {
+        return 0;
+    }
+    descr = property_table_find(table, property);
+    if (!descr || !(descr->flags & PROPERTY_CACHED)) {
+        return 0;
+    }
+
+    return table->cache->slot[descr - table->descr].len;
+}
+
+/**
+ * Forgets the pre-encoded values of a table, so that they are encoded
+ * again on the next read.  Call it whenever a cached value changes.
+ *
+ * @param table - property table of an object type
+ */
+void property_cache_invalidate(
+    const struct property_table_t *table)
+{
+    struct property_cache_t *cache = table->cache;
+    unsigned i;
+
+    if (cache) {
+        for (i = 0; i < table->count; i++) {
+            cache->slot[i].len = 0;
+        }
+        cache->used = 0;
+    }
+}
+
+/**
+ * Tells whether a property belongs to the set named by one of the
+ * special properties ALL, REQUIRED or OPTIONAL.
+ *
+ * @param descr - property descriptor
+ * @param special_property - PROP_ALL, PROP_REQUIRED or PROP_OPTIONAL
+ *
+ * @return true if the property is in the set
+ */
+bool property_table_special(
+    const struct property_descr_t *descr,
+    BACNET_PROPERTY_ID special_property)
+{
+    if (special_property == PROP_ALL) {
+        return true;
+    } else if (special_property == PROP_REQUIRED) {
+        return (descr->flags & PROPERTY_REQUIRED) ? true : false;
+    } else if (special_property == PROP_OPTIONAL) {
+        return (descr->flags & PROPERTY_OPTIONAL) ? true : false;
+    }
+
+    return false;
+}
+
+/**
+ * Fills the '-1' terminated Required, Optional and Proprietary lists of
+ * an object type from its property table, for the code that works from
+ * the lists.  Each list needs room for the table count plus one.
+ *
+ * @param table - property table of an object type
+ * @param pRequired - list of required properties, or NULL
+ * @param pOptional - list of optional properties, or NULL
+ * @param pProprietary - list of proprietary properties, or NULL
+ */
+void property_table_lists(
+    const struct property_table_t *table,
+    int *pRequired,
+    int *pOptional,
+    int *pProprietary)
+{
+    const struct property_descr_t *descr;
+    unsigned i;
+
+    descr = table->descr;
+    for (i = 0; i < table->count; i++) {
+        if ((descr[i].flags & PROPERTY_REQUIRED) && pRequired) {
+            *pRequired++ = descr[i].property;
+        } else if ((descr[i].flags & PROPERTY_OPTIONAL) && pOptional) {
+            *pOptional++ = descr[i].property;
+        } else if ((descr[i].flags & PROPERTY_PROPRIETARY) && pProprietary) {
+            *pProprietary++ = descr[i].property;
+        }
+    }
+    if (pRequired) {
+        *pRequired = -1;
+    }
+    if (pOptional) {
+        *pOptional = -1;
+    }
+    if (pProprietary) {
+        *pProprietary = -1;
+    }
+}
+
 /**
  * ReadProperty handler for this property.  For the given ReadProperty
  * data, the application_data is loaded or the error flags are set.
@@ -1206,52 +1417,51 @@ int property_list_encode(
                             (pListRequired[i] == PROP_OBJECT_IDENTIFIER) ||
                             (pListRequired[i] == PROP_OBJECT_NAME)) {
                             continue;
-                        } else {
-                            len =
-                                encode_application_enumerated(&apdu[apdu_len],
-                                (uint32_t)pListRequired[i]);
                         }
                         /* add it if we have room */
-                        if ((apdu_len + len) < max_apdu_len) {
-                            apdu_len += len;
-                        } else {
+                        if ((apdu_len + PROPERTY_LIST_ELEMENT_MAX) >
+                            max_apdu_len) {
                             rpdata->error_code =
                                 ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
                             apdu_len = BACNET_STATUS_ABORT;
                             break;
                         }
+                        len =
+                            encode_application_enumerated(&apdu[apdu_len],
+                            (uint32_t)pListRequired[i]);
+                        apdu_len += len;
                     }
                 }
-                if (optional_count) {
+                if (optional_count && (apdu_len >= 0)) {
                     for (i = 0; i < optional_count; i++) {
-                        len =
-                            encode_application_enumerated(&apdu[apdu_len],
-                            (uint32_t)pListOptional[i]);
                         /* add it if we have room */
-                        if ((apdu_len + len) < max_apdu_len) {
-                            apdu_len += len;
-                        } else {
+                        if ((apdu_len + PROPERTY_LIST_ELEMENT_MAX) >
+                            max_apdu_len) {
                             rpdata->error_code =
                                 ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
                             apdu_len = BACNET_STATUS_ABORT;
                             break;
                         }
+                        len =
+                            encode_application_enumerated(&apdu[apdu_len],
+                            (uint32_t)pListOptional[i]);
+                        apdu_len += len;
                     }
                 }
-                if (proprietary_count) {
+                if (proprietary_count && (apdu_len >= 0)) {
                     for (i = 0; i < proprietary_count; i++) {
-                        len =
-                            encode_application_enumerated(&apdu[apdu_len],
-                            (uint32_t)pListProprietary[i]);
                         /* add it if we have room */
-                        if ((apdu_len + len) < max_apdu_len) {
-                            apdu_len += len;
-                        } else {
+                        if ((apdu_len + PROPERTY_LIST_ELEMENT_MAX) >
+                            max_apdu_len) {
                             rpdata->error_code =
                                 ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
                             apdu_len = BACNET_STATUS_ABORT;
                             break;
                         }
+                        len =
+                            encode_application_enumerated(&apdu[apdu_len],
+                            (uint32_t)pListProprietary[i]);
+                        apdu_len += len;
                     }
                 }
             } else {
@@ -33,6 +33,7 @@
 ####COPYRIGHTEND####*/
 #include <stdint.h>
 #include "bacenum.h"
+#include "bits.h"
 #include "bacdcode.h"
 #include "bacdef.h"
 #include "readrange.h"
@@ -76,7 +77,13 @@ int rr_encode_apdu(
 
     if (apdu) {
         apdu[0] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST;
+#if BACNET_SEGMENTATION_ENABLED
+        /* the TSM reassembles a segmented ACK for us */
+        apdu[0] |= BAC_BIT(1);
+        apdu[1] = encode_max_segs_max_apdu(MAX_SEGMENTS_ACCEPTED, MAX_APDU);
+#else
         apdu[1] = encode_max_segs_max_apdu(0, MAX_APDU);
+#endif
         apdu[2] = invoke_id;
         apdu[3] = SERVICE_CONFIRMED_READ_RANGE; /* service choice */
         apdu_len = 4;
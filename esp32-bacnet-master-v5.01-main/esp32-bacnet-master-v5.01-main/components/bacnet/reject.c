@@ -36,6 +36,9 @@
 #include "bacdcode.h"
 #include "bacdef.h"
 #include "reject.h"
+#if APDU_STATISTICS
+#include "apdu.h"
+#endif
 
 /** @file reject.c  Encode/Decode Reject APDUs */
 
@@ -104,6 +107,9 @@ int reject_encode_apdu(
         apdu[1] = invoke_id;
         apdu[2] = reject_reason;
         apdu_len = 3;
+#if APDU_STATISTICS
+        apdu_statistics_reject();
+#endif
     }
 
     return apdu_len;
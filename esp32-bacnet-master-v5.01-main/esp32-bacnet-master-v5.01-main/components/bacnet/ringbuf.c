@@ -0,0 +1,375 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ringbuf.h"
+
+/** @file ringbuf.c  Ring of fixed size elements
+ *
+ * Like the FIFO, the head is only moved by the writer and the tail by
+ * the reader, and both run freely so that head - tail is the count.
+ * An element can be filled in place: Ringbuf_Data_Peek() gives the
+ * free element at the head, and Ringbuf_Data_Put() adds it.
+ */
+
+/* the element must be seen before the index that hands it over */
+#define RINGBUF_BARRIER() __sync_synchronize()
+
+/* the element at a free running index */
+static volatile uint8_t *ringbuf_element(
+    RING_BUFFER const *b,
+    unsigned index)
+{
+    return &b->buffer[(index & (b->element_count - 1)) * b->element_size];
+}
+
+/* copies an element out of, or into, the volatile buffer */
+static void ringbuf_copy(
+    volatile uint8_t * dest,
+    volatile const uint8_t * src,
+    unsigned size)
+{
+    unsigned i;
+
+    for (i = 0; i < size; i++) {
+        dest[i] = src[i];
+    }
+}
+
+/**
+ * Returns the number of elements in the ring.
+ *
+ * @param b - ring buffer structure
+ *
+ * @return number of elements
+ */
+unsigned Ringbuf_Count(
+    RING_BUFFER const *b)
+{
+    unsigned head, tail;        /* used to avoid volatile decision */
+
+    if (b) {
+        head = b->head;
+        tail = b->tail;
+        return head - tail;
+    }
+
+    return 0;
+}
+
+/**
+ * Tells whether the ring is full.
+ *
+ * @param b - ring buffer structure
+ *
+ * @return true if full, or b is NULL
+ */
+bool Ringbuf_Full(
+    RING_BUFFER const *b)
+{
+    return (b ? (Ringbuf_Count(b) >= b->element_count) : true);
+}
+
+/**
+ * Tells whether the ring is empty.
+ *
+ * @param b - ring buffer structure
+ *
+ * @return true if empty, or b is NULL
+ */
+bool Ringbuf_Empty(
+    RING_BUFFER const *b)
+{
+    return (b ? (Ringbuf_Count(b) == 0) : true);
+}
+
+/**
+ * Looks at the oldest element without removing it.
+ *
+ * @param b - ring buffer structure
+ *
+ * @return the oldest element, or NULL if the ring is empty
+ */
+volatile uint8_t *Ringbuf_Peek(
+    RING_BUFFER const *b)
+{
+    if (!Ringbuf_Empty(b)) {
+        RINGBUF_BARRIER();
+        return ringbuf_element(b, b->tail);
+    }
+
+    return NULL;
+}
+
+/**
+ * Removes the oldest element.
+ *
+ * @param b - ring buffer structure
+ * @param data_element - where the element is copied, or NULL
+ *
+ * @return true if there was an element
+ */
+bool Ringbuf_Pop(
+    RING_BUFFER * b,
+    uint8_t * data_element)
+{
+    if (!Ringbuf_Empty(b)) {
+        RINGBUF_BARRIER();
+        if (data_element) {
+            ringbuf_copy(data_element, ringbuf_element(b, b->tail),
+                b->element_size);
+        }
+        RINGBUF_BARRIER();
+        b->tail++;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Adds an element after the newest one.
+ *
+ * @param b - ring buffer structure
+ * @param data_element - the element to copy in
+ *
+ * @return true if there was room for it
+ */
+bool Ringbuf_Put(
+    RING_BUFFER * b,
+    uint8_t * data_element)
+{
+    if (b && data_element && !Ringbuf_Full(b)) {
+        ringbuf_copy(ringbuf_element(b, b->head), data_element,
+            b->element_size);
+        RINGBUF_BARRIER();
+        b->head++;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Adds an element ahead of the oldest one, so that it is the next
+ * removed.  This moves the tail, so only the reader may do this.
+ *
+ * @param b - ring buffer structure
+ * @param data_element - the element to copy in
+ *
+ * @return true if there was room for it
+ */
+bool Ringbuf_Put_Front(
+    RING_BUFFER * b,
+    uint8_t * data_element)
+{
+    if (b && data_element && !Ringbuf_Full(b)) {
+        ringbuf_copy(ringbuf_element(b, b->tail - 1), data_element,
+            b->element_size);
+        RINGBUF_BARRIER();
+        b->tail--;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Gives the free element at the head, to be filled in place and then
+ * added with Ringbuf_Data_Put().
+ *
+ * @param b - ring buffer structure
+ *
+ * @return the free element, or NULL if the ring is full
+ */
+volatile uint8_t *Ringbuf_Data_Peek(
+    RING_BUFFER * b)
+{
+    if (b && !Ringbuf_Full(b)) {
+        return ringbuf_element(b, b->head);
+    }
+
+    return NULL;
+}
+
+/**
+ * Adds the element given by Ringbuf_Data_Peek() once it is filled.
+ *
+ * @param b - ring buffer structure
+ * @param data_element - the element from Ringbuf_Data_Peek()
+ *
+ * @return true if it was the free element at the head
+ */
+bool Ringbuf_Data_Put(
+    RING_BUFFER * b,
+    volatile uint8_t * data_element)
+{
+    if (data_element && (data_element == Ringbuf_Data_Peek(b))) {
+        RINGBUF_BARRIER();
+        b->head++;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Sets up a ring over a block of memory.
+ *
+ * @param b - ring buffer structure
+ * @param buffer - block of element_size * element_count bytes
+ * @param element_size - size of one element
+ * @param element_count - number of elements, which must be a power of two
+ */
+void Ringbuf_Init(
+    RING_BUFFER * b,
+    volatile uint8_t * buffer,
+    unsigned element_size,
+    unsigned element_count)
+{
+    if (b) {
+        b->head = 0;
+        b->tail = 0;
+        b->buffer = buffer;
+        b->element_size = element_size;
+        b->element_count = element_count;
+    }
+}
+
+#ifdef TEST
+#include <assert.h>
+
+#include "ctest.h"
+
+/* fill, drain and wrap a ring of element_count elements */
+static void testRingBuf(
+    Test * pTest,
+    volatile uint8_t * data_store,
+    uint8_t * data_element,
+    unsigned element_size,
+    unsigned element_count)
+{
+    RING_BUFFER test_buffer;
+    volatile uint8_t *test_data;
+    unsigned index;
+    unsigned data_index;
+    unsigned pass;
+    bool status;
+
+    Ringbuf_Init(&test_buffer, data_store, element_size, element_count);
+    ct_test(pTest, Ringbuf_Empty(&test_buffer));
+    ct_test(pTest, Ringbuf_Peek(&test_buffer) == NULL);
+    ct_test(pTest, Ringbuf_Pop(&test_buffer, NULL) == false);
+
+    for (pass = 0; pass < 3; pass++) {
+        for (index = 0; index < element_count; index++) {
+            for (data_index = 0; data_index < element_size; data_index++) {
+                data_element[data_index] = (uint8_t) (index + pass);
+            }
+            status = Ringbuf_Put(&test_buffer, data_element);
+            ct_test(pTest, status == true);
+            ct_test(pTest, Ringbuf_Count(&test_buffer) == (index + 1));
+        }
+        ct_test(pTest, Ringbuf_Full(&test_buffer));
+        ct_test(pTest, Ringbuf_Put(&test_buffer, data_element) == false);
+        ct_test(pTest, Ringbuf_Data_Peek(&test_buffer) == NULL);
+        for (index = 0; index < element_count; index++) {
+            test_data = Ringbuf_Peek(&test_buffer);
+            ct_test(pTest, test_data != NULL);
+            if (test_data) {
+                ct_test(pTest, test_data[0] == (uint8_t) (index + pass));
+                ct_test(pTest,
+                    test_data[element_size - 1] == (uint8_t) (index + pass));
+            }
+            status = Ringbuf_Pop(&test_buffer, data_element);
+            ct_test(pTest, status == true);
+            ct_test(pTest, data_element[0] == (uint8_t) (index + pass));
+        }
+        ct_test(pTest, Ringbuf_Empty(&test_buffer));
+        /* leave the indexes off the start of the buffer */
+        status = Ringbuf_Put(&test_buffer, data_element);
+        status = Ringbuf_Pop(&test_buffer, NULL);
+        ct_test(pTest, status == true);
+    }
+
+    /* fill in place, and put one ahead of the others */
+    test_data = Ringbuf_Data_Peek(&test_buffer);
+    ct_test(pTest, test_data != NULL);
+    if (test_data) {
+        test_data[0] = 1;
+        ct_test(pTest, Ringbuf_Data_Put(&test_buffer, test_data));
+        ct_test(pTest, !Ringbuf_Data_Put(&test_buffer, test_data));
+    }
+    data_element[0] = 2;
+    status = Ringbuf_Put_Front(&test_buffer, data_element);
+    ct_test(pTest, status == true);
+    ct_test(pTest, Ringbuf_Count(&test_buffer) == 2);
+    status = Ringbuf_Pop(&test_buffer, data_element);
+    ct_test(pTest, data_element[0] == 2);
+    status = Ringbuf_Pop(&test_buffer, data_element);
+    ct_test(pTest, data_element[0] == 1);
+    ct_test(pTest, Ringbuf_Empty(&test_buffer));
+}
+
+void testRingBufSize16(
+    Test * pTest)
+{
+    volatile uint8_t data_store[5 * 16];
+    uint8_t data_element[5];
+
+    testRingBuf(pTest, data_store, data_element, sizeof(data_element), 16);
+}
+
+void testRingBufSize32(
+    Test * pTest)
+{
+    volatile uint8_t data_store[16 * 32];
+    uint8_t data_element[16];
+
+    testRingBuf(pTest, data_store, data_element, sizeof(data_element), 32);
+}
+
+#ifdef TEST_RING_BUFFER
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("Ring Buffer", NULL);
+    rc = ct_addTestFunction(pTest, testRingBufSize16);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testRingBufSize32);
+    assert(rc);
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_RING_BUFFER */
+#endif /* TEST */
@@ -0,0 +1,1826 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "bacdef.h"
+#include "bacaddr.h"
+#include "bacdcode.h"
+#include "bacenum.h"
+#include "npdu.h"
+#include "datalink.h"
+#include "router.h"
+#include "baclock.h"
+#if ROUTER_RX_TASKS
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#endif
+
+/** @file router.c  Routes NPDUs between the ports of the device */
+
+#if ROUTER_RX_TASKS
+/* below MS/TP, whose state machines must keep their timing */
+#ifndef ROUTER_RX_TASK_PRIORITY
+#define ROUTER_RX_TASK_PRIORITY (configMAX_PRIORITIES - 3)
+#endif
+#ifndef ROUTER_RX_TASK_STACK
+#define ROUTER_RX_TASK_STACK 3072
+#endif
+/* milliseconds a port task waits on its datalink at a time */
+#ifndef ROUTER_RX_WAIT_MS
+#define ROUTER_RX_WAIT_MS 1000
+#endif
+#endif
+
+/* every queue can be full, and every port have received all it may,
+   with one packet left over */
+#define ROUTER_PACKETS \
+    ((ROUTER_PORTS_MAX * (ROUTER_QUEUE_SIZE + \
+    (ROUTER_RX_TASKS * ROUTER_RX_QUEUE_SIZE))) + 1)
+#if ROUTER_PACKETS > 255
+#error "the router packets must be numbered by a uint8_t"
+#endif
+
+typedef struct router_packet {
+    /* the datalink address it is sent to */
+    BACNET_ADDRESS dest;
+    /* the datalink address it came from */
+    BACNET_ADDRESS src;
+    BACNET_NPDU_DATA npdu_data;
+    /* where the NPDU starts in buffer[], and its length */
+    uint16_t offset;
+    uint16_t length;
+    /* the datalinks receive their whole frame into buffer[] and
+       move the NPDU to its start, so room for the largest header */
+    uint8_t buffer[ROUTER_HEADROOM + MAX_MPDU];
+} ROUTER_PACKET;
+
+/* FIFO of packet numbers */
+typedef struct router_fifo {
+    uint8_t head;
+    uint8_t count;
+    uint8_t packet[ROUTER_QUEUE_SIZE];
+    /* a task is handing the queue to the datalink */
+    bool draining;
+} ROUTER_FIFO;
+
+/* the DNETs of an I-Am-Router-To-Network */
+#define ROUTER_NETWORK_DATA_MAX (2 * (ROUTER_PORTS_MAX + ROUTER_TABLE_SIZE))
+
+static ROUTER_LINK *Port[ROUTER_PORTS_MAX];
+static unsigned Port_Count;
+static ROUTER_FIFO Port_Queue[ROUTER_PORTS_MAX];
+static ROUTER_PACKET Packet[ROUTER_PACKETS];
+/* stack of unused packet numbers */
+static uint8_t Free_Packet[ROUTER_PACKETS];
+static uint8_t Free_Count;
+static ROUTER_ROUTE Route_Table[ROUTER_TABLE_SIZE];
+/* the ports, their queues, the packets and the routes: the tasks that
+   send and the one that routes share them, as do the port tasks;
+   it is never held while a datalink sends */
+static BACLOCK Router_Lock = BACLOCK_INITIALIZER;
+
+#if ROUTER_RX_TASKS
+/* a packet a port task has received */
+typedef struct router_rx_item {
+    uint8_t port;
+    uint8_t packet;
+} ROUTER_RX_ITEM;
+
+static TaskHandle_t RX_Task[ROUTER_PORTS_MAX];
+/* the packets each port may still receive before the router takes some */
+static SemaphoreHandle_t RX_Slots[ROUTER_PORTS_MAX];
+static QueueHandle_t RX_Queue;
+#endif
+
+static int router_packet_get(
+    void)
+{
+    int n = -1;
+
+    baclock_take(&Router_Lock);
+    if (Free_Count) {
+        n = Free_Packet[--Free_Count];
+    }
+    baclock_give(&Router_Lock);
+
+    return n;
+}
+
+static void router_packet_put(
+    uint8_t n)
+{
+    baclock_take(&Router_Lock);
+    Free_Packet[Free_Count++] = n;
+    baclock_give(&Router_Lock);
+}
+
+static int router_packet_copy(
+    uint8_t n)
+{
+    int m = router_packet_get();
+
+    if (m >= 0) {
+        Packet[m] = Packet[n];
+    }
+
+    return m;
+}
+
+static int router_port_of_net(
+    uint16_t net)
+{
+    unsigned port;
+
+    for (port = 0; port < Port_Count; port++) {
+        if (Port[port]->net == net) {
+            return (int) port;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Finds the route to a network behind another router.
+ *
+ * @param dnet - the network number
+ *
+ * @return the route, or NULL if none is known
+ */
+ROUTER_ROUTE *router_route_find(
+    uint16_t dnet)
+{
+    unsigned i;
+
+    if (dnet == 0) {
+        return NULL;
+    }
+    for (i = 0; i < ROUTER_TABLE_SIZE; i++) {
+        if (Route_Table[i].dnet == dnet) {
+            return &Route_Table[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* dnet is reached through the router at next_hop on the port */
+static void router_route_learn(
+    uint16_t dnet,
+    unsigned port,
+    BACNET_ADDRESS * next_hop)
+{
+    ROUTER_ROUTE *route = NULL;
+    unsigned i;
+
+    if ((dnet == 0) || (dnet == BACNET_BROADCAST_NETWORK) ||
+        (router_port_of_net(dnet) >= 0)) {
+        return;
+    }
+    route = router_route_find(dnet);
+    for (i = 0; !route && (i < ROUTER_TABLE_SIZE); i++) {
+        if (Route_Table[i].dnet == 0) {
+            route = &Route_Table[i];
+        }
+    }
+    if (route) {
+        route->dnet = dnet;
+        route->port = (uint8_t) port;
+        route->busy = false;
+        bacnet_address_copy(&route->next_hop, next_hop);
+        route->next_hop.net = 0;
+        route->next_hop.len = 0;
+    }
+}
+
+static bool router_route_usable(
+    ROUTER_ROUTE * route,
+    unsigned port)
+{
+    return (route && !route->busy && (route->port != port));
+}
+
+/* the full network address of a station on a port */
+static void router_origin(
+    BACNET_ADDRESS * origin,
+    uint16_t net,
+    BACNET_ADDRESS * mac)
+{
+    unsigned i;
+
+    memset(origin, 0, sizeof(BACNET_ADDRESS));
+    origin->net = net;
+    origin->len = mac->mac_len;
+    for (i = 0; (i < mac->mac_len) && (i < MAX_MAC_LEN); i++) {
+        origin->adr[i] = mac->mac[i];
+    }
+}
+
+/* the datalink address of a station given by its DADR, or the
+   broadcast address of the port for an empty DADR */
+static void router_mac(
+    BACNET_ADDRESS * mac,
+    unsigned port,
+    BACNET_ADDRESS * dest)
+{
+    unsigned i;
+
+    if (dest->len == 0) {
+        Port[port]->get_broadcast_address(mac);
+        return;
+    }
+    memset(mac, 0, sizeof(BACNET_ADDRESS));
+    mac->mac_len = dest->len;
+    for (i = 0; (i < dest->len) && (i < MAX_MAC_LEN); i++) {
+        mac->mac[i] = dest->adr[i];
+    }
+}
+
+static bool router_is_me(
+    BACNET_ADDRESS * dest)
+{
+    BACNET_ADDRESS me = { 0 };
+
+    Port[0]->get_my_address(&me);
+
+    return ((dest->len == me.mac_len) &&
+        (memcmp(dest->adr, me.mac, me.mac_len) == 0));
+}
+
+/**
+ * Replaces the NPCI of a packet with one encoded from dest, src and
+ * npdu_data.  The new NPCI is written to end where the old one ended, in
+ * the headroom if it is longer, so the APDU or network message data
+ * after it is not moved.
+ *
+ * @param pkt - the packet
+ * @param npci_len - length of the NPCI it has now
+ * @param dest - DNET and DADR, or NULL for none
+ * @param src - SNET and SADR, or NULL for none
+ * @param npdu_data - the rest of the NPCI
+ *
+ * @return true if the new NPCI fits
+ */
+static bool router_npci_rewrite(
+    ROUTER_PACKET * pkt,
+    uint16_t npci_len,
+    BACNET_ADDRESS * dest,
+    BACNET_ADDRESS * src,
+    BACNET_NPDU_DATA * npdu_data)
+{
+    uint8_t npci[MAX_NPDU] = { 0 };
+    unsigned start = pkt->offset + npci_len;
+    int len = 0;
+
+    len = npdu_encode_pdu(npci, dest, src, npdu_data);
+    if ((len <= 0) || ((unsigned) len > start)) {
+        return false;
+    }
+    start -= len;
+    memcpy(&pkt->buffer[start], npci, len);
+    pkt->length = pkt->length - npci_len + len;
+    pkt->offset = (uint16_t) start;
+    pkt->npdu_data = *npdu_data;
+
+    return true;
+}
+
+/* queues packet n to go out of a port to mac, or as a broadcast */
+static void router_enqueue(
+    unsigned port,
+    uint8_t n,
+    BACNET_ADDRESS * mac)
+{
+    ROUTER_FIFO *fifo = &Port_Queue[port];
+    ROUTER_PACKET *pkt = &Packet[n];
+
+    if (fifo->count >= ROUTER_QUEUE_SIZE) {
+        /* the port is backed up: drop it, as a router may */
+        router_packet_put(n);
+        return;
+    }
+    if (mac) {
+        bacnet_address_copy(&pkt->dest, mac);
+    } else {
+        Port[port]->get_broadcast_address(&pkt->dest);
+    }
+    fifo->packet[(fifo->head + fifo->count) % ROUTER_QUEUE_SIZE] = n;
+    fifo->count++;
+}
+
+/* Hands the queued packets of a port to its datalink, while it takes
+   them, unless another task is at it already - that one sends what is
+   queued meanwhile too.  Each packet is taken off the queue with
+   Router_Lock held, and sent once it is given. */
+static void router_port_drain(
+    unsigned port)
+{
+    ROUTER_FIFO *fifo = &Port_Queue[port];
+    ROUTER_LINK *link = Port[port];
+    ROUTER_PACKET *pkt = NULL;
+    uint8_t n = 0;
+
+    baclock_take(&Router_Lock);
+    if (fifo->draining) {
+        baclock_give(&Router_Lock);
+        return;
+    }
+    fifo->draining = true;
+    while (fifo->count) {
+        if (link->send_busy && link->send_busy()) {
+            break;
+        }
+        n = fifo->packet[fifo->head];
+        fifo->head = (fifo->head + 1) % ROUTER_QUEUE_SIZE;
+        fifo->count--;
+        baclock_give(&Router_Lock);
+        pkt = &Packet[n];
+        (void) link->send_pdu(&pkt->dest, &pkt->npdu_data,
+            &pkt->buffer[pkt->offset], pkt->length);
+        router_packet_put(n);
+        baclock_take(&Router_Lock);
+    }
+    fifo->draining = false;
+    baclock_give(&Router_Lock);
+}
+
+static void router_ports_drain(
+    void)
+{
+    unsigned port;
+
+    for (port = 0; port < Port_Count; port++) {
+        router_port_drain(port);
+    }
+}
+
+/**
+ * Returns the number of packets waiting to go out of a port.
+ *
+ * @param port - the port number
+ *
+ * @return packets in its queue
+ */
+unsigned router_queue_count(
+    unsigned port)
+{
+    unsigned count = 0;
+
+    baclock_take(&Router_Lock);
+    if (port < Port_Count) {
+        count = Port_Queue[port].count;
+    }
+    baclock_give(&Router_Lock);
+
+    return count;
+}
+
+/* queues a network layer message to go out of a port; it is sent
+   when the queue is next drained */
+static void router_send_network_message(
+    unsigned port,
+    BACNET_ADDRESS * mac,
+    BACNET_ADDRESS * dest,
+    BACNET_NETWORK_MESSAGE_TYPE message_type,
+    uint8_t * data,
+    unsigned data_len)
+{
+    ROUTER_PACKET *pkt = NULL;
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t *pdu = NULL;
+    int len = 0;
+    int n = 0;
+
+    n = router_packet_get();
+    if (n < 0) {
+        return;
+    }
+    pkt = &Packet[n];
+    pdu = &pkt->buffer[ROUTER_HEADROOM];
+    npdu_data.protocol_version = BACNET_PROTOCOL_VERSION;
+    npdu_data.network_layer_message = true;
+    npdu_data.network_message_type = message_type;
+    npdu_data.priority = MESSAGE_PRIORITY_NORMAL;
+    npdu_data.hop_count = HOP_COUNT_DEFAULT;
+    len = npdu_encode_pdu(pdu, dest, NULL, &npdu_data);
+    if (data_len) {
+        memcpy(&pdu[len], data, data_len);
+        len += data_len;
+    }
+    pkt->offset = ROUTER_HEADROOM;
+    pkt->length = (uint16_t) len;
+    pkt->npdu_data = npdu_data;
+    baclock_take(&Router_Lock);
+    router_enqueue(port, (uint8_t) n, mac);
+    baclock_give(&Router_Lock);
+}
+
+/* encodes the networks reachable from a port, except through it */
+static unsigned router_network_list(
+    uint8_t * data,
+    unsigned port)
+{
+    unsigned len = 0;
+    unsigned i;
+
+    for (i = 0; i < Port_Count; i++) {
+        if (i != port) {
+            len += encode_unsigned16(&data[len], Port[i]->net);
+        }
+    }
+    for (i = 0; i < ROUTER_TABLE_SIZE; i++) {
+        if (Route_Table[i].dnet && (Route_Table[i].port != port)) {
+            len += encode_unsigned16(&data[len], Route_Table[i].dnet);
+        }
+    }
+
+    return len;
+}
+
+/* asks the other ports for a router to dnet */
+static void router_who_is(
+    unsigned port,
+    uint16_t dnet)
+{
+    uint8_t data[2] = { 0 };
+    unsigned i;
+
+    (void) encode_unsigned16(data, dnet);
+    for (i = 0; i < Port_Count; i++) {
+        if (i != port) {
+            router_send_network_message(i, NULL, NULL,
+                NETWORK_MESSAGE_WHO_IS_ROUTER_TO_NETWORK, data, sizeof(data));
+        }
+    }
+}
+
+/* tells the station at mac that its NPDU to dnet went nowhere */
+static void router_reject(
+    unsigned port,
+    BACNET_ADDRESS * mac,
+    BACNET_ADDRESS * src,
+    uint8_t reason,
+    uint16_t dnet)
+{
+    uint8_t data[3] = { 0 };
+
+    data[0] = reason;
+    (void) encode_unsigned16(&data[1], dnet);
+    router_send_network_message(port, mac, src->net ? src : NULL,
+        NETWORK_MESSAGE_REJECT_MESSAGE_TO_NETWORK, data, sizeof(data));
+}
+
+/**
+ * Broadcasts I-Am-Router-To-Network on every port, with the networks
+ * reachable through each of the others.
+ */
+void router_announce(
+    void)
+{
+    uint8_t data[ROUTER_NETWORK_DATA_MAX] = { 0 };
+    unsigned len = 0;
+    unsigned port;
+
+    baclock_take(&Router_Lock);
+    for (port = 0; port < Port_Count; port++) {
+        len = router_network_list(data, port);
+        if (len) {
+            router_send_network_message(port, NULL, NULL,
+                NETWORK_MESSAGE_I_AM_ROUTER_TO_NETWORK, data, len);
+        }
+    }
+    baclock_give(&Router_Lock);
+    router_ports_drain();
+}
+
+/* handles a network layer message for the router itself */
+static void router_network_message(
+    unsigned port,
+    BACNET_ADDRESS * mac,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * data,
+    uint16_t data_len)
+{
+    uint8_t list[ROUTER_NETWORK_DATA_MAX] = { 0 };
+    ROUTER_ROUTE *route = NULL;
+    unsigned list_len = 0;
+    uint16_t dnet = 0;
+    int target = 0;
+    unsigned i;
+
+    switch (npdu_data->network_message_type) {
+        case NETWORK_MESSAGE_WHO_IS_ROUTER_TO_NETWORK:
+            if (data_len >= 2) {
+                (void) decode_unsigned16(data, &dnet);
+                target = router_port_of_net(dnet);
+                route = router_route_find(dnet);
+                if (((target >= 0) && ((unsigned) target != port)) ||
+                    router_route_usable(route, port)) {
+                    list_len = encode_unsigned16(list, dnet);
+                } else if ((target < 0) && !route) {
+                    router_who_is(port, dnet);
+                }
+            } else {
+                list_len = router_network_list(list, port);
+            }
+            if (list_len) {
+                router_send_network_message(port, NULL, NULL,
+                    NETWORK_MESSAGE_I_AM_ROUTER_TO_NETWORK, list, list_len);
+            }
+            break;
+        case NETWORK_MESSAGE_I_AM_ROUTER_TO_NETWORK:
+            for (i = 0; (i + 1) < data_len; i += 2) {
+                (void) decode_unsigned16(&data[i], &dnet);
+                if (router_port_of_net(dnet) < 0) {
+                    router_route_learn(dnet, port, mac);
+                    list_len += encode_unsigned16(&list[list_len], dnet);
+                }
+            }
+            /* pass the news on to the other ports */
+            for (i = 0; list_len && (i < Port_Count); i++) {
+                if (i != port) {
+                    router_send_network_message(i, NULL, NULL,
+                        NETWORK_MESSAGE_I_AM_ROUTER_TO_NETWORK, list,
+                        list_len);
+                }
+            }
+            break;
+        case NETWORK_MESSAGE_REJECT_MESSAGE_TO_NETWORK:
+            if ((data_len >= 3) && (data[0] == NETWORK_REJECT_NO_ROUTE)) {
+                (void) decode_unsigned16(&data[1], &dnet);
+                route = router_route_find(dnet);
+                if (route) {
+                    route->dnet = 0;
+                }
+            }
+            break;
+        case NETWORK_MESSAGE_ROUTER_BUSY_TO_NETWORK:
+        case NETWORK_MESSAGE_ROUTER_AVAILABLE_TO_NETWORK:
+            for (i = 0; (i + 1) < data_len; i += 2) {
+                (void) decode_unsigned16(&data[i], &dnet);
+                route = router_route_find(dnet);
+                if (route && (route->port == port)) {
+                    route->busy =
+                        (npdu_data->network_message_type ==
+                        NETWORK_MESSAGE_ROUTER_BUSY_TO_NETWORK);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* copies the NPDU of a packet for the device */
+static uint16_t router_deliver(
+    ROUTER_PACKET * pkt,
+    BACNET_ADDRESS * mac,
+    BACNET_ADDRESS * src,
+    uint8_t * pdu,
+    uint16_t max_pdu)
+{
+    if (pkt->npdu_data.network_layer_message || (pkt->length > max_pdu)) {
+        return 0;
+    }
+    bacnet_address_copy(src, mac);
+    memcpy(pdu, &pkt->buffer[pkt->offset], pkt->length);
+
+    return pkt->length;
+}
+
+/**
+ * Routes a packet received on a port.  The packet is queued on the port
+ * it leaves by, or returned to the free packets.
+ *
+ * @param port - the port it came in on
+ * @param mac - its datalink source
+ * @param n - the packet
+ * @param src - the source, for the device
+ * @param pdu - the NPDU, for the device
+ * @param max_pdu - room in pdu[]
+ *
+ * @return the length of the NPDU in pdu[] if it is for the device too
+ */
+static uint16_t router_handler(
+    unsigned port,
+    BACNET_ADDRESS * mac,
+    uint8_t n,
+    BACNET_ADDRESS * src,
+    uint8_t * pdu,
+    uint16_t max_pdu)
+{
+    ROUTER_PACKET *pkt = &Packet[n];
+    uint8_t *npdu = &pkt->buffer[pkt->offset];
+    BACNET_ADDRESS npdu_dest = { 0 };
+    BACNET_ADDRESS npdu_src = { 0 };
+    BACNET_ADDRESS origin = { 0 };
+    BACNET_ADDRESS next = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    ROUTER_ROUTE *route = NULL;
+    uint16_t pdu_len = 0;
+    int npci_len = 0;
+    int target = -1;
+    int m = 0;
+    unsigned i;
+
+    if ((pkt->length < 2) || (npdu[0] != BACNET_PROTOCOL_VERSION)) {
+        router_packet_put(n);
+        return 0;
+    }
+    npci_len = npdu_decode(npdu, &npdu_dest, &npdu_src, &npdu_data);
+    if ((npci_len <= 0) || (npci_len > pkt->length)) {
+        router_packet_put(n);
+        return 0;
+    }
+    pkt->npdu_data = npdu_data;
+    if (npdu_src.net) {
+        router_route_learn(npdu_src.net, port, mac);
+        origin = npdu_src;
+    } else {
+        router_origin(&origin, Port[port]->net, mac);
+    }
+    if (npdu_data.network_layer_message && ((npdu_dest.net == 0) ||
+            (npdu_dest.net == BACNET_BROADCAST_NETWORK) ||
+            (npdu_dest.net == Port[port]->net))) {
+        router_network_message(port, mac, &npdu_data, &npdu[npci_len],
+            (uint16_t) (pkt->length - npci_len));
+    }
+    if ((npdu_dest.net == 0) || (npdu_dest.net == Port[port]->net)) {
+        /* for the network it came from, where the device may be too */
+        if (port == 0) {
+            pdu_len = router_deliver(pkt, mac, src, pdu, max_pdu);
+        } else if (router_npci_rewrite(pkt, (uint16_t) npci_len, NULL,
+                &origin, &npdu_data)) {
+            pdu_len = router_deliver(pkt, mac, src, pdu, max_pdu);
+        }
+        router_packet_put(n);
+        return pdu_len;
+    }
+    if (npdu_dest.net == BACNET_BROADCAST_NETWORK) {
+        if (port == 0) {
+            pdu_len = router_deliver(pkt, mac, src, pdu, max_pdu);
+        }
+        if (npdu_data.hop_count <= 1) {
+            router_packet_put(n);
+            return pdu_len;
+        }
+        npdu_data.hop_count--;
+        if (!router_npci_rewrite(pkt, (uint16_t) npci_len, &npdu_dest,
+                &origin, &npdu_data)) {
+            router_packet_put(n);
+            return pdu_len;
+        }
+        if (port != 0) {
+            pdu_len = router_deliver(pkt, mac, src, pdu, max_pdu);
+        }
+        /* out of every other port, the last one taking this packet */
+        for (i = 0; i < Port_Count; i++) {
+            if (i == port) {
+                continue;
+            }
+            if (target >= 0) {
+                m = router_packet_copy(n);
+                if (m >= 0) {
+                    router_enqueue((unsigned) target, (uint8_t) m, NULL);
+                }
+            }
+            target = (int) i;
+        }
+        if (target >= 0) {
+            router_enqueue((unsigned) target, n, NULL);
+        } else {
+            router_packet_put(n);
+        }
+        return pdu_len;
+    }
+    target = router_port_of_net(npdu_dest.net);
+    if (target >= 0) {
+        /* a network of ours: the last router on the way */
+        if (!router_npci_rewrite(pkt, (uint16_t) npci_len, NULL, &origin,
+                &npdu_data)) {
+            router_packet_put(n);
+            return 0;
+        }
+        if ((target == 0) && ((npdu_dest.len == 0) ||
+                router_is_me(&npdu_dest))) {
+            pdu_len = router_deliver(pkt, mac, src, pdu, max_pdu);
+            if (npdu_dest.len) {
+                router_packet_put(n);
+                return pdu_len;
+            }
+        }
+        router_mac(&next, (unsigned) target, &npdu_dest);
+        router_enqueue((unsigned) target, n, &next);
+        return pdu_len;
+    }
+    route = router_route_find(npdu_dest.net);
+    if (router_route_usable(route, port) && (npdu_data.hop_count > 1)) {
+        npdu_data.hop_count--;
+        if (router_npci_rewrite(pkt, (uint16_t) npci_len, &npdu_dest,
+                &origin, &npdu_data)) {
+            router_enqueue(route->port, n, &route->next_hop);
+            return 0;
+        }
+    } else if (route && route->busy) {
+        router_reject(port, mac, &npdu_src, NETWORK_REJECT_ROUTER_BUSY,
+            npdu_dest.net);
+    } else if (!route) {
+        router_reject(port, mac, &npdu_src, NETWORK_REJECT_NO_ROUTE,
+            npdu_dest.net);
+        router_who_is(port, npdu_dest.net);
+    }
+    router_packet_put(n);
+
+    return 0;
+}
+
+/* sends an NPDU of the device out of a port with a new NPCI */
+static int router_send_npci(
+    unsigned port,
+    BACNET_ADDRESS * mac,
+    BACNET_ADDRESS * dest,
+    BACNET_ADDRESS * src,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * data,
+    unsigned data_len)
+{
+    uint8_t pdu[MAX_NPDU + MAX_PDU] = { 0 };
+    BACNET_ADDRESS broadcast = { 0 };
+    int len = 0;
+
+    len = npdu_encode_pdu(pdu, dest, src, npdu_data);
+    if ((len <= 0) || ((len + data_len) > sizeof(pdu))) {
+        return -1;
+    }
+    memcpy(&pdu[len], data, data_len);
+    if (!mac) {
+        Port[port]->get_broadcast_address(&broadcast);
+        mac = &broadcast;
+    }
+
+    return Port[port]->send_pdu(mac, npdu_data, pdu, len + data_len);
+}
+
+/**
+ * Sends an NPDU of the device.  It goes straight to the datalink of the
+ * port it leaves by, as it would without the router: with DNET and DADR
+ * dropped on the last hop, and SNET and SADR added when it leaves by a
+ * port other than the one the device is on.  Router_Lock is only held
+ * to look up the route.
+ *
+ * @param dest - the destination address
+ * @param npdu_data - network information
+ * @param pdu - the NPDU, already encoded for dest
+ * @param pdu_len - number of octets in the NPDU
+ *
+ * @return number of octets sent, or negative on failure
+ */
+int router_send_pdu(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    BACNET_ADDRESS npdu_dest = { 0 };
+    BACNET_ADDRESS npdu_src = { 0 };
+    BACNET_ADDRESS origin = { 0 };
+    BACNET_ADDRESS me = { 0 };
+    BACNET_ADDRESS mac = { 0 };
+    BACNET_NPDU_DATA decoded = { 0 };
+    ROUTER_ROUTE *route = NULL;
+    bool routed = false;
+    bool unknown = false;
+    int bytes_sent = -1;
+    int npci_len = 0;
+    int target = 0;
+    unsigned i;
+
+    if (Port_Count == 0) {
+        return -1;
+    }
+    if (!dest || (dest->net == 0)) {
+        return Port[0]->send_pdu(dest, npdu_data, pdu, pdu_len);
+    }
+    npci_len = npdu_decode(pdu, &npdu_dest, &npdu_src, &decoded);
+    if ((npci_len <= 0) || ((unsigned) npci_len > pdu_len)) {
+        return -1;
+    }
+    Port[0]->get_my_address(&me);
+    router_origin(&origin, Port[0]->net, &me);
+    if (dest->net == BACNET_BROADCAST_NETWORK) {
+        bytes_sent = Port[0]->send_pdu(dest, npdu_data, pdu, pdu_len);
+        for (i = 1; i < Port_Count; i++) {
+            (void) router_send_npci(i, NULL, &npdu_dest, &origin, &decoded,
+                &pdu[npci_len], pdu_len - npci_len);
+        }
+        return bytes_sent;
+    }
+    target = router_port_of_net(dest->net);
+    if (target >= 0) {
+        router_mac(&mac, (unsigned) target, dest);
+        return router_send_npci((unsigned) target, &mac, NULL,
+            (target == 0) ? NULL : &origin, &decoded, &pdu[npci_len],
+            pdu_len - npci_len);
+    }
+    /* the route is copied, since it may change once the lock is given */
+    baclock_take(&Router_Lock);
+    route = router_route_find(dest->net);
+    if (route && !route->busy) {
+        target = route->port;
+        bacnet_address_copy(&mac, &route->next_hop);
+        routed = true;
+    } else if (!route) {
+        unknown = true;
+    }
+    baclock_give(&Router_Lock);
+    if (routed) {
+        return router_send_npci((unsigned) target, &mac, &npdu_dest,
+            (target == 0) ? NULL : &origin, &decoded, &pdu[npci_len],
+            pdu_len - npci_len);
+    }
+    if (unknown) {
+        router_who_is(Port_Count, dest->net);
+        router_ports_drain();
+    }
+
+    return -1;
+}
+
+#if ROUTER_RX_TASKS
+/* true while a port has packets waiting to go out */
+static bool router_queued(
+    void)
+{
+    unsigned port;
+
+    for (port = 0; port < Port_Count; port++) {
+        if (Port_Queue[port].count) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* receives on one port, for as long as the port has a free slot */
+static void router_rx_task(
+    void *pvParameters)
+{
+    unsigned port = (unsigned) (uintptr_t) pvParameters;
+    ROUTER_LINK *link = Port[port];
+    ROUTER_PACKET *pkt = NULL;
+    ROUTER_RX_ITEM item;
+    int n = 0;
+
+    item.port = (uint8_t) port;
+    for (;;) {
+        (void) xSemaphoreTake(RX_Slots[port], portMAX_DELAY);
+        n = router_packet_get();
+        if (n < 0) {
+            /* the pool is sized so this does not happen */
+            (void) xSemaphoreGive(RX_Slots[port]);
+            vTaskDelay(pdMS_TO_TICKS(ROUTER_POLL_MS));
+            continue;
+        }
+        pkt = &Packet[n];
+        pkt->offset = ROUTER_HEADROOM;
+        do {
+            pkt->length =
+                link->receive(&pkt->src, &pkt->buffer[ROUTER_HEADROOM],
+                MAX_MPDU, ROUTER_RX_WAIT_MS);
+        } while (pkt->length == 0);
+        item.packet = (uint8_t) n;
+        (void) xQueueSend(RX_Queue, &item, portMAX_DELAY);
+    }
+}
+
+static void router_rx_stop(
+    void)
+{
+    unsigned port;
+
+    for (port = 0; port < ROUTER_PORTS_MAX; port++) {
+        if (RX_Task[port]) {
+            vTaskDelete(RX_Task[port]);
+            RX_Task[port] = NULL;
+        }
+        if (RX_Slots[port]) {
+            vSemaphoreDelete(RX_Slots[port]);
+            RX_Slots[port] = NULL;
+        }
+    }
+    if (RX_Queue) {
+        vQueueDelete(RX_Queue);
+        RX_Queue = NULL;
+    }
+}
+
+/* starts a receive task for each port added */
+static bool router_rx_start(
+    void)
+{
+    unsigned port;
+
+    RX_Queue =
+        xQueueCreate(ROUTER_PORTS_MAX * ROUTER_RX_QUEUE_SIZE,
+        sizeof(ROUTER_RX_ITEM));
+    if (!RX_Queue) {
+        router_rx_stop();
+        return false;
+    }
+    for (port = 0; port < Port_Count; port++) {
+        RX_Slots[port] =
+            xSemaphoreCreateCounting(ROUTER_RX_QUEUE_SIZE,
+            ROUTER_RX_QUEUE_SIZE);
+        if (!RX_Slots[port] ||
+            (xTaskCreate(router_rx_task, "bacnet_port_rx",
+                    ROUTER_RX_TASK_STACK, (void *) (uintptr_t) port,
+                    ROUTER_RX_TASK_PRIORITY, &RX_Task[port]) != pdPASS)) {
+            router_rx_stop();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Runs the router until an NPDU for the device arrives, or for about
+ * timeout milliseconds.  The ports receive in tasks of their own; what
+ * they received is routed in turn, and the port queues are drained
+ * at least every ROUTER_POLL_MS while they hold packets.
+ *
+ * @param src - returns the source address
+ * @param pdu - returns the NPDU
+ * @param max_pdu - room in pdu[]
+ * @param timeout - milliseconds to run; 0 to route what is waiting
+ *
+ * @return the number of octets in the NPDU, or zero if none arrived
+ */
+uint16_t router_receive(
+    BACNET_ADDRESS * src,
+    uint8_t * pdu,
+    uint16_t max_pdu,
+    unsigned timeout)
+{
+    BACNET_ADDRESS mac = { 0 };
+    ROUTER_RX_ITEM item;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t limit = pdMS_TO_TICKS(timeout);
+    TickType_t elapsed = 0;
+    TickType_t wait = 0;
+    uint16_t pdu_len = 0;
+    unsigned port;
+
+    if (!RX_Queue) {
+        return 0;
+    }
+    do {
+        /* never held while sending or waiting, so that the tasks
+           sending get in */
+        router_ports_drain();
+        baclock_take(&Router_Lock);
+        wait = limit - elapsed;
+        if (router_queued() && (wait > pdMS_TO_TICKS(ROUTER_POLL_MS))) {
+            wait = pdMS_TO_TICKS(ROUTER_POLL_MS);
+        }
+        baclock_give(&Router_Lock);
+        if (xQueueReceive(RX_Queue, &item, wait) == pdTRUE) {
+            baclock_take(&Router_Lock);
+            /* the packet may be reused before the handler is done
+               with its source */
+            bacnet_address_copy(&mac, &Packet[item.packet].src);
+            pdu_len =
+                router_handler(item.port, &mac, item.packet, src, pdu,
+                max_pdu);
+            baclock_give(&Router_Lock);
+            (void) xSemaphoreGive(RX_Slots[item.port]);
+            /* what it forwarded or answered goes out now */
+            router_ports_drain();
+            if (pdu_len) {
+                return pdu_len;
+            }
+        }
+        elapsed = xTaskGetTickCount() - start;
+    } while (elapsed < limit);
+
+    return 0;
+}
+#else
+/**
+ * Runs the router until an NPDU for the device arrives, or for about
+ * timeout milliseconds.  Each port in turn has its queue drained and is
+ * waited on for ROUTER_POLL_MS; what it receives is routed.
+ *
+ * @param src - returns the source address
+ * @param pdu - returns the NPDU
+ * @param max_pdu - room in pdu[]
+ * @param timeout - milliseconds to run; 0 for one turn of the ports
+ *
+ * @return the number of octets in the NPDU, or zero if none arrived
+ */
+uint16_t router_receive(
+    BACNET_ADDRESS * src,
+    uint8_t * pdu,
+    uint16_t max_pdu,
+    unsigned timeout)
+{
+    BACNET_ADDRESS mac = { 0 };
+    ROUTER_PACKET *pkt = NULL;
+    unsigned wait = timeout ? ROUTER_POLL_MS : 0;
+    unsigned elapsed = 0;
+    uint16_t pdu_len = 0;
+    unsigned port;
+    int n = 0;
+
+    do {
+        for (port = 0; port < Port_Count; port++) {
+            /* never held while sending or waiting, so that the tasks
+               sending get in */
+            router_port_drain(port);
+            n = router_packet_get();
+            if (n < 0) {
+                continue;
+            }
+            pkt = &Packet[n];
+            pkt->offset = ROUTER_HEADROOM;
+            pkt->length =
+                Port[port]->receive(&mac, &pkt->buffer[ROUTER_HEADROOM],
+                MAX_MPDU, wait);
+            if (pkt->length == 0) {
+                router_packet_put((uint8_t) n);
+                continue;
+            }
+            baclock_take(&Router_Lock);
+            pdu_len =
+                router_handler(port, &mac, (uint8_t) n, src, pdu, max_pdu);
+            baclock_give(&Router_Lock);
+            /* what it forwarded or answered goes out now */
+            router_ports_drain();
+            if (pdu_len) {
+                return pdu_len;
+            }
+        }
+        elapsed += wait * Port_Count;
+    } while (elapsed < timeout);
+
+    return 0;
+}
+#endif
+
+void router_get_broadcast_address(
+    BACNET_ADDRESS * dest)
+{
+    if (Port_Count) {
+        Port[0]->get_broadcast_address(dest);
+    }
+}
+
+void router_get_my_address(
+    BACNET_ADDRESS * my_address)
+{
+    if (Port_Count) {
+        Port[0]->get_my_address(my_address);
+    }
+}
+
+/**
+ * Forgets the ports, the routes and the queued packets.
+ */
+void router_ports_init(
+    void)
+{
+    unsigned i;
+
+    baclock_take(&Router_Lock);
+    Port_Count = 0;
+    memset(Port_Queue, 0, sizeof(Port_Queue));
+    memset(Route_Table, 0, sizeof(Route_Table));
+    for (i = 0; i < ROUTER_PACKETS; i++) {
+        Free_Packet[i] = (uint8_t) i;
+    }
+    Free_Count = ROUTER_PACKETS;
+    baclock_give(&Router_Lock);
+}
+
+/**
+ * Adds a port; the device is on the first one added.
+ *
+ * @param link - the datalink of the port and its network number
+ *
+ * @return the port number, or -1 if there is no room
+ */
+int router_port_add(
+    ROUTER_LINK * link)
+{
+    if (!link || (Port_Count >= ROUTER_PORTS_MAX)) {
+        return -1;
+    }
+    Port[Port_Count] = link;
+
+    return (int) Port_Count++;
+}
+
+#if defined(BACDL_ROUTER)
+static ROUTER_LINK BIP_Link = {
+    .net = ROUTER_BIP_NET,
+#if defined(BBMD_ENABLED) && BBMD_ENABLED
+    .send_pdu = bvlc_send_pdu,
+    .receive = bvlc_receive,
+#else
+    .send_pdu = bip_send_pdu,
+    .receive = bip_receive,
+#endif
+    .get_broadcast_address = bip_get_broadcast_address,
+    .get_my_address = bip_get_my_address,
+    .send_busy = NULL
+};
+
+static ROUTER_LINK MSTP_Link = {
+    .net = ROUTER_MSTP_NET,
+    .send_pdu = dlmstp_send_pdu,
+    .receive = dlmstp_receive,
+    .get_broadcast_address = dlmstp_get_broadcast_address,
+    .get_my_address = dlmstp_get_my_address,
+    .send_busy = dlmstp_send_pdu_queue_full
+};
+
+#if defined(BACDL_BIP6)
+static ROUTER_LINK BIP6_Link = {
+    .net = ROUTER_BIP6_NET,
+    .send_pdu = bip6_send_pdu,
+    .receive = bip6_receive,
+    .get_broadcast_address = bip6_get_broadcast_address,
+    .get_my_address = bip6_get_my_address,
+    .send_busy = NULL
+};
+#endif
+
+/**
+ * Starts the datalinks, with the device on BACnet/IP, and tells their
+ * networks about the router.
+ *
+ * @param ifname - the network interface of BACnet/IP
+ *
+ * @return true if all the datalinks are running
+ */
+bool router_init(
+    char *ifname)
+{
+    router_ports_init();
+    if (!bip_init(ifname)) {
+        return false;
+    }
+    (void) router_port_add(&BIP_Link);
+    if (!dlmstp_init(NULL)) {
+        router_cleanup();
+        return false;
+    }
+    (void) router_port_add(&MSTP_Link);
+#if defined(BACDL_BIP6)
+    if (!bip6_init(NULL)) {
+        router_cleanup();
+        return false;
+    }
+    (void) router_port_add(&BIP6_Link);
+#endif
+#if ROUTER_RX_TASKS
+    if (!router_rx_start()) {
+        router_cleanup();
+        return false;
+    }
+#endif
+    router_announce();
+
+    return true;
+}
+
+void router_cleanup(
+    void)
+{
+#if ROUTER_RX_TASKS
+    router_rx_stop();
+#endif
+#if defined(BACDL_BIP6)
+    bip6_cleanup();
+#endif
+    dlmstp_cleanup();
+    bip_cleanup();
+    router_ports_init();
+}
+#endif
+
+#ifdef TEST
+#include <assert.h>
+#include "ctest.h"
+
+/* Two datalinks that keep what is sent and give what the test
+   puts in: port 0 like BACnet/IP on network 1, with the device,
+   and port 1 like MS/TP on network 2. */
+#define TEST_FRAMES 8
+
+struct test_frame {
+    BACNET_ADDRESS addr;
+    uint16_t len;
+    uint8_t pdu[MAX_PDU];
+};
+
+struct test_link {
+    ROUTER_LINK link;
+    uint8_t mac_len;
+    uint8_t mac[MAX_MAC_LEN];
+    bool busy;
+    struct test_frame rx[TEST_FRAMES];
+    unsigned rx_head;
+    unsigned rx_count;
+    struct test_frame tx[TEST_FRAMES];
+    unsigned tx_count;
+};
+
+static struct test_link Test_Link[2];
+/* frames a datalink was handed with Router_Lock held */
+static unsigned Test_Sent_Locked;
+
+static int test_send(
+    struct test_link *tl,
+    BACNET_ADDRESS * dest,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    struct test_frame *frame = NULL;
+
+    if (Router_Lock.depth) {
+        Test_Sent_Locked++;
+    }
+    if (tl->tx_count >= TEST_FRAMES) {
+        return -1;
+    }
+    frame = &tl->tx[tl->tx_count++];
+    bacnet_address_copy(&frame->addr, dest);
+    memcpy(frame->pdu, pdu, pdu_len);
+    frame->len = (uint16_t) pdu_len;
+
+    return (int) pdu_len;
+}
+
+static uint16_t test_receive(
+    struct test_link *tl,
+    BACNET_ADDRESS * src,
+    uint8_t * pdu,
+    uint16_t max_pdu)
+{
+    struct test_frame *frame = NULL;
+
+    if ((tl->rx_count == 0) || (tl->rx[tl->rx_head].len > max_pdu)) {
+        return 0;
+    }
+    frame = &tl->rx[tl->rx_head];
+    tl->rx_head = (tl->rx_head + 1) % TEST_FRAMES;
+    tl->rx_count--;
+    bacnet_address_copy(src, &frame->addr);
+    memcpy(pdu, frame->pdu, frame->len);
+
+    return frame->len;
+}
+
+static void test_broadcast(
+    struct test_link *tl,
+    BACNET_ADDRESS * dest)
+{
+    memset(dest, 0, sizeof(BACNET_ADDRESS));
+    dest->mac_len = (tl == &Test_Link[0]) ? 6 : 0;
+    memset(dest->mac, 0xFF, dest->mac_len);
+    dest->net = BACNET_BROADCAST_NETWORK;
+}
+
+static void test_my_address(
+    struct test_link *tl,
+    BACNET_ADDRESS * my_address)
+{
+    memset(my_address, 0, sizeof(BACNET_ADDRESS));
+    my_address->mac_len = tl->mac_len;
+    memcpy(my_address->mac, tl->mac, tl->mac_len);
+}
+
+static int test_send_0(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    (void) npdu_data;
+    return test_send(&Test_Link[0], dest, pdu, pdu_len);
+}
+
+static int test_send_1(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    (void) npdu_data;
+    return test_send(&Test_Link[1], dest, pdu, pdu_len);
+}
+
+static uint16_t test_receive_0(
+    BACNET_ADDRESS * src,
+    uint8_t * pdu,
+    uint16_t max_pdu,
+    unsigned timeout)
+{
+    (void) timeout;
+    return test_receive(&Test_Link[0], src, pdu, max_pdu);
+}
+
+static uint16_t test_receive_1(
+    BACNET_ADDRESS * src,
+    uint8_t * pdu,
+    uint16_t max_pdu,
+    unsigned timeout)
+{
+    (void) timeout;
+    return test_receive(&Test_Link[1], src, pdu, max_pdu);
+}
+
+static void test_broadcast_0(
+    BACNET_ADDRESS * dest)
+{
+    test_broadcast(&Test_Link[0], dest);
+}
+
+static void test_broadcast_1(
+    BACNET_ADDRESS * dest)
+{
+    test_broadcast(&Test_Link[1], dest);
+}
+
+static void test_my_address_0(
+    BACNET_ADDRESS * my_address)
+{
+    test_my_address(&Test_Link[0], my_address);
+}
+
+static void test_my_address_1(
+    BACNET_ADDRESS * my_address)
+{
+    test_my_address(&Test_Link[1], my_address);
+}
+
+static bool test_busy_1(
+    void)
+{
+    return Test_Link[1].busy;
+}
+
+static const uint8_t Test_IP_Me[6] = { 192, 168, 0, 10, 0xBA, 0xC0 };
+static const uint8_t Test_IP_Peer[6] = { 192, 168, 0, 20, 0xBA, 0xC0 };
+static const uint8_t Test_IP_Router[6] = { 192, 168, 0, 30, 0xBA, 0xC0 };
+/* a ReadProperty request: the APDU the router must not touch */
+static const uint8_t Test_APDU[] = {
+    0x00, 0x05, 0x01, 0x0C, 0x0C, 0x00, 0x00, 0x00, 0x01, 0x19, 0x55
+};
+
+static void test_setup(
+    void)
+{
+    memset(Test_Link, 0, sizeof(Test_Link));
+    Test_Sent_Locked = 0;
+    Test_Link[0].link.net = 1;
+    Test_Link[0].link.send_pdu = test_send_0;
+    Test_Link[0].link.receive = test_receive_0;
+    Test_Link[0].link.get_broadcast_address = test_broadcast_0;
+    Test_Link[0].link.get_my_address = test_my_address_0;
+    Test_Link[0].mac_len = 6;
+    memcpy(Test_Link[0].mac, Test_IP_Me, 6);
+    Test_Link[1].link.net = 2;
+    Test_Link[1].link.send_pdu = test_send_1;
+    Test_Link[1].link.receive = test_receive_1;
+    Test_Link[1].link.get_broadcast_address = test_broadcast_1;
+    Test_Link[1].link.get_my_address = test_my_address_1;
+    Test_Link[1].link.send_busy = test_busy_1;
+    Test_Link[1].mac_len = 1;
+    Test_Link[1].mac[0] = 1;
+    router_ports_init();
+    (void) router_port_add(&Test_Link[0].link);
+    (void) router_port_add(&Test_Link[1].link);
+}
+
+static void test_address(
+    BACNET_ADDRESS * addr,
+    uint16_t net,
+    const uint8_t * adr,
+    uint8_t len)
+{
+    memset(addr, 0, sizeof(BACNET_ADDRESS));
+    addr->net = net;
+    addr->len = len;
+    if (len) {
+        memcpy(addr->adr, adr, len);
+    }
+}
+
+/* puts an NPDU with the test APDU, or a network message, on a link */
+static void test_inject(
+    unsigned port,
+    const uint8_t * mac,
+    uint8_t mac_len,
+    BACNET_ADDRESS * dest,
+    BACNET_ADDRESS * src,
+    uint8_t hop_count,
+    int message_type,
+    const uint8_t * data,
+    unsigned data_len)
+{
+    struct test_link *tl = &Test_Link[port];
+    struct test_frame *frame = NULL;
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    int len = 0;
+
+    assert(tl->rx_count < TEST_FRAMES);
+    frame = &tl->rx[(tl->rx_head + tl->rx_count) % TEST_FRAMES];
+    tl->rx_count++;
+    memset(&frame->addr, 0, sizeof(BACNET_ADDRESS));
+    frame->addr.mac_len = mac_len;
+    memcpy(frame->addr.mac, mac, mac_len);
+    npdu_data.protocol_version = BACNET_PROTOCOL_VERSION;
+    npdu_data.priority = MESSAGE_PRIORITY_NORMAL;
+    npdu_data.hop_count = hop_count;
+    if (message_type >= 0) {
+        npdu_data.network_layer_message = true;
+        npdu_data.network_message_type =
+            (BACNET_NETWORK_MESSAGE_TYPE) message_type;
+    } else {
+        npdu_data.data_expecting_reply = true;
+        data = Test_APDU;
+        data_len = sizeof(Test_APDU);
+    }
+    len = npdu_encode_pdu(frame->pdu, dest, src, &npdu_data);
+    memcpy(&frame->pdu[len], data, data_len);
+    frame->len = (uint16_t) (len + data_len);
+}
+
+/* decodes what went out and checks that the APDU is the test APDU */
+static void test_sent(
+    Test * pTest,
+    struct test_frame *frame,
+    BACNET_ADDRESS * dest,
+    BACNET_ADDRESS * src,
+    BACNET_NPDU_DATA * npdu_data)
+{
+    int len = 0;
+
+    memset(dest, 0, sizeof(BACNET_ADDRESS));
+    memset(src, 0, sizeof(BACNET_ADDRESS));
+    len = npdu_decode(frame->pdu, dest, src, npdu_data);
+    ct_test(pTest, len > 0);
+    if (!npdu_data->network_layer_message) {
+        ct_test(pTest, (frame->len - len) == sizeof(Test_APDU));
+        ct_test(pTest, memcmp(&frame->pdu[len], Test_APDU,
+                sizeof(Test_APDU)) == 0);
+    }
+}
+
+static void testRouterForward(
+    Test * pTest)
+{
+    BACNET_ADDRESS dest = { 0 }, src = { 0 }, addr = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t pdu[MAX_PDU] = { 0 };
+    uint8_t mac = 5;
+    uint16_t len = 0;
+
+    test_setup();
+    /* MS/TP station 5 to a station on BACnet/IP */
+    test_address(&addr, 1, Test_IP_Peer, 6);
+    test_inject(1, &mac, 1, &addr, NULL, 255, -1, NULL, 0);
+    len = router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, len == 0);
+    len = router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, Test_Link[0].tx_count == 1);
+    ct_test(pTest, Test_Link[0].tx[0].addr.mac_len == 6);
+    ct_test(pTest, memcmp(Test_Link[0].tx[0].addr.mac, Test_IP_Peer, 6) == 0);
+    test_sent(pTest, &Test_Link[0].tx[0], &dest, &src, &npdu_data);
+    ct_test(pTest, dest.net == 0);
+    ct_test(pTest, src.net == 2);
+    ct_test(pTest, src.len == 1);
+    ct_test(pTest, src.adr[0] == 5);
+    ct_test(pTest, npdu_data.data_expecting_reply);
+
+    /* a station on BACnet/IP to MS/TP station 7 */
+    mac = 7;
+    test_address(&addr, 2, &mac, 1);
+    test_inject(0, Test_IP_Peer, 6, &addr, NULL, 255, -1, NULL, 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, Test_Link[1].tx_count == 1);
+    ct_test(pTest, Test_Link[1].tx[0].addr.mac_len == 1);
+    ct_test(pTest, Test_Link[1].tx[0].addr.mac[0] == 7);
+    test_sent(pTest, &Test_Link[1].tx[0], &dest, &src, &npdu_data);
+    ct_test(pTest, dest.net == 0);
+    ct_test(pTest, src.net == 1);
+    ct_test(pTest, src.len == 6);
+    ct_test(pTest, memcmp(src.adr, Test_IP_Peer, 6) == 0);
+
+    /* a global broadcast from MS/TP: the device and BACnet/IP get it */
+    mac = 5;
+    test_address(&addr, BACNET_BROADCAST_NETWORK, NULL, 0);
+    test_inject(1, &mac, 1, &addr, NULL, 255, -1, NULL, 0);
+    len = router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, len > 0);
+    memset(&src, 0, sizeof(src));
+    ct_test(pTest, npdu_decode(pdu, &dest, &src, &npdu_data) > 0);
+    ct_test(pTest, src.net == 2);
+    ct_test(pTest, src.adr[0] == 5);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, Test_Link[0].tx_count == 2);
+    ct_test(pTest, Test_Link[0].tx[1].addr.net == BACNET_BROADCAST_NETWORK);
+    test_sent(pTest, &Test_Link[0].tx[1], &dest, &src, &npdu_data);
+    ct_test(pTest, dest.net == BACNET_BROADCAST_NETWORK);
+    ct_test(pTest, npdu_data.hop_count == 254);
+    ct_test(pTest, src.net == 2);
+
+    /* its hops used up, a global broadcast goes no further */
+    test_inject(1, &mac, 1, &addr, NULL, 1, -1, NULL, 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, Test_Link[0].tx_count == 2);
+    ct_test(pTest, Test_Sent_Locked == 0);
+}
+
+static void testRouterDevice(
+    Test * pTest)
+{
+    BACNET_ADDRESS dest = { 0 }, src = { 0 }, addr = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t pdu[MAX_PDU] = { 0 };
+    uint8_t mac = 5;
+    uint16_t len = 0;
+    int npdu_len = 0;
+
+    test_setup();
+    /* MS/TP station 5 to the device */
+    test_address(&addr, 1, Test_IP_Me, 6);
+    test_inject(1, &mac, 1, &addr, NULL, 255, -1, NULL, 0);
+    len = router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, len > 0);
+    ct_test(pTest, Test_Link[0].tx_count == 0);
+    memset(&src, 0, sizeof(src));
+    npdu_len = npdu_decode(pdu, &dest, &src, &npdu_data);
+    ct_test(pTest, npdu_len > 0);
+    ct_test(pTest, dest.net == 0);
+    ct_test(pTest, src.net == 2);
+    ct_test(pTest, src.len == 1);
+    ct_test(pTest, src.adr[0] == 5);
+    ct_test(pTest, (len - npdu_len) == sizeof(Test_APDU));
+
+    /* and the device answers it */
+    npdu_data.data_expecting_reply = false;
+    npdu_len = npdu_encode_pdu(pdu, &src, NULL, &npdu_data);
+    memcpy(&pdu[npdu_len], Test_APDU, sizeof(Test_APDU));
+    ct_test(pTest, router_send_pdu(&src, &npdu_data, pdu,
+            npdu_len + sizeof(Test_APDU)) > 0);
+    ct_test(pTest, Test_Link[1].tx_count == 1);
+    ct_test(pTest, Test_Link[1].tx[0].addr.mac[0] == 5);
+    test_sent(pTest, &Test_Link[1].tx[0], &dest, &src, &npdu_data);
+    ct_test(pTest, dest.net == 0);
+    ct_test(pTest, src.net == 1);
+    ct_test(pTest, memcmp(src.adr, Test_IP_Me, 6) == 0);
+
+    /* a station on its own network is sent to as it is */
+    test_address(&addr, 0, NULL, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.mac_len = 6;
+    memcpy(addr.mac, Test_IP_Peer, 6);
+    npdu_len = npdu_encode_pdu(pdu, &addr, NULL, &npdu_data);
+    ct_test(pTest, router_send_pdu(&addr, &npdu_data, pdu, npdu_len) > 0);
+    ct_test(pTest, Test_Link[0].tx_count == 1);
+
+    /* nobody knows network 9 */
+    test_address(&addr, 9, &mac, 1);
+    npdu_len = npdu_encode_pdu(pdu, &addr, NULL, &npdu_data);
+    ct_test(pTest, router_send_pdu(&addr, &npdu_data, pdu, npdu_len) < 0);
+    ct_test(pTest, Test_Link[0].tx_count == 2);
+    ct_test(pTest, Test_Link[1].tx_count == 2);
+    test_sent(pTest, &Test_Link[1].tx[1], &dest, &src, &npdu_data);
+    ct_test(pTest, npdu_data.network_layer_message);
+    ct_test(pTest, npdu_data.network_message_type ==
+        NETWORK_MESSAGE_WHO_IS_ROUTER_TO_NETWORK);
+    ct_test(pTest, Test_Sent_Locked == 0);
+}
+
+static void testRouterNetworkMessages(
+    Test * pTest)
+{
+    BACNET_ADDRESS dest = { 0 }, src = { 0 }, addr = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    ROUTER_ROUTE *route = NULL;
+    uint8_t pdu[MAX_PDU] = { 0 };
+    uint8_t data[4] = { 0 };
+    uint16_t dnet = 0;
+    uint8_t mac = 5;
+    int len = 0;
+
+    test_setup();
+    /* Who-Is-Router-To-Network from BACnet/IP: network 2 is here */
+    test_inject(0, Test_IP_Peer, 6, NULL, NULL, 0,
+        NETWORK_MESSAGE_WHO_IS_ROUTER_TO_NETWORK, NULL, 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, Test_Link[0].tx_count == 1);
+    len = npdu_decode(Test_Link[0].tx[0].pdu, &dest, &src, &npdu_data);
+    ct_test(pTest, npdu_data.network_message_type ==
+        NETWORK_MESSAGE_I_AM_ROUTER_TO_NETWORK);
+    ct_test(pTest, (Test_Link[0].tx[0].len - len) == 2);
+    (void) decode_unsigned16(&Test_Link[0].tx[0].pdu[len], &dnet);
+    ct_test(pTest, dnet == 2);
+    /* asked from MS/TP about network 2 itself, it says nothing */
+    (void) encode_unsigned16(data, 2);
+    test_inject(1, &mac, 1, NULL, NULL, 0,
+        NETWORK_MESSAGE_WHO_IS_ROUTER_TO_NETWORK, data, 2);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, Test_Link[1].tx_count == 0);
+
+    /* a router on BACnet/IP to network 5: learned and passed on */
+    (void) encode_unsigned16(data, 5);
+    test_inject(0, Test_IP_Router, 6, NULL, NULL, 0,
+        NETWORK_MESSAGE_I_AM_ROUTER_TO_NETWORK, data, 2);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    route = router_route_find(5);
+    ct_test(pTest, route != NULL);
+    ct_test(pTest, route && (route->port == 0));
+    ct_test(pTest, route &&
+        (memcmp(route->next_hop.mac, Test_IP_Router, 6) == 0));
+    ct_test(pTest, Test_Link[1].tx_count == 1);
+    (void) npdu_decode(Test_Link[1].tx[0].pdu, &dest, &src, &npdu_data);
+    ct_test(pTest, npdu_data.network_message_type ==
+        NETWORK_MESSAGE_I_AM_ROUTER_TO_NETWORK);
+
+    /* MS/TP station 5 to network 5, through that router */
+    test_address(&addr, 5, &mac, 1);
+    test_inject(1, &mac, 1, &addr, NULL, 255, -1, NULL, 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, Test_Link[0].tx_count == 2);
+    ct_test(pTest, memcmp(Test_Link[0].tx[1].addr.mac, Test_IP_Router,
+            6) == 0);
+    test_sent(pTest, &Test_Link[0].tx[1], &dest, &src, &npdu_data);
+    ct_test(pTest, dest.net == 5);
+    ct_test(pTest, dest.adr[0] == 5);
+    ct_test(pTest, npdu_data.hop_count == 254);
+    ct_test(pTest, src.net == 2);
+    /* not with its last hop */
+    test_inject(1, &mac, 1, &addr, NULL, 1, -1, NULL, 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, Test_Link[0].tx_count == 2);
+
+    /* an SNET seen is a network learned */
+    test_address(&addr, 2, &mac, 1);
+    test_address(&src, 7, Test_IP_Peer, 6);
+    test_inject(0, Test_IP_Router, 6, &addr, &src, 255, -1, NULL, 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    route = router_route_find(7);
+    ct_test(pTest, route && (route->port == 0));
+    ct_test(pTest, Test_Link[1].tx_count == 2);
+    test_sent(pTest, &Test_Link[1].tx[1], &dest, &src, &npdu_data);
+    ct_test(pTest, src.net == 7);
+    ct_test(pTest, memcmp(src.adr, Test_IP_Peer, 6) == 0);
+
+    /* network 9 is rejected, and asked for */
+    test_address(&addr, 9, &mac, 1);
+    test_inject(1, &mac, 1, &addr, NULL, 255, -1, NULL, 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, Test_Link[1].tx_count == 3);
+    ct_test(pTest, Test_Link[1].tx[2].addr.mac[0] == 5);
+    len = npdu_decode(Test_Link[1].tx[2].pdu, &dest, &src, &npdu_data);
+    ct_test(pTest, npdu_data.network_message_type ==
+        NETWORK_MESSAGE_REJECT_MESSAGE_TO_NETWORK);
+    ct_test(pTest, Test_Link[1].tx[2].pdu[len] == NETWORK_REJECT_NO_ROUTE);
+    (void) decode_unsigned16(&Test_Link[1].tx[2].pdu[len + 1], &dnet);
+    ct_test(pTest, dnet == 9);
+    ct_test(pTest, Test_Link[0].tx_count == 3);
+    (void) npdu_decode(Test_Link[0].tx[2].pdu, &dest, &src, &npdu_data);
+    ct_test(pTest, npdu_data.network_message_type ==
+        NETWORK_MESSAGE_WHO_IS_ROUTER_TO_NETWORK);
+
+    /* the device to network 5, through that router */
+    test_address(&addr, 5, &mac, 1);
+    npdu_data.network_layer_message = false;
+    npdu_data.hop_count = HOP_COUNT_DEFAULT;
+    len = npdu_encode_pdu(pdu, &addr, NULL, &npdu_data);
+    memcpy(&pdu[len], Test_APDU, sizeof(Test_APDU));
+    ct_test(pTest, router_send_pdu(&addr, &npdu_data, pdu,
+            len + sizeof(Test_APDU)) > 0);
+    ct_test(pTest, Test_Link[0].tx_count == 4);
+    ct_test(pTest, memcmp(Test_Link[0].tx[3].addr.mac, Test_IP_Router,
+            6) == 0);
+    test_sent(pTest, &Test_Link[0].tx[3], &dest, &src, &npdu_data);
+    ct_test(pTest, dest.net == 5);
+    ct_test(pTest, src.net == 0);
+    /* nothing went out with the lock held */
+    router_announce();
+    ct_test(pTest, Test_Link[0].tx_count == 5);
+    ct_test(pTest, Test_Link[1].tx_count == 4);
+    ct_test(pTest, Test_Sent_Locked == 0);
+}
+
+static void testRouterQueue(
+    Test * pTest)
+{
+    BACNET_ADDRESS dest = { 0 }, src = { 0 }, addr = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t pdu[MAX_PDU] = { 0 };
+    uint8_t mac = 0;
+    unsigned i;
+
+    test_setup();
+    /* MS/TP is backed up: its queue fills, and drops the rest */
+    Test_Link[1].busy = true;
+    for (i = 0; i < (ROUTER_QUEUE_SIZE + 2); i++) {
+        mac = (uint8_t) (10 + i);
+        test_address(&addr, 2, &mac, 1);
+        test_inject(0, Test_IP_Peer, 6, &addr, NULL, 255, -1, NULL, 0);
+        (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    }
+    ct_test(pTest, router_queue_count(1) == ROUTER_QUEUE_SIZE);
+    ct_test(pTest, Test_Link[1].tx_count == 0);
+    /* while BACnet/IP is not held up */
+    mac = 5;
+    test_address(&addr, 1, Test_IP_Peer, 6);
+    test_inject(1, &mac, 1, &addr, NULL, 255, -1, NULL, 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, Test_Link[0].tx_count == 1);
+    /* and what waited goes out in order */
+    Test_Link[1].busy = false;
+    (void) router_receive(&src, pdu, sizeof(pdu), 0);
+    ct_test(pTest, router_queue_count(1) == 0);
+    ct_test(pTest, Test_Link[1].tx_count == ROUTER_QUEUE_SIZE);
+    for (i = 0; i < Test_Link[1].tx_count; i++) {
+        ct_test(pTest, Test_Link[1].tx[i].addr.mac[0] == (10 + i));
+        test_sent(pTest, &Test_Link[1].tx[i], &dest, &src, &npdu_data);
+        ct_test(pTest, src.net == 1);
+    }
+    ct_test(pTest, Free_Count == ROUTER_PACKETS);
+    ct_test(pTest, Test_Sent_Locked == 0);
+}
+
+void testRouter(
+    Test * pTest)
+{
+    bool rc;
+
+    rc = ct_addTestFunction(pTest, testRouterForward);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testRouterDevice);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testRouterNetworkMessages);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testRouterQueue);
+    assert(rc);
+}
+
+#ifdef TEST_ROUTER
+int main(
+    void)
+{
+    Test *pTest;
+
+    pTest = ct_create("BACnet Router", NULL);
+    testRouter(pTest);
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_ROUTER */
+#endif /* TEST */
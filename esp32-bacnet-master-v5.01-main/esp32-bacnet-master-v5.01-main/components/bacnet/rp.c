@@ -33,6 +33,7 @@
 ####COPYRIGHTEND####*/
 #include <stdint.h>
 #include "bacenum.h"
+#include "bits.h"
 #include "bacdcode.h"
 #include "bacdef.h"
 #include "rp.h"
@@ -51,7 +52,13 @@ int rp_encode_apdu(
 
     if (apdu) {
         apdu[0] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST;
+#if BACNET_SEGMENTATION_ENABLED
+        /* the TSM reassembles a segmented ACK for us */
+        apdu[0] |= BAC_BIT(1);
+        apdu[1] = encode_max_segs_max_apdu(MAX_SEGMENTS_ACCEPTED, MAX_APDU);
+#else
         apdu[1] = encode_max_segs_max_apdu(0, MAX_APDU);
+#endif
         apdu[2] = invoke_id;
         apdu[3] = SERVICE_CONFIRMED_READ_PROPERTY;      /* service choice */
         apdu_len = 4;
@@ -306,7 +313,7 @@ int rp_decode_apdu(
     if (!apdu)
         return -1;
     /* optional checking - most likely was already done prior to this call */
-    if (apdu[0] != PDU_TYPE_CONFIRMED_SERVICE_REQUEST)
+    if ((apdu[0] & 0xF0) != PDU_TYPE_CONFIRMED_SERVICE_REQUEST)
         return -1;
     /*  apdu[1] = encode_max_segs_max_apdu(0, MAX_APDU); */
     *invoke_id = apdu[2];       /* invoke id - filled in by net layer */
@@ -32,8 +32,10 @@
  -------------------------------------------
 ####COPYRIGHTEND####*/
 #include <stdint.h>
+#include <string.h>
 #include "bacenum.h"
 #include "bacerror.h"
+#include "bits.h"
 #include "bacdcode.h"
 #include "bacdef.h"
 #include "bacapp.h"
@@ -52,7 +54,13 @@ int rpm_encode_apdu_init(
 
     if (apdu) {
         apdu[0] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST;
+#if BACNET_SEGMENTATION_ENABLED
+        /* the TSM reassembles a segmented ACK for us */
+        apdu[0] |= BAC_BIT(1);
+        apdu[1] = encode_max_segs_max_apdu(MAX_SEGMENTS_ACCEPTED, MAX_APDU);
+#else
         apdu[1] = encode_max_segs_max_apdu(0, MAX_APDU);
+#endif
         apdu[2] = invoke_id;
         apdu[3] = SERVICE_CONFIRMED_READ_PROP_MULTIPLE; /* service choice */
         apdu_len = 4;
@@ -426,6 +434,214 @@ int rpm_ack_encode_apdu_object_end(
     return apdu_len;
 }
 
+/* the largest object id, property, error or end part of an ACK */
+#define RPM_ACK_PART_MAX 16
+
+/**
+ * Starts encoding an RPM ACK in place.
+ *
+ * @param cursor - cursor to initialize
+ * @param apdu - buffer for the ACK
+ * @param size - number of octets in the buffer
+ * @param len - number of octets already encoded, i.e. the ACK header
+ */
+void rpm_ack_cursor_init(
+    RPM_ACK_CURSOR * cursor,
+    uint8_t * apdu,
+    unsigned size,
+    unsigned len)
+{
+    cursor->apdu = apdu;
+    cursor->size = size;
+    cursor->len = (len < size) ? len : size;
+}
+
+/**
+ * @return a mark for rpm_ack_cursor_rollback() at the current position
+ */
+unsigned rpm_ack_cursor_mark(
+    RPM_ACK_CURSOR * cursor)
+{
+    return cursor->len;
+}
+
+/**
+ * Drops everything encoded after a mark.
+ *
+ * @param cursor - ACK cursor
+ * @param mark - from rpm_ack_cursor_mark()
+ */
+void rpm_ack_cursor_rollback(
+    RPM_ACK_CURSOR * cursor,
+    unsigned mark)
+{
+    if (mark < cursor->len) {
+        cursor->len = mark;
+    }
+}
+
+/**
+ * @return the number of octets left in the buffer
+ */
+unsigned rpm_ack_cursor_room(
+    RPM_ACK_CURSOR * cursor)
+{
+    return cursor->size - cursor->len;
+}
+
+/* The small parts are encoded straight into the buffer when the largest
+   one fits, and through a scratch copy near the end of the buffer. */
+static uint8_t *rpm_ack_cursor_part(
+    RPM_ACK_CURSOR * cursor,
+    uint8_t * scratch)
+{
+    if (rpm_ack_cursor_room(cursor) >= RPM_ACK_PART_MAX) {
+        return &cursor->apdu[cursor->len];
+    }
+
+    return scratch;
+}
+
+static bool rpm_ack_cursor_commit(
+    RPM_ACK_CURSOR * cursor,
+    uint8_t * part,
+    int len)
+{
+    if (len <= 0) {
+        return false;
+    }
+    if (part != &cursor->apdu[cursor->len]) {
+        if ((unsigned) len > rpm_ack_cursor_room(cursor)) {
+            return false;
+        }
+        memcpy(&cursor->apdu[cursor->len], part, (size_t) len);
+    }
+    cursor->len += (unsigned) len;
+
+    return true;
+}
+
+bool rpm_ack_cursor_object_begin(
+    RPM_ACK_CURSOR * cursor,
+    BACNET_RPM_DATA * rpmdata)
+{
+    uint8_t scratch[RPM_ACK_PART_MAX];
+    uint8_t *part = rpm_ack_cursor_part(cursor, scratch);
+
+    return rpm_ack_cursor_commit(cursor, part,
+        rpm_ack_encode_apdu_object_begin(part, rpmdata));
+}
+
+bool rpm_ack_cursor_object_property(
+    RPM_ACK_CURSOR * cursor,
+    BACNET_PROPERTY_ID object_property,
+    uint32_t array_index)
+{
+    uint8_t scratch[RPM_ACK_PART_MAX];
+    uint8_t *part = rpm_ack_cursor_part(cursor, scratch);
+
+    return rpm_ack_cursor_commit(cursor, part,
+        rpm_ack_encode_apdu_object_property(part, object_property,
+            array_index));
+}
+
+/**
+ * Opens the property value so that it can be encoded in place.
+ * Finish it with rpm_ack_cursor_value_end().
+ *
+ * @param cursor - ACK cursor
+ * @param max_len - [out] room for the value, leaving the closing tag
+ *
+ * @return where the value goes, or NULL if not even the tags fit
+ */
+uint8_t *rpm_ack_cursor_value_begin(
+    RPM_ACK_CURSOR * cursor,
+    unsigned *max_len)
+{
+    if (rpm_ack_cursor_room(cursor) < 2) {
+        return NULL;
+    }
+    /* Tag 4: propertyValue */
+    cursor->len += encode_opening_tag(&cursor->apdu[cursor->len], 4);
+    if (max_len) {
+        *max_len = rpm_ack_cursor_room(cursor) - 1;
+    }
+
+    return &cursor->apdu[cursor->len];
+}
+
+/**
+ * Closes a property value encoded in place.
+ *
+ * @param cursor - ACK cursor
+ * @param value_len - octets encoded at rpm_ack_cursor_value_begin()
+ *
+ * @return false if the value overran the room given for it
+ */
+bool rpm_ack_cursor_value_end(
+    RPM_ACK_CURSOR * cursor,
+    unsigned value_len)
+{
+    if (value_len >= rpm_ack_cursor_room(cursor)) {
+        return false;
+    }
+    cursor->len += value_len;
+    cursor->len += encode_closing_tag(&cursor->apdu[cursor->len], 4);
+
+    return true;
+}
+
+/**
+ * Adds a property value that was encoded elsewhere.
+ *
+ * @param cursor - ACK cursor
+ * @param application_data - the encoded value
+ * @param application_data_len - octets in the value
+ *
+ * @return false if the value and its tags do not fit
+ */
+bool rpm_ack_cursor_value(
+    RPM_ACK_CURSOR * cursor,
+    uint8_t * application_data,
+    unsigned application_data_len)
+{
+    uint8_t *value = NULL;
+    unsigned max_len = 0;
+    unsigned mark = rpm_ack_cursor_mark(cursor);
+
+    value = rpm_ack_cursor_value_begin(cursor, &max_len);
+    if ((value == NULL) || (application_data_len > max_len)) {
+        rpm_ack_cursor_rollback(cursor, mark);
+        return false;
+    }
+    memcpy(value, application_data, application_data_len);
+
+    return rpm_ack_cursor_value_end(cursor, application_data_len);
+}
+
+bool rpm_ack_cursor_object_property_error(
+    RPM_ACK_CURSOR * cursor,
+    BACNET_ERROR_CLASS error_class,
+    BACNET_ERROR_CODE error_code)
+{
+    uint8_t scratch[RPM_ACK_PART_MAX];
+    uint8_t *part = rpm_ack_cursor_part(cursor, scratch);
+
+    return rpm_ack_cursor_commit(cursor, part,
+        rpm_ack_encode_apdu_object_property_error(part, error_class,
+            error_code));
+}
+
+bool rpm_ack_cursor_object_end(
+    RPM_ACK_CURSOR * cursor)
+{
+    uint8_t scratch[RPM_ACK_PART_MAX];
+    uint8_t *part = rpm_ack_cursor_part(cursor, scratch);
+
+    return rpm_ack_cursor_commit(cursor, part,
+        rpm_ack_encode_apdu_object_end(part));
+}
+
 #if BACNET_SVC_RPM_A
 
 /* decode the object portion of the service request only */
@@ -565,7 +781,7 @@ int rpm_decode_apdu(
     if (!apdu)
         return -1;
     /* optional checking - most likely was already done prior to this call */
-    if (apdu[0] != PDU_TYPE_CONFIRMED_SERVICE_REQUEST)
+    if ((apdu[0] & 0xF0) != PDU_TYPE_CONFIRMED_SERVICE_REQUEST)
         return -1;
     /*  apdu[1] = encode_max_segs_max_apdu(0, MAX_APDU); */
     *invoke_id = apdu[2];       /* invoke id - filled in by net layer */
@@ -942,6 +1158,280 @@ void testReadPropertyMultipleAck(
     ct_test(pTest, len == service_request_len);
 }
 
+/* the ACK encoded in place matches the one built part by part */
+void testReadPropertyMultipleAckCursor(
+    Test * pTest)
+{
+    uint8_t apdu[64] = { 0 };
+    uint8_t test_apdu[64] = { 0 };
+    uint8_t value[8] = { 0 };
+    int value_len = 0;
+    int test_len = 0;
+    unsigned mark = 0;
+    unsigned max_len = 0;
+    uint8_t *pValue = NULL;
+    bool status = false;
+    RPM_ACK_CURSOR cursor;
+    BACNET_RPM_DATA rpmdata;
+
+    rpmdata.object_type = OBJECT_ANALOG_INPUT;
+    rpmdata.object_instance = 7;
+    value_len = encode_application_real(&value[0], 1.0F);
+    /* reference encoding */
+    test_len = rpm_ack_encode_apdu_init(&test_apdu[0], 1);
+    test_len +=
+        rpm_ack_encode_apdu_object_begin(&test_apdu[test_len], &rpmdata);
+    test_len +=
+        rpm_ack_encode_apdu_object_property(&test_apdu[test_len],
+        PROP_PRESENT_VALUE, BACNET_ARRAY_ALL);
+    test_len +=
+        rpm_ack_encode_apdu_object_property_value(&test_apdu[test_len],
+        &value[0], value_len);
+    test_len +=
+        rpm_ack_encode_apdu_object_property(&test_apdu[test_len],
+        PROP_UNITS, BACNET_ARRAY_ALL);
+    test_len +=
+        rpm_ack_encode_apdu_object_property_error(&test_apdu[test_len],
+        ERROR_CLASS_PROPERTY, ERROR_CODE_UNKNOWN_PROPERTY);
+    test_len += rpm_ack_encode_apdu_object_end(&test_apdu[test_len]);
+    /* in place, with a value that is rolled back for an error */
+    rpm_ack_cursor_init(&cursor, &apdu[0], sizeof(apdu),
+        rpm_ack_encode_apdu_init(&apdu[0], 1));
+    status = rpm_ack_cursor_object_begin(&cursor, &rpmdata);
+    ct_test(pTest, status == true);
+    status =
+        rpm_ack_cursor_object_property(&cursor, PROP_PRESENT_VALUE,
+        BACNET_ARRAY_ALL);
+    ct_test(pTest, status == true);
+    pValue = rpm_ack_cursor_value_begin(&cursor, &max_len);
+    ct_test(pTest, pValue != NULL);
+    ct_test(pTest, max_len == (sizeof(apdu) - cursor.len - 1));
+    memcpy(pValue, &value[0], value_len);
+    status = rpm_ack_cursor_value_end(&cursor, value_len);
+    ct_test(pTest, status == true);
+    status =
+        rpm_ack_cursor_object_property(&cursor, PROP_UNITS,
+        BACNET_ARRAY_ALL);
+    ct_test(pTest, status == true);
+    mark = rpm_ack_cursor_mark(&cursor);
+    status = rpm_ack_cursor_value(&cursor, &value[0], value_len);
+    ct_test(pTest, status == true);
+    rpm_ack_cursor_rollback(&cursor, mark);
+    status =
+        rpm_ack_cursor_object_property_error(&cursor, ERROR_CLASS_PROPERTY,
+        ERROR_CODE_UNKNOWN_PROPERTY);
+    ct_test(pTest, status == true);
+    status = rpm_ack_cursor_object_end(&cursor);
+    ct_test(pTest, status == true);
+    ct_test(pTest, cursor.len == (unsigned) test_len);
+    ct_test(pTest, memcmp(&apdu[0], &test_apdu[0], test_len) == 0);
+    /* parts that do not fit are not encoded */
+    rpm_ack_cursor_init(&cursor, &apdu[0], test_len - 1, 0);
+    cursor.len = test_len - 2;
+    mark = rpm_ack_cursor_mark(&cursor);
+    status = rpm_ack_cursor_value(&cursor, &value[0], value_len);
+    ct_test(pTest, status == false);
+    ct_test(pTest, cursor.len == mark);
+    status =
+        rpm_ack_cursor_object_property_error(&cursor, ERROR_CLASS_PROPERTY,
+        ERROR_CODE_UNKNOWN_PROPERTY);
+    ct_test(pTest, status == false);
+    ct_test(pTest, cursor.len == mark);
+    status = rpm_ack_cursor_object_end(&cursor);
+    ct_test(pTest, status == true);
+    ct_test(pTest, rpm_ack_cursor_room(&cursor) == 0);
+    status = rpm_ack_cursor_object_end(&cursor);
+    ct_test(pTest, status == false);
+}
+
+/* the properties read by testReadPropertyMultipleAckInPlace(): the
+   length of an OCTET STRING value, or 0 for a property that is an error */
+static const struct {
+    BACNET_PROPERTY_ID property;
+    unsigned length;
+} Test_Values[] = {
+    {PROP_PRESENT_VALUE, 4},
+    {PROP_OBJECT_NAME, 20},
+    {PROP_UNITS, 0},
+    {PROP_PRIORITY_ARRAY, 60},
+    {PROP_DESCRIPTION, 1}
+};
+
+/* a reader that encodes no more than application_data_len */
+static int testReadValue(
+    unsigned index,
+    uint8_t * apdu,
+    unsigned max_apdu)
+{
+    uint8_t value[64];
+    unsigned i = 0;
+    BACNET_OCTET_STRING octet_string;
+
+    if (Test_Values[index].length == 0) {
+        return BACNET_STATUS_ERROR;
+    }
+    if ((Test_Values[index].length + 2) > max_apdu) {
+        return BACNET_STATUS_ABORT;
+    }
+    for (i = 0; i < Test_Values[index].length; i++) {
+        value[i] = (uint8_t) (index + i);
+    }
+    octetstring_init(&octet_string, &value[0], Test_Values[index].length);
+
+    return encode_application_octet_string(&apdu[0], &octet_string);
+}
+
+/* the ACK as the handler built it before, each part staged in a buffer
+   and copied into the reply if it fits */
+static int testAckStaged(
+    uint8_t * apdu,
+    unsigned max_apdu,
+    BACNET_RPM_DATA * rpmdata)
+{
+    uint8_t temp[MAX_APDU];
+    int apdu_len = 0;
+    int len = 0;
+    unsigned i = 0;
+
+    apdu_len = rpm_ack_encode_apdu_init(&temp[0], 1);
+    if (memcopy(apdu, &temp[0], 0, apdu_len, max_apdu) == 0) {
+        return BACNET_STATUS_ABORT;
+    }
+    len = rpm_ack_encode_apdu_object_begin(&temp[0], rpmdata);
+    if (memcopy(apdu, &temp[0], apdu_len, len, max_apdu) == 0) {
+        return BACNET_STATUS_ABORT;
+    }
+    apdu_len += len;
+    for (i = 0; i < sizeof(Test_Values) / sizeof(Test_Values[0]); i++) {
+        len =
+            rpm_ack_encode_apdu_object_property(&temp[0],
+            Test_Values[i].property, BACNET_ARRAY_ALL);
+        if (memcopy(apdu, &temp[0], apdu_len, len, max_apdu) == 0) {
+            return BACNET_STATUS_ABORT;
+        }
+        apdu_len += len;
+        len = testReadValue(i, &temp[0], sizeof(temp));
+        if (len < 0) {
+            len =
+                rpm_ack_encode_apdu_object_property_error(&temp[0],
+                ERROR_CLASS_PROPERTY, ERROR_CODE_UNKNOWN_PROPERTY);
+            if (memcopy(apdu, &temp[0], apdu_len, len, max_apdu) == 0) {
+                return BACNET_STATUS_ABORT;
+            }
+        } else if ((apdu_len + 1 + len + 1) < (int) max_apdu) {
+            len =
+                rpm_ack_encode_apdu_object_property_value(&apdu[apdu_len],
+                &temp[0], len);
+        } else {
+            return BACNET_STATUS_ABORT;
+        }
+        apdu_len += len;
+    }
+    len = rpm_ack_encode_apdu_object_end(&temp[0]);
+    if (memcopy(apdu, &temp[0], apdu_len, len, max_apdu) == 0) {
+        return BACNET_STATUS_ABORT;
+    }
+    apdu_len += len;
+
+    return apdu_len;
+}
+
+/* the ACK as the handler builds it now, in place through the cursor with
+   each value bounded by the room that is left */
+static int testAckInPlace(
+    uint8_t * apdu,
+    unsigned max_apdu,
+    BACNET_RPM_DATA * rpmdata)
+{
+    uint8_t header[8];
+    int len = 0;
+    unsigned i = 0;
+    unsigned mark = 0;
+    unsigned value_mark = 0;
+    unsigned max_len = 0;
+    uint8_t *value = NULL;
+    RPM_ACK_CURSOR cursor;
+
+    len = rpm_ack_encode_apdu_init(&header[0], 1);
+    if ((unsigned) len > max_apdu) {
+        return BACNET_STATUS_ABORT;
+    }
+    memcpy(apdu, &header[0], (size_t) len);
+    rpm_ack_cursor_init(&cursor, apdu, max_apdu, (unsigned) len);
+    if (!rpm_ack_cursor_object_begin(&cursor, rpmdata)) {
+        return BACNET_STATUS_ABORT;
+    }
+    for (i = 0; i < sizeof(Test_Values) / sizeof(Test_Values[0]); i++) {
+        mark = rpm_ack_cursor_mark(&cursor);
+        if (!rpm_ack_cursor_object_property(&cursor, Test_Values[i].property,
+                BACNET_ARRAY_ALL)) {
+            return BACNET_STATUS_ABORT;
+        }
+        value_mark = rpm_ack_cursor_mark(&cursor);
+        value = rpm_ack_cursor_value_begin(&cursor, &max_len);
+        if (!value) {
+            rpm_ack_cursor_rollback(&cursor, mark);
+            return BACNET_STATUS_ABORT;
+        }
+        len = testReadValue(i, value, max_len);
+        if (len == BACNET_STATUS_ABORT) {
+            rpm_ack_cursor_rollback(&cursor, mark);
+            return BACNET_STATUS_ABORT;
+        } else if (len < 0) {
+            rpm_ack_cursor_rollback(&cursor, value_mark);
+            if (!rpm_ack_cursor_object_property_error(&cursor,
+                    ERROR_CLASS_PROPERTY, ERROR_CODE_UNKNOWN_PROPERTY)) {
+                rpm_ack_cursor_rollback(&cursor, mark);
+                return BACNET_STATUS_ABORT;
+            }
+        } else if (!rpm_ack_cursor_value_end(&cursor, (unsigned) len)) {
+            rpm_ack_cursor_rollback(&cursor, mark);
+            return BACNET_STATUS_ABORT;
+        }
+    }
+    if (!rpm_ack_cursor_object_end(&cursor)) {
+        return BACNET_STATUS_ABORT;
+    }
+
+    return (int) rpm_ack_cursor_mark(&cursor);
+}
+
+/* for every size of reply buffer, the ACK encoded in place is byte for
+   byte the one staged and copied, or both abort */
+void testReadPropertyMultipleAckInPlace(
+    Test * pTest)
+{
+    uint8_t apdu[256] = { 0 };
+    uint8_t test_apdu[256] = { 0 };
+    int len = 0;
+    int test_len = 0;
+    int full_len = 0;
+    unsigned max_apdu = 0;
+    BACNET_RPM_DATA rpmdata;
+
+    rpmdata.object_type = OBJECT_ANALOG_OUTPUT;
+    rpmdata.object_instance = 3;
+    full_len = testAckStaged(&test_apdu[0], sizeof(test_apdu), &rpmdata);
+    ct_test(pTest, full_len > 100);
+    for (max_apdu = 1; max_apdu <= sizeof(apdu); max_apdu++) {
+        memset(&apdu[0], 0xA5, sizeof(apdu));
+        memset(&test_apdu[0], 0x5A, sizeof(test_apdu));
+        test_len = testAckStaged(&test_apdu[0], max_apdu, &rpmdata);
+        len = testAckInPlace(&apdu[0], max_apdu, &rpmdata);
+        ct_test(pTest, len == test_len);
+        if (len > 0) {
+            ct_test(pTest, len == full_len);
+            ct_test(pTest, memcmp(&apdu[0], &test_apdu[0], len) == 0);
+        } else {
+            ct_test(pTest, max_apdu < (unsigned) full_len);
+        }
+        /* nothing is written past the room that was given */
+        if (max_apdu < sizeof(apdu)) {
+            ct_test(pTest, apdu[max_apdu] == 0xA5);
+        }
+    }
+}
+
 #ifdef TEST_READ_PROPERTY_MULTIPLE
 int main(
     void)
@@ -955,6 +1445,10 @@ int main(
     assert(rc);
     rc = ct_addTestFunction(pTest, testReadPropertyMultipleAck);
     assert(rc);
+    rc = ct_addTestFunction(pTest, testReadPropertyMultipleAckCursor);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testReadPropertyMultipleAckInPlace);
+    assert(rc);
 
     ct_setStream(pTest, stdout);
     ct_run(pTest);
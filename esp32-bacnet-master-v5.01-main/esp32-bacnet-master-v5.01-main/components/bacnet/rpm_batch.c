@@ -0,0 +1,1224 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "config.h"
+#include "txbuf.h"
+#include "bacdef.h"
+#include "bacaddr.h"
+#include "bacdcode.h"
+#include "bacapp.h"
+#include "address.h"
+#include "tsm.h"
+#include "npdu.h"
+#include "apdu.h"
+#include "datalink.h"
+#include "dcc.h"
+#include "rpm.h"
+#include "rpm_batch.h"
+#include "handlers.h"
+
+/** @file rpm_batch.c  Batches reads into ReadPropertyMultiple requests. */
+
+/* what we expect a property to cost in the ACK: the property
+   identifier, the value tags and a small primitive value */
+#ifndef RPM_BATCH_ACK_ESTIMATE
+#define RPM_BATCH_ACK_ESTIMATE 16
+#endif
+/* what we expect a character string property to cost, such as a name
+   or a description.  A list or a whole array is expected to fill the
+   ACK, so it is sent in a request of its own. */
+#ifndef RPM_BATCH_ACK_ESTIMATE_STRING
+#define RPM_BATCH_ACK_ESTIMATE_STRING 64
+#endif
+/* ComplexACK header: type, invoke ID and service choice */
+#define RPM_BATCH_ACK_HEADER_LEN 3
+
+typedef enum {
+    RPM_BATCH_IDLE = 0,
+    RPM_BATCH_PENDING,
+    RPM_BATCH_SENT
+} RPM_BATCH_STATE;
+
+typedef struct rpm_batch_read {
+    RPM_BATCH_STATE state;
+    /* invoke ID and destination of the request carrying this read,
+       when SENT */
+    uint8_t invoke_id;
+    BACNET_ADDRESS dest;
+    /* the server could not answer it along with other reads,
+       so it goes in a request of its own */
+    bool alone;
+    uint32_t device_id;
+    BACNET_OBJECT_TYPE object_type;
+    uint32_t object_instance;
+    BACNET_PROPERTY_ID object_property;
+    uint32_t array_index;
+    rpm_batch_callback_function callback;
+    void *context;
+} RPM_BATCH_READ;
+
+static RPM_BATCH_READ RPM_Batch_Reads[MAX_RPM_BATCH_READS];
+/* the Reject and Abort handlers set before rpm_batch_init(), which
+   get those that do not answer a batch */
+static reject_function RPM_Batch_Next_Reject;
+static abort_function RPM_Batch_Next_Abort;
+
+/* hands the result to the callback and frees the slot */
+static void rpm_batch_complete(
+    RPM_BATCH_READ * pRead,
+    BACNET_READ_PROPERTY_DATA * rp_data)
+{
+    rpm_batch_callback_function callback = pRead->callback;
+    void *context = pRead->context;
+    uint32_t device_id = pRead->device_id;
+
+    /* free the slot first, so the callback can queue the next read */
+    pRead->state = RPM_BATCH_IDLE;
+    if (callback) {
+        callback(device_id, rp_data, context);
+    }
+}
+
+/* true if the read waits on the request with this invoke ID to src */
+static bool rpm_batch_waiting(
+    RPM_BATCH_READ * pRead,
+    BACNET_ADDRESS * src,
+    uint8_t invoke_id)
+{
+    return (pRead->state == RPM_BATCH_SENT) &&
+        (pRead->invoke_id == invoke_id) &&
+        bacnet_address_same(&pRead->dest, src);
+}
+
+/* fails every read still waiting on this request */
+static void rpm_batch_fail(
+    BACNET_ADDRESS * src,
+    uint8_t invoke_id,
+    BACNET_ERROR_CLASS error_class,
+    BACNET_ERROR_CODE error_code)
+{
+    BACNET_READ_PROPERTY_DATA rp_data;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_RPM_BATCH_READS; i++) {
+        if (rpm_batch_waiting(&RPM_Batch_Reads[i], src, invoke_id)) {
+            rp_data.object_type = RPM_Batch_Reads[i].object_type;
+            rp_data.object_instance = RPM_Batch_Reads[i].object_instance;
+            rp_data.object_property = RPM_Batch_Reads[i].object_property;
+            rp_data.array_index = RPM_Batch_Reads[i].array_index;
+            rp_data.application_data = NULL;
+            rp_data.application_data_len = 0;
+            rp_data.error_class = error_class;
+            rp_data.error_code = error_code;
+            rpm_batch_complete(&RPM_Batch_Reads[i], &rp_data);
+        }
+    }
+}
+
+/* number of reads waiting on the request with this invoke ID to src */
+static unsigned rpm_batch_waiting_count(
+    BACNET_ADDRESS * src,
+    uint8_t invoke_id)
+{
+    unsigned count = 0;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_RPM_BATCH_READS; i++) {
+        if (rpm_batch_waiting(&RPM_Batch_Reads[i], src, invoke_id)) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/** Clear the queue and take over the ReadPropertyMultiple ACK and Error
+ *  handlers, and the Reject and Abort handlers.
+ *  ACKs that don't belong to a batch are passed on to
+ *  handler_read_property_multiple_ack(), and Rejects and Aborts to the
+ *  handlers that were set before, so call it after setting those.
+ */
+void rpm_batch_init(
+    void)
+{
+    memset(RPM_Batch_Reads, 0, sizeof(RPM_Batch_Reads));
+    apdu_set_confirmed_ack_handler(SERVICE_CONFIRMED_READ_PROP_MULTIPLE,
+        rpm_batch_ack_handler);
+    apdu_set_error_handler(SERVICE_CONFIRMED_READ_PROP_MULTIPLE,
+        rpm_batch_error_handler);
+    /* called again, it keeps the handlers it passes on to */
+    if (apdu_get_reject_handler() != rpm_batch_reject_handler) {
+        RPM_Batch_Next_Reject = apdu_get_reject_handler();
+        apdu_set_reject_handler(rpm_batch_reject_handler);
+    }
+    if (apdu_get_abort_handler() != rpm_batch_abort_handler) {
+        RPM_Batch_Next_Abort = apdu_get_abort_handler();
+        apdu_set_abort_handler(rpm_batch_abort_handler);
+    }
+}
+
+/** Queue one property read.  Nothing is sent until rpm_batch_send().
+ * @param device_id [in] device to read from - it has to be bound
+ *        in the address cache by the time the batch is sent
+ * @param object_type [in] object to read
+ * @param object_instance [in] object to read
+ * @param object_property [in] property to read
+ * @param array_index [in] array index, or BACNET_ARRAY_ALL
+ * @param callback [in] called with the result
+ * @param context [in] passed to the callback
+ * @return true if queued, false if the queue is full
+ */
+bool rpm_batch_read(
+    uint32_t device_id,
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance,
+    BACNET_PROPERTY_ID object_property,
+    uint32_t array_index,
+    rpm_batch_callback_function callback,
+    void *context)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_RPM_BATCH_READS; i++) {
+        if (RPM_Batch_Reads[i].state == RPM_BATCH_IDLE) {
+            RPM_Batch_Reads[i].state = RPM_BATCH_PENDING;
+            RPM_Batch_Reads[i].invoke_id = 0;
+            RPM_Batch_Reads[i].alone = false;
+            RPM_Batch_Reads[i].device_id = device_id;
+            RPM_Batch_Reads[i].object_type = object_type;
+            RPM_Batch_Reads[i].object_instance = object_instance;
+            RPM_Batch_Reads[i].object_property = object_property;
+            RPM_Batch_Reads[i].array_index = array_index;
+            RPM_Batch_Reads[i].callback = callback;
+            RPM_Batch_Reads[i].context = context;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* what we expect the property to cost in the ACK */
+static unsigned rpm_batch_ack_estimate(
+    BACNET_PROPERTY_ID object_property,
+    uint32_t array_index,
+    unsigned max_apdu)
+{
+    switch (object_property) {
+        case PROP_ALL:
+        case PROP_REQUIRED:
+        case PROP_OPTIONAL:
+        case PROP_ACTIVE_COV_SUBSCRIPTIONS:
+        case PROP_DEVICE_ADDRESS_BINDING:
+        case PROP_LOG_BUFFER:
+        case PROP_RECIPIENT_LIST:
+        case PROP_TIME_SYNCHRONIZATION_RECIPIENTS:
+            return max_apdu;
+        case PROP_OBJECT_LIST:
+        case PROP_STRUCTURED_OBJECT_LIST:
+        case PROP_PROPERTY_LIST:
+        case PROP_PRIORITY_ARRAY:
+        case PROP_EVENT_TIME_STAMPS:
+            if (array_index == BACNET_ARRAY_ALL) {
+                return max_apdu;
+            }
+            return RPM_BATCH_ACK_ESTIMATE;
+        case PROP_STATE_TEXT:
+            if (array_index == BACNET_ARRAY_ALL) {
+                return max_apdu;
+            }
+            return RPM_BATCH_ACK_ESTIMATE_STRING;
+        case PROP_OBJECT_NAME:
+        case PROP_DESCRIPTION:
+        case PROP_LOCATION:
+        case PROP_VENDOR_NAME:
+        case PROP_MODEL_NAME:
+        case PROP_FIRMWARE_REVISION:
+        case PROP_APPLICATION_SOFTWARE_VERSION:
+        case PROP_PROFILE_NAME:
+        case PROP_DEVICE_TYPE:
+        case PROP_ACTIVE_TEXT:
+        case PROP_INACTIVE_TEXT:
+            return RPM_BATCH_ACK_ESTIMATE_STRING;
+        default:
+            break;
+    }
+
+    return RPM_BATCH_ACK_ESTIMATE;
+}
+
+/* Appends an encoding if the request and the expected ACK still fit.
+   The first read of a request is always taken: if its answer turns out
+   too big, the server says so.
+   Returns false, and appends nothing, if they don't. */
+static bool rpm_batch_append(
+    uint8_t * apdu,
+    unsigned *apdu_len,
+    unsigned *ack_len,
+    unsigned max_apdu,
+    uint8_t * encoding,
+    unsigned encoding_len,
+    unsigned ack_cost,
+    bool first)
+{
+    /* always leave room to close the object */
+    if (((*apdu_len + encoding_len + 1) > max_apdu) ||
+        (!first && ((*ack_len + ack_cost + 1) > max_apdu))) {
+        return false;
+    }
+    memcpy(&apdu[*apdu_len], encoding, encoding_len);
+    *apdu_len += encoding_len;
+    *ack_len += ack_cost;
+
+    return true;
+}
+
+/* Packs as many pending reads for the device as fit into one request.
+   Returns the invoke ID of the request, or 0 if none was sent. */
+static uint8_t rpm_batch_device_send(
+    uint32_t device_id)
+{
+    BACNET_ADDRESS dest;
+    BACNET_ADDRESS my_address;
+    BACNET_NPDU_DATA npdu_data;
+    RPM_BATCH_READ *pObject = NULL;
+    RPM_BATCH_READ *pRead = NULL;
+    uint8_t encoding[16];
+    uint8_t *apdu = NULL;
+    unsigned max_apdu = 0;
+    unsigned apdu_len = 0;
+    unsigned ack_len = 0;
+    unsigned count = 0;
+    unsigned object_apdu_len = 0;
+    unsigned object_ack_len = 0;
+    unsigned object_count = 0;
+    unsigned i = 0;
+    unsigned j = 0;
+    int pdu_len = 0;
+    int len = 0;
+    uint8_t invoke_id = 0;
+    bool full = false;
+
+    if (!dcc_communication_enabled()) {
+        return 0;
+    }
+    if (!address_get_by_device(device_id, &max_apdu, &dest)) {
+        return 0;
+    }
+    invoke_id = tsm_next_free_invokeID();
+    if (!invoke_id) {
+        return 0;
+    }
+    if (max_apdu > MAX_APDU) {
+        max_apdu = MAX_APDU;
+    }
+    datalink_get_my_address(&my_address);
+    npdu_encode_npdu_data(&npdu_data, true, MESSAGE_PRIORITY_NORMAL);
+    pdu_len =
+        npdu_encode_pdu(&Handler_Transmit_Buffer[0], &dest, &my_address,
+        &npdu_data);
+    apdu = &Handler_Transmit_Buffer[pdu_len];
+    apdu_len = (unsigned) rpm_encode_apdu_init(apdu, invoke_id);
+    ack_len = RPM_BATCH_ACK_HEADER_LEN;
+    for (i = 0; (i < MAX_RPM_BATCH_READS) && !full; i++) {
+        pObject = &RPM_Batch_Reads[i];
+        if ((pObject->state != RPM_BATCH_PENDING) ||
+            (pObject->device_id != device_id)) {
+            continue;
+        }
+        /* one ReadAccessSpecification per object */
+        object_apdu_len = apdu_len;
+        object_ack_len = ack_len;
+        object_count = count;
+        len =
+            rpm_encode_apdu_object_begin(&encoding[0], pObject->object_type,
+            pObject->object_instance);
+        if (!rpm_batch_append(apdu, &apdu_len, &ack_len, max_apdu,
+                &encoding[0], (unsigned) len, (unsigned) len, count == 0)) {
+            break;
+        }
+        for (j = i; j < MAX_RPM_BATCH_READS; j++) {
+            pRead = &RPM_Batch_Reads[j];
+            if ((pRead->state != RPM_BATCH_PENDING) ||
+                (pRead->device_id != device_id) ||
+                (pRead->object_type != pObject->object_type) ||
+                (pRead->object_instance != pObject->object_instance)) {
+                continue;
+            }
+            if (pRead->alone && (count > 0)) {
+                continue;
+            }
+            len =
+                rpm_encode_apdu_object_property(&encoding[0],
+                pRead->object_property, pRead->array_index);
+            if (!rpm_batch_append(apdu, &apdu_len, &ack_len, max_apdu,
+                    &encoding[0], (unsigned) len,
+                    rpm_batch_ack_estimate(pRead->object_property,
+                        pRead->array_index, max_apdu), count == 0)) {
+                /* a smaller read may still fit */
+                continue;
+            }
+            pRead->state = RPM_BATCH_SENT;
+            pRead->invoke_id = invoke_id;
+            bacnet_address_copy(&pRead->dest, &dest);
+            count++;
+            if (pRead->alone) {
+                full = true;
+                break;
+            }
+        }
+        if (count == object_count) {
+            /* not even one property fit - drop the empty object */
+            apdu_len = object_apdu_len;
+            ack_len = object_ack_len;
+            break;
+        }
+        apdu_len += (unsigned) rpm_encode_apdu_object_end(&apdu[apdu_len]);
+        ack_len++;
+    }
+    if (count == 0) {
+        /* the device can't take even one read */
+        tsm_free_invoke_id(invoke_id);
+        return 0;
+    }
+    pdu_len += (int) apdu_len;
+    tsm_set_confirmed_unsegmented_transaction(invoke_id, &dest, &npdu_data,
+        &Handler_Transmit_Buffer[0], (uint16_t) pdu_len);
+    /* if it is lost, the TSM sends it again when it times out */
+    datalink_send_pdu(&dest, &npdu_data, &Handler_Transmit_Buffer[0],
+        pdu_len);
+
+    return invoke_id;
+}
+
+/** Send the queued reads, as few requests per device as will fit.
+ *  Reads for devices that are not bound yet, or that find no free
+ *  invoke ID, stay queued for the next call.
+ * @return number of requests sent
+ */
+unsigned rpm_batch_send(
+    void)
+{
+    unsigned requests = 0;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_RPM_BATCH_READS; i++) {
+        while (RPM_Batch_Reads[i].state == RPM_BATCH_PENDING) {
+            if (rpm_batch_device_send(RPM_Batch_Reads[i].device_id) == 0) {
+                break;
+            }
+            requests++;
+        }
+    }
+
+    return requests;
+}
+
+/** Fail the reads whose request timed out, and send the reads that
+ *  are queued, or were queued again after an Abort.
+ *  Call it after tsm_timer_milliseconds().
+ */
+void rpm_batch_task(
+    void)
+{
+    BACNET_ADDRESS dest;
+    uint8_t invoke_id = 0;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_RPM_BATCH_READS; i++) {
+        if ((RPM_Batch_Reads[i].state == RPM_BATCH_SENT) &&
+            tsm_invoke_id_failed(RPM_Batch_Reads[i].invoke_id)) {
+            /* the callbacks may reuse the slot */
+            invoke_id = RPM_Batch_Reads[i].invoke_id;
+            bacnet_address_copy(&dest, &RPM_Batch_Reads[i].dest);
+            tsm_free_invoke_id(invoke_id);
+            rpm_batch_fail(&dest, invoke_id, ERROR_CLASS_COMMUNICATION,
+                ERROR_CODE_TIMEOUT);
+        }
+    }
+    rpm_batch_send();
+}
+
+/** Handler for an Error answering a ReadPropertyMultiple request.
+ * @ingroup DSRPMB
+ * Fails every read of the request with the error.
+ *
+ * @param src [in] the server
+ * @param invoke_id [in] invoke ID of the request
+ * @param error_class [in] the error class
+ * @param error_code [in] the error code
+ */
+void rpm_batch_error_handler(
+    BACNET_ADDRESS * src,
+    uint8_t invoke_id,
+    BACNET_ERROR_CLASS error_class,
+    BACNET_ERROR_CODE error_code)
+{
+    rpm_batch_fail(src, invoke_id, error_class, error_code);
+}
+
+/** Handler for a Reject of a request.
+ * @ingroup DSRPMB
+ * Fails every read of the request, if it was one of ours, with the
+ * ERROR_CODE_REJECT_ code of the reason; a Reject of any other request
+ * goes to the handler set before rpm_batch_init().
+ *
+ * @param src [in] the server
+ * @param invoke_id [in] invoke ID of the request
+ * @param reject_reason [in] the reason
+ */
+void rpm_batch_reject_handler(
+    BACNET_ADDRESS * src,
+    uint8_t invoke_id,
+    uint8_t reject_reason)
+{
+    BACNET_ERROR_CODE error_code = ERROR_CODE_REJECT_OTHER;
+
+    if (rpm_batch_waiting_count(src, invoke_id) == 0) {
+        if (RPM_Batch_Next_Reject) {
+            RPM_Batch_Next_Reject(src, invoke_id, reject_reason);
+        }
+        return;
+    }
+    /* the reasons up to unrecognized-service have codes in order */
+    if ((reject_reason >= REJECT_REASON_BUFFER_OVERFLOW) &&
+        (reject_reason <= REJECT_REASON_UNRECOGNIZED_SERVICE)) {
+        error_code = (BACNET_ERROR_CODE) (ERROR_CODE_REJECT_BUFFER_OVERFLOW +
+            reject_reason - REJECT_REASON_BUFFER_OVERFLOW);
+    } else if (reject_reason >= FIRST_PROPRIETARY_REJECT_REASON) {
+        error_code = ERROR_CODE_REJECT_PROPRIETARY;
+    }
+    rpm_batch_fail(src, invoke_id, ERROR_CLASS_SERVICES, error_code);
+}
+
+/** Handler for an Abort from a server.
+ * @ingroup DSRPMB
+ * If the server could not fit the ACK of a request that carried more
+ * than one read, each of its reads is queued again to be sent in a
+ * request of its own.  Otherwise the reads fail with the
+ * ERROR_CODE_ABORT_ code of the reason.  An Abort of any other
+ * transaction goes to the handler set before rpm_batch_init().
+ *
+ * @param src [in] the server
+ * @param invoke_id [in] invoke ID of the request
+ * @param abort_reason [in] the reason
+ * @param server [in] true if the Abort came from the server
+ */
+void rpm_batch_abort_handler(
+    BACNET_ADDRESS * src,
+    uint8_t invoke_id,
+    uint8_t abort_reason,
+    bool server)
+{
+    BACNET_ERROR_CODE error_code = ERROR_CODE_ABORT_OTHER;
+    unsigned i = 0;
+
+    if (!server || (rpm_batch_waiting_count(src, invoke_id) == 0)) {
+        if (RPM_Batch_Next_Abort) {
+            RPM_Batch_Next_Abort(src, invoke_id, abort_reason, server);
+        }
+        return;
+    }
+    if (((abort_reason == ABORT_REASON_BUFFER_OVERFLOW) ||
+            (abort_reason == ABORT_REASON_SEGMENTATION_NOT_SUPPORTED)) &&
+        (rpm_batch_waiting_count(src, invoke_id) > 1)) {
+        for (i = 0; i < MAX_RPM_BATCH_READS; i++) {
+            if (rpm_batch_waiting(&RPM_Batch_Reads[i], src, invoke_id)) {
+                RPM_Batch_Reads[i].state = RPM_BATCH_PENDING;
+                RPM_Batch_Reads[i].alone = true;
+            }
+        }
+        return;
+    }
+    /* the reasons up to segmentation-not-supported have codes in order */
+    if ((abort_reason >= ABORT_REASON_BUFFER_OVERFLOW) &&
+        (abort_reason <= ABORT_REASON_SEGMENTATION_NOT_SUPPORTED)) {
+        error_code = (BACNET_ERROR_CODE) (ERROR_CODE_ABORT_BUFFER_OVERFLOW +
+            abort_reason - ABORT_REASON_BUFFER_OVERFLOW);
+    } else if (abort_reason >= FIRST_PROPRIETARY_ABORT_REASON) {
+        error_code = ERROR_CODE_ABORT_PROPRIETARY;
+    }
+    rpm_batch_fail(src, invoke_id, ERROR_CLASS_COMMUNICATION, error_code);
+}
+
+/** @return number of reads queued or waiting for an ACK */
+unsigned rpm_batch_pending_count(
+    void)
+{
+    unsigned count = 0;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_RPM_BATCH_READS; i++) {
+        if (RPM_Batch_Reads[i].state != RPM_BATCH_IDLE) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* decodes the error class and code of a propertyAccessError;
+   returns the number of bytes decoded, or 0 if malformed */
+static int rpm_batch_decode_error(
+    uint8_t * apdu,
+    unsigned apdu_len,
+    BACNET_READ_PROPERTY_DATA * rp_data)
+{
+    uint8_t tag_number = 0;
+    uint32_t len_value_type = 0;
+    uint32_t error_value[2] = { 0, 0 };
+    unsigned len = 0;
+    unsigned i = 0;
+
+    for (i = 0; i < 2; i++) {
+        if ((len >= apdu_len) || IS_CONTEXT_SPECIFIC(apdu[len])) {
+            return 0;
+        }
+        len +=
+            (unsigned) decode_tag_number_and_value(&apdu[len], &tag_number,
+            &len_value_type);
+        if ((tag_number != BACNET_APPLICATION_TAG_ENUMERATED) ||
+            ((len + len_value_type) > apdu_len)) {
+            return 0;
+        }
+        len +=
+            (unsigned) decode_enumerated(&apdu[len], len_value_type,
+            &error_value[i]);
+    }
+    rp_data->error_class = (BACNET_ERROR_CLASS) error_value[0];
+    rp_data->error_code = (BACNET_ERROR_CODE) error_value[1];
+
+    return (int) len;
+}
+
+/* the first read of this request that matches the result */
+static RPM_BATCH_READ *rpm_batch_find(
+    BACNET_ADDRESS * src,
+    uint8_t invoke_id,
+    BACNET_READ_PROPERTY_DATA * rp_data)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_RPM_BATCH_READS; i++) {
+        if (rpm_batch_waiting(&RPM_Batch_Reads[i], src, invoke_id) &&
+            (RPM_Batch_Reads[i].object_type == rp_data->object_type) &&
+            (RPM_Batch_Reads[i].object_instance == rp_data->object_instance)
+            && (RPM_Batch_Reads[i].object_property == rp_data->object_property)
+            && (RPM_Batch_Reads[i].array_index == rp_data->array_index)) {
+            return &RPM_Batch_Reads[i];
+        }
+    }
+
+    return NULL;
+}
+
+/** Handler for a ReadPropertyMultiple ACK.
+ * @ingroup DSRPMB
+ * Walks the ACK in place - nothing is allocated - and calls back each
+ * read that it answers.  Reads of the request that the ACK leaves out
+ * are failed.
+ *
+ * @param service_request [in] The contents of the service request.
+ * @param service_len [in] The length of the service_request.
+ * @param src [in] BACNET_ADDRESS of the source of the message
+ * @param service_data [in] The BACNET_CONFIRMED_SERVICE_ACK_DATA information
+ *                          decoded from the APDU header of this message.
+ */
+void rpm_batch_ack_handler(
+    uint8_t * service_request,
+    uint16_t service_len,
+    BACNET_ADDRESS * src,
+    BACNET_CONFIRMED_SERVICE_ACK_DATA * service_data)
+{
+    BACNET_READ_PROPERTY_DATA rp_data;
+    RPM_BATCH_READ *pRead = NULL;
+    uint8_t *apdu = service_request;
+    unsigned len = 0;
+    int data_len = 0;
+
+    if (rpm_batch_waiting_count(src, service_data->invoke_id) == 0) {
+        handler_read_property_multiple_ack(service_request, service_len, src,
+            service_data);
+        return;
+    }
+    while (len < service_len) {
+        data_len =
+            rpm_ack_decode_object_id(&apdu[len], service_len - len,
+            &rp_data.object_type, &rp_data.object_instance);
+        if (data_len <= 0) {
+            break;
+        }
+        len += (unsigned) data_len;
+        while ((len < service_len) &&
+            !decode_is_closing_tag_number(&apdu[len], 1)) {
+            data_len =
+                rpm_ack_decode_object_property(&apdu[len], service_len - len,
+                &rp_data.object_property, &rp_data.array_index);
+            if ((data_len <= 0) || ((len + data_len) >= service_len)) {
+                goto RPM_BATCH_DONE;
+            }
+            len += (unsigned) data_len;
+            if (decode_is_opening_tag_number(&apdu[len], 4)) {
+                /* propertyValue */
+                data_len =
+                    bacapp_data_len(&apdu[len], service_len - len,
+                    rp_data.object_property);
+                if (data_len < 0) {
+                    goto RPM_BATCH_DONE;
+                }
+                rp_data.application_data = &apdu[len + 1];
+                rp_data.application_data_len = data_len;
+                rp_data.error_class = ERROR_CLASS_PROPERTY;
+                rp_data.error_code = ERROR_CODE_OTHER;
+                len += (unsigned) data_len + 2;
+            } else if (decode_is_opening_tag_number(&apdu[len], 5)) {
+                /* propertyAccessError */
+                len++;
+                data_len =
+                    rpm_batch_decode_error(&apdu[len], service_len - len,
+                    &rp_data);
+                if (data_len <= 0) {
+                    goto RPM_BATCH_DONE;
+                }
+                len += (unsigned) data_len + 1;
+                rp_data.application_data = NULL;
+                rp_data.application_data_len = 0;
+            } else {
+                goto RPM_BATCH_DONE;
+            }
+            pRead = rpm_batch_find(src, service_data->invoke_id, &rp_data);
+            if (pRead) {
+                rpm_batch_complete(pRead, &rp_data);
+            }
+        }
+        /* closing tag of listOfResults */
+        len++;
+    }
+
+  RPM_BATCH_DONE:
+    rpm_batch_fail(src, service_data->invoke_id, ERROR_CLASS_SERVICES,
+        ERROR_CODE_OTHER);
+}
+
+#ifdef TEST
+#include <assert.h>
+#include "ctest.h"
+#include "bacerror.h"
+#include "reject.h"
+#include "abort.h"
+
+/* the requests the datalink was asked to send, and the last of them */
+static unsigned Test_Requests;
+static uint8_t Test_Request[MAX_PDU];
+static unsigned Test_Request_Len;
+/* ACKs passed on to handler_read_property_multiple_ack() */
+static unsigned Test_Foreign_ACKs;
+
+typedef struct test_result {
+    unsigned calls;
+    bool value;
+    BACNET_ERROR_CLASS error_class;
+    BACNET_ERROR_CODE error_code;
+} TEST_RESULT;
+static TEST_RESULT Test_Result[MAX_RPM_BATCH_READS];
+
+int datalink_send_pdu(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    uint8_t * pdu,
+    unsigned pdu_len)
+{
+    (void) dest;
+    (void) npdu_data;
+    memcpy(Test_Request, pdu, pdu_len);
+    Test_Request_Len = pdu_len;
+    Test_Requests++;
+
+    return (int) pdu_len;
+}
+
+void datalink_get_broadcast_address(
+    BACNET_ADDRESS * dest)
+{
+    memset(dest, 0, sizeof(BACNET_ADDRESS));
+}
+
+void datalink_get_my_address(
+    BACNET_ADDRESS * my_address)
+{
+    memset(my_address, 0, sizeof(BACNET_ADDRESS));
+}
+
+void handler_read_property_multiple_ack(
+    uint8_t * service_request,
+    uint16_t service_len,
+    BACNET_ADDRESS * src,
+    BACNET_CONFIRMED_SERVICE_ACK_DATA * service_data)
+{
+    (void) service_request;
+    (void) service_len;
+    (void) src;
+    (void) service_data;
+    Test_Foreign_ACKs++;
+}
+
+static void test_callback(
+    uint32_t device_id,
+    BACNET_READ_PROPERTY_DATA * rp_data,
+    void *context)
+{
+    TEST_RESULT *result = (TEST_RESULT *) context;
+
+    (void) device_id;
+    result->calls++;
+    result->value = (rp_data->application_data != NULL);
+    result->error_class = rp_data->error_class;
+    result->error_code = rp_data->error_code;
+}
+
+static void test_address(
+    BACNET_ADDRESS * src,
+    uint8_t mac)
+{
+    memset(src, 0, sizeof(BACNET_ADDRESS));
+    src->mac_len = 1;
+    src->mac[0] = mac;
+}
+
+/* starts a test with the device bound at this MAC address */
+static void test_init(
+    uint32_t device_id,
+    unsigned max_apdu,
+    BACNET_ADDRESS * src)
+{
+    rpm_batch_init();
+    memset(Test_Result, 0, sizeof(Test_Result));
+    Test_Requests = 0;
+    Test_Foreign_ACKs = 0;
+    test_address(src, (uint8_t) device_id);
+    address_add(device_id, max_apdu, src);
+}
+
+static void test_read(
+    Test * pTest,
+    uint32_t device_id,
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance,
+    BACNET_PROPERTY_ID object_property,
+    unsigned index)
+{
+    ct_test(pTest, rpm_batch_read(device_id, object_type, object_instance,
+            object_property, BACNET_ARRAY_ALL, test_callback,
+            &Test_Result[index]));
+}
+
+/* the invoke ID of the last request sent, and its service request */
+static uint8_t test_request_decode(
+    uint8_t ** service_request,
+    unsigned *service_request_len)
+{
+    BACNET_ADDRESS dest;
+    BACNET_ADDRESS src;
+    BACNET_NPDU_DATA npdu_data;
+    uint8_t *apdu = NULL;
+    int npdu_len = 0;
+
+    npdu_len = npdu_decode(Test_Request, &dest, &src, &npdu_data);
+    apdu = &Test_Request[npdu_len];
+    /* type, max segs and APDU, invoke ID, service choice */
+    *service_request = &apdu[4];
+    *service_request_len = Test_Request_Len - (unsigned) npdu_len - 4;
+
+    return apdu[2];
+}
+
+/* number of ReadAccessSpecifications and of properties in the request */
+static void test_request_count(
+    Test * pTest,
+    unsigned *objects,
+    unsigned *properties)
+{
+    BACNET_RPM_DATA rpmdata;
+    uint8_t *apdu = NULL;
+    unsigned apdu_len = 0;
+    unsigned len = 0;
+    int data_len = 0;
+
+    *objects = 0;
+    *properties = 0;
+    (void) test_request_decode(&apdu, &apdu_len);
+    while (len < apdu_len) {
+        data_len = rpm_decode_object_id(&apdu[len], apdu_len - len, &rpmdata);
+        ct_test(pTest, data_len > 0);
+        if (data_len <= 0) {
+            return;
+        }
+        len += (unsigned) data_len;
+        (*objects)++;
+        while (rpm_decode_object_end(&apdu[len], apdu_len - len) == 0) {
+            data_len =
+                rpm_decode_object_property(&apdu[len], apdu_len - len,
+                &rpmdata);
+            ct_test(pTest, data_len > 0);
+            if (data_len <= 0) {
+                return;
+            }
+            len += (unsigned) data_len;
+            (*properties)++;
+        }
+        len++;
+    }
+}
+
+/* answers the reads of the request with this invoke ID from src:
+   the read in slot error with a propertyAccessError, the one in slot
+   skip not at all */
+static void test_ack(
+    BACNET_ADDRESS * src,
+    uint8_t invoke_id,
+    unsigned error,
+    unsigned skip)
+{
+    BACNET_RPM_DATA rpmdata;
+    uint8_t apdu[MAX_APDU];
+    uint8_t value[8];
+    int value_len = 0;
+    int apdu_len = 0;
+    unsigned i = 0;
+
+    apdu_len = rpm_ack_encode_apdu_init(apdu, invoke_id);
+    for (i = 0; i < MAX_RPM_BATCH_READS; i++) {
+        if ((RPM_Batch_Reads[i].state != RPM_BATCH_SENT) ||
+            (RPM_Batch_Reads[i].invoke_id != invoke_id) || (i == skip)) {
+            continue;
+        }
+        rpmdata.object_type = RPM_Batch_Reads[i].object_type;
+        rpmdata.object_instance = RPM_Batch_Reads[i].object_instance;
+        apdu_len +=
+            rpm_ack_encode_apdu_object_begin(&apdu[apdu_len], &rpmdata);
+        apdu_len +=
+            rpm_ack_encode_apdu_object_property(&apdu[apdu_len],
+            RPM_Batch_Reads[i].object_property,
+            RPM_Batch_Reads[i].array_index);
+        if (i == error) {
+            apdu_len +=
+                rpm_ack_encode_apdu_object_property_error(&apdu[apdu_len],
+                ERROR_CLASS_PROPERTY, ERROR_CODE_UNKNOWN_PROPERTY);
+        } else {
+            value_len = encode_application_unsigned(value, i);
+            apdu_len +=
+                rpm_ack_encode_apdu_object_property_value(&apdu[apdu_len],
+                value, (unsigned) value_len);
+        }
+        apdu_len += rpm_ack_encode_apdu_object_end(&apdu[apdu_len]);
+    }
+    apdu_handler(src, apdu, (uint16_t) apdu_len);
+}
+
+/* reads are batched by device and object, and their ACK is taken apart */
+void testRPMBatch(
+    Test * pTest)
+{
+    BACNET_ADDRESS src;
+    BACNET_ADDRESS other;
+    uint8_t *apdu = NULL;
+    unsigned apdu_len = 0;
+    unsigned objects = 0;
+    unsigned properties = 0;
+    uint8_t invoke_id = 0;
+    unsigned i = 0;
+
+    test_init(1, MAX_APDU, &src);
+    test_read(pTest, 1, OBJECT_ANALOG_INPUT, 0, PROP_PRESENT_VALUE, 0);
+    test_read(pTest, 1, OBJECT_ANALOG_INPUT, 1, PROP_PRESENT_VALUE, 1);
+    test_read(pTest, 1, OBJECT_ANALOG_INPUT, 0, PROP_UNITS, 2);
+    test_read(pTest, 1, OBJECT_BINARY_INPUT, 0, PROP_PRESENT_VALUE, 3);
+    test_read(pTest, 1, OBJECT_ANALOG_INPUT, 0, PROP_STATUS_FLAGS, 4);
+    /* a device that is not bound waits */
+    test_read(pTest, 99, OBJECT_DEVICE, 99, PROP_OBJECT_NAME, 5);
+    ct_test(pTest, rpm_batch_send() == 1);
+    ct_test(pTest, Test_Requests == 1);
+    ct_test(pTest, rpm_batch_pending_count() == 6);
+    test_request_count(pTest, &objects, &properties);
+    ct_test(pTest, objects == 3);
+    ct_test(pTest, properties == 5);
+    invoke_id = test_request_decode(&apdu, &apdu_len);
+    /* an ACK with our invoke ID from another device is not ours */
+    test_address(&other, 2);
+    test_ack(&other, invoke_id, MAX_RPM_BATCH_READS, MAX_RPM_BATCH_READS);
+    ct_test(pTest, Test_Foreign_ACKs == 1);
+    ct_test(pTest, rpm_batch_pending_count() == 6);
+    /* the ACK answers read 2 with an error, and leaves read 4 out */
+    test_ack(&src, invoke_id, 2, 4);
+    ct_test(pTest, Test_Foreign_ACKs == 1);
+    for (i = 0; i < 5; i++) {
+        ct_test(pTest, Test_Result[i].calls == 1);
+    }
+    ct_test(pTest, Test_Result[0].value);
+    ct_test(pTest, Test_Result[1].value);
+    ct_test(pTest, Test_Result[3].value);
+    ct_test(pTest, !Test_Result[2].value);
+    ct_test(pTest, Test_Result[2].error_class == ERROR_CLASS_PROPERTY);
+    ct_test(pTest, Test_Result[2].error_code == ERROR_CODE_UNKNOWN_PROPERTY);
+    ct_test(pTest, !Test_Result[4].value);
+    ct_test(pTest, Test_Result[4].error_class == ERROR_CLASS_SERVICES);
+    ct_test(pTest, Test_Result[5].calls == 0);
+    ct_test(pTest, rpm_batch_pending_count() == 1);
+    /* once bound, the last read goes out */
+    test_address(&other, 99);
+    address_add(99, MAX_APDU, &other);
+    rpm_batch_task();
+    ct_test(pTest, Test_Requests == 2);
+    invoke_id = test_request_decode(&apdu, &apdu_len);
+    test_ack(&other, invoke_id, MAX_RPM_BATCH_READS, MAX_RPM_BATCH_READS);
+    ct_test(pTest, Test_Result[5].calls == 1);
+    ct_test(pTest, Test_Result[5].value);
+    ct_test(pTest, rpm_batch_pending_count() == 0);
+    address_remove_device(1);
+    address_remove_device(99);
+}
+
+/* a request holds only as many reads as their ACK is expected to fit */
+void testRPMBatchSplit(
+    Test * pTest)
+{
+    BACNET_ADDRESS src;
+    uint8_t *apdu = NULL;
+    unsigned apdu_len = 0;
+    unsigned objects = 0;
+    unsigned properties = 0;
+    unsigned i = 0;
+
+    /* the smallest max APDU there is */
+    test_init(2, 50, &src);
+    for (i = 0; i < 6; i++) {
+        test_read(pTest, 2, OBJECT_ANALOG_VALUE, i, PROP_PRESENT_VALUE, i);
+    }
+    ct_test(pTest, rpm_batch_send() == 3);
+    test_request_count(pTest, &objects, &properties);
+    ct_test(pTest, properties == 2);
+    for (i = 0; i < 3; i++) {
+        tsm_free_invoke_id(RPM_Batch_Reads[2 * i].invoke_id);
+    }
+    /* names cost more, so each takes a request of its own */
+    test_init(2, 50, &src);
+    for (i = 0; i < 4; i++) {
+        test_read(pTest, 2, OBJECT_ANALOG_VALUE, i, PROP_OBJECT_NAME, i);
+    }
+    ct_test(pTest, rpm_batch_send() == 4);
+    test_request_count(pTest, &objects, &properties);
+    ct_test(pTest, properties == 1);
+    for (i = 0; i < 4; i++) {
+        tsm_free_invoke_id(RPM_Batch_Reads[i].invoke_id);
+    }
+    /* and a whole list goes on its own even in a large APDU */
+    test_init(2, MAX_APDU, &src);
+    test_read(pTest, 2, OBJECT_DEVICE, 2, PROP_OBJECT_NAME, 0);
+    test_read(pTest, 2, OBJECT_DEVICE, 2, PROP_OBJECT_LIST, 1);
+    test_read(pTest, 2, OBJECT_DEVICE, 2, PROP_MODEL_NAME, 2);
+    ct_test(pTest, rpm_batch_send() == 2);
+    ct_test(pTest, RPM_Batch_Reads[0].invoke_id ==
+        RPM_Batch_Reads[2].invoke_id);
+    ct_test(pTest, RPM_Batch_Reads[0].invoke_id !=
+        RPM_Batch_Reads[1].invoke_id);
+    (void) test_request_decode(&apdu, &apdu_len);
+    test_request_count(pTest, &objects, &properties);
+    ct_test(pTest, properties == 1);
+    tsm_free_invoke_id(RPM_Batch_Reads[0].invoke_id);
+    tsm_free_invoke_id(RPM_Batch_Reads[1].invoke_id);
+    rpm_batch_init();
+    address_remove_device(2);
+}
+
+/* Rejects and Aborts passed on to the handlers set before */
+static unsigned Test_Other_Rejects;
+static unsigned Test_Other_Aborts;
+
+static void test_reject_handler(
+    BACNET_ADDRESS * src,
+    uint8_t invoke_id,
+    uint8_t reject_reason)
+{
+    (void) src;
+    (void) invoke_id;
+    (void) reject_reason;
+    Test_Other_Rejects++;
+}
+
+static void test_abort_handler(
+    BACNET_ADDRESS * src,
+    uint8_t invoke_id,
+    uint8_t abort_reason,
+    bool server)
+{
+    (void) src;
+    (void) invoke_id;
+    (void) abort_reason;
+    (void) server;
+    Test_Other_Aborts++;
+}
+
+/* an Error, Reject, Abort or timeout fails the reads of its request */
+void testRPMBatchErrors(
+    Test * pTest)
+{
+    BACNET_ADDRESS src;
+    BACNET_ADDRESS other;
+    uint8_t *apdu = NULL;
+    uint8_t reply[MAX_APDU];
+    unsigned apdu_len = 0;
+    int reply_len = 0;
+    uint8_t invoke_id = 0;
+    unsigned i = 0;
+
+    /* handlers of the application, which the batch passes on to */
+    apdu_set_reject_handler(test_reject_handler);
+    apdu_set_abort_handler(test_abort_handler);
+    test_init(3, MAX_APDU, &src);
+    ct_test(pTest, apdu_get_reject_handler() == rpm_batch_reject_handler);
+    ct_test(pTest, apdu_get_abort_handler() == rpm_batch_abort_handler);
+    test_address(&other, 4);
+    test_read(pTest, 3, OBJECT_ANALOG_VALUE, 0, PROP_PRESENT_VALUE, 0);
+    test_read(pTest, 3, OBJECT_ANALOG_VALUE, 1, PROP_PRESENT_VALUE, 1);
+    ct_test(pTest, rpm_batch_send() == 1);
+    invoke_id = test_request_decode(&apdu, &apdu_len);
+    rpm_batch_error_handler(&other, invoke_id, ERROR_CLASS_OBJECT,
+        ERROR_CODE_UNKNOWN_OBJECT);
+    ct_test(pTest, rpm_batch_pending_count() == 2);
+    /* a Reject or Abort of another request is not the batch's */
+    reply_len =
+        reject_encode_apdu(reply, invoke_id,
+        REJECT_REASON_UNRECOGNIZED_SERVICE);
+    apdu_handler(&other, reply, (uint16_t) reply_len);
+    reply_len =
+        abort_encode_apdu(reply, (uint8_t) (invoke_id + 1),
+        ABORT_REASON_OTHER, true);
+    apdu_handler(&src, reply, (uint16_t) reply_len);
+    ct_test(pTest, rpm_batch_pending_count() == 2);
+    ct_test(pTest, Test_Other_Rejects == 1);
+    ct_test(pTest, Test_Other_Aborts == 1);
+    reply_len =
+        bacerror_encode_apdu(reply, invoke_id,
+        SERVICE_CONFIRMED_READ_PROP_MULTIPLE, ERROR_CLASS_OBJECT,
+        ERROR_CODE_UNKNOWN_OBJECT);
+    apdu_handler(&src, reply, (uint16_t) reply_len);
+    ct_test(pTest, rpm_batch_pending_count() == 0);
+    for (i = 0; i < 2; i++) {
+        ct_test(pTest, Test_Result[i].calls == 1);
+        ct_test(pTest, Test_Result[i].error_class == ERROR_CLASS_OBJECT);
+        ct_test(pTest, Test_Result[i].error_code ==
+            ERROR_CODE_UNKNOWN_OBJECT);
+    }
+
+    test_init(3, MAX_APDU, &src);
+    test_read(pTest, 3, OBJECT_ANALOG_VALUE, 0, PROP_PRESENT_VALUE, 0);
+    ct_test(pTest, rpm_batch_send() == 1);
+    invoke_id = test_request_decode(&apdu, &apdu_len);
+    reply_len =
+        reject_encode_apdu(reply, invoke_id,
+        REJECT_REASON_UNRECOGNIZED_SERVICE);
+    apdu_handler(&src, reply, (uint16_t) reply_len);
+    ct_test(pTest, Test_Result[0].calls == 1);
+    ct_test(pTest, Test_Result[0].error_class == ERROR_CLASS_SERVICES);
+    ct_test(pTest, Test_Result[0].error_code ==
+        ERROR_CODE_REJECT_UNRECOGNIZED_SERVICE);
+
+    /* an ACK too big for a request of three sends each on its own */
+    test_init(3, MAX_APDU, &src);
+    for (i = 0; i < 3; i++) {
+        test_read(pTest, 3, OBJECT_ANALOG_VALUE, i, PROP_PRESENT_VALUE, i);
+    }
+    ct_test(pTest, rpm_batch_send() == 1);
+    invoke_id = test_request_decode(&apdu, &apdu_len);
+    reply_len =
+        abort_encode_apdu(reply, invoke_id,
+        ABORT_REASON_SEGMENTATION_NOT_SUPPORTED, true);
+    apdu_handler(&src, reply, (uint16_t) reply_len);
+    ct_test(pTest, rpm_batch_pending_count() == 3);
+    ct_test(pTest, Test_Result[0].calls == 0);
+    rpm_batch_task();
+    ct_test(pTest, Test_Requests == 4);
+    for (i = 0; i < 3; i++) {
+        ct_test(pTest, RPM_Batch_Reads[i].state == RPM_BATCH_SENT);
+    }
+    /* the last of them is too big on its own, and fails */
+    invoke_id = test_request_decode(&apdu, &apdu_len);
+    /* an Abort from a client is not an answer */
+    rpm_batch_abort_handler(&src, invoke_id, ABORT_REASON_BUFFER_OVERFLOW,
+        false);
+    ct_test(pTest, rpm_batch_pending_count() == 3);
+    ct_test(pTest, Test_Other_Aborts == 2);
+    reply_len =
+        abort_encode_apdu(reply, invoke_id, ABORT_REASON_BUFFER_OVERFLOW,
+        true);
+    apdu_handler(&src, reply, (uint16_t) reply_len);
+    ct_test(pTest, rpm_batch_pending_count() == 2);
+    ct_test(pTest, Test_Result[2].calls == 1);
+    ct_test(pTest, Test_Result[2].error_class == ERROR_CLASS_COMMUNICATION);
+    ct_test(pTest, Test_Result[2].error_code ==
+        ERROR_CODE_ABORT_BUFFER_OVERFLOW);
+    /* the others are never answered */
+    for (i = 0; i <= apdu_retries(); i++) {
+        tsm_timer_milliseconds(apdu_timeout());
+    }
+    rpm_batch_task();
+    ct_test(pTest, rpm_batch_pending_count() == 0);
+    for (i = 0; i < 2; i++) {
+        ct_test(pTest, Test_Result[i].calls == 1);
+        ct_test(pTest, Test_Result[i].error_class ==
+            ERROR_CLASS_COMMUNICATION);
+        ct_test(pTest, Test_Result[i].error_code == ERROR_CODE_TIMEOUT);
+    }
+    address_remove_device(3);
+}
+
+#ifdef TEST_RPM_BATCH
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("BACnet ReadPropertyMultiple Batch", NULL);
+    /* individual tests */
+    rc = ct_addTestFunction(pTest, testRPMBatch);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testRPMBatchSplit);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testRPMBatchErrors);
+    assert(rc);
+
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_RPM_BATCH */
+#endif /* TEST */
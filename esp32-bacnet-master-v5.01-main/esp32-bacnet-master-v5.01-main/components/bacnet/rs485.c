@@ -0,0 +1,340 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#include "driver/gptimer.h"
+#include "esp_timer.h"
+#include "esp_intr_alloc.h"
+#include "esp_rom_sys.h"
+#include "esp_log.h"
+#include "hal/uart_hal.h"
+#include "soc/soc_caps.h"
+#include "soc/uart_periph.h"
+#include "config.h"
+#include "fifo.h"
+#include "mstp.h"
+#include "rs485.h"
+
+/** @file rs485.c  MS/TP line on an ESP32 UART in RS-485 half duplex mode */
+
+static const char *TAG = "rs485";
+
+/* octets waiting for the MS/TP task, a power of two: enough for a whole
+   frame, should the task be held up that long */
+#define RS485_RX_FIFO_SIZE 1024
+
+/* the receive interrupts: an octet, and every kind of error */
+#define RS485_RX_INTR (UART_INTR_RXFIFO_FULL | UART_INTR_RXFIFO_TOUT | \
+    UART_INTR_RXFIFO_OVF | UART_INTR_FRAM_ERR | UART_INTR_PARITY_ERR)
+
+static volatile uint8_t Receive_Store[RS485_RX_FIFO_SIZE];
+/* written by the interrupt, read by the MS/TP task */
+static FIFO_BUFFER Receive_Buffer;
+/* set by the interrupt on a UART error or a full FIFO */
+static volatile bool Receive_Error;
+/* the time of the last octet on the line, in microseconds */
+static volatile uint32_t Silence_Start;
+static uint32_t Baud_Rate = MSTP_BAUD_RATE;
+static uart_hal_context_t RS485_Hal;
+static intr_handle_t RS485_Intr;
+/* ticks every millisecond, to wake the task for the MS/TP timeouts */
+static gptimer_handle_t Tick_Timer;
+/* the task woken by the interrupts */
+static volatile TaskHandle_t Wait_Task;
+
+static void rs485_isr(
+    void *arg)
+{
+    uint8_t data[SOC_UART_FIFO_LEN];
+    uint32_t status;
+    int len = 0;
+    BaseType_t woken = pdFALSE;
+
+    (void) arg;
+    status = uart_hal_get_intsts_mask(&RS485_Hal);
+    if (status & (UART_INTR_FRAM_ERR | UART_INTR_PARITY_ERR |
+            UART_INTR_RXFIFO_OVF)) {
+        Receive_Error = true;
+        if (status & UART_INTR_RXFIFO_OVF) {
+            uart_hal_rxfifo_rst(&RS485_Hal);
+        }
+    }
+    len = (int) uart_hal_get_rxfifo_len(&RS485_Hal);
+    if (len > 0) {
+        if (len > (int) sizeof(data)) {
+            len = sizeof(data);
+        }
+        uart_hal_read_rxfifo(&RS485_Hal, data, &len);
+        if (!FIFO_Add(&Receive_Buffer, data, (unsigned) len)) {
+            /* the task fell behind: the frame is lost either way */
+            Receive_Error = true;
+        }
+        Silence_Start = (uint32_t) esp_timer_get_time();
+    }
+    uart_hal_clr_intsts_mask(&RS485_Hal, status);
+    if (Wait_Task) {
+        vTaskNotifyGiveFromISR(Wait_Task, &woken);
+    }
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static bool rs485_tick(
+    gptimer_handle_t timer,
+    const gptimer_alarm_event_data_t * edata,
+    void *user_ctx)
+{
+    BaseType_t woken = pdFALSE;
+
+    (void) timer;
+    (void) edata;
+    (void) user_ctx;
+    if (Wait_Task) {
+        vTaskNotifyGiveFromISR(Wait_Task, &woken);
+    }
+
+    return (woken == pdTRUE);
+}
+
+/**
+ * Returns the time since the last octet was sent or received.
+ *
+ * @param pArg - the MS/TP port, unused
+ *
+ * @return the silence on the line, in milliseconds
+ */
+uint32_t RS485_Silence_Milliseconds(
+    void *pArg)
+{
+    (void) pArg;
+
+    return ((uint32_t) esp_timer_get_time() - Silence_Start) / 1000UL;
+}
+
+/**
+ * Starts the silence timer over.
+ *
+ * @param pArg - the MS/TP port, unused
+ */
+void RS485_Silence_Reset(
+    void *pArg)
+{
+    (void) pArg;
+    Silence_Start = (uint32_t) esp_timer_get_time();
+}
+
+/**
+ * Sets the baud rate, now or for RS485_Initialize().
+ *
+ * @param baud - 9600, 19200, 38400, 57600, 76800 or 115200
+ *
+ * @return true if the baud rate is valid
+ */
+bool RS485_Set_Baud_Rate(
+    uint32_t baud)
+{
+    switch (baud) {
+        case 9600:
+        case 19200:
+        case 38400:
+        case 57600:
+        case 76800:
+        case 115200:
+            Baud_Rate = baud;
+            if (RS485_Intr) {
+                (void) uart_set_baudrate(MSTP_UART_NUM, baud);
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint32_t RS485_Get_Baud_Rate(
+    void)
+{
+    return Baud_Rate;
+}
+
+/**
+ * Sends a frame: waits out the turnaround time after the last octet
+ * received, keeps the transmit FIFO fed so that there is no gap between
+ * octets, and releases the line once the last stop bit is out.
+ *
+ * @param mstp_port - the MS/TP port
+ * @param buffer - the frame
+ * @param nbytes - number of octets in the frame
+ */
+void RS485_Send_Frame(
+    volatile struct mstp_port_struct_t *mstp_port,
+    uint8_t * buffer,
+    uint16_t nbytes)
+{
+    uint32_t turnaround = (Tturnaround * 1000000UL) / Baud_Rate;
+    uint32_t silence = 0;
+    uint32_t written = 0;
+
+    silence = (uint32_t) esp_timer_get_time() - Silence_Start;
+    if (silence < turnaround) {
+        esp_rom_delay_us(turnaround - silence);
+    }
+    /* enable the transceiver driver */
+    uart_hal_set_rts(&RS485_Hal, 0);
+    while (nbytes) {
+        uart_hal_write_txfifo(&RS485_Hal, buffer, nbytes, &written);
+        buffer += written;
+        nbytes -= (uint16_t) written;
+    }
+    while (!uart_hal_is_tx_idle(&RS485_Hal)) {
+        /* the last octet is going out */
+    }
+    /* nothing heard while sending is from another station */
+    uart_hal_rxfifo_rst(&RS485_Hal);
+    uart_hal_set_rts(&RS485_Hal, 1);
+    mstp_port->SilenceTimerReset((void *) mstp_port);
+}
+
+/**
+ * Gives the receive state machine the next octet or error.  Call it
+ * only when the port has neither DataAvailable nor ReceiveError set.
+ *
+ * @param mstp_port - the MS/TP port
+ */
+void RS485_Check_UART_Data(
+    volatile struct mstp_port_struct_t *mstp_port)
+{
+    if (Receive_Error) {
+        Receive_Error = false;
+        mstp_port->ReceiveError = true;
+    } else if (!FIFO_Empty(&Receive_Buffer)) {
+        mstp_port->DataRegister = FIFO_Get(&Receive_Buffer);
+        mstp_port->DataAvailable = true;
+    }
+}
+
+/**
+ * Tells whether there are octets or an error for RS485_Check_UART_Data().
+ *
+ * @return true if there is something to check
+ */
+bool RS485_Data_Pending(
+    void)
+{
+    return (Receive_Error || !FIFO_Empty(&Receive_Buffer));
+}
+
+/**
+ * Blocks the calling task until octets are received or the next
+ * millisecond tick, whichever comes first.
+ */
+void RS485_Wait_Event(
+    void)
+{
+    if (!Wait_Task) {
+        Wait_Task = xTaskGetCurrentTaskHandle();
+    }
+    (void) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10) + 1);
+}
+
+/**
+ * Sets up the UART, its pins and interrupt, and the millisecond timer.
+ */
+void RS485_Initialize(
+    void)
+{
+    uart_config_t uart_config = {
+        .baud_rate = (int) Baud_Rate,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = 1000000,
+    };
+    gptimer_event_callbacks_t timer_callbacks = {
+        .on_alarm = rs485_tick,
+    };
+    gptimer_alarm_config_t alarm_config = {
+        .reload_count = 0,
+        .alarm_count = 1000,
+        .flags.auto_reload_on_alarm = true,
+    };
+
+    FIFO_Init(&Receive_Buffer, Receive_Store, sizeof(Receive_Store));
+    RS485_Hal.dev = UART_LL_GET_HW(MSTP_UART_NUM);
+    ESP_ERROR_CHECK(uart_param_config(MSTP_UART_NUM, &uart_config));
+    ESP_ERROR_CHECK(uart_set_pin(MSTP_UART_NUM, MSTP_TX_GPIO, MSTP_RX_GPIO,
+            MSTP_DE_GPIO, UART_PIN_NO_CHANGE));
+    /* the octets are taken by our own interrupt, not the UART driver */
+    uart_hal_set_mode(&RS485_Hal, UART_MODE_RS485_HALF_DUPLEX);
+    uart_hal_set_rts(&RS485_Hal, 1);
+    uart_hal_rxfifo_rst(&RS485_Hal);
+    uart_hal_txfifo_rst(&RS485_Hal);
+    /* an interrupt for each octet, so that its time is known */
+    uart_hal_set_rxfifo_full_thr(&RS485_Hal, 1);
+    uart_hal_disable_intr_mask(&RS485_Hal, UART_LL_INTR_MASK);
+    uart_hal_clr_intsts_mask(&RS485_Hal, UART_LL_INTR_MASK);
+    ESP_ERROR_CHECK(esp_intr_alloc(uart_periph_signal[MSTP_UART_NUM].irq, 0,
+            rs485_isr, NULL, &RS485_Intr));
+    uart_hal_ena_intr_mask(&RS485_Hal, RS485_RX_INTR);
+    Silence_Start = (uint32_t) esp_timer_get_time();
+
+    ESP_ERROR_CHECK(gptimer_new_timer(&timer_config, &Tick_Timer));
+    ESP_ERROR_CHECK(gptimer_register_event_callbacks(Tick_Timer,
+            &timer_callbacks, NULL));
+    ESP_ERROR_CHECK(gptimer_set_alarm_action(Tick_Timer, &alarm_config));
+    ESP_ERROR_CHECK(gptimer_enable(Tick_Timer));
+    ESP_ERROR_CHECK(gptimer_start(Tick_Timer));
+    ESP_LOGI(TAG, "UART%d at %lu baud", MSTP_UART_NUM,
+        (unsigned long) Baud_Rate);
+}
+
+/**
+ * Releases the UART interrupt and the timer.
+ */
+void RS485_Cleanup(
+    void)
+{
+    if (Tick_Timer) {
+        (void) gptimer_stop(Tick_Timer);
+        (void) gptimer_disable(Tick_Timer);
+        (void) gptimer_del_timer(Tick_Timer);
+        Tick_Timer = NULL;
+    }
+    if (RS485_Intr) {
+        uart_hal_disable_intr_mask(&RS485_Hal, UART_LL_INTR_MASK);
+        (void) esp_intr_free(RS485_Intr);
+        RS485_Intr = NULL;
+    }
+    Wait_Task = NULL;
+}
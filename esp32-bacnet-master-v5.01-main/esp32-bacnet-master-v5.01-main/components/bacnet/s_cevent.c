@@ -72,7 +72,8 @@ uint8_t Send_CEvent_Notify(
     if (invoke_id) {
         /* encode the NPDU portion of the packet */
         datalink_get_my_address(&my_address);
-        npdu_encode_npdu_data(&npdu_data, true, MESSAGE_PRIORITY_NORMAL);
+        npdu_encode_npdu_data(&npdu_data, true,
+            event_notify_network_priority(data->priority));
         pdu_len =
             npdu_encode_pdu(&Handler_Transmit_Buffer[0], &dest, &my_address,
             &npdu_data);
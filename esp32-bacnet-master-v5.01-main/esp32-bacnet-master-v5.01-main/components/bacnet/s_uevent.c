@@ -53,7 +53,8 @@ int Send_UEvent_Notify(
 
     datalink_get_my_address(&my_address);
     /* encode the NPDU portion of the packet */
-    npdu_encode_npdu_data(&npdu_data, false, MESSAGE_PRIORITY_NORMAL);
+    npdu_encode_npdu_data(&npdu_data, false,
+        event_notify_network_priority(data->priority));
     pdu_len = npdu_encode_pdu(buffer, dest, &my_address, &npdu_data);
     /* encode the APDU portion of the packet */
     len = uevent_notify_encode_apdu(&buffer[pdu_len], data);
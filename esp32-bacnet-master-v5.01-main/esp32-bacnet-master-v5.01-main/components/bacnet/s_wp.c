@@ -152,7 +152,9 @@ uint8_t Send_Write_Property_Request(
     uint32_t array_index)
 {
     uint8_t application_data[MAX_APDU] = { 0 };
-    int apdu_len = 0, len = 0;
+    BACAPP_CURSOR cursor;
+
+    bacapp_cursor_init(&cursor, &application_data[0], sizeof(application_data));
 
     while (object_value) {
 #if PRINT_ENABLED_DEBUG
@@ -162,16 +164,13 @@ uint8_t Send_Write_Property_Request(
                 context_specific ? object_value->context_tag : object_value->
                 tag));
 #endif
-        len = bacapp_encode_data(&application_data[apdu_len], object_value);
-        if ((len + apdu_len) < MAX_APDU) {
-            apdu_len += len;
-        } else {
+        if (bacapp_cursor_encode_data(&cursor, object_value) <= 0) {
             return 0;
         }
         object_value = object_value->next;
     }
 
     return Send_Write_Property_Request_Data(device_id, object_type,
-        object_instance, object_property, &application_data[0], apdu_len,
+        object_instance, object_property, &application_data[0], (int) cursor.len,
         priority, array_index);
 }
@@ -0,0 +1,955 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "bacint.h"
+#include "objinst.h"
+#include "trendlog.h"
+#include "tlarchive.h"
+
+/** @file tlarchive.c  Trend Log records kept in page files on flash */
+
+#if TREND_LOG_ARCHIVE
+
+/* largest encoding of a record after the first of a page:
+   time delta and change flag, type and status, datum delta */
+#define TL_RECORD_ENC_MAX (5 + 2 + 5)
+
+/* the queue is shared by the server task, which adds the jobs,
+   and the archive task, which does them; each index is only
+   written by one of them */
+#define TL_BARRIER() __sync_synchronize()
+
+typedef enum {
+    TL_JOB_WRITE,
+    TL_JOB_ERASE
+} TL_JOB_KIND;
+
+typedef struct tl_job {
+    TL_ARCHIVE *Archive;
+    TL_JOB_KIND Kind;
+    uint32_t Slot;
+    uint8_t *Page;
+} TL_JOB;
+
+static TL_ARCHIVE Archives[MAX_TREND_LOGS];
+static TL_JOB Queue[TL_ARCHIVE_QUEUE];
+/* jobs added, and jobs done */
+static volatile uint32_t Queue_Head;
+static volatile uint32_t Queue_Tail;
+/* the last page read from the flash - only ever read at start up
+   and by the server task, never by the archive task */
+static uint8_t *Read_Page;
+static TL_ARCHIVE *Read_Archive;
+static uint32_t Read_Page_Number;
+
+static int tl_encode_varint(
+    uint8_t * apdu,
+    uint32_t value)
+{
+    int len = 0;
+
+    while (value >= 0x80) {
+        apdu[len++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    apdu[len++] = (uint8_t) value;
+
+    return len;
+}
+
+/* returns the length, or 0 if the varint runs past the page */
+static int tl_decode_varint(
+    const uint8_t * apdu,
+    int apdu_len,
+    uint32_t * value)
+{
+    int len = 0;
+    uint32_t result = 0;
+
+    while ((len < apdu_len) && (len < 5)) {
+        result |= (uint32_t) (apdu[len] & 0x7F) << (7 * len);
+        if ((apdu[len++] & 0x80) == 0) {
+            *value = result;
+            return len;
+        }
+    }
+
+    return 0;
+}
+
+static uint32_t tl_zigzag(
+    int32_t value)
+{
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+static int32_t tl_unzigzag(
+    uint32_t value)
+{
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+/* the deltas of a record from the one before it in the page */
+static int tl_encode_record(
+    uint8_t * apdu,
+    TL_RECORD * record,
+    TL_RECORD * last)
+{
+    int len = 0;
+    bool changed = false;
+
+    changed = (record->Type != last->Type) ||
+        (record->Status != last->Status);
+    len = tl_encode_varint(apdu,
+        ((record->Time - last->Time) << 1) | (changed ? 1 : 0));
+    if (changed) {
+        apdu[len++] = record->Type;
+        apdu[len++] = record->Status;
+    }
+    len += tl_encode_varint(&apdu[len],
+        tl_zigzag((int32_t) (record->Datum.Bits - last->Datum.Bits)));
+
+    return len;
+}
+
+/* replaces the record with the next one, returns 0 if it is broken */
+static int tl_decode_record(
+    const uint8_t * apdu,
+    int apdu_len,
+    TL_RECORD * record)
+{
+    int len = 0;
+    int value_len = 0;
+    uint32_t value = 0;
+
+    value_len = tl_decode_varint(apdu, apdu_len, &value);
+    if (value_len == 0) {
+        return 0;
+    }
+    len = value_len;
+    record->Time += value >> 1;
+    if (value & 1) {
+        if ((len + 2) > apdu_len) {
+            return 0;
+        }
+        record->Type = apdu[len++];
+        record->Status = apdu[len++];
+    }
+    value_len = tl_decode_varint(&apdu[len], apdu_len - len, &value);
+    if (value_len == 0) {
+        return 0;
+    }
+    len += value_len;
+    record->Datum.Bits += (uint32_t) tl_unzigzag(value);
+
+    return len;
+}
+
+/* Fletcher-16 of the page, without the checksum itself */
+static uint16_t tl_page_checksum(
+    const uint8_t * page,
+    uint16_t length)
+{
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    uint16_t i = 0;
+
+    for (i = 0; i < length; i++) {
+        if ((i == 6) || (i == 7)) {
+            continue;
+        }
+        sum1 = (sum1 + page[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+
+    return (uint16_t) ((sum2 << 8) | sum1);
+}
+
+/* the first record of a page, which is stored in full */
+static void tl_page_first(
+    const uint8_t * page,
+    uint32_t * sequence,
+    TL_RECORD * record)
+{
+    /* the decoders only read, whatever their prototypes say */
+    decode_unsigned32((uint8_t *) & page[12], sequence);
+    decode_unsigned32((uint8_t *) & page[16], &record->Time);
+    record->Type = page[20];
+    record->Status = page[21];
+    decode_unsigned32((uint8_t *) & page[24], &record->Datum.Bits);
+}
+
+static bool tl_job_pending(
+    uint32_t job)
+{
+    return ((int32_t) (job - Queue_Tail) >= 0);
+}
+
+static bool tl_queue_full(
+    void)
+{
+    return ((Queue_Head - Queue_Tail) >= TL_ARCHIVE_QUEUE);
+}
+
+static void tl_queue_erase(
+    TL_ARCHIVE * archive)
+{
+    TL_JOB *job = &Queue[Queue_Head % TL_ARCHIVE_QUEUE];
+
+    job->Archive = archive;
+    job->Kind = TL_JOB_ERASE;
+    memset(job->Page, 0xFF, TL_ARCHIVE_PAGE_SIZE);
+    TL_BARRIER();
+    Queue_Head++;
+    archive->Erase_Pending = false;
+}
+
+/* hands the open page to the archive task, which writes it over
+   the oldest page of the file */
+static void tl_archive_seal(
+    TL_ARCHIVE * archive)
+{
+    TL_PAGE_INDEX *index = NULL;
+    TL_JOB *job = NULL;
+    TL_RECORD first;
+    uint32_t slot = archive->Next_Page % TL_ARCHIVE_PAGES;
+
+    if (archive->Open_Count == 0) {
+        return;
+    }
+    if (archive->Erase_Pending && !tl_queue_full()) {
+        tl_queue_erase(archive);
+    }
+    if (archive->Erase_Pending || tl_queue_full()) {
+        /* the flash is not keeping up; these records stay in RAM only */
+        archive->Overruns++;
+        archive->Open_Count = 0;
+        archive->Open_Length = 0;
+        return;
+    }
+    encode_unsigned16(&archive->Open[2], archive->Open_Count);
+    encode_unsigned16(&archive->Open[4], archive->Open_Length);
+    encode_unsigned16(&archive->Open[6],
+        tl_page_checksum(archive->Open, archive->Open_Length));
+    job = &Queue[Queue_Head % TL_ARCHIVE_QUEUE];
+    job->Archive = archive;
+    job->Kind = TL_JOB_WRITE;
+    job->Slot = slot;
+    memcpy(job->Page, archive->Open, archive->Open_Length);
+    index = &archive->Index[slot];
+    index->Page_Number = archive->Next_Page;
+    tl_page_first(archive->Open, &index->First_Sequence, &first);
+    index->First_Time = first.Time;
+    index->Count = archive->Open_Count;
+    index->Job = Queue_Head;
+    index->Valid = true;
+    TL_BARRIER();
+    Queue_Head++;
+    archive->Next_Page++;
+    archive->Open_Count = 0;
+    archive->Open_Length = 0;
+}
+
+/**
+ * Adds a record to the open page, sealing the page when it is full.
+ *
+ * @param archive - archive of the log
+ * @param sequence - sequence number of the record
+ * @param record - the record, in time order after the ones before
+ */
+void tl_archive_append(
+    TL_ARCHIVE * archive,
+    uint32_t sequence,
+    TL_RECORD * record)
+{
+    uint8_t *page = NULL;
+
+    if (!archive) {
+        return;
+    }
+    if ((archive->Open_Count == UINT16_MAX) ||
+        ((archive->Open_Length + TL_RECORD_ENC_MAX) > TL_ARCHIVE_PAGE_SIZE)) {
+        tl_archive_seal(archive);
+    }
+    page = archive->Open;
+    if (archive->Open_Count == 0) {
+        page[0] = 'T';
+        page[1] = 'L';
+        encode_unsigned32(&page[8], archive->Next_Page);
+        encode_unsigned32(&page[12], sequence);
+        encode_unsigned32(&page[16], record->Time);
+        page[20] = record->Type;
+        page[21] = record->Status;
+        page[22] = 0;
+        page[23] = 0;
+        encode_unsigned32(&page[24], record->Datum.Bits);
+        archive->Open_Length = TL_PAGE_HEADER;
+    } else {
+        archive->Open_Length +=
+            tl_encode_record(&page[archive->Open_Length], record,
+            &archive->Open_Last);
+    }
+    archive->Open_Last = *record;
+    archive->Open_Count++;
+    archive->Newest_Sequence = sequence;
+}
+
+/* seals the open page even if it is not full, so that it is kept */
+void tl_archive_flush(
+    TL_ARCHIVE * archive)
+{
+    if (archive) {
+        tl_archive_seal(archive);
+    }
+}
+
+/* forgets all the records, and erases the file in the background */
+void tl_archive_purge(
+    TL_ARCHIVE * archive)
+{
+    unsigned i = 0;
+
+    if (!archive) {
+        return;
+    }
+    for (i = 0; i < TL_ARCHIVE_PAGES; i++) {
+        archive->Index[i].Valid = false;
+    }
+    archive->Open_Count = 0;
+    archive->Open_Length = 0;
+    archive->Newest_Sequence = 0;
+    archive->Erase_Pending = true;
+    if (!tl_queue_full()) {
+        tl_queue_erase(archive);
+    }
+}
+
+/* true when the next page sealed overwrites the oldest one */
+bool tl_archive_full(
+    TL_ARCHIVE * archive)
+{
+    TL_PAGE_INDEX *index = NULL;
+
+    if (!archive || (archive->Next_Page < TL_ARCHIVE_PAGES)) {
+        return false;
+    }
+    index = &archive->Index[archive->Next_Page % TL_ARCHIVE_PAGES];
+
+    return index->Valid &&
+        (index->Page_Number == (archive->Next_Page - TL_ARCHIVE_PAGES)) &&
+        ((archive->Open_Length + TL_RECORD_ENC_MAX) > TL_ARCHIVE_PAGE_SIZE);
+}
+
+/* the bytes of a page, wherever it is; NULL if it is gone */
+static const uint8_t *tl_archive_page(
+    TL_ARCHIVE * archive,
+    uint32_t page_number)
+{
+    TL_PAGE_INDEX *index = NULL;
+    FILE *pFile = NULL;
+    size_t len = 0;
+
+    if (page_number == archive->Next_Page) {
+        return archive->Open_Count ? archive->Open : NULL;
+    }
+    index = &archive->Index[page_number % TL_ARCHIVE_PAGES];
+    if (!index->Valid || (index->Page_Number != page_number)) {
+        return NULL;
+    }
+    if (tl_job_pending(index->Job)) {
+        /* not written yet, and the buffer is not reused until it is */
+        return Queue[index->Job % TL_ARCHIVE_QUEUE].Page;
+    }
+    if ((Read_Archive == archive) && (Read_Page_Number == page_number)) {
+        return Read_Page;
+    }
+    Read_Archive = NULL;
+    pFile = fopen(archive->Filename, "rb");
+    if (pFile) {
+        if (fseek(pFile,
+                (long) (page_number % TL_ARCHIVE_PAGES) *
+                TL_ARCHIVE_PAGE_SIZE, SEEK_SET) == 0) {
+            len = fread(Read_Page, 1, TL_ARCHIVE_PAGE_SIZE, pFile);
+        }
+        fclose(pFile);
+    }
+    if ((len != TL_ARCHIVE_PAGE_SIZE) || (Read_Page[0] != 'T') ||
+        (Read_Page[1] != 'L')) {
+        return NULL;
+    }
+    Read_Archive = archive;
+    Read_Page_Number = page_number;
+
+    return Read_Page;
+}
+
+/* the first sequence number and time of a page, without reading it */
+static bool tl_archive_page_info(
+    TL_ARCHIVE * archive,
+    uint32_t page_number,
+    uint32_t * sequence,
+    uint32_t * seconds)
+{
+    TL_PAGE_INDEX *index = NULL;
+    TL_RECORD first;
+
+    if (page_number == archive->Next_Page) {
+        if (archive->Open_Count == 0) {
+            return false;
+        }
+        tl_page_first(archive->Open, sequence, &first);
+        *seconds = first.Time;
+        return true;
+    }
+    index = &archive->Index[page_number % TL_ARCHIVE_PAGES];
+    if (!index->Valid || (index->Page_Number != page_number)) {
+        return false;
+    }
+    *sequence = index->First_Sequence;
+    *seconds = index->First_Time;
+
+    return true;
+}
+
+/* the page number of the oldest page that can still be there */
+static uint32_t tl_archive_lowest(
+    TL_ARCHIVE * archive)
+{
+    return (archive->Next_Page > TL_ARCHIVE_PAGES) ?
+        (archive->Next_Page - TL_ARCHIVE_PAGES) : 0;
+}
+
+/* finds the last page whose first sequence number (or time)
+   is not after the key - a binary search that steps over the
+   pages that were lost */
+static bool tl_archive_search(
+    TL_ARCHIVE * archive,
+    bool by_time,
+    uint32_t key,
+    uint32_t * page_number)
+{
+    uint32_t low = tl_archive_lowest(archive);
+    uint32_t high = archive->Next_Page;
+    uint32_t middle = 0;
+    uint32_t probe = 0;
+    uint32_t sequence = 0;
+    uint32_t seconds = 0;
+    bool found = false;
+
+    while (low <= high) {
+        middle = low + ((high - low) / 2);
+        for (probe = middle; probe <= high; probe++) {
+            if (tl_archive_page_info(archive, probe, &sequence, &seconds)) {
+                break;
+            }
+        }
+        if ((probe <= high) && ((by_time ? seconds : sequence) <= key)) {
+            *page_number = probe;
+            found = true;
+            low = probe + 1;
+        } else if (middle == 0) {
+            break;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return found;
+}
+
+/* points the cursor at the first record of a page */
+static bool tl_archive_load(
+    TL_ARCHIVE * archive,
+    TL_CURSOR * cursor,
+    uint32_t page_number)
+{
+    const uint8_t *page = NULL;
+    uint16_t count = 0;
+
+    page = tl_archive_page(archive, page_number);
+    if (!page) {
+        return false;
+    }
+    if (page == archive->Open) {
+        count = archive->Open_Count;
+    } else {
+        decode_unsigned16((uint8_t *) & page[2], &count);
+    }
+    if (count == 0) {
+        return false;
+    }
+    cursor->Archive = archive;
+    cursor->Page = page;
+    cursor->Page_Number = page_number;
+    cursor->Offset = TL_PAGE_HEADER;
+    cursor->Remaining = count - 1;
+    tl_page_first(page, &cursor->Sequence, &cursor->Record);
+
+    return true;
+}
+
+/**
+ * Moves the cursor to the record after the one it has.
+ *
+ * @param cursor - a cursor set by tl_archive_seek()
+ *
+ * @return true if there is such a record, in cursor->Record
+ */
+bool tl_archive_next(
+    TL_CURSOR * cursor)
+{
+    uint32_t sequence = cursor->Sequence;
+    int len = 0;
+
+    if (cursor->Remaining) {
+        len = tl_decode_record(&cursor->Page[cursor->Offset],
+            TL_ARCHIVE_PAGE_SIZE - cursor->Offset, &cursor->Record);
+        if (len == 0) {
+            return false;
+        }
+        cursor->Offset += len;
+        cursor->Remaining--;
+        cursor->Sequence++;
+        return true;
+    }
+    if (!tl_archive_load(cursor->Archive, cursor, cursor->Page_Number + 1)) {
+        return false;
+    }
+
+    return (cursor->Sequence == (sequence + 1));
+}
+
+/**
+ * Points a cursor at a record, decoding its page up to it.
+ *
+ * @param archive - archive of the log
+ * @param cursor - the cursor to set
+ * @param sequence - sequence number of the record
+ *
+ * @return true if the record is in the archive
+ */
+bool tl_archive_seek(
+    TL_ARCHIVE * archive,
+    TL_CURSOR * cursor,
+    uint32_t sequence)
+{
+    uint32_t page_number = 0;
+
+    if (!archive || !tl_archive_search(archive, false, sequence, &page_number)
+        || !tl_archive_load(archive, cursor, page_number)) {
+        return false;
+    }
+    while (cursor->Sequence < sequence) {
+        if (!cursor->Remaining || !tl_archive_next(cursor)) {
+            return false;
+        }
+    }
+
+    return (cursor->Sequence == sequence);
+}
+
+/* the sequence number of the oldest record, 0 if there is none */
+uint32_t tl_archive_oldest(
+    TL_ARCHIVE * archive)
+{
+    uint32_t page_number = 0;
+    uint32_t sequence = 0;
+    uint32_t seconds = 0;
+
+    if (!archive) {
+        return 0;
+    }
+    for (page_number = tl_archive_lowest(archive);
+        page_number <= archive->Next_Page; page_number++) {
+        if (tl_archive_page_info(archive, page_number, &sequence, &seconds)) {
+            return sequence;
+        }
+    }
+
+    return 0;
+}
+
+/* the sequence number of the newest record, 0 if there is none */
+uint32_t tl_archive_newest(
+    TL_ARCHIVE * archive)
+{
+    if (!archive || (tl_archive_oldest(archive) == 0)) {
+        return 0;
+    }
+
+    return archive->Newest_Sequence;
+}
+
+/**
+ * Finds the first record later than a time.
+ *
+ * @param archive - archive of the log
+ * @param seconds - record time to compare with
+ *
+ * @return its sequence number, or the one after the newest record
+ */
+uint32_t tl_archive_find_time(
+    TL_ARCHIVE * archive,
+    uint32_t seconds)
+{
+    TL_CURSOR cursor;
+    uint32_t page_number = 0;
+
+    if (!archive) {
+        return 0;
+    }
+    if (!tl_archive_search(archive, true, seconds, &page_number)) {
+        return tl_archive_oldest(archive);
+    }
+    if (tl_archive_load(archive, &cursor, page_number)) {
+        do {
+            if (cursor.Record.Time > seconds) {
+                return cursor.Sequence;
+            }
+        } while (tl_archive_next(&cursor));
+    }
+
+    return archive->Newest_Sequence + 1;
+}
+
+/* reads back the pages of the file, as a restart finds them */
+static bool tl_archive_scan(
+    TL_ARCHIVE * archive)
+{
+    TL_PAGE_INDEX *index = NULL;
+    TL_RECORD first;
+    FILE *pFile = NULL;
+    uint32_t slot = 0;
+    uint32_t newest = 0;
+    uint16_t count = 0;
+    uint16_t length = 0;
+    uint16_t checksum = 0;
+    bool found = false;
+    bool status = true;
+
+    pFile = fopen(archive->Filename, "rb");
+    if (!pFile) {
+        return false;
+    }
+    for (slot = 0; slot < TL_ARCHIVE_PAGES; slot++) {
+        index = &archive->Index[slot];
+        if (fread(Read_Page, 1, TL_ARCHIVE_PAGE_SIZE,
+                pFile) != TL_ARCHIVE_PAGE_SIZE) {
+            /* cut short: it gets erased */
+            status = false;
+            break;
+        }
+        if ((Read_Page[0] != 'T') || (Read_Page[1] != 'L')) {
+            continue;
+        }
+        decode_unsigned16(&Read_Page[2], &count);
+        decode_unsigned16(&Read_Page[4], &length);
+        decode_unsigned16(&Read_Page[6], &checksum);
+        decode_unsigned32(&Read_Page[8], &index->Page_Number);
+        if ((count == 0) || (length < TL_PAGE_HEADER) ||
+            (length > TL_ARCHIVE_PAGE_SIZE) ||
+            ((index->Page_Number % TL_ARCHIVE_PAGES) != slot) ||
+            (tl_page_checksum(Read_Page, length) != checksum)) {
+            /* torn by a reset while it was written */
+            continue;
+        }
+        tl_page_first(Read_Page, &index->First_Sequence, &first);
+        index->First_Time = first.Time;
+        index->Count = count;
+        index->Job = Queue_Tail - 1;
+        index->Valid = true;
+        if (!found || (index->Page_Number >= newest)) {
+            newest = index->Page_Number;
+            archive->Newest_Sequence = index->First_Sequence + count - 1;
+            found = true;
+        }
+    }
+    fclose(pFile);
+    if (!status) {
+        for (slot = 0; slot < TL_ARCHIVE_PAGES; slot++) {
+            archive->Index[slot].Valid = false;
+        }
+        return false;
+    }
+    archive->Next_Page = found ? (newest + 1) : 0;
+    /* pages older than the ones around them are left from a purge */
+    for (slot = 0; slot < TL_ARCHIVE_PAGES; slot++) {
+        index = &archive->Index[slot];
+        if (index->Valid &&
+            (index->Page_Number < tl_archive_lowest(archive))) {
+            index->Valid = false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Opens the archive of a log, reading back the index of its file,
+ * or creating the file in the background if there is none.
+ *
+ * @param log_index - index of the Trend Log
+ *
+ * @return the archive, or NULL if there is no memory for it
+ */
+TL_ARCHIVE *tl_archive_open(
+    unsigned log_index)
+{
+    TL_ARCHIVE *archive = NULL;
+    unsigned i = 0;
+
+    if (log_index >= MAX_TREND_LOGS) {
+        return NULL;
+    }
+    for (i = 0; i < TL_ARCHIVE_QUEUE; i++) {
+        if (!Queue[i].Page) {
+            Queue[i].Page = objinst_realloc(NULL, TL_ARCHIVE_PAGE_SIZE);
+            if (!Queue[i].Page) {
+                return NULL;
+            }
+        }
+    }
+    if (!Read_Page) {
+        Read_Page = objinst_realloc(NULL, TL_ARCHIVE_PAGE_SIZE);
+        if (!Read_Page) {
+            return NULL;
+        }
+    }
+    archive = &Archives[log_index];
+    if (!archive->Index) {
+        archive->Index =
+            objinst_realloc(NULL, TL_ARCHIVE_PAGES * sizeof(TL_PAGE_INDEX));
+    }
+    if (!archive->Open) {
+        archive->Open = objinst_realloc(NULL, TL_ARCHIVE_PAGE_SIZE);
+    }
+    if (!archive->Index || !archive->Open) {
+        return NULL;
+    }
+    snprintf(archive->Filename, sizeof(archive->Filename), "%s/tl%u.log",
+        TL_ARCHIVE_PATH, log_index);
+    memset(archive->Index, 0, TL_ARCHIVE_PAGES * sizeof(TL_PAGE_INDEX));
+    archive->Next_Page = 0;
+    archive->Open_Count = 0;
+    archive->Open_Length = 0;
+    archive->Newest_Sequence = 0;
+    archive->Overruns = 0;
+    archive->Erase_Pending = false;
+    if (Read_Archive == archive) {
+        Read_Archive = NULL;
+    }
+    if (!tl_archive_scan(archive)) {
+        /* written out before any page goes after it */
+        archive->Erase_Pending = true;
+        if (!tl_queue_full()) {
+            tl_queue_erase(archive);
+        }
+    }
+
+    return archive;
+}
+
+/**
+ * Does the oldest job of the queue: writes a sealed page into its
+ * slot, or erases a file.  This is the only place the archive
+ * writes to the flash, so run it from a task of its own.
+ *
+ * @return true if there was a job, false if the queue is empty
+ */
+bool tl_archive_maintenance(
+    void)
+{
+    TL_JOB *job = NULL;
+    FILE *pFile = NULL;
+    unsigned i = 0;
+
+    if (Queue_Tail == Queue_Head) {
+        return false;
+    }
+    TL_BARRIER();
+    job = &Queue[Queue_Tail % TL_ARCHIVE_QUEUE];
+    if (job->Kind == TL_JOB_ERASE) {
+        pFile = fopen(job->Archive->Filename, "wb");
+        if (pFile) {
+            for (i = 0; i < TL_ARCHIVE_PAGES; i++) {
+                fwrite(job->Page, 1, TL_ARCHIVE_PAGE_SIZE, pFile);
+            }
+            fclose(pFile);
+        }
+    } else {
+        pFile = fopen(job->Archive->Filename, "r+b");
+        if (pFile) {
+            if (fseek(pFile, (long) job->Slot * TL_ARCHIVE_PAGE_SIZE,
+                    SEEK_SET) == 0) {
+                fwrite(job->Page, 1, TL_ARCHIVE_PAGE_SIZE, pFile);
+            }
+            fclose(pFile);
+        }
+    }
+    TL_BARRIER();
+    Queue_Tail++;
+
+    return true;
+}
+
+#ifdef TEST
+#include <assert.h>
+#include "ctest.h"
+
+static void testTLArchiveAppend(
+    TL_ARCHIVE * archive,
+    uint32_t first,
+    uint32_t records)
+{
+    TL_RECORD record;
+    uint32_t i;
+
+    for (i = first; i < (first + records); i++) {
+        record.Time = i * 60;
+        record.Type = TL_TYPE_REAL;
+        record.Status = (i % 100) ? 0 : TL_STATUS_FLAGS_VALID;
+        record.Datum.Real = 20.0f + ((float) (i % 50) / 4.0f);
+        tl_archive_append(archive, i, &record);
+        while (tl_archive_maintenance()) {
+            /* the flash keeps up */
+        }
+    }
+}
+
+void testTLArchive(
+    Test * pTest)
+{
+    TL_ARCHIVE *archive = NULL;
+    TL_CURSOR cursor;
+    uint8_t buffer[TL_RECORD_ENC_MAX];
+    TL_RECORD record;
+    TL_RECORD last;
+    uint32_t i = 0;
+    int len = 0;
+    bool status = true;
+
+    /* the deltas round trip, the largest within the bound */
+    last.Time = 0;
+    last.Type = TL_TYPE_REAL;
+    last.Status = 0;
+    last.Datum.Bits = 0;
+    record.Time = UINT32_MAX / 2;
+    record.Type = TL_TYPE_ERROR;
+    record.Status = TL_STATUS_FLAGS_VALID;
+    record.Datum.Bits = 0x80000000UL;
+    len = tl_encode_record(buffer, &record, &last);
+    ct_test(pTest, len == TL_RECORD_ENC_MAX);
+    ct_test(pTest, tl_decode_record(buffer, len, &last) == len);
+    ct_test(pTest, last.Time == record.Time);
+    ct_test(pTest, last.Type == record.Type);
+    ct_test(pTest, last.Status == record.Status);
+    ct_test(pTest, last.Datum.Bits == record.Datum.Bits);
+    ct_test(pTest, tl_decode_record(buffer, len - 1, &last) == 0);
+
+    remove(TL_ARCHIVE_PATH "/tl0.log");
+    archive = tl_archive_open(0);
+    ct_test(pTest, archive != NULL);
+    ct_test(pTest, tl_archive_maintenance());
+    ct_test(pTest, !tl_archive_maintenance());
+    ct_test(pTest, tl_archive_oldest(archive) == 0);
+    /* a minute apart, enough to go round the file */
+    testTLArchiveAppend(archive, 1, 40000);
+    ct_test(pTest, archive->Next_Page > TL_ARCHIVE_PAGES);
+    ct_test(pTest, archive->Overruns == 0);
+    ct_test(pTest, tl_archive_newest(archive) == 40000);
+    ct_test(pTest, tl_archive_oldest(archive) > 1);
+    ct_test(pTest, !tl_archive_seek(archive, &cursor, 1));
+    ct_test(pTest, tl_archive_seek(archive, &cursor, 30000));
+    ct_test(pTest, cursor.Record.Time == (30000 * 60));
+    for (i = 30001; i <= 40000; i++) {
+        if (!tl_archive_next(&cursor) || (cursor.Sequence != i) ||
+            (cursor.Record.Time != (i * 60)) ||
+            (cursor.Record.Datum.Real !=
+                (20.0f + ((float) (i % 50) / 4.0f))) ||
+            (cursor.Record.Status !=
+                ((i % 100) ? 0 : TL_STATUS_FLAGS_VALID))) {
+            status = false;
+            break;
+        }
+    }
+    ct_test(pTest, status);
+    ct_test(pTest, !tl_archive_next(&cursor));
+    ct_test(pTest, tl_archive_find_time(archive, 35000 * 60) == 35001);
+    ct_test(pTest, tl_archive_find_time(archive, 35000 * 60 + 1) == 35001);
+    ct_test(pTest, tl_archive_find_time(archive, 0) ==
+        tl_archive_oldest(archive));
+    ct_test(pTest, tl_archive_find_time(archive, UINT32_MAX) == 40001);
+    /* after a restart the sealed pages are still there */
+    tl_archive_flush(archive);
+    while (tl_archive_maintenance()) {
+    }
+    i = tl_archive_oldest(archive);
+    archive = tl_archive_open(0);
+    ct_test(pTest, !tl_archive_maintenance());
+    ct_test(pTest, tl_archive_oldest(archive) == i);
+    ct_test(pTest, tl_archive_newest(archive) == 40000);
+    ct_test(pTest, tl_archive_seek(archive, &cursor, 39999));
+    ct_test(pTest, tl_archive_next(&cursor));
+    ct_test(pTest, cursor.Record.Time == (40000 * 60));
+    testTLArchiveAppend(archive, 40001, 10);
+    ct_test(pTest, tl_archive_seek(archive, &cursor, 40010));
+    /* a purge is kept too */
+    tl_archive_purge(archive);
+    ct_test(pTest, tl_archive_oldest(archive) == 0);
+    ct_test(pTest, tl_archive_maintenance());
+    archive = tl_archive_open(0);
+    ct_test(pTest, tl_archive_oldest(archive) == 0);
+    ct_test(pTest, tl_archive_newest(archive) == 0);
+    remove(TL_ARCHIVE_PATH "/tl0.log");
+
+    return;
+}
+
+#ifdef TEST_TL_ARCHIVE
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("BACnet Trend Log Archive", NULL);
+    /* individual tests */
+    rc = ct_addTestFunction(pTest, testTLArchive);
+    assert(rc);
+
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_TL_ARCHIVE */
+#endif /* TEST */
+#endif /* TREND_LOG_ARCHIVE */
@@ -0,0 +1,1343 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+
+/* Trend Log Objects - customize for your use */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bacdef.h"
+#include "bacdcode.h"
+#include "bacenum.h"
+#include "bacapp.h"
+#include "config.h"     /* the custom stuff */
+#include "device.h"
+#include "handlers.h"
+#include "objinst.h"
+#include "trendlog.h"
+#include "tlarchive.h"
+
+/** @file trendlog.c  Trend Log objects kept in a ring buffer */
+
+/* records in each log; a day of one-minute samples */
+#ifndef TREND_LOG_BUFFER_SIZE
+#define TREND_LOG_BUFFER_SIZE 1440
+#endif
+/* seconds between samples, until Log_Interval is written */
+#ifndef TREND_LOG_INTERVAL
+#define TREND_LOG_INTERVAL 60
+#endif
+
+static TREND_LOG_DESCR TL_Descr[MAX_TREND_LOGS];
+/* days from 1900 to TL_EPOCH_YEAR, as the datetime functions count */
+static uint32_t TL_Epoch_Days;
+/* the sampled value - only the server task runs the logs */
+static uint8_t TL_Value_Buffer[MAX_APDU];
+
+/* converts a local date and time into a record time,
+   which is 0 if the date is unspecified or before TL_EPOCH_YEAR */
+static uint32_t Trend_Log_Seconds(
+    BACNET_DATE_TIME * bdatetime)
+{
+    uint32_t days = 0;
+
+    days = datetime_days_since_epoch(&bdatetime->date);
+    if (days < TL_Epoch_Days) {
+        return 0;
+    }
+
+    return ((days - TL_Epoch_Days) * 86400UL) +
+        datetime_seconds_since_midnight(&bdatetime->time);
+}
+
+static void Trend_Log_Date_Time(
+    uint32_t seconds,
+    BACNET_DATE_TIME * bdatetime)
+{
+    datetime_days_since_epoch_into_date(TL_Epoch_Days + (seconds / 86400UL),
+        &bdatetime->date);
+    seconds %= 86400UL;
+    datetime_set_time(&bdatetime->time, (uint8_t) (seconds / 3600),
+        (uint8_t) ((seconds / 60) % 60), (uint8_t) (seconds % 60), 0);
+}
+
+/* the record time of now, or 0 while the clock is not set */
+static uint32_t Trend_Log_Now(
+    void)
+{
+    BACNET_DATE_TIME bdatetime;
+
+    Device_getCurrentDateTime(&bdatetime);
+
+    return Trend_Log_Seconds(&bdatetime);
+}
+
+/* the record at a position in the log, 1 is the oldest */
+static TL_RECORD *Trend_Log_Record(
+    TREND_LOG_DESCR * log,
+    uint32_t position)
+{
+    return &log->Buffer[(log->Record_Start + position - 1) % log->Buffer_Size];
+}
+
+/* the sequence number of the oldest record in the ring */
+static uint32_t Trend_Log_Ring_First(
+    TREND_LOG_DESCR * log)
+{
+    return log->Total_Record_Count - log->Record_Count + 1;
+}
+
+/* the sequence number of the oldest record of the log, 0 if none */
+static uint32_t Trend_Log_Oldest(
+    TREND_LOG_DESCR * log)
+{
+    uint32_t oldest = 0;
+
+#if TREND_LOG_ARCHIVE
+    oldest = tl_archive_oldest(log->Archive);
+#endif
+    if (log->Record_Count && ((oldest == 0) ||
+            (Trend_Log_Ring_First(log) < oldest))) {
+        oldest = Trend_Log_Ring_First(log);
+    }
+
+    return oldest;
+}
+
+/* the number of records in the log, ring and archive together */
+static uint32_t Trend_Log_Records(
+    TREND_LOG_DESCR * log)
+{
+    uint32_t oldest = Trend_Log_Oldest(log);
+
+    return oldest ? (log->Total_Record_Count - oldest + 1) : 0;
+}
+
+/* the records the log can hold */
+static uint32_t Trend_Log_Capacity(
+    TREND_LOG_DESCR * log)
+{
+#if TREND_LOG_ARCHIVE
+    if (log->Archive) {
+        /* as many as the pages hold if the values never change */
+        return log->Buffer_Size + (TL_ARCHIVE_PAGES * TL_PAGE_RECORDS_MAX);
+    }
+#endif
+    return log->Buffer_Size;
+}
+
+/* appends a record, overwriting the oldest when the ring is full */
+static void Trend_Log_Insert(
+    TREND_LOG_DESCR * log,
+    TL_RECORD * record)
+{
+    TL_RECORD *newest = NULL;
+
+    if (log->Buffer_Size == 0) {
+        return;
+    }
+    if (log->Record_Count) {
+        /* keep the records in time order, so that a ReadRange by time
+           can search them, even if the clock is set back */
+        newest = Trend_Log_Record(log, log->Record_Count);
+        if (record->Time < newest->Time) {
+            record->Time = newest->Time;
+        }
+    }
+    if (log->Record_Count < log->Buffer_Size) {
+        log->Record_Count++;
+    } else {
+        log->Record_Start = (log->Record_Start + 1) % log->Buffer_Size;
+    }
+    *Trend_Log_Record(log, log->Record_Count) = *record;
+    /* sequence numbers run from 1 to 2^32-1 and wrap back to 1 */
+    log->Total_Record_Count++;
+    if (log->Total_Record_Count == 0) {
+        log->Total_Record_Count = 1;
+    }
+#if TREND_LOG_ARCHIVE
+    tl_archive_append(log->Archive, log->Total_Record_Count, record);
+#endif
+}
+
+/* appends a log-status record */
+static void Trend_Log_Insert_Status(
+    TREND_LOG_DESCR * log,
+    BACNET_LOG_STATUS status,
+    bool state)
+{
+    TL_RECORD record;
+
+    record.Time = Trend_Log_Now();
+    record.Type = TL_TYPE_STATUS;
+    record.Status = 0;
+    record.Datum.Bits = state ? (1UL << status) : 0;
+    if (!log->Enable) {
+        record.Datum.Bits |= (1UL << LOG_STATUS_LOG_DISABLED);
+    }
+    Trend_Log_Insert(log, &record);
+}
+
+static void Trend_Log_Enable(
+    TREND_LOG_DESCR * log,
+    bool enable)
+{
+    if (log->Enable != enable) {
+        log->Enable = enable;
+        log->Remaining = 0;
+        Trend_Log_Insert_Status(log, LOG_STATUS_LOG_DISABLED, !enable);
+#if TREND_LOG_ARCHIVE
+        if (!enable) {
+            /* keep the records taken so far across a restart */
+            tl_archive_flush(log->Archive);
+        }
+#endif
+    }
+}
+
+/* empties the log, leaving the buffer-purged record in it */
+static void Trend_Log_Purge(
+    TREND_LOG_DESCR * log)
+{
+    log->Record_Count = 0;
+    log->Record_Start = 0;
+#if TREND_LOG_ARCHIVE
+    tl_archive_purge(log->Archive);
+#endif
+    Trend_Log_Insert_Status(log, LOG_STATUS_BUFFER_PURGED, true);
+}
+
+/* true when the next record overwrites the oldest one */
+static bool Trend_Log_Full(
+    TREND_LOG_DESCR * log)
+{
+#if TREND_LOG_ARCHIVE
+    if (log->Archive) {
+        return tl_archive_full(log->Archive);
+    }
+#endif
+
+    return ((log->Record_Count + 1) >= log->Buffer_Size);
+}
+
+/* reads the monitored property and appends it to the log */
+static void Trend_Log_Sample(
+    TREND_LOG_DESCR * log)
+{
+    BACNET_READ_PROPERTY_DATA rpdata;
+    BACNET_APPLICATION_DATA_VALUE value;
+    TL_RECORD record;
+    int len = 0;
+    uint8_t i = 0;
+
+    record.Time = Trend_Log_Now();
+    if (record.Time == 0) {
+        /* samples without a time are of no use to anybody */
+        return;
+    }
+    record.Status = 0;
+    rpdata.object_type = log->Source.objectIdentifier.type;
+    rpdata.object_instance = log->Source.objectIdentifier.instance;
+    rpdata.object_property = log->Source.propertyIdentifier;
+    rpdata.array_index = log->Source.arrayIndex;
+    rpdata.application_data = TL_Value_Buffer;
+    rpdata.application_data_len = sizeof(TL_Value_Buffer);
+    len = Device_Read_Property(&rpdata);
+    if (len >= 0) {
+        len = bacapp_decode_application_data(TL_Value_Buffer, (uint8_t) len,
+            &value);
+    }
+    if (len < 0) {
+        record.Type = TL_TYPE_ERROR;
+        record.Datum.Bits =
+            ((uint32_t) rpdata.error_class << 16) | rpdata.error_code;
+    } else {
+        switch (value.tag) {
+            case BACNET_APPLICATION_TAG_NULL:
+                record.Type = TL_TYPE_NULL;
+                record.Datum.Bits = 0;
+                break;
+            case BACNET_APPLICATION_TAG_BOOLEAN:
+                record.Type = TL_TYPE_BOOL;
+                record.Datum.Bits = 0;
+                record.Datum.Boolean = value.type.Boolean;
+                break;
+            case BACNET_APPLICATION_TAG_UNSIGNED_INT:
+                record.Type = TL_TYPE_UNSIGN;
+                record.Datum.Unsigned = value.type.Unsigned_Int;
+                break;
+            case BACNET_APPLICATION_TAG_SIGNED_INT:
+                record.Type = TL_TYPE_SIGN;
+                record.Datum.Signed = value.type.Signed_Int;
+                break;
+            case BACNET_APPLICATION_TAG_REAL:
+                record.Type = TL_TYPE_REAL;
+                record.Datum.Real = value.type.Real;
+                break;
+            case BACNET_APPLICATION_TAG_ENUMERATED:
+                record.Type = TL_TYPE_ENUM;
+                record.Datum.Enumerated = value.type.Enumerated;
+                break;
+            default:
+                record.Type = TL_TYPE_ERROR;
+                record.Datum.Bits =
+                    ((uint32_t) ERROR_CLASS_PROPERTY << 16) |
+                    ERROR_CODE_DATATYPE_NOT_SUPPORTED;
+                break;
+        }
+        /* the Status_Flags go with the value, when the object has them */
+        rpdata.object_property = PROP_STATUS_FLAGS;
+        rpdata.array_index = BACNET_ARRAY_ALL;
+        len = Device_Read_Property(&rpdata);
+        if ((len > 0) &&
+            (bacapp_decode_application_data(TL_Value_Buffer, (uint8_t) len,
+                    &value) > 0) &&
+            (value.tag == BACNET_APPLICATION_TAG_BIT_STRING)) {
+            record.Status = TL_STATUS_FLAGS_VALID;
+            for (i = 0; i < 4; i++) {
+                if (bitstring_bit(&value.type.Bit_String, i)) {
+                    record.Status |= (uint8_t) (1 << i);
+                }
+            }
+        }
+    }
+    Trend_Log_Insert(log, &record);
+    if (log->Stop_When_Full && Trend_Log_Full(log)) {
+        /* the last record says why the logging stopped */
+        Trend_Log_Enable(log, false);
+    }
+}
+
+/**
+ * Samples the logs whose Log_Interval is up.  Call it once a second.
+ *
+ * @param seconds - time since the last call
+ */
+void Trend_Log_Timer(
+    uint16_t seconds)
+{
+    TREND_LOG_DESCR *log = NULL;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_TREND_LOGS; i++) {
+        log = &TL_Descr[i];
+        if (!log->Enable || (log->Buffer_Size == 0)) {
+            continue;
+        }
+        if (log->Remaining > seconds) {
+            log->Remaining -= seconds;
+            continue;
+        }
+        log->Remaining = log->Log_Interval;
+        Trend_Log_Sample(log);
+    }
+}
+
+void Trend_Log_Init(
+    void)
+{
+    BACNET_DATE epoch;
+    TREND_LOG_DESCR *log = NULL;
+    unsigned i = 0;
+
+    datetime_set_date(&epoch, TL_EPOCH_YEAR, 1, 1);
+    TL_Epoch_Days = datetime_days_since_epoch(&epoch);
+    for (i = 0; i < MAX_TREND_LOGS; i++) {
+        log = &TL_Descr[i];
+        if (!log->Buffer) {
+            log->Buffer =
+                objinst_realloc(NULL,
+                TREND_LOG_BUFFER_SIZE * sizeof(TL_RECORD));
+        }
+        log->Buffer_Size = log->Buffer ? TREND_LOG_BUFFER_SIZE : 0;
+        log->Record_Count = 0;
+        log->Record_Start = 0;
+        log->Total_Record_Count = 0;
+        log->Stop_When_Full = false;
+        log->Log_Interval = TREND_LOG_INTERVAL;
+        log->Remaining = 0;
+        /* each log follows the Analog Value of the same instance */
+        log->Source.objectIdentifier.type = OBJECT_ANALOG_VALUE;
+        log->Source.objectIdentifier.instance = i;
+        log->Source.propertyIdentifier = PROP_PRESENT_VALUE;
+        log->Source.arrayIndex = BACNET_ARRAY_ALL;
+        log->Source.deviceIndentifier.type = BACNET_NO_DEV_TYPE;
+        log->Source.deviceIndentifier.instance = BACNET_NO_DEV_ID;
+        log->Enable = (log->Buffer_Size != 0);
+#if TREND_LOG_ARCHIVE
+        log->Archive = tl_archive_open(i);
+        /* carry on numbering from the records kept on flash */
+        log->Total_Record_Count = tl_archive_newest(log->Archive);
+#endif
+    }
+}
+
+bool Trend_Log_Valid_Instance(
+    uint32_t object_instance)
+{
+    return (object_instance < MAX_TREND_LOGS);
+}
+
+unsigned Trend_Log_Count(
+    void)
+{
+    return MAX_TREND_LOGS;
+}
+
+uint32_t Trend_Log_Index_To_Instance(
+    unsigned index)
+{
+    return index;
+}
+
+unsigned Trend_Log_Instance_To_Index(
+    uint32_t object_instance)
+{
+    return (object_instance < MAX_TREND_LOGS) ? object_instance :
+        MAX_TREND_LOGS;
+}
+
+bool Trend_Log_Object_Name(
+    uint32_t object_instance,
+    BACNET_CHARACTER_STRING * object_name)
+{
+    char text_string[32] = "";
+    bool status = false;
+
+    if (Trend_Log_Valid_Instance(object_instance)) {
+        sprintf(text_string, "TREND LOG %lu", (unsigned long) object_instance);
+        status = characterstring_init_ansi(object_name, text_string);
+    }
+
+    return status;
+}
+
+/**
+ * Sets what a log samples and how often, and empties it if that
+ * is not what it sampled before.
+ *
+ * @param  object_instance - object-instance number of the log
+ * @param  object_type - type of the local object to sample
+ * @param  source_instance - instance of the local object to sample
+ * @param  object_property - property to sample
+ * @param  log_interval - seconds between samples
+ *
+ * @return true if the log exists
+ */
+bool Trend_Log_Source_Set(
+    uint32_t object_instance,
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t source_instance,
+    BACNET_PROPERTY_ID object_property,
+    uint32_t log_interval)
+{
+    TREND_LOG_DESCR *log = NULL;
+
+    if (!Trend_Log_Valid_Instance(object_instance) || (log_interval == 0)) {
+        return false;
+    }
+    log = &TL_Descr[object_instance];
+    log->Log_Interval = log_interval;
+    log->Remaining = 0;
+    if ((log->Source.objectIdentifier.type == object_type) &&
+        (log->Source.objectIdentifier.instance == source_instance) &&
+        (log->Source.propertyIdentifier == object_property) &&
+        (log->Source.arrayIndex == BACNET_ARRAY_ALL)) {
+        /* the same records as the ones already logged */
+        return true;
+    }
+    log->Source.objectIdentifier.type = object_type;
+    log->Source.objectIdentifier.instance = source_instance;
+    log->Source.propertyIdentifier = object_property;
+    log->Source.arrayIndex = BACNET_ARRAY_ALL;
+    Trend_Log_Purge(log);
+
+    return true;
+}
+
+bool Trend_Log_Enable_Set(
+    uint32_t object_instance,
+    bool enable)
+{
+    if (!Trend_Log_Valid_Instance(object_instance)) {
+        return false;
+    }
+    Trend_Log_Enable(&TL_Descr[object_instance], enable);
+
+    return true;
+}
+
+static int Trend_Log_Read_Object_Identifier(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_object_id(&rpdata->application_data[0],
+        OBJECT_TRENDLOG, rpdata->object_instance);
+}
+
+static int Trend_Log_Read_Object_Name(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_CHARACTER_STRING char_string;
+
+    Trend_Log_Object_Name(rpdata->object_instance, &char_string);
+
+    return encode_application_character_string(&rpdata->application_data[0],
+        &char_string);
+}
+
+static int Trend_Log_Read_Object_Type(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        OBJECT_TRENDLOG);
+}
+
+static int Trend_Log_Read_Enable(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_boolean(&rpdata->application_data[0],
+        TL_Descr[object_index].Enable);
+}
+
+static int Trend_Log_Read_Stop_When_Full(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_boolean(&rpdata->application_data[0],
+        TL_Descr[object_index].Stop_When_Full);
+}
+
+static int Trend_Log_Read_Buffer_Size(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        Trend_Log_Capacity(&TL_Descr[object_index]));
+}
+
+static int Trend_Log_Read_Log_Buffer(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    /* the buffer is only read with ReadRange */
+    rpdata->error_class = ERROR_CLASS_PROPERTY;
+    rpdata->error_code = ERROR_CODE_READ_ACCESS_DENIED;
+
+    return BACNET_STATUS_ERROR;
+}
+
+static int Trend_Log_Read_Record_Count(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        Trend_Log_Records(&TL_Descr[object_index]));
+}
+
+static int Trend_Log_Read_Total_Record_Count(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_unsigned(&rpdata->application_data[0],
+        TL_Descr[object_index].Total_Record_Count);
+}
+
+static int Trend_Log_Read_Event_State(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        EVENT_STATE_NORMAL);
+}
+
+static int Trend_Log_Read_Logging_Type(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return encode_application_enumerated(&rpdata->application_data[0],
+        LOGGING_TYPE_POLLED);
+}
+
+static int Trend_Log_Read_Status_Flags(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    BACNET_BIT_STRING bit_string;
+
+    bitstring_init(&bit_string);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_IN_ALARM, false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_FAULT, false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_OVERRIDDEN, false);
+    bitstring_set_bit(&bit_string, STATUS_FLAG_OUT_OF_SERVICE, false);
+
+    return encode_application_bitstring(&rpdata->application_data[0],
+        &bit_string);
+}
+
+static int Trend_Log_Read_Log_Device_Object_Property(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    return bacapp_encode_device_obj_property_ref(&rpdata->application_data[0],
+        &TL_Descr[object_index].Source);
+}
+
+static int Trend_Log_Read_Log_Interval(
+    BACNET_READ_PROPERTY_DATA * rpdata,
+    unsigned object_index)
+{
+    /* in hundredths of a second */
+    return encode_application_unsigned(&rpdata->application_data[0],
+        TL_Descr[object_index].Log_Interval * 100);
+}
+
+/* The Trend Log properties, as ReadPropertyMultiple lists them */
+static const struct property_descr_t Trend_Log_Property_Descr[] = {
+    {PROP_OBJECT_IDENTIFIER, PROPERTY_REQUIRED,
+        Trend_Log_Read_Object_Identifier},
+    {PROP_OBJECT_NAME, PROPERTY_REQUIRED, Trend_Log_Read_Object_Name},
+    {PROP_OBJECT_TYPE, PROPERTY_REQUIRED, Trend_Log_Read_Object_Type},
+    {PROP_ENABLE, PROPERTY_REQUIRED, Trend_Log_Read_Enable},
+    {PROP_STOP_WHEN_FULL, PROPERTY_REQUIRED, Trend_Log_Read_Stop_When_Full},
+    {PROP_BUFFER_SIZE, PROPERTY_REQUIRED, Trend_Log_Read_Buffer_Size},
+    {PROP_LOG_BUFFER, PROPERTY_REQUIRED, Trend_Log_Read_Log_Buffer},
+    {PROP_RECORD_COUNT, PROPERTY_REQUIRED, Trend_Log_Read_Record_Count},
+    {PROP_TOTAL_RECORD_COUNT, PROPERTY_REQUIRED,
+        Trend_Log_Read_Total_Record_Count},
+    {PROP_EVENT_STATE, PROPERTY_REQUIRED, Trend_Log_Read_Event_State},
+    {PROP_LOGGING_TYPE, PROPERTY_REQUIRED, Trend_Log_Read_Logging_Type},
+    {PROP_STATUS_FLAGS, PROPERTY_REQUIRED, Trend_Log_Read_Status_Flags},
+    {PROP_LOG_DEVICE_OBJECT_PROPERTY, PROPERTY_OPTIONAL,
+        Trend_Log_Read_Log_Device_Object_Property},
+    {PROP_LOG_INTERVAL, PROPERTY_OPTIONAL, Trend_Log_Read_Log_Interval},
+};
+
+static const struct property_table_t Trend_Log_Properties =
+    PROPERTY_TABLE(Trend_Log_Property_Descr);
+
+/* These three arrays are used by the ReadPropertyMultiple handler,
+   and are filled from the property table on first use */
+#define TL_PROPERTY_COUNT \
+    (sizeof(Trend_Log_Property_Descr) / sizeof(Trend_Log_Property_Descr[0]))
+static int Trend_Log_Properties_Required[TL_PROPERTY_COUNT + 1];
+static int Trend_Log_Properties_Optional[TL_PROPERTY_COUNT + 1];
+static int Trend_Log_Properties_Proprietary[TL_PROPERTY_COUNT + 1];
+static bool Trend_Log_Properties_Valid;
+
+void Trend_Log_Property_Lists(
+    const int **pRequired,
+    const int **pOptional,
+    const int **pProprietary)
+{
+    if (!Trend_Log_Properties_Valid) {
+        property_table_lists(&Trend_Log_Properties,
+            Trend_Log_Properties_Required, Trend_Log_Properties_Optional,
+            Trend_Log_Properties_Proprietary);
+        Trend_Log_Properties_Valid = true;
+    }
+    if (pRequired)
+        *pRequired = Trend_Log_Properties_Required;
+    if (pOptional)
+        *pOptional = Trend_Log_Properties_Optional;
+    if (pProprietary)
+        *pProprietary = Trend_Log_Properties_Proprietary;
+
+    return;
+}
+
+const struct property_table_t *Trend_Log_Property_Table(
+    void)
+{
+    return &Trend_Log_Properties;
+}
+
+/* return apdu len, or BACNET_STATUS_ERROR on error */
+int Trend_Log_Read_Property(
+    BACNET_READ_PROPERTY_DATA * rpdata)
+{
+    unsigned object_index = 0;
+
+    if ((rpdata == NULL) || (rpdata->application_data == NULL) ||
+        (rpdata->application_data_len == 0)) {
+        return 0;
+    }
+
+    object_index = Trend_Log_Instance_To_Index(rpdata->object_instance);
+    if (object_index >= MAX_TREND_LOGS)
+        return BACNET_STATUS_ERROR;
+
+    return property_table_read(&Trend_Log_Properties, rpdata, object_index);
+}
+
+/* returns true if successful */
+bool Trend_Log_Write_Property(
+    BACNET_WRITE_PROPERTY_DATA * wp_data)
+{
+    bool status = false;        /* return value */
+    unsigned object_index = 0;
+    int len = 0;
+    BACNET_APPLICATION_DATA_VALUE value;
+    BACNET_DEVICE_OBJECT_PROPERTY_REFERENCE source;
+    TREND_LOG_DESCR *log = NULL;
+
+    object_index = Trend_Log_Instance_To_Index(wp_data->object_instance);
+    if (object_index >= MAX_TREND_LOGS)
+        return false;
+    log = &TL_Descr[object_index];
+    if (wp_data->array_index != BACNET_ARRAY_ALL) {
+        /*  only array properties can have array options */
+        wp_data->error_class = ERROR_CLASS_PROPERTY;
+        wp_data->error_code = ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY;
+        return false;
+    }
+    if (wp_data->object_property == PROP_LOG_DEVICE_OBJECT_PROPERTY) {
+        /* a constructed value, not an application tagged one */
+        len =
+            bacapp_decode_device_obj_property_ref(wp_data->application_data,
+            &source);
+        if ((len <= 0) || (len > wp_data->application_data_len)) {
+            wp_data->error_class = ERROR_CLASS_PROPERTY;
+            wp_data->error_code = ERROR_CODE_INVALID_DATA_TYPE;
+        } else if ((source.deviceIndentifier.type == OBJECT_DEVICE) &&
+            (source.deviceIndentifier.instance !=
+                Device_Object_Instance_Number())) {
+            /* we only log our own objects */
+            wp_data->error_class = ERROR_CLASS_PROPERTY;
+            wp_data->error_code = ERROR_CODE_OPTIONAL_FUNCTIONALITY_NOT_SUPPORTED;
+        } else {
+            log->Source = source;
+            log->Remaining = 0;
+            Trend_Log_Purge(log);
+            status = true;
+        }
+        return status;
+    }
+    /* decode the some of the request */
+    len =
+        bacapp_decode_application_data(wp_data->application_data,
+        wp_data->application_data_len, &value);
+    if (len < 0) {
+        /* error while decoding - a value larger than we can handle */
+        wp_data->error_class = ERROR_CLASS_PROPERTY;
+        wp_data->error_code = ERROR_CODE_VALUE_OUT_OF_RANGE;
+        return false;
+    }
+
+    switch (wp_data->object_property) {
+        case PROP_ENABLE:
+            status =
+                WPValidateArgType(&value, BACNET_APPLICATION_TAG_BOOLEAN,
+                &wp_data->error_class, &wp_data->error_code);
+            if (status) {
+                Trend_Log_Enable(log, value.type.Boolean);
+            }
+            break;
+
+        case PROP_STOP_WHEN_FULL:
+            status =
+                WPValidateArgType(&value, BACNET_APPLICATION_TAG_BOOLEAN,
+                &wp_data->error_class, &wp_data->error_code);
+            if (status) {
+                log->Stop_When_Full = value.type.Boolean;
+            }
+            break;
+
+        case PROP_RECORD_COUNT:
+            status =
+                WPValidateArgType(&value, BACNET_APPLICATION_TAG_UNSIGNED_INT,
+                &wp_data->error_class, &wp_data->error_code);
+            if (status) {
+                /* only zero may be written, to empty the log */
+                if (value.type.Unsigned_Int == 0) {
+                    Trend_Log_Purge(log);
+                } else {
+                    status = false;
+                    wp_data->error_class = ERROR_CLASS_PROPERTY;
+                    wp_data->error_code = ERROR_CODE_VALUE_OUT_OF_RANGE;
+                }
+            }
+            break;
+
+        case PROP_LOG_INTERVAL:
+            status =
+                WPValidateArgType(&value, BACNET_APPLICATION_TAG_UNSIGNED_INT,
+                &wp_data->error_class, &wp_data->error_code);
+            if (status) {
+                /* hundredths of a second; we sample on whole seconds */
+                if (value.type.Unsigned_Int != 0) {
+                    log->Log_Interval = (value.type.Unsigned_Int + 99) / 100;
+                    log->Remaining = 0;
+                } else {
+                    status = false;
+                    wp_data->error_class = ERROR_CLASS_PROPERTY;
+                    wp_data->error_code = ERROR_CODE_VALUE_OUT_OF_RANGE;
+                }
+            }
+            break;
+
+        case PROP_OBJECT_IDENTIFIER:
+        case PROP_OBJECT_NAME:
+        case PROP_OBJECT_TYPE:
+        case PROP_BUFFER_SIZE:
+        case PROP_LOG_BUFFER:
+        case PROP_TOTAL_RECORD_COUNT:
+        case PROP_EVENT_STATE:
+        case PROP_LOGGING_TYPE:
+        case PROP_STATUS_FLAGS:
+            wp_data->error_class = ERROR_CLASS_PROPERTY;
+            wp_data->error_code = ERROR_CODE_WRITE_ACCESS_DENIED;
+            break;
+        default:
+            wp_data->error_class = ERROR_CLASS_PROPERTY;
+            wp_data->error_code = ERROR_CODE_UNKNOWN_PROPERTY;
+            break;
+    }
+
+    return status;
+}
+
+bool Trend_Log_RR_Info(
+    BACNET_READ_RANGE_DATA * pRequest,  /* Info on the request */
+    RR_PROP_INFO * pInfo)
+{       /* Where to put the response */
+    bool status = false;        /* return value */
+
+    if (!Trend_Log_Valid_Instance(pRequest->object_instance)) {
+        pRequest->error_class = ERROR_CLASS_OBJECT;
+        pRequest->error_code = ERROR_CODE_UNKNOWN_OBJECT;
+    } else if (pRequest->object_property == PROP_LOG_BUFFER) {
+        pInfo->RequestTypes = RR_BY_POSITION | RR_BY_SEQUENCE | RR_BY_TIME;
+        pInfo->Handler = rr_trend_log_encode;
+        status = true;
+    } else {
+        pRequest->error_class = ERROR_CLASS_SERVICES;
+        pRequest->error_code = ERROR_CODE_PROPERTY_IS_NOT_A_LIST;
+    }
+
+    return status;
+}
+
+/* BACnetLogRecord ::= SEQUENCE {
+    timestamp   [0] BACnetDateTime,
+    logDatum    [1] CHOICE {...},
+    statusFlags [2] BACnetStatusFlags OPTIONAL
+} */
+static int Trend_Log_Encode_Record(
+    uint8_t * apdu,
+    TL_RECORD * record)
+{
+    BACNET_DATE_TIME bdatetime;
+    BACNET_BIT_STRING bit_string;
+    int len = 0;
+    uint8_t i = 0;
+
+    Trend_Log_Date_Time(record->Time, &bdatetime);
+    len += encode_opening_tag(&apdu[len], 0);
+    len += encode_application_date(&apdu[len], &bdatetime.date);
+    len += encode_application_time(&apdu[len], &bdatetime.time);
+    len += encode_closing_tag(&apdu[len], 0);
+    len += encode_opening_tag(&apdu[len], 1);
+    switch (record->Type) {
+        case TL_TYPE_STATUS:
+            bitstring_init(&bit_string);
+            for (i = 0; i <= LOG_STATUS_LOG_INTERRUPTED; i++) {
+                bitstring_set_bit(&bit_string, i,
+                    (record->Datum.Bits & (1UL << i)) ? true : false);
+            }
+            len += encode_context_bitstring(&apdu[len], record->Type,
+                &bit_string);
+            break;
+        case TL_TYPE_BOOL:
+            len += encode_context_boolean(&apdu[len], record->Type,
+                record->Datum.Boolean);
+            break;
+        case TL_TYPE_REAL:
+            len += encode_context_real(&apdu[len], record->Type,
+                record->Datum.Real);
+            break;
+        case TL_TYPE_ENUM:
+            len += encode_context_enumerated(&apdu[len], record->Type,
+                record->Datum.Enumerated);
+            break;
+        case TL_TYPE_UNSIGN:
+            len += encode_context_unsigned(&apdu[len], record->Type,
+                record->Datum.Unsigned);
+            break;
+        case TL_TYPE_SIGN:
+            len += encode_context_signed(&apdu[len], record->Type,
+                record->Datum.Signed);
+            break;
+        case TL_TYPE_ERROR:
+            len += encode_opening_tag(&apdu[len], record->Type);
+            len += encode_application_enumerated(&apdu[len],
+                record->Datum.Bits >> 16);
+            len += encode_application_enumerated(&apdu[len],
+                record->Datum.Bits & 0xFFFF);
+            len += encode_closing_tag(&apdu[len], record->Type);
+            break;
+        case TL_TYPE_NULL:
+        default:
+            len += encode_context_null(&apdu[len], TL_TYPE_NULL);
+            break;
+    }
+    len += encode_closing_tag(&apdu[len], 1);
+    if (record->Status & TL_STATUS_FLAGS_VALID) {
+        bitstring_init(&bit_string);
+        for (i = 0; i < 4; i++) {
+            bitstring_set_bit(&bit_string, i,
+                (record->Status & (1 << i)) ? true : false);
+        }
+        len += encode_context_bitstring(&apdu[len], 2, &bit_string);
+    }
+
+    return len;
+}
+
+/* reads records by sequence number, from the ring when it still has
+   them and from the archive when it does not */
+typedef struct tl_reader {
+    TREND_LOG_DESCR *Log;
+#if TREND_LOG_ARCHIVE
+    TL_CURSOR Cursor;
+    bool Cursor_Valid;
+#endif
+} TL_READER;
+
+static bool Trend_Log_Read_Record(
+    TL_READER * reader,
+    uint32_t sequence,
+    TL_RECORD * record)
+{
+    TREND_LOG_DESCR *log = reader->Log;
+    uint32_t first = Trend_Log_Ring_First(log);
+
+    if (log->Record_Count && (sequence >= first) &&
+        (sequence <= log->Total_Record_Count)) {
+        *record = *Trend_Log_Record(log, sequence - first + 1);
+        return true;
+    }
+#if TREND_LOG_ARCHIVE
+    /* one after the other, the cursor decodes each record once */
+    if (reader->Cursor_Valid && ((reader->Cursor.Sequence + 1) == sequence)) {
+        reader->Cursor_Valid = tl_archive_next(&reader->Cursor);
+    } else if (!reader->Cursor_Valid ||
+        (reader->Cursor.Sequence != sequence)) {
+        reader->Cursor_Valid =
+            tl_archive_seek(log->Archive, &reader->Cursor, sequence);
+    }
+    if (reader->Cursor_Valid && (reader->Cursor.Sequence == sequence)) {
+        *record = reader->Cursor.Record;
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+/* the sequence number of the first record later than the time,
+   or the one after the newest if there is none - a binary search
+   of the ring, or of the archive for the older records */
+static uint32_t Trend_Log_Find_Time(
+    TREND_LOG_DESCR * log,
+    uint32_t seconds)
+{
+    uint32_t low = 1;
+    uint32_t high = log->Record_Count + 1;
+    uint32_t middle = 0;
+#if TREND_LOG_ARCHIVE
+    uint32_t sequence = 0;
+#endif
+
+    if (log->Record_Count && (Trend_Log_Record(log, 1)->Time <= seconds)) {
+        while (low < high) {
+            middle = low + ((high - low) / 2);
+            if (Trend_Log_Record(log, middle)->Time > seconds) {
+                high = middle;
+            } else {
+                low = middle + 1;
+            }
+        }
+        return Trend_Log_Ring_First(log) + low - 1;
+    }
+#if TREND_LOG_ARCHIVE
+    if (tl_archive_oldest(log->Archive)) {
+        sequence = tl_archive_find_time(log->Archive, seconds);
+        if ((log->Record_Count == 0) ||
+            (sequence < Trend_Log_Ring_First(log))) {
+            return sequence;
+        }
+    }
+#endif
+
+    return log->Record_Count ? Trend_Log_Ring_First(log) :
+        (log->Total_Record_Count + 1);
+}
+
+/**
+ * Encodes the records of the Log_Buffer that a ReadRange asks for,
+ * straight into the reply, reading one record at a time.
+ *
+ * @param apdu - where to encode the records
+ * @param pRequest - the request, which gets the ItemCount,
+ *        FirstSequence and ResultFlags of the reply
+ *
+ * @return the number of bytes encoded
+ */
+int rr_trend_log_encode(
+    uint8_t * apdu,
+    BACNET_READ_RANGE_DATA * pRequest)
+{
+    TL_READER reader;
+    TL_RECORD record;
+    uint8_t scratch[TL_MAX_ENC];
+    uint32_t first = 0; /* position of the first record to send */
+    uint32_t last = 0;  /* position of the last record to send */
+    uint32_t oldest = 0;        /* sequence number of position 1 */
+    uint32_t count = 0;
+    uint32_t position = 0;
+    uint32_t sequence = 0;
+    uint32_t seconds = 0;
+    int32_t remaining = 0;
+    int32_t total = 0;
+    int len = 0;
+    int iLen = 0;
+
+    /* Initialise result flags to all false */
+    bitstring_init(&pRequest->ResultFlags);
+    bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_FIRST_ITEM, false);
+    bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_LAST_ITEM, false);
+    bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_MORE_ITEMS, false);
+    pRequest->ItemCount = 0;
+    reader.Log =
+        &TL_Descr[Trend_Log_Instance_To_Index(pRequest->object_instance)];
+#if TREND_LOG_ARCHIVE
+    reader.Cursor_Valid = false;
+#endif
+    oldest = Trend_Log_Oldest(reader.Log);
+    if (oldest == 0) {
+        return 0;
+    }
+    count = reader.Log->Total_Record_Count - oldest + 1;
+    /* turn the request into the positions of a range of records */
+    switch (pRequest->RequestType) {
+        case RR_BY_POSITION:
+            position = pRequest->Range.RefIndex;
+            break;
+        case RR_BY_SEQUENCE:
+            if ((pRequest->Range.RefSeqNum < oldest) ||
+                (pRequest->Range.RefSeqNum >
+                    reader.Log->Total_Record_Count)) {
+                return 0;
+            }
+            position = pRequest->Range.RefSeqNum - oldest + 1;
+            break;
+        case RR_BY_TIME:
+            /* the records later than the time, or the ones before it */
+            seconds = Trend_Log_Seconds(&pRequest->Range.RefTime);
+            if (pRequest->Count < 0) {
+                if (seconds == 0) {
+                    return 0;
+                }
+                sequence = Trend_Log_Find_Time(reader.Log, seconds - 1) - 1;
+            } else {
+                sequence = Trend_Log_Find_Time(reader.Log, seconds);
+            }
+            position = (sequence < oldest) ? 0 : (sequence - oldest + 1);
+            break;
+        case RR_READ_ALL:
+        default:
+            position = 1;
+            pRequest->Count = (int32_t) count;
+            break;
+    }
+    if ((position == 0) || (position > count)) {
+        return 0;
+    }
+    remaining = pRequest->application_data_len - pRequest->Overhead;
+    if (pRequest->Count < 0) {
+        last = position;
+        if ((uint32_t) (-pRequest->Count) >= last) {
+            first = 1;
+        } else {
+            first = last + (uint32_t) pRequest->Count + 1;
+        }
+        /* the records nearest the reference go out if not all fit:
+           add up their sizes, then drop the oldest until they do */
+        if ((last - first + 1) > (uint32_t) (remaining / TL_MIN_ENC)) {
+            first = last - (uint32_t) (remaining / TL_MIN_ENC) + 1;
+            bitstring_set_bit(&pRequest->ResultFlags,
+                RESULT_FLAG_MORE_ITEMS, true);
+        }
+        for (position = first; position <= last; position++) {
+            if (!Trend_Log_Read_Record(&reader, oldest + position - 1,
+                    &record)) {
+                last = position - 1;
+                break;
+            }
+            total += Trend_Log_Encode_Record(scratch, &record);
+        }
+        while ((first <= last) && (total > remaining) &&
+            Trend_Log_Read_Record(&reader, oldest + first - 1, &record)) {
+            total -= Trend_Log_Encode_Record(scratch, &record);
+            first++;
+            bitstring_set_bit(&pRequest->ResultFlags,
+                RESULT_FLAG_MORE_ITEMS, true);
+        }
+    } else {
+        first = position;
+        last = count;
+        if ((uint32_t) pRequest->Count < (last - first + 1)) {
+            last = first + (uint32_t) pRequest->Count - 1;
+        }
+    }
+    for (position = first; position <= last; position++) {
+        if ((pRequest->Count > 0) && (remaining < TL_MAX_ENC)) {
+            bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_MORE_ITEMS,
+                true);
+            break;
+        }
+        if (!Trend_Log_Read_Record(&reader, oldest + position - 1, &record)) {
+            break;
+        }
+        len = Trend_Log_Encode_Record(&apdu[iLen], &record);
+        iLen += len;
+        remaining -= len;
+        pRequest->ItemCount++;
+    }
+    if (pRequest->ItemCount) {
+        if (first == 1) {
+            bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_FIRST_ITEM,
+                true);
+        }
+        if ((first + pRequest->ItemCount - 1) == count) {
+            bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_LAST_ITEM,
+                true);
+        }
+        pRequest->FirstSequence = oldest + first - 1;
+    }
+
+    return iLen;
+}
+
+#ifdef TEST
+#include <assert.h>
+#include <string.h>
+#include "ctest.h"
+
+bool WPValidateArgType(
+    BACNET_APPLICATION_DATA_VALUE * pValue,
+    uint8_t ucExpectedTag,
+    BACNET_ERROR_CLASS * pErrorClass,
+    BACNET_ERROR_CODE * pErrorCode)
+{
+    pValue = pValue;
+    ucExpectedTag = ucExpectedTag;
+    pErrorClass = pErrorClass;
+    pErrorCode = pErrorCode;
+
+    return false;
+}
+
+/* fills a log with REAL records one minute apart, value = minute */
+static void testTrendLogFill(
+    TREND_LOG_DESCR * log,
+    uint32_t records)
+{
+    TL_RECORD record;
+    uint32_t i;
+
+    log->Record_Count = 0;
+    log->Record_Start = 0;
+    log->Total_Record_Count = 0;
+#if TREND_LOG_ARCHIVE
+    tl_archive_purge(log->Archive);
+#endif
+    for (i = 0; i < records; i++) {
+        record.Time = 86400UL + (i * 60);
+        record.Type = TL_TYPE_REAL;
+        record.Status = 0;
+        record.Datum.Real = (float) i;
+        Trend_Log_Insert(log, &record);
+#if TREND_LOG_ARCHIVE
+        while (tl_archive_maintenance()) {
+            /* the flash keeps up */
+        }
+#endif
+    }
+}
+
+/* the value of the n'th record of a ReadRange reply */
+static float testTrendLogValue(
+    uint8_t * apdu,
+    int apdu_len,
+    unsigned n)
+{
+    int len = 0;
+    uint8_t tag_number = 0;
+    uint32_t len_value = 0;
+    float value = -1.0f;
+
+    while (len < apdu_len) {
+        /* opening 0, date, time, closing 0, opening 1 */
+        len += 1 + 5 + 5 + 1 + 1;
+        len += decode_tag_number_and_value(&apdu[len], &tag_number,
+            &len_value);
+        len += decode_real(&apdu[len], &value);
+        len += 1;
+        if (n-- == 0) {
+            break;
+        }
+    }
+
+    return value;
+}
+
+void testTrendLog(
+    Test * pTest)
+{
+    BACNET_READ_RANGE_DATA request;
+    TREND_LOG_DESCR *log = &TL_Descr[0];
+    uint8_t apdu[MAX_APDU];
+    int len = 0;
+
+    Trend_Log_Init();
+    ct_test(pTest, Trend_Log_Count() == MAX_TREND_LOGS);
+    ct_test(pTest, log->Buffer_Size == TREND_LOG_BUFFER_SIZE);
+    /* wrap the ring: the oldest are overwritten */
+    testTrendLogFill(log, TREND_LOG_BUFFER_SIZE + 10);
+    ct_test(pTest, log->Record_Count == TREND_LOG_BUFFER_SIZE);
+    ct_test(pTest, log->Total_Record_Count == (TREND_LOG_BUFFER_SIZE + 10));
+    ct_test(pTest, Trend_Log_Record(log, 1)->Datum.Real == 10.0f);
+
+    memset(&request, 0, sizeof(request));
+    request.object_type = OBJECT_TRENDLOG;
+    request.object_instance = 0;
+    request.object_property = PROP_LOG_BUFFER;
+    request.array_index = BACNET_ARRAY_ALL;
+    request.application_data_len = MAX_APDU;
+    request.Overhead = RR_OVERHEAD + RR_1ST_SEQ_OVERHEAD;
+    /* by sequence: record 100 has the value 99 */
+    request.RequestType = RR_BY_SEQUENCE;
+    request.Range.RefSeqNum = 100;
+    request.Count = 3;
+    len = rr_trend_log_encode(apdu, &request);
+    ct_test(pTest, request.ItemCount == 3);
+    ct_test(pTest, request.FirstSequence == 100);
+    ct_test(pTest, testTrendLogValue(apdu, len, 0) == 99.0f);
+    ct_test(pTest, testTrendLogValue(apdu, len, 2) == 101.0f);
+    ct_test(pTest, !bitstring_bit(&request.ResultFlags,
+            RESULT_FLAG_FIRST_ITEM));
+    request.Range.RefSeqNum = 5;
+    len = rr_trend_log_encode(apdu, &request);
+#if TREND_LOG_ARCHIVE
+    /* records overwritten in the ring are read from the archive,
+       up to where the ring takes over */
+    ct_test(pTest, request.ItemCount == 3);
+    ct_test(pTest, testTrendLogValue(apdu, len, 0) == 4.0f);
+    request.Range.RefSeqNum = 10;
+    len = rr_trend_log_encode(apdu, &request);
+    ct_test(pTest, request.ItemCount == 3);
+    ct_test(pTest, testTrendLogValue(apdu, len, 2) == 11.0f);
+    request.Count = -3;
+    len = rr_trend_log_encode(apdu, &request);
+    ct_test(pTest, request.ItemCount == 3);
+    ct_test(pTest, request.FirstSequence == 8);
+    ct_test(pTest, testTrendLogValue(apdu, len, 0) == 7.0f);
+#else
+    /* overwritten records are gone */
+    ct_test(pTest, len == 0);
+    ct_test(pTest, request.ItemCount == 0);
+#endif
+    /* backwards from the newest */
+    request.Range.RefSeqNum = log->Total_Record_Count;
+    request.Count = -2;
+    len = rr_trend_log_encode(apdu, &request);
+    ct_test(pTest, request.ItemCount == 2);
+    ct_test(pTest, bitstring_bit(&request.ResultFlags,
+            RESULT_FLAG_LAST_ITEM));
+    ct_test(pTest, request.FirstSequence == (log->Total_Record_Count - 1));
+    /* by time: the records after 00:30 of day 1 start with minute 31 */
+    request.RequestType = RR_BY_TIME;
+    Trend_Log_Date_Time(86400UL + (30 * 60), &request.Range.RefTime);
+    request.Count = 2;
+    len = rr_trend_log_encode(apdu, &request);
+    ct_test(pTest, request.ItemCount == 2);
+    ct_test(pTest, testTrendLogValue(apdu, len, 0) == 31.0f);
+    ct_test(pTest, request.FirstSequence == 32);
+    /* and the ones before it end with minute 29 */
+    request.Count = -2;
+    len = rr_trend_log_encode(apdu, &request);
+    ct_test(pTest, request.ItemCount == 2);
+    ct_test(pTest, testTrendLogValue(apdu, len, 1) == 29.0f);
+    /* by position, and more than fits in one reply */
+    request.RequestType = RR_BY_POSITION;
+    request.Range.RefIndex = 1;
+    request.Count = TREND_LOG_BUFFER_SIZE;
+    len = rr_trend_log_encode(apdu, &request);
+    ct_test(pTest, request.ItemCount > 0);
+    ct_test(pTest, request.ItemCount < TREND_LOG_BUFFER_SIZE);
+    ct_test(pTest, len <= (MAX_APDU - request.Overhead));
+    ct_test(pTest, bitstring_bit(&request.ResultFlags,
+            RESULT_FLAG_FIRST_ITEM));
+    ct_test(pTest, bitstring_bit(&request.ResultFlags,
+            RESULT_FLAG_MORE_ITEMS));
+    ct_test(pTest, testTrendLogValue(apdu, len, 0) ==
+        (float) (Trend_Log_Oldest(log) - 1));
+    /* a purge leaves only the buffer-purged record */
+    Trend_Log_Purge(log);
+    ct_test(pTest, log->Record_Count == 1);
+    ct_test(pTest, Trend_Log_Record(log, 1)->Type == TL_TYPE_STATUS);
+
+    return;
+}
+
+#ifdef TEST_TREND_LOG
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("BACnet Trend Log", NULL);
+    /* individual tests */
+    rc = ct_addTestFunction(pTest, testTrendLog);
+    assert(rc);
+
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_TREND_LOG */
+#endif /* TEST */
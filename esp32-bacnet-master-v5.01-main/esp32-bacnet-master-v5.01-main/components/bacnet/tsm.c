@@ -35,6 +35,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include "bits.h"
 #include "apdu.h"
 #include "bacdef.h"
@@ -46,6 +47,8 @@
 #include "handlers.h"
 #include "address.h"
 #include "bacaddr.h"
+#include "abort.h"
+#include "baclock.h"
 
 /** @file tsm.c  BACnet Transaction State Machine operations  */
 
@@ -55,14 +58,36 @@
 /* If we are only a server and only initiate broadcasts, */
 /* then we don't need a TSM layer. */
 
-/* FIXME: not coded for segmentation */
-
 /* declare space for the TSM transactions, and set it up in the init. */
 /* table rules: an Invoke ID = 0 is an unused spot in the table */
 static BACNET_TSM_DATA TSM_List[MAX_TSM_TRANSACTIONS];
 
 /* invoke ID for incrementing between subsequent calls. */
 static uint8_t Current_Invoke_ID = 1;
+/* the client task sends and times out its requests while the
+   server task takes the replies */
+static BACLOCK TSM_Lock = BACLOCK_INITIALIZER;
+
+#if BACNET_SEGMENTATION_ENABLED
+#if (MAX_SEGMENTED_APDU > 65535)
+#error "MAX_SEGMENTED_APDU must fit in the 16-bit service request length"
+#endif
+/* ComplexACK header: type, invoke ID and service choice */
+#define COMPLEX_ACK_HEADER_LEN 3
+/* segmented ComplexACK header adds sequence number and window size */
+#define COMPLEX_ACK_SEGMENT_HEADER_LEN 5
+
+/* pooled buffers for reassembly and for segmented replies */
+static uint8_t Segment_Buffer[MAX_SEGMENT_BUFFERS][MAX_SEGMENTED_APDU];
+static bool Segment_Buffer_In_Use[MAX_SEGMENT_BUFFERS];
+/* transactions initiated by our peers - state IDLE is an unused spot */
+static BACNET_TSM_PEER_DATA TSM_Peer_List[MAX_TSM_PEER_TRANSACTIONS];
+/* segments, SegmentACKs and Aborts sent by the TSM itself */
+static uint8_t Segment_Transmit_Buffer[MAX_PDU];
+
+static void tsm_segment_data_free(
+    BACNET_TSM_SEGMENT_DATA * segment);
+#endif
 
 /* returns MAX_TSM_TRANSACTIONS if not found */
 static uint8_t tsm_find_invokeID_index(
@@ -103,6 +128,7 @@ bool tsm_transaction_available(
     bool status = false;        /* return value */
     unsigned i = 0;     /* counter */
 
+    baclock_take(&TSM_Lock);
     for (i = 0; i < MAX_TSM_TRANSACTIONS; i++) {
         if (TSM_List[i].InvokeID == 0) {
             /* one is available! */
@@ -110,6 +136,7 @@ bool tsm_transaction_available(
             break;
         }
     }
+    baclock_give(&TSM_Lock);
 
     return status;
 }
@@ -120,6 +147,7 @@ uint8_t tsm_transaction_idle_count(
     uint8_t count = 0;  /* return value */
     unsigned i = 0;     /* counter */
 
+    baclock_take(&TSM_Lock);
     for (i = 0; i < MAX_TSM_TRANSACTIONS; i++) {
         if ((TSM_List[i].InvokeID == 0) &&
             (TSM_List[i].state == TSM_STATE_IDLE)) {
@@ -127,6 +155,7 @@ uint8_t tsm_transaction_idle_count(
             count++;
         }
     }
+    baclock_give(&TSM_Lock);
 
     return count;
 }
@@ -136,10 +165,12 @@ uint8_t tsm_transaction_idle_count(
 void tsm_invokeID_set(
     uint8_t invokeID)
 {
+    baclock_take(&TSM_Lock);
     if (invokeID == 0) {
         invokeID = 1;
     }
     Current_Invoke_ID = invokeID;
+    baclock_give(&TSM_Lock);
 }
 
 /* gets the next free invokeID,
@@ -152,6 +183,7 @@ uint8_t tsm_next_free_invokeID(
     uint8_t invokeID = 0;
     bool found = false;
 
+    baclock_take(&TSM_Lock);
     /* is there even space available? */
     if (tsm_transaction_available()) {
         while (!found) {
@@ -183,6 +215,7 @@ uint8_t tsm_next_free_invokeID(
             }
         }
     }
+    baclock_give(&TSM_Lock);
 
     return invokeID;
 }
@@ -197,12 +230,14 @@ void tsm_set_confirmed_unsegmented_transaction(
     uint16_t j = 0;
     uint8_t index;
 
+    baclock_take(&TSM_Lock);
     if (invokeID) {
         index = tsm_find_invokeID_index(invokeID);
         if (index < MAX_TSM_TRANSACTIONS) {
             /* SendConfirmedUnsegmented */
             TSM_List[index].state = TSM_STATE_AWAIT_CONFIRMATION;
             TSM_List[index].RetryCount = 0;
+            TSM_List[index].Retransmit = false;
             /* start the timer */
             TSM_List[index].RequestTimer = apdu_timeout();
             /* copy the data */
@@ -214,6 +249,7 @@ void tsm_set_confirmed_unsegmented_transaction(
             bacnet_address_copy(&TSM_List[index].dest, dest);
         }
     }
+    baclock_give(&TSM_Lock);
 
     return;
 }
@@ -231,6 +267,7 @@ bool tsm_get_transaction_pdu(
     uint8_t index;
     bool found = false;
 
+    baclock_take(&TSM_Lock);
     if (invokeID) {
         index = tsm_find_invokeID_index(invokeID);
         /* how much checking is needed?  state?  dest match? just invokeID? */
@@ -247,16 +284,865 @@ bool tsm_get_transaction_pdu(
             found = true;
         }
     }
+    baclock_give(&TSM_Lock);
 
     return found;
 }
 
-/* called once a millisecond or slower */
+#if BACNET_SEGMENTATION_ENABLED
+/** Reserve one of the pooled segment buffers.
+ * @param buffer_size [out] size of the buffer, or 0 if none are free.
+ * @return buffer of MAX_SEGMENTED_APDU octets, or NULL if none are free.
+ */
+uint8_t *tsm_segment_buffer_alloc(
+    uint32_t * buffer_size)
+{
+    uint8_t *buffer = NULL;
+    unsigned i = 0;
+
+    baclock_take(&TSM_Lock);
+    for (i = 0; i < MAX_SEGMENT_BUFFERS; i++) {
+        if (!Segment_Buffer_In_Use[i]) {
+            Segment_Buffer_In_Use[i] = true;
+            buffer = &Segment_Buffer[i][0];
+            break;
+        }
+    }
+    baclock_give(&TSM_Lock);
+    if (buffer_size) {
+        *buffer_size = buffer ? MAX_SEGMENTED_APDU : 0;
+    }
+
+    return buffer;
+}
+
+/* returns MAX_SEGMENT_BUFFERS if the buffer is not from the pool */
+static unsigned tsm_segment_buffer_index(
+    uint8_t * buffer)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_SEGMENT_BUFFERS; i++) {
+        if (buffer == &Segment_Buffer[i][0]) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/** Return a buffer to the pool.
+ * Buffers that did not come from the pool, or NULL, are ignored.
+ * @param buffer [in] buffer from tsm_segment_buffer_alloc()
+ */
+void tsm_segment_buffer_free(
+    uint8_t * buffer)
+{
+    unsigned i = tsm_segment_buffer_index(buffer);
+
+    baclock_take(&TSM_Lock);
+    if (i < MAX_SEGMENT_BUFFERS) {
+        Segment_Buffer_In_Use[i] = false;
+    }
+    baclock_give(&TSM_Lock);
+}
+
+static void tsm_segment_data_free(
+    BACNET_TSM_SEGMENT_DATA * segment)
+{
+    tsm_segment_buffer_free(segment->buffer);
+    segment->buffer = NULL;
+    segment->buffer_len = 0;
+}
+
+/* the receiver gives up after missing a few segment timeouts */
+static uint16_t tsm_segment_receive_timeout(
+    void)
+{
+    uint32_t timeout = (uint32_t) apdu_segment_timeout() * 4;
+
+    if (timeout > UINT16_MAX) {
+        timeout = UINT16_MAX;
+    }
+
+    return (uint16_t) timeout;
+}
+
+static BACNET_TSM_PEER_DATA *tsm_peer_find(
+    BACNET_ADDRESS * src,
+    uint8_t invokeID)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_TSM_PEER_TRANSACTIONS; i++) {
+        if ((TSM_Peer_List[i].state != TSM_STATE_IDLE) &&
+            (TSM_Peer_List[i].InvokeID == invokeID) &&
+            bacnet_address_same(&TSM_Peer_List[i].dest, src)) {
+            return &TSM_Peer_List[i];
+        }
+    }
+
+    return NULL;
+}
+
+static BACNET_TSM_PEER_DATA *tsm_peer_alloc(
+    BACNET_ADDRESS * src,
+    uint8_t invokeID)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_TSM_PEER_TRANSACTIONS; i++) {
+        if (TSM_Peer_List[i].state == TSM_STATE_IDLE) {
+            memset(&TSM_Peer_List[i], 0, sizeof(TSM_Peer_List[i]));
+            TSM_Peer_List[i].InvokeID = invokeID;
+            bacnet_address_copy(&TSM_Peer_List[i].dest, src);
+            return &TSM_Peer_List[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void tsm_peer_free(
+    BACNET_TSM_PEER_DATA * peer)
+{
+    tsm_segment_data_free(&peer->segment);
+    peer->state = TSM_STATE_IDLE;
+    peer->InvokeID = 0;
+}
+
+/* encodes the NPDU into pdu[] */
+static int tsm_npdu_encode_pdu(
+    uint8_t * pdu,
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    bool data_expecting_reply,
+    BACNET_MESSAGE_PRIORITY priority)
+{
+    BACNET_ADDRESS my_address;
+
+    datalink_get_my_address(&my_address);
+    npdu_encode_npdu_data(npdu_data, data_expecting_reply, priority);
+
+    return npdu_encode_pdu(pdu, dest, &my_address, npdu_data);
+}
+
+/* encodes the NPDU into the segment transmit buffer */
+static int tsm_npdu_encode(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    bool data_expecting_reply,
+    BACNET_MESSAGE_PRIORITY priority)
+{
+    return tsm_npdu_encode_pdu(&Segment_Transmit_Buffer[0], dest, npdu_data,
+        data_expecting_reply, priority);
+}
+
+static void tsm_segmentack_send(
+    BACNET_ADDRESS * dest,
+    bool nak,
+    bool server,
+    uint8_t invokeID,
+    uint8_t sequence_number,
+    uint8_t actual_window_size)
+{
+    BACNET_NPDU_DATA npdu_data;
+    uint8_t *apdu = NULL;
+    int npdu_len = 0;
+
+    npdu_len =
+        tsm_npdu_encode(dest, &npdu_data, false, MESSAGE_PRIORITY_NORMAL);
+    apdu = &Segment_Transmit_Buffer[npdu_len];
+    apdu[0] = PDU_TYPE_SEGMENT_ACK;
+    if (nak) {
+        apdu[0] |= BAC_BIT(1);
+    }
+    if (server) {
+        apdu[0] |= BAC_BIT(0);
+    }
+    apdu[1] = invokeID;
+    apdu[2] = sequence_number;
+    apdu[3] = actual_window_size;
+    datalink_send_pdu(dest, &npdu_data, &Segment_Transmit_Buffer[0],
+        npdu_len + 4);
+}
+
+static void tsm_abort_send(
+    BACNET_ADDRESS * dest,
+    uint8_t invokeID,
+    uint8_t abort_reason,
+    bool server)
+{
+    BACNET_NPDU_DATA npdu_data;
+    int npdu_len = 0;
+    int apdu_len = 0;
+
+    npdu_len =
+        tsm_npdu_encode(dest, &npdu_data, false, MESSAGE_PRIORITY_NORMAL);
+    apdu_len =
+        abort_encode_apdu(&Segment_Transmit_Buffer[npdu_len], invokeID,
+        abort_reason, server);
+    datalink_send_pdu(dest, &npdu_data, &Segment_Transmit_Buffer[0],
+        npdu_len + apdu_len);
+}
+
+/* encodes one segment of the ComplexACK held by the peer transaction
+   into pdu[], and returns its length */
+static int tsm_segment_encode(
+    uint8_t * pdu,
+    BACNET_NPDU_DATA * npdu_data,
+    BACNET_TSM_PEER_DATA * peer,
+    uint8_t sequence_number)
+{
+    uint8_t *apdu = NULL;
+    uint32_t offset = 0;
+    uint32_t len = 0;
+    int npdu_len = 0;
+
+    offset = (uint32_t) sequence_number * peer->segment.segment_size;
+    len = peer->segment.buffer_len - offset;
+    if (len > peer->segment.segment_size) {
+        len = peer->segment.segment_size;
+    }
+    npdu_len =
+        tsm_npdu_encode_pdu(pdu, &peer->dest, npdu_data, true,
+        peer->npdu_data.priority);
+    apdu = &pdu[npdu_len];
+    apdu[0] = PDU_TYPE_COMPLEX_ACK | BAC_BIT(3);
+    if ((sequence_number + 1) < peer->segment.segment_count) {
+        apdu[0] |= BAC_BIT(2);
+    }
+    apdu[1] = peer->InvokeID;
+    apdu[2] = sequence_number;
+    apdu[3] = peer->segment.ProposedWindowSize;
+    apdu[4] = peer->segment.service_choice;
+    memcpy(&apdu[COMPLEX_ACK_SEGMENT_HEADER_LEN],
+        &peer->segment.buffer[offset], len);
+
+    return npdu_len + COMPLEX_ACK_SEGMENT_HEADER_LEN + (int) len;
+}
+
+/* sends one segment of the ComplexACK held by the peer transaction */
+static void tsm_segment_send(
+    BACNET_TSM_PEER_DATA * peer,
+    uint8_t sequence_number)
+{
+    BACNET_NPDU_DATA npdu_data;
+    int pdu_len = 0;
+
+    pdu_len =
+        tsm_segment_encode(&Segment_Transmit_Buffer[0], &npdu_data, peer,
+        sequence_number);
+    datalink_send_pdu(&peer->dest, &npdu_data, &Segment_Transmit_Buffer[0],
+        (unsigned) pdu_len);
+}
+
+/* 5.4.5.3 FillWindow: send the segments of the current window */
+static void tsm_segment_window_send(
+    BACNET_TSM_PEER_DATA * peer)
+{
+    unsigned i = 0;
+    unsigned sequence_number = 0;
+
+    for (i = 0; i < peer->segment.ActualWindowSize; i++) {
+        sequence_number = peer->segment.InitialSequenceNumber + i;
+        if (sequence_number >= peer->segment.segment_count) {
+            break;
+        }
+        tsm_segment_send(peer, (uint8_t) sequence_number);
+        if ((sequence_number + 1) == peer->segment.segment_count) {
+            peer->segment.SentAllSegments = true;
+        }
+    }
+    peer->segment.SegmentTimer = apdu_segment_timeout();
+}
+
+/* tsm_set_complexack_transaction() with TSM_Lock held */
+static int tsm_set_complexack_transaction_locked(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    BACNET_CONFIRMED_SERVICE_DATA * service_data,
+    uint8_t * apdu,
+    uint32_t apdu_len)
+{
+    BACNET_TSM_PEER_DATA *peer = NULL;
+    BACNET_NPDU_DATA reply_npdu_data;
+    uint8_t *buffer = NULL;
+    uint8_t abort_reason = ABORT_REASON_OTHER;
+    uint32_t max_apdu = 0;
+    uint32_t segment_size = 0;
+    uint32_t segment_count = 0;
+    int npdu_len = 0;
+    int bytes_sent = 0;
+
+    max_apdu = (uint32_t) service_data->max_resp;
+    if (max_apdu > MAX_APDU) {
+        max_apdu = MAX_APDU;
+    }
+    peer = tsm_peer_find(dest, service_data->invoke_id);
+    if (apdu_len <= max_apdu) {
+        npdu_len =
+            tsm_npdu_encode(dest, &reply_npdu_data, false,
+            npdu_data->priority);
+        memcpy(&Segment_Transmit_Buffer[npdu_len], apdu, apdu_len);
+        bytes_sent =
+            datalink_send_pdu(dest, &reply_npdu_data,
+            &Segment_Transmit_Buffer[0], npdu_len + apdu_len);
+        tsm_segment_buffer_free(apdu);
+        if (peer) {
+            tsm_peer_free(peer);
+        }
+        return bytes_sent;
+    }
+    if (!service_data->segmented_response_accepted) {
+        abort_reason = ABORT_REASON_SEGMENTATION_NOT_SUPPORTED;
+        goto TSM_ABORT;
+    }
+    segment_size = max_apdu - COMPLEX_ACK_SEGMENT_HEADER_LEN;
+    segment_count =
+        (apdu_len - COMPLEX_ACK_HEADER_LEN + segment_size - 1) / segment_size;
+    if ((segment_count > 255) || ((service_data->max_segs >= 2) &&
+            (service_data->max_segs <= 64) &&
+            (segment_count > (uint32_t) service_data->max_segs))) {
+        abort_reason = ABORT_REASON_BUFFER_OVERFLOW;
+        goto TSM_ABORT;
+    }
+    if (peer) {
+        /* the request was segmented - its buffer is no longer needed */
+        tsm_segment_data_free(&peer->segment);
+    } else {
+        peer = tsm_peer_alloc(dest, service_data->invoke_id);
+        if (!peer) {
+            abort_reason = ABORT_REASON_PREEMPTED_BY_HIGHER_PRIORITY_TASK;
+            goto TSM_ABORT;
+        }
+    }
+    buffer = apdu;
+    if (tsm_segment_buffer_index(apdu) == MAX_SEGMENT_BUFFERS) {
+        buffer = tsm_segment_buffer_alloc(NULL);
+        if (!buffer) {
+            abort_reason = ABORT_REASON_PREEMPTED_BY_HIGHER_PRIORITY_TASK;
+            goto TSM_ABORT;
+        }
+    }
+    /* keep only the service data - the header differs in each segment */
+    memmove(buffer, &apdu[COMPLEX_ACK_HEADER_LEN],
+        apdu_len - COMPLEX_ACK_HEADER_LEN);
+    peer->state = TSM_STATE_SEGMENTED_RESPONSE;
+    npdu_copy_data(&peer->npdu_data, npdu_data);
+    peer->service_data = *service_data;
+    peer->segment.buffer = buffer;
+    peer->segment.buffer_len = apdu_len - COMPLEX_ACK_HEADER_LEN;
+    peer->segment.service_choice = apdu[2];
+    peer->segment.segment_size = (uint16_t) segment_size;
+    peer->segment.segment_count = (uint8_t) segment_count;
+    peer->segment.SegmentRetryCount = 0;
+    peer->segment.SentAllSegments = false;
+    peer->segment.WindowResent = false;
+    peer->segment.InitialSequenceNumber = 0;
+    peer->segment.ProposedWindowSize = MAX_SEGMENT_WINDOW_SIZE;
+    /* the client tells us its window in the first SegmentACK */
+    peer->segment.ActualWindowSize = 1;
+    tsm_segment_window_send(peer);
+
+    return (int) apdu_len;
+
+  TSM_ABORT:
+    tsm_abort_send(dest, service_data->invoke_id, abort_reason, true);
+    tsm_segment_buffer_free(apdu);
+    if (peer) {
+        tsm_peer_free(peer);
+    }
+
+    return BACNET_STATUS_ABORT;
+}
+
+/** Send a ComplexACK, segmenting it when it doesn't fit the client.
+ * The TSM takes ownership of the APDU if it came from
+ * tsm_segment_buffer_alloc(), and sends an Abort itself if the
+ * response cannot be delivered.
+ * @param dest [in] the client
+ * @param npdu_data [in] network priority for the reply
+ * @param service_data [in] the header of the request being answered
+ * @param apdu [in] the complete unsegmented ComplexACK APDU
+ * @param apdu_len [in] length of the APDU
+ * @return number of bytes sent, or BACNET_STATUS_ABORT
+ */
+int tsm_set_complexack_transaction(
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data,
+    BACNET_CONFIRMED_SERVICE_DATA * service_data,
+    uint8_t * apdu,
+    uint32_t apdu_len)
+{
+    int status;
+
+    baclock_take(&TSM_Lock);
+    status =
+        tsm_set_complexack_transaction_locked(dest, npdu_data, service_data,
+        apdu, apdu_len);
+    baclock_give(&TSM_Lock);
+
+    return status;
+}
+
+/* Stores one received segment.
+   Returns 1 when the message is complete, 0 while more segments are
+   expected, and -1 if the transaction was aborted. */
+static int tsm_segment_receive(
+    BACNET_ADDRESS * src,
+    BACNET_TSM_SEGMENT_DATA * segment,
+    uint8_t invokeID,
+    bool server,
+    uint8_t sequence_number,
+    bool more_follows,
+    uint8_t * data,
+    uint16_t data_len)
+{
+    segment->SegmentTimer = tsm_segment_receive_timeout();
+    if (sequence_number != (uint8_t) (segment->LastSequenceNumber + 1)) {
+        /* SegmentReceivedOutOfOrder or duplicate:
+           ask for everything after the last good one */
+        tsm_segmentack_send(src, true, server, invokeID,
+            segment->LastSequenceNumber, segment->ActualWindowSize);
+        return 0;
+    }
+    if ((segment->buffer_len + data_len) > MAX_SEGMENTED_APDU) {
+        tsm_abort_send(src, invokeID, ABORT_REASON_BUFFER_OVERFLOW, server);
+        return -1;
+    }
+    memcpy(&segment->buffer[segment->buffer_len], data, data_len);
+    segment->buffer_len += data_len;
+    segment->LastSequenceNumber = sequence_number;
+    if (!more_follows) {
+        tsm_segmentack_send(src, false, server, invokeID, sequence_number,
+            segment->ActualWindowSize);
+        return 1;
+    }
+    if ((sequence_number == 0) ||
+        (sequence_number ==
+            (uint8_t) (segment->InitialSequenceNumber +
+                segment->ActualWindowSize - 1))) {
+        /* the first segment, or the window is full */
+        tsm_segmentack_send(src, false, server, invokeID, sequence_number,
+            segment->ActualWindowSize);
+        segment->InitialSequenceNumber = sequence_number + 1;
+    }
+
+    return 0;
+}
+
+/* prepares a segment structure for the first segment of a message */
+static void tsm_segment_receive_init(
+    BACNET_TSM_SEGMENT_DATA * segment,
+    uint8_t * buffer,
+    uint8_t service_choice,
+    uint8_t proposed_window_size)
+{
+    memset(segment, 0, sizeof(BACNET_TSM_SEGMENT_DATA));
+    segment->buffer = buffer;
+    segment->service_choice = service_choice;
+    segment->ProposedWindowSize = proposed_window_size;
+    segment->ActualWindowSize = proposed_window_size;
+    if (segment->ActualWindowSize > MAX_SEGMENT_WINDOW_SIZE) {
+        segment->ActualWindowSize = MAX_SEGMENT_WINDOW_SIZE;
+    }
+    if (segment->ActualWindowSize == 0) {
+        segment->ActualWindowSize = 1;
+    }
+    /* so that zero is the next expected sequence number */
+    segment->LastSequenceNumber = 255;
+}
+
+/* tsm_segmented_request_received() with TSM_Lock held */
+static bool tsm_segmented_request_received_locked(
+    BACNET_ADDRESS * src,
+    BACNET_CONFIRMED_SERVICE_DATA * service_data,
+    uint8_t service_choice,
+    uint8_t * service_request,
+    uint16_t service_request_len,
+    uint8_t ** request,
+    uint32_t * request_len)
+{
+    BACNET_TSM_PEER_DATA *peer = NULL;
+    uint8_t *buffer = NULL;
+    int status = 0;
+
+    peer = tsm_peer_find(src, service_data->invoke_id);
+    if (!peer && (service_data->sequence_number == 0)) {
+        buffer = tsm_segment_buffer_alloc(NULL);
+        if (buffer) {
+            peer = tsm_peer_alloc(src, service_data->invoke_id);
+        }
+        if (!peer) {
+            tsm_segment_buffer_free(buffer);
+            tsm_abort_send(src, service_data->invoke_id,
+                ABORT_REASON_PREEMPTED_BY_HIGHER_PRIORITY_TASK, true);
+            return false;
+        }
+        peer->state = TSM_STATE_SEGMENTED_REQUEST;
+        peer->service_data = *service_data;
+        tsm_segment_receive_init(&peer->segment, buffer, service_choice,
+            service_data->proposed_window_number);
+    }
+    if (!peer || (peer->state != TSM_STATE_SEGMENTED_REQUEST) ||
+        (peer->segment.service_choice != service_choice)) {
+        tsm_abort_send(src, service_data->invoke_id,
+            ABORT_REASON_INVALID_APDU_IN_THIS_STATE, true);
+        if (peer) {
+            tsm_peer_free(peer);
+        }
+        return false;
+    }
+    status =
+        tsm_segment_receive(src, &peer->segment, peer->InvokeID, true,
+        service_data->sequence_number, service_data->more_follows,
+        service_request, service_request_len);
+    if (status < 0) {
+        tsm_peer_free(peer);
+    } else if (status > 0) {
+        peer->state = TSM_STATE_AWAIT_RESPONSE;
+        *request = peer->segment.buffer;
+        *request_len = peer->segment.buffer_len;
+        return true;
+    }
+
+    return false;
+}
+
+/** Collect a segment of a confirmed request sent to us.
+ * @param src [in] the client
+ * @param service_data [in] the header of this segment
+ * @param service_choice [in] the service of this segment
+ * @param service_request [in] the service data of this segment
+ * @param service_request_len [in] length of the service data
+ * @param request [out] the reassembled service request
+ * @param request_len [out] length of the reassembled service request
+ * @return true when the last segment has been received; the caller
+ *         passes the request on, then calls tsm_segmented_request_done()
+ */
+bool tsm_segmented_request_received(
+    BACNET_ADDRESS * src,
+    BACNET_CONFIRMED_SERVICE_DATA * service_data,
+    uint8_t service_choice,
+    uint8_t * service_request,
+    uint16_t service_request_len,
+    uint8_t ** request,
+    uint32_t * request_len)
+{
+    bool status;
+
+    baclock_take(&TSM_Lock);
+    status =
+        tsm_segmented_request_received_locked(src, service_data,
+        service_choice, service_request, service_request_len, request,
+        request_len);
+    baclock_give(&TSM_Lock);
+
+    return status;
+}
+
+/** Release a reassembled request once its handler has returned,
+ *  unless the handler turned it into a segmented response.
+ * @param src [in] the client
+ * @param invokeID [in] the client's invoke ID
+ */
+void tsm_segmented_request_done(
+    BACNET_ADDRESS * src,
+    uint8_t invokeID)
+{
+    BACNET_TSM_PEER_DATA *peer = NULL;
+
+    baclock_take(&TSM_Lock);
+    peer = tsm_peer_find(src, invokeID);
+    if (peer && (peer->state == TSM_STATE_AWAIT_RESPONSE)) {
+        tsm_peer_free(peer);
+    }
+    baclock_give(&TSM_Lock);
+}
+
+/* tsm_segmented_complexack_received() with TSM_Lock held */
+static bool tsm_segmented_complexack_received_locked(
+    BACNET_ADDRESS * src,
+    BACNET_CONFIRMED_SERVICE_ACK_DATA * service_data,
+    uint8_t service_choice,
+    uint8_t * service_request,
+    uint16_t service_request_len,
+    uint8_t ** ack,
+    uint32_t * ack_len)
+{
+    BACNET_TSM_DATA *tsm = NULL;
+    uint8_t *buffer = NULL;
+    uint8_t index = 0;
+    int status = 0;
+
+    index = tsm_find_invokeID_index(service_data->invoke_id);
+    if (index >= MAX_TSM_TRANSACTIONS) {
+        return false;
+    }
+    tsm = &TSM_List[index];
+    if (!bacnet_address_same(src, &tsm->dest)) {
+        /* only the server we asked answers our request */
+        return false;
+    }
+    if ((tsm->state == TSM_STATE_AWAIT_CONFIRMATION) &&
+        (service_data->sequence_number == 0)) {
+        buffer = tsm_segment_buffer_alloc(NULL);
+        if (!buffer) {
+            tsm_abort_send(src, service_data->invoke_id,
+                ABORT_REASON_PREEMPTED_BY_HIGHER_PRIORITY_TASK, false);
+            /* a valid invoke ID in IDLE is a failed message */
+            tsm->state = TSM_STATE_IDLE;
+            return false;
+        }
+        tsm->state = TSM_STATE_SEGMENTED_CONFIRMATION;
+        tsm_segment_receive_init(&tsm->segment, buffer, service_choice,
+            service_data->proposed_window_number);
+    }
+    if ((tsm->state != TSM_STATE_SEGMENTED_CONFIRMATION) ||
+        (tsm->segment.service_choice != service_choice)) {
+        return false;
+    }
+    status =
+        tsm_segment_receive(src, &tsm->segment, tsm->InvokeID, false,
+        service_data->sequence_number, service_data->more_follows,
+        service_request, service_request_len);
+    if (status < 0) {
+        tsm_segment_data_free(&tsm->segment);
+        tsm->state = TSM_STATE_IDLE;
+    } else if (status > 0) {
+        *ack = tsm->segment.buffer;
+        *ack_len = tsm->segment.buffer_len;
+        return true;
+    }
+
+    return false;
+}
+
+/** Collect a segment of a ComplexACK for one of our requests.
+ * @param src [in] the server
+ * @param service_data [in] the header of this segment
+ * @param service_choice [in] the service of this segment
+ * @param service_request [in] the service data of this segment
+ * @param service_request_len [in] length of the service data
+ * @param ack [out] the reassembled service data
+ * @param ack_len [out] length of the reassembled service data
+ * @return true when the last segment has been received; the caller
+ *         passes the ACK on, then frees the invoke ID.
+ */
+bool tsm_segmented_complexack_received(
+    BACNET_ADDRESS * src,
+    BACNET_CONFIRMED_SERVICE_ACK_DATA * service_data,
+    uint8_t service_choice,
+    uint8_t * service_request,
+    uint16_t service_request_len,
+    uint8_t ** ack,
+    uint32_t * ack_len)
+{
+    bool status;
+
+    baclock_take(&TSM_Lock);
+    status =
+        tsm_segmented_complexack_received_locked(src, service_data,
+        service_choice, service_request, service_request_len, ack, ack_len);
+    baclock_give(&TSM_Lock);
+
+    return status;
+}
+
+/* tsm_segmentack_received() with TSM_Lock held */
+static void tsm_segmentack_received_locked(
+    BACNET_ADDRESS * src,
+    uint8_t invokeID,
+    uint8_t sequence_number,
+    uint8_t actual_window_size,
+    bool negative_ack)
+{
+    BACNET_TSM_PEER_DATA *peer = tsm_peer_find(src, invokeID);
+
+    if (!peer || (peer->state != TSM_STATE_SEGMENTED_RESPONSE)) {
+        return;
+    }
+    if (negative_ack &&
+        ((uint8_t) (sequence_number + 1) ==
+            peer->segment.InitialSequenceNumber)) {
+        /* nothing of the window arrived in order: send it again, from
+           the segment after the acknowledged one, but only once for the
+           NAKs of every segment the client got out of order */
+        if (!peer->segment.WindowResent) {
+            peer->segment.WindowResent = true;
+            tsm_segment_window_send(peer);
+        }
+        return;
+    }
+    if ((uint8_t) (sequence_number - peer->segment.InitialSequenceNumber) >=
+        peer->segment.ActualWindowSize) {
+        /* DuplicateACK_Received */
+        peer->segment.SegmentTimer = apdu_segment_timeout();
+        return;
+    }
+    if (peer->segment.SentAllSegments &&
+        ((sequence_number + 1) == peer->segment.segment_count)) {
+        /* FinalACK_Received */
+        tsm_peer_free(peer);
+        return;
+    }
+    /* NewACK_Received: a negative one resends from the segment after
+       it, which the NAKs that follow for the same segment need not do */
+    peer->segment.ResendWindow = false;
+    peer->segment.WindowResent = negative_ack;
+    peer->segment.InitialSequenceNumber = sequence_number + 1;
+    peer->segment.ActualWindowSize = actual_window_size;
+    if (peer->segment.ActualWindowSize > 127) {
+        peer->segment.ActualWindowSize = 127;
+    }
+    if (peer->segment.ActualWindowSize == 0) {
+        peer->segment.ActualWindowSize = 1;
+    }
+    peer->segment.SegmentRetryCount = 0;
+    tsm_segment_window_send(peer);
+}
+
+/** Handle a SegmentACK from a client receiving our segmented ComplexACK.
+ * Transmission resumes after the acknowledged segment; a negative ACK
+ * for the segment before the window, which says none of the window
+ * arrived in order, sends the window again at once.
+ * @param src [in] the client
+ * @param invokeID [in] the client's invoke ID
+ * @param sequence_number [in] the last segment received in order
+ * @param actual_window_size [in] the window the client accepts
+ * @param negative_ack [in] true for a negative SegmentACK
+ */
+void tsm_segmentack_received(
+    BACNET_ADDRESS * src,
+    uint8_t invokeID,
+    uint8_t sequence_number,
+    uint8_t actual_window_size,
+    bool negative_ack)
+{
+    baclock_take(&TSM_Lock);
+    tsm_segmentack_received_locked(src, invokeID, sequence_number,
+        actual_window_size, negative_ack);
+    baclock_give(&TSM_Lock);
+}
+
+/** Handle an Abort from a client for one of the transactions we serve.
+ * @param src [in] the client
+ * @param invokeID [in] the client's invoke ID
+ */
+void tsm_abort_received(
+    BACNET_ADDRESS * src,
+    uint8_t invokeID)
+{
+    BACNET_TSM_PEER_DATA *peer = NULL;
+
+    baclock_take(&TSM_Lock);
+    peer = tsm_peer_find(src, invokeID);
+    if (peer) {
+        tsm_peer_free(peer);
+    }
+    baclock_give(&TSM_Lock);
+}
+
+static void tsm_peer_timer_milliseconds(
+    uint16_t milliseconds)
+{
+    BACNET_TSM_PEER_DATA *peer = NULL;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_TSM_PEER_TRANSACTIONS; i++) {
+        peer = &TSM_Peer_List[i];
+        if ((peer->state != TSM_STATE_SEGMENTED_REQUEST) &&
+            (peer->state != TSM_STATE_SEGMENTED_RESPONSE)) {
+            continue;
+        }
+        if (peer->segment.SegmentTimer > milliseconds) {
+            peer->segment.SegmentTimer -= milliseconds;
+            continue;
+        }
+        peer->segment.SegmentTimer = 0;
+        if ((peer->state == TSM_STATE_SEGMENTED_RESPONSE) &&
+            (peer->segment.SegmentRetryCount < apdu_retries())) {
+            /* resend the window, once TSM_Lock is given */
+            peer->segment.SegmentRetryCount++;
+            peer->segment.ResendWindow = true;
+            peer->segment.ResendSequenceNumber =
+                peer->segment.InitialSequenceNumber;
+            peer->segment.SegmentTimer = apdu_segment_timeout();
+        } else {
+            /* the client went away */
+            tsm_peer_free(peer);
+        }
+    }
+}
+#endif
+
+/* encodes the next PDU the timer has to send again into pdu[],
+   and returns its length, or 0 when there are no more */
+static unsigned tsm_timer_pdu_locked(
+    uint8_t * pdu,
+    BACNET_ADDRESS * dest,
+    BACNET_NPDU_DATA * npdu_data)
+{
+    unsigned i = 0;
+#if BACNET_SEGMENTATION_ENABLED
+    BACNET_TSM_PEER_DATA *peer = NULL;
+    uint8_t sequence_number = 0;
+#endif
+
+    for (i = 0; i < MAX_TSM_TRANSACTIONS; i++) {
+        if (TSM_List[i].Retransmit) {
+            TSM_List[i].Retransmit = false;
+            if (TSM_List[i].state == TSM_STATE_AWAIT_CONFIRMATION) {
+                bacnet_address_copy(dest, &TSM_List[i].dest);
+                npdu_copy_data(npdu_data, &TSM_List[i].npdu_data);
+                memcpy(pdu, &TSM_List[i].apdu[0], TSM_List[i].apdu_len);
+                return TSM_List[i].apdu_len;
+            }
+        }
+    }
+#if BACNET_SEGMENTATION_ENABLED
+    for (i = 0; i < MAX_TSM_PEER_TRANSACTIONS; i++) {
+        peer = &TSM_Peer_List[i];
+        if (!peer->segment.ResendWindow) {
+            continue;
+        }
+        sequence_number = peer->segment.ResendSequenceNumber;
+        if ((peer->state != TSM_STATE_SEGMENTED_RESPONSE) ||
+            ((uint8_t) (sequence_number -
+                    peer->segment.InitialSequenceNumber) >=
+                peer->segment.ActualWindowSize) ||
+            (sequence_number >= peer->segment.segment_count)) {
+            peer->segment.ResendWindow = false;
+            continue;
+        }
+        if ((sequence_number + 1) == peer->segment.segment_count) {
+            peer->segment.SentAllSegments = true;
+        }
+        peer->segment.ResendSequenceNumber++;
+        bacnet_address_copy(dest, &peer->dest);
+
+        return (unsigned) tsm_segment_encode(pdu, npdu_data, peer,
+            sequence_number);
+    }
+#endif
+
+    return 0;
+}
+
+/* called once a millisecond or slower.
+   The PDUs that time out are sent again after TSM_Lock is given,
+   so that no other task waits on the TSM while the datalink sends. */
 void tsm_timer_milliseconds(
     uint16_t milliseconds)
 {
+    BACNET_ADDRESS dest;
+    BACNET_NPDU_DATA npdu_data;
+    uint8_t pdu[MAX_PDU];
+    unsigned pdu_len = 0;
     unsigned i = 0;     /* counter */
 
+    baclock_take(&TSM_Lock);
     for (i = 0; i < MAX_TSM_TRANSACTIONS; i++) {
         if (TSM_List[i].state == TSM_STATE_AWAIT_CONFIRMATION) {
             if (TSM_List[i].RequestTimer > milliseconds)
@@ -268,9 +1154,7 @@ void tsm_timer_milliseconds(
                 if (TSM_List[i].RetryCount < apdu_retries()) {
                     TSM_List[i].RequestTimer = apdu_timeout();
                     TSM_List[i].RetryCount++;
-                    datalink_send_pdu(&TSM_List[i].dest,
-                        &TSM_List[i].npdu_data, &TSM_List[i].apdu[0],
-                        TSM_List[i].apdu_len);
+                    TSM_List[i].Retransmit = true;
                 } else {
                     /* note: the invoke id has not been cleared yet
                        and this indicates a failed message:
@@ -279,6 +1163,30 @@ void tsm_timer_milliseconds(
                 }
             }
         }
+#if BACNET_SEGMENTATION_ENABLED
+        else if (TSM_List[i].state == TSM_STATE_SEGMENTED_CONFIRMATION) {
+            if (TSM_List[i].segment.SegmentTimer > milliseconds) {
+                TSM_List[i].segment.SegmentTimer -= milliseconds;
+            } else {
+                /* the server stopped sending: a failed message */
+                tsm_segment_data_free(&TSM_List[i].segment);
+                TSM_List[i].state = TSM_STATE_IDLE;
+            }
+        }
+#endif
+    }
+#if BACNET_SEGMENTATION_ENABLED
+    tsm_peer_timer_milliseconds(milliseconds);
+#endif
+    baclock_give(&TSM_Lock);
+    for (;;) {
+        baclock_take(&TSM_Lock);
+        pdu_len = tsm_timer_pdu_locked(pdu, &dest, &npdu_data);
+        baclock_give(&TSM_Lock);
+        if (pdu_len == 0) {
+            break;
+        }
+        datalink_send_pdu(&dest, &npdu_data, pdu, pdu_len);
     }
 }
 
@@ -288,11 +1196,16 @@ void tsm_free_invoke_id(
 {
     uint8_t index;
 
+    baclock_take(&TSM_Lock);
     index = tsm_find_invokeID_index(invokeID);
     if (index < MAX_TSM_TRANSACTIONS) {
         TSM_List[index].state = TSM_STATE_IDLE;
         TSM_List[index].InvokeID = 0;
+#if BACNET_SEGMENTATION_ENABLED
+        tsm_segment_data_free(&TSM_List[index].segment);
+#endif
     }
+    baclock_give(&TSM_Lock);
 }
 
 /** Check if the invoke ID has been made free by the Transaction State Machine.
@@ -305,9 +1218,11 @@ bool tsm_invoke_id_free(
     bool status = true;
     uint8_t index;
 
+    baclock_take(&TSM_Lock);
     index = tsm_find_invokeID_index(invokeID);
     if (index < MAX_TSM_TRANSACTIONS)
         status = false;
+    baclock_give(&TSM_Lock);
 
     return status;
 }
@@ -324,6 +1239,7 @@ bool tsm_invoke_id_failed(
     bool status = false;
     uint8_t index;
 
+    baclock_take(&TSM_Lock);
     index = tsm_find_invokeID_index(invokeID);
     if (index < MAX_TSM_TRANSACTIONS) {
         /* a valid invoke ID and the state is IDLE is a
@@ -331,48 +1247,655 @@ bool tsm_invoke_id_failed(
         if (TSM_List[index].state == TSM_STATE_IDLE)
             status = true;
     }
+    baclock_give(&TSM_Lock);
 
     return status;
 }
 
 
-#ifdef TEST
+/* the TSM tests stand in for the datalink, so they only build on their
+   own - other tests link the TSM as it is */
+#if defined(TEST) && defined(TEST_TSM)
 #include <assert.h>
+#include <pthread.h>
 #include <string.h>
 #include "ctest.h"
 
 /* flag to send an I-Am */
 bool I_Am_Request = true;
 
-/* dummy function stubs */
+/* the PDUs sent while a test captures them, oldest first */
+#define TEST_FRAMES 64
+typedef struct test_frame {
+    BACNET_ADDRESS dest;
+    uint8_t pdu[MAX_PDU];
+    unsigned pdu_len;
+} TEST_FRAME;
+static TEST_FRAME Test_Frame[TEST_FRAMES];
+static unsigned Test_Frame_Head;
+static unsigned Test_Frame_Count;
+static bool Test_Capture;
+
+/* the datalink: keeps what is sent while Test_Capture is set */
 int datalink_send_pdu(
     BACNET_ADDRESS * dest,
     BACNET_NPDU_DATA * npdu_data,
     uint8_t * pdu,
     unsigned pdu_len)
 {
-    (void) dest;
+    TEST_FRAME *frame = NULL;
+
     (void) npdu_data;
-    (void) pdu;
-    (void) pdu_len;
+    if (Test_Capture && (Test_Frame_Count < TEST_FRAMES)) {
+        frame =
+            &Test_Frame[(Test_Frame_Head + Test_Frame_Count) % TEST_FRAMES];
+        bacnet_address_copy(&frame->dest, dest);
+        memcpy(frame->pdu, pdu, pdu_len);
+        frame->pdu_len = pdu_len;
+        Test_Frame_Count++;
+    }
 
-    return 0;
+    return (int) pdu_len;
 }
 
 /* dummy function stubs */
 void datalink_get_broadcast_address(
     BACNET_ADDRESS * dest)
 {
-    (void) dest;
+    memset(dest, 0, sizeof(BACNET_ADDRESS));
+}
+
+/* dummy function stubs */
+void datalink_get_my_address(
+    BACNET_ADDRESS * my_address)
+{
+    memset(my_address, 0, sizeof(BACNET_ADDRESS));
+}
+
+#define TEST_THREADS 4
+#define TEST_LOOPS 200000
+
+/* the invoke IDs the threads hold */
+static volatile uint8_t Test_Invoke_ID_Held[256];
+static volatile unsigned Test_Errors;
+static volatile bool Test_Done;
+
+/* a client task: each request it makes has an invoke ID of its own,
+   and keeps what was sent until it is freed */
+static void *test_client_thread(
+    void *arg)
+{
+    BACNET_ADDRESS dest = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t apdu[8] = { 0 };
+    uint8_t sent[8] = { 0 };
+    uint16_t sent_len = 0;
+    uint8_t invoke_id = 0;
+    unsigned i;
+
+    apdu[0] = (uint8_t) (uintptr_t) arg;
+    for (i = 0; i < TEST_LOOPS; i++) {
+        invoke_id = tsm_next_free_invokeID();
+        if (invoke_id == 0) {
+            continue;
+        }
+        if (__sync_lock_test_and_set(&Test_Invoke_ID_Held[invoke_id], 1)) {
+            Test_Errors++;
+        }
+        apdu[1] = invoke_id;
+        tsm_set_confirmed_unsegmented_transaction(invoke_id, &dest,
+            &npdu_data, apdu, sizeof(apdu));
+        if (!tsm_get_transaction_pdu(invoke_id, &dest, &npdu_data, sent,
+                &sent_len) || (sent_len != sizeof(apdu)) ||
+            (memcmp(sent, apdu, sizeof(apdu)) != 0)) {
+            Test_Errors++;
+        }
+        __sync_lock_release(&Test_Invoke_ID_Held[invoke_id]);
+        tsm_free_invoke_id(invoke_id);
+    }
+
+    return NULL;
+}
+
+/* the task that times the requests out meanwhile */
+static void *test_timer_thread(
+    void *arg)
+{
+    (void) arg;
+    while (!Test_Done) {
+        tsm_timer_milliseconds(1);
+    }
+
+    return NULL;
+}
+
+void testTSMThreads(
+    Test * pTest)
+{
+    pthread_t client[TEST_THREADS];
+    pthread_t timer;
+    unsigned i;
+
+    Test_Done = false;
+    ct_test(pTest, pthread_create(&timer, NULL, test_timer_thread,
+            NULL) == 0);
+    for (i = 0; i < TEST_THREADS; i++) {
+        ct_test(pTest, pthread_create(&client[i], NULL, test_client_thread,
+                (void *) (uintptr_t) (i + 1)) == 0);
+    }
+    for (i = 0; i < TEST_THREADS; i++) {
+        (void) pthread_join(client[i], NULL);
+    }
+    Test_Done = true;
+    (void) pthread_join(timer, NULL);
+    ct_test(pTest, Test_Errors == 0);
+    ct_test(pTest, tsm_transaction_idle_count() == MAX_TSM_TRANSACTIONS);
 }
 
 void testTSM(
     Test * pTest)
 {
-    /* FIXME: add some unit testing... */
+#if BACNET_SEGMENTATION_ENABLED
+    uint8_t *buffer[MAX_SEGMENT_BUFFERS];
+    uint32_t buffer_size = 0;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_SEGMENT_BUFFERS; i++) {
+        buffer[i] = tsm_segment_buffer_alloc(&buffer_size);
+        ct_test(pTest, buffer[i] != NULL);
+        ct_test(pTest, buffer_size == MAX_SEGMENTED_APDU);
+    }
+    ct_test(pTest, tsm_segment_buffer_alloc(&buffer_size) == NULL);
+    ct_test(pTest, buffer_size == 0);
+    tsm_segment_buffer_free(buffer[0]);
+    ct_test(pTest, tsm_segment_buffer_alloc(NULL) == buffer[0]);
+    for (i = 0; i < MAX_SEGMENT_BUFFERS; i++) {
+        tsm_segment_buffer_free(buffer[i]);
+    }
+#endif
     return;
 }
 
+#if BACNET_SEGMENTATION_ENABLED
+static BACNET_ADDRESS Test_Client;
+static BACNET_ADDRESS Test_Server;
+/* the ComplexACK the server sends: 11 segments of TEST_SEGMENT_SIZE */
+#define TEST_MAX_RESP 50
+#define TEST_SEGMENT_SIZE (TEST_MAX_RESP - COMPLEX_ACK_SEGMENT_HEADER_LEN)
+#define TEST_ACK_LEN ((10 * TEST_SEGMENT_SIZE) + 20)
+#define TEST_INVOKE_ID_SERVER 77
+
+static void test_frames_reset(
+    void)
+{
+    Test_Frame_Head = 0;
+    Test_Frame_Count = 0;
+    Test_Capture = true;
+    memset(&Test_Client, 0, sizeof(Test_Client));
+    Test_Client.mac_len = 1;
+    Test_Client.mac[0] = 1;
+    memset(&Test_Server, 0, sizeof(Test_Server));
+    Test_Server.mac_len = 1;
+    Test_Server.mac[0] = 2;
+}
+
+/* takes the oldest frame sent and returns its APDU, or NULL */
+static uint8_t *test_frame_get(
+    TEST_FRAME ** frame,
+    unsigned *apdu_len)
+{
+    BACNET_ADDRESS dest;
+    BACNET_ADDRESS src;
+    BACNET_NPDU_DATA npdu_data;
+    int npdu_len = 0;
+
+    if (Test_Frame_Count == 0) {
+        return NULL;
+    }
+    *frame = &Test_Frame[Test_Frame_Head];
+    Test_Frame_Head = (Test_Frame_Head + 1) % TEST_FRAMES;
+    Test_Frame_Count--;
+    npdu_len = npdu_decode((*frame)->pdu, &dest, &src, &npdu_data);
+    *apdu_len = (*frame)->pdu_len - (unsigned) npdu_len;
+
+    return &(*frame)->pdu[npdu_len];
+}
+
+/* true when every segment buffer is back in the pool */
+static bool test_segment_buffers_free(
+    void)
+{
+    uint8_t *buffer[MAX_SEGMENT_BUFFERS];
+    unsigned i = 0;
+    bool status = true;
+
+    for (i = 0; i < MAX_SEGMENT_BUFFERS; i++) {
+        buffer[i] = tsm_segment_buffer_alloc(NULL);
+        if (!buffer[i]) {
+            status = false;
+        }
+    }
+    for (i = 0; i < MAX_SEGMENT_BUFFERS; i++) {
+        tsm_segment_buffer_free(buffer[i]);
+    }
+
+    return status;
+}
+
+/* the server answers the client's request with a ComplexACK that
+   takes 11 segments; returns the client's invoke ID */
+static uint8_t test_complexack_start(
+    Test * pTest,
+    uint8_t * service_data_sent)
+{
+    BACNET_CONFIRMED_SERVICE_DATA service_data = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t request[8] = { 0 };
+    uint8_t *apdu = NULL;
+    uint8_t invoke_id = 0;
+    unsigned i = 0;
+
+    invoke_id = tsm_next_free_invokeID();
+    ct_test(pTest, invoke_id != 0);
+    tsm_set_confirmed_unsegmented_transaction(invoke_id, &Test_Server,
+        &npdu_data, request, sizeof(request));
+    apdu = tsm_segment_buffer_alloc(NULL);
+    ct_test(pTest, apdu != NULL);
+    apdu[0] = PDU_TYPE_COMPLEX_ACK;
+    apdu[1] = invoke_id;
+    apdu[2] = SERVICE_CONFIRMED_READ_PROP_MULTIPLE;
+    for (i = 0; i < TEST_ACK_LEN; i++) {
+        service_data_sent[i] = (uint8_t) (i * 7);
+        apdu[COMPLEX_ACK_HEADER_LEN + i] = service_data_sent[i];
+    }
+    service_data.invoke_id = invoke_id;
+    service_data.max_resp = TEST_MAX_RESP;
+    service_data.max_segs = 64;
+    service_data.segmented_response_accepted = true;
+    ct_test(pTest, tsm_set_complexack_transaction(&Test_Client, &npdu_data,
+            &service_data, apdu,
+            COMPLEX_ACK_HEADER_LEN + TEST_ACK_LEN) > 0);
+
+    return invoke_id;
+}
+
+/* passes the frames between the client and the server, dropping the
+   first segment with sequence number drop, and sending the first with
+   sequence number duplicate twice; -1 for neither. When the frames stop
+   before the client has the whole ComplexACK, a segment timeout passes.
+   Returns true once the client has the whole ComplexACK. */
+static bool test_complexack_pump(
+    Test * pTest,
+    int drop,
+    int duplicate,
+    unsigned *acks,
+    unsigned *naks,
+    unsigned *timeouts,
+    uint8_t ** ack,
+    uint32_t * ack_len)
+{
+    BACNET_CONFIRMED_SERVICE_ACK_DATA ack_data = { 0 };
+    TEST_FRAME *frame = NULL;
+    uint8_t *apdu = NULL;
+    unsigned apdu_len = 0;
+    unsigned steps = 0;
+    unsigned copies = 0;
+    bool complete = false;
+
+    do {
+        while ((apdu = test_frame_get(&frame, &apdu_len)) != NULL) {
+            ct_test(pTest, ++steps < 1000);
+            if ((apdu[0] & 0xF0) == PDU_TYPE_SEGMENT_ACK) {
+                /* from the client: the server bit is clear */
+                ct_test(pTest, (apdu[0] & BAC_BIT(0)) == 0);
+                ct_test(pTest, bacnet_address_same(&frame->dest,
+                        &Test_Server));
+                if (apdu[0] & BAC_BIT(1)) {
+                    (*naks)++;
+                } else {
+                    (*acks)++;
+                }
+                tsm_segmentack_received(&Test_Client, apdu[1], apdu[2],
+                    apdu[3], (apdu[0] & BAC_BIT(1)) != 0);
+                continue;
+            }
+            ct_test(pTest, (apdu[0] & 0xF0) == PDU_TYPE_COMPLEX_ACK);
+            ct_test(pTest, (apdu[0] & BAC_BIT(3)) != 0);
+            ct_test(pTest, bacnet_address_same(&frame->dest, &Test_Client));
+            if (apdu[2] == drop) {
+                drop = -1;
+                continue;
+            }
+            copies = 1;
+            if (apdu[2] == duplicate) {
+                duplicate = -1;
+                copies = 2;
+            }
+            ack_data.segmented_message = true;
+            ack_data.more_follows = (apdu[0] & BAC_BIT(2)) ? true : false;
+            ack_data.invoke_id = apdu[1];
+            ack_data.sequence_number = apdu[2];
+            ack_data.proposed_window_number = apdu[3];
+            while (copies--) {
+                if (tsm_segmented_complexack_received(&Test_Server,
+                        &ack_data, apdu[4],
+                        &apdu[COMPLEX_ACK_SEGMENT_HEADER_LEN],
+                        (uint16_t) (apdu_len -
+                            COMPLEX_ACK_SEGMENT_HEADER_LEN), ack,
+                        ack_len)) {
+                    complete = true;
+                }
+            }
+        }
+        if (!complete) {
+            /* the server sends the unacknowledged window again */
+            tsm_timer_milliseconds(apdu_segment_timeout());
+            (*timeouts)++;
+        }
+    } while (Test_Frame_Count > 0);
+
+    return complete;
+}
+
+/* a segmented ComplexACK, windowed by the SegmentACKs of the client */
+static void testTSMSegmentedComplexACK(
+    Test * pTest,
+    int drop,
+    int duplicate)
+{
+    uint8_t sent[TEST_ACK_LEN];
+    uint8_t *ack = NULL;
+    uint32_t ack_len = 0;
+    unsigned acks = 0;
+    unsigned naks = 0;
+    unsigned timeouts = 0;
+    uint8_t invoke_id = 0;
+
+    test_frames_reset();
+    invoke_id = test_complexack_start(pTest, sent);
+    /* the first window is a single segment */
+    ct_test(pTest, Test_Frame_Count == 1);
+    ct_test(pTest, test_complexack_pump(pTest, drop, duplicate, &acks, &naks,
+            &timeouts, &ack, &ack_len));
+    ct_test(pTest, ack_len == TEST_ACK_LEN);
+    ct_test(pTest, memcmp(ack, sent, TEST_ACK_LEN) == 0);
+    if ((drop < 0) && (duplicate < 0)) {
+        /* segment 0, then windows of MAX_SEGMENT_WINDOW_SIZE */
+        ct_test(pTest, acks ==
+            (1 + ((11 - 1 + MAX_SEGMENT_WINDOW_SIZE - 1) /
+                    MAX_SEGMENT_WINDOW_SIZE)));
+        ct_test(pTest, naks == 0);
+        ct_test(pTest, timeouts == 0);
+    } else {
+        ct_test(pTest, naks > 0);
+    }
+    tsm_free_invoke_id(invoke_id);
+    /* the server let go of the transaction on the final SegmentACK */
+    ct_test(pTest, test_segment_buffers_free());
+    Test_Capture = false;
+}
+
+void testTSMSegmentWindows(
+    Test * pTest)
+{
+    testTSMSegmentedComplexACK(pTest, -1, -1);
+    testTSMSegmentedComplexACK(pTest, 2, -1);
+    testTSMSegmentedComplexACK(pTest, 5, -1);
+    testTSMSegmentedComplexACK(pTest, 8, -1);
+    testTSMSegmentedComplexACK(pTest, -1, 3);
+    testTSMSegmentedComplexACK(pTest, -1, 10);
+    testTSMSegmentedComplexACK(pTest, 0, 7);
+}
+
+/* checks the next frame is a SegmentACK from the server */
+static void test_segmentack_expect(
+    Test * pTest,
+    bool nak,
+    uint8_t sequence_number)
+{
+    TEST_FRAME *frame = NULL;
+    uint8_t *apdu = NULL;
+    unsigned apdu_len = 0;
+
+    apdu = test_frame_get(&frame, &apdu_len);
+    ct_test(pTest, apdu != NULL);
+    if (apdu) {
+        ct_test(pTest, apdu_len == 4);
+        ct_test(pTest, (apdu[0] & 0xF0) == PDU_TYPE_SEGMENT_ACK);
+        ct_test(pTest, (apdu[0] & BAC_BIT(0)) != 0);
+        ct_test(pTest, ((apdu[0] & BAC_BIT(1)) != 0) == nak);
+        ct_test(pTest, apdu[1] == TEST_INVOKE_ID_SERVER);
+        ct_test(pTest, apdu[2] == sequence_number);
+    }
+}
+
+/* receives one segment of a request of four segments of four octets */
+static bool test_request_segment(
+    uint8_t sequence_number,
+    uint8_t ** request,
+    uint32_t * request_len)
+{
+    BACNET_CONFIRMED_SERVICE_DATA service_data = { 0 };
+    uint8_t data[4];
+    unsigned i = 0;
+
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t) ((sequence_number * sizeof(data)) + i);
+    }
+    service_data.segmented_message = true;
+    service_data.more_follows = (sequence_number < 3);
+    service_data.invoke_id = TEST_INVOKE_ID_SERVER;
+    service_data.sequence_number = sequence_number;
+    service_data.proposed_window_number = 2;
+    service_data.max_resp = MAX_APDU;
+
+    return tsm_segmented_request_received(&Test_Client, &service_data,
+        SERVICE_CONFIRMED_WRITE_PROP_MULTIPLE, data, sizeof(data), request,
+        request_len);
+}
+
+/* a segmented request, with segments out of order and duplicated */
+void testTSMSegmentedRequest(
+    Test * pTest)
+{
+    uint8_t *request = NULL;
+    uint32_t request_len = 0;
+    unsigned i = 0;
+
+    test_frames_reset();
+    ct_test(pTest, !test_request_segment(0, &request, &request_len));
+    test_segmentack_expect(pTest, false, 0);
+    ct_test(pTest, !test_request_segment(1, &request, &request_len));
+    ct_test(pTest, Test_Frame_Count == 0);
+    /* segment 2 is lost: ask again for what follows 1 */
+    ct_test(pTest, !test_request_segment(3, &request, &request_len));
+    test_segmentack_expect(pTest, true, 1);
+    /* the window is full */
+    ct_test(pTest, !test_request_segment(2, &request, &request_len));
+    test_segmentack_expect(pTest, false, 2);
+    /* a duplicate is not stored again */
+    ct_test(pTest, !test_request_segment(2, &request, &request_len));
+    test_segmentack_expect(pTest, true, 2);
+    ct_test(pTest, test_request_segment(3, &request, &request_len));
+    test_segmentack_expect(pTest, false, 3);
+    ct_test(pTest, Test_Frame_Count == 0);
+    ct_test(pTest, request_len == 16);
+    for (i = 0; i < 16; i++) {
+        ct_test(pTest, request[i] == i);
+    }
+    tsm_segmented_request_done(&Test_Client, TEST_INVOKE_ID_SERVER);
+    ct_test(pTest, test_segment_buffers_free());
+    Test_Capture = false;
+}
+
+/* segments and requests that time out */
+void testTSMSegmentTimeout(
+    Test * pTest)
+{
+    BACNET_CONFIRMED_SERVICE_ACK_DATA ack_data = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t sent[TEST_ACK_LEN];
+    uint8_t request[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    TEST_FRAME *frame = NULL;
+    uint8_t *apdu = NULL;
+    unsigned apdu_len = 0;
+    uint8_t *ack = NULL;
+    uint32_t ack_len = 0;
+    unsigned acks = 0;
+    unsigned naks = 0;
+    unsigned timeouts = 0;
+    uint8_t invoke_id = 0;
+    unsigned i = 0;
+
+    /* a window that is lost is sent again when the segment times out */
+    test_frames_reset();
+    invoke_id = test_complexack_start(pTest, sent);
+    apdu = test_frame_get(&frame, &apdu_len);
+    ct_test(pTest, apdu && (apdu[2] == 0));
+    tsm_segmentack_received(&Test_Client, invoke_id, 0,
+        MAX_SEGMENT_WINDOW_SIZE, false);
+    ct_test(pTest, Test_Frame_Count == MAX_SEGMENT_WINDOW_SIZE);
+    Test_Frame_Count = 0;
+    tsm_timer_milliseconds(apdu_segment_timeout() - 1);
+    ct_test(pTest, Test_Frame_Count == 0);
+    tsm_timer_milliseconds(1);
+    ct_test(pTest, Test_Frame_Count == MAX_SEGMENT_WINDOW_SIZE);
+    for (i = 0; i < MAX_SEGMENT_WINDOW_SIZE; i++) {
+        ct_test(pTest, Test_Frame[(Test_Frame_Head + i) % TEST_FRAMES].pdu[
+                Test_Frame[(Test_Frame_Head + i) % TEST_FRAMES].pdu_len -
+                TEST_SEGMENT_SIZE - 3] == (1 + i));
+    }
+    /* the client has segment 0 and the rest comes again */
+    ack_data.segmented_message = true;
+    ack_data.more_follows = true;
+    ack_data.invoke_id = invoke_id;
+    ack_data.proposed_window_number = MAX_SEGMENT_WINDOW_SIZE;
+    ct_test(pTest, !tsm_segmented_complexack_received(&Test_Server,
+            &ack_data, SERVICE_CONFIRMED_READ_PROP_MULTIPLE, sent,
+            TEST_SEGMENT_SIZE, &ack, &ack_len));
+    /* its SegmentACK of segment 0 is a duplicate by now */
+    ct_test(pTest, test_complexack_pump(pTest, -1, -1, &acks, &naks,
+            &timeouts, &ack, &ack_len));
+    ct_test(pTest, timeouts == 0);
+    ct_test(pTest, ack_len == TEST_ACK_LEN);
+    ct_test(pTest, memcmp(ack, sent, TEST_ACK_LEN) == 0);
+    tsm_free_invoke_id(invoke_id);
+    ct_test(pTest, test_segment_buffers_free());
+
+    /* a negative SegmentACK for the segment before the window says none
+       of the window arrived in order: it is sent again at once, once */
+    test_frames_reset();
+    invoke_id = test_complexack_start(pTest, sent);
+    apdu = test_frame_get(&frame, &apdu_len);
+    ct_test(pTest, apdu && (apdu[2] == 0));
+    tsm_segmentack_received(&Test_Client, invoke_id, 0,
+        MAX_SEGMENT_WINDOW_SIZE, false);
+    ct_test(pTest, Test_Frame_Count == MAX_SEGMENT_WINDOW_SIZE);
+    Test_Frame_Count = 0;
+    tsm_segmentack_received(&Test_Client, invoke_id, 0,
+        MAX_SEGMENT_WINDOW_SIZE, true);
+    ct_test(pTest, Test_Frame_Count == MAX_SEGMENT_WINDOW_SIZE);
+    for (i = 0; i < MAX_SEGMENT_WINDOW_SIZE; i++) {
+        ct_test(pTest, Test_Frame[(Test_Frame_Head + i) % TEST_FRAMES].pdu[
+                Test_Frame[(Test_Frame_Head + i) % TEST_FRAMES].pdu_len -
+                TEST_SEGMENT_SIZE - 3] == (1 + i));
+    }
+    Test_Frame_Count = 0;
+    /* the NAKs of the other segments out of order */
+    tsm_segmentack_received(&Test_Client, invoke_id, 0,
+        MAX_SEGMENT_WINDOW_SIZE, true);
+    ct_test(pTest, Test_Frame_Count == 0);
+    /* and a positive one is a duplicate */
+    tsm_segmentack_received(&Test_Client, invoke_id, 0,
+        MAX_SEGMENT_WINDOW_SIZE, false);
+    ct_test(pTest, Test_Frame_Count == 0);
+    ack_data.segmented_message = true;
+    ack_data.more_follows = true;
+    ack_data.invoke_id = invoke_id;
+    ack_data.sequence_number = 0;
+    ack_data.proposed_window_number = MAX_SEGMENT_WINDOW_SIZE;
+    ct_test(pTest, !tsm_segmented_complexack_received(&Test_Server,
+            &ack_data, SERVICE_CONFIRMED_READ_PROP_MULTIPLE, sent,
+            TEST_SEGMENT_SIZE, &ack, &ack_len));
+    ct_test(pTest, test_complexack_pump(pTest, -1, -1, &acks, &naks,
+            &timeouts, &ack, &ack_len));
+    ct_test(pTest, ack_len == TEST_ACK_LEN);
+    ct_test(pTest, memcmp(ack, sent, TEST_ACK_LEN) == 0);
+    tsm_free_invoke_id(invoke_id);
+    ct_test(pTest, test_segment_buffers_free());
+
+    /* a client that stops acknowledging is given up on */
+    test_frames_reset();
+    invoke_id = test_complexack_start(pTest, sent);
+    tsm_free_invoke_id(invoke_id);
+    for (i = 0; i < apdu_retries(); i++) {
+        Test_Frame_Count = 0;
+        tsm_timer_milliseconds(apdu_segment_timeout());
+        ct_test(pTest, Test_Frame_Count == 1);
+    }
+    Test_Frame_Count = 0;
+    tsm_timer_milliseconds(apdu_segment_timeout());
+    ct_test(pTest, Test_Frame_Count == 0);
+    ct_test(pTest, test_segment_buffers_free());
+
+    /* segments from a device other than the server are not taken */
+    test_frames_reset();
+    invoke_id = tsm_next_free_invokeID();
+    tsm_set_confirmed_unsegmented_transaction(invoke_id, &Test_Server,
+        &npdu_data, request, sizeof(request));
+    ack_data.invoke_id = invoke_id;
+    ack_data.sequence_number = 0;
+    ct_test(pTest, !tsm_segmented_complexack_received(&Test_Client,
+            &ack_data, SERVICE_CONFIRMED_READ_PROP_MULTIPLE, sent,
+            TEST_SEGMENT_SIZE, &ack, &ack_len));
+    ct_test(pTest, Test_Frame_Count == 0);
+    ct_test(pTest, TSM_List[tsm_find_invokeID_index(invoke_id)].state ==
+        TSM_STATE_AWAIT_CONFIRMATION);
+    tsm_free_invoke_id(invoke_id);
+    ct_test(pTest, test_segment_buffers_free());
+
+    /* a server that stops sending segments fails the request */
+    test_frames_reset();
+    invoke_id = tsm_next_free_invokeID();
+    tsm_set_confirmed_unsegmented_transaction(invoke_id, &Test_Server,
+        &npdu_data, request, sizeof(request));
+    ack_data.invoke_id = invoke_id;
+    ack_data.sequence_number = 0;
+    ct_test(pTest, !tsm_segmented_complexack_received(&Test_Server,
+            &ack_data, SERVICE_CONFIRMED_READ_PROP_MULTIPLE, sent,
+            TEST_SEGMENT_SIZE, &ack, &ack_len));
+    ct_test(pTest, !tsm_invoke_id_failed(invoke_id));
+    tsm_timer_milliseconds(tsm_segment_receive_timeout());
+    ct_test(pTest, tsm_invoke_id_failed(invoke_id));
+    tsm_free_invoke_id(invoke_id);
+    ct_test(pTest, test_segment_buffers_free());
+
+    /* an unanswered request is sent again, then fails */
+    test_frames_reset();
+    invoke_id = tsm_next_free_invokeID();
+    tsm_set_confirmed_unsegmented_transaction(invoke_id, &Test_Server,
+        &npdu_data, request, sizeof(request));
+    for (i = 0; i < apdu_retries(); i++) {
+        Test_Frame_Count = 0;
+        Test_Frame_Head = 0;
+        tsm_timer_milliseconds(apdu_timeout());
+        ct_test(pTest, Test_Frame_Count == 1);
+        ct_test(pTest, Test_Frame[0].pdu_len == sizeof(request));
+        ct_test(pTest, memcmp(Test_Frame[0].pdu, request,
+                sizeof(request)) == 0);
+        ct_test(pTest, bacnet_address_same(&Test_Frame[0].dest,
+                &Test_Server));
+    }
+    ct_test(pTest, !tsm_invoke_id_failed(invoke_id));
+    Test_Frame_Count = 0;
+    tsm_timer_milliseconds(apdu_timeout());
+    ct_test(pTest, Test_Frame_Count == 0);
+    ct_test(pTest, tsm_invoke_id_failed(invoke_id));
+    tsm_free_invoke_id(invoke_id);
+    Test_Capture = false;
+}
+#endif
+
 #ifdef TEST_TSM
 int main(
     void)
@@ -384,6 +1907,16 @@ int main(
     /* individual tests */
     rc = ct_addTestFunction(pTest, testTSM);
     assert(rc);
+#if BACNET_SEGMENTATION_ENABLED
+    rc = ct_addTestFunction(pTest, testTSMSegmentWindows);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testTSMSegmentedRequest);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testTSMSegmentTimeout);
+    assert(rc);
+#endif
+    rc = ct_addTestFunction(pTest, testTSMThreads);
+    assert(rc);
 
     ct_setStream(pTest, stdout);
     ct_run(pTest);
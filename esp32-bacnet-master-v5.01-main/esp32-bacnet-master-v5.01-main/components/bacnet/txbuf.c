@@ -24,9 +24,200 @@
 *********************************************************************/
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "config.h"
 #include "datalink.h"
+#include "baclock.h"
+#include "txbuf.h"
+#if !defined(TEST)
+#include "esp_log.h"
+#endif
 
-/** @file txbuf.c  Declare the global Transmit Buffer for handler functions. */
+/** @file txbuf.c  The Transmit Buffers of the tasks, for the handler functions. */
 
-uint8_t Handler_Transmit_Buffer[MAX_PDU] = { 0 };
+static TXBUF Transmit_Buffer[TXBUF_POOL_SIZE];
+/* the task each buffer belongs to, or NULL */
+static void *volatile Transmit_Buffer_Task[TXBUF_POOL_SIZE];
+static BACLOCK Transmit_Buffer_Lock = BACLOCK_INITIALIZER;
+#if !defined(TEST)
+static const char *TAG = "txbuf";
+#endif
+
+/* returns TXBUF_POOL_SIZE if the task has no buffer */
+static unsigned txbuf_index(
+    void *task)
+{
+    unsigned i;
+
+    for (i = 0; i < TXBUF_POOL_SIZE; i++) {
+        if (Transmit_Buffer_Task[i] == task) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/**
+ * Finds the transmit buffer of the calling task, taking one from the
+ * pool if it has none yet.  The pool has a buffer for each task that
+ * sends, so a task that finds it empty is one too many: it stops here
+ * rather than wait for a buffer that may never be released.
+ *
+ * @return the buffer, which the task keeps until txbuf_release()
+ */
+TXBUF *txbuf_get(
+    void)
+{
+    void *task = baclock_task();
+    unsigned i;
+
+    /* only the task itself ever makes a buffer its own,
+       so it finds it without the lock */
+    i = txbuf_index(task);
+    if (i == TXBUF_POOL_SIZE) {
+        baclock_take(&Transmit_Buffer_Lock);
+        i = txbuf_index(NULL);
+        if (i < TXBUF_POOL_SIZE) {
+            Transmit_Buffer_Task[i] = task;
+        }
+        baclock_give(&Transmit_Buffer_Lock);
+        if (i == TXBUF_POOL_SIZE) {
+#if defined(TEST)
+            fprintf(stderr, "txbuf: all %u transmit buffers are taken\n",
+                (unsigned) TXBUF_POOL_SIZE);
+#else
+            ESP_LOGE(TAG, "all %u transmit buffers are taken, task %s",
+                (unsigned) TXBUF_POOL_SIZE, pcTaskGetName(NULL));
+#endif
+            abort();
+        }
+    }
+
+    return &Transmit_Buffer[i];
+}
+
+/**
+ * Gives the transmit buffer of the calling task back to the pool,
+ * for a task that is done sending.
+ */
+void txbuf_release(
+    void)
+{
+    unsigned i;
+
+    baclock_take(&Transmit_Buffer_Lock);
+    i = txbuf_index(baclock_task());
+    if (i < TXBUF_POOL_SIZE) {
+        Transmit_Buffer_Task[i] = NULL;
+    }
+    baclock_give(&Transmit_Buffer_Lock);
+}
+
+#ifdef TEST
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "ctest.h"
+
+#define TEST_THREADS TXBUF_POOL_SIZE
+#define TEST_LOOPS 2000
+
+static volatile unsigned Test_Errors;
+
+/* fills its buffer with its own number, and finds it unchanged */
+static void *test_thread(
+    void *arg)
+{
+    uint8_t tag = (uint8_t) (uintptr_t) arg;
+    unsigned i, j;
+
+    for (i = 0; i < TEST_LOOPS; i++) {
+        memset(&Handler_Transmit_Buffer[0], tag, MAX_PDU);
+        (void) sched_yield();
+        for (j = 0; j < MAX_PDU; j++) {
+            if (Handler_Transmit_Buffer[j] != tag) {
+                Test_Errors++;
+                break;
+            }
+        }
+        /* some hand the buffer back, as a task that is done does */
+        if (tag & 1) {
+            txbuf_release();
+        }
+    }
+    txbuf_release();
+
+    return NULL;
+}
+
+void testTxBuf(
+    Test * pTest)
+{
+    pthread_t thread[TEST_THREADS];
+    unsigned i;
+
+    ct_test(pTest, sizeof(Handler_Transmit_Buffer) == MAX_PDU);
+    ct_test(pTest, &Handler_Transmit_Buffer[0] == &Handler_Transmit_Buffer[0]);
+    txbuf_release();
+    for (i = 0; i < TEST_THREADS; i++) {
+        ct_test(pTest, pthread_create(&thread[i], NULL, test_thread,
+                (void *) (uintptr_t) (i + 1)) == 0);
+    }
+    for (i = 0; i < TEST_THREADS; i++) {
+        (void) pthread_join(thread[i], NULL);
+    }
+    ct_test(pTest, Test_Errors == 0);
+    ct_test(pTest, txbuf_index(NULL) == 0);
+}
+
+/* a task more than the pool has buffers for stops, and does not wait */
+void testTxBufEmpty(
+    Test * pTest)
+{
+    pid_t pid;
+    int status = 0;
+    unsigned i;
+
+    pid = fork();
+    ct_test(pTest, pid >= 0);
+    if (pid == 0) {
+        for (i = 0; i < TXBUF_POOL_SIZE; i++) {
+            Transmit_Buffer_Task[i] = &Transmit_Buffer[i];
+        }
+        (void) txbuf_get();
+        _exit(0);
+    }
+    ct_test(pTest, waitpid(pid, &status, 0) == pid);
+    ct_test(pTest, WIFSIGNALED(status));
+    ct_test(pTest, WTERMSIG(status) == SIGABRT);
+}
+
+#ifdef TEST_TXBUF
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("BACnet Transmit Buffer", NULL);
+    /* individual tests */
+    rc = ct_addTestFunction(pTest, testTxBuf);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, testTxBufEmpty);
+    assert(rc);
+
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_TXBUF */
+#endif /* TEST */
@@ -0,0 +1,358 @@
+/**************************************************************************
+*
+* Copyright (C) 2026
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*********************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "vmac.h"
+
+/** @file vmac.c  Virtual MAC addresses of the BACnet/IPv6 nodes */
+
+/* A slot that was used and has been deleted keeps the probe sequences
+   running through it intact; it is reused by the next add. */
+#define VMAC_SLOT_EMPTY 0
+#define VMAC_SLOT_USED 1
+#define VMAC_SLOT_DELETED 2
+
+#if (VMAC_TABLE_SIZE & (VMAC_TABLE_SIZE - 1))
+#error VMAC_TABLE_SIZE must be a power of two
+#endif
+
+struct vmac_slot {
+    uint32_t device_id;
+    uint8_t state;
+    struct vmac_data vmac;
+};
+
+static struct vmac_slot VMAC_Table[VMAC_TABLE_SIZE];
+static unsigned int VMAC_Entries;
+
+/* the first slot to look in: Fibonacci hashing spreads the device
+   instances of a site, which tend to be close together */
+static unsigned int vmac_hash(
+    uint32_t device_id)
+{
+    return (unsigned int) ((device_id * 2654435761UL) & 0xFFFFFFFFUL) &
+        (VMAC_TABLE_SIZE - 1);
+}
+
+/* the slot of device_id, or NULL */
+static struct vmac_slot *vmac_slot_find(
+    uint32_t device_id)
+{
+    struct vmac_slot *slot = NULL;
+    unsigned int index = vmac_hash(device_id);
+    unsigned int i;
+
+    for (i = 0; i < VMAC_TABLE_SIZE; i++) {
+        slot = &VMAC_Table[index];
+        if (slot->state == VMAC_SLOT_EMPTY) {
+            break;
+        }
+        if ((slot->state == VMAC_SLOT_USED) &&
+            (slot->device_id == device_id)) {
+            return slot;
+        }
+        index = (index + 1) & (VMAC_TABLE_SIZE - 1);
+    }
+
+    return NULL;
+}
+
+/**
+ * Returns the number of VMAC in the list
+ */
+unsigned int VMAC_Count(
+    void)
+{
+    return VMAC_Entries;
+}
+
+/**
+ * Adds a VMAC to the list, or replaces the one of the device
+ *
+ * @param device_id - device ID used as the key-pair
+ * @param src - BACnet/IPv6 address
+ *
+ * @return true if the device ID and MAC are added
+ */
+bool VMAC_Add(
+    uint32_t device_id,
+    struct vmac_data *src)
+{
+    struct vmac_slot *slot = NULL;
+    struct vmac_slot *free_slot = NULL;
+    unsigned int index = 0;
+    unsigned int i;
+
+    if (!src || (src->mac_len > VMAC_MAC_MAX)) {
+        return false;
+    }
+    slot = vmac_slot_find(device_id);
+    if (!slot) {
+        index = vmac_hash(device_id);
+        for (i = 0; i < VMAC_TABLE_SIZE; i++) {
+            if (VMAC_Table[index].state != VMAC_SLOT_USED) {
+                free_slot = &VMAC_Table[index];
+                break;
+            }
+            index = (index + 1) & (VMAC_TABLE_SIZE - 1);
+        }
+        if (!free_slot) {
+            return false;
+        }
+        slot = free_slot;
+        slot->device_id = device_id;
+        slot->state = VMAC_SLOT_USED;
+        VMAC_Entries++;
+    }
+    memcpy(slot->vmac.mac, src->mac, src->mac_len);
+    slot->vmac.mac_len = src->mac_len;
+
+    return true;
+}
+
+/**
+ * Finds a VMAC in the list by its device ID
+ *
+ * @param device_id - device ID used as the key-pair
+ *
+ * @return pointer to the VMAC data, or NULL if not found
+ */
+struct vmac_data *VMAC_Find_By_Key(
+    uint32_t device_id)
+{
+    struct vmac_slot *slot = vmac_slot_find(device_id);
+
+    if (slot) {
+        return &slot->vmac;
+    }
+
+    return NULL;
+}
+
+/**
+ * Compares two VMAC addresses
+ *
+ * @param vmac1 - VMAC address that will be compared to vmac2
+ * @param vmac2 - VMAC address that will be compared to vmac1
+ *
+ * @return true if the addresses are different
+ */
+bool VMAC_Different(
+    struct vmac_data *vmac1,
+    struct vmac_data *vmac2)
+{
+    return !VMAC_Match(vmac1, vmac2);
+}
+
+/**
+ * Compares two VMAC addresses
+ *
+ * @param vmac1 - VMAC address that will be compared to vmac2
+ * @param vmac2 - VMAC address that will be compared to vmac1
+ *
+ * @return true if the addresses match
+ */
+bool VMAC_Match(
+    struct vmac_data *vmac1,
+    struct vmac_data *vmac2)
+{
+    if (!vmac1 || !vmac2 || (vmac1->mac_len != vmac2->mac_len) ||
+        (vmac1->mac_len > VMAC_MAC_MAX)) {
+        return false;
+    }
+
+    return (memcmp(vmac1->mac, vmac2->mac, vmac1->mac_len) == 0);
+}
+
+/**
+ * Finds the device ID of a VMAC address.  The table is hashed on the
+ * device ID, so this one looks through all of it.
+ *
+ * @param vmac - VMAC address to look for
+ * @param device_id - device ID of the VMAC, if found
+ *
+ * @return true if the VMAC address was found
+ */
+bool VMAC_Find_By_Data(
+    struct vmac_data *vmac,
+    uint32_t * device_id)
+{
+    unsigned int i;
+
+    for (i = 0; i < VMAC_TABLE_SIZE; i++) {
+        if ((VMAC_Table[i].state == VMAC_SLOT_USED) &&
+            VMAC_Match(vmac, &VMAC_Table[i].vmac)) {
+            if (device_id) {
+                *device_id = VMAC_Table[i].device_id;
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Deletes a VMAC from the list
+ *
+ * @param device_id - device ID used as the key-pair
+ *
+ * @return true if the device ID was found and deleted
+ */
+bool VMAC_Delete(
+    uint32_t device_id)
+{
+    struct vmac_slot *slot = vmac_slot_find(device_id);
+    unsigned int next = 0;
+
+    if (!slot) {
+        return false;
+    }
+    /* the end of a probe sequence needs no marker */
+    next = ((unsigned int) (slot - VMAC_Table) + 1) & (VMAC_TABLE_SIZE - 1);
+    if (VMAC_Table[next].state == VMAC_SLOT_EMPTY) {
+        slot->state = VMAC_SLOT_EMPTY;
+    } else {
+        slot->state = VMAC_SLOT_DELETED;
+    }
+    VMAC_Entries--;
+
+    return true;
+}
+
+/**
+ * Cleans up the memory used by the VMAC list data
+ */
+void VMAC_Cleanup(
+    void)
+{
+    memset(VMAC_Table, 0, sizeof(VMAC_Table));
+    VMAC_Entries = 0;
+}
+
+/**
+ * Initializes the VMAC list data
+ */
+void VMAC_Init(
+    void)
+{
+    VMAC_Cleanup();
+}
+
+#ifdef TEST
+#include <assert.h>
+#include "ctest.h"
+
+static void test_vmac_data(
+    struct vmac_data *vmac,
+    uint32_t device_id)
+{
+    unsigned int i;
+
+    vmac->mac_len = VMAC_MAC_MAX;
+    for (i = 0; i < VMAC_MAC_MAX; i++) {
+        vmac->mac[i] = (uint8_t) i;
+    }
+    vmac->mac[0] = (uint8_t) (device_id >> 16);
+    vmac->mac[1] = (uint8_t) (device_id >> 8);
+    vmac->mac[2] = (uint8_t) device_id;
+}
+
+void testVMAC(
+    Test * pTest)
+{
+    struct vmac_data vmac = { { 0 }, 0 };
+    struct vmac_data *pVMAC = NULL;
+    uint32_t device_id = 0;
+    uint32_t test_device_id = 0;
+    unsigned int i;
+
+    VMAC_Init();
+    ct_test(pTest, VMAC_Count() == 0);
+    ct_test(pTest, VMAC_Find_By_Key(123) == NULL);
+    /* device instances next to each other, and some that collide */
+    for (i = 0; i < (VMAC_TABLE_SIZE / 2); i++) {
+        device_id = (i & 1) ? (100 + i) : (i * VMAC_TABLE_SIZE);
+        test_vmac_data(&vmac, device_id);
+        ct_test(pTest, VMAC_Add(device_id, &vmac));
+    }
+    ct_test(pTest, VMAC_Count() == (VMAC_TABLE_SIZE / 2));
+    for (i = 0; i < (VMAC_TABLE_SIZE / 2); i++) {
+        device_id = (i & 1) ? (100 + i) : (i * VMAC_TABLE_SIZE);
+        test_vmac_data(&vmac, device_id);
+        pVMAC = VMAC_Find_By_Key(device_id);
+        ct_test(pTest, pVMAC != NULL);
+        ct_test(pTest, VMAC_Match(pVMAC, &vmac));
+        ct_test(pTest, VMAC_Find_By_Data(&vmac, &test_device_id));
+        ct_test(pTest, test_device_id == device_id);
+    }
+    /* a new address replaces the old one */
+    test_vmac_data(&vmac, 7);
+    ct_test(pTest, VMAC_Add(0, &vmac));
+    ct_test(pTest, VMAC_Count() == (VMAC_TABLE_SIZE / 2));
+    ct_test(pTest, VMAC_Match(VMAC_Find_By_Key(0), &vmac));
+    test_vmac_data(&vmac, 0);
+    ct_test(pTest, VMAC_Different(VMAC_Find_By_Key(0), &vmac));
+    /* the colliding ones are still found with one deleted before them */
+    ct_test(pTest, VMAC_Delete(0));
+    ct_test(pTest, !VMAC_Delete(0));
+    ct_test(pTest, VMAC_Find_By_Key(0) == NULL);
+    for (i = 2; i < (VMAC_TABLE_SIZE / 2); i += 2) {
+        ct_test(pTest, VMAC_Find_By_Key(i * VMAC_TABLE_SIZE) != NULL);
+    }
+    ct_test(pTest, VMAC_Count() == ((VMAC_TABLE_SIZE / 2) - 1));
+    /* and the table fills up, deleted slots too, but no more */
+    for (i = 0; VMAC_Count() < VMAC_TABLE_SIZE; i++) {
+        test_vmac_data(&vmac, 1000 + i);
+        ct_test(pTest, VMAC_Add(1000 + i, &vmac));
+    }
+    ct_test(pTest, !VMAC_Add(4000, &vmac));
+    ct_test(pTest, VMAC_Find_By_Key(4000) == NULL);
+    ct_test(pTest, VMAC_Find_By_Key(1000) != NULL);
+    VMAC_Cleanup();
+    ct_test(pTest, VMAC_Count() == 0);
+    ct_test(pTest, VMAC_Find_By_Key(1000) == NULL);
+}
+
+#ifdef TEST_VMAC
+int main(
+    void)
+{
+    Test *pTest;
+    bool rc;
+
+    pTest = ct_create("BACnet VMAC", NULL);
+    rc = ct_addTestFunction(pTest, testVMAC);
+    assert(rc);
+    ct_setStream(pTest, stdout);
+    ct_run(pTest);
+    (void) ct_report(pTest);
+    ct_destroy(pTest);
+
+    return 0;
+}
+#endif /* TEST_VMAC */
+#endif /* TEST */
@@ -264,7 +264,6 @@ int wpm_encode_apdu(
 	int apdu_len = 0;
 	int len = 0;
 	BACNET_WRITE_ACCESS_DATA *wpm_object;        /* current object */
-	uint8_t apdu_temp[MAX_APDU];      /* temp for data before copy */
 	BACNET_PROPERTY_VALUE *wpm_property;    /* current property */
 	BACNET_WRITE_PROPERTY_DATA wpdata;	/* for compatibility with wpm_encode_apdu_object_property function */
 
@@ -287,10 +286,14 @@ int wpm_encode_apdu(
 				wpdata.array_index = wpm_property->propertyArrayIndex;
 				wpdata.priority = wpm_property->priority;
 
-				wpdata.application_data_len = bacapp_encode_data(&apdu_temp[0],
-					&wpm_property->value);
-				memcpy(&wpdata.application_data[0], &apdu_temp[0],
-					(size_t)wpdata.application_data_len);
+				/* sized first, so that it is encoded in place */
+				len = bacapp_encode_data_len(&wpm_property->value);
+				if ((len <= 0) ||
+					((size_t) len > sizeof(wpdata.application_data))) {
+					return 0;
+				}
+				wpdata.application_data_len = bacapp_encode_data(
+					&wpdata.application_data[0], &wpm_property->value);
 
 				len = wpm_encode_apdu_object_property(&apdu[apdu_len], &wpdata);
 				apdu_len += len;
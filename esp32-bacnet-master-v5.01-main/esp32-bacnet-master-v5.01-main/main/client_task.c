@@ -70,12 +70,9 @@ int last_button_state = -1;
 
 while(true)
 {
+    /* the server task runs the TSM timer for both */
     current_seconds = time(NULL);
 
-    if (current_seconds != last_seconds) {
-        tsm_timer_milliseconds((uint16_t)((current_seconds - last_seconds) * 1000));
-    }
-
     if (!found) {
         found = address_bind_request(CLIENT_DEVICE_ID, &max_apdu, &Target_Address);
         if (!found && (current_seconds % 5 == 0)) {
@@ -25,6 +25,7 @@
 #include "apdu.h"
 #include "iam.h"
 #include "tsm.h"
+#include "rpm_batch.h"
 #include "datalink.h"
 #include "dcc.h"
 #include "getevent.h"
@@ -32,6 +33,11 @@
 #include "txbuf.h"
 #include "version.h"
 #include "av.h"
+#include "trendlog.h"
+#if TREND_LOG_ARCHIVE
+#include "esp_spiffs.h"
+#include "tlarchive.h"
+#endif
 #include "sdkconfig.h"
 
 #define SERVER_DEVICE_ID CONFIG_SERVER_DEVICE_ID
@@ -48,7 +54,14 @@ static object_functions_t Object_Table[] = {
         Device_Object_Name, 
         Device_Read_Property_Local,
         Device_Write_Property_Local, 
-        Device_Property_Lists 
+        Device_Property_Lists,
+        NULL /* ReadRangeInfo */,
+        NULL /* Iterator */,
+        NULL /* Value_Lists */,
+        NULL /* COV */,
+        NULL /* COV Clear */,
+        NULL /* Intrinsic Reporting */,
+        Device_Property_Table
     },
     { 
         OBJECT_ANALOG_VALUE, 
@@ -59,7 +72,35 @@ static object_functions_t Object_Table[] = {
         Analog_Value_Object_Name, 
         Analog_Value_Read_Property,
         Analog_Value_Write_Property, 
-        Analog_Value_Property_Lists 
+        Analog_Value_Property_Lists,
+        NULL /* ReadRangeInfo */,
+        NULL /* Iterator */,
+        Analog_Value_Encode_Value_List,
+        Analog_Value_Change_Of_Value,
+        Analog_Value_Change_Of_Value_Clear,
+        NULL /* Intrinsic Reporting */,
+        Analog_Value_Property_Table
+    },
+    { 
+        OBJECT_TRENDLOG, 
+        Trend_Log_Init, 
+        Trend_Log_Count,
+        Trend_Log_Index_To_Instance, 
+        Trend_Log_Valid_Instance,
+        Trend_Log_Object_Name, 
+        Trend_Log_Read_Property,
+        Trend_Log_Write_Property, 
+        Trend_Log_Property_Lists,
+        Trend_Log_RR_Info,
+        NULL /* Iterator */,
+        NULL /* Value_Lists */,
+        NULL /* COV */,
+        NULL /* COV Clear */,
+        NULL /* Intrinsic Reporting */,
+        Trend_Log_Property_Table
+    },
+    {
+        MAX_BACNET_OBJECT_TYPE /* end of the table */
     },
 };
 
@@ -107,8 +148,24 @@ static void Init_Service_Handlers(void)
     /* handle the data coming back from private requests */
     apdu_set_unconfirmed_handler(SERVICE_UNCONFIRMED_PRIVATE_TRANSFER,
         handler_unconfirmed_private_transfer);
+    /* the ACKs of batched reads: last, since it passes the Rejects and
+       Aborts of other requests on to the handlers set before */
+    rpm_batch_init();
 }
 
+#if TREND_LOG_ARCHIVE
+/* writes the Trend Log pages to flash, so that the server task
+   never waits for it */
+static void archive_task(void *pvParameters)
+{
+    for (;;) {
+        if (!tl_archive_maintenance()) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+    }
+}
+#endif
+
 void app_main(void)
 {
     // Initialize NVS
@@ -125,8 +182,10 @@ void app_main(void)
     // Initialize event loop
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
+#if defined(BACDL_BIP) || defined(BACDL_BIP6)
 	// Initialize wifi and connect
     wifi_initialize();
+#endif
 
     // set up led
     led_initialize();
@@ -139,12 +198,26 @@ void app_main(void)
     /* load any static address bindings to show up
        in our device bindings list */
     address_init();
+#if TREND_LOG_ARCHIVE
+    /* the Trend Logs read back their pages in Device_Init() */
+    esp_vfs_spiffs_conf_t spiffs_conf = {
+        .base_path = TL_ARCHIVE_PATH,
+        .partition_label = "storage",
+        .max_files = 4,
+        .format_if_mount_failed = true
+    };
+    if (esp_vfs_spiffs_register(&spiffs_conf) != ESP_OK) {
+        ESP_LOGE(TAG, "no SPIFFS partition for the trend log archive");
+    }
+#endif
     Init_Service_Handlers();
     dlenv_init();
     atexit(datalink_cleanup);
     /* configure the timeout values */
     /* broadcast an I-Am on startup */
     Send_I_Am(&Handler_Transmit_Buffer[0]);
+    /* this task is done sending: its buffer goes back to the pool */
+    txbuf_release();
 
     // start bacnet server
 	xTaskCreate(server_task,"bacnet_server", 8000, NULL, 1, NULL);
@@ -152,5 +225,10 @@ void app_main(void)
     // start bacnet client
     xTaskCreate(client_task,"bacnet_client", 8000, NULL, 1, NULL);	
 
+#if TREND_LOG_ARCHIVE
+    // write the trend log pages to flash
+    xTaskCreate(archive_task,"trend_archive", 4000, NULL, 1, NULL);
+#endif
+
     ESP_LOGI(TAG, "BACnet demo started");
 }
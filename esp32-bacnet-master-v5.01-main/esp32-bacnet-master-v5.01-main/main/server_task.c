@@ -6,6 +6,8 @@
 #include <time.h>
 
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "config.h"
 #include "address.h"
 #include "bacdef.h"
@@ -17,6 +19,7 @@
 #include "apdu.h"
 #include "iam.h"
 #include "tsm.h"
+#include "rpm_batch.h"
 #include "datalink.h"
 #include "dcc.h"
 #include "getevent.h"
@@ -28,6 +31,7 @@
 #include "ai.h"
 #include "bv.h"
 #include "av.h"
+#include "trendlog.h"
 #include "led.h"
 #include "server_task.h"
 
@@ -43,9 +47,16 @@ void server_task(void *arg)
     }; 
     
     uint16_t pdu_len = 0;
+    time_t last_seconds = time(NULL);
+    time_t current_seconds = 0;
+    TickType_t last_ticks = xTaskGetTickCount();
+    TickType_t current_ticks = 0;
+    uint16_t elapsed_milliseconds = 0;
 	
     for (;;) {
-        pdu_len = datalink_receive(&src, &rx_buffer[0], MAX_MPDU, 5000);
+        /* wake up often enough to time the segments and requests,
+           and to send the broadcasts held back for credit */
+        pdu_len = datalink_receive(&src, &rx_buffer[0], MAX_MPDU, 100);
 
         if (pdu_len) {
             npdu_handler(&src, &rx_buffer[0], pdu_len);
@@ -59,6 +70,35 @@ void server_task(void *arg)
                 led_off();
             }
         }
+        /* once a second: expire foreign devices, renew our registration,
+           expire COV subscriptions, sample the trend logs */
+        current_seconds = time(NULL);
+        if (current_seconds != last_seconds) {
+            dlenv_maintenance_timer((uint16_t) (current_seconds - last_seconds));
+            handler_cov_timer_seconds((uint32_t) (current_seconds -
+                    last_seconds));
+            Trend_Log_Timer((uint16_t) (current_seconds - last_seconds));
+            last_seconds = current_seconds;
+        }
+        /* notify the subscribers of the objects that have changed */
+        handler_cov_task();
+        /* retry the requests and segments that time out, for the
+           server and the client task alike */
+        current_ticks = xTaskGetTickCount();
+        if (current_ticks != last_ticks) {
+            elapsed_milliseconds =
+                (uint16_t) pdTICKS_TO_MS(current_ticks - last_ticks);
+            tsm_timer_milliseconds(elapsed_milliseconds);
+#if DATALINK_TX_QUEUE_SIZE
+            dlqueue_timer_milliseconds(elapsed_milliseconds);
+#endif
+            last_ticks = current_ticks;
+        }
+        /* fail the batched reads that timed out, send those queued */
+        rpm_batch_task();
+#if DATALINK_TX_QUEUE_SIZE
+        dlqueue_task();
+#endif
     }
 }
 
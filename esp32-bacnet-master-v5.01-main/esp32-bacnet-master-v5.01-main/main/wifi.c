@@ -28,6 +28,16 @@ static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
+#if defined(BACDL_BIP6)
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        /* BACnet/IPv6 needs at least the link-local address */
+        esp_netif_create_ip6_linklocal(esp_netif_get_handle_from_ifkey("WIFI_STA_DEF"));
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_GOT_IP6) {
+        ip_event_got_ip6_t* event = (ip_event_got_ip6_t*) event_data;
+        ESP_LOGI(TAG, "got ipv6:" IPV6STR, IPV62STR(event->ip6_info.ip));
+        s_retry_num = 0;
+        xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
+#endif
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         if (s_retry_num < MAXIMUM_RETRY) {
             esp_wifi_connect();
@@ -56,6 +66,9 @@ void wifi_initialize(void)
 
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
+#if defined(BACDL_BIP6)
+    esp_event_handler_instance_t instance_got_ip6;
+#endif
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
                                                         ESP_EVENT_ANY_ID,
                                                         &event_handler,
@@ -66,6 +79,13 @@ void wifi_initialize(void)
                                                         &event_handler,
                                                         NULL,
                                                         &instance_got_ip));
+#if defined(BACDL_BIP6)
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
+                                                        IP_EVENT_GOT_IP6,
+                                                        &event_handler,
+                                                        NULL,
+                                                        &instance_got_ip6));
+#endif
 
     wifi_config_t wifi_config = {
         .sta = {